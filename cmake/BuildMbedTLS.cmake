@@ -163,6 +163,15 @@ if(CMAKE_VERBOSE_MAKEFILE)
     list(APPEND mbedtls_configure -D "CMAKE_VERBOSE_MAKEFILE=1")
 endif()
 
+#
+# Mbed TLS is only built with link time optimization when it is built with
+# the same general purpose register only flags as the rest of RMM. Otherwise
+# its SIMD code could end up inlined out of the FPU enabled sections.
+#
+if(RMM_LTO AND NOT RMM_FPU_USE_AT_REL2)
+    list(APPEND mbedtls_configure -D "CMAKE_INTERPROCEDURAL_OPTIMIZATION=ON")
+endif()
+
 #
 # Mbed TLS's build system ignores and overwrites the flags we specify in our
 # toolchain files. Un-overwrite them, because they're there for a good reason.
@@ -176,9 +185,17 @@ if(RMM_FPU_USE_AT_REL2)
     # Enable using crypto and sha instructions
     string(REGEX REPLACE "(march=[^\\ ]*)" "\\1+sha3+crypto" FP_CMAKE_C_FLAGS ${FP_CMAKE_C_FLAGS})
     # Enable using SHA256 and SHA512 instructions in MbedTLS
-    string(APPEND FP_CMAKE_C_FLAGS
-            " -DMBEDTLS_SHA256_USE_A64_CRYPTO_ONLY=1 "
-            " -DMBEDTLS_SHA512_USE_A64_CRYPTO_ONLY=1 ")
+    if(RMM_SHA_A64_CRYPTO_DETECT)
+        # Fall back to the C implementation if the instructions are absent
+        string(APPEND FP_CMAKE_C_FLAGS
+                " -DRMM_SHA_A64_CRYPTO_DETECT=1 "
+                " -DMBEDTLS_SHA256_USE_A64_CRYPTO_IF_PRESENT=1 "
+                " -DMBEDTLS_SHA512_USE_A64_CRYPTO_IF_PRESENT=1 ")
+    else()
+        string(APPEND FP_CMAKE_C_FLAGS
+                " -DMBEDTLS_SHA256_USE_A64_CRYPTO_ONLY=1 "
+                " -DMBEDTLS_SHA512_USE_A64_CRYPTO_ONLY=1 ")
+    endif()
 else()
     set(FP_CMAKE_C_FLAGS ${CMAKE_C_FLAGS})
 endif()
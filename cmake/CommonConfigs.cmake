@@ -8,7 +8,7 @@
 #
 arm_config_option(
     NAME MAX_CPUS
-    HELP "Maximum number of CPUs supported by RMM"
+    HELP "Maximum number of CPUs supported by RMM. The per-CPU stacks and the larger per-CPU variables are only allocated for the CPUs reported by EL3 at boot"
     TYPE STRING
     DEFAULT 16)
 
@@ -36,6 +36,97 @@ arm_config_option(
     DEPENDS (RMM_ARCH STREQUAL aarch64)
     ELSE OFF)
 
+arm_config_option(
+    NAME RMM_SHA_A64_CRYPTO_DETECT
+    HELP "Use the A64 SHA256/SHA512 instructions only if detected at runtime"
+    TYPE BOOL
+    DEFAULT ON
+    DEPENDS RMM_FPU_USE_AT_REL2
+    ELSE OFF)
+
+arm_config_option(
+    NAME RMM_RMI_STATS
+    HELP "Collect per-CPU statistics of the RMI calls, read by RMI_RMI_STATS"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_PMU_PROFILE
+    HELP "Sample PMU event counters at EL2 around each RMI call and Realm exit handler, read by RMI_PMU_PROFILE"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_TICKET_LOCK
+    HELP "Use fair ticket locks instead of test-and-set spinlocks"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_REC_STATS
+    HELP "Collect per-REC exit and time statistics, read by RMI_REC_STATS"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_MPAM
+    HELP "Assign the MPAM PARTID and PMG chosen by the Host to each REC. Requires FEAT_MPAM"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_MEC
+    HELP "Run each Realm with its own Memory Encryption Context. Requires FEAT_MEC"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_SPE
+    HELP "Allow Realms to use the Statistical Profiling Extension. Requires FEAT_SPE"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_PAUTH
+    HELP "Allow Realms to use Pointer Authentication. Requires FEAT_PAuth"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_REC_RUN_SPARSE_COPY
+    HELP "Transfer only the RecRun fields used by each REC entry and exit"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_LTO
+    HELP "Build RMM, QCBOR, t_cose and, without RMM_FPU_USE_AT_REL2, Mbed TLS with link time optimization"
+    TYPE BOOL
+    DEFAULT OFF)
+
+arm_config_option(
+    NAME RMM_SMCCC_EXT_REGS
+    HELP "Enable the RMI calls which pass X1-X17 in both directions (SMCCC v1.2). Requires EL3 to forward these registers"
+    TYPE BOOL
+    DEFAULT OFF)
+
+#
+# Link time optimization lets the small helpers called across the libraries,
+# such as the granule, buffer and s2tte ones, be inlined into the RMI and
+# Realm exit handlers. It is enabled before any target is created, so that it
+# applies to all of them, including QCBOR and t_cose.
+#
+if(RMM_LTO)
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT lto_supported OUTPUT lto_output LANGUAGES C)
+
+    if(NOT lto_supported)
+        message(FATAL_ERROR "RMM_LTO is not supported by the toolchain: ${lto_output}")
+    endif()
+
+    set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+endif()
+
 #
 # Introduce a pseudo-library purely for applying flags to RMM's libraries.
 # This is applied to any targets created after this point.
@@ -53,8 +144,13 @@ endif()
 target_compile_definitions(rmm-common
     INTERFACE "MAX_CPUS=${MAX_CPUS}U")
 
+#
+# The stage 2 geometry (RTT levels, VTCR_EL2 and TLBI encodings) follows
+# GRANULE_SIZE, which may be 16KB or 64KB. The RMI ABI and the slot buffers,
+# which map each granule with a single 4KB page, still require 4KB though.
+#
 if(NOT(GRANULE_SIZE EQUAL 4096))
-    message(FATAL_ERROR "GRANULE_SIZE is not initialized correctly")
+    message(FATAL_ERROR "GRANULE_SIZE must be 4096: the RMI ABI and the slot buffers use 4KB granules")
 endif()
 
 target_compile_definitions(rmm-common
@@ -65,6 +161,61 @@ if(RMM_FPU_USE_AT_REL2)
         INTERFACE "RMM_FPU_USE_AT_REL2=1")
 endif()
 
+if(RMM_SHA_A64_CRYPTO_DETECT)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_SHA_A64_CRYPTO_DETECT=1")
+endif()
+
+if(RMM_RMI_STATS)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_RMI_STATS=1")
+endif()
+
+if(RMM_PMU_PROFILE)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_PMU_PROFILE=1")
+endif()
+
+if(RMM_REC_STATS)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_REC_STATS=1")
+endif()
+
+if(RMM_MPAM)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_MPAM=1")
+endif()
+
+if(RMM_MEC)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_MEC=1")
+endif()
+
+if(RMM_SPE)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_SPE=1")
+endif()
+
+if(RMM_PAUTH)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_PAUTH=1")
+endif()
+
+if(RMM_REC_RUN_SPARSE_COPY)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_REC_RUN_SPARSE_COPY=1")
+endif()
+
+if(RMM_SMCCC_EXT_REGS)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_SMCCC_EXT_REGS=1")
+endif()
+
+if(RMM_TICKET_LOCK)
+    target_compile_definitions(rmm-common
+        INTERFACE "RMM_TICKET_LOCK=1")
+endif()
+
 #
 # Project name and version
 #
@@ -29,13 +29,24 @@ arm_config_option_override(NAME RMM_UART_ADDR DEFAULT 0x1c0c0000)
 # Maximum number of translation tables allocated by the runtime context
 # for the translation library.
 #
-arm_config_option_override(NAME PLAT_CMN_CTX_MAX_XLAT_TABLES DEFAULT 5)
+arm_config_option_override(NAME PLAT_CMN_CTX_MAX_XLAT_TABLES DEFAULT 6)
+
+#
+# Maximum number of static regions mapped by the runtime context. Two extra
+# regions are needed to map the DRAM banks when RMM_GRANULE_DIRECT_MAP is
+# enabled, one for the per-CPU RMM-EL3 shared buffers, one for the granule
+# table (one per NUMA node if EL3 describes them) and one for the per-CPU
+# areas.
+#
+arm_config_option_override(NAME PLAT_CMN_MAX_MMAP_REGIONS DEFAULT 10)
 
 #
 # Disable FPU/SIMD usage in RMM. Enabling this option turns on
-# DMBEDTLS_SHAXXX_USE_A64_CRYPTO_ONLY in Mbed TLS. To run RMM that was compiled
-# this way requires Crypto.so plugin to be present for the FVP. This plugin is
-# delivered separate to the FVP, and might not be present in all environments.
+# DMBEDTLS_SHAXXX_USE_A64_CRYPTO_IF_PRESENT in Mbed TLS, or
+# DMBEDTLS_SHAXXX_USE_A64_CRYPTO_ONLY if RMM_SHA_A64_CRYPTO_DETECT is disabled.
+# The latter requires Crypto.so plugin to be present for the FVP. This plugin
+# is delivered separate to the FVP, and might not be present in all
+# environments.
 #
 arm_config_option_override(NAME RMM_FPU_USE_AT_REL2 DEFAULT OFF)
 
@@ -25,6 +25,34 @@
 #define MBEDTLS_ECDSA_C
 #define MBEDTLS_ECDSA_DETERMINISTIC
 #define MBEDTLS_ECP_WINDOW_SIZE		(2U)	/* Valid range = [2,7] */
+/*
+ * Use the constant comb tables of the P-384 base point built into MbedTLS
+ * for the k * G multiplication of each ECDSA signature, instead of
+ * computing the points of the comb for every signature.
+ */
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM	1
+/*
+ * Reduce modulo the P-384 prime with the dedicated NIST reduction, a fixed
+ * sequence of limb additions and subtractions, instead of a generic bignum
+ * division after every field multiplication.
+ */
+#define MBEDTLS_ECP_NIST_OPTIM
+/*
+ * Use the inline assembly of the bignum multiply-accumulate inner loop,
+ * which on AArch64 is built on MUL and UMULH without data dependent
+ * branches.
+ */
+#define MBEDTLS_HAVE_ASM
+
+/*
+ * AES-GCM protects the granules exported from a Realm with
+ * RMI_DATA_EXPORT. The AES tables are built in, rather than generated by
+ * MbedTLS on their first use, so that the CPUs can use them concurrently.
+ */
+#define MBEDTLS_AES_C
+#define MBEDTLS_AES_ROM_TABLES
+#define MBEDTLS_CIPHER_C
+#define MBEDTLS_GCM_C
 
 #define MBEDTLS_ENTROPY_C
 #define MBEDTLS_NO_PLATFORM_ENTROPY
@@ -69,4 +97,16 @@
 void *buffer_alloc_calloc(size_t n, size_t size);
 void buffer_alloc_free(void *ptr);
 
+#ifdef RMM_SHA_A64_CRYPTO_DETECT
+/*
+ * MbedTLS detects the A64 SHA256/SHA512 instructions through getauxval(),
+ * which is provided by RMM on top of ID_AA64ISAR0_EL1.
+ */
+#define AT_HWCAP	16UL
+#define HWCAP_SHA2	(1UL << 6)
+#define HWCAP_SHA512	(1UL << 21)
+
+unsigned long getauxval(unsigned long type);
+#endif /* RMM_SHA_A64_CRYPTO_DETECT */
+
 #endif /* MBEDTLS_CONFIG_H */
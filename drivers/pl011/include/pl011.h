@@ -54,4 +54,25 @@ int uart_init(uintptr_t baseaddr, unsigned int clock, unsigned int baud);
  */
 void uart_putc(char ch);
 
+/*
+ * Function that sends the log lines queued by the CPUs when
+ * RMM_UART_BUFFERED is enabled, as far as the Tx FIFO has room for them.
+ * It never waits for the UART nor for another CPU.
+ * Arguments:
+ *   void
+ * Returns:
+ *   void
+ */
+void uart_drain(void);
+
+/*
+ * Function that returns the number of log lines of a CPU dropped because
+ * its buffer was full when RMM_UART_BUFFERED is enabled
+ * Arguments:
+ *   cpu      - Index of the CPU
+ * Returns:
+ *   Number of lines dropped
+ */
+unsigned long uart_dropped_lines(unsigned int cpu);
+
 #endif /* PL011_H */
@@ -3,15 +3,26 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <arch.h>
+#include <arch_helpers.h>
+#include <atomics.h>
+#include <cpuid.h>
+#include <memory.h>
 #include <mmio.h>
 #include <pl011.h>
+#include <stdbool.h>
 #include <utils_def.h>
 
+static inline bool uart_tx_full(void)
+{
+	return (read32((void *)((RMM_UART_ADDR) + UARTFR))
+				& PL011_UARTFR_TXFF) != 0U;
+}
+
 static inline void uart_wait(void)
 {
 	/* Wait until there is room in the Tx FIFO */
-	while ((read32((void *)((RMM_UART_ADDR) + UARTFR))
-				& PL011_UARTFR_TXFF) != 0U) {
+	while (uart_tx_full()) {
 		/* Do nothing */
 	}
 }
@@ -67,6 +78,163 @@ void uart_putc(char ch)
 	write8(ch, (void *)((RMM_UART_ADDR) + UARTDR));
 }
 
+#ifdef RMM_UART_BUFFERED
+/* Size of the log buffer of each CPU, a power of two */
+#define UART_BUF_SIZE		U(1024)
+
+/*
+ * Log buffer of a CPU. The counters run freely and are reduced modulo
+ * UART_BUF_SIZE to index @data. Only the owner CPU writes @head and only
+ * the holder of the console lock writes @tail, so that each line can be
+ * queued without waiting for the UART.
+ */
+struct uart_buf {
+	char data[UART_BUF_SIZE];
+	/* End of the complete lines which can be sent */
+	unsigned long head;
+	/* End of the characters already sent */
+	unsigned long tail;
+	/* End of the line being written, owner CPU only */
+	unsigned long line_end;
+	/* The line being written did not fit, owner CPU only */
+	bool overflow;
+	/* Number of lines dropped because the buffer was full */
+	unsigned long dropped;
+} __aligned(CACHE_WRITEBACK_GRANULE);
+
+static struct uart_buf uart_bufs[MAX_CPUS];
+
+/* Number of complete lines queued in the buffers */
+static uint64_t uart_queued_lines;
+
+/* Bit 0 is the console lock, only ever tried by uart_drain() */
+static uint64_t uart_lock;
+
+/* Buffer drained first by the next holder of the console lock */
+static unsigned int uart_drain_cpu;
+
+/*
+ * Send the characters of @buf up to the end of its oldest complete line.
+ * Returns false if the Tx FIFO filled up before the end of the line.
+ */
+static bool uart_drain_line(struct uart_buf *buf)
+{
+	unsigned long tail = buf->tail;
+	char ch;
+
+	do {
+		if (uart_tx_full()) {
+			SCA_WRITE64_RELEASE(&buf->tail, tail);
+			return false;
+		}
+
+		ch = buf->data[tail % UART_BUF_SIZE];
+		write8(ch, (void *)((RMM_UART_ADDR) + UARTDR));
+		tail++;
+	} while (ch != '\n');
+
+	SCA_WRITE64_RELEASE(&buf->tail, tail);
+	return true;
+}
+
+/*
+ * Send as many queued lines as the Tx FIFO accepts, without waiting for it.
+ * Only whole lines are taken from each buffer in turn, so that the lines
+ * of different CPUs do not interleave. The call returns at once if another
+ * CPU is already draining the buffers.
+ */
+void uart_drain(void)
+{
+	if (SCA_READ64(&uart_queued_lines) == 0UL) {
+		return;
+	}
+
+	if (atomic_bit_set_acquire_release_64(&uart_lock, 0)) {
+		return;
+	}
+
+	while (SCA_READ64(&uart_queued_lines) != 0UL) {
+		struct uart_buf *buf = &uart_bufs[uart_drain_cpu];
+
+		if (buf->tail != SCA_READ64_ACQUIRE(&buf->head)) {
+			/* A partly sent line is finished first */
+			if (!uart_drain_line(buf)) {
+				break;
+			}
+			atomic_add_64(&uart_queued_lines, -1L);
+		}
+		uart_drain_cpu = (uart_drain_cpu + 1U) % MAX_CPUS;
+	}
+
+	atomic_bit_clear_release_64(&uart_lock, 0);
+}
+
+unsigned long uart_dropped_lines(unsigned int cpu)
+{
+	return SCA_READ64(&uart_bufs[cpu].dropped);
+}
+
+static void uart_buf_putc(struct uart_buf *buf, char ch)
+{
+	if ((buf->line_end - SCA_READ64_ACQUIRE(&buf->tail)) >=
+	    UART_BUF_SIZE) {
+		buf->overflow = true;
+		return;
+	}
+
+	buf->data[buf->line_end % UART_BUF_SIZE] = ch;
+	buf->line_end++;
+}
+
+/* Serial output - called from printf */
+void _putchar(char ch)
+{
+	struct uart_buf *buf = &uart_bufs[my_cpuid()];
+
+	/*
+	 * The atomics of the console are not usable on the Device memory
+	 * which backs the data accesses while the MMU is off, so the boot
+	 * messages logged before it is enabled are sent directly.
+	 */
+	if (!is_mmu_enabled()) {
+		if (ch == '\n') {
+			uart_putc('\r');
+		}
+		uart_putc(ch);
+		return;
+	}
+
+	if (ch != '\n') {
+		uart_buf_putc(buf, ch);
+		return;
+	}
+
+	uart_buf_putc(buf, '\r');
+	uart_buf_putc(buf, ch);
+
+	/* A line is queued whole or not at all */
+	if (buf->overflow) {
+		buf->line_end = buf->head;
+		buf->overflow = false;
+		SCA_WRITE64(&buf->dropped, buf->dropped + 1UL);
+	} else {
+		SCA_WRITE64_RELEASE(&buf->head, buf->line_end);
+		atomic_add_64(&uart_queued_lines, 1L);
+	}
+
+	uart_drain();
+}
+#else
+void uart_drain(void)
+{
+}
+
+unsigned long uart_dropped_lines(unsigned int cpu)
+{
+	(void)cpu;
+	return 0UL;
+}
+
 /* Serial output - called from printf */
 void _putchar(char ch)
 {
@@ -75,3 +243,4 @@ void _putchar(char ch)
 	}
 	uart_putc(ch);
 }
+#endif /* RMM_UART_BUFFERED */
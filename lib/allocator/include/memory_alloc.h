@@ -17,11 +17,40 @@ typedef struct memory_header_s memory_header_t;
  */
 #define REC_HEAP_PAGES		2
 
+/*
+ * Freed blocks of up to BUFFER_ALLOC_CLASSES * BUFFER_ALLOC_CLASS_STEP bytes
+ * are kept in per size class lists, so that the small and short lived
+ * allocations done by the bignum code are served without walking the free
+ * list.
+ */
+#define BUFFER_ALLOC_CLASS_STEP		16U
+#define BUFFER_ALLOC_CLASSES		16U
+
+/*
+ * Usage statistics of a heap. They are kept across the re-initialisations
+ * of the heap, so they cover the lifetime of the context.
+ */
+struct buffer_alloc_stats {
+	/* Successful and failed allocations */
+	unsigned long		allocs;
+	unsigned long		alloc_failures;
+	unsigned long		frees;
+	/* Bytes in use by the allocations, including their headers */
+	size_t			cur_bytes;
+	/* High-water mark of cur_bytes */
+	size_t			peak_bytes;
+	/* CNTPCT_EL0 ticks spent in the allocations, in total and at most */
+	unsigned long		alloc_ticks;
+	unsigned long		max_alloc_ticks;
+};
+
 struct buffer_alloc_ctx {
 	unsigned char		*buf;
 	size_t			len;
 	memory_header_t		*first;
 	memory_header_t		*first_free;
+	memory_header_t		*class_free[BUFFER_ALLOC_CLASSES];
+	struct buffer_alloc_stats stats;
 	int			verify;
 };
 
@@ -58,4 +87,14 @@ int buffer_alloc_ctx_assign(struct buffer_alloc_ctx *ctx);
  */
 void buffer_alloc_ctx_unassign(void);
 
+/*
+ * Walk the free blocks of the heap of @ctx and return the number of free
+ * bytes, including the blocks held in the size class lists, in @free_bytes
+ * and the size of the largest free block in @largest_free.
+ *
+ * The heap buffer must be mapped and not in use by another CPU.
+ */
+void buffer_alloc_ctx_free_info(const struct buffer_alloc_ctx *ctx,
+				size_t *free_bytes, size_t *largest_free);
+
 #endif /* MEMORY_ALLOC_H */
@@ -26,11 +26,20 @@
 #include <memory_alloc.h>
 #include <sizes.h>
 #include <string.h>
+#include <utils_def.h>
 
 #define MAGIC1		UL(0xFF00AA55)
 #define MAGIC2		UL(0xEE119966)
 #define MAX_BT		20
 
+/* Values of memory_header_s.alloc */
+#define BLOCK_FREE	UL(0)
+#define BLOCK_ALLOC	UL(1)
+/* Released by the caller but kept in a size class list */
+#define BLOCK_CACHED	UL(2)
+
+COMPILER_ASSERT((BUFFER_ALLOC_CLASS_STEP % MBEDTLS_MEMORY_ALIGN_MULTIPLE) == 0);
+
 #if defined(MBEDTLS_MEMORY_DEBUG)
 #error MBEDTLS_MEMORY_DEBUG is not supported by this allocator.
 #endif
@@ -89,7 +98,7 @@ static int verify_header(struct memory_header_s *hdr)
 		return 1;
 	}
 
-	if (hdr->alloc > 1UL) {
+	if (hdr->alloc > BLOCK_CACHED) {
 		return 1;
 	}
 
@@ -135,32 +144,41 @@ static int verify_chain(struct buffer_alloc_ctx *heap)
 	return 0;
 }
 
-static void *buffer_alloc_calloc_with_heap(struct buffer_alloc_ctx *heap,
-					   size_t n,
-					   size_t size)
+/*
+ * Return the size class a block of @size bytes belongs to, or
+ * BUFFER_ALLOC_CLASSES if it is too small or too large to be cached.
+ * Class i holds blocks of at least (i + 1) * BUFFER_ALLOC_CLASS_STEP bytes.
+ */
+static inline unsigned int size_class(size_t size)
 {
-	struct memory_header_s *new;
-	struct memory_header_s *cur = heap->first_free;
-	unsigned char *p;
-	void *ret;
-	size_t original_len, len;
+	size_t idx = size / BUFFER_ALLOC_CLASS_STEP;
 
-	if (heap->buf == NULL || heap->first == NULL) {
-		return NULL;
+	if ((idx == 0UL) || (idx > BUFFER_ALLOC_CLASSES)) {
+		return BUFFER_ALLOC_CLASSES;
 	}
 
-	original_len = len = n * size;
+	return (unsigned int)(idx - 1UL);
+}
 
-	if (n == 0UL || size == 0UL || len / n != size) {
-		return NULL;
-	} else if (len > (size_t)-MBEDTLS_MEMORY_ALIGN_MULTIPLE) {
-		return NULL;
-	}
+static void heap_account_alloc(struct buffer_alloc_ctx *heap,
+			       struct memory_header_s *hdr)
+{
+	struct buffer_alloc_stats *stats = &heap->stats;
 
-	if ((len % MBEDTLS_MEMORY_ALIGN_MULTIPLE) != 0) {
-		len -= len % MBEDTLS_MEMORY_ALIGN_MULTIPLE;
-		len += MBEDTLS_MEMORY_ALIGN_MULTIPLE;
+	stats->allocs++;
+	stats->cur_bytes += hdr->size + sizeof(struct memory_header_s);
+	if (stats->cur_bytes > stats->peak_bytes) {
+		stats->peak_bytes = stats->cur_bytes;
 	}
+}
+
+/* Carve a block of at least @len bytes out of the free list */
+static struct memory_header_s *heap_alloc_block(struct buffer_alloc_ctx *heap,
+						size_t len)
+{
+	struct memory_header_s *new;
+	struct memory_header_s *cur = heap->first_free;
+	unsigned char *p;
 
 	/* Find block that fits */
 	while (cur != NULL) {
@@ -174,14 +192,14 @@ static void *buffer_alloc_calloc_with_heap(struct buffer_alloc_ctx *heap,
 		return NULL;
 	}
 
-	if (cur->alloc != 0UL) {
+	if (cur->alloc != BLOCK_FREE) {
 		assert(false);
 	}
 
 	/* Found location, split block if > memory_header + 4 room left */
 	if ((cur->size - len) <
 	    (sizeof(struct memory_header_s) + MBEDTLS_MEMORY_ALIGN_MULTIPLE)) {
-		cur->alloc = 1UL;
+		cur->alloc = BLOCK_ALLOC;
 
 		/* Remove from free_list */
 		if (cur->prev_free != NULL) {
@@ -197,21 +215,14 @@ static void *buffer_alloc_calloc_with_heap(struct buffer_alloc_ctx *heap,
 		cur->prev_free = NULL;
 		cur->next_free = NULL;
 
-		if (heap->verify & MBEDTLS_MEMORY_VERIFY_ALLOC) {
-			assert(verify_chain(heap) == 0);
-		}
-
-		ret = (unsigned char *) cur + sizeof(struct memory_header_s);
-		memset(ret, 0, original_len);
-
-		return ret;
+		return cur;
 	}
 
 	p = ((unsigned char *) cur) + sizeof(struct memory_header_s) + len;
 	new = (struct memory_header_s *) p;
 
 	new->size = cur->size - len - sizeof(struct memory_header_s);
-	new->alloc = 0;
+	new->alloc = BLOCK_FREE;
 	new->prev = cur;
 	new->next = cur->next;
 	new->magic1 = MAGIC1;
@@ -234,12 +245,94 @@ static void *buffer_alloc_calloc_with_heap(struct buffer_alloc_ctx *heap,
 		new->next_free->prev_free = new;
 	}
 
-	cur->alloc = 1;
+	cur->alloc = BLOCK_ALLOC;
 	cur->size = len;
 	cur->next = new;
 	cur->prev_free = NULL;
 	cur->next_free = NULL;
 
+	return cur;
+}
+
+static void heap_release_block(struct buffer_alloc_ctx *heap,
+			       struct memory_header_s *hdr);
+
+/*
+ * Give all the blocks held in the size class lists back to the free list,
+ * so that they can be merged with their neighbours.
+ */
+static void heap_flush_classes(struct buffer_alloc_ctx *heap)
+{
+	for (unsigned int i = 0U; i < BUFFER_ALLOC_CLASSES; i++) {
+		struct memory_header_s *hdr = heap->class_free[i];
+
+		while (hdr != NULL) {
+			struct memory_header_s *next = hdr->next_free;
+
+			hdr->next_free = NULL;
+			heap_release_block(heap, hdr);
+			hdr = next;
+		}
+
+		heap->class_free[i] = NULL;
+	}
+}
+
+static void *buffer_alloc_calloc_with_heap(struct buffer_alloc_ctx *heap,
+					   size_t n,
+					   size_t size)
+{
+	struct memory_header_s *cur;
+	void *ret;
+	size_t original_len, len;
+	unsigned int idx;
+
+	if (heap->buf == NULL || heap->first == NULL) {
+		return NULL;
+	}
+
+	original_len = len = n * size;
+
+	if (n == 0UL || size == 0UL || len / n != size) {
+		return NULL;
+	} else if (len > (size_t)-BUFFER_ALLOC_CLASS_STEP) {
+		return NULL;
+	}
+
+	/*
+	 * Small requests are rounded up to their size class, so that any
+	 * block cached in that class can serve them.
+	 */
+	idx = size_class(len + BUFFER_ALLOC_CLASS_STEP - 1UL);
+	if (idx < BUFFER_ALLOC_CLASSES) {
+		len = ((size_t)idx + 1UL) * BUFFER_ALLOC_CLASS_STEP;
+		cur = heap->class_free[idx];
+		if (cur != NULL) {
+			assert(cur->alloc == BLOCK_CACHED);
+			heap->class_free[idx] = cur->next_free;
+			cur->next_free = NULL;
+			cur->alloc = BLOCK_ALLOC;
+			goto out;
+		}
+	} else if ((len % MBEDTLS_MEMORY_ALIGN_MULTIPLE) != 0) {
+		len -= len % MBEDTLS_MEMORY_ALIGN_MULTIPLE;
+		len += MBEDTLS_MEMORY_ALIGN_MULTIPLE;
+	}
+
+	cur = heap_alloc_block(heap, len);
+	if (cur == NULL) {
+		/* Blocks in the size classes may be hiding a suitable one */
+		heap_flush_classes(heap);
+		cur = heap_alloc_block(heap, len);
+		if (cur == NULL) {
+			heap->stats.alloc_failures++;
+			return NULL;
+		}
+	}
+
+out:
+	heap_account_alloc(heap, cur);
+
 	if ((heap->verify & MBEDTLS_MEMORY_VERIFY_ALLOC) != 0) {
 		assert(verify_chain(heap) == 0);
 	}
@@ -253,39 +346,33 @@ static void *buffer_alloc_calloc_with_heap(struct buffer_alloc_ctx *heap,
 void *buffer_alloc_calloc(size_t n, size_t size)
 {
 	struct buffer_alloc_ctx *heap = get_heap_ctx();
+	unsigned long start, ticks;
+	void *ret;
 
 	assert(heap);
-	return buffer_alloc_calloc_with_heap(heap, n, size);
-}
-
-static void buffer_alloc_free_with_heap(struct buffer_alloc_ctx *heap,
-					void *ptr)
-{
-	struct memory_header_s *hdr;
-	struct memory_header_s *old = NULL;
-	unsigned char *p = (unsigned char *) ptr;
 
-	if (ptr == NULL || heap->buf == NULL || heap->first == NULL) {
-		return;
-	}
+	start = read_cntpct_el0();
+	ret = buffer_alloc_calloc_with_heap(heap, n, size);
+	ticks = read_cntpct_el0() - start;
 
-	if (p < heap->buf || p >= heap->buf + heap->len) {
-		assert(0);
+	heap->stats.alloc_ticks += ticks;
+	if (ticks > heap->stats.max_alloc_ticks) {
+		heap->stats.max_alloc_ticks = ticks;
 	}
 
-	p -= sizeof(struct memory_header_s);
-	hdr = (struct memory_header_s *) p;
-
-	assert(verify_header(hdr) == 0);
+	return ret;
+}
 
-	if (hdr->alloc != 1) {
-		assert(0);
-	}
+/* Return @hdr to the free list, merging it with its free neighbours */
+static void heap_release_block(struct buffer_alloc_ctx *heap,
+			       struct memory_header_s *hdr)
+{
+	struct memory_header_s *old = NULL;
 
-	hdr->alloc = 0;
+	hdr->alloc = BLOCK_FREE;
 
 	/* Regroup with block before */
-	if (hdr->prev != NULL && hdr->prev->alloc == 0UL) {
+	if (hdr->prev != NULL && hdr->prev->alloc == BLOCK_FREE) {
 		hdr->prev->size += sizeof(struct memory_header_s) + hdr->size;
 		hdr->prev->next = hdr->next;
 		old = hdr;
@@ -299,7 +386,7 @@ static void buffer_alloc_free_with_heap(struct buffer_alloc_ctx *heap,
 	}
 
 	/* Regroup with block after */
-	if (hdr->next != NULL && hdr->next->alloc == 0UL) {
+	if (hdr->next != NULL && hdr->next->alloc == BLOCK_FREE) {
 		hdr->size += sizeof(struct memory_header_s) + hdr->next->size;
 		old = hdr->next;
 		hdr->next = hdr->next->next;
@@ -346,6 +433,48 @@ static void buffer_alloc_free_with_heap(struct buffer_alloc_ctx *heap,
 		}
 		heap->first_free = hdr;
 	}
+}
+
+static void buffer_alloc_free_with_heap(struct buffer_alloc_ctx *heap,
+					void *ptr)
+{
+	struct memory_header_s *hdr;
+	unsigned char *p = (unsigned char *) ptr;
+	unsigned int idx;
+
+	if (ptr == NULL || heap->buf == NULL || heap->first == NULL) {
+		return;
+	}
+
+	if (p < heap->buf || p >= heap->buf + heap->len) {
+		assert(0);
+	}
+
+	p -= sizeof(struct memory_header_s);
+	hdr = (struct memory_header_s *) p;
+
+	assert(verify_header(hdr) == 0);
+
+	if (hdr->alloc != BLOCK_ALLOC) {
+		assert(0);
+	}
+
+	heap->stats.frees++;
+	heap->stats.cur_bytes -= hdr->size + sizeof(struct memory_header_s);
+
+	/*
+	 * Small blocks are kept aside for the next request of the same class
+	 * rather than merged back, as MbedTLS frees and reallocates bignums
+	 * of the same few sizes over and over.
+	 */
+	idx = size_class(hdr->size);
+	if (idx < BUFFER_ALLOC_CLASSES) {
+		hdr->alloc = BLOCK_CACHED;
+		hdr->next_free = heap->class_free[idx];
+		heap->class_free[idx] = hdr;
+	} else {
+		heap_release_block(heap, hdr);
+	}
 
 	if (heap->verify & MBEDTLS_MEMORY_VERIFY_FREE) {
 		assert(verify_chain(heap));
@@ -360,6 +489,36 @@ void buffer_alloc_free(void *ptr)
 	buffer_alloc_free_with_heap(heap, ptr);
 }
 
+void buffer_alloc_ctx_free_info(const struct buffer_alloc_ctx *ctx,
+				size_t *free_bytes, size_t *largest_free)
+{
+	struct memory_header_s *hdr;
+	size_t total = 0UL;
+	size_t largest = 0UL;
+
+	assert(ctx != NULL);
+
+	for (hdr = ctx->first_free; hdr != NULL; hdr = hdr->next_free) {
+		total += hdr->size;
+		if (hdr->size > largest) {
+			largest = hdr->size;
+		}
+	}
+
+	for (unsigned int i = 0U; i < BUFFER_ALLOC_CLASSES; i++) {
+		for (hdr = ctx->class_free[i]; hdr != NULL;
+		     hdr = hdr->next_free) {
+			total += hdr->size;
+			if (hdr->size > largest) {
+				largest = hdr->size;
+			}
+		}
+	}
+
+	*free_bytes = total;
+	*largest_free = largest;
+}
+
 int buffer_alloc_ctx_assign(struct buffer_alloc_ctx *ctx)
 {
 	unsigned int cpuid = my_cpuid();
@@ -418,10 +577,14 @@ void mbedtls_memory_buffer_alloc_init(unsigned char *buf, size_t len)
 	 * This way the interface can remain the same.
 	 */
 	struct buffer_alloc_ctx *heap = get_heap_ctx();
+	struct buffer_alloc_stats stats;
 
 	assert(heap);
 
+	stats = heap->stats;
 	memset(heap, 0, sizeof(struct buffer_alloc_ctx));
+	heap->stats = stats;
+	heap->stats.cur_bytes = 0UL;
 
 	if (len < sizeof(struct memory_header_s) +
 	    MBEDTLS_MEMORY_ALIGN_MULTIPLE) {
@@ -449,7 +612,12 @@ void mbedtls_memory_buffer_alloc_init(unsigned char *buf, size_t len)
 void mbedtls_memory_buffer_alloc_free(void)
 {
 	struct buffer_alloc_ctx *heap = get_heap_ctx();
+	struct buffer_alloc_stats stats;
 
 	assert(heap);
+
+	stats = heap->stats;
 	memset(heap, 0, sizeof(struct buffer_alloc_ctx));
+	heap->stats = stats;
+	heap->stats.cur_bytes = 0UL;
 }
@@ -109,4 +109,23 @@ static inline bool atomic_bit_set_acquire_release_64(uint64_t *loc, int bit)
 	return ((val & mask) != 0UL);
 }
 
+/*
+ * Atomically replace the 64-bit value at @loc with @new_val if it is equal
+ * to @expected, with acquire semantics.
+ * Return the value read from @loc, which is @expected on success.
+ */
+static inline uint64_t atomic_cas_acquire_64(uint64_t *loc, uint64_t expected,
+					     uint64_t new_val)
+{
+	asm volatile(
+	"	casa %[val], %[new_val], %[loc]\n"
+	: [loc] "+Q" (*loc),
+	  [val] "+r" (expected)
+	: [new_val] "r" (new_val)
+	: "memory"
+	);
+
+	return expected;
+}
+
 #endif /* ATOMICS_H */
@@ -65,7 +65,41 @@ static inline void (_op ## _type)(uint64_t v)		\
 	 __asm__ (#_op " " #_type ", %0" : : "r" (v));	\
 }
 
+/*
+ * Define function for the nXS form of a TLBI instruction with register
+ * parameter (FEAT_XS), from the op1, CRm and op2 fields of its encoding.
+ * The instruction is written as SYS, as the assembler only knows the nXS
+ * forms from Armv8.7.
+ */
+#define DEFINE_TLBI_NXS_PARAM_FUNC(_type, _op1, _crm, _op2)	\
+static inline void (tlbi ## _type ## nxs)(uint64_t v)		\
+{								\
+	(void)v; /* To avoid MISRA-C:2012-2.7 warnings */ \
+	 __asm__ ("sys #" #_op1 ", c9, c" #_crm ", #" #_op2 ", %0"	\
+		  : : "r" (v));					\
+}
+
+/*
+ * Define function for a DC instruction with register parameter, from the
+ * op1, CRm and op2 fields of its encoding, for the operations which the
+ * assembler only knows from later versions of the architecture.
+ */
+#define DEFINE_DC_SYS_PARAM_FUNC(_type, _op1, _crm, _op2)	\
+static inline void (dc ## _type)(uint64_t v)			\
+{								\
+	(void)v; /* To avoid MISRA-C:2012-2.7 warnings */ \
+	 __asm__ ("sys #" #_op1 ", c7, c" #_crm ", #" #_op2 ", %0"	\
+		  : : "r" (v) : "memory");			\
+}
+
 #define dsb(scope) asm volatile("dsb " #scope : : : "memory")
 #define dmb(scope) asm volatile("dmb " #scope : : : "memory")
 
+/* DSB ISHnXS and DSB NSHnXS (FEAT_XS), encoded for the same reason */
+#define dsb_ishnxs() asm volatile(".inst 0xd5033a3f" : : : "memory")
+#define dsb_nshnxs() asm volatile(".inst 0xd503363f" : : : "memory")
+
+/* PSB CSYNC, in the hint space so that it does not require FEAT_SPE */
+#define psb_csync() asm volatile("hint #17" : : : "memory")
+
 #endif /* INSTR_HELPERS_H */
@@ -6,27 +6,117 @@
 #ifndef SPINLOCK_H
 #define SPINLOCK_H
 
-/*
- * A trivial spinlock implementation, per ARM DDI 0487D.a, section K11.3.4.
- */
+#include <stdbool.h>
 
 typedef struct {
 	unsigned int val;
 } spinlock_t;
 
+#ifdef RMM_TICKET_LOCK
+/*
+ * A ticket lock, which grants the lock in the order in which it was
+ * requested. The low halfword of @val is the ticket currently being served
+ * and the high halfword is the next ticket to hand out, so a zeroed lock
+ * is unlocked.
+ *
+ * A ticket is taken with a single LDADDA, which FEAT_LSE provides on every
+ * RME capable PE. Waiters then sleep with WFE on the owner halfword, which
+ * only the lock holder writes.
+ */
+
+/* Return true if the lock word @val is not held */
+static inline bool spinlock_val_is_free(unsigned int val)
+{
+	return (val & 0xffffU) == (val >> 16);
+}
+
+/* Return the lock word of a free lock @val once it has been taken */
+static inline unsigned int spinlock_val_locked(unsigned int val)
+{
+	return val + (1U << 16);
+}
+
 static inline void spinlock_acquire(spinlock_t *l)
 {
-	unsigned int tmp;
+	unsigned int old, tmp;
 
 	asm volatile(
+	"	prfm	pstl1strm, %[lock]\n"
+	"	ldadda	%w[inc], %w[old], %[lock]\n"
+	/* The lock is free if the ticket taken is the one being served */
+	"	eor	%w[tmp], %w[old], %w[old], ror #16\n"
+	"	cbz	%w[tmp], 2f\n"
 	"	sevl\n"
-	"	prfm	pstl1keep, %[lock]\n"
 	"1:\n"
 	"	wfe\n"
-	"	ldaxr	%w[tmp], %[lock]\n"
+	"	ldaxrh	%w[tmp], %[owner]\n"
+	"	eor	%w[tmp], %w[tmp], %w[old], lsr #16\n"
 	"	cbnz	%w[tmp], 1b\n"
-	"	stxr	%w[tmp], %w[one], %[lock]\n"
+	"2:\n"
+	: [lock] "+Q" (l->val),
+	  [owner] "+Q" (*(unsigned short *)&l->val),
+	  [old] "=&r" (old),
+	  [tmp] "=&r" (tmp)
+	: [inc] "r" (1U << 16)
+	: "memory"
+	);
+}
+
+static inline void spinlock_release(spinlock_t *l)
+{
+	unsigned int tmp;
+
+	asm volatile(
+	"	ldrh	%w[tmp], %[owner]\n"
+	"	add	%w[tmp], %w[tmp], #1\n"
+	"	stlrh	%w[tmp], %[owner]\n"
+	: [owner] "+Q" (*(unsigned short *)&l->val),
+	  [tmp] "=&r" (tmp)
+	:
+	: "memory"
+	);
+}
+#else
+/*
+ * A test-and-set spinlock, based on ARM DDI 0487D.a, section K11.3.4.
+ *
+ * The uncontended case is a single SWPA. When the lock is held, the PE
+ * waits with WFE on an exclusive load of the lock, as in the reference
+ * implementation, and retries the SWPA once the lock reads as free. The
+ * exclusive load is redone after a failed SWPA, so that the monitor is
+ * armed again before the next WFE.
+ */
+
+/* Return true if the lock word @val is not held */
+static inline bool spinlock_val_is_free(unsigned int val)
+{
+	return val == 0U;
+}
+
+/* Return the lock word of a free lock @val once it has been taken */
+static inline unsigned int spinlock_val_locked(unsigned int val)
+{
+	(void)val;
+	return 1U;
+}
+
+static inline void spinlock_acquire(spinlock_t *l)
+{
+	unsigned int tmp;
+
+	asm volatile(
+	"	prfm	pstl1strm, %[lock]\n"
+	"	swpa	%w[one], %w[tmp], %[lock]\n"
+	"	cbz	%w[tmp], 3f\n"
+	"	b	2f\n"
+	"1:\n"
+	"	wfe\n"
+	"2:\n"
+	"	ldaxr	%w[tmp], %[lock]\n"
 	"	cbnz	%w[tmp], 1b\n"
+	"	swpa	%w[one], %w[tmp], %[lock]\n"
+	"	cbnz	%w[tmp], 2b\n"
+	"3:\n"
 	: [lock] "+Q" (l->val),
 	  [tmp] "=&r" (tmp)
 	: [one] "r" (1)
@@ -43,5 +133,6 @@ static inline void spinlock_release(spinlock_t *l)
 	: "memory"
 	);
 }
+#endif /* RMM_TICKET_LOCK */
 
 #endif /* SPINLOCK_H */
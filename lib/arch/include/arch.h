@@ -15,11 +15,39 @@
 #define EL1_VIRT_TIMER_PPI	UL(27)
 #define EL1_PHYS_TIMER_PPI	UL(30)
 
+/* GIC virtual CPU interface maintenance interrupt ID */
+#define GIC_MAINT_PPI		UL(25)
+
 /* Counter-timer Physical Offset register */
 #define CNTPOFF_EL2		S3_4_C14_C0_6
 
-/* MPAM0 Register */
+/* MPAM Registers */
 #define MPAM0_EL1		S3_0_C10_C5_1
+#define MPAM1_EL12		S3_5_C10_C5_0
+#define MPAMIDR_EL1		S3_0_C10_C4_4
+#define MPAM2_EL2		S3_4_C10_C5_0
+#define MPAMHCR_EL2		S3_4_C10_C4_0
+
+/* Memory Encryption Contexts registers */
+#define ID_AA64MMFR3_EL1	S3_0_C0_C7_3
+#define MECIDR_EL2		S3_4_C10_C8_7
+#define MECID_P0_EL2		S3_4_C10_C8_0
+#define MECID_A0_EL2		S3_4_C10_C8_1
+#define MECID_P1_EL2		S3_4_C10_C8_2
+#define MECID_A1_EL2		S3_4_C10_C8_3
+#define VMECID_P_EL2		S3_4_C10_C9_0
+#define VMECID_A_EL2		S3_4_C10_C9_1
+
+/* Statistical Profiling Extension registers */
+#define PMSCR_EL12		S3_5_C9_C9_0
+#define PMSICR_EL1		S3_0_C9_C9_2
+#define PMSIRR_EL1		S3_0_C9_C9_3
+#define PMSFCR_EL1		S3_0_C9_C9_4
+#define PMSEVFR_EL1		S3_0_C9_C9_5
+#define PMSLATFR_EL1		S3_0_C9_C9_6
+#define PMBLIMITR_EL1		S3_0_C9_C10_0
+#define PMBPTR_EL1		S3_0_C9_C10_1
+#define PMBSR_EL1		S3_0_C9_C10_3
 
 /* Interrupt Controller registers */
 #define ICC_HPPIR1_EL1		S3_0_C12_C12_2
@@ -61,6 +89,7 @@
 #define ICH_HCR_EL2		S3_4_C12_C11_0
 #define ICH_VTR_EL2		S3_4_C12_C11_1
 #define ICH_MISR_EL2		S3_4_C12_C11_2
+#define ICH_ELRSR_EL2		S3_4_C12_C11_5
 #define ICH_VMCR_EL2		S3_4_C12_C11_7
 
 /* RNDR definition */
@@ -71,6 +100,11 @@
 #define CTYPE_SHIFT(n)		U(3 * ((n) - 1))
 #define CLIDR_FIELD_WIDTH	U(3)
 
+/* DCZID_EL0 definitions */
+#define DCZID_EL0_BS_SHIFT	U(0)
+#define DCZID_EL0_BS_WIDTH	U(4)
+#define DCZID_EL0_DZP_BIT	U(4)
+
 /* CSSELR definitions */
 #define LEVEL_SHIFT		U(1)
 
@@ -420,9 +454,28 @@
 #define ID_AA64PFR0_EL1_SVE_WIDTH	UL(4)
 #define ID_AA64PFR0_EL1_SVE_MASK	UL(0xf)
 
+#define ID_AA64PFR0_EL1_MPAM_SHIFT	UL(40)
+#define ID_AA64PFR0_EL1_MPAM_WIDTH	UL(4)
+
 #define ID_AA64PFR0_EL1_AMU_SHIFT	UL(44)
 #define ID_AA64PFR0_EL1_AMU_WIDTH	4
 
+/* ID_AA64PFR1_EL1 definitions */
+#define ID_AA64PFR1_EL1_MPAM_FRAC_SHIFT	UL(16)
+#define ID_AA64PFR1_EL1_MPAM_FRAC_WIDTH	UL(4)
+
+/* ID_AA64DFR0_EL1 definitions */
+#define ID_AA64DFR0_EL1_PMUVER_SHIFT	UL(8)
+#define ID_AA64DFR0_EL1_PMUVER_WIDTH	UL(4)
+
+#define ID_AA64DFR0_EL1_PMUVER_PMUV3	UL(1)
+#define ID_AA64DFR0_EL1_PMUVER_PMUV3P1	UL(4)
+#define ID_AA64DFR0_EL1_PMUVER_PMUV3P5	UL(6)
+#define ID_AA64DFR0_EL1_PMUVER_IMPDEF	UL(0xf)
+
+#define ID_AA64DFR0_EL1_PMSVER_SHIFT	UL(32)
+#define ID_AA64DFR0_EL1_PMSVER_WIDTH	UL(4)
+
 /* ID_AA64MMFR0_EL1 definitions */
 #define ID_AA64MMFR0_EL1_PARANGE_SHIFT	U(0)
 #define ID_AA64MMFR0_EL1_PARANGE_MASK	ULL(0xf)
@@ -481,18 +534,50 @@
 #define ID_AA64ISAR0_RNDR_SHIFT			UL(60)
 #define ID_AA64ISAR0_RNDR_MASK			UL(0xF)
 
+/* TLB range maintenance instructions definitions */
+#define ID_AA64ISAR0_TLB_SHIFT			UL(56)
+#define ID_AA64ISAR0_TLB_MASK			UL(0xF)
+#define ID_AA64ISAR0_TLB_RANGE			UL(0x2)
+
+/* SHA2 instructions definitions */
+#define ID_AA64ISAR0_SHA2_SHIFT			UL(12)
+#define ID_AA64ISAR0_SHA2_MASK			UL(0xF)
+#define ID_AA64ISAR0_SHA2_SHA256		UL(0x1)
+#define ID_AA64ISAR0_SHA2_SHA512		UL(0x2)
+
+/* ID_AA64ISAR1_EL1 definitions */
+#define ID_AA64ISAR1_XS_SHIFT			UL(56)
+#define ID_AA64ISAR1_XS_MASK			UL(0xF)
+
+#define ID_AA64ISAR1_API_SHIFT			UL(8)
+#define ID_AA64ISAR1_API_WIDTH			UL(4)
+
+#define ID_AA64ISAR1_APA_SHIFT			UL(4)
+#define ID_AA64ISAR1_APA_WIDTH			UL(4)
+
 /* ID_AA64MMFR1_EL1 definitions */
 #define ID_AA64MMFR1_EL1_VMIDBits_SHIFT		UL(4)
 #define ID_AA64MMFR1_EL1_VMIDBits_MASK		UL(0xf)
 #define ID_AA64MMFR1_EL1_VMIDBits_8		UL(0)
 #define ID_AA64MMFR1_EL1_VMIDBits_16		UL(2)
 
+#define ID_AA64MMFR1_EL1_HAFDBS_SHIFT		UL(0)
+#define ID_AA64MMFR1_EL1_HAFDBS_MASK		UL(0xf)
+#define ID_AA64MMFR1_EL1_HAFDBS_AF		UL(1)
+#define ID_AA64MMFR1_EL1_HAFDBS_AF_DBM		UL(2)
+
 /* HPFAR_EL2 definitions */
 #define HPFAR_EL2_FIPA_SHIFT		4
 #define HPFAR_EL2_FIPA_WIDTH		40
 #define HPFAR_EL2_FIPA_MASK		MASK(HPFAR_EL2_FIPA)
 #define HPFAR_EL2_FIPA_OFFSET		8
 
+/*
+ * HPFAR_EL2.FIPA holds the faulting IPA in units of 4KB, whatever the
+ * translation granule, so the rest of it comes from FAR_EL2.
+ */
+#define HPFAR_EL2_FIPA_FAR_MASK		UL(0xFFF)
+
 /* SPSR definitions */
 #define SPSR_EL2_MODE_SHIFT		0
 #define SPSR_EL2_MODE_WIDTH		4
@@ -583,6 +668,12 @@
 #define VTCR_SL0_4K_L0		INPLACE(VTCR_SL0, 2)
 #define VTCR_SL0_4K_L3		INPLACE(VTCR_SL0, 3)
 
+/* With the 16KB and 64KB granules, level 0 is only valid for the former */
+#define VTCR_SL0_16K_64K_L3	INPLACE(VTCR_SL0, 0)
+#define VTCR_SL0_16K_64K_L2	INPLACE(VTCR_SL0, 1)
+#define VTCR_SL0_16K_64K_L1	INPLACE(VTCR_SL0, 2)
+#define VTCR_SL0_16K_L0		INPLACE(VTCR_SL0, 3)
+
 #define VTCR_IRGN0_SHIFT	8
 #define VTCR_IRGN0_WIDTH	2
 #define VTCR_IRGN0_WBRAWA	INPLACE(VTCR_IRGN0, 1)
@@ -598,12 +689,24 @@
 #define VTCR_TG0_SHIFT		14
 #define VTCR_TG0_WIDTH		2
 #define VTCR_TG0_4K		INPLACE(VTCR_TG0, 0)
+#define VTCR_TG0_64K		INPLACE(VTCR_TG0, 1)
+#define VTCR_TG0_16K		INPLACE(VTCR_TG0, 2)
+
+#if GRANULE_SIZE == 4096U
+#define VTCR_TG0_GRANULE	VTCR_TG0_4K
+#elif GRANULE_SIZE == 16384U
+#define VTCR_TG0_GRANULE	VTCR_TG0_16K
+#else
+#define VTCR_TG0_GRANULE	VTCR_TG0_64K
+#endif
 
 #define VTCR_PS_SHIFT		16
 #define VTCR_PS_WIDTH		3
 #define VTCR_PS_40		INPLACE(VTCR_PS, 2)
 
 #define VTCR_VS			(UL(1) << 19)
+#define VTCR_HA			(UL(1) << 21)
+#define VTCR_HD			(UL(1) << 22)
 #define VTCR_NSA		(UL(1) << 30)
 #define VTCR_RES1		(UL(1) << 31)
 
@@ -611,7 +714,7 @@
 	VTCR_IRGN0_WBRAWA | /* PTW inner cache attr. is WB RAWA*/ \
 	VTCR_ORGN0_WBRAWA | /* PTW outer cache attr. is WB RAWA*/ \
 	VTCR_SH0_IS       | /* PTW shareability attr. is Outer Sharable*/\
-	VTCR_TG0_4K       | /* 4K granule size in non-secure PT*/ \
+	VTCR_TG0_GRANULE  | /* S2 granule size is GRANULE_SIZE */ \
 	VTCR_PS_40        | /* size(PA) = 40 */   \
 	/* VS = 0              size(VMID) = 8 */ \
 	/* NSW = 0             non-secure s2 is made of secure pages*/ \
@@ -621,11 +724,15 @@
 
 
 /* SCTLR definitions */
+#define SCTLR_EL1_EnIA		(UL(1) << 31)
+#define SCTLR_EL1_EnIB		(UL(1) << 30)
+#define SCTLR_EL1_EnDA		(UL(1) << 27)
 #define SCTLR_EL1_EE		(UL(1) << 25)
 #define SCTLR_EL1_SPAN		(UL(1) << 23)
 #define SCTLR_EL1_EIS		(UL(1) << 22)
 #define SCTLR_EL1_nTWE		(UL(1) << 18)
 #define SCTLR_EL1_nTWI		(UL(1) << 16)
+#define SCTLR_EL1_EnDB		(UL(1) << 13)
 #define SCTLR_EL1_EOS		(UL(1) << 11)
 #define SCTLR_EL1_nAA		(UL(1) << 6)
 #define SCTLR_EL1_CP15BEN	(UL(1) << 5)
@@ -637,9 +744,28 @@
 	SCTLR_EL1_SA0 | SCTLR_EL1_SA)
 
 /* PMCR_EL0 Definitions */
+#define PMCR_EL0_E_BIT			(UL(1) << 0)
 #define PMCR_EL0_LC_SHIFT		6
 #define PMCR_EL0_LC_WIDTH		1
 #define PMCR_EL0_LC_BIT			INPLACE(PMCR_EL0_LC, 1)
+#define PMCR_EL0_N_SHIFT		11
+#define PMCR_EL0_N_WIDTH		5
+
+/* Bit of the cycle counter in PMCNTENSET_EL0, PMINTENSET_EL1 and PMOVSSET_EL0 */
+#define PMU_CYCLE_CTR_BIT		(UL(1) << 31)
+
+/* PMEVTYPER<n>_EL0 definitions */
+#define PMEVTYPER_EL0_P_BIT		(UL(1) << 31)
+#define PMEVTYPER_EL0_U_BIT		(UL(1) << 30)
+#define PMEVTYPER_EL0_NSH_BIT		(UL(1) << 27)
+#define PMEVTYPER_EL0_RLH_BIT		(UL(1) << 20)
+
+/* Common architectural and microarchitectural PMU events */
+#define PMU_EVENT_L1D_CACHE_REFILL	UL(0x03)
+#define PMU_EVENT_BR_MIS_PRED		UL(0x10)
+#define PMU_EVENT_CPU_CYCLES		UL(0x11)
+#define PMU_EVENT_L2D_CACHE_REFILL	UL(0x17)
+#define PMU_EVENT_DTLB_WALK		UL(0x34)
 
 #define PMCR_EL0_RES1			PMCR_EL0_LC_BIT
 
@@ -742,6 +868,7 @@
 #define MDCR_EL2_TPMS		(U(1) << 14)
 #define MDCR_EL2_E2PB(x)	((x) << 12)
 #define MDCR_EL2_E2PB_EL1	U(0x3)
+#define MDCR_EL2_E2PB_EL1_TRAP	U(0x2)
 #define MDCR_EL2_TDRA_BIT	(U(1) << 11)
 #define MDCR_EL2_TDOSA_BIT	(U(1) << 10)
 #define MDCR_EL2_TDA_BIT	(U(1) << 9)
@@ -749,9 +876,20 @@
 #define MDCR_EL2_HPME_BIT	(U(1) << 7)
 #define MDCR_EL2_TPM_BIT	(U(1) << 6)
 #define MDCR_EL2_TPMCR_BIT	(U(1) << 5)
+#define MDCR_EL2_HPMN_SHIFT	U(0)
+#define MDCR_EL2_HPMN_WIDTH	U(5)
 #define MDCR_EL2_INIT		(MDCR_EL2_TPMCR_BIT \
 				| MDCR_EL2_TPM_BIT \
-				| MDCR_EL2_TDA_BIT)
+				| MDCR_EL2_TDA_BIT \
+				| MDCR_EL2_TPMS)
+
+/*
+ * MDCR_EL2 of a Realm with SPE: the Realm programs the sampling controls,
+ * and its accesses to the Profiling Buffer registers are trapped so that
+ * RMM checks the buffer before it is enabled.
+ */
+#define MDCR_EL2_INIT_SPE	((MDCR_EL2_INIT & ~MDCR_EL2_TPMS) | \
+				 MDCR_EL2_E2PB(MDCR_EL2_E2PB_EL1_TRAP))
 
 /* MPIDR definitions */
 #define MPIDR_EL1_AFF_MASK	0xFF
@@ -816,11 +954,55 @@
 				 ICC_SRE_EL2_DFB | ICC_SRE_EL2_SRE)
 
 /* MPAM definitions */
-#define MPAM2_EL2_INIT		0x0
+#define MPAM2_EL2_TRAPMPAM1EL1	(UL(1) << 48)
+#define MPAM2_EL2_TRAPMPAM0EL1	(UL(1) << 49)
+
+/*
+ * RMM uses the default PARTID and PMG at EL2. The Realms cannot access
+ * MPAM0_EL1 and MPAM1_EL1, which RMM programs with the values chosen by
+ * the Host on every REC entry.
+ */
+#define MPAM2_EL2_INIT		(MPAM2_EL2_TRAPMPAM1EL1 | \
+				 MPAM2_EL2_TRAPMPAM0EL1)
 #define MPAMHCR_EL2_INIT	0x0
 
+/* Fields of MPAM0_EL1 and MPAM1_EL1 */
+#define MPAM_EL1_PARTID_I_SHIFT	0
+#define MPAM_EL1_PARTID_I_WIDTH	16
+#define MPAM_EL1_PARTID_D_SHIFT	16
+#define MPAM_EL1_PARTID_D_WIDTH	16
+#define MPAM_EL1_PMG_I_SHIFT	32
+#define MPAM_EL1_PMG_I_WIDTH	8
+#define MPAM_EL1_PMG_D_SHIFT	40
+#define MPAM_EL1_PMG_D_WIDTH	8
+
+/* MPAMIDR_EL1 definitions */
+#define MPAMIDR_EL1_PARTID_MAX_SHIFT	0
+#define MPAMIDR_EL1_PARTID_MAX_WIDTH	16
+#define MPAMIDR_EL1_PMG_MAX_SHIFT	32
+#define MPAMIDR_EL1_PMG_MAX_WIDTH	8
+
 #define PMSCR_EL2_INIT		0x0
 
+/* PMBLIMITR_EL1 definitions */
+#define PMBLIMITR_EL1_E_BIT		(UL(1) << 0)
+#define PMBLIMITR_EL1_LIMIT_SHIFT	12
+#define PMBLIMITR_EL1_LIMIT_WIDTH	52
+
+/* PMBSR_EL1 definitions */
+#define PMBSR_EL1_S_BIT			(UL(1) << 17)
+#define PMBSR_EL1_EC_SHIFT		26
+#define PMBSR_EL1_EC_WIDTH		6
+#define PMBSR_EL1_EC_FAULT_S2		UL(0x25)
+#define PMBSR_EL1_FSC_SHIFT		0
+#define PMBSR_EL1_FSC_WIDTH		6
+#define PMBSR_EL1_FSC_PERM_L3		UL(0xf)
+
+/* PAR_EL1 definitions */
+#define PAR_EL1_F_BIT			(UL(1) << 0)
+#define PAR_EL1_PA_SHIFT		12
+#define PAR_EL1_PA_WIDTH		40
+
 #define SYSREG_ESR(op0, op1, crn, crm, op2) \
 		(((op0) << ESR_EL2_SYSREG_TRAP_OP0_SHIFT) | \
 		 ((op1) << ESR_EL2_SYSREG_TRAP_OP1_SHIFT) | \
@@ -855,6 +1037,13 @@
 #define ESR_EL2_SYSREG_ID_AA64ISAR1_API_SHIFT	8
 #define ESR_EL2_SYSREG_ID_AA64ISAR1_APA_SHIFT	4
 
+/*
+ * The pointer authentication keys are the registers of op0 3, op1 0, CRn 2
+ * and CRm 1 to 3, while those of CRm 0 are never trapped.
+ */
+#define ESR_EL2_SYSREG_PAUTH_KEY_MASK		SYSREG_ESR(3, 7, 15, 12, 0)
+#define ESR_EL2_SYSREG_PAUTH_KEY		SYSREG_ESR(3, 0, 2, 0, 0)
+
 #define ESR_EL2_SYSREG_TIMERS_MASK		SYSREG_ESR(3, 3, 15, 12, 0)
 #define ESR_EL2_SYSREG_TIMERS			SYSREG_ESR(3, 3, 14, 0, 0)
 
@@ -867,6 +1056,28 @@
 
 #define ESR_EL2_SYSREG_ICC_PMR_EL1		SYSREG_ESR(3, 0, 4, 6, 0)
 
+/*
+ * SPE Profiling Buffer registers encoding mask, for the registers from
+ * PMBLIMITR_EL1 (3, 0, 9, 10, 0) to PMBIDR_EL1 (3, 0, 9, 10, 7).
+ */
+#define ESR_EL2_SYSREG_PMB_MASK			SYSREG_ESR(3, 7, 15, 15, 0)
+#define ESR_EL2_SYSREG_PMB			SYSREG_ESR(3, 0, 9, 10, 0)
+
+#define ESR_EL2_SYSREG_PMBLIMITR_EL1		SYSREG_ESR(3, 0, 9, 10, 0)
+#define ESR_EL2_SYSREG_PMBPTR_EL1		SYSREG_ESR(3, 0, 9, 10, 1)
+#define ESR_EL2_SYSREG_PMBSR_EL1		SYSREG_ESR(3, 0, 9, 10, 3)
+
+/*
+ * PMU system registers encoding masks: PMCR_EL0 to PMMIR_EL1, in the range
+ * (3, x, 9, 12, 0) to (3, x, 9, 15, 7), and PMEVCNTR<n>_EL0, PMEVTYPER<n>_EL0
+ * and PMCCFILTR_EL0, in the range (3, 3, 14, 8, 0) to (3, 3, 14, 15, 7).
+ */
+#define ESR_EL2_SYSREG_PMU_MASK			SYSREG_ESR(3, 0, 15, 12, 0)
+#define ESR_EL2_SYSREG_PMU			SYSREG_ESR(3, 0, 9, 12, 0)
+
+#define ESR_EL2_SYSREG_PMU_EV_MASK		SYSREG_ESR(3, 7, 15, 8, 0)
+#define ESR_EL2_SYSREG_PMU_EV			SYSREG_ESR(3, 3, 14, 8, 0)
+
 /*
  * GIC system registers encoding mask for registers from
  * ICC_IAR0_EL1(3, 0, 12, 8, 0) to ICC_IGRPEN1_EL1(3, 0, 12, 12, 7).
@@ -891,6 +1102,28 @@
 #define ICC_HPPIR1_EL1_INTID_WIDTH	24
 #define ICC_HPPIR1_EL1_INTID_MASK	MASK(ICC_HPPIR1_EL1_INTID)
 
+/* ICC_SGI1R_EL1 */
+#define ICC_SGI1R_EL1_TARGETS_SHIFT	0
+#define ICC_SGI1R_EL1_TARGETS_WIDTH	16
+
+#define ICC_SGI1R_EL1_AFF1_SHIFT	16
+#define ICC_SGI1R_EL1_AFF1_WIDTH	8
+
+#define ICC_SGI1R_EL1_INTID_SHIFT	24
+#define ICC_SGI1R_EL1_INTID_WIDTH	4
+
+#define ICC_SGI1R_EL1_AFF2_SHIFT	32
+#define ICC_SGI1R_EL1_AFF2_WIDTH	8
+
+#define ICC_SGI1R_EL1_IRM_SHIFT		40
+#define ICC_SGI1R_EL1_IRM_BIT		INPLACE(ICC_SGI1R_EL1_IRM, UL(1))
+
+#define ICC_SGI1R_EL1_RS_SHIFT		44
+#define ICC_SGI1R_EL1_RS_WIDTH		4
+
+#define ICC_SGI1R_EL1_AFF3_SHIFT	48
+#define ICC_SGI1R_EL1_AFF3_WIDTH	8
+
 #define CNTHCTL_EL2_EL0PCTEN	(UL(1) << UL(0))
 #define CNTHCTL_EL2_EL0VCTEN	(UL(1) << UL(1))
 #define CNTHCTL_EL2_EL1PCTEN	(UL(1) << 10)
@@ -918,13 +1151,92 @@
 #define TLBI_ADDR_MASK		U(0x0FFFFFFFFFFF)
 #define TLBI_ADDR(x)		(((x) >> TLBI_ADDR_SHIFT) & TLBI_ADDR_MASK)
 
+/*
+ * Translation table level hint for TLBI by address operations (FEAT_TTL).
+ * Bits [47:44] of the operand encode the translation granule (bits [3:2])
+ * and the level holding the leaf entry (bits [1:0]). A value of zero means
+ * that no hint is provided.
+ */
+#define TLBI_TTL_SHIFT		U(44)
+#define TLBI_TTL_TG_4K		UL(0x4)
+#define TLBI_TTL_TG_16K		UL(0x8)
+#define TLBI_TTL_TG_64K		UL(0xC)
+
+#if GRANULE_SIZE == 4096U
+#define TLBI_TTL_TG		TLBI_TTL_TG_4K
+#elif GRANULE_SIZE == 16384U
+#define TLBI_TTL_TG		TLBI_TTL_TG_16K
+#else
+#define TLBI_TTL_TG		TLBI_TTL_TG_64K
+#endif
+
+#define TLBI_TTL(level)		((TLBI_TTL_TG |				\
+				  ((unsigned long)(level) & UL(3)))	\
+							<< TLBI_TTL_SHIFT)
+
+/*
+ * Operand fields for TLBI by address range operations (FEAT_TLBIRANGE).
+ * The range covers (NUM + 1) * 2^((5 * SCALE) + 1) translation granules
+ * starting at BaseADDR.
+ */
+#define TLBIR_TG_SHIFT		U(46)
+#define TLBIR_TG_4K		UL(0x1)
+#define TLBIR_TG_16K		UL(0x2)
+#define TLBIR_TG_64K		UL(0x3)
+#define TLBIR_SCALE_SHIFT	U(44)
+#define TLBIR_SCALE_MAX		U(3)
+#define TLBIR_NUM_SHIFT		U(39)
+#define TLBIR_NUM_MAX		U(31)
+#define TLBIR_TTL_SHIFT		U(37)
+#define TLBIR_BADDR_MASK	UL(0x1FFFFFFFFF)
+
+#if GRANULE_SIZE == 4096U
+#define TLBIR_TG		TLBIR_TG_4K
+#elif GRANULE_SIZE == 16384U
+#define TLBIR_TG		TLBIR_TG_16K
+#else
+#define TLBIR_TG		TLBIR_TG_64K
+#endif
+
+/* Number of granules covered by a single unit of a given range SCALE */
+#define TLBIR_SCALE_GRANULES(scale)	(UL(1) << ((5U * (scale)) + 1U))
+
+#define TLBIR_ADDR(x, num, scale, level)				\
+	((TLBIR_TG << TLBIR_TG_SHIFT)				|	\
+	 ((unsigned long)(scale) << TLBIR_SCALE_SHIFT)		|	\
+	 ((unsigned long)(num) << TLBIR_NUM_SHIFT)		|	\
+	 (((unsigned long)(level) & UL(3)) << TLBIR_TTL_SHIFT)	|	\
+	 (((x) >> TLBI_ADDR_SHIFT) & TLBIR_BADDR_MASK))
+
 /* ID_AA64MMFR2_EL1 definitions */
 #define ID_AA64MMFR2_EL1_ST_SHIFT	U(28)
 #define ID_AA64MMFR2_EL1_ST_MASK	ULL(0xf)
 
+#define ID_AA64MMFR2_EL1_TTL_SHIFT	U(48)
+#define ID_AA64MMFR2_EL1_TTL_MASK	ULL(0xf)
+
 #define ID_AA64MMFR2_EL1_CNP_SHIFT	U(0)
 #define ID_AA64MMFR2_EL1_CNP_MASK	ULL(0xf)
 
+/* ID_AA64MMFR3_EL1 definitions */
+#define ID_AA64MMFR3_EL1_MEC_SHIFT	U(28)
+#define ID_AA64MMFR3_EL1_MEC_MASK	ULL(0xf)
+
+/* CTR_EL0 definitions */
+#define CTR_EL0_DMINLINE_SHIFT		U(16)
+#define CTR_EL0_DMINLINE_WIDTH		U(4)
+
+/* MECIDR_EL2 definitions */
+#define MECIDR_EL2_MECIDWIDTHM1_SHIFT	U(0)
+#define MECIDR_EL2_MECIDWIDTHM1_WIDTH	U(4)
+
+/*
+ * AMEC bit of the stage 1 page descriptors of the EL2 and EL2&0 translation
+ * regimes (FEAT_MEC): the access uses the alternate MECID, MECID_A0_EL2 or
+ * MECID_A1_EL2, instead of the primary one.
+ */
+#define DESC_AMEC_BIT			(ULL(1) << 63)
+
 /* Custom defined values to indicate the vector offset to exception handlers */
 #define ARM_EXCEPTION_SYNC_LEL		0
 #define ARM_EXCEPTION_IRQ_LEL		1
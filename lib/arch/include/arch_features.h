@@ -36,6 +36,114 @@ static inline bool is_feat_rng_present(void)
 		ID_AA64ISAR0_RNDR_MASK) != 0UL;
 }
 
+/*
+ * Check if FEAT_TLBIRANGE is implemented
+ * ID_AA64ISAR0_EL1.TLB, bits [59:56]:
+ * 0b0010 Outer Shareable and TLB range maintenance instructions are
+ *	  implemented.
+ */
+static inline bool is_feat_tlbirange_present(void)
+{
+	return (((read_ID_AA64ISAR0_EL1() >> ID_AA64ISAR0_TLB_SHIFT) &
+		ID_AA64ISAR0_TLB_MASK) == ID_AA64ISAR0_TLB_RANGE);
+}
+
+/*
+ * Check if FEAT_SHA256 is implemented
+ * ID_AA64ISAR0_EL1.SHA2, bits [15:12]:
+ * 0b0001 SHA256H, SHA256H2, SHA256SU0 and SHA256SU1 instructions
+ *	  implemented.
+ * 0b0010 As 0b0001, and SHA512H, SHA512H2, SHA512SU0 and SHA512SU1
+ *	  instructions implemented.
+ */
+static inline bool is_feat_sha256_present(void)
+{
+	return (((read_ID_AA64ISAR0_EL1() >> ID_AA64ISAR0_SHA2_SHIFT) &
+		ID_AA64ISAR0_SHA2_MASK) >= ID_AA64ISAR0_SHA2_SHA256);
+}
+
+/*
+ * Check if FEAT_SHA512 is implemented
+ */
+static inline bool is_feat_sha512_present(void)
+{
+	return (((read_ID_AA64ISAR0_EL1() >> ID_AA64ISAR0_SHA2_SHIFT) &
+		ID_AA64ISAR0_SHA2_MASK) >= ID_AA64ISAR0_SHA2_SHA512);
+}
+
+/*
+ * Check if FEAT_TTL is implemented
+ * ID_AA64MMFR2_EL1.TTL, bits [51:48]:
+ * 0b0001 TLB maintenance instructions by address have bits [47:44] holding
+ *	  the TTL field.
+ */
+static inline bool is_feat_ttl_present(void)
+{
+	return ((read_id_aa64mmfr2_el1() >> ID_AA64MMFR2_EL1_TTL_SHIFT) &
+		ID_AA64MMFR2_EL1_TTL_MASK) == 1U;
+}
+
+/*
+ * Return the version of the Performance Monitors Extension
+ * ID_AA64DFR0_EL1.PMUVer, bits [11:8]:
+ * 0b0000 PMU not implemented.
+ * 0b0001 PMUv3 implemented, with later versions in increasing values.
+ * 0b1111 IMPLEMENTATION DEFINED form of performance monitors.
+ */
+static inline unsigned long feat_pmu_version(void)
+{
+	return EXTRACT(ID_AA64DFR0_EL1_PMUVER, read_ID_AA64DFR0_EL1());
+}
+
+/*
+ * Check if FEAT_PMUv3 is implemented
+ */
+static inline bool is_feat_pmuv3_present(void)
+{
+	unsigned long pmuver = feat_pmu_version();
+
+	return (pmuver >= ID_AA64DFR0_EL1_PMUVER_PMUV3) &&
+	       (pmuver != ID_AA64DFR0_EL1_PMUVER_IMPDEF);
+}
+
+/*
+ * Check if FEAT_PAuth is implemented
+ * ID_AA64ISAR1_EL1.API, bits [11:8] and ID_AA64ISAR1_EL1.APA, bits [7:4]:
+ * 0b0000 Address authentication with the respective algorithm
+ *	  not implemented.
+ */
+static inline bool is_feat_pauth_present(void)
+{
+	return (EXTRACT(ID_AA64ISAR1_API, read_ID_AA64ISAR1_EL1()) != 0UL) ||
+	       (EXTRACT(ID_AA64ISAR1_APA, read_ID_AA64ISAR1_EL1()) != 0UL);
+}
+
+/*
+ * Check if FEAT_SPE is implemented
+ * ID_AA64DFR0_EL1.PMSVer, bits [35:32]:
+ * 0b0000 SPE not implemented.
+ * 0b0001 FEAT_SPE implemented, with later versions in increasing values.
+ */
+static inline bool is_feat_spe_present(void)
+{
+	return EXTRACT(ID_AA64DFR0_EL1_PMSVER, read_ID_AA64DFR0_EL1()) != 0UL;
+}
+
+/*
+ * Check if FEAT_HAFDBS is implemented with the hardware management of both
+ * the Access flag and the dirty state.
+ * ID_AA64MMFR1_EL1.HAFDBS, bits [3:0]:
+ * 0b0000 Not supported.
+ * 0b0001 Access flag only.
+ * 0b0010 Access flag and dirty state.
+ */
+static inline bool is_feat_hafdbs_present(void)
+{
+	return (((read_id_aa64mmfr1_el1() >> ID_AA64MMFR1_EL1_HAFDBS_SHIFT) &
+		ID_AA64MMFR1_EL1_HAFDBS_MASK) >=
+		ID_AA64MMFR1_EL1_HAFDBS_AF_DBM);
+}
+
 /*
  * Check if FEAT_VMID16 is implemented
  * ID_AA64MMFR1_EL1.VMIDBits, bits [7:4]:
@@ -64,6 +172,29 @@ static inline bool is_feat_lpa2_4k_present(void)
 		ID_AA64MMFR0_EL1_TGRAN4_2_LPA2));
 }
 
+/*
+ * Check if FEAT_XS is implemented
+ * ID_AA64ISAR1_EL1.XS, bits [59:56]:
+ * 0b0001 The XS attribute, the TLBI and DSB instructions with the nXS
+ *	  qualifier, and the HCRX_EL2.{FGTnXS, FnXS} fields are supported.
+ */
+static inline bool is_feat_xs_present(void)
+{
+	return (((read_ID_AA64ISAR1_EL1() >> ID_AA64ISAR1_XS_SHIFT) &
+		ID_AA64ISAR1_XS_MASK) == 1UL);
+}
+
+/*
+ * Check if FEAT_MEC is implemented
+ * ID_AA64MMFR3_EL1.MEC, bits [31:28]:
+ * 0b0001 Memory Encryption Contexts are implemented.
+ */
+static inline bool is_feat_mec_present(void)
+{
+	return ((read_id_aa64mmfr3_el1() >> ID_AA64MMFR3_EL1_MEC_SHIFT) &
+		ID_AA64MMFR3_EL1_MEC_MASK) == 1U;
+}
+
 unsigned int arch_feat_get_pa_width(void);
 
 #endif /* ARCH_FEATURES_H */
@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef BOOT_PHASE_H
+#define BOOT_PHASE_H
+
+#include <stdbool.h>
+
+/*
+ * Phases of the cold boot of RMM which are timed with CNTPCT_EL0. The
+ * attestation phases are only run on the first use of attestation.
+ *
+ * The values are those of the RMI_BOOT_PHASE_* indices of RMI_RMI_STATS.
+ */
+enum boot_phase {
+	BOOT_PHASE_EL3_IFC,
+	BOOT_PHASE_XLAT,
+	BOOT_PHASE_GRANULES,
+	BOOT_PHASE_SLOT_BUF,
+	BOOT_PHASE_PRNG,
+	BOOT_PHASE_ATTEST_KEY,
+	BOOT_PHASE_PLAT_TOKEN,
+	BOOT_PHASE_NR
+};
+
+/*
+ * Record the start and the end of @phase. A phase is only recorded once,
+ * by the first CPU to run it, so the warm boot of the other CPUs does not
+ * overwrite the timestamps of the cold boot.
+ */
+void boot_phase_start(enum boot_phase phase);
+void boot_phase_end(enum boot_phase phase);
+
+/*
+ * Get the CNTPCT_EL0 ticks spent in @phase and the CNTPCT_EL0 value when
+ * it started. Returns false if the phase has not completed yet.
+ */
+bool boot_phase_get(enum boot_phase phase, unsigned long *ticks,
+		    unsigned long *start);
+
+#endif /* BOOT_PHASE_H */
@@ -66,6 +66,27 @@ static inline unsigned long access_mask(unsigned long esr)
 	}
 }
 
+/*
+ * Return @val as loaded to the transfer register by the data access of @esr,
+ * sign-extended if the access requires it.
+ */
+static inline unsigned long esr_load_value(unsigned long esr, unsigned long val)
+{
+	val &= access_mask(esr);
+
+	if (esr_sign_extend(esr)) {
+		unsigned int bit_count = access_len(esr) * 8U;
+		unsigned long mask = 1UL << (bit_count - 1U);
+
+		val = (val ^ mask) - mask;
+		if (!esr_sixty_four(esr)) {
+			val &= (1UL << 32U) - 1UL;
+		}
+	}
+
+	return val;
+}
+
 /*
  * For a trapped msr/mrs sysreg access, get the transfer register in the
  * ESR_EL2.
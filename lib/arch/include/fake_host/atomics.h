@@ -9,12 +9,17 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/*
+ * The fake_host helpers use the compiler atomic builtins, so that they
+ * remain atomic when the simulated PEs run on separate threads.
+ */
+
 /*
  * Atomically adds @val to the 64-bit value stored at memory location @loc.
  */
 static inline void atomic_add_64(uint64_t *loc, long val)
 {
-	*loc = *loc + val;
+	(void)__atomic_fetch_add(loc, val, __ATOMIC_RELAXED);
 }
 
 /*
@@ -24,10 +29,7 @@ static inline void atomic_add_64(uint64_t *loc, long val)
  */
 static inline unsigned long atomic_load_add_release_64(uint64_t *loc, long val)
 {
-	unsigned long old_val = *loc;
-
-	*loc = *loc + val;
-	return old_val;
+	return __atomic_fetch_add(loc, val, __ATOMIC_RELEASE);
 }
 
 /*
@@ -37,7 +39,7 @@ static inline void atomic_bit_set_release_64(uint64_t *loc, int bit)
 {
 	uint64_t mask = (1UL << bit);
 
-	*loc = *loc | mask;
+	(void)__atomic_fetch_or(loc, mask, __ATOMIC_RELEASE);
 }
 
 /*
@@ -47,7 +49,7 @@ static inline void atomic_bit_clear_release_64(uint64_t *loc, int bit)
 {
 	uint64_t mask = ~((uint64_t)(1UL << bit));
 
-	*loc = *loc & mask;
+	(void)__atomic_fetch_and(loc, mask, __ATOMIC_RELEASE);
 }
 
 /*
@@ -55,7 +57,7 @@ static inline void atomic_bit_clear_release_64(uint64_t *loc, int bit)
  */
 static inline bool atomic_test_bit_acquire_64(uint64_t *loc, int bit)
 {
-	uint64_t val = *loc;
+	uint64_t val = __atomic_load_n(loc, __ATOMIC_ACQUIRE);
 	uint64_t mask = (1UL << bit);
 
 	return ((val & mask) != 0UL);
@@ -69,10 +71,22 @@ static inline bool atomic_test_bit_acquire_64(uint64_t *loc, int bit)
 static inline bool atomic_bit_set_acquire_release_64(uint64_t *loc, int bit)
 {
 	uint64_t mask = (1UL << bit);
-	unsigned long old_val = *loc & mask;
+	uint64_t old_val = __atomic_fetch_or(loc, mask, __ATOMIC_ACQ_REL);
 
-	*loc |= mask;
-	return (old_val != 0UL);
+	return ((old_val & mask) != 0UL);
+}
+
+/*
+ * Atomically replace the 64-bit value at @loc with @new_val if it is equal
+ * to @expected, with acquire semantics.
+ * Return the value read from @loc, which is @expected on success.
+ */
+static inline uint64_t atomic_cas_acquire_64(uint64_t *loc, uint64_t expected,
+					     uint64_t new_val)
+{
+	(void)__atomic_compare_exchange_n(loc, &expected, new_val, false,
+					  __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+	return expected;
 }
 
 #endif /* ATOMICS_H */
@@ -46,11 +46,24 @@ static inline void write_ ## _name(u_register_t v)		\
  * Macros to create inline functions for system instructions
  *********************************************************************/
 
+/* Class of each system instruction for the cost model of the fake host */
+#define HOST_COST_OP_tlbi	HOST_COST_TLBI
+#define HOST_COST_OP_isb	HOST_COST_ISB
+#define HOST_COST_OP_dc		HOST_COST_DC
+#define HOST_COST_OP_at		HOST_COST_AT
+#define HOST_COST_OP_wfi	HOST_COST_OTHER
+#define HOST_COST_OP_wfe	HOST_COST_OTHER
+#define HOST_COST_OP_sev	HOST_COST_OTHER
+#define HOST_COST_OP_xpaci	HOST_COST_OTHER
+
+#define HOST_COST_SYSOP(_op)	HOST_COST(HOST_COST_OP_ ## _op)
+
 /* Define function for simple system instruction */
 #define DEFINE_SYSOP_FUNC(_op)				\
 static inline void (_op)(void)				\
 {							\
 	(void)_op;					\
+	HOST_COST_SYSOP(_op);				\
 }
 
 /* Define function for system instruction with register parameter */
@@ -58,12 +71,14 @@ static inline void (_op)(void)				\
 static inline void (_op)(uint64_t v)			\
 {							\
 	(void)v; /* To avoid MISRA-C:2012-2.7 warnings */ \
+	HOST_COST_SYSOP(_op);				\
 }
 
 /* Define function for system instruction with type specifier */
 #define DEFINE_SYSOP_TYPE_FUNC(_op, _type)		\
 static inline void (_op ## _type)(void)			\
 {							\
+	HOST_COST_SYSOP(_op);				\
 }
 
 /* Define function for system instruction with register parameter */
@@ -71,9 +86,29 @@ static inline void (_op ## _type)(void)			\
 static inline void (_op ## _type)(uint64_t v)		\
 {							\
 	(void)v; /* To avoid MISRA-C:2012-2.7 warnings */ \
+	HOST_COST_SYSOP(_op);				\
+}
+
+/* Define function for the nXS form of a TLBI instruction */
+#define DEFINE_TLBI_NXS_PARAM_FUNC(_type, _op1, _crm, _op2)	\
+static inline void (tlbi ## _type ## nxs)(uint64_t v)		\
+{								\
+	(void)v; /* To avoid MISRA-C:2012-2.7 warnings */ \
+	HOST_COST_SYSOP(tlbi);					\
+}
+
+/* Define function for a DC instruction encoded as SYS */
+#define DEFINE_DC_SYS_PARAM_FUNC(_type, _op1, _crm, _op2)	\
+static inline void (dc ## _type)(uint64_t v)			\
+{								\
+	(void)v; /* To avoid MISRA-C:2012-2.7 warnings */ \
+	HOST_COST_SYSOP(dc);					\
 }
 
-#define dsb(scope)
-#define dmb(scope)
+#define dsb(scope)	HOST_COST(HOST_COST_DSB)
+#define dsb_ishnxs()	HOST_COST(HOST_COST_DSB)
+#define dsb_nshnxs()	HOST_COST(HOST_COST_DSB)
+#define dmb(scope)	HOST_COST(HOST_COST_DMB)
+#define psb_csync()
 
 #endif /* INSTR_HELPERS_H */
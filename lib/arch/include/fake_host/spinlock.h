@@ -7,11 +7,39 @@
 #define SPINLOCK_H
 
 #include <host_harness.h>
+#include <stdbool.h>
 
 typedef struct spinlock_s {
 	unsigned int val;
 } spinlock_t;
 
+/*
+ * The lock word follows the encoding of the aarch64 spinlock_t, so that
+ * code updating it directly behaves the same on both architectures.
+ */
+#ifdef RMM_TICKET_LOCK
+static inline bool spinlock_val_is_free(unsigned int val)
+{
+	return (val & 0xffffU) == (val >> 16);
+}
+
+static inline unsigned int spinlock_val_locked(unsigned int val)
+{
+	return val + (1U << 16);
+}
+#else
+static inline bool spinlock_val_is_free(unsigned int val)
+{
+	return val == 0U;
+}
+
+static inline unsigned int spinlock_val_locked(unsigned int val)
+{
+	(void)val;
+	return 1U;
+}
+#endif /* RMM_TICKET_LOCK */
+
 static inline void spinlock_acquire(spinlock_t *l)
 {
 	host_spinlock_acquire(l);
@@ -78,6 +78,12 @@ void fpu_restore_state(struct fpu_state *fpu);
  * access to the FPU registers.
  * These functions are expected to be called before FPU is used by RMM to save
  * the incoming FPU context.
+ *
+ * A save/restore pair delimits an FPU section, and sections nest: only the
+ * outermost fpu_save_my_state() saves the registers and only the matching
+ * outermost fpu_restore_my_state() restores them. A command computing several
+ * hashes can therefore open one section around all of them, while the hash
+ * helpers it calls still open their own.
  */
 void fpu_save_my_state(void);
 void fpu_restore_my_state(void);
@@ -86,7 +92,8 @@ void fpu_restore_my_state(void);
  * Return true iff an fpu state is saved in the per-cpu buffer in this library.
  *
  * After calling 'fpu_save_my_state' this function returns true. After calling
- * 'fpu_restore_my_state' this function returns false.
+ * 'fpu_restore_my_state' for the outermost section this function returns
+ * false.
  */
 bool fpu_is_my_state_saved(unsigned int cpu_id);
 
@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch_helpers.h>
+#include <assert.h>
+#include <boot_phase.h>
+#include <memory.h>
+#include <utils_def.h>
+
+struct boot_phase_stamps {
+	unsigned long start;
+	/* Zero until the phase completes */
+	unsigned long end;
+};
+
+static struct boot_phase_stamps boot_phases[BOOT_PHASE_NR];
+
+void boot_phase_start(enum boot_phase phase)
+{
+	assert(phase < BOOT_PHASE_NR);
+
+	if (SCA_READ64(&boot_phases[phase].end) == 0UL) {
+		boot_phases[phase].start = read_cntpct_el0();
+	}
+}
+
+void boot_phase_end(enum boot_phase phase)
+{
+	unsigned long now = read_cntpct_el0();
+
+	assert(phase < BOOT_PHASE_NR);
+
+	if (SCA_READ64(&boot_phases[phase].end) == 0UL) {
+		/* Keep the phase recorded even if CNTPCT_EL0 reads as zero */
+		SCA_WRITE64_RELEASE(&boot_phases[phase].end,
+				    (now != 0UL) ? now : 1UL);
+	}
+}
+
+bool boot_phase_get(enum boot_phase phase, unsigned long *ticks,
+		    unsigned long *start)
+{
+	unsigned long end;
+
+	assert(phase < BOOT_PHASE_NR);
+
+	end = SCA_READ64_ACQUIRE(&boot_phases[phase].end);
+	if (end == 0UL) {
+		return false;
+	}
+
+	*start = boot_phases[phase].start;
+	*ticks = (end > *start) ? (end - *start) : 0UL;
+	return true;
+}
@@ -4,6 +4,7 @@
  */
 
 #include <arch_helpers.h>
+#include <string.h>
 
 /*******************************************************************************
  * Cache management
@@ -23,3 +24,8 @@ void inv_dcache_range(uintptr_t addr, size_t size)
 	(void)addr;
 	(void)size;
 }
+
+void zero_granule(void *addr)
+{
+	(void)memset(addr, 0, GRANULE_SIZE);
+}
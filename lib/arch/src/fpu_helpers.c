@@ -5,14 +5,17 @@
 
 #include <cpuid.h>
 #include <fpu_helpers.h>
+#include <percpu.h>
 #include <stdbool.h>
 
 struct rmm_fpu_state {
 	struct fpu_state state;
 	bool saved;
+	/* Number of fpu_save_my_state() calls not yet matched by a restore */
+	unsigned int depth;
 };
 
-struct rmm_fpu_state rmm_fpu_state[MAX_CPUS];
+DEFINE_PER_CPU(struct rmm_fpu_state, rmm_fpu_state);
 
 #ifdef RMM_FPU_USE_AT_REL2
 void fpu_save_my_state(void)
@@ -20,7 +23,14 @@ void fpu_save_my_state(void)
 	struct rmm_fpu_state *rmm_state;
 	unsigned int cpu_id = my_cpuid();
 
-	rmm_state = rmm_fpu_state + cpu_id;
+	rmm_state = &per_cpu(rmm_fpu_state, cpu_id);
+
+	/* Only the outermost section saves the incoming state */
+	if (rmm_state->depth++ != 0U) {
+		assert(rmm_state->saved);
+		return;
+	}
+
 	assert(!rmm_state->saved);
 	rmm_state->saved = true;
 	FPU_ALLOW(fpu_save_state(&(rmm_state->state)));
@@ -31,8 +41,14 @@ void fpu_restore_my_state(void)
 	struct rmm_fpu_state *rmm_state;
 	unsigned int cpu_id = my_cpuid();
 
-	rmm_state = rmm_fpu_state + cpu_id;
+	rmm_state = &per_cpu(rmm_fpu_state, cpu_id);
 	assert(rmm_state->saved);
+	assert(rmm_state->depth != 0U);
+
+	if (--rmm_state->depth != 0U) {
+		return;
+	}
+
 	FPU_ALLOW(fpu_restore_state(&(rmm_state->state)));
 	rmm_state->saved = false;
 }
@@ -40,7 +56,7 @@ void fpu_restore_my_state(void)
 bool fpu_is_my_state_saved(unsigned int cpu_id)
 {
 	assert(cpu_id < MAX_CPUS);
-	return rmm_fpu_state[cpu_id].saved;
+	return per_cpu(rmm_fpu_state, cpu_id).saved;
 }
 
 #else /* RMM_FPU_USE_AT_REL2 */
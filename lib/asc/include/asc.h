@@ -8,4 +8,18 @@
 void asc_mark_secure(unsigned long addr);
 void asc_mark_nonsecure(unsigned long addr);
 
+/*
+ * Change the PAS of @count contiguous granules starting at @base with a
+ * single call to EL3.
+ */
+void asc_mark_secure_range(unsigned long base, unsigned long count);
+void asc_mark_nonsecure_range(unsigned long base, unsigned long count);
+
+/*
+ * Change the PAS of the @count granules whose addresses are listed in
+ * @addrs, using as few calls to EL3 as possible.
+ */
+void asc_mark_secure_list(const unsigned long *addrs, unsigned long count);
+void asc_mark_nonsecure_list(const unsigned long *addrs, unsigned long count);
+
 #endif /* ASC_H */
@@ -4,7 +4,22 @@
  */
 
 #include <assert.h>
+#include <asc.h>
+#include <memory.h>
+#include <rmm_el3_ifc.h>
 #include <smc.h>
+#include <stdbool.h>
+
+/*
+ * Cleared the first time EL3 reports that the batched GPT transition calls
+ * are not implemented. From then on, the range and list operations fall back
+ * to one call per granule.
+ *
+ * Any CPU can clear it while others read it, so it is only accessed with
+ * single-copy atomic accesses. A CPU which reads it before it is cleared
+ * only makes one more batched call, which fails the same way.
+ */
+static unsigned long asc_batch_supported = 1UL;
 
 void asc_mark_secure(unsigned long addr)
 {
@@ -22,3 +37,89 @@ void asc_mark_nonsecure(unsigned long addr)
 	assert(ret == 0);
 }
 
+static void asc_mark_one(bool secure, unsigned long addr)
+{
+	if (secure) {
+		asc_mark_secure(addr);
+	} else {
+		asc_mark_nonsecure(addr);
+	}
+}
+
+/*
+ * Check the result of a batched EL3 call. Returns false if the call is not
+ * supported by EL3 and the caller needs to fall back to per granule calls.
+ */
+static bool asc_batch_done(int ret)
+{
+	if (ret == SMC_UNKNOWN) {
+		SCA_WRITE64(&asc_batch_supported, 0UL);
+		return false;
+	}
+
+	assert(ret == 0);
+	return true;
+}
+
+static void asc_mark_range(bool secure, unsigned long base,
+			   unsigned long count)
+{
+	unsigned long i;
+
+	if (count == 0UL) {
+		return;
+	}
+
+	if ((SCA_READ64(&asc_batch_supported) != 0UL) &&
+	    asc_batch_done(rmm_el3_ifc_gpt_mark_range(secure, base, count))) {
+		return;
+	}
+
+	for (i = 0UL; i < count; i++) {
+		asc_mark_one(secure, base + (i * GRANULE_SIZE));
+	}
+}
+
+static void asc_mark_list(bool secure, const unsigned long *addrs,
+			  unsigned long count)
+{
+	while (count != 0UL) {
+		unsigned long n = count;
+		unsigned long i;
+
+		if (n > RMM_EL3_IFC_GPT_LIST_MAX) {
+			n = RMM_EL3_IFC_GPT_LIST_MAX;
+		}
+
+		if ((SCA_READ64(&asc_batch_supported) == 0UL) ||
+		    !asc_batch_done(rmm_el3_ifc_gpt_mark_list(secure,
+							      addrs, n))) {
+			for (i = 0UL; i < n; i++) {
+				asc_mark_one(secure, addrs[i]);
+			}
+		}
+
+		addrs += n;
+		count -= n;
+	}
+}
+
+void asc_mark_secure_range(unsigned long base, unsigned long count)
+{
+	asc_mark_range(true, base, count);
+}
+
+void asc_mark_nonsecure_range(unsigned long base, unsigned long count)
+{
+	asc_mark_range(false, base, count);
+}
+
+void asc_mark_secure_list(const unsigned long *addrs, unsigned long count)
+{
+	asc_mark_list(true, addrs, count);
+}
+
+void asc_mark_nonsecure_list(const unsigned long *addrs, unsigned long count)
+{
+	asc_mark_list(false, addrs, count);
+}
@@ -11,20 +11,13 @@
 struct buffer_alloc_ctx;
 
 /*
- * Performs any early initialization needed for the crypto library.
- */
-int attestation_init(void);
-
-/*
- * Return the platform token that was previously retrieved from the monitor.
- *
- * Arguments:
- * buf - pointer to a q_useful_buf structure where the reference to the
- *	 platform token will be returned.
+ * Retrieve the platform token from the monitor again, after it has been
+ * rotated. The CCA tokens built afterwards contain the new token.
  *
- * Returns 0 on success, and a negative error code otherwise.
+ * Returns 0 on success, and a negative error code otherwise. The previous
+ * platform token is kept on error.
  */
-int attest_get_platform_token(struct q_useful_buf_c **buf);
+int attest_refresh_platform_token(void);
 
 /*
  * Initialize the heap buffer to be used with the given buffer_alloc_ctx.
@@ -45,6 +38,10 @@ int attestation_heap_ctx_init(unsigned char *buf, size_t buf_size);
  * Assign a given buf_alloc_ctx to this CPU. This needs to be called
  * prior to entering a Realm to allow it invoking RMM crypto operations.
  *
+ * The first call initialises the attestation, which includes getting the
+ * Realm attestation key and the platform token from EL3, so it must be made
+ * with no buf_alloc_ctx assigned to this CPU.
+ *
  * Arguments:
  * ctx - pointer to buffer_alloc_ctx
  *
@@ -78,4 +75,14 @@ int attestation_heap_ctx_unassign_pe(struct buffer_alloc_ctx *ctx);
  */
 int attestation_heap_reinit_pe(unsigned char *buf, size_t buf_size);
 
+/*
+ * Reseed the PRNG of this CPU from the TRNG once it has generated
+ * RMM_ATTEST_RESEED_BYTES bytes since it was last seeded. Does nothing if
+ * RMM_ATTEST_RESEED_BYTES is 0.
+ *
+ * This is meant to be called when the CPU is about to return to the Host,
+ * so that the TRNG accesses are not done in the middle of a signing.
+ */
+void attestation_rnd_reseed(void);
+
 #endif /* ATTESTATION_H */
@@ -0,0 +1,88 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef ATTESTATION_EXPORT_H
+#define ATTESTATION_EXPORT_H
+
+#include <mbedtls/gcm.h>
+#include <memory_alloc.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <utils_def.h>
+
+/* Size in bytes of the AES-256 key protecting the granules of a Realm */
+#define EXPORT_KEY_SIZE		32U
+
+/* Size in bytes of the GCM tag of an exported granule */
+#define EXPORT_TAG_SIZE		16U
+
+/*
+ * Heap of the MbedTLS cipher context of the GCM, which only holds the AES
+ * key schedule.
+ */
+#define EXPORT_HEAP_SIZE	1024U
+
+/*
+ * Context of the encryption or the decryption of an exported granule, with
+ * the heap MbedTLS allocates from meanwhile, so that no heap needs to be
+ * assigned to the CPU by the caller.
+ */
+struct attest_export_ctx {
+	mbedtls_gcm_context gcm;
+	bool encrypt;
+	struct buffer_alloc_ctx heap_ctx;
+	unsigned char heap[EXPORT_HEAP_SIZE] __aligned(sizeof(unsigned long));
+};
+
+/*
+ * Generate a random key for the granules exported from a Realm with the
+ * PRNG of this CPU, initialising the attestation first if needed.
+ *
+ * Must be called with no buffer_alloc_ctx assigned to this CPU.
+ *
+ * Returns 0 on success, negative error code otherwise.
+ */
+int attest_export_key_generate(unsigned char *key);
+
+/*
+ * Start the encryption, if @encrypt is true, or the decryption of a granule
+ * with @key. The IV is built from @seq, which must not be used twice with
+ * the same key, and the @aad_len bytes at @aad are authenticated with the
+ * granule.
+ *
+ * Must be called with no buffer_alloc_ctx assigned to this CPU. On success,
+ * attest_export_finish() must be called, even if an update fails.
+ *
+ * Returns 0 on success, negative error code otherwise.
+ */
+int attest_export_start(struct attest_export_ctx *ctx,
+			const unsigned char *key,
+			bool encrypt,
+			unsigned long seq,
+			const void *aad,
+			size_t aad_len);
+
+/*
+ * Encrypt or decrypt the next @len bytes, a multiple of 16, from @in to
+ * @out, which can be the same buffer.
+ *
+ * Returns 0 on success, negative error code otherwise.
+ */
+int attest_export_update(struct attest_export_ctx *ctx,
+			 const void *in,
+			 void *out,
+			 size_t len);
+
+/*
+ * Finish the operation started on @ctx and release its resources. The tag
+ * is written to @tag after an encryption, and compared to @tag after a
+ * decryption.
+ *
+ * Returns 0 on success, and a negative error code otherwise, including
+ * when the tag of a decryption does not match.
+ */
+int attest_export_finish(struct attest_export_ctx *ctx, unsigned char *tag);
+
+#endif /* ATTESTATION_EXPORT_H */
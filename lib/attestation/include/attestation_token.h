@@ -17,6 +17,7 @@
 #include <t_cose/q_useful_buf.h>
 #include <t_cose/t_cose_sign1_sign.h>
 
+/* Size of the token buffer of the Realm if it does not give one */
 #define ATTEST_TOKEN_BUFFER_SIZE		GRANULE_SIZE
 
 enum attest_token_err_t {
@@ -35,7 +36,12 @@ enum attest_token_err_t {
 	/* Signing is in progress, function should be called with the same
 	 * parameters again.
 	 */
-	ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS
+	ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS,
+	/*
+	 * The token waits for the other tokens of its batch or for the
+	 * signature of the batch, function should be called again later.
+	 */
+	ATTEST_TOKEN_ERR_BATCH_WAIT
 };
 
 /* The state of the realm token generation */
@@ -69,6 +75,22 @@ struct attest_token_encode_ctx {
 
 #define ATTEST_CHALLENGE_SIZE			(64)
 
+#ifdef RMM_ATTEST_BATCH
+/* Value of attest_batch_ref.gen for a token which is not in a batch */
+#define ATTEST_BATCH_NONE			(~0U)
+
+/*
+ * Membership of a Realm token in a batch of tokens of which only the root of
+ * the Merkle tree of the payloads is signed, see attestation_token.c.
+ */
+struct attest_batch_ref {
+	unsigned int gen;		/* Generation of the batch */
+	unsigned short index;		/* Index of the token in the batch */
+	unsigned short payload_len;	/* Size of the payload of the token */
+	bool leader;			/* The token signs the batch */
+};
+#endif
+
 /*
  * The context for signing an attestation token. Each REC contains one context
  * that is passed to the attestation library during attestation token creation
@@ -83,9 +105,65 @@ struct token_sign_ctx {
 	struct attest_token_encode_ctx ctx;
 	/* Data saved in the first iteration */
 	unsigned long token_ipa;
+	unsigned long token_buf_size;
 	unsigned char challenge[ATTEST_CHALLENGE_SIZE];
+	/*
+	 * Progress of the write of the CCA token to the Realm buffer, in
+	 * ATTEST_SIGN_TOKEN_WRITE_IN_PROGRESS state.
+	 */
+	size_t token_written;
+	/*
+	 * Measurement generation of the Realm when the last Realm token was
+	 * created, or zero if it was never signed. Once signed, the token is
+	 * used again for the same challenge while the generation is unchanged.
+	 */
+	unsigned long meas_gen;
+	unsigned int token_gen;
+#ifdef RMM_ATTEST_BATCH
+	struct attest_batch_ref batch;
+#endif
+};
+
+/* Claims of the Realm token which do not change after Realm activation */
+enum attest_realm_claim {
+	ATTEST_REALM_CLAIM_RPV,
+	ATTEST_REALM_CLAIM_PUB_KEY,
+	ATTEST_REALM_CLAIM_HASH_ALGO_ID,
+	ATTEST_REALM_CLAIM_PUB_KEY_HASH_ALGO_ID,
+	ATTEST_REALM_CLAIM_RIM,
+	ATTEST_REALM_CLAIM_NR
 };
 
+/* Large enough for the claims above with a P-384 public key */
+#define ATTEST_REALM_CLAIMS_SIZE		(320U)
+
+/*
+ * The CBOR encoded values of the static claims of a Realm, built once on
+ * Realm activation and copied as they are into each Realm token.
+ */
+struct attest_realm_claims {
+	/* Offset in 'buf' of the end of the encoded value of each claim */
+	unsigned short end[ATTEST_REALM_CLAIM_NR];
+	unsigned char buf[ATTEST_REALM_CLAIMS_SIZE];
+};
+
+/*
+ * Encode the static claims of a Realm.
+ *
+ * Arguments:
+ * algorithm	- Algorithm used during measurement.
+ * rim		- Realm Initial Measurement.
+ * rpv		- Realm Personalization value.
+ * claims	- Structure where to store the encoded claims.
+ *
+ * Returns ATTEST_TOKEN_ERR_SUCCESS (0) on success or a negative error code
+ * otherwise.
+ */
+int attest_realm_claims_create(enum hash_algo algorithm,
+			       unsigned char *rim,
+			       struct q_useful_buf_c *rpv,
+			       struct attest_realm_claims *claims);
+
 /*
  * Sign the realm token and complete the CBOR encoding.
  * This function returns ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS
@@ -106,27 +184,58 @@ enum attest_token_err_t
 attest_realm_token_sign(struct attest_token_encode_ctx *me,
 			struct q_useful_buf_c *completed_token);
 
+#ifdef RMM_ATTEST_BATCH
+/*
+ * Batched version of attest_realm_token_sign(), for a token created by
+ * attest_realm_token_create() in @token_buf. The token joins a batch and,
+ * if it closes the batch, signs the root of the batch. Returns
+ * ATTEST_TOKEN_ERR_BATCH_WAIT while the token waits for the rest of the batch
+ * and ATTEST_TOKEN_ERR_SUCCESS once `completed_token` holds the batched token.
+ */
+enum attest_token_err_t
+attest_realm_token_batch_sign(struct token_sign_ctx *ctx,
+			      const struct q_useful_buf *token_buf,
+			      struct q_useful_buf_c *completed_token);
+
+/*
+ * Give up the token of @ctx before it is complete. If it signs its batch,
+ * the other tokens of the batch join a later one.
+ */
+void attest_realm_token_batch_abort(struct token_sign_ctx *ctx);
+#endif
+
 /*
- * Combine realm token and platform token to top-level cca token
+ * Copy a chunk of the top-level CCA token, which combines the platform
+ * token and the Realm token, so that the token can be written to a buffer
+ * one piece at a time.
  *
- * attest_token_buf  Pointer and length to the buffer where the token will be
- *                   written.
  * realm_token       Pointer and length to the realm token.
+ * offset            Offset in the CCA token of the chunk.
+ * buf               Pointer and length to the buffer where the chunk will be
+ *                   written. Only the part of it up to the end of the token
+ *                   is written to.
+ * gen               Generation of the platform token. It is set when @offset
+ *                   is 0 and checked for the other chunks, so that all of
+ *                   them come from the same platform token.
  *
- * Return 0 in case of error, the length of the cca token otherwise.
+ * Return the length of the CCA token, or 0 if the platform token changed
+ * since the chunk at offset 0 was copied, in which case the copy must be
+ * restarted from offset 0.
  */
-size_t attest_cca_token_create(struct q_useful_buf         *attest_token_buf,
-			       const struct q_useful_buf_c *realm_token);
+size_t attest_cca_token_read(const struct q_useful_buf_c *realm_token,
+			     size_t offset, struct q_useful_buf *buf,
+			     unsigned int *gen);
 
 /*
  * Assemble the Realm token in the buffer provided in realm_token_buf,
- * except the signature.
+ * except the signature. With RMM_ATTEST_BATCH, only the payload of the token
+ * is assembled, see attest_realm_token_batch_sign().
  *
  * Arguments:
  * Algorithm		- Algorithm used during measurement.
  * Measurement		- Array of buffers containing all the measurements.
  * num_measurements	- Number of measurements to add to the token.
- * rpv                  - Realm Personalization value
+ * claims		- Static claims of the Realm, which include the RIM.
  * ctx			- Token sign context, used for signing.
  * realm_token_buf	- Buffer where to assemble the attestation token.
  *
@@ -136,7 +245,7 @@ size_t attest_cca_token_create(struct q_useful_buf         *attest_token_buf,
 int attest_realm_token_create(enum hash_algo algorithm,
 			     unsigned char measurements[][MAX_MEASUREMENT_SIZE],
 			     unsigned int num_measurements,
-			     struct q_useful_buf_c *rpv,
+			     const struct attest_realm_claims *claims,
 			     struct token_sign_ctx *ctx,
 			     struct q_useful_buf *realm_token_buf);
 
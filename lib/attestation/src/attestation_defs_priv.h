@@ -23,4 +23,11 @@
 #define CCA_PLAT_TOKEN				(44234)
 #define CCA_REALM_DELEGATED_TOKEN		(44241)
 
+/* Claims of the batched Realm tokens, see attestation_token.c */
+#define EAT_PROFILE				(265)
+#define RMM_BATCH_ROOT				(44300)
+#define RMM_BATCH_SIZE				(44301)
+
+#define RMM_BATCH_PROFILE	"tag:trustedfirmware.org,2024:rmm-batch-token"
+
 #endif /* ATTESTATION_DEFS_PRIV_H */
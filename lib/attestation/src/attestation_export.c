@@ -0,0 +1,134 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <assert.h>
+#include <attestation.h>
+#include <attestation_export.h>
+#include <attestation_priv.h>
+#include <errno.h>
+#include <fpu_helpers.h>
+#include <mbedtls/memory_buffer_alloc.h>
+#include <string.h>
+
+/* Size in bytes of the GCM IV, of which the sequence number is the start */
+#define EXPORT_IV_SIZE		12U
+
+int attest_export_key_generate(unsigned char *key)
+{
+	struct attest_rng_context rng_ctx;
+	int ret;
+
+	assert(key != NULL);
+
+	if (!attestation_init_once()) {
+		return -EINVAL;
+	}
+
+	attest_get_cpu_rng_context(&rng_ctx);
+
+	fpu_save_my_state();
+	FPU_ALLOW(ret = rng_ctx.f_rng(rng_ctx.p_rng, key, EXPORT_KEY_SIZE));
+	fpu_restore_my_state();
+
+	return (ret == 0) ? 0 : -EINVAL;
+}
+
+int attest_export_start(struct attest_export_ctx *ctx,
+			const unsigned char *key,
+			bool encrypt,
+			unsigned long seq,
+			const void *aad,
+			size_t aad_len)
+{
+	unsigned char iv[EXPORT_IV_SIZE] = { 0 };
+	int ret;
+
+	assert((ctx != NULL) && (key != NULL));
+
+	/* The statistics of the heap are kept by its initialisation */
+	(void)memset(&ctx->heap_ctx, 0, sizeof(ctx->heap_ctx));
+	if (buffer_alloc_ctx_assign(&ctx->heap_ctx) != 0) {
+		return -EINVAL;
+	}
+
+	(void)memcpy(iv, &seq, sizeof(seq));
+	ctx->encrypt = encrypt;
+
+	fpu_save_my_state();
+
+	FPU_ALLOW(mbedtls_memory_buffer_alloc_init(ctx->heap,
+						   sizeof(ctx->heap)));
+	FPU_ALLOW(mbedtls_gcm_init(&ctx->gcm));
+	FPU_ALLOW(ret = mbedtls_gcm_setkey(&ctx->gcm, MBEDTLS_CIPHER_ID_AES,
+					   key, EXPORT_KEY_SIZE * 8U));
+	if (ret == 0) {
+		FPU_ALLOW(ret = mbedtls_gcm_starts(&ctx->gcm,
+				encrypt ? MBEDTLS_GCM_ENCRYPT :
+					  MBEDTLS_GCM_DECRYPT,
+				iv, sizeof(iv)));
+	}
+	if (ret == 0) {
+		FPU_ALLOW(ret = mbedtls_gcm_update_ad(&ctx->gcm, aad,
+						      aad_len));
+	}
+
+	if (ret != 0) {
+		FPU_ALLOW(mbedtls_gcm_free(&ctx->gcm));
+		fpu_restore_my_state();
+		buffer_alloc_ctx_unassign();
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int attest_export_update(struct attest_export_ctx *ctx,
+			 const void *in,
+			 void *out,
+			 size_t len)
+{
+	size_t olen;
+	int ret;
+
+	assert(ctx != NULL);
+	assert((len % 16U) == 0U);
+
+	FPU_ALLOW(ret = mbedtls_gcm_update(&ctx->gcm, in, len, out, len,
+					   &olen));
+
+	return ((ret == 0) && (olen == len)) ? 0 : -EINVAL;
+}
+
+int attest_export_finish(struct attest_export_ctx *ctx, unsigned char *tag)
+{
+	unsigned char computed[EXPORT_TAG_SIZE];
+	unsigned char diff = 0U;
+	size_t olen;
+	int ret;
+
+	assert((ctx != NULL) && (tag != NULL));
+
+	FPU_ALLOW(ret = mbedtls_gcm_finish(&ctx->gcm, NULL, 0U, &olen,
+					   computed, sizeof(computed)));
+	FPU_ALLOW(mbedtls_gcm_free(&ctx->gcm));
+	fpu_restore_my_state();
+	buffer_alloc_ctx_unassign();
+
+	if (ret != 0) {
+		return -EINVAL;
+	}
+
+	if (ctx->encrypt) {
+		(void)memcpy(tag, computed, sizeof(computed));
+		return 0;
+	}
+
+	/* Compare all the bytes, so that the time does not depend on them */
+	for (unsigned int i = 0U; i < EXPORT_TAG_SIZE; i++) {
+		diff |= (unsigned char)(computed[i] ^ tag[i]);
+	}
+
+	return (diff == 0U) ? 0 : -EINVAL;
+}
@@ -31,12 +31,6 @@
 /* ECC Curve type define for querying attestation key from monitor */
 #define ATTEST_KEY_CURVE_ECC_SECP384R1	0
 
-/*
- * The platform token which will be needed during attestation.
- */
-static unsigned char rmm_platform_token_buf[SZ_4K];
-static struct q_useful_buf rmm_platform_token;
-
 /*
  * The public key is kept loaded as it is both not required to be secret (and
  * hence can be kept in attestation memory) and immutable.
@@ -221,6 +215,7 @@ int attest_setup_platform_token(void)
 	uintptr_t shared_buf;
 	size_t platform_token_len = 0;
 	struct q_useful_buf_c rmm_pub_key_hash;
+	struct q_useful_buf_c platform_token;
 
 	/*
 	 * Copy the RAK public hash value to the token buffer. This is
@@ -248,28 +243,22 @@ int attest_setup_platform_token(void)
 		return -EINVAL;
 	}
 
-	(void)memcpy(rmm_platform_token_buf,
-		     (void *)shared_buf,
-		     platform_token_len);
+	/*
+	 * The token is only kept encoded in the head of the CCA token, which
+	 * is replaced atomically for the tokens being built on other CPUs.
+	 */
+	platform_token.ptr = (void *)shared_buf;
+	platform_token.len = platform_token_len;
+	ret = attest_cca_token_head_update(&platform_token);
 
 	rmm_el3_ifc_release_shared_buf();
 
-	rmm_platform_token.ptr = rmm_platform_token_buf;
-	rmm_platform_token.len = platform_token_len;
-
-	return 0;
+	return ret;
 }
 
-int attest_get_platform_token(struct q_useful_buf_c **buf)
+int attest_refresh_platform_token(void)
 {
-	assert(buf != NULL);
-
-	if (rmm_platform_token.ptr == NULL) {
-		return -EINVAL;
-	}
-
-	*buf = (struct q_useful_buf_c *)&rmm_platform_token;
-	return 0;
+	return attest_setup_platform_token();
 }
 
 enum hash_algo attest_get_realm_public_key_hash_algo_id(void)
@@ -6,6 +6,8 @@
 #ifndef ATTESTATION_PRIV_H
 #define ATTESTATION_PRIV_H
 
+#include <stdbool.h>
+
 /*
  * A structure holding the context for generating a pseudo-random number derived
  * from a real random seed.
@@ -77,11 +79,28 @@ int attest_get_realm_public_key(struct q_useful_buf_c *public_key);
  */
 int attest_setup_platform_token(void);
 
+/*
+ * Encode the head of the CCA token with @platform_token, replacing the
+ * previous one. Used when the platform token is retrieved from the monitor.
+ *
+ * Returns 0 on success, negative error code on error.
+ */
+int attest_cca_token_head_update(struct q_useful_buf_c *platform_token);
+
 /*
  * Get the hash algorithm to use for computing the hash of the realm public key.
  */
 enum hash_algo attest_get_realm_public_key_hash_algo_id(void);
 
+/*
+ * Initialise the attestation on its first use, see attestation_utils.c.
+ *
+ * Must be called with no buffer_alloc_ctx assigned to this CPU.
+ *
+ * Returns true if the attestation is initialised.
+ */
+bool attestation_init_once(void);
+
 /*
  * Initialise PRNGs for all the CPUs
  *
@@ -13,25 +13,40 @@
 #include <fpu_helpers.h>
 #include <mbedtls/entropy.h>
 #include <mbedtls/hmac_drbg.h>
+#include <percpu.h>
 #include <platform_api.h>
+#include <rmm_el3_ifc.h>
 #include <stdbool.h>
+#include <string.h>
 #include <utils_def.h>
 
+struct cpu_drbg {
+	/* Must be first, as the PRNG callbacks are passed a pointer to it */
+	mbedtls_hmac_drbg_context ctx;
+#ifdef RMM_ATTEST_RESEED_BYTES
+	/* Bytes generated by the PRNG since it was last reseeded */
+	unsigned long bytes;
+#endif
+};
+
 /*
  * Allocate a PRNG object per PE in order to avoid the necessity of locking if
  * concurrent attestation token requests are executed.
  */
-static mbedtls_hmac_drbg_context cpu_drbg_ctx[MAX_CPUS];
+static DEFINE_PER_CPU(struct cpu_drbg, cpu_drbg);
 static bool prng_init_done;
 
+#ifdef RMM_ATTEST_RESEED_BYTES
+/* Size of the fresh entropy mixed into a PRNG on reseed */
+#define RESEED_ENTROPY_SIZE	48U
+#endif
+
 static int get_random_seed(unsigned char *output, size_t len)
 {
 	bool rc;
 	uint64_t *random_output;
 	uint64_t *random_end;
 
-	assert(!prng_init_done);
-
 	/* Enforce `len` is a multiple of 8 and `output` is 8-byte aligned. */
 	assert((len & 0x7UL) == 0UL && ((uintptr_t)output & 0x7UL) == 0UL);
 
@@ -65,24 +80,88 @@ int mbedtls_hardware_poll(void  *data, unsigned char *output,
 	(void)data;
 
 	/* Not in RMM init, PRNGs are already initialized, use them. */
-	rng_ctx = &cpu_drbg_ctx[cpu_id];
+	rng_ctx = &per_cpu(cpu_drbg, cpu_id).ctx;
 	ret = mbedtls_hmac_drbg_random(rng_ctx, output, len);
 	if (ret != 0) {
 		return ret;
 	}
 	*olen = len;
 
+#ifdef RMM_ATTEST_RESEED_BYTES
+	per_cpu(cpu_drbg, cpu_id).bytes += len;
+#endif
 	return 0;
 }
 
+#ifdef RMM_ATTEST_RESEED_BYTES
+/* PRNG callback which counts the bytes generated for the reseed policy */
+static int cpu_drbg_random(void *p_rng, unsigned char *output, size_t len)
+{
+	struct cpu_drbg *drbg = p_rng;
+	int ret;
+
+	/*
+	 * The PRNG of the CPU which prepared the signing, which may not be
+	 * the current CPU if the signing was resumed on another one.
+	 */
+	ret = mbedtls_hmac_drbg_random(&drbg->ctx, output, len);
+	if (ret == 0) {
+		drbg->bytes += len;
+	}
+
+	return ret;
+}
+#endif
+
 void attest_get_cpu_rng_context(struct attest_rng_context *rng_ctx)
 {
 	unsigned int cpu_id = my_cpuid();
 
 	assert(prng_init_done);
 
+#ifdef RMM_ATTEST_RESEED_BYTES
+	rng_ctx->f_rng = cpu_drbg_random;
+#else
 	rng_ctx->f_rng = mbedtls_hmac_drbg_random;
-	rng_ctx->p_rng = &cpu_drbg_ctx[cpu_id];
+#endif
+	rng_ctx->p_rng = &per_cpu(cpu_drbg, cpu_id).ctx;
+}
+
+void attestation_rnd_reseed(void)
+{
+#ifdef RMM_ATTEST_RESEED_BYTES
+	unsigned int cpu_id = my_cpuid();
+	uint8_t entropy[RESEED_ENTROPY_SIZE] __aligned(8);
+	int rc;
+
+	if (!prng_init_done ||
+	    (per_cpu(cpu_drbg, cpu_id).bytes < RMM_ATTEST_RESEED_BYTES)) {
+		return;
+	}
+
+	/*
+	 * If the TRNG has no entropy available, keep the count so that the
+	 * reseed is tried again at the end of the next call.
+	 */
+	if (get_random_seed(entropy, sizeof(entropy)) != 0) {
+		return;
+	}
+
+	/*
+	 * The PRNGs are seeded from a buffer and have no entropy callback, so
+	 * the fresh entropy is mixed into the state as additional input.
+	 */
+	fpu_save_my_state();
+	FPU_ALLOW(rc = mbedtls_hmac_drbg_update(&per_cpu(cpu_drbg, cpu_id).ctx,
+						 entropy, sizeof(entropy)));
+	fpu_restore_my_state();
+
+	(void)memset(entropy, 0, sizeof(entropy));
+
+	if (rc == 0) {
+		per_cpu(cpu_drbg, cpu_id).bytes = 0UL;
+	}
+#endif /* RMM_ATTEST_RESEED_BYTES */
 }
 
 int attest_rnd_prng_init(void)
@@ -125,17 +204,20 @@ int attest_rnd_prng_init(void)
 
 	/*
 	 * Set up the per CPU PRNG objects which going to be used during
-	 * Elliptic Curve signing to blind the private key.
+	 * Elliptic Curve signing to blind the private key. Only the CPUs
+	 * reported by EL3 have a per-CPU area.
 	 */
-	for (i = 0U; i < MAX_CPUS; ++i) {
+	for (i = 0U; i < rmm_el3_ifc_get_num_cpus(); ++i) {
 		rc = mbedtls_hmac_drbg_random(&drbg_ctx, seed, sizeof(seed));
 		if (rc != 0) {
 			retval = -EINVAL;
 			goto free_temp_prng;
 		}
 
-		mbedtls_hmac_drbg_init(&cpu_drbg_ctx[i]);
-		rc = mbedtls_hmac_drbg_seed_buf(&cpu_drbg_ctx[i], md_info,
+		mbedtls_hmac_drbg_context *ctx = &per_cpu(cpu_drbg, i).ctx;
+
+		mbedtls_hmac_drbg_init(ctx);
+		rc = mbedtls_hmac_drbg_seed_buf(ctx, md_info,
 						seed, sizeof(seed));
 		if (rc != 0) {
 			retval = -EINVAL;
@@ -9,15 +9,20 @@
  *    trusted-firmware-m/secure_fw/partitions/initial_attestation/attest_token_encode.c
  */
 
+#include <arch_helpers.h>
 #include <assert.h>
 #include <attestation.h>
 #include <attestation_defs_priv.h>
 #include <attestation_priv.h>
 #include <attestation_token.h>
 #include <debug.h>
+#include <errno.h>
 #include <fpu_helpers.h>
 #include <measurement.h>
 #include <qcbor/qcbor.h>
+#include <sizes.h>
+#include <spinlock.h>
+#include <string.h>
 #include <t_cose/q_useful_buf.h>
 #include <t_cose/t_cose_common.h>
 #include <t_cose/t_cose_sign1_sign.h>
@@ -185,47 +190,602 @@ attest_realm_token_sign(struct attest_token_encode_ctx *me,
 	return attest_res;
 }
 
-size_t attest_cca_token_create(struct q_useful_buf         *attest_token_buf,
-			       const struct q_useful_buf_c *realm_token)
-{
-	struct q_useful_buf_c   completed_token;
-	QCBOREncodeContext      cbor_enc_ctx;
-	QCBORError              qcbor_res;
-	struct q_useful_buf_c  *rmm_platform_token;
+/*
+ * The CCA token up to the encoded label of the Realm token, that is the tag,
+ * the map header and the encoded platform token. It is encoded once when the
+ * platform token is retrieved, so that building a CCA token only copies it.
+ */
+/* Upper bound of the size of the head without the platform token */
+#define CCA_TOKEN_HEAD_OVERHEAD		(32U)
+#define CCA_TOKEN_HEAD_SIZE		(SZ_4K + CCA_TOKEN_HEAD_OVERHEAD)
 
-	__unused int            ret;
+static unsigned char cca_token_head_buf[CCA_TOKEN_HEAD_SIZE];
+static size_t cca_token_head_len;
+/* Incremented on every update of the head */
+static unsigned int cca_token_head_gen;
+static spinlock_t cca_token_head_lock;
 
-	/* Get the platform token */
-	ret = attest_get_platform_token(&rmm_platform_token);
-	assert(ret == 0);
+/* CBOR major type 2, byte string, and largest head of a Realm token */
+#define CBOR_MAJOR_BSTR			(0x40U)
+#define CBOR_BSTR_HEAD_MAX		(3U)
 
-	QCBOREncode_Init(&cbor_enc_ctx, *attest_token_buf);
+int attest_cca_token_head_update(struct q_useful_buf_c *platform_token)
+{
+	struct q_useful_buf buf = { cca_token_head_buf,
+				    sizeof(cca_token_head_buf) };
+	struct q_useful_buf_c no_realm_token = { cca_token_head_buf, 0U };
+	struct q_useful_buf_c encoded;
+	QCBOREncodeContext cbor_enc_ctx;
+	__unused QCBORError qcbor_res;
 
-	QCBOREncode_AddTag(&cbor_enc_ctx, TAG_CCA_TOKEN);
+	/*
+	 * Reject the token before overwriting the head, so that the previous
+	 * token is kept. The encoding cannot fail once the token fits.
+	 */
+	if (platform_token->len >
+	    (CCA_TOKEN_HEAD_SIZE - CCA_TOKEN_HEAD_OVERHEAD)) {
+		ERROR("Platform token too large\n");
+		return -EINVAL;
+	}
 
-	QCBOREncode_OpenMap(&cbor_enc_ctx);
+	spinlock_acquire(&cca_token_head_lock);
 
+	/*
+	 * Encode the CCA token with an empty Realm token. The head is all of
+	 * it but the empty byte string at the end, encoded as a single 0x40.
+	 */
+	QCBOREncode_Init(&cbor_enc_ctx, buf);
+	QCBOREncode_AddTag(&cbor_enc_ctx, TAG_CCA_TOKEN);
+	QCBOREncode_OpenMap(&cbor_enc_ctx);
 	QCBOREncode_AddBytesToMapN(&cbor_enc_ctx,
 				   CCA_PLAT_TOKEN,
-				   *rmm_platform_token);
-
+				   *platform_token);
 	QCBOREncode_AddBytesToMapN(&cbor_enc_ctx,
 				   CCA_REALM_DELEGATED_TOKEN,
-				   *realm_token);
+				   no_realm_token);
 	QCBOREncode_CloseMap(&cbor_enc_ctx);
 
-	qcbor_res = QCBOREncode_Finish(&cbor_enc_ctx, &completed_token);
+	qcbor_res = QCBOREncode_Finish(&cbor_enc_ctx, &encoded);
+	assert(qcbor_res == QCBOR_SUCCESS);
+	assert(cca_token_head_buf[encoded.len - 1U] == 0x40U);
 
-	if (qcbor_res == QCBOR_ERR_BUFFER_TOO_SMALL) {
-		ERROR("CCA output token buffer too small\n");
-		return 0;
-	} else if (qcbor_res != QCBOR_SUCCESS) {
-		/* likely from array not closed, too many closes, ... */
-		assert(false);
+	cca_token_head_len = encoded.len - 1U;
+	cca_token_head_gen++;
+
+	spinlock_release(&cca_token_head_lock);
+
+	return 0;
+}
+
+/*
+ * Encode in @head the CBOR head of a byte string of @len bytes, as in
+ * RFC 8949 section 3, and return its size.
+ */
+static size_t encode_bstr_head(size_t len, uint8_t head[CBOR_BSTR_HEAD_MAX])
+{
+	if (len < 24U) {
+		head[0] = (uint8_t)(CBOR_MAJOR_BSTR | len);
+		return 1U;
+	}
+
+	if (len <= 0xFFU) {
+		head[0] = CBOR_MAJOR_BSTR | 24U;
+		head[1] = (uint8_t)len;
+		return 2U;
+	}
+
+	assert(len <= 0xFFFFU);
+	head[0] = CBOR_MAJOR_BSTR | 25U;
+	head[1] = (uint8_t)(len >> 8);
+	head[2] = (uint8_t)len;
+	return 3U;
+}
+
+size_t attest_cca_token_read(const struct q_useful_buf_c *realm_token,
+			     size_t offset, struct q_useful_buf *buf,
+			     unsigned int *gen)
+{
+	uint8_t bstr_head[CBOR_BSTR_HEAD_MAX];
+	struct q_useful_buf_c parts[3];
+	size_t part_start = 0U;
+	size_t total;
+
+	parts[1].ptr = bstr_head;
+	parts[1].len = encode_bstr_head(realm_token->len, bstr_head);
+	parts[2] = *realm_token;
+
+	spinlock_acquire(&cca_token_head_lock);
+
+	if (offset == 0U) {
+		*gen = cca_token_head_gen;
+	} else if (*gen != cca_token_head_gen) {
+		/* The platform token was refreshed since the first chunk */
+		spinlock_release(&cca_token_head_lock);
+		return 0U;
+	}
+
+	assert(cca_token_head_len != 0U);
+	parts[0].ptr = cca_token_head_buf;
+	parts[0].len = cca_token_head_len;
+	total = parts[0].len + parts[1].len + parts[2].len;
+
+	/* Copy the intersection of each part with the requested window */
+	for (unsigned int i = 0U; i < ARRAY_LEN(parts); i++) {
+		size_t part_end = part_start + parts[i].len;
+		size_t from = (offset > part_start) ? offset : part_start;
+		size_t to = ((offset + buf->len) < part_end) ?
+				(offset + buf->len) : part_end;
+
+		if (from < to) {
+			(void)memcpy((uint8_t *)buf->ptr + (from - offset),
+				     (const uint8_t *)parts[i].ptr +
+						(from - part_start),
+				     to - from);
+		}
+		part_start = part_end;
+	}
+
+	spinlock_release(&cca_token_head_lock);
+
+	return total;
+}
+
+#ifdef RMM_ATTEST_BATCH
+/*
+ * Batched Realm tokens.
+ *
+ * The Realm tokens requested within RMM_ATTEST_BATCH_WINDOW_US of each other,
+ * up to RMM_ATTEST_BATCH of them, form a batch: their payloads are the leaves
+ * of a Merkle tree of which only the root is signed. A batched Realm token is
+ * the CBOR array
+ *
+ *	[ payload : bstr, index : uint, proof : [ + bstr ], root : COSE_Sign1 ]
+ *
+ * where 'proof' holds the sibling of each node on the path from the leaf
+ * 'index' up to the root, and the payload of 'root' holds the EAT_PROFILE,
+ * RMM_BATCH_ROOT and RMM_BATCH_SIZE claims. A leaf is the SHA-256 of 0x00
+ * followed by the payload, a node the SHA-256 of 0x01 followed by its two
+ * children. The leaves after the last token of a batch are zero.
+ *
+ * Once a batch is full or its window has elapsed, the first of its tokens to
+ * notice it closes it and signs its root, with its own signing context, while
+ * the next batch opens. The batches go through the slots of 'batches' in the
+ * order of their generation, so that the tokens of a signed batch can be
+ * completed until its slot is reused three batches later. A token which misses
+ * it, or whose batch is given up by its signer, joins a later batch.
+ */
+#define BATCH_HASH_SIZE		SHA256_SIZE
+#define BATCH_NR_SLOTS		(4U)
+/* Room for the heads of the token array and of the payload byte string */
+#define BATCH_HEAD_ROOM		(1U + CBOR_BSTR_HEAD_MAX)
+#define BATCH_ROOT_TOKEN_SIZE	(256U)
+/* CBOR head of an array of 4 items */
+#define BATCH_TOKEN_HEAD	(0x84U)
+/* Time after which the signing of a batch is given up by its other tokens */
+#define BATCH_SIGN_TIMEOUT_US	(1000000UL)
+
+COMPILER_ASSERT((RMM_ATTEST_BATCH >= 2U) && (RMM_ATTEST_BATCH <= 16U));
+COMPILER_ASSERT(IS_POWER_OF_TWO(RMM_ATTEST_BATCH));
+
+enum batch_state {
+	BATCH_OPEN,
+	BATCH_SIGNING,
+	BATCH_SIGNED,
+	BATCH_ABANDONED
+};
+
+struct attest_batch {
+	unsigned int gen;
+	enum batch_state state;
+	unsigned int nr_leaves;
+	/* End of the window while open, signing timeout once closed */
+	unsigned long deadline;
+	/* Node 1 is the root, node i has nodes 2i and 2i + 1 as children */
+	unsigned char tree[2U * RMM_ATTEST_BATCH][BATCH_HASH_SIZE];
+	unsigned char root_token[BATCH_ROOT_TOKEN_SIZE];
+	size_t root_token_len;
+};
+
+static struct attest_batch batches[BATCH_NR_SLOTS];
+static unsigned int batch_open_gen;
+static spinlock_t batch_lock;
+
+static unsigned long batch_ticks(unsigned long us)
+{
+	return (us * read_cntfrq_el0()) / 1000000UL;
+}
+
+static struct attest_batch *batch_slot(unsigned int gen)
+{
+	return &batches[gen % BATCH_NR_SLOTS];
+}
+
+/* Compute the leaf of the payload of the token of @ctx */
+static void batch_leaf(struct token_sign_ctx *ctx,
+		       const struct q_useful_buf *token_buf,
+		       unsigned char leaf[BATCH_HASH_SIZE])
+{
+	struct measurement_ctx hash_ctx;
+	unsigned char prefix = 0U;
+
+	measurement_ctx_begin(&hash_ctx, HASH_ALGO_SHA256);
+	measurement_ctx_hash_start(&hash_ctx);
+	measurement_ctx_hash_update(&hash_ctx, &prefix, sizeof(prefix));
+	measurement_ctx_hash_update(&hash_ctx,
+				    (uint8_t *)token_buf->ptr + BATCH_HEAD_ROOM,
+				    ctx->batch.payload_len);
+	measurement_ctx_hash_finish(&hash_ctx, leaf);
+	measurement_ctx_end(&hash_ctx);
+}
+
+/* Compute the nodes of the tree of @b above its leaves */
+static void batch_tree_build(struct attest_batch *b)
+{
+	struct measurement_ctx hash_ctx;
+	unsigned char node[1U + (2U * BATCH_HASH_SIZE)];
+
+	node[0] = 1U;
+
+	measurement_ctx_begin(&hash_ctx, HASH_ALGO_SHA256);
+	for (unsigned int i = RMM_ATTEST_BATCH - 1U; i != 0U; i--) {
+		(void)memcpy(&node[1], b->tree[2U * i], 2U * BATCH_HASH_SIZE);
+		measurement_ctx_hash(&hash_ctx, node, sizeof(node), b->tree[i]);
+	}
+	measurement_ctx_end(&hash_ctx);
+}
+
+/* Close the open batch and open the next one. Called with batch_lock held. */
+static void batch_close(struct attest_batch *b)
+{
+	struct attest_batch *next;
+
+	b->state = BATCH_SIGNING;
+	b->deadline = read_cntpct_el0() + batch_ticks(BATCH_SIGN_TIMEOUT_US);
+	batch_tree_build(b);
+
+	batch_open_gen++;
+	next = batch_slot(batch_open_gen);
+	next->gen = batch_open_gen;
+	next->state = BATCH_OPEN;
+	next->nr_leaves = 0U;
+	(void)memset(next->tree, 0, sizeof(next->tree));
+}
+
+/*
+ * Add the token of @ctx to the open batch. Returns false if the batch is
+ * full.
+ */
+static bool batch_join(struct token_sign_ctx *ctx,
+		       const struct q_useful_buf *token_buf)
+{
+	unsigned char leaf[BATCH_HASH_SIZE];
+	struct attest_batch *b;
+	bool joined = false;
+
+	batch_leaf(ctx, token_buf, leaf);
+
+	spinlock_acquire(&batch_lock);
+	b = batch_slot(batch_open_gen);
+	if (b->nr_leaves < RMM_ATTEST_BATCH) {
+		if (b->nr_leaves == 0U) {
+			b->deadline = read_cntpct_el0() +
+				batch_ticks(RMM_ATTEST_BATCH_WINDOW_US);
+		}
+		(void)memcpy(b->tree[RMM_ATTEST_BATCH + b->nr_leaves], leaf,
+			     sizeof(leaf));
+		ctx->batch.gen = batch_open_gen;
+		ctx->batch.index = (unsigned short)b->nr_leaves;
+		b->nr_leaves++;
+		joined = true;
+	}
+	spinlock_release(&batch_lock);
+
+	return joined;
+}
+
+/*
+ * Start the signing of the root of @b, the batch closed by the token of @ctx,
+ * in the part of @token_buf after the payload.
+ */
+static enum attest_token_err_t
+batch_sign_start(struct token_sign_ctx *ctx,
+		 const struct q_useful_buf *token_buf,
+		 const unsigned char root[BATCH_HASH_SIZE],
+		 unsigned int nr_leaves)
+{
+	size_t used = BATCH_HEAD_ROOM + ctx->batch.payload_len;
+	struct q_useful_buf root_buf = {
+		(uint8_t *)token_buf->ptr + used, token_buf->len - used };
+	struct q_useful_buf_c root_value = { root, BATCH_HASH_SIZE };
+	enum attest_token_err_t token_ret;
+
+	token_ret = attest_token_encode_start(&(ctx->ctx),
+					      0,     /* option_flags */
+					      0,     /* key_select */
+					      T_COSE_ALGORITHM_ES384,
+					      &root_buf);
+	if (token_ret != ATTEST_TOKEN_ERR_SUCCESS) {
+		return token_ret;
+	}
+
+	QCBOREncode_AddSZStringToMapN(&(ctx->ctx.cbor_enc_ctx),
+				      EAT_PROFILE, RMM_BATCH_PROFILE);
+	QCBOREncode_AddBytesToMapN(&(ctx->ctx.cbor_enc_ctx),
+				   RMM_BATCH_ROOT, root_value);
+	QCBOREncode_AddUInt64ToMapN(&(ctx->ctx.cbor_enc_ctx),
+				    RMM_BATCH_SIZE, nr_leaves);
+	QCBOREncode_CloseMap(&(ctx->ctx.cbor_enc_ctx));
+
+	ctx->batch.leader = true;
+	return ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS;
+}
+
+/* Run a signing iteration of the root of the batch of @ctx */
+static enum attest_token_err_t batch_sign_continue(struct token_sign_ctx *ctx)
+{
+	struct q_useful_buf_c root_token;
+	enum attest_token_err_t token_ret;
+	struct attest_batch *b;
+
+	token_ret = attest_realm_token_sign(&(ctx->ctx), &root_token);
+	if (token_ret != ATTEST_TOKEN_ERR_SUCCESS) {
+		return token_ret;
+	}
+
+	ctx->batch.leader = false;
+
+	spinlock_acquire(&batch_lock);
+	b = batch_slot(ctx->batch.gen);
+	if ((b->gen == ctx->batch.gen) && (b->state == BATCH_SIGNING) &&
+	    (root_token.len <= sizeof(b->root_token))) {
+		(void)memcpy(b->root_token, root_token.ptr, root_token.len);
+		b->root_token_len = root_token.len;
+		b->state = BATCH_SIGNED;
 	} else {
-		return completed_token.len;
+		/* The batch was given up, join another one */
+		ctx->batch.gen = ATTEST_BATCH_NONE;
 	}
-	return 0;
+	spinlock_release(&batch_lock);
+
+	return ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS;
+}
+
+/*
+ * Complete the token of @ctx with the proof of its leaf in @b and the signed
+ * root of @b. Called with batch_lock held.
+ */
+static enum attest_token_err_t
+batch_token_complete(struct token_sign_ctx *ctx, const struct attest_batch *b,
+		     const struct q_useful_buf *token_buf,
+		     struct q_useful_buf_c *completed_token)
+{
+	size_t used = BATCH_HEAD_ROOM + ctx->batch.payload_len;
+	struct q_useful_buf tail_buf = {
+		(uint8_t *)token_buf->ptr + used, token_buf->len - used };
+	struct q_useful_buf_c root_token = { b->root_token, b->root_token_len };
+	uint8_t payload_head[CBOR_BSTR_HEAD_MAX];
+	QCBOREncodeContext cbor_enc_ctx;
+	struct q_useful_buf_c tail;
+	size_t head_len;
+	uint8_t *token;
+
+	QCBOREncode_Init(&cbor_enc_ctx, tail_buf);
+	QCBOREncode_AddUInt64(&cbor_enc_ctx, ctx->batch.index);
+	QCBOREncode_OpenArray(&cbor_enc_ctx);
+	for (unsigned int i = RMM_ATTEST_BATCH + ctx->batch.index;
+	     i != 1U; i >>= 1U) {
+		struct q_useful_buf_c sibling = {
+			b->tree[i ^ 1U], BATCH_HASH_SIZE };
+
+		QCBOREncode_AddBytes(&cbor_enc_ctx, sibling);
+	}
+	QCBOREncode_CloseArray(&cbor_enc_ctx);
+	QCBOREncode_AddEncoded(&cbor_enc_ctx, root_token);
+
+	if (QCBOREncode_Finish(&cbor_enc_ctx, &tail) != QCBOR_SUCCESS) {
+		return ATTEST_TOKEN_ERR_TOO_SMALL;
+	}
+
+	/* Prepend the heads of the array and of the payload */
+	head_len = encode_bstr_head(ctx->batch.payload_len, payload_head);
+	token = (uint8_t *)token_buf->ptr + BATCH_HEAD_ROOM - head_len - 1U;
+	token[0] = BATCH_TOKEN_HEAD;
+	(void)memcpy(&token[1], payload_head, head_len);
+
+	completed_token->ptr = token;
+	completed_token->len = 1U + head_len + ctx->batch.payload_len +
+			       tail.len;
+	return ATTEST_TOKEN_ERR_SUCCESS;
+}
+
+enum attest_token_err_t
+attest_realm_token_batch_sign(struct token_sign_ctx *ctx,
+			      const struct q_useful_buf *token_buf,
+			      struct q_useful_buf_c *completed_token)
+{
+	enum attest_token_err_t token_ret = ATTEST_TOKEN_ERR_BATCH_WAIT;
+	unsigned char root[BATCH_HASH_SIZE];
+	unsigned int nr_leaves = 0U;
+	struct attest_batch *prev;
+	struct attest_batch *b;
+	unsigned long now;
+
+	assert(ctx != NULL);
+	assert(completed_token != NULL);
+
+	if (ctx->batch.leader) {
+		return batch_sign_continue(ctx);
+	}
+
+	if ((ctx->batch.gen == ATTEST_BATCH_NONE) &&
+	    !batch_join(ctx, token_buf)) {
+		return ATTEST_TOKEN_ERR_BATCH_WAIT;
+	}
+
+	now = read_cntpct_el0();
+
+	spinlock_acquire(&batch_lock);
+	b = batch_slot(ctx->batch.gen);
+	prev = batch_slot(ctx->batch.gen - 1U);
+
+	if (b->gen != ctx->batch.gen) {
+		/* The batch was signed but its slot has been reused */
+		ctx->batch.gen = ATTEST_BATCH_NONE;
+		token_ret = ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS;
+	} else {
+		/* Give up the signing of a batch whose signer is gone */
+		if ((b->state == BATCH_SIGNING) && (now >= b->deadline)) {
+			b->state = BATCH_ABANDONED;
+		}
+
+		switch (b->state) {
+		case BATCH_OPEN:
+			if ((prev->gen == (b->gen - 1U)) &&
+			    (prev->state == BATCH_SIGNING)) {
+				if (now < prev->deadline) {
+					/* One batch is signed at a time */
+					break;
+				}
+				prev->state = BATCH_ABANDONED;
+			}
+
+			if ((b->nr_leaves == RMM_ATTEST_BATCH) ||
+			    (now >= b->deadline)) {
+				batch_close(b);
+				(void)memcpy(root, b->tree[1], sizeof(root));
+				nr_leaves = b->nr_leaves;
+			}
+			break;
+		case BATCH_SIGNING:
+			break;
+		case BATCH_SIGNED:
+			token_ret = batch_token_complete(ctx, b, token_buf,
+							 completed_token);
+			break;
+		case BATCH_ABANDONED:
+			ctx->batch.gen = ATTEST_BATCH_NONE;
+			token_ret = ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS;
+			break;
+		default:
+			assert(false);
+		}
+	}
+	spinlock_release(&batch_lock);
+
+	if (nr_leaves != 0U) {
+		/* The token closed the batch, it signs it */
+		token_ret = batch_sign_start(ctx, token_buf, root, nr_leaves);
+	}
+
+	return token_ret;
+}
+
+void attest_realm_token_batch_abort(struct token_sign_ctx *ctx)
+{
+	struct attest_batch *b;
+
+	if (ctx->batch.leader) {
+		spinlock_acquire(&batch_lock);
+		b = batch_slot(ctx->batch.gen);
+		if ((b->gen == ctx->batch.gen) &&
+		    (b->state == BATCH_SIGNING)) {
+			b->state = BATCH_ABANDONED;
+		}
+		spinlock_release(&batch_lock);
+	}
+
+	ctx->batch.gen = ATTEST_BATCH_NONE;
+	ctx->batch.leader = false;
+}
+#endif /* RMM_ATTEST_BATCH */
+
+/* Labels of the static claims, in the order of enum attest_realm_claim */
+static const int64_t realm_claim_labels[ATTEST_REALM_CLAIM_NR] = {
+	[ATTEST_REALM_CLAIM_RPV] = CCA_REALM_PERSONALIZATION_VALUE,
+	[ATTEST_REALM_CLAIM_PUB_KEY] = CCA_REALM_PUB_KEY,
+	[ATTEST_REALM_CLAIM_HASH_ALGO_ID] = CCA_REALM_HASH_ALGM_ID,
+	[ATTEST_REALM_CLAIM_PUB_KEY_HASH_ALGO_ID] =
+					CCA_REALM_PUB_KEY_HASH_ALGO_ID,
+	[ATTEST_REALM_CLAIM_RIM] = CCA_REALM_INITIAL_MEASUREMENT
+};
+
+/*
+ * Encode the value of the claim @claim as a byte or text string, right
+ * after the value of the previous claim.
+ */
+static int encode_realm_claim(struct attest_realm_claims *claims,
+			      enum attest_realm_claim claim,
+			      bool is_text,
+			      struct q_useful_buf_c value)
+{
+	QCBOREncodeContext cbor_enc_ctx;
+	struct q_useful_buf_c encoded;
+	size_t start = (claim == ATTEST_REALM_CLAIM_RPV) ? 0U :
+						claims->end[claim - 1];
+	struct q_useful_buf buf = {
+		&claims->buf[start], sizeof(claims->buf) - start};
+
+	QCBOREncode_Init(&cbor_enc_ctx, buf);
+
+	if (is_text) {
+		QCBOREncode_AddText(&cbor_enc_ctx, value);
+	} else {
+		QCBOREncode_AddBytes(&cbor_enc_ctx, value);
+	}
+
+	if (QCBOREncode_Finish(&cbor_enc_ctx, &encoded) != QCBOR_SUCCESS) {
+		return ATTEST_TOKEN_ERR_TOO_SMALL;
+	}
+
+	claims->end[claim] = (unsigned short)(start + encoded.len);
+	return ATTEST_TOKEN_ERR_SUCCESS;
+}
+
+int attest_realm_claims_create(enum hash_algo algorithm,
+			       unsigned char *rim,
+			       struct q_useful_buf_c *rpv,
+			       struct attest_realm_claims *claims)
+{
+	struct q_useful_buf_c buf;
+	int ret;
+
+	assert((rim != NULL) && (rpv != NULL) && (claims != NULL));
+
+	ret = encode_realm_claim(claims, ATTEST_REALM_CLAIM_RPV, false, *rpv);
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = attest_get_realm_public_key(&buf);
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = encode_realm_claim(claims, ATTEST_REALM_CLAIM_PUB_KEY, false,
+				 buf);
+	if (ret != 0) {
+		return ret;
+	}
+
+	attest_get_hash_algo_text(algorithm, &buf);
+	ret = encode_realm_claim(claims, ATTEST_REALM_CLAIM_HASH_ALGO_ID, true,
+				 buf);
+	if (ret != 0) {
+		return ret;
+	}
+
+	attest_get_hash_algo_text(attest_get_realm_public_key_hash_algo_id(),
+				  &buf);
+	ret = encode_realm_claim(claims,
+				 ATTEST_REALM_CLAIM_PUB_KEY_HASH_ALGO_ID, true,
+				 buf);
+	if (ret != 0) {
+		return ret;
+	}
+
+	buf.ptr = rim;
+	buf.len = measurement_get_size(algorithm);
+	return encode_realm_claim(claims, ATTEST_REALM_CLAIM_RIM, false, buf);
 }
 
 /*
@@ -241,24 +801,44 @@ size_t attest_cca_token_create(struct q_useful_buf         *attest_token_buf,
  *	- Realm Public Key Hash Algorithm Id
  *	- Realm Initial Measurement
  *	- Realm Extensible Measurements
+ *
+ * All but the challenge and the REMs are copied already encoded from
+ * @claims.
  */
 int attest_realm_token_create(enum hash_algo algorithm,
 			     unsigned char measurements[][MAX_MEASUREMENT_SIZE],
 			     unsigned int num_measurements,
-			     struct q_useful_buf_c *rpv,
+			     const struct attest_realm_claims *claims,
 			     struct token_sign_ctx *ctx,
 			     struct q_useful_buf *realm_token_buf)
 {
 	struct q_useful_buf_c buf;
 	size_t measurement_size;
+	size_t start = 0U;
+#ifdef RMM_ATTEST_BATCH
+	struct q_useful_buf payload_buf = {
+		(uint8_t *)realm_token_buf->ptr + BATCH_HEAD_ROOM,
+		realm_token_buf->len - BATCH_HEAD_ROOM };
+	struct q_useful_buf_c payload;
+#else
 	enum attest_token_err_t token_ret;
-	int ret;
+#endif
 
 	/* Can only be called in the init state */
 	assert(ctx->state == ATTEST_SIGN_NOT_STARTED);
 
 	assert(num_measurements == MEASUREMENT_SLOT_NR);
 
+#ifdef RMM_ATTEST_BATCH
+	/*
+	 * The payload is signed as part of a batch, open it on its own. The
+	 * profile claim tells the verifier how to check the token.
+	 */
+	QCBOREncode_Init(&(ctx->ctx.cbor_enc_ctx), payload_buf);
+	QCBOREncode_OpenMap(&(ctx->ctx.cbor_enc_ctx));
+	QCBOREncode_AddSZStringToMapN(&(ctx->ctx.cbor_enc_ctx),
+				      EAT_PROFILE, RMM_BATCH_PROFILE);
+#else
 	/*
 	 * Get started creating the token. This sets up the CBOR and COSE
 	 * contexts which causes the COSE headers to be constructed.
@@ -271,6 +851,7 @@ int attest_realm_token_create(enum hash_algo algorithm,
 	if (token_ret != ATTEST_TOKEN_ERR_SUCCESS) {
 		return token_ret;
 	}
+#endif
 
 	/* Add challenge value, which is the only input from the caller. */
 	buf.ptr = ctx->challenge;
@@ -279,40 +860,19 @@ int attest_realm_token_create(enum hash_algo algorithm,
 				   CCA_REALM_CHALLENGE,
 				   buf);
 
-	QCBOREncode_AddBytesToMapN(&(ctx->ctx.cbor_enc_ctx),
-				   CCA_REALM_PERSONALIZATION_VALUE,
-				   *rpv);
-
-	ret = attest_get_realm_public_key(&buf);
-	if (ret != 0) {
-		return ret;
+	for (unsigned int i = 0U; i < (unsigned int)ATTEST_REALM_CLAIM_NR; i++) {
+		buf.ptr = &claims->buf[start];
+		buf.len = claims->end[i] - start;
+		QCBOREncode_AddEncodedToMapN(&(ctx->ctx.cbor_enc_ctx),
+					     realm_claim_labels[i],
+					     buf);
+		start = claims->end[i];
 	}
 
-	QCBOREncode_AddBytesToMapN(&(ctx->ctx.cbor_enc_ctx),
-				   CCA_REALM_PUB_KEY,
-				   buf);
-
-	attest_get_hash_algo_text(algorithm, &buf);
-	QCBOREncode_AddTextToMapN(&(ctx->ctx.cbor_enc_ctx),
-				  CCA_REALM_HASH_ALGM_ID,
-				  buf);
-
-	attest_get_hash_algo_text(attest_get_realm_public_key_hash_algo_id(),
-				  &buf);
-	QCBOREncode_AddTextToMapN(&(ctx->ctx.cbor_enc_ctx),
-				  CCA_REALM_PUB_KEY_HASH_ALGO_ID,
-				  buf);
-
 	measurement_size = measurement_get_size(algorithm);
 	assert(measurement_size <= MAX_MEASUREMENT_SIZE);
 
-	/* RIM: 0, REM: 1..4 */
-	buf.ptr = &measurements[RIM_MEASUREMENT_SLOT];
-	buf.len = measurement_size;
-	QCBOREncode_AddBytesToMapN(&(ctx->ctx.cbor_enc_ctx),
-				   CCA_REALM_INITIAL_MEASUREMENT,
-				   buf);
-
+	/* REM: 1..4 */
 	QCBOREncode_OpenArrayInMapN(&(ctx->ctx.cbor_enc_ctx),
 				    CCA_REALM_EXTENSIBLE_MEASUREMENTS);
 
@@ -325,5 +885,17 @@ int attest_realm_token_create(enum hash_algo algorithm,
 	QCBOREncode_CloseArray(&(ctx->ctx.cbor_enc_ctx));
 	QCBOREncode_CloseMap(&(ctx->ctx.cbor_enc_ctx));
 
+#ifdef RMM_ATTEST_BATCH
+	if (QCBOREncode_Finish(&(ctx->ctx.cbor_enc_ctx), &payload) !=
+	    QCBOR_SUCCESS) {
+		return ATTEST_TOKEN_ERR_TOO_SMALL;
+	}
+
+	/* The token joins a batch on its first signing iteration */
+	ctx->batch.gen = ATTEST_BATCH_NONE;
+	ctx->batch.payload_len = (unsigned short)payload.len;
+	ctx->batch.leader = false;
+#endif
+
 	return ATTEST_TOKEN_ERR_SUCCESS;
 }
@@ -6,13 +6,16 @@
 #include <assert.h>
 #include <attestation.h>
 #include <attestation_priv.h>
+#include <boot_phase.h>
 #include <debug.h>
 #include <errno.h>
 #include <fpu_helpers.h>
 #include <mbedtls/ecp.h>
 #include <mbedtls/memory_buffer_alloc.h>
+#include <memory.h>
 #include <memory_alloc.h>
 #include <sizes.h>
+#include <spinlock.h>
 
 /*
  * Memory buffer for the allocator during key initialization.
@@ -37,11 +40,17 @@
 static unsigned char mem_buf[INIT_HEAP_PAGES * SZ_4K]
 					__aligned(sizeof(unsigned long));
 
-static bool attest_initialized;
+/* Progress of attestation_init_once(), read without attest_init_lock */
+#define ATTEST_INIT_PENDING	0UL
+#define ATTEST_INIT_DONE	1UL
+#define ATTEST_INIT_FAILED	2UL
+
+static uint64_t attest_init_state = ATTEST_INIT_PENDING;
+static spinlock_t attest_init_lock;
 
 struct buffer_alloc_ctx init_ctx;
 
-int attestation_init(void)
+static int attestation_init(void)
 {
 	int ret;
 
@@ -63,37 +72,78 @@ int attestation_init(void)
 	 */
 	FPU_ALLOW(mbedtls_ecp_set_max_ops(ECP_MAX_OPS));
 
+	boot_phase_start(BOOT_PHASE_PRNG);
 	FPU_ALLOW(ret = attest_rnd_prng_init());
-	if (ret != 0) {
-		return ret;
-	}
 
 	/* Retrieve the platform key from root world */
-	FPU_ALLOW(ret = attest_init_realm_attestation_key());
-	if (ret != 0) {
-		return ret;
+	if (ret == 0) {
+		boot_phase_end(BOOT_PHASE_PRNG);
+		boot_phase_start(BOOT_PHASE_ATTEST_KEY);
+		FPU_ALLOW(ret = attest_init_realm_attestation_key());
 	}
 
 	fpu_restore_my_state();
 
 	/* Retrieve the platform token from root world */
-	ret = attest_setup_platform_token();
-	if (ret != 0) {
-		return ret;
+	if (ret == 0) {
+		boot_phase_end(BOOT_PHASE_ATTEST_KEY);
+		boot_phase_start(BOOT_PHASE_PLAT_TOKEN);
+		ret = attest_setup_platform_token();
+	}
+
+	if (ret == 0) {
+		boot_phase_end(BOOT_PHASE_PLAT_TOKEN);
 	}
 
 	buffer_alloc_ctx_unassign();
 
-	attest_initialized = true;
+	return ret;
+}
 
-	return 0;
+/*
+ * Derive the Realm attestation key, seed the PRNGs and get the platform token
+ * on the first use of attestation, rather than during the cold boot of RMM,
+ * so that the Host does not wait for them until a Realm needs them. The
+ * outcome is final: a failed initialisation is not retried.
+ *
+ * Must be called with no buffer_alloc_ctx assigned to this CPU.
+ */
+bool attestation_init_once(void)
+{
+	uint64_t state = SCA_READ64_ACQUIRE(&attest_init_state);
+
+	if (state != ATTEST_INIT_PENDING) {
+		return (state == ATTEST_INIT_DONE);
+	}
+
+	spinlock_acquire(&attest_init_lock);
+
+	state = SCA_READ64(&attest_init_state);
+	if (state == ATTEST_INIT_PENDING) {
+		if (attestation_init() == 0) {
+			state = ATTEST_INIT_DONE;
+		} else {
+			WARN("Attestation init failed.\n");
+			state = ATTEST_INIT_FAILED;
+		}
+		SCA_WRITE64_RELEASE(&attest_init_state, state);
+	}
+
+	spinlock_release(&attest_init_lock);
+
+	return (state == ATTEST_INIT_DONE);
+}
+
+static bool attest_initialized(void)
+{
+	return (SCA_READ64_ACQUIRE(&attest_init_state) == ATTEST_INIT_DONE);
 }
 
 int attestation_heap_ctx_init(unsigned char *buf, size_t buf_size)
 {
 	assert(buf != NULL);
 
-	if (attest_initialized == false) {
+	if (!attest_initialized()) {
 		return -EINVAL;
 	}
 
@@ -109,7 +159,7 @@ int attestation_heap_ctx_assign_pe(struct buffer_alloc_ctx *ctx)
 {
 	assert(ctx != NULL);
 
-	if (attest_initialized == false) {
+	if (!attestation_init_once()) {
 		return -EINVAL;
 	}
 
@@ -124,7 +174,7 @@ int attestation_heap_ctx_unassign_pe(struct buffer_alloc_ctx *ctx)
 {
 	assert(ctx != NULL);
 
-	if (attest_initialized == false) {
+	if (!attest_initialized()) {
 		return -EINVAL;
 	}
 
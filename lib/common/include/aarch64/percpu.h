@@ -0,0 +1,66 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <utils_def.h>
+
+/*
+ * The per-CPU variables are placed in the percpu_data section, which holds
+ * the copy of CPU 0. The linker script places it at the end of the RMM
+ * image, followed by the stack of CPU 0, and the copies of the other CPUs
+ * follow at a stride of percpu_end - percpu_start. Only the copies of the
+ * CPUs reported by EL3 at boot are backed by memory and mapped.
+ */
+extern unsigned long percpu_start;
+extern unsigned long percpu_data_end;
+extern unsigned long percpu_end;
+
+static inline uintptr_t percpu_stride(void)
+{
+	return (uintptr_t)&percpu_end - (uintptr_t)&percpu_start;
+}
+
+/*
+ * Zero the per-CPU variables of CPUs 1 to @num_cpus - 1, those of CPU 0 being
+ * zeroed with the BSS. This must be called during cold boot, with the MMU
+ * disabled, before any other CPU boots.
+ */
+static inline void percpu_init(unsigned long num_cpus)
+{
+	uintptr_t start = (uintptr_t)&percpu_start;
+	size_t size = (uintptr_t)&percpu_data_end - start;
+
+	for (unsigned long cpu = 1UL; cpu < num_cpus; cpu++) {
+		(void)memset((void *)(start + (cpu * percpu_stride())), 0, size);
+	}
+}
+
+/* Lowest address of the stack of CPU @cpu */
+static inline uintptr_t percpu_stack_base(unsigned int cpu)
+{
+	return (uintptr_t)&percpu_data_end + ((uintptr_t)cpu * percpu_stride());
+}
+
+/* Address above the top of the stack of CPU @cpu */
+static inline uintptr_t percpu_stack_top(unsigned int cpu)
+{
+	return (uintptr_t)&percpu_end + ((uintptr_t)cpu * percpu_stride());
+}
+
+/* Define a per-CPU variable of type @_type */
+#define DEFINE_PER_CPU(_type, _name)					\
+	__typeof__(_type) _name __section("percpu_data")
+
+/* The copy of the per-CPU variable @_name of CPU @_cpu, as an lvalue */
+#define per_cpu(_name, _cpu)						\
+	(*(__typeof__(&(_name)))((uintptr_t)&(_name) +			\
+				 ((uintptr_t)(_cpu) * percpu_stride())))
+
+#endif /* PERCPU_H */
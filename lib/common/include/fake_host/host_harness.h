@@ -91,4 +91,31 @@ void *host_buffer_arch_map(enum buffer_slot slot,
  */
 void host_buffer_arch_unmap(void *buf);
 
+/*
+ * Classes of the operations which are no-ops on the fake host but costly on
+ * hardware, counted when the platform is built with HOST_COST_MODEL.
+ */
+enum host_cost_op {
+	HOST_COST_TLBI,
+	HOST_COST_DSB,
+	HOST_COST_DMB,
+	HOST_COST_ISB,
+	HOST_COST_DC,
+	HOST_COST_AT,
+	HOST_COST_SLOT_MAP,
+	HOST_COST_OTHER,
+	HOST_COST_NR_OPS
+};
+
+#ifdef HOST_COST_MODEL
+/*
+ * Fake host hook to count one operation of class @op.
+ */
+void host_cost_add(enum host_cost_op op);
+
+#define HOST_COST(_op)		host_cost_add(_op)
+#else
+#define HOST_COST(_op)
+#endif
+
 #endif /* HOST_HARNESS_H */
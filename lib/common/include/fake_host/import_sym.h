@@ -16,6 +16,11 @@
 #define rmm_ro_end	0x40000000UL
 #define rmm_rw_start	0x40000000UL
 #define rmm_rw_end	0x50000000UL
+#define rmm_granules_start	0x50000000UL
+#define rmm_granules_end	0x60000000UL
+#define percpu_start	0x60000000UL
+#define percpu_end	0x60001000UL
+#define rmm_limit	0x60100000UL
 
 /*
  * Emulates the import of an assembly or linker symbol as a C expression
@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include <stdint.h>
+
+/*
+ * The per-CPU variables of the fake_host build are arrays of MAX_CPUS
+ * elements, as the host has no per-CPU area to place them in.
+ */
+#define DEFINE_PER_CPU(_type, _name)	__typeof__(_type) _name[MAX_CPUS]
+
+#define per_cpu(_name, _cpu)		((_name)[(_cpu)])
+
+static inline void percpu_init(unsigned long num_cpus)
+{
+	(void)num_cpus;
+}
+
+/* The stacks of the fake_host build are the ones of the host threads */
+static inline uintptr_t percpu_stack_base(unsigned int cpu)
+{
+	(void)cpu;
+	return 0UL;
+}
+
+static inline uintptr_t percpu_stack_top(unsigned int cpu)
+{
+	(void)cpu;
+	return 0UL;
+}
+
+#endif /* PERCPU_H */
@@ -26,4 +26,11 @@ unsigned long plat_granule_addr_to_idx(unsigned long addr);
  */
 unsigned long plat_granule_idx_to_addr(unsigned long idx);
 
+/*
+ * Sends the log output buffered by the platform console, if any, as far as
+ * it can be done without waiting for the console. This is called at the
+ * end of each RMI call.
+ */
+void plat_console_drain(void);
+
 #endif /* PLATFORM_API_H */
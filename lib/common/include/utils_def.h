@@ -43,6 +43,19 @@
 #define __unused	__attribute__((__unused__))
 #define __aligned(x)	__attribute__((__aligned__(x)))
 #define __section(x)	__attribute__((__section__(x)))
+#ifndef __always_inline
+#define __always_inline	inline __attribute__((__always_inline__))
+#endif
+
+/*
+ * Code and read-mostly data of the REC entry and exit paths and of the RMI
+ * dispatch, placed together by the linker script so that these paths touch
+ * as few pages and cache lines as possible. Data written concurrently by
+ * several CPUs does not belong there.
+ */
+#define __hot_text	__section(".text.hot")
+#define __hot_rodata	__section(".rodata.hot")
+#define __hot_bss	__section(".bss.hot")
 
 #define __printflike(fmtarg, firstvararg) \
 		__attribute__((__format__ (__printf__, fmtarg, firstvararg)))
@@ -128,10 +141,26 @@
 #define ALIGNED(_size, _alignment) (((unsigned long)(_size) % (_alignment)) == UL(0))
 
 #define GRANULE_ALIGNED(_addr) ALIGNED((void *)(_addr), GRANULE_SIZE)
+/*
+ * The stage 2 translation granule of the Realms, which all of the RTT
+ * geometry derives from, is the RMM granule.
+ */
+#if GRANULE_SIZE == 4096U
 #define GRANULE_SHIFT	(UL(12))
-#define GRANULE_MASK	(~0xfffUL)
+#elif GRANULE_SIZE == 16384U
+#define GRANULE_SHIFT	(UL(14))
+#elif GRANULE_SIZE == 65536U
+#define GRANULE_SHIFT	(UL(16))
+#else
+#error "Unsupported GRANULE_SIZE"
+#endif
+#define GRANULE_MASK	(~(GRANULE_SIZE - 1UL))
 
+#ifdef RMM_MPAM
+#define HAS_MPAM 1
+#else
 #define HAS_MPAM 0
+#endif
 
 #if HAS_MPAM
 #define MPAM(_x...) _x
@@ -139,7 +168,23 @@
 #define MPAM(_x...)
 #endif
 
+#ifdef RMM_MEC
+#define HAS_MEC 1
+#else
+#define HAS_MEC 0
+#endif
+
+#if HAS_MEC
+#define MEC(_x...) _x
+#else
+#define MEC(_x...)
+#endif
+
+#ifdef RMM_SPE
+#define HAS_SPE 1
+#else
 #define HAS_SPE 0
+#endif
 
 #if HAS_SPE
 #define SPE(_x...) _x
@@ -147,6 +192,18 @@
 #define SPE(_x...)
 #endif
 
+#ifdef RMM_PAUTH
+#define HAS_PAUTH 1
+#else
+#define HAS_PAUTH 0
+#endif
+
+#if HAS_PAUTH
+#define PAUTH(_x...) _x
+#else
+#define PAUTH(_x...)
+#endif
+
 #if !(defined(__ASSEMBLER__) || defined(__LINKER__))
 
 /*
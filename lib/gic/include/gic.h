@@ -138,6 +138,13 @@
 #define ICH_LR_PRIORITY_WIDTH		UL(8)
 #define ICH_LR_PRIORITY_MASK		MASK(ICH_LR_PRIORITY)
 
+/*
+ * Priority of the interrupts injected by RMM. The Host does not tell RMM the
+ * priority it would have used, so this is the usual default of a Group 1
+ * interrupt.
+ */
+#define GIC_INJECT_PRIORITY		UL(0xa0)
+
 /* The group for this virtual interrupt */
 #define ICH_LR_GROUP_SHIFT		UL(60)
 #define ICH_LR_GROUP_BIT		INPLACE(ICH_LR_GROUP, UL(1))
@@ -226,6 +233,23 @@ struct gic_cpu_state {
 	unsigned long ich_lr_el2[ICH_MAX_LRS];	/* RecRun in/out */
 	/* GICv3 Maintenance Interrupt State Register */
 	unsigned long ich_misr_el2;		/* RecRun out */
+
+	/* Bitmap of the List Registers loaded with an interrupt on entry */
+	unsigned long lrs_in_use;
+	/* At least one Active Priorities Register was non-zero on entry */
+	bool aprs_in_use;
+
+	/*
+	 * Bitmap of the List Registers changed by the Host since they were
+	 * last validated, see gic_validate_state()
+	 */
+	unsigned long lrs_unchecked;
+
+	/*
+	 * Maintenance interrupts enabled in ICH_HCR_EL2 by RMM while the REC
+	 * runs, which the Host did not enable, see gic_inject_lrs()
+	 */
+	unsigned long hcr_local;
 };
 
 struct rmi_rec_entry;
@@ -238,7 +262,44 @@ void gic_copy_state_from_ns(struct gic_cpu_state *gicstate,
 void gic_copy_state_to_ns(struct gic_cpu_state *gicstate,
 			  struct rmi_rec_exit *rec_exit);
 bool gic_validate_state(struct gic_cpu_state *gicstate);
+
+/*
+ * Validate the @nr LR values in @lrs queued by the Host, see
+ * REC_ENTRY_FLAG_VIRQ_QUEUE. Each one must be a valid LR value holding a
+ * pending interrupt.
+ */
+bool gic_validate_lrs(const unsigned long *lrs, unsigned int nr);
 void gic_restore_state(struct gic_cpu_state *gicstate);
 void gic_save_state(struct gic_cpu_state *gicstate);
 
+/*
+ * Make the interrupt @intid pending in the LRs of the running REC, see
+ * REC_ENTRY_FLAG_TIMER_LOCAL and REC_ENTRY_FLAG_SGI_LOCAL. Returns false if
+ * no LR is free.
+ */
+bool gic_inject_virq(struct gic_cpu_state *gicstate, unsigned int intid);
+
+/*
+ * Make the level-sensitive PPI @intid no longer pending in the LRs of the
+ * running REC, see REC_ENTRY_FLAG_TIMER_LOCAL.
+ */
+void gic_retire_ppi(struct gic_cpu_state *gicstate, unsigned int intid);
+
+/*
+ * Inject the interrupts of the @nr LR values in @lrs, in order, into the free
+ * LRs of the running REC. Returns the number of LR values consumed, which
+ * stops at the first one for which no LR is free. While some are left, the
+ * underflow maintenance interrupt is enabled so that RMM can inject them
+ * when the REC frees its LRs, see gic_is_local_maintenance().
+ */
+unsigned int gic_inject_lrs(struct gic_cpu_state *gicstate,
+			    const unsigned long *lrs, unsigned int nr);
+
+/*
+ * Returns true if the maintenance interrupt of the running REC is only
+ * caused by the conditions enabled by gic_inject_lrs(), and not by the ones
+ * enabled by the Host.
+ */
+bool gic_is_local_maintenance(struct gic_cpu_state *gicstate);
+
 #endif /* GIC_H */
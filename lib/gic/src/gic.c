@@ -11,28 +11,11 @@
 #include <stdbool.h>
 #include <string.h>
 
-/* The macros below fall through to case (n - 1) */
-#define READ_ICH_LR_EL2(n)	{				\
-	case n:							\
-	gicstate->ich_lr_el2[n] = read_ich_lr##n##_el2();	\
-	}
-
-#define WRITE_ICH_LR_EL2(n)	{			\
-	case n:						\
-	write_ich_lr##n##_el2(gicstate->ich_lr_el2[n]);	\
-	}
-
-#define READ_ICH_APR_EL2(n)	{				\
-	case n:							\
-	gicstate->ich_ap0r_el2[n] = read_ich_ap0r##n##_el2();	\
-	gicstate->ich_ap1r_el2[n] = read_ich_ap1r##n##_el2();	\
-	}
+/* The macros below expand to one case of a switch on the register index */
+#define READ_ICH_REG_EL2(reg, n)	case n: return read_ich_##reg##n##_el2()
 
-#define WRITE_ICH_APR_EL2(n)	{				\
-	case n:							\
-	write_ich_ap0r##n##_el2(gicstate->ich_ap0r_el2[n]);	\
-	write_ich_ap1r##n##_el2(gicstate->ich_ap1r_el2[n]);	\
-	}
+#define WRITE_ICH_REG_EL2(reg, n, val)	\
+	case n: write_ich_##reg##n##_el2(val); break
 
 /* GIC virtualization features */
 struct gic_virt_feature_s {
@@ -127,14 +110,21 @@ void gic_cpu_state_init(struct gic_cpu_state *gicstate)
 		ICH_HCR_EL2_DVIM_BIT;	/* Direct-injection not supported */
 }
 
+__hot_text
 void gic_copy_state_from_ns(struct gic_cpu_state *gicstate,
 			    struct rmi_rec_entry *rec_entry)
 {
 	unsigned int i;
 
-	/* Copy List Registers */
+	/*
+	 * Copy List Registers. The ones which still hold the value returned to
+	 * the Host on the last REC exit need not be validated again.
+	 */
 	for (i = 0U; i <= gic_virt_feature.nr_lrs; i++) {
-		gicstate->ich_lr_el2[i] = rec_entry->gicv3_lrs[i];
+		if (gicstate->ich_lr_el2[i] != rec_entry->gicv3_lrs[i]) {
+			gicstate->ich_lr_el2[i] = rec_entry->gicv3_lrs[i];
+			gicstate->lrs_unchecked |= (1UL << i);
+		}
 	}
 
 	/* Get bits from NS hypervisor */
@@ -142,6 +132,7 @@ void gic_copy_state_from_ns(struct gic_cpu_state *gicstate,
 	gicstate->ich_hcr_el2 |= rec_entry->gicv3_hcr & ICH_HCR_EL2_NS_MASK;
 }
 
+__hot_text
 void gic_copy_state_to_ns(struct gic_cpu_state *gicstate,
 			  struct rmi_rec_exit *rec_exit)
 {
@@ -176,132 +167,429 @@ static bool is_valid_vintid(unsigned long intid)
 		false);
 }
 
+/* Check the fields of the valid LR value @lr written by the Host */
+static bool is_valid_lr(unsigned long lr)
+{
+	/* The RMM Specification imposes the constraint that HW == '0' */
+	return (EXTRACT_BIT(ICH_LR_HW, lr) == 0UL) &&
+		/* Check RES0 bits in the Priority field */
+		((EXTRACT(ICH_LR_PRIORITY, lr) &
+			gic_virt_feature.pri_res0_mask) == 0UL) &&
+		/* Only the EOI bit in the pINTID is allowed to be set */
+		((lr & ICH_LR_PINTID_MASK & ~ICH_LR_EOI_BIT) == 0UL) &&
+		/* Check if vINTID is in the valid range */
+		is_valid_vintid(EXTRACT(ICH_LR_VINTID, lr));
+}
+
+/*
+ * Validate the List Registers changed by the Host since the last REC exit.
+ * The other ones were validated on a previous REC entry, and since then only
+ * the REC and RMM changed them without creating two LRs for one vINTID, so
+ * each vINTID duplicated in the LRs is held by at least one changed LR.
+ */
 bool gic_validate_state(struct gic_cpu_state *gicstate)
 {
+	unsigned long unchecked = gicstate->lrs_unchecked;
 	unsigned int i, j;
 
-	for (i = 0U; i <= gic_virt_feature.nr_lrs; i++) {
-		unsigned long lr = gicstate->ich_lr_el2[i];
-		unsigned long intid = EXTRACT(ICH_LR_VINTID, lr);
+	while (unchecked != 0UL) {
+		unsigned long lr, intid;
+
+		i = (unsigned int)__builtin_ctzl(unchecked);
+		unchecked &= unchecked - 1UL;
+
+		lr = gicstate->ich_lr_el2[i];
+		intid = EXTRACT(ICH_LR_VINTID, lr);
 
 		if ((lr & ICH_LR_STATE_MASK) == ICH_LR_STATE_INVALID) {
 			continue;
 		}
 
-		/* The RMM Specification imposes the constraint that HW == '0' */
-		if ((EXTRACT_BIT(ICH_LR_HW, lr) != 0UL) ||
-		    /* Check RES0 bits in the Priority field */
-		   ((EXTRACT(ICH_LR_PRIORITY, lr) &
-			gic_virt_feature.pri_res0_mask) != 0UL) ||
-		    /* Only the EOI bit in the pINTID is allowed to be set */
-		   ((lr & ICH_LR_PINTID_MASK & ~ICH_LR_EOI_BIT) != 0UL) ||
-		    /* Check if vINTID is in the valid range */
-		   !is_valid_vintid(intid)) {
+		if (!is_valid_lr(lr)) {
 			return false;
 		}
 
 		/*
 		 * Behavior is UNPREDICTABLE if two or more List Registers
-		 * specify the same vINTID.
+		 * specify the same vINTID. A pair of changed LRs is compared
+		 * once, when checking the lower one.
 		 */
-		for (j = i + 1U; j <= gic_virt_feature.nr_lrs; j++) {
+		for (j = 0U; j <= gic_virt_feature.nr_lrs; j++) {
 			unsigned long _lr = gicstate->ich_lr_el2[j];
-			unsigned long _intid = EXTRACT(ICH_LR_VINTID, _lr);
 
 			if ((_lr & ICH_LR_STATE_MASK) == ICH_LR_STATE_INVALID) {
 				continue;
 			}
 
-			if (intid == _intid) {
+			if ((j == i) ||
+			    ((j < i) &&
+			     ((gicstate->lrs_unchecked & (1UL << j)) != 0UL))) {
+				continue;
+			}
+
+			if (EXTRACT(ICH_LR_VINTID, _lr) == intid) {
 				return false;
 			}
 		}
 	}
 
+	/* The LRs are checked again on the next entry if one is invalid */
+	gicstate->lrs_unchecked = 0UL;
 	return true;
 }
 
-/* Save ICH_LR<n>_EL2 registers [n...0] */
-static void read_lrs(struct gic_cpu_state *gicstate)
+bool gic_validate_lrs(const unsigned long *lrs, unsigned int nr)
 {
-	switch (gic_virt_feature.nr_lrs) {
-	READ_ICH_LR_EL2(15);
-	READ_ICH_LR_EL2(14);
-	READ_ICH_LR_EL2(13);
-	READ_ICH_LR_EL2(12);
-	READ_ICH_LR_EL2(11);
-	READ_ICH_LR_EL2(10);
-	READ_ICH_LR_EL2(9);
-	READ_ICH_LR_EL2(8);
-	READ_ICH_LR_EL2(7);
-	READ_ICH_LR_EL2(6);
-	READ_ICH_LR_EL2(5);
-	READ_ICH_LR_EL2(4);
-	READ_ICH_LR_EL2(3);
-	READ_ICH_LR_EL2(2);
-	READ_ICH_LR_EL2(1);
+	for (unsigned int i = 0U; i < nr; i++) {
+		if (((lrs[i] & ICH_LR_STATE_MASK) != ICH_LR_STATE_PENDING) ||
+		    !is_valid_lr(lrs[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static unsigned long read_lr(unsigned int n)
+{
+	switch (n) {
+	READ_ICH_REG_EL2(lr, 0);
+	READ_ICH_REG_EL2(lr, 1);
+	READ_ICH_REG_EL2(lr, 2);
+	READ_ICH_REG_EL2(lr, 3);
+	READ_ICH_REG_EL2(lr, 4);
+	READ_ICH_REG_EL2(lr, 5);
+	READ_ICH_REG_EL2(lr, 6);
+	READ_ICH_REG_EL2(lr, 7);
+	READ_ICH_REG_EL2(lr, 8);
+	READ_ICH_REG_EL2(lr, 9);
+	READ_ICH_REG_EL2(lr, 10);
+	READ_ICH_REG_EL2(lr, 11);
+	READ_ICH_REG_EL2(lr, 12);
+	READ_ICH_REG_EL2(lr, 13);
+	READ_ICH_REG_EL2(lr, 14);
+	READ_ICH_REG_EL2(lr, 15);
 	default:
-	READ_ICH_LR_EL2(0);
+		assert(false);
+		return 0UL;
 	}
 }
 
-/* Restore ICH_LR<n>_EL2 registers [n...0] */
-static void write_lrs(struct gic_cpu_state *gicstate)
+static void write_lr(unsigned int n, unsigned long val)
+{
+	switch (n) {
+	WRITE_ICH_REG_EL2(lr, 0, val);
+	WRITE_ICH_REG_EL2(lr, 1, val);
+	WRITE_ICH_REG_EL2(lr, 2, val);
+	WRITE_ICH_REG_EL2(lr, 3, val);
+	WRITE_ICH_REG_EL2(lr, 4, val);
+	WRITE_ICH_REG_EL2(lr, 5, val);
+	WRITE_ICH_REG_EL2(lr, 6, val);
+	WRITE_ICH_REG_EL2(lr, 7, val);
+	WRITE_ICH_REG_EL2(lr, 8, val);
+	WRITE_ICH_REG_EL2(lr, 9, val);
+	WRITE_ICH_REG_EL2(lr, 10, val);
+	WRITE_ICH_REG_EL2(lr, 11, val);
+	WRITE_ICH_REG_EL2(lr, 12, val);
+	WRITE_ICH_REG_EL2(lr, 13, val);
+	WRITE_ICH_REG_EL2(lr, 14, val);
+	WRITE_ICH_REG_EL2(lr, 15, val);
+	default:
+		assert(false);
+	}
+}
+
+static unsigned long read_ap0r(unsigned int n)
+{
+	switch (n) {
+	READ_ICH_REG_EL2(ap0r, 0);
+	READ_ICH_REG_EL2(ap0r, 1);
+	READ_ICH_REG_EL2(ap0r, 2);
+	READ_ICH_REG_EL2(ap0r, 3);
+	default:
+		assert(false);
+		return 0UL;
+	}
+}
+
+static void write_ap0r(unsigned int n, unsigned long val)
+{
+	switch (n) {
+	WRITE_ICH_REG_EL2(ap0r, 0, val);
+	WRITE_ICH_REG_EL2(ap0r, 1, val);
+	WRITE_ICH_REG_EL2(ap0r, 2, val);
+	WRITE_ICH_REG_EL2(ap0r, 3, val);
+	default:
+		assert(false);
+	}
+}
+
+static unsigned long read_ap1r(unsigned int n)
+{
+	switch (n) {
+	READ_ICH_REG_EL2(ap1r, 0);
+	READ_ICH_REG_EL2(ap1r, 1);
+	READ_ICH_REG_EL2(ap1r, 2);
+	READ_ICH_REG_EL2(ap1r, 3);
+	default:
+		assert(false);
+		return 0UL;
+	}
+}
+
+static void write_ap1r(unsigned int n, unsigned long val)
 {
-	switch (gic_virt_feature.nr_lrs) {
-	WRITE_ICH_LR_EL2(15);
-	WRITE_ICH_LR_EL2(14);
-	WRITE_ICH_LR_EL2(13);
-	WRITE_ICH_LR_EL2(12);
-	WRITE_ICH_LR_EL2(11);
-	WRITE_ICH_LR_EL2(10);
-	WRITE_ICH_LR_EL2(9);
-	WRITE_ICH_LR_EL2(8);
-	WRITE_ICH_LR_EL2(7);
-	WRITE_ICH_LR_EL2(6);
-	WRITE_ICH_LR_EL2(5);
-	WRITE_ICH_LR_EL2(4);
-	WRITE_ICH_LR_EL2(3);
-	WRITE_ICH_LR_EL2(2);
-	WRITE_ICH_LR_EL2(1);
+	switch (n) {
+	WRITE_ICH_REG_EL2(ap1r, 0, val);
+	WRITE_ICH_REG_EL2(ap1r, 1, val);
+	WRITE_ICH_REG_EL2(ap1r, 2, val);
+	WRITE_ICH_REG_EL2(ap1r, 3, val);
 	default:
-	WRITE_ICH_LR_EL2(0);
+		assert(false);
+	}
+}
+
+/*
+ * An LR is empty when it holds no interrupt and requests no maintenance
+ * interrupt on EOI. This matches the definition of ICH_ELRSR_EL2, given
+ * that the RMM requires HW == '0'.
+ */
+static bool is_lr_empty(unsigned long lr)
+{
+	return ((lr & ICH_LR_STATE_MASK) == ICH_LR_STATE_INVALID) &&
+		((lr & ICH_LR_EOI_BIT) == 0UL);
+}
+
+/*
+ * Save the ICH_LR<n>_EL2 registers loaded on REC entry. The GIC never turns
+ * an empty LR into a non-empty one, so the other LRs still hold the value
+ * in @gicstate.
+ */
+static void read_lrs(struct gic_cpu_state *gicstate)
+{
+	unsigned long in_use = gicstate->lrs_in_use;
+
+	while (in_use != 0UL) {
+		unsigned int i = (unsigned int)__builtin_ctzl(in_use);
+
+		gicstate->ich_lr_el2[i] = read_lr(i);
+		in_use &= in_use - 1UL;
+	}
+}
+
+/*
+ * Restore the ICH_LR<n>_EL2 registers. An empty LR of the REC is not
+ * written if the LR is already empty in hardware, as the content of an
+ * empty LR has no effect on the virtual CPU interface.
+ */
+static void write_lrs(struct gic_cpu_state *gicstate)
+{
+	unsigned long elrsr = read_ich_elrsr_el2();
+
+	gicstate->lrs_in_use = 0UL;
+
+	for (unsigned int i = 0U; i <= gic_virt_feature.nr_lrs; i++) {
+		unsigned long lr = gicstate->ich_lr_el2[i];
+
+		if (!is_lr_empty(lr)) {
+			gicstate->lrs_in_use |= (1UL << i);
+		} else if ((elrsr & (1UL << i)) != 0UL) {
+			continue;
+		}
+
+		write_lr(i, lr);
+	}
+}
+
+/*
+ * Return the index of the LR of the running REC which holds @intid, or
+ * ICH_MAX_LRS if there is none.
+ */
+static unsigned int find_lr(struct gic_cpu_state *gicstate, unsigned int intid)
+{
+	unsigned long in_use = gicstate->lrs_in_use;
+
+	while (in_use != 0UL) {
+		unsigned int i = (unsigned int)__builtin_ctzl(in_use);
+		unsigned long lr = read_lr(i);
+
+		if (!is_lr_empty(lr) &&
+		    (EXTRACT(ICH_LR_VINTID, lr) == (unsigned long)intid)) {
+			return i;
+		}
+		in_use &= in_use - 1UL;
+	}
+
+	return ICH_MAX_LRS;
+}
+
+/*
+ * Make the interrupt of the LR value @new pending in the LRs of the running
+ * REC. Returns false if no LR is free.
+ */
+static bool inject_lr(struct gic_cpu_state *gicstate, unsigned long new)
+{
+	unsigned int i = find_lr(gicstate,
+				 (unsigned int)EXTRACT(ICH_LR_VINTID, new));
+	unsigned long elrsr;
+
+	if (i != ICH_MAX_LRS) {
+		unsigned long lr = read_lr(i);
+
+		/* An interrupt which is already pending is not injected twice */
+		if ((lr & ICH_LR_STATE_MASK) == ICH_LR_STATE_ACTIVE) {
+			write_lr(i, (lr & ~ICH_LR_STATE_MASK) |
+				    ICH_LR_STATE_PENDING_ACTIVE);
+		}
+		return true;
+	}
+
+	elrsr = read_ich_elrsr_el2();
+
+	for (i = 0U; i <= gic_virt_feature.nr_lrs; i++) {
+		if ((elrsr & (1UL << i)) != 0UL) {
+			write_lr(i, new);
+			gicstate->lrs_in_use |= (1UL << i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool gic_inject_virq(struct gic_cpu_state *gicstate, unsigned int intid)
+{
+	return inject_lr(gicstate, ICH_LR_STATE_PENDING | ICH_LR_GROUP_BIT |
+				   INPLACE(ICH_LR_PRIORITY,
+					   GIC_INJECT_PRIORITY) |
+				   INPLACE(ICH_LR_VINTID, intid));
+}
+
+unsigned int gic_inject_lrs(struct gic_cpu_state *gicstate,
+			    const unsigned long *lrs, unsigned int nr)
+{
+	unsigned long local;
+	unsigned int i;
+
+	for (i = 0U; i < nr; i++) {
+		if (!inject_lr(gicstate, lrs[i])) {
+			break;
+		}
+	}
+
+	/*
+	 * The underflow maintenance interrupt, raised when at most one LR
+	 * holds an interrupt, requires a second LR for it to be of any use.
+	 */
+	local = ((i < nr) && (gic_virt_feature.nr_lrs != 0U) &&
+		 ((gicstate->ich_hcr_el2 & ICH_HCR_EL2_UIE_BIT) == 0UL)) ?
+		ICH_HCR_EL2_UIE_BIT : 0UL;
+
+	if (local != gicstate->hcr_local) {
+		write_ich_hcr_el2((read_ich_hcr_el2() & ~gicstate->hcr_local) |
+				  local);
+		gicstate->hcr_local = local;
+	}
+
+	return i;
+}
+
+bool gic_is_local_maintenance(struct gic_cpu_state *gicstate)
+{
+	unsigned long misr;
+
+	if (gicstate->hcr_local == 0UL) {
+		return false;
+	}
+
+	/* Each condition uses the bit of its enable in ICH_HCR_EL2 */
+	misr = read_ich_misr_el2();
+	return (misr != 0UL) && ((misr & ~gicstate->hcr_local) == 0UL);
+}
+
+void gic_retire_ppi(struct gic_cpu_state *gicstate, unsigned int intid)
+{
+	unsigned int i = find_lr(gicstate, intid);
+	unsigned long lr;
+
+	if (i == ICH_MAX_LRS) {
+		return;
+	}
+
+	/*
+	 * A level-sensitive interrupt which is no longer asserted is no longer
+	 * pending. It stays active until the REC deactivates it.
+	 */
+	lr = read_lr(i);
+	if ((lr & ICH_LR_STATE_MASK) == ICH_LR_STATE_PENDING) {
+		write_lr(i, 0UL);
+	} else if ((lr & ICH_LR_STATE_MASK) == ICH_LR_STATE_PENDING_ACTIVE) {
+		write_lr(i, (lr & ~ICH_LR_STATE_MASK) | ICH_LR_STATE_ACTIVE);
 	}
 }
 
 /* Save ICH_AP0R<n>_EL2 and ICH_AP1R<n>_EL2 registers [n...0] */
 static void read_aprs(struct gic_cpu_state *gicstate)
 {
-	switch (gic_virt_feature.nr_aprs) {
-	READ_ICH_APR_EL2(3);
-	READ_ICH_APR_EL2(2);
-	READ_ICH_APR_EL2(1);
-	default:
-	READ_ICH_APR_EL2(0);
+	/*
+	 * A priority only becomes active when the REC acknowledges an
+	 * interrupt from an LR, so the APRs are still zero if they were
+	 * zero on entry and no LR was in use.
+	 */
+	if (!gicstate->aprs_in_use && (gicstate->lrs_in_use == 0UL)) {
+		return;
+	}
+
+	for (unsigned int i = 0U; i <= gic_virt_feature.nr_aprs; i++) {
+		gicstate->ich_ap0r_el2[i] = read_ap0r(i);
+		gicstate->ich_ap1r_el2[i] = read_ap1r(i);
+	}
+}
+
+/*
+ * Restore a zero APR only if the Host left it non-zero, which is a read
+ * instead of a write in the common case of no active priority.
+ */
+static void write_apr(unsigned long (*read_fn)(unsigned int),
+		      void (*write_fn)(unsigned int, unsigned long),
+		      unsigned int n, unsigned long val)
+{
+	if ((val != 0UL) || (read_fn(n) != 0UL)) {
+		write_fn(n, val);
 	}
 }
 
 /* Restore ICH_AP0R<n>_EL2 and ICH_AP1R<n>_EL2 registers [n...0] */
 static void write_aprs(struct gic_cpu_state *gicstate)
 {
-	switch (gic_virt_feature.nr_aprs) {
-	WRITE_ICH_APR_EL2(3);
-	WRITE_ICH_APR_EL2(2);
-	WRITE_ICH_APR_EL2(1);
-	default:
-	WRITE_ICH_APR_EL2(0);
+	gicstate->aprs_in_use = false;
+
+	for (unsigned int i = 0U; i <= gic_virt_feature.nr_aprs; i++) {
+		unsigned long ap0r = gicstate->ich_ap0r_el2[i];
+		unsigned long ap1r = gicstate->ich_ap1r_el2[i];
+
+		if ((ap0r | ap1r) != 0UL) {
+			gicstate->aprs_in_use = true;
+		}
+
+		write_apr(read_ap0r, write_ap0r, i, ap0r);
+		write_apr(read_ap1r, write_ap1r, i, ap1r);
 	}
 }
 
+__hot_text
 void gic_restore_state(struct gic_cpu_state *gicstate)
 {
 	write_aprs(gicstate);
 	write_lrs(gicstate);
 
-	write_ich_vmcr_el2(gicstate->ich_vmcr_el2);
+	if (read_ich_vmcr_el2() != gicstate->ich_vmcr_el2) {
+		write_ich_vmcr_el2(gicstate->ich_vmcr_el2);
+	}
 	write_ich_hcr_el2(gicstate->ich_hcr_el2);
 }
 
+__hot_text
 void gic_save_state(struct gic_cpu_state *gicstate)
 {
 	read_aprs(gicstate);
@@ -312,6 +600,14 @@ void gic_save_state(struct gic_cpu_state *gicstate)
 	gicstate->ich_hcr_el2 = read_ich_hcr_el2();
 	gicstate->ich_misr_el2 = read_ich_misr_el2();
 
+	/*
+	 * Hide the maintenance interrupts enabled by gic_inject_lrs(). Each
+	 * condition of ICH_MISR_EL2 uses the bit of its enable in ICH_HCR_EL2.
+	 */
+	gicstate->ich_hcr_el2 &= ~gicstate->hcr_local;
+	gicstate->ich_misr_el2 &= ~gicstate->hcr_local;
+	gicstate->hcr_local = 0UL;
+
 	/* On REC exit, set ICH_HCR_EL2.En == '0' */
 	write_ich_hcr_el2(gicstate->ich_hcr_el2 & ~ICH_HCR_EL2_EN_BIT);
 }
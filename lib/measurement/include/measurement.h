@@ -7,6 +7,8 @@
 #define MEASUREMENT_H
 
 #include <assert.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/sha512.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <utils_def.h>
@@ -124,6 +126,68 @@ COMPILER_ASSERT(offsetof(struct measurement_desc_ripas, rim) == 0x10);
 COMPILER_ASSERT(offsetof(struct measurement_desc_ripas, ipa) == 0x50);
 COMPILER_ASSERT(offsetof(struct measurement_desc_ripas, level) == 0x58);
 
+/*
+ * Context used to compute a sequence of hashes with the same algorithm.
+ *
+ * The FPU state is saved by measurement_ctx_begin() and restored by
+ * measurement_ctx_end(), so that the cost of saving it and of setting up
+ * the hash context is paid once for all the hashes computed in between.
+ * The other measurement functions may be called while a context is open on
+ * the current CPU, in which case they run in the FPU section of the context
+ * and do not save the FPU state again.
+ */
+struct measurement_ctx {
+	enum hash_algo algo;
+	union {
+		mbedtls_sha256_context sha256;
+		mbedtls_sha512_context sha512;
+	};
+};
+
+/* Open a measurement context for algorithm hash_algo. */
+void measurement_ctx_begin(struct measurement_ctx *ctx,
+			   enum hash_algo hash_algo);
+
+/*
+ * Calculate the hash of data with the algorithm of `ctx` to the buffer
+ * `out`.
+ */
+void measurement_ctx_hash(struct measurement_ctx *ctx,
+			  void *data,
+			  size_t size,
+			  unsigned char *out);
+
+/*
+ * Calculate the hashes of `nr` independent buffers of `size` bytes, with the
+ * algorithm of `ctx`. The hash of `data[i]` is written to `out[i]`.
+ *
+ * With SHA-256, when RMM may use the FPU and the SHA256 instructions are
+ * implemented, the buffers are hashed in pairs with the rounds of the two
+ * computations interleaved, which nearly doubles the throughput as each
+ * SHA256 instruction has a latency of several cycles.
+ */
+void measurement_ctx_hash_multi(struct measurement_ctx *ctx,
+				void *data[],
+				size_t size,
+				unsigned char *out[],
+				unsigned int nr);
+
+/*
+ * Calculate the hash of data passed in pieces with the algorithm of `ctx`:
+ * measurement_ctx_hash_start() opens the hash, each call to
+ * measurement_ctx_hash_update() adds `size` bytes from `data` to it and
+ * measurement_ctx_hash_finish() writes the result to `out`.
+ */
+void measurement_ctx_hash_start(struct measurement_ctx *ctx);
+void measurement_ctx_hash_update(struct measurement_ctx *ctx,
+				 void *data,
+				 size_t size);
+void measurement_ctx_hash_finish(struct measurement_ctx *ctx,
+				 unsigned char *out);
+
+/* Close a measurement context opened by measurement_ctx_begin(). */
+void measurement_ctx_end(struct measurement_ctx *ctx);
+
 /*
  * Calculate the hash of data with algorithm hash_algo to the buffer `out`.
  */
@@ -138,6 +202,22 @@ void measurement_extend(enum hash_algo hash_algo,
 			size_t extend_measurement_size,
 			unsigned char *out);
 
+/*
+ * Extend the RIM at `rim` with a RmmMeasurementDescriptorRipas for each of
+ * the `count` entries of size `map_size` at RTT level `level` starting at
+ * IPA `base`, in increasing IPA order.
+ *
+ * The result is identical to hashing the descriptors one at a time, as each
+ * of them carries the RIM produced by the previous one, but a single
+ * measurement context is used for the whole run.
+ */
+void measurement_ripas_extend_range(enum hash_algo hash_algo,
+				    unsigned char *rim,
+				    unsigned long base,
+				    unsigned long map_size,
+				    unsigned long count,
+				    unsigned long level);
+
 /*
  * Return the hash size in bytes for the selected measurement algorithm.
  *
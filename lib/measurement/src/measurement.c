@@ -3,13 +3,16 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <arch_features.h>
 #include <assert.h>
 #include <debug.h>
 #include <fpu_helpers.h>
 #include <mbedtls/sha256.h>
 #include <mbedtls/sha512.h>
 #include <measurement.h>
+#include <measurement_priv.h>
 #include <stdbool.h>
+#include <string.h>
 
 #if LOG_LEVEL >= LOG_LEVEL_VERBOSE
 static void measurement_print(unsigned char *measurement,
@@ -41,45 +44,309 @@ static void measurement_print(unsigned char *measurement,
 }
 #endif /* LOG_LEVEL */
 
-static void do_hash(enum hash_algo hash_algo,
-		    void *data,
-		    size_t size,
-		    unsigned char *out)
+#ifdef RMM_SHA_A64_CRYPTO_DETECT
+/*
+ * Called by MbedTLS to find out whether the A64 SHA256/SHA512 instructions
+ * can be used. Only the AT_HWCAP bits checked by MbedTLS are reported.
+ */
+unsigned long getauxval(unsigned long type)
 {
-	__unused int ret;
+	unsigned long hwcap = 0UL;
 
-	assert(size <= GRANULE_SIZE);
-	assert((data != NULL) && (out != NULL));
+	if (type != AT_HWCAP) {
+		return 0UL;
+	}
+
+	if (is_feat_sha256_present()) {
+		hwcap |= HWCAP_SHA2;
+	}
+
+	if (is_feat_sha512_present()) {
+		hwcap |= HWCAP_SHA512;
+	}
+
+	return hwcap;
+}
+#endif /* RMM_SHA_A64_CRYPTO_DETECT */
+
+void measurement_ctx_begin(struct measurement_ctx *ctx,
+			   enum hash_algo hash_algo)
+{
+	assert(ctx != NULL);
+
+	ctx->algo = hash_algo;
 
 	fpu_save_my_state();
 
 	if (hash_algo == HASH_ALGO_SHA256) {
-		/* 0 to indicate SHA256 not SHA224 */
-		FPU_ALLOW(ret = mbedtls_sha256(data, size, out, 0));
-
-		assert(ret == 0);
+		mbedtls_sha256_init(&ctx->sha256);
 	} else if (hash_algo == HASH_ALGO_SHA512) {
-		/* 0 to indicate SHA512 not SHA384 */
-		FPU_ALLOW(ret = mbedtls_sha512(data, size, out, 0));
+		mbedtls_sha512_init(&ctx->sha512);
+	} else {
+		assert(false);
+	}
+}
+
+static void ctx_hash_sha256(mbedtls_sha256_context *sha256_ctx,
+			    void *data,
+			    size_t size,
+			    unsigned char *out)
+{
+	__unused int ret;
+
+	/* 0 to indicate SHA256 not SHA224 */
+	ret = mbedtls_sha256_starts(sha256_ctx, 0);
+	assert(ret == 0);
+
+	ret = mbedtls_sha256_update(sha256_ctx, (unsigned char *)data, size);
+	assert(ret == 0);
+
+	ret = mbedtls_sha256_finish(sha256_ctx, out);
+	assert(ret == 0);
+}
 
-		assert(ret == 0);
+static void ctx_hash_sha512(mbedtls_sha512_context *sha512_ctx,
+			    void *data,
+			    size_t size,
+			    unsigned char *out)
+{
+	__unused int ret;
+
+	/* 0 to indicate SHA512 not SHA384 */
+	ret = mbedtls_sha512_starts(sha512_ctx, 0);
+	assert(ret == 0);
+
+	ret = mbedtls_sha512_update(sha512_ctx, (unsigned char *)data, size);
+	assert(ret == 0);
+
+	ret = mbedtls_sha512_finish(sha512_ctx, out);
+	assert(ret == 0);
+}
+
+void measurement_ctx_hash(struct measurement_ctx *ctx,
+			  void *data,
+			  size_t size,
+			  unsigned char *out)
+{
+	assert(ctx != NULL);
+	assert(size <= GRANULE_SIZE);
+	assert((data != NULL) && (out != NULL));
+
+	if (ctx->algo == HASH_ALGO_SHA256) {
+		FPU_ALLOW(ctx_hash_sha256(&ctx->sha256, data, size, out));
+	} else if (ctx->algo == HASH_ALGO_SHA512) {
+		FPU_ALLOW(ctx_hash_sha512(&ctx->sha512, data, size, out));
 	} else {
 		assert(false);
 	}
 
-	fpu_restore_my_state();
+#if LOG_LEVEL >= LOG_LEVEL_VERBOSE
+	measurement_print(out, ctx->algo);
+#endif
+}
+
+#ifdef MEASUREMENT_SHA256_X2
+static const uint32_t sha256_init_state[8] = {
+	0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU,
+	0x510e527fU, 0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U
+};
+
+/*
+ * Calculate the SHA-256 hashes of `data0` and `data1`, of `size` bytes each,
+ * together. `size` must be a non-zero multiple of SHA256_BLOCK_SIZE, so that
+ * the padding is a block of its own, identical for both buffers.
+ */
+static void sha256_hash_x2(void *data0, void *data1, size_t size,
+			   unsigned char *out0, unsigned char *out1)
+{
+	uint32_t state[2][8];
+	unsigned char pad[SHA256_BLOCK_SIZE] = {0};
+	uint64_t nr_bits = (uint64_t)size * 8UL;
+
+	(void)memcpy(state[0], sha256_init_state, sizeof(sha256_init_state));
+	(void)memcpy(state[1], sha256_init_state, sizeof(sha256_init_state));
+
+	/* A single 1 bit, then the message size in bits in big-endian */
+	pad[0] = 0x80U;
+	for (unsigned int i = 0U; i < 8U; i++) {
+		pad[SHA256_BLOCK_SIZE - 1U - i] =
+			(unsigned char)(nr_bits >> (8U * i));
+	}
+
+	FPU_ALLOW(sha256_blocks_x2(state[0], state[1], data0, data1,
+				   size / SHA256_BLOCK_SIZE));
+	FPU_ALLOW(sha256_blocks_x2(state[0], state[1], pad, pad, 1U));
+
+	for (unsigned int i = 0U; i < 8U; i++) {
+		for (unsigned int j = 0U; j < 4U; j++) {
+			out0[(4U * i) + j] =
+				(unsigned char)(state[0][i] >> (24U - (8U * j)));
+			out1[(4U * i) + j] =
+				(unsigned char)(state[1][i] >> (24U - (8U * j)));
+		}
+	}
+}
+#endif /* MEASUREMENT_SHA256_X2 */
+
+void measurement_ctx_hash_multi(struct measurement_ctx *ctx,
+				void *data[],
+				size_t size,
+				unsigned char *out[],
+				unsigned int nr)
+{
+	unsigned int i = 0U;
+
+	assert(ctx != NULL);
+	assert((data != NULL) && (out != NULL));
 
+#ifdef MEASUREMENT_SHA256_X2
+	if ((ctx->algo == HASH_ALGO_SHA256) && (size != 0U) &&
+	    ((size % SHA256_BLOCK_SIZE) == 0U) && is_feat_sha256_present()) {
+		for (; (i + 1U) < nr; i += 2U) {
+			sha256_hash_x2(data[i], data[i + 1U], size,
+				       out[i], out[i + 1U]);
 #if LOG_LEVEL >= LOG_LEVEL_VERBOSE
-	measurement_print(out, hash_algo);
+			measurement_print(out[i], ctx->algo);
+			measurement_print(out[i + 1U], ctx->algo);
+#endif
+		}
+	}
+#endif /* MEASUREMENT_SHA256_X2 */
+
+	/* The remaining buffers are hashed one at a time */
+	for (; i < nr; i++) {
+		measurement_ctx_hash(ctx, data[i], size, out[i]);
+	}
+}
+
+static void ctx_hash_start(struct measurement_ctx *ctx)
+{
+	__unused int ret;
+
+	if (ctx->algo == HASH_ALGO_SHA256) {
+		ret = mbedtls_sha256_starts(&ctx->sha256, 0);
+	} else {
+		ret = mbedtls_sha512_starts(&ctx->sha512, 0);
+	}
+	assert(ret == 0);
+}
+
+static void ctx_hash_update(struct measurement_ctx *ctx,
+			    void *data,
+			    size_t size)
+{
+	__unused int ret;
+
+	if (ctx->algo == HASH_ALGO_SHA256) {
+		ret = mbedtls_sha256_update(&ctx->sha256,
+					    (unsigned char *)data, size);
+	} else {
+		ret = mbedtls_sha512_update(&ctx->sha512,
+					    (unsigned char *)data, size);
+	}
+	assert(ret == 0);
+}
+
+static void ctx_hash_finish(struct measurement_ctx *ctx, unsigned char *out)
+{
+	__unused int ret;
+
+	if (ctx->algo == HASH_ALGO_SHA256) {
+		ret = mbedtls_sha256_finish(&ctx->sha256, out);
+	} else {
+		ret = mbedtls_sha512_finish(&ctx->sha512, out);
+	}
+	assert(ret == 0);
+}
+
+void measurement_ctx_hash_start(struct measurement_ctx *ctx)
+{
+	assert(ctx != NULL);
+	assert((ctx->algo == HASH_ALGO_SHA256) ||
+	       (ctx->algo == HASH_ALGO_SHA512));
+
+	FPU_ALLOW(ctx_hash_start(ctx));
+}
+
+void measurement_ctx_hash_update(struct measurement_ctx *ctx,
+				 void *data,
+				 size_t size)
+{
+	assert(ctx != NULL);
+	assert(data != NULL);
+
+	FPU_ALLOW(ctx_hash_update(ctx, data, size));
+}
+
+void measurement_ctx_hash_finish(struct measurement_ctx *ctx,
+				 unsigned char *out)
+{
+	assert(ctx != NULL);
+	assert(out != NULL);
+
+	FPU_ALLOW(ctx_hash_finish(ctx, out));
+
+#if LOG_LEVEL >= LOG_LEVEL_VERBOSE
+	measurement_print(out, ctx->algo);
 #endif
 }
 
+void measurement_ctx_end(struct measurement_ctx *ctx)
+{
+	assert(ctx != NULL);
+
+	if (ctx->algo == HASH_ALGO_SHA256) {
+		mbedtls_sha256_free(&ctx->sha256);
+	} else {
+		mbedtls_sha512_free(&ctx->sha512);
+	}
+
+	fpu_restore_my_state();
+}
+
 void measurement_hash_compute(enum hash_algo hash_algo,
 			      void *data,
 			      size_t size,
 			      unsigned char *out)
 {
-	do_hash(hash_algo, data, size, out);
+	struct measurement_ctx ctx;
+
+	measurement_ctx_begin(&ctx, hash_algo);
+	measurement_ctx_hash(&ctx, data, size, out);
+	measurement_ctx_end(&ctx);
+}
+
+void measurement_ripas_extend_range(enum hash_algo hash_algo,
+				    unsigned char *rim,
+				    unsigned long base,
+				    unsigned long map_size,
+				    unsigned long count,
+				    unsigned long level)
+{
+	struct measurement_desc_ripas desc = {0};
+	struct measurement_ctx ctx;
+	size_t rim_size = measurement_get_size(hash_algo);
+
+	assert(rim != NULL);
+
+	if (count == 0UL) {
+		return;
+	}
+
+	desc.desc_type = MEASURE_DESC_TYPE_RIPAS;
+	desc.len = sizeof(struct measurement_desc_ripas);
+	desc.ipa = base;
+	desc.level = (unsigned char)level;
+
+	measurement_ctx_begin(&ctx, hash_algo);
+
+	for (unsigned long i = 0UL; i < count; i++) {
+		(void)memcpy(desc.rim, rim, rim_size);
+		measurement_ctx_hash(&ctx, &desc, sizeof(desc), rim);
+		desc.ipa += map_size;
+	}
+
+	measurement_ctx_end(&ctx);
 }
 
 static void measurement_extend_sha256(void *current_measurement,
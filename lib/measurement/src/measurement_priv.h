@@ -0,0 +1,25 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef MEASUREMENT_PRIV_H
+#define MEASUREMENT_PRIV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size in bytes of a SHA-256 message block */
+#define SHA256_BLOCK_SIZE	(64U)
+
+/*
+ * Update the SHA-256 states `state0` and `state1` with the `nr_blocks`
+ * message blocks at `in0` and `in1` respectively, with the rounds of the two
+ * computations interleaved. `nr_blocks` must not be zero. Uses the SHA256
+ * instructions, so the FPU must be accessible.
+ */
+void sha256_blocks_x2(uint32_t state0[8], uint32_t state1[8],
+		      const void *in0, const void *in1,
+		      size_t nr_blocks);
+
+#endif /* MEASUREMENT_PRIV_H */
@@ -21,10 +21,12 @@ enum buffer_slot {
 	 * RMM-private.
 	 */
 	SLOT_DELEGATED,
+	SLOT_DELEGATED2,	/* Some commands access two DATA granules at a time*/
 	SLOT_RD,
 	SLOT_REC,
 	SLOT_REC2,		/* Some commands access two REC granules at a time*/
 	SLOT_REC_TARGET,	/* Target REC for interrupts */
+	SLOT_REC_RD,		/* RD of the REC run by RMI_REC_ENTER */
 	SLOT_REC_AUX0,		/* Reserve slots for max rec auxiliary granules
 				 * so that all of them can be mapped at once.
 				 * If the max aux granules is 0, no slots will
@@ -39,9 +41,30 @@ enum buffer_slot {
 struct granule;
 
 void assert_cpu_slots_empty(void);
+
+/*
+ * Invalidate the slot mappings of the current CPU kept for reuse after
+ * buffer_unmap(). Must be called before returning to the Host.
+ */
+void buffer_slots_flush(void);
 void *granule_map(struct granule *g, enum buffer_slot slot);
+void *granule_map_mec(struct granule *g, enum buffer_slot slot,
+		      unsigned int mecid);
 void buffer_unmap(void *buf);
 
+/*
+ * Map or unmap several granules at once with a single barrier. The slots in
+ * @slots must be distinct.
+ */
+void granule_map_group(struct granule *g[], const enum buffer_slot slots[],
+		       unsigned int nr, void *bufs[]);
+void buffer_unmap_group(void *bufs[], unsigned int nr);
+
+#ifdef RMM_RMI_STATS
+/* Return the number of slot buffers mapped so far by the current CPU */
+unsigned long buffer_slot_map_count(void);
+#endif
+
 bool ns_buffer_read(enum buffer_slot slot,
 		    struct granule *granule,
 		    unsigned int offset,
@@ -53,6 +76,36 @@ bool ns_buffer_write(enum buffer_slot slot,
 		     unsigned int size,
 		     void *src);
 
+/*
+ * Range of bytes within a buffer, used to transfer only parts of a
+ * NS granule. @offset and @size must be aligned to 8 bytes.
+ */
+struct ns_buffer_range {
+	unsigned int offset;
+	unsigned int size;
+};
+
+bool ns_buffer_read_ranges(enum buffer_slot slot,
+			   struct granule *ns_gr,
+			   unsigned int offset,
+			   const struct ns_buffer_range *ranges,
+			   unsigned int nr_ranges,
+			   void *dest);
+bool ns_buffer_write_ranges(enum buffer_slot slot,
+			    struct granule *ns_gr,
+			    unsigned int offset,
+			    const struct ns_buffer_range *ranges,
+			    unsigned int nr_ranges,
+			    void *src);
+
+struct measurement_ctx;
+
+bool ns_buffer_read_hash(enum buffer_slot slot,
+			 struct granule *ns_gr,
+			 void *dest,
+			 struct measurement_ctx *ctx,
+			 unsigned char *out);
+
 /*
  * Initializes and enables the VMSA for the slot buffer mechanism.
  *
@@ -88,4 +141,21 @@ void *buffer_map_internal(enum buffer_slot slot, unsigned long addr, bool ns);
  */
 void buffer_unmap_internal(void *buf);
 
+/*
+ * Same as buffer_map_internal() and buffer_unmap_internal() for @nr Realm
+ * PAs or slot buffers at once. On a mapping failure, all of @bufs are set
+ * to NULL.
+ */
+/*
+ * Same as buffer_map_internal() for a Realm PA accessed in the memory
+ * encryption context @mecid, in a slot which is not reused lazily.
+ */
+void *buffer_map_internal_mec(enum buffer_slot slot, unsigned long addr,
+			      unsigned int mecid);
+
+void buffer_map_internal_group(const enum buffer_slot slots[],
+			       const unsigned long addrs[],
+			       unsigned int nr, void *bufs[]);
+void buffer_unmap_internal_group(void *bufs[], unsigned int nr);
+
 #endif /* BUFFER_H */
@@ -6,6 +6,7 @@
 #ifndef GRANULE_H
 #define GRANULE_H
 
+#include <arch.h>
 #include <assert.h>
 #include <atomics.h>
 #include <buffer.h>
@@ -13,15 +14,74 @@
 #include <memory.h>
 #include <spinlock.h>
 #include <status.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <utils_def.h>
+
+/*
+ * The lock and the state of a granule are adjacent 32-bit fields, so that
+ * they can also be accessed together as one naturally aligned 64-bit word,
+ * with the lock in the low half.
+ */
+COMPILER_ASSERT(offsetof(struct granule, lock) == 0U);
+COMPILER_ASSERT(offsetof(struct granule, state) == 4U);
+COMPILER_ASSERT(sizeof(struct granule) == 16U);
+
+#define GRANULE_LOCK_WORD(val, state)	\
+	(((uint64_t)(state) << 32) | (uint64_t)(val))
+
+#ifdef RMM_GRANULE_HOT_SLOTS
+/*
+ * The reference counts of the REC and RD granules are updated by many CPUs,
+ * on each REC entry and exit in the case of a REC, while the neighbouring
+ * entries of the granule table are locked by other CPUs. While a granule is
+ * a REC or an RD, its reference count is therefore kept in a slot of a side
+ * table, in a cache line of its own, if one is free. The refcount field of
+ * the granule then holds GRANULE_HOT_BIT and the index of the slot.
+ *
+ * The lock stays in the granule table, as it shares a word with the state.
+ */
+#define GRANULE_HOT_BIT		(1UL << 63)
+
+struct granule_hot {
+	unsigned long refcount;
+} __aligned(CACHE_WRITEBACK_GRANULE);
+
+extern struct granule_hot granule_hot[RMM_GRANULE_HOT_SLOTS];
+
+/* Must be called with g->lock held, on the transitions to and from REC/RD */
+void granule_hot_attach(struct granule *g);
+void granule_hot_detach(struct granule *g);
+
+static inline unsigned long *granule_refcount_ptr(struct granule *g)
+{
+	/*
+	 * The field only changes between a refcount and a slot index with
+	 * the lock held and no reference to the granule, so it is stable
+	 * for any caller which may access the refcount.
+	 */
+	unsigned long val = __sca_read64(&g->refcount);
+
+	if ((val & GRANULE_HOT_BIT) != 0UL) {
+		return &granule_hot[val & ~GRANULE_HOT_BIT].refcount;
+	}
+	return &g->refcount;
+}
+#else
+static inline unsigned long *granule_refcount_ptr(struct granule *g)
+{
+	return &g->refcount;
+}
+#endif /* RMM_GRANULE_HOT_SLOTS */
 
 static inline unsigned long granule_refcount_read_relaxed(struct granule *g)
 {
-	return __sca_read64(&g->refcount);
+	return __sca_read64(granule_refcount_ptr(g));
 }
 
 static inline unsigned long granule_refcount_read_acquire(struct granule *g)
 {
-	return __sca_read64_acquire(&g->refcount);
+	return __sca_read64_acquire(granule_refcount_ptr(g));
 }
 
 /*
@@ -61,6 +121,9 @@ static inline void __granule_assert_unlocked_invariants(struct granule *g,
 	case GRANULE_STATE_RTT:
 		assert(g->refcount >= 0UL);
 		break;
+	case GRANULE_STATE_RTT_SHARED:
+		/* Number of Realm RTT entries linking to the granule */
+		break;
 	case GRANULE_STATE_REC_AUX:
 		assert(g->refcount == 0UL);
 		break;
@@ -70,16 +133,106 @@ static inline void __granule_assert_unlocked_invariants(struct granule *g,
 	}
 }
 
+#ifdef RMM_GRANULE_CHECK_SAMPLE
+/*
+ * Return true once every RMM_GRANULE_CHECK_SAMPLE calls on the current CPU,
+ * when the invariants of the granule being locked or unlocked are checked.
+ */
+bool granule_check_sampled(void);
+#endif
+
+/*
+ * Check the unlocked granule invariants on lock and unlock. With
+ * RMM_GRANULE_CHECK_SAMPLE, only one operation in RMM_GRANULE_CHECK_SAMPLE
+ * is checked, and the rest of the table is covered by granule_check_sweep().
+ */
+static inline void granule_check_unlocked_invariants(struct granule *g,
+						     enum granule_state state)
+{
+#ifdef RMM_GRANULE_CHECK_SAMPLE
+	if (!granule_check_sampled()) {
+		return;
+	}
+#endif
+	__granule_assert_unlocked_invariants(g, state);
+}
+
 /* Must be called with g->lock held */
 static inline enum granule_state granule_get_state(struct granule *g)
 {
 	return g->state;
 }
 
+/*
+ * Return the state of @g without holding its lock, with a single relaxed load
+ * of its lock and state word. The state may change as soon as it is read.
+ */
+static inline enum granule_state granule_unlocked_state(struct granule *g)
+{
+	uint64_t word = SCA_READ64((uint64_t *)(void *)&g->lock);
+
+	return (enum granule_state)(word >> 32);
+}
+
+#ifdef RMM_GRANULE_STATS
+/* Count a transition of a granule on the current CPU */
+void granule_stats_transition(enum granule_state from, enum granule_state to);
+
+/* Number of transitions from @from to @to made by @cpu */
+unsigned long granule_stats_transitions(unsigned int cpu,
+					enum granule_state from,
+					enum granule_state to);
+
+/*
+ * Number of granules in @state, from the transitions of all the CPUs. As
+ * the counters of the other CPUs are read while they may be updated, this
+ * is only exact when no granule changes state.
+ */
+long granule_stats_count(enum granule_state state);
+#endif
+
+#ifdef RMM_GRANULE_SUMMARY
+/* Number of consecutive entries of the granule table summarised together */
+#define GRANULE_SUMMARY_BLOCK_GRANULES	512UL
+#define GRANULE_SUMMARY_BLOCK_SIZE	(GRANULE_SUMMARY_BLOCK_GRANULES * \
+					 GRANULE_SIZE)
+
+/* Account the transition of @g from @from to @to in the summary */
+void granule_summary_transition(struct granule *g,
+				enum granule_state from,
+				enum granule_state to);
+
+/*
+ * Returns true if all the granules of the block which starts at @addr are
+ * in the same state, which is then returned in @state, without looking at
+ * the granules themselves. Returns false if they are not, or if @addr is
+ * not the start of a block of the granule table, in which case the caller
+ * has to look at each granule.
+ *
+ * As no granule lock is taken, the result is only a snapshot: a caller
+ * which changes the state of the granules still has to lock them.
+ */
+bool granule_block_state(unsigned long addr, enum granule_state *state);
+#endif
+
 /* Must be called with g->lock held */
 static inline void granule_set_state(struct granule *g,
 				     enum granule_state state)
 {
+#ifdef RMM_GRANULE_STATS
+	granule_stats_transition(g->state, state);
+#endif
+#ifdef RMM_GRANULE_SUMMARY
+	granule_summary_transition(g, g->state, state);
+#endif
+#ifdef RMM_GRANULE_HOT_SLOTS
+	if ((state == GRANULE_STATE_REC) || (state == GRANULE_STATE_RD)) {
+		granule_hot_attach(g);
+	} else if ((g->state == GRANULE_STATE_REC) ||
+		   (g->state == GRANULE_STATE_RD)) {
+		granule_hot_detach(g);
+	}
+#endif
 	g->state = state;
 }
 
@@ -87,10 +240,41 @@ static inline void granule_set_state(struct granule *g,
  * Acquire the spinlock and then check expected state
  * Fails if unexpected locking sequence detected.
  * Also asserts if invariant conditions are met.
+ *
+ * The common cases, where the granule is unlocked, are handled with a CAS
+ * on the lock and state word: it takes the lock only if the state matches,
+ * and a granule found unlocked in another state is rejected without being
+ * written to. The state only changes with the lock held, so it is stable
+ * whenever the lock is seen free. Only a granule which is already locked
+ * goes through spinlock_acquire().
  */
 static inline bool granule_lock_on_state_match(struct granule *g,
 				    enum granule_state expected_state)
 {
+	uint64_t *word = (uint64_t *)(void *)&g->lock;
+	uint64_t expected = GRANULE_LOCK_WORD(0U, expected_state);
+	uint64_t old;
+
+	old = atomic_cas_acquire_64(word, expected,
+			GRANULE_LOCK_WORD(spinlock_val_locked(0U),
+					  expected_state));
+	if ((old != expected) && spinlock_val_is_free((unsigned int)old)) {
+		if ((enum granule_state)(old >> 32) != expected_state) {
+			return false;
+		}
+
+		/* Free with a non-zero lock word, as a used ticket lock is */
+		expected = old;
+		old = atomic_cas_acquire_64(word, expected,
+			GRANULE_LOCK_WORD(spinlock_val_locked((unsigned int)old),
+					  expected_state));
+	}
+
+	if (old == expected) {
+		granule_check_unlocked_invariants(g, expected_state);
+		return true;
+	}
+
 	spinlock_acquire(&g->lock);
 
 	if (granule_get_state(g) != expected_state) {
@@ -98,7 +282,32 @@ static inline bool granule_lock_on_state_match(struct granule *g,
 		return false;
 	}
 
-	__granule_assert_unlocked_invariants(g, expected_state);
+	granule_check_unlocked_invariants(g, expected_state);
+	return true;
+}
+
+/*
+ * Same as granule_lock_on_state_match(), but fails instead of waiting
+ * when the granule is locked.
+ */
+static inline bool granule_trylock_on_state_match(struct granule *g,
+				    enum granule_state expected_state)
+{
+	uint64_t *word = (uint64_t *)(void *)&g->lock;
+	uint64_t old = __sca_read64(word);
+
+	if (!spinlock_val_is_free((unsigned int)old) ||
+	    ((enum granule_state)(old >> 32) != expected_state)) {
+		return false;
+	}
+
+	if (atomic_cas_acquire_64(word, old,
+			GRANULE_LOCK_WORD(spinlock_val_locked((unsigned int)old),
+					  expected_state)) != old) {
+		return false;
+	}
+
+	granule_check_unlocked_invariants(g, expected_state);
 	return true;
 }
 
@@ -116,7 +325,7 @@ static inline void granule_lock(struct granule *g,
 
 static inline void granule_unlock(struct granule *g)
 {
-	__granule_assert_unlocked_invariants(g, granule_get_state(g));
+	granule_check_unlocked_invariants(g, granule_get_state(g));
 	spinlock_release(&g->lock);
 }
 
@@ -131,9 +340,22 @@ static inline void granule_unlock_transition(struct granule *g,
 unsigned long granule_addr(struct granule *g);
 struct granule *addr_to_granule(unsigned long addr);
 struct granule *find_granule(unsigned long addr);
+struct granule *find_granule_range(unsigned long addr, unsigned long count);
 struct granule *find_lock_granule(unsigned long addr,
 				  enum granule_state expected_state);
 
+/* A granule to find and lock with find_lock_granules() */
+struct granule_set {
+	unsigned long addr;
+	enum granule_state state;
+	/* Set to the locked granule on success */
+	struct granule *g;
+};
+
+/* Maximum number of granules locked by find_lock_granules() */
+#define FIND_LOCK_GRANULES_MAX		8U
+
+bool find_lock_granules(struct granule_set *granules, unsigned int n);
 bool find_lock_two_granules(unsigned long addr1,
 			    enum granule_state expected_state1,
 			    struct granule **g1,
@@ -145,30 +367,93 @@ void granule_memzero(struct granule *g, enum buffer_slot slot);
 
 void granule_memzero_mapped(void *buf);
 
+/*
+ * Clean and invalidate the cache lines of @g to the Point of Encryption, so
+ * that the granule can be accessed in another memory encryption context.
+ */
+void granule_mec_clean(struct granule *g);
+
+/*
+ * A DELEGATED granule is not zeroed at delegation. It is marked as needing
+ * a scrub instead, and the first user of the granule either overwrites it
+ * completely and clears the mark, or zeroes it with granule_scrub().
+ *
+ * All these functions must be called with g->lock held.
+ */
+void granule_set_needs_scrub(struct granule *g);
+void granule_clear_needs_scrub(struct granule *g);
+void granule_scrub(struct granule *g, enum buffer_slot slot);
+void granule_scrub_mapped(struct granule *g, void *buf);
+
+/*
+ * A DELEGATED granule may instead keep the content the Host loaded in it
+ * before its delegation, to be measured in place by Data.Create. The
+ * granule is then marked as preloaded as well as needing a scrub, and is
+ * not zeroed by granule_prescrub(). Clearing the scrub mark, or zeroing the
+ * granule, also clears the preloaded mark.
+ *
+ * These functions must be called with g->lock held.
+ */
+void granule_set_preloaded(struct granule *g);
+bool granule_is_preloaded(struct granule *g);
+
+/*
+ * Zero a share of the granule table, which is not zeroed with the BSS. Each
+ * CPU calls this once it has booted, so that the table is zeroed in parallel.
+ */
+void granule_table_init_share(void);
+
+/*
+ * Zero the rest of the granule table and wait for the shares of the other
+ * CPUs to be done. This must be called before any granule is used, and only
+ * costs a load once the table is ready.
+ */
+void granule_table_init_complete(void);
+
+/*
+ * Zero up to @budget DELEGATED granules which still need a scrub. This
+ * takes the granule locks itself and skips the granules that are locked.
+ */
+void granule_prescrub(unsigned int budget);
+
+#ifdef RMM_GRANULE_CHECK_SAMPLE
+/*
+ * Check the invariants of the next few unlocked granules of the table. The
+ * granules are handed out from a shared cursor, so that the calls made at
+ * the end of the RMI calls sweep the whole table over time. Locked granules
+ * are skipped.
+ */
+void granule_check_sweep(void);
+#endif
+
 /* Must be called with g->lock held */
 static inline void __granule_get(struct granule *g)
 {
-	g->refcount++;
+	(*granule_refcount_ptr(g))++;
 }
 
 /* Must be called with g->lock held */
 static inline void __granule_put(struct granule *g)
 {
-	assert(g->refcount > 0UL);
-	g->refcount--;
+	unsigned long *refcount = granule_refcount_ptr(g);
+
+	assert(*refcount > 0UL);
+	(*refcount)--;
 }
 
 /* Must be called with g->lock held */
 static inline void __granule_refcount_inc(struct granule *g, unsigned long val)
 {
-	g->refcount += val;
+	*granule_refcount_ptr(g) += val;
 }
 
 /* Must be called with g->lock held */
 static inline void __granule_refcount_dec(struct granule *g, unsigned long val)
 {
-	assert(g->refcount >= val);
-	g->refcount -= val;
+	unsigned long *refcount = granule_refcount_ptr(g);
+
+	assert(*refcount >= val);
+	*refcount -= val;
 }
 
 /*
@@ -176,7 +461,7 @@ static inline void __granule_refcount_dec(struct granule *g, unsigned long val)
  */
 static inline void atomic_granule_get(struct granule *g)
 {
-	atomic_add_64(&g->refcount, 1UL);
+	atomic_add_64(granule_refcount_ptr(g), 1UL);
 }
 
 /*
@@ -184,7 +469,7 @@ static inline void atomic_granule_get(struct granule *g)
  */
 static inline void atomic_granule_put(struct granule *g)
 {
-	atomic_add_64(&g->refcount, -1L);
+	atomic_add_64(granule_refcount_ptr(g), -1L);
 }
 
 /*
@@ -195,7 +480,7 @@ static inline void atomic_granule_put_release(struct granule *g)
 {
 	unsigned long old_refcount __unused;
 
-	old_refcount = atomic_load_add_release_64(&g->refcount, -1L);
+	old_refcount = atomic_load_add_release_64(granule_refcount_ptr(g), -1L);
 	assert(old_refcount > 0UL);
 }
 
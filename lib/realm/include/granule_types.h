@@ -26,6 +26,7 @@
  * - GRANULE_STATE_DELEGATED
  * - GRANULE_STATE_RD
  * - GRANULE_STATE_REC
+ * - GRANULE_STATE_RTT_SHARED
  *
  * Otherwise a granule state is considered `internal`.
  *
@@ -60,9 +61,10 @@
  * Invariants
  * ----------
  * GRANULE_STATE_DELEGATED is special, in that it is the gateway between the
- * non-secure and realm world.  We maintain the property that any unlocked
- * granule with state == GRANULE_STATE_DELEGATED contains only zeroes; while
- * locked these may contain non-zero values.
+ * non-secure and realm world. An unlocked granule with state ==
+ * GRANULE_STATE_DELEGATED either contains only zeroes, or is marked as
+ * needing a scrub, in which case it must be zeroed or completely overwritten
+ * before it leaves that state, see granule_set_needs_scrub().
  */
 
 enum granule_state {
@@ -184,7 +186,21 @@ enum granule_state {
 	 *   - Assigned s2tte.
 	 */
 	GRANULE_STATE_RTT,
-	GRANULE_STATE_LAST = GRANULE_STATE_RTT
+	/*
+	 * Shared RTT Granule (external)
+	 *
+	 * Last level RTT built by the Host with RMI_RTT_SHARED, which only
+	 * holds Unprotected s2ttes and can be linked by the RTTs of several
+	 * Realms. Its content is protected by granule::lock and can only
+	 * change while no Realm links to it.
+	 *
+	 * A reference is held on this granule for each RTT entry linking
+	 * to it. A reference is taken while the granule is locked, and
+	 * dropped atomically without the lock once the linking RTT entry
+	 * has been removed and the TLBs of its Realm invalidated.
+	 */
+	GRANULE_STATE_RTT_SHARED,
+	GRANULE_STATE_LAST = GRANULE_STATE_RTT_SHARED
 };
 
 struct granule {
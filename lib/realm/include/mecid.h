@@ -0,0 +1,14 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef MECID_H
+#define MECID_H
+
+/* MECID used by RMM, and by the Realms which do not have their own */
+#define MECID_RMM	0U
+
+unsigned int mecid_alloc(void);
+
+#endif /* MECID_H */
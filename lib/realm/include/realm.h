@@ -7,15 +7,37 @@
 #define REALM_H
 
 #include <assert.h>
+#include <atomics.h>
+#include <attestation_export.h>
 #include <measurement.h>
 #include <memory.h>
 #include <rec.h>
+#include <smc-rmi.h>
 #include <table.h>
 
 #define REALM_STATE_NEW		0
 #define REALM_STATE_ACTIVE	1
 #define REALM_STATE_SYSTEM_OFF	2
 
+/* Maximum number of RTTs freed by automatic folding pending reclaim */
+#define RTT_RECLAIM_LIST_LEN	32U
+
+/* Maximum number of granules in the RTT pool of a Realm, used or not */
+#define RTT_POOL_LEN		16U
+
+/* Maximum number of granules in the DATA pool of a Realm, used or not */
+#define DATA_POOL_LEN		16U
+
+/* Number of RECs of a Realm which the rd records the granule of */
+#define RD_REC_TABLE_LEN	64U
+
+#ifdef RMM_RIPAS_SUMMARY
+/* Size of the IPA blocks of the RIPAS summary */
+#define RIPAS_SUMMARY_BLOCK_SHIFT	21U
+/* Number of 64-bit words of the RIPAS summary, covering 16GB of IPA space */
+#define RIPAS_SUMMARY_WORDS		128U
+#endif
+
 /*
  * Stage 2 configuration of the Realm
  */
@@ -29,12 +51,18 @@ struct realm_s2_context {
 	/* Number of concatenated starting level rtts */
 	unsigned int num_root_rtts;
 
+	/* Walker of the RTTs, see rtt_walker_select() */
+	unsigned int rtt_walker;
+
 	/* First level RTT, pointed to by Realm TTBR */
 	struct granule *g_rtt;
 
 	/* Virtual Machine Identifier */
 	unsigned int vmid;
 
+	/* Memory Encryption Context Identifier, see mecid_alloc() */
+	unsigned int mecid;
+
 	/*
 	 * TODO: we will need other translation regime state, e.g. TCR, MAIR(?).
 	 */
@@ -75,11 +103,157 @@ struct rd {
 	/* Realm measurement */
 	unsigned char measurement[MEASUREMENT_SLOT_NR][MAX_MEASUREMENT_SIZE];
 
+	/*
+	 * Generation of the measurements, incremented when a REM is extended.
+	 * It starts at 1, so that it never matches the one of a REC without
+	 * a signed Realm token, see token_sign_ctx.meas_gen.
+	 */
+	unsigned long meas_gen;
+
 	/* Realm Personalization Value */
 	unsigned char rpv[RPV_SIZE];
+
+	/* Static claims of the Realm token, encoded on Realm activation */
+	struct attest_realm_claims attest_claims;
+
+	/* Fold fully populated last level RTTs during RMI commands */
+	bool auto_fold;
+
+	/*
+	 * Apply the RIPAS changes to EMPTY requested by the Realm without
+	 * exiting to the Host
+	 */
+	bool auto_ripas_empty;
+
+	/* PMU exposed to the Realm and number of its event counters */
+	bool pmu_enabled;
+	unsigned int pmu_num_ctrs;
+
+	/* Statistical Profiling Extension exposed to the Realm */
+	bool spe_enabled;
+
+	/* Access flag and dirty state of the stage 2 managed by hardware */
+	bool hafdbs_enabled;
+
+	/* Dirty state of the stage 2 tracked by write-protecting it */
+	bool wp_dirty_enabled;
+
+	/* WFI and WFE of the RECs are never trapped */
+	bool wfx_notrap;
+
+	/*
+	 * Values returned to the Realm for its reads of the ID registers,
+	 * sanitised at RMI_REALM_CREATE, see realm_id_regs_init().
+	 */
+	unsigned long id_regs[REALM_ID_REGS_LEN];
+
+	/* MPAM partition of the RECs, in the format of MPAM1_EL1 */
+	unsigned long mpam;
+
+	/*
+	 * Addresses of the RTTs which have been freed by automatic folding
+	 * and not yet reported to the Host through RMI_RTT_RECLAIM.
+	 */
+	unsigned int nr_reclaim_rtts;
+	unsigned long reclaim_rtts[RTT_RECLAIM_LIST_LEN];
+
+	/*
+	 * Number of automatic folds skipped because the reclaim list was
+	 * full, since it was last reported by RMI_RTT_RECLAIM.
+	 */
+	unsigned long nr_skipped_folds;
+
+	/*
+	 * Granules donated by the Host through RMI_RTT_POOL_DONATE, which are
+	 * kept in GRANULE_STATE_RTT without being linked. They are used to
+	 * create the RTTs missing below an Unassigned s2tte during DATA_CREATE
+	 * and RTT_MAP_UNPROTECTED, after which their addresses are moved to
+	 * rtt_pool_used until they are reported through RMI_RTT_POOL_REPORT.
+	 * nr_rtt_pool + nr_rtt_pool_used never exceeds RTT_POOL_LEN.
+	 */
+	unsigned int nr_rtt_pool;
+	unsigned long rtt_pool[RTT_POOL_LEN];
+	unsigned int nr_rtt_pool_used;
+	unsigned long rtt_pool_used[RTT_POOL_LEN];
+
+	/*
+	 * Scrubbed granules donated by the Host through RMI_DATA_POOL_DONATE,
+	 * which are kept in GRANULE_STATE_DATA without being mapped. They are
+	 * mapped by the RMM at the Unassigned RIPAS RAM IPAs the RECs fault
+	 * on, after which the mapping is moved to data_pool_used until it is
+	 * reported through RMI_DATA_POOL_REPORT.
+	 * nr_data_pool + nr_data_pool_used never exceeds DATA_POOL_LEN.
+	 */
+	unsigned int nr_data_pool;
+	unsigned long data_pool[DATA_POOL_LEN];
+	unsigned int nr_data_pool_used;
+	struct rmi_data_pool_entry data_pool_used[DATA_POOL_LEN];
+
+	/* Pages can be exported with RMI_DATA_EXPORT */
+	bool data_export_enabled;
+
+	/*
+	 * Key of the granules exported with RMI_DATA_EXPORT, generated
+	 * on the first export and then never changed, and sequence number of
+	 * the next export, which is the IV of its encryption. Both are written
+	 * with the rd granule lock held.
+	 */
+	bool export_key_valid;
+	unsigned char export_key[EXPORT_KEY_SIZE];
+	unsigned long export_seq;
+
+	/*
+	 * Incremented whenever a valid Protected IPA of the Realm is unmapped
+	 * or its RIPAS set to EMPTY, so that the RECs can tell whether the
+	 * translations they have cached are still valid. Accessed with
+	 * atomic operations, without holding the rd granule lock.
+	 */
+	uint64_t s2_unmap_gen;
+
+	/*
+	 * Number of granules of the Realm in each state, indexed by
+	 * RMI_GRANULE_STATE_*, read by RMI_REALM_FOOTPRINT. Some commands
+	 * update them without holding the rd granule lock, see
+	 * realm_footprint_add().
+	 */
+	uint64_t footprint[RMI_GRANULE_STATE_NR];
+
+	/*
+	 * Granules of the first RD_REC_TABLE_LEN RECs, indexed by REC index,
+	 * so that PSCI requests targeting a REC can be completed without
+	 * exiting to the Host. Only written by RMI_REC_CREATE while the Realm
+	 * is in REALM_STATE_NEW. An entry is not cleared when the REC is
+	 * destroyed, so the state and the content of the granule have to be
+	 * checked under its lock before use.
+	 */
+	struct granule *g_recs[RD_REC_TABLE_LEN];
+
+#ifdef RMM_RIPAS_SUMMARY
+	/*
+	 * Bitmap of the blocks of the PAR in which all the IPAs have RIPAS
+	 * RAM. A bit is set by RSI_IPA_STATE_GET when it finds a block entry
+	 * with RIPAS RAM, and cleared by the RMI commands which can change the
+	 * RIPAS or HIPAS of the block, see realm_ripas_summary_clear().
+	 */
+	uint64_t ripas_summary[RIPAS_SUMMARY_WORDS];
+	/* Incremented whenever bits of ripas_summary are cleared */
+	uint64_t ripas_summary_gen;
+#endif
 };
 COMPILER_ASSERT(sizeof(struct rd) <= GRANULE_SIZE);
 
+/*
+ * Add @n granules in @state to the footprint of the Realm. The rd must be
+ * mapped, and the caller must keep the Realm from being destroyed, but the
+ * rd granule lock need not be held.
+ */
+static inline void realm_footprint_add(struct rd *rd, unsigned long state,
+				       long n)
+{
+	assert(state < RMI_GRANULE_STATE_NR);
+	atomic_add_64(&rd->footprint[state], n);
+}
+
 /*
  * Sets the rd's state while holding the rd granule lock.
  */
@@ -130,6 +304,21 @@ static inline unsigned long get_rd_rec_count_unlocked(struct rd *rd)
 	return SCA_READ64_ACQUIRE(&rd->rec_count);
 }
 
+/*
+ * Records that a valid Protected IPA of the Realm has been unmapped or made
+ * inaccessible. Must be called after the S2TTE has been updated, while the
+ * RTT holding it is locked.
+ */
+static inline void realm_s2_unmap_gen_inc(struct rd *rd)
+{
+	atomic_add_64(&rd->s2_unmap_gen, 1L);
+}
+
+static inline uint64_t realm_s2_unmap_gen(struct rd *rd)
+{
+	return SCA_READ64_ACQUIRE(&rd->s2_unmap_gen);
+}
+
 static inline unsigned long realm_ipa_bits(struct rd *rd)
 {
 	return rd->s2_ctx.ipa_bits;
@@ -225,6 +414,7 @@ enum s2_walk_status {
 
 struct s2_walk_result {
 	unsigned long pa;
+	unsigned long size;
 	unsigned long rtt_level;
 	enum ripas ripas;
 	bool destroyed;
@@ -237,11 +427,40 @@ static inline bool s2_walk_result_match_ripas(struct s2_walk_result *res,
 	return (!res->destroyed && (res->ripas == ripas));
 }
 
+/* PA range backing a part of an IPA range, see realm_ipa_range_to_pa() */
+struct s2_walk_extent {
+	unsigned long pa;
+	unsigned long size;
+};
+
 enum s2_walk_status realm_ipa_to_pa(struct rd *rd,
 				    unsigned long ipa,
 				    struct s2_walk_result *res);
 
+enum s2_walk_status realm_ipa_range_to_pa(struct rd *rd,
+					  unsigned long ipa,
+					  unsigned long size,
+					  struct s2_walk_extent *extents,
+					  unsigned int *nr_extents,
+					  struct s2_walk_result *res);
+
 enum s2_walk_status realm_ipa_get_ripas(struct rec *rec, unsigned long ipa,
 					enum ripas *ripas_ptr,
 					unsigned long *rtt_level);
+
+bool realm_data_pool_map(struct rec *rec, unsigned long ipa);
+bool realm_wp_dirty_fault(struct rec *rec, unsigned long ipa);
+
+#ifdef RMM_RIPAS_SUMMARY
+void realm_ripas_summary_clear(struct rd *rd, unsigned long base,
+			       unsigned long top);
+#else
+static inline void realm_ripas_summary_clear(struct rd *rd, unsigned long base,
+					     unsigned long top)
+{
+	(void)rd;
+	(void)base;
+	(void)top;
+}
+#endif
 #endif /* REALM_H */
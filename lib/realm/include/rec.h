@@ -19,6 +19,24 @@
 #include <utils_def.h>
 
 struct granule;
+struct rd;
+
+/*
+ * Pointer authentication keys of a REC, which are only switched when the
+ * REC runs on a CPU whose keys are those of another REC.
+ */
+struct pauth_state {
+	unsigned long apiakeylo_el1;
+	unsigned long apiakeyhi_el1;
+	unsigned long apibkeylo_el1;
+	unsigned long apibkeyhi_el1;
+	unsigned long apdakeylo_el1;
+	unsigned long apdakeyhi_el1;
+	unsigned long apdbkeylo_el1;
+	unsigned long apdbkeyhi_el1;
+	unsigned long apgakeylo_el1;
+	unsigned long apgakeyhi_el1;
+};
 
 /*
  * System registers whose contents are specific to a REC.
@@ -55,6 +73,7 @@ struct sysreg_state {
 	unsigned long mdccint_el1;
 	unsigned long disr_el1;
 	unsigned long mpam0_el1;
+	unsigned long mpam1_el1;
 
 	/* Timer Registers */
 	unsigned long cnthctl_el2;
@@ -68,9 +87,8 @@ struct sysreg_state {
 	/* GIC Registers */
 	struct gic_cpu_state gicstate;
 
-	/* TODO MPAM */
-	/* TODO Performance Monitor Registers */
-	/* TODO Pointer Authentication Registers */
+	/* Pointer Authentication Registers, see RMM_PAUTH */
+	struct pauth_state pauth;
 
 	unsigned long vmpidr_el2;	/* restored only */
 	unsigned long hcr_el2;		/* restored only */
@@ -84,6 +102,7 @@ struct common_sysreg_state {
 	unsigned long vttbr_el2;
 	unsigned long vtcr_el2;
 	unsigned long hcr_el2;
+	unsigned long mdcr_el2;
 };
 
 /*
@@ -98,48 +117,208 @@ struct ns_state {
 	struct sve_state *sve;
 } __attribute__((aligned(CACHE_WRITEBACK_GRANULE)));
 
+/*
+ * Bounds of the number of consecutive WFE traps that RMM resumes without
+ * exiting to the Host, when REC_ENTRY_FLAG_WFE_POLL is set.
+ */
+#define REC_WFE_POLL_MIN	1U
+#define REC_WFE_POLL_MAX	64U
+
+/* Bit of rec->sgi_post set while the REC accepts posted SGIs */
+#define REC_SGI_POST_OPEN_BIT	63
+
+/* Number of event counters of PMUv3 */
+#define PMU_MAX_EVENT_CTRS	31U
+
+/*
+ * PMU state of the Realm, other than PMCR_EL0 and PMUSERENR_EL0 which are
+ * switched with the other system registers on every REC entry.
+ */
+struct pmu_state {
+	unsigned long pmccfiltr_el0;
+	unsigned long pmccntr_el0;
+	unsigned long pmcntenset_el0;
+	unsigned long pmintenset_el1;
+	unsigned long pmovsset_el0;
+	unsigned long pmselr_el0;
+	unsigned long pmevcntr_el0[PMU_MAX_EVENT_CTRS];
+	unsigned long pmevtyper_el0[PMU_MAX_EVENT_CTRS];
+};
+COMPILER_ASSERT(sizeof(struct pmu_state) <= GRANULE_SIZE);
+
+/*
+ * SPE state, switched on every REC entry and exit when RMM is built with
+ * RMM_SPE. It is all zero, and profiling is disabled, for the Realms
+ * without SPE_EN.
+ */
+struct spe_state {
+	unsigned long pmscr_el1;
+	unsigned long pmsicr_el1;
+	unsigned long pmsirr_el1;
+	unsigned long pmsfcr_el1;
+	unsigned long pmsevfr_el1;
+	unsigned long pmslatfr_el1;
+	unsigned long pmblimitr_el1;
+	unsigned long pmbptr_el1;
+	unsigned long pmbsr_el1;
+};
+
 /*
  * This structure contains pointers to data that is allocated
  * in auxilary granules.
  */
 struct rec_aux_data {
+	void *aux; /* Mapping of the auxiliary granules, NULL if unmapped. */
 	uint8_t *attest_heap_buf; /* Pointer to the heap buffer of this REC. */
+	struct pmu_state *pmu; /* PMU state, in the granule after the heap. */
 };
 
+/*
+ * The auxiliary granules of a REC hold its attestation heap, unless the
+ * RECs share the heaps of RMM_ATTEST_HEAP_POOL, followed by its PMU state.
+ */
+#ifdef RMM_ATTEST_HEAP_POOL
+#define REC_AUX_HEAP_PAGES		0U
+#define REC_NUM_AUX_GRANULES		1U
+#else
+#define REC_AUX_HEAP_PAGES		((unsigned int)REC_HEAP_PAGES)
+#define REC_NUM_AUX_GRANULES		MAX_REC_AUX_GRANULES
+#endif
+
+/* The REC holds no heap of RMM_ATTEST_HEAP_POOL */
+#define REC_ATTEST_HEAP_NONE		(~0U)
+
 /* This structure is used for storing FPU/SIMD context for realm. */
 struct rec_fpu_context {
 	struct fpu_state fpu;
 	bool used;
+	/*
+	 * Number of consecutive REC entries, up to REC_FPU_EAGER_THRESHOLD,
+	 * on which the Realm trapped on its first FPU/SIMD access.
+	 */
+	unsigned char lazy_uses;
+	/* Number of REC entries with an eager switch since the last trap */
+	unsigned char eager_entries;
 };
 
+/*
+ * The FPU/SIMD state of a REC is switched in at REC entry, instead of on the
+ * first FPU/SIMD trap, once the Realm has used FPU/SIMD on this many
+ * consecutive REC entries. One in REC_FPU_EAGER_PERIOD entries is then still
+ * run with the trap enabled, to detect that the Realm stopped using it.
+ */
+#define REC_FPU_EAGER_THRESHOLD		4U
+#define REC_FPU_EAGER_PERIOD		32U
+
+/*
+ * Number of ID registers, in the ID_AA64*_EL1 space of op0 == 3, op1 == 0,
+ * CRn == 0 and CRm == REALM_ID_REGS_CRM_BASE to 7, whose sanitised values
+ * are computed once per Realm.
+ */
+#define REALM_ID_REGS_CRM_BASE	4U
+#define REALM_ID_REGS_LEN	32U
+
 struct rec {
+	/*
+	 * The state below is accessed on every REC entry and exit, and is
+	 * kept at the start of the structure so that it spans as few cache
+	 * lines as possible.
+	 */
+	unsigned long regs[31];
+	unsigned long pc;
+	unsigned long pstate;
+
 	struct granule *g_rec; /* the granule in which this rec lives */
 	unsigned long rec_idx; /* Which rec is this */
 	bool runnable;
 
-	unsigned long regs[31];
-	unsigned long pc;
-	unsigned long pstate;
+	struct {
+		/*
+		 * Set to 'true' when there is a pending PSCI
+		 * command that must be resolved by the host.
+		 * The command is encoded in rec->regs[0].
+		 *
+		 * A REC with pending PSCI is not schedulable.
+		 */
+		bool pending;
+		/*
+		 * REC_ENTRY_FLAG_PSCI_LOCAL was set on the current REC
+		 * entry.
+		 */
+		bool local;
+	} psci_info;
 
-	struct sysreg_state sysregs;
-	struct common_sysreg_state common_sysregs;
+	/* REC_ENTRY_FLAG_TIMER_LOCAL was set on the current REC entry */
+	bool timer_local;
 
+	/* REC_ENTRY_FLAG_SGI_LOCAL was set on the current REC entry */
+	bool sgi_local;
+
+	/* REC_ENTRY_FLAG_NS_EL1_DEAD was set on the current REC entry */
+	bool ns_el1_dead;
+
+	/* True if host call is pending */
+	bool host_call;
+
+	/*
+	 * Set by the handler of the last Realm exit if RMM emulated it without
+	 * touching the timers or the events to inject, see rec_run_loop().
+	 */
+	bool trivial_exit;
+
+	/*
+	 * Virtual interrupts queued by the Host with REC_ENTRY_FLAG_VIRQ_QUEUE,
+	 * in the rec_run of the current REC entry, of which the first @next
+	 * have been injected.
+	 */
 	struct {
-		unsigned long start;
-		unsigned long end;
-		unsigned long addr;
-		enum ripas ripas;
-	} set_ripas;
+		const unsigned long *lrs;
+		unsigned int nr;
+		unsigned int next;
+	} virq_queue;
 
 	/*
-	 * Common values across all RECs in a Realm.
+	 * SGIs posted to the REC by the other RECs of the Realm, in bits
+	 * [15:0]. Bit REC_SGI_POST_OPEN_BIT is set while the REC runs with
+	 * sgi_local, see sgi_post().
+	 */
+	uint64_t sgi_post;
+
+	/*
+	 * Translation of the page holding the rsi_host_call structure of the
+	 * last RSI_HOST_CALL, valid while the s2_unmap_gen of the Realm is
+	 * unchanged.
 	 */
 	struct {
-		unsigned long ipa_bits;
-		int s2_starting_level;
-		struct granule *g_rtt;
-		struct granule *g_rd;
-	} realm_info;
+		bool valid;
+		unsigned long ipa;
+		unsigned long pa;
+		uint64_t gen;
+	} host_call_cache;
+
+	/* REC_ENTRY_FLAG_ATTEST_SIGN_DEFER was set on the current REC entry */
+	bool attest_sign_defer;
+
+	/*
+	 * Set when the PMU holds the state of the Realm, which is then
+	 * saved in rec->aux_data.pmu on REC exit.
+	 */
+	bool pmu_used;
+
+	/* Adaptive polling of the trapped WFE instructions */
+	struct {
+		/* REC_ENTRY_FLAG_WFE_POLL was set on the current REC entry */
+		bool enabled;
+		/* Number of WFE traps resumed from RMM before exiting */
+		unsigned int window;
+		/* Number of WFE traps resumed from RMM in a row */
+		unsigned int count;
+	} wfe_poll;
+
+	struct {
+		unsigned long vsesr_el2;
+		bool inject;
+	} serror_info;
 
 	struct {
 		/*
@@ -153,29 +332,110 @@ struct rec {
 		unsigned long far;
 	} last_run_info;
 
-	/* Structure for storing FPU/SIMD context for realm. */
-	struct rec_fpu_context fpu_ctx;
+	/*
+	 * Common values across all RECs in a Realm.
+	 */
+	struct {
+		unsigned long ipa_bits;
+		struct granule *g_rtt;
+		struct granule *g_rd;
+		int s2_starting_level;
+		unsigned int vmid;
+		unsigned int mecid;
+		bool pmu_enabled;
+		unsigned int pmu_num_ctrs;
+		bool spe_enabled;
+		bool wfx_notrap;
+	} realm_info;
 
 	/* Pointer to per-cpu non-secure state */
 	struct ns_state *ns;
 
+	/* Mapping of the RD during RMI_REC_ENTER, for the RSI handlers */
+	struct rd *rd;
+
+	/* Reset on every REC entry, see rec_attest_heap_map() */
+	struct rec_aux_data aux_data;
+
+	struct sysreg_state sysregs;
+	struct common_sysreg_state common_sysregs;
+
+	/*
+	 * The state below is only accessed by some of the exits or RMI calls.
+	 */
+
+	/* Structure for storing FPU/SIMD context for realm. */
+	struct rec_fpu_context fpu_ctx;
+
+	/* SPE state of the Realm, see RMM_SPE */
+	struct spe_state spe;
+
+	/*
+	 * Unique identifier of the saved pointer authentication keys of the
+	 * REC, which tells whether a CPU holds them. Renewed each time the
+	 * keys are saved. Zero if the Realm does not use Pointer
+	 * Authentication.
+	 */
+	unsigned long pauth_id;
+
 	struct {
-		/*
-		 * Set to 'true' when there is a pending PSCI
-		 * command that must be resolved by the host.
-		 * The command is encoded in rec->regs[0].
-		 *
-		 * A REC with pending PSCI is not schedulable.
-		 */
-		bool pending;
-	} psci_info;
+		unsigned long start;
+		unsigned long end;
+		unsigned long addr;
+		enum ripas ripas;
+	} set_ripas;
+
+	/* Ring of MMIO writes registered by RMI_REC_MMIO_RING */
+	struct {
+		/* NS granule of the ring, NULL if there is none */
+		struct granule *g_ns;
+		/* Number of entries written to the ring */
+		unsigned long head;
+		/* Value of rmi_mmio_ring.tail when it was last read */
+		unsigned long tail;
+		unsigned long nr_regions;
+		struct rmi_mmio_ring_region regions[RMI_MMIO_RING_NR_REGIONS];
+		/* Value of rmi_mmio_ring.nr_consts when it was registered */
+		unsigned long nr_consts;
+	} mmio_ring;
+
+#ifdef RMM_REC_STATS
+	/* Statistics of the REC, read by RMI_REC_STATS */
+	struct {
+		unsigned long exits[RMI_REC_STATS_NR_EXITS];
+		unsigned long exit_ticks[RMI_REC_STATS_NR_EXITS];
+		unsigned long fast_exits;
+		unsigned long timer_polls;
+		unsigned long early_irq_exits;
+		unsigned long realm_ticks;
+		unsigned long rmm_ticks;
+		/* Index + 1 of the CPU the REC last ran on, 0 if none */
+		unsigned long last_cpu;
+		unsigned long entries;
+		unsigned long migrations;
+		unsigned long migration_rmm_ticks;
+		unsigned long mmio_const_reads;
+		/* RMI_REC_STATS_S2_FAULTS .. RMI_REC_STATS_ATTEST_ITERATIONS */
+		unsigned int s2_faults;
+		unsigned int mmio_exits;
+		unsigned int host_calls;
+		unsigned int ripas_changes;
+		unsigned int attest_iterations;
+		/* RMI_REC_STATS_EXIT_* of the last Realm exit */
+		unsigned int last_exit;
+	} stats;
+#endif
+
+	/*
+	 * Attestation state, only accessed by the RSI attestation calls and
+	 * mapped on demand, see rec_attest_heap_map().
+	 */
 
 	/* Number of auxiliary granules */
 	unsigned int num_rec_aux;
 
 	/* Addresses of auxiliary granules */
 	struct granule *g_aux[MAX_REC_AUX_GRANULES];
-	struct rec_aux_data aux_data;
 
 	unsigned char rmm_realm_token_buf[SZ_1K];
 	struct q_useful_buf_c rmm_realm_token;
@@ -186,15 +446,12 @@ struct rec {
 	struct {
 		struct buffer_alloc_ctx ctx;
 		bool ctx_initialised;
+		/*
+		 * Heap of RMM_ATTEST_HEAP_POOL held from RSI_ATTEST_TOKEN_INIT
+		 * until the token is signed, or REC_ATTEST_HEAP_NONE
+		 */
+		unsigned int pool_slot;
 	} alloc_info;
-
-	struct {
-		unsigned long vsesr_el2;
-		bool inject;
-	} serror_info;
-
-	/* True if host call is pending */
-	bool host_call;
 };
 COMPILER_ASSERT(sizeof(struct rec) <= GRANULE_SIZE);
 
@@ -223,12 +480,31 @@ static inline unsigned long mpidr_to_rec_idx(unsigned long mpidr)
 }
 
 void rec_run_loop(struct rec *rec, struct rmi_rec_exit *rec_exit);
+bool rec_cpu_is_warm(const struct rec *rec, unsigned int cpu);
+
+/*
+ * Lock and map the REC of the Realm of the running @rec with index @rec_idx.
+ * Returns NULL if the rd has not recorded the granule of that REC or if the
+ * granule no longer holds it. The REC is unmapped and unlocked by
+ * rec_unmap_sibling().
+ */
+struct rec *rec_map_sibling(struct rec *rec, unsigned long rec_idx);
+void rec_unmap_sibling(struct rec *sibling);
+void rec_attest_heap_map(struct rec *rec);
+void rec_attest_heap_unmap(struct rec *rec);
+bool rec_attest_heap_acquire(struct rec *rec);
+void rec_attest_heap_release(struct rec *rec);
+unsigned long rec_attest_heaps_used(unsigned long *nr);
+void rec_fpu_switch_in(struct rec *rec);
 
 unsigned long smc_rec_create(unsigned long rec_addr,
 			     unsigned long rd_addr,
 			     unsigned long rec_params_addr);
 
-unsigned long smc_rec_destroy(unsigned long rec_addr);
+void smc_rec_destroy(unsigned long rec_addr,
+		     unsigned long count,
+		     unsigned long flags,
+		     struct smc_result *ret);
 
 unsigned long smc_rec_enter(unsigned long rec_addr,
 			    unsigned long rec_run_addr);
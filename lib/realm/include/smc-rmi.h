@@ -48,6 +48,12 @@
 
 #define REC_PARAMS_FLAG_RUNNABLE	(1UL << 0U)
 
+/*
+ * Run the REC with the MPAM partition in rmi_rec_params.mpam instead of the
+ * one of the Realm, see RMM_MPAM. The flag is not part of the measurement.
+ */
+#define REC_PARAMS_FLAG_MPAM		(1UL << 1U)
+
 /*
  * The number of GPRs (starting from X0) per voluntary exit context.
  * Per SMCCC.
@@ -61,6 +67,9 @@
 /* Maximum number of Interrupt Controller List Registers */
 #define REC_GIC_NUM_LRS			(16U)
 
+/* Maximum number of virtual interrupts queued with REC_ENTRY_FLAG_VIRQ_QUEUE */
+#define REC_GIC_NUM_QUEUED_LRS		(64U)
+
 /* Maximum number of auxiliary granules required for a REC */
 #define MAX_REC_AUX_GRANULES		(16U)
 
@@ -71,6 +80,65 @@
 #define REC_ENTRY_FLAG_TRAP_WFI		(1UL << 2U)
 #define REC_ENTRY_FLAG_TRAP_WFE		(1UL << 3U)
 
+/*
+ * Resume the Realm from RMM on some of the trapped WFE instructions before
+ * exiting to the host, see REC_ENTRY_FLAG_TRAP_WFE
+ */
+#define REC_ENTRY_FLAG_WFE_POLL		(1UL << 4U)
+
+/*
+ * Leave the signing of the Realm token to RMI_REC_ATTEST_SIGN. The REC
+ * then exits with RMI_EXIT_ATTEST_SIGN instead of signing the token in
+ * RSI_ATTEST_TOKEN_CONTINUE.
+ */
+#define REC_ENTRY_FLAG_ATTEST_SIGN_DEFER	(1UL << 5U)
+
+/*
+ * Let RMM complete PSCI_AFFINITY_INFO and PSCI_CPU_ON when it can access
+ * the target REC, instead of leaving it to RMI_PSCI_COMPLETE. A PSCI_CPU_ON
+ * completed by RMM still exits with RMI_EXIT_PSCI so that the Host can
+ * schedule the target REC, with RMI_EXIT_PSCI_COMPLETED in gprs[2].
+ */
+#define REC_ENTRY_FLAG_PSCI_LOCAL	(1UL << 6U)
+
+/*
+ * Let RMM inject the EL1 timer interrupts of the Realm into a free LR while
+ * the REC runs, instead of exiting with RMI_EXIT_IRQ when a timer output
+ * changes. The LRs written by RMM are returned in gicv3_lrs on the next REC
+ * exit and are owned by the Host from then on. The Host must not inject the
+ * timer interrupts itself while this flag is set. RMM still exits with
+ * RMI_EXIT_IRQ when no LR is free.
+ */
+#define REC_ENTRY_FLAG_TIMER_LOCAL	(1UL << 7U)
+
+/*
+ * Let RMM post an SGI sent by the REC to another REC of the Realm which runs
+ * on another PE and was also entered with this flag, instead of exiting with
+ * RMI_EXIT_SYNC. The target REC injects the SGI into a free LR, which is
+ * returned in gicv3_lrs on its next REC exit as for REC_ENTRY_FLAG_TIMER_LOCAL.
+ */
+#define REC_ENTRY_FLAG_SGI_LOCAL	(1UL << 8U)
+
+/*
+ * The Host does not need the EL1 and EL0 system registers which only hold
+ * the context of its own EL1 guest, such as a VHE Host running no guest, to
+ * be preserved across the REC entry. RMM does not save them and leaves them
+ * zeroed on REC exit. The registers shared with the Host at EL2 and EL0 are
+ * preserved as usual.
+ */
+#define REC_ENTRY_FLAG_NS_EL1_DEAD	(1UL << 9U)
+
+/*
+ * Let RMM inject the gicv3_queued_nr interrupts of gicv3_queued_lrs, in
+ * order, into the LRs freed by the REC while it runs, instead of the Host
+ * waiting for an underflow maintenance interrupt exit to refill the LRs.
+ * Each value is an LR value holding a pending interrupt. The number of them
+ * injected is returned in gicv3_queued_done and the LRs used are returned in
+ * gicv3_lrs on the REC exit. RMM only exits because of the queue when no LR
+ * is free for its next interrupt and the REC frees none.
+ */
+#define REC_ENTRY_FLAG_VIRQ_QUEUE	(1UL << 10U)
+
 /*
  * RmiRecExitReason represents the reason for a REC exit.
  * This is returned to NS hosts via RMI_REC_ENTER::run_ptr.
@@ -82,6 +150,40 @@
 #define RMI_EXIT_RIPAS_CHANGE		(4U)
 #define RMI_EXIT_HOST_CALL		(5U)
 #define RMI_EXIT_SERROR			(6U)
+#define RMI_EXIT_ATTEST_SIGN		(7U)
+
+/*
+ * Value of gprs[2] on RMI_EXIT_PSCI for a PSCI_CPU_ON which RMM has already
+ * completed, see REC_ENTRY_FLAG_PSCI_LOCAL
+ */
+#define RMI_EXIT_PSCI_COMPLETED		(1UL)
+
+/*
+ * Flags reported in the ripas_split field of struct rmi_rec_exit on
+ * RMI_EXIT_RIPAS_CHANGE, set when the entry of the RTT walk at the first
+ * (HEAD) or at the last (TAIL) RMI_RTT_SET_RIPAS of the change is a block
+ * mapping, which the RTTs down to its level split.
+ */
+#define RMI_RIPAS_SPLIT_HEAD		(1UL << 0)
+#define RMI_RIPAS_SPLIT_TAIL		(1UL << 1)
+
+/*
+ * RmiPmuOverflowStatus, reported in the pmu_ovf_status field of
+ * struct rmi_rec_exit. When it is ACTIVE, an overflow interrupt of the Realm
+ * PMU is pending, and the Host is expected to inject the PMU PPI through the
+ * GIC list registers on the next REC entry.
+ */
+#define RMI_PMU_OVERFLOW_NOT_ACTIVE	(0UL)
+#define RMI_PMU_OVERFLOW_ACTIVE		(1UL)
+
+/*
+ * Status of the SPE profiling buffer interrupt of the Realm, reported in the
+ * spe_irq_status field of struct rmi_rec_exit. When it is ACTIVE, the Host
+ * is expected to inject the SPE PPI through the GIC list registers on the
+ * next REC entry. See RMM_SPE.
+ */
+#define RMI_SPE_IRQ_NOT_ACTIVE		(0UL)
+#define RMI_SPE_IRQ_ACTIVE		(1UL)
 
 /* RmiRttEntryState represents the state of an RTTE */
 #define RMI_RTT_STATE_UNASSIGNED	(0U)
@@ -89,6 +191,7 @@
 #define RMI_RTT_STATE_ASSIGNED		(2U)
 #define RMI_RTT_STATE_TABLE		(3U)
 #define RMI_RTT_STATE_VALID_NS		(4U)
+#define RMI_RTT_STATE_EXPORTED		(5U)
 
 /* no parameters */
 #define SMC_RMM_VERSION				SMC64_RMI_FID(U(0x0))
@@ -107,6 +210,20 @@
 #define RMI_NO_MEASURE_CONTENT 0
 #define RMI_MEASURE_CONTENT  1
 
+/*
+ * Flag for RMI_DATA_CREATE and RMI_DATA_CREATE_UNKNOWN to map the data with a
+ * block s2tte at RTT_DATA_BLOCK_LEVEL instead of a page s2tte.
+ */
+#define RMI_DATA_CREATE_BLOCK 2
+
+/*
+ * Flag for RMI_DATA_CREATE to use the content of the DATA granules, which
+ * must have been delegated with RMI_GRANULE_DELEGATE_PRESERVE_RANGE, instead
+ * of copying it from a source granule. The source address must then be the
+ * data address.
+ */
+#define RMI_DATA_CREATE_IN_PLACE 4
+
 /*
  * arg0 == data address
  * arg1 == RD address
@@ -120,6 +237,7 @@
  * arg0 == data address
  * arg1 == RD address
  * arg2 == map address
+ * arg3 == flags
  */
 #define SMC_RMM_DATA_CREATE_UNKNOWN		SMC64_RMI_FID(U(0x4))
 
@@ -137,6 +255,8 @@
 /*
  * arg0 == RD address
  * arg1 == struct rmi_realm_params addr
+ * ret1 == RTT starting level of the Realm
+ * ret2 == number of starting level RTTs used, from rtt_base
  */
 #define SMC_RMM_REALM_CREATE			SMC64_RMI_FID(U(0x8))
 
@@ -154,9 +274,26 @@
 
 /*
  * arg0 == REC address
+ *
+ * With RMI_REC_DESTROY_LIST set in arg0, destroys a list of RECs:
+ * arg0 == address of an NS granule | RMI_REC_DESTROY_LIST. On entry, the
+ *	   granule holds the addresses of the RECs. On return, it holds the
+ *	   addresses of the REC and auxiliary granules freed.
+ * arg1 == number of RECs (1..RMI_REC_DESTROY_LIST_LEN)
+ * arg2 == flags, RMI_REC_DESTROY_UNDELEGATE
+ * ret1 == number of RECs destroyed
+ * ret2 == number of granule addresses written to the list
  */
 #define SMC_RMM_REC_DESTROY			SMC64_RMI_FID(U(0xB))
 
+#define RMI_REC_DESTROY_LIST			(UL(1) << 0)
+
+/* The granules freed are undelegated instead of becoming DELEGATED */
+#define RMI_REC_DESTROY_UNDELEGATE		(UL(1) << 0)
+
+/* Maximum number of RECs destroyed by one RMI_REC_DESTROY with a list */
+#define RMI_REC_DESTROY_LIST_LEN		24UL
+
 /*
  * arg0 == rec address
  * arg1 == rec_run address
@@ -187,6 +324,34 @@
  */
 #define SMC_RMM_RTT_MAP_UNPROTECTED		SMC64_RMI_FID(U(0xF))
 
+/*
+ * arg0 == RD address
+ * arg1 == map address
+ * arg2 == address of the NS granule the encrypted content is written to
+ * ret1 == address of the DATA granule released
+ * ret2 - ret3 == tag of the encrypted content
+ *
+ * Lets the Host move the content of the DATA granule mapped by a valid
+ * page s2tte out of the Realm, so that it can use the granule for
+ * something else until RMI_DATA_IMPORT.
+ *
+ * The content of the granule is encrypted with AES-GCM under a key of the
+ * Realm, generated by RMM on the first export, and written to the NS
+ * granule. The IPA is authenticated with it. The s2tte becomes Exported,
+ * keeping RIPAS RAM and the sequence number of the export, and the DATA
+ * granule becomes DELEGATED. The sequence number is the IV, and one is used
+ * by every call which gets as far as the RTT walk, whether it succeeds or
+ * not.
+ *
+ * A REC accessing an Exported IPA exits to the Host with a Data Abort, as
+ * for an Unassigned IPA with RIPAS RAM. RMI_DATA_DESTROY makes an Exported
+ * s2tte Destroyed, discarding the exported content. Only a page can be
+ * exported, from a Realm created with RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN
+ * and without a memory encryption context of its own, and at most 2^36
+ * times over the life of the Realm.
+ */
+#define SMC_RMM_DATA_EXPORT			SMC64_RMI_FID(U(0x10))
+
 /*
  * arg0 == RD address
  * arg1 == map address
@@ -205,6 +370,25 @@
  */
 #define SMC_RMM_RTT_UNMAP_UNPROTECTED		SMC64_RMI_FID(U(0x12))
 
+/*
+ * arg0 == address of the DELEGATED granule holding the encrypted content
+ * arg1 == RD address
+ * arg2 == map address
+ * arg3 - arg4 == tag returned by RMI_DATA_EXPORT
+ *
+ * Puts back the content exported from the Exported page s2tte at the map
+ * address, see RMI_DATA_EXPORT.
+ *
+ * The granule, delegated by the Host with
+ * RMI_GRANULE_DELEGATE_PRESERVE_RANGE after loading the encrypted content
+ * in it, is decrypted in place. If the tag matches the content, the IPA and
+ * the sequence number kept in the Exported s2tte, the granule becomes DATA
+ * and is mapped again. Otherwise RMI_ERROR_INPUT is returned and the
+ * granule stays DELEGATED, with its content zeroed. The content of an
+ * older export of the IPA fails the check.
+ */
+#define SMC_RMM_DATA_IMPORT			SMC64_RMI_FID(U(0x13))
+
 /*
  * arg0 == calling rec address
  * arg1 == target rec address
@@ -242,9 +426,738 @@
  * arg2 == map address
  * arg3 == level
  * arg4 == ripas
+ * ret1 == address up to which the RIPAS has been changed
  */
 #define SMC_RMM_RTT_SET_RIPAS			SMC64_RMI_FID(U(0x19))
 
+/*
+ * arg0 == base address of the target granule range
+ * arg1 == number of granules in the range
+ * ret1 == number of granules delegated
+ */
+#define SMC_RMM_GRANULE_DELEGATE_RANGE		SMC64_RMI_FID(U(0x1A))
+
+/*
+ * arg0 == base address of the target granule range
+ * arg1 == number of granules in the range
+ * ret1 == number of granules undelegated
+ */
+#define SMC_RMM_GRANULE_UNDELEGATE_RANGE	SMC64_RMI_FID(U(0x1B))
+
+/*
+ * Maximum number of granules processed by a single call to
+ * RMI_GRANULE_DELEGATE_RANGE or RMI_GRANULE_UNDELEGATE_RANGE. Larger ranges
+ * are processed partially and the Host is expected to reissue the command
+ * for the remaining granules.
+ */
+#define RMI_GRANULE_RANGE_MAX_COUNT		(512UL)
+
+/*
+ * arg0 == base data address
+ * arg1 == RD address
+ * arg2 == base map address
+ * arg3 == base SRC address
+ * arg4 == flags
+ * arg5 == number of granules
+ * ret1 == number of granules created
+ */
+#define SMC_RMM_DATA_CREATE_RANGE		SMC64_RMI_FID(U(0x1C))
+
+/*
+ * arg0 == RD address
+ * ret1 == address of an RTT freed by automatic folding, or 0
+ * ret2 == number of automatic folds skipped since the last call because
+ *	   the list of freed RTTs was full
+ *
+ * The Host can fold the RTTs whose automatic fold was skipped with
+ * RMI_RTT_FOLD.
+ */
+#define SMC_RMM_RTT_RECLAIM			SMC64_RMI_FID(U(0x1D))
+
+/*
+ * arg0 == RD address
+ * arg1 == base of target IPA range
+ * arg2 == top of target IPA range
+ * arg3 == RTT level
+ * ret1 == IPA following the last entry initialised
+ */
+#define SMC_RMM_RTT_INIT_RIPAS_RANGE		SMC64_RMI_FID(U(0x1E))
+
+/*
+ * arg0 == FID of the RMI command
+ * arg1 == CPU index
+ * arg2 == statistic, one of RMI_STATS_*
+ * ret1 == value of the statistic
+ *
+ * For RMI_STATS_MAX_STACK, arg0 can also be the FID of an RSI command.
+ *
+ * For RMI_STATS_BOOT_PHASE, arg0 is ignored and arg1 is one of
+ * RMI_BOOT_PHASE_*. ret1 is the number of CNTPCT_EL0 ticks spent in the
+ * phase and ret2 the CNTPCT_EL0 value when it started. The command fails
+ * if the phase has not completed yet.
+ *
+ * For RMI_STATS_PAGE, arg0 is the NS address of a granule to which RMM
+ * writes its statistics as struct rmi_stats_page, or 0 to stop, and arg1 the
+ * minimum interval between two writes, in microseconds, up to
+ * RMI_STATS_PAGE_MAX_INTERVAL_US.
+ */
+#define SMC_RMM_RMI_STATS			SMC64_RMI_FID(U(0x1F))
+
+/* Statistics kept for each RMI command when RMM_RMI_STATS is enabled */
+#define RMI_STATS_CALLS				0UL	/* Number of calls */
+#define RMI_STATS_ERRORS			1UL	/* Number of failed calls */
+#define RMI_STATS_TICKS				2UL	/* Total CNTPCT_EL0 ticks */
+#define RMI_STATS_MAX_TICKS			3UL	/* Longest call, in ticks */
+#define RMI_STATS_SLOT_MAPS			4UL	/* Slot buffers mapped */
+#define RMI_STATS_S1_FLUSHES			5UL	/* VMID-wide S1 invalidations */
+
+/* Kept for each RMI and RSI command when RMM_STACK_PROFILE is enabled */
+#define RMI_STATS_MAX_STACK			6UL	/* Deepest stack, bytes */
+
+/* Kept for each phase of the cold boot, by all builds */
+#define RMI_STATS_BOOT_PHASE			7UL
+
+/* Registers the granule of struct rmi_stats_page, by all builds */
+#define RMI_STATS_PAGE				8UL
+#define RMI_STATS_PAGE_MAX_INTERVAL_US		60000000UL
+
+/* Phases of the cold boot of RMM */
+#define RMI_BOOT_PHASE_EL3_IFC			0UL	/* RMM-EL3 interface */
+#define RMI_BOOT_PHASE_XLAT			1UL	/* Xlat tables build */
+#define RMI_BOOT_PHASE_GRANULES			2UL	/* Granule table init */
+#define RMI_BOOT_PHASE_SLOT_BUF			3UL	/* Slot buffers init */
+#define RMI_BOOT_PHASE_PRNG			4UL	/* PRNG seeding */
+#define RMI_BOOT_PHASE_ATTEST_KEY		5UL	/* Attestation key */
+#define RMI_BOOT_PHASE_PLAT_TOKEN		6UL	/* Platform token */
+#define RMI_BOOT_PHASE_NR			7UL
+
+/*
+ * arg0 == NS address of the granule to copy the trace to
+ * arg1 == CPU index, ORed with RMI_TRACE_DUMP_PC_SAMPLES to copy the PC
+ *	   samples of the CPU recorded with RMM_PC_SAMPLE instead
+ */
+#define SMC_RMM_TRACE_DUMP			SMC64_RMI_FID(U(0x20))
+
+#define RMI_TRACE_DUMP_PC_SAMPLES		(UL(1) << 63)
+
+/*
+ * arg0 == REC address
+ * arg1 == statistic, one of RMI_REC_STATS_*
+ * ret1 == value of the statistic
+ */
+#define SMC_RMM_REC_STATS			SMC64_RMI_FID(U(0x21))
+
+/*
+ * Statistics kept for each REC when RMM_REC_STATS is enabled. The first
+ * RMI_REC_STATS_NR_EXITS values count the exits from the Realm by cause,
+ * whether they are handled by RMM or returned to the Host.
+ */
+#define RMI_REC_STATS_EXIT_WFX			0UL
+#define RMI_REC_STATS_EXIT_HVC			1UL
+#define RMI_REC_STATS_EXIT_RSI			2UL
+#define RMI_REC_STATS_EXIT_SYSREG		3UL
+#define RMI_REC_STATS_EXIT_INST_ABORT		4UL
+#define RMI_REC_STATS_EXIT_DATA_ABORT		5UL
+#define RMI_REC_STATS_EXIT_FPU			6UL
+#define RMI_REC_STATS_EXIT_SYNC_OTHER		7UL
+#define RMI_REC_STATS_EXIT_IRQ			8UL
+#define RMI_REC_STATS_EXIT_FIQ			9UL
+#define RMI_REC_STATS_EXIT_SERROR		10UL
+#define RMI_REC_STATS_NR_EXITS			11UL
+/* CNTPCT_EL0 ticks spent running the Realm */
+#define RMI_REC_STATS_REALM_TICKS		11UL
+/* CNTPCT_EL0 ticks spent in RMM during REC_ENTER */
+#define RMI_REC_STATS_RMM_TICKS			12UL
+/*
+ * CNTPCT_EL0 ticks spent in RMM handling the exits of each cause, from the
+ * exit up to the next entry into the Realm or the return to the Host. The
+ * statistic for a cause is RMI_REC_STATS_EXIT_TICKS + RMI_REC_STATS_EXIT_*.
+ */
+#define RMI_REC_STATS_EXIT_TICKS		13UL
+/* Exits after which the Realm was re-entered through the fast path */
+#define RMI_REC_STATS_FAST_EXITS		24UL
+/*
+ * Reads of ICC_HPPIR1_EL1 on REC entry which found a masked timer interrupt
+ * still pending
+ */
+#define RMI_REC_STATS_TIMER_POLLS		25UL
+/*
+ * Usage of the attestation heap of the REC, see struct buffer_alloc_stats.
+ * The sizes are in bytes and include the headers of the allocator.
+ */
+#define RMI_REC_STATS_HEAP_ALLOCS		26UL
+#define RMI_REC_STATS_HEAP_ALLOC_FAILURES	27UL
+#define RMI_REC_STATS_HEAP_FREES		28UL
+#define RMI_REC_STATS_HEAP_CUR_BYTES		29UL
+#define RMI_REC_STATS_HEAP_PEAK_BYTES		30UL
+#define RMI_REC_STATS_HEAP_ALLOC_TICKS		31UL
+#define RMI_REC_STATS_HEAP_MAX_ALLOC_TICKS	32UL
+/*
+ * The following statistics walk the heap, so the REC must not be running.
+ * The fragmentation is the percentage of the free bytes which are not in
+ * the largest free block.
+ */
+#define RMI_REC_STATS_HEAP_FREE_BYTES		33UL
+#define RMI_REC_STATS_HEAP_LARGEST_FREE		34UL
+#define RMI_REC_STATS_HEAP_FRAGMENTATION	35UL
+/*
+ * REC entries which returned RMI_EXIT_IRQ without entering the Realm, as an
+ * IRQ was already pending
+ */
+#define RMI_REC_STATS_EARLY_IRQ_EXITS		36UL
+/*
+ * Placement hints. LAST_CPU is the index of the CPU the REC last ran on, or
+ * UINT64_MAX if it never ran. LAST_CPU_WARM is 1 if no other Realm has run
+ * on that CPU since, so that its stage 2 context is still loaded there and
+ * its TLB entries may still be cached. FPU_EAGER is 1 if the FPU/SIMD state
+ * of the REC is loaded on each entry as the Realm keeps using it. It is
+ * saved back to the REC on each exit, so it is never left on a CPU.
+ */
+#define RMI_REC_STATS_LAST_CPU			37UL
+#define RMI_REC_STATS_LAST_CPU_WARM		38UL
+#define RMI_REC_STATS_FPU_EAGER			39UL
+/*
+ * REC entries, REC entries on another CPU than the previous one and
+ * CNTPCT_EL0 ticks spent in RMM during the latter. The cost of a migration
+ * is estimated by comparing the RMM ticks per entry of both.
+ */
+#define RMI_REC_STATS_ENTRIES			40UL
+#define RMI_REC_STATS_MIGRATIONS		41UL
+#define RMI_REC_STATS_MIGRATION_RMM_TICKS	42UL
+/* MMIO reads served from the constants of the MMIO ring of the REC */
+#define RMI_REC_STATS_MMIO_CONST_READS		43UL
+/*
+ * Stage 2 faults at Protected IPAs and accesses to Unprotected IPAs reported
+ * to the Host, RSI_HOST_CALL and RSI_IPA_STATE_SET requests made to the Host
+ * and signing iterations of RSI_ATTEST_TOKEN_CONTINUE. These are 32-bit
+ * counters which wrap around. The Realm reads them with RSI_REC_STATS.
+ */
+#define RMI_REC_STATS_S2_FAULTS			44UL
+#define RMI_REC_STATS_MMIO_EXITS		45UL
+#define RMI_REC_STATS_HOST_CALLS		46UL
+#define RMI_REC_STATS_RIPAS_CHANGES		47UL
+#define RMI_REC_STATS_ATTEST_ITERATIONS		48UL
+
+/*
+ * arg0 == REC address
+ * arg1 == NS address of the MMIO write ring, or 0 to remove it
+ *
+ * The ring also holds the constant MMIO reads of the REC, see
+ * struct rmi_mmio_ring.
+ */
+#define SMC_RMM_REC_MMIO_RING			SMC64_RMI_FID(U(0x22))
+
+/*
+ * arg0 == REC address
+ * ret1 == 1 if the Realm token is signed, 0 if the signing was interrupted
+ */
+#define SMC_RMM_REC_ATTEST_SIGN			SMC64_RMI_FID(U(0x23))
+
+/* No parameters */
+#define SMC_RMM_PLATFORM_TOKEN_REFRESH		SMC64_RMI_FID(U(0x24))
+
+/*
+ * arg0 == lowest VMID to return
+ * ret1 == VMID not in use by any Realm
+ */
+#define SMC_RMM_VMID_FIND			SMC64_RMI_FID(U(0x25))
+
+/*
+ * arg0 == RD address
+ * arg1 == address of the NS list of reclaimed granules
+ * ret1 == number of granule addresses written to the list
+ *
+ * Returns RMI_INCOMPLETE, with ret1 as above, if the teardown was preempted.
+ */
+#define SMC_RMM_REALM_TEARDOWN			SMC64_RMI_FID(U(0x26))
+
+/* Maximum number of granule addresses returned by RMI_REALM_TEARDOWN */
+#define RMI_REALM_TEARDOWN_LIST_LEN		(GRANULE_SIZE / sizeof(unsigned long))
+
+/*
+ * arg0 == RD address
+ * arg1 == address of the NS list of struct rmi_rec_create_entry
+ * arg2 == number of entries of the list
+ * ret1 == number of RECs created
+ */
+#define SMC_RMM_REC_CREATE_MULTI		SMC64_RMI_FID(U(0x27))
+
+/* Maximum number of RECs created by one RMI_REC_CREATE_MULTI */
+#define RMI_REC_CREATE_MULTI_LEN		64UL
+
+/*
+ * arg0 == RD address
+ * arg1 == base IPA
+ * arg2 == top IPA
+ * arg3 == RTT level
+ * arg4 == s2tte of the first entry
+ * ret1 == IPA following the last entry mapped
+ */
+#define SMC_RMM_RTT_MAP_UNPROTECTED_RANGE	SMC64_RMI_FID(U(0x28))
+
+/*
+ * arg0 == RD address
+ * arg1 == base IPA
+ * arg2 == top IPA
+ * arg3 == RTT level
+ * ret1 == IPA following the last entry unmapped
+ */
+#define SMC_RMM_RTT_UNMAP_UNPROTECTED_RANGE	SMC64_RMI_FID(U(0x29))
+
+/*
+ * arg0 == RD address
+ * arg1 == IPA translated by the RTT
+ * arg2 == RTT level
+ * arg3 == address of the NS granule the entries are written to
+ * ret1 == IPA translated by the first entry of the RTT
+ *
+ * Each entry is written as one 64-bit word holding the output address
+ * returned by RMI_RTT_READ_ENTRY in bits [47:0], with the state and the
+ * RIPAS at the shifts below. The level of all the entries is arg2.
+ */
+#define SMC_RMM_RTT_READ_ENTRIES		SMC64_RMI_FID(U(0x2A))
+
+/*
+ * arg0 == table, one of RMI_PMU_PROFILE_TABLE_*
+ * arg1 == entry of the table: FID of the RMI command for
+ *	   RMI_PMU_PROFILE_TABLE_RMI, or one of RMI_REC_STATS_EXIT_* for
+ *	   RMI_PMU_PROFILE_TABLE_REC_EXIT
+ * arg2 == CPU index
+ * arg3 == counter, one of RMI_PMU_PROFILE_*
+ * ret1 == value of the counter
+ */
+#define SMC_RMM_PMU_PROFILE			SMC64_RMI_FID(U(0x2B))
+
+/* Tables kept for each CPU when RMM_PMU_PROFILE is enabled */
+#define RMI_PMU_PROFILE_TABLE_RMI		0UL	/* RMI commands */
+#define RMI_PMU_PROFILE_TABLE_REC_EXIT		1UL	/* Realm exit causes */
+
+/* Counters kept for each entry of the tables, counted at EL2 only */
+#define RMI_PMU_PROFILE_SAMPLES			0UL	/* Number of samples */
+#define RMI_PMU_PROFILE_CYCLES			1UL	/* CPU_CYCLES */
+#define RMI_PMU_PROFILE_L1D_REFILLS		2UL	/* L1D_CACHE_REFILL */
+#define RMI_PMU_PROFILE_L2D_REFILLS		3UL	/* L2D_CACHE_REFILL */
+#define RMI_PMU_PROFILE_TLB_WALKS		4UL	/* DTLB_WALK */
+#define RMI_PMU_PROFILE_BR_MISPREDS		5UL	/* BR_MIS_PRED */
+
+/*
+ * arg0 == RD address
+ * arg1 == IPA translated by the RTT
+ * arg2 == RTT level
+ * arg3 == address of the NS granule the bitmaps are written to
+ * ret1 == IPA translated by the first entry of the RTT
+ *
+ * Only for a Realm created with HAFDBS_EN or WP_DIRTY_EN. Bit i of the
+ * bitmap at RMI_RTT_SCAN_ACCESSED_OFFSET, resp. RMI_RTT_SCAN_DIRTY_OFFSET, is
+ * set if entry i of the RTT is in the ASSIGNED state with RIPAS RAM and has
+ * been accessed, resp. written, by the Realm since it was mapped or last
+ * scanned.
+ * The access and dirty state of all the entries of the RTT is cleared.
+ *
+ * For a Realm created with WP_DIRTY_EN, RMM write-protects the entries
+ * instead and gives write access back on the first write of the Realm,
+ * without a REC exit. The accessed bitmap is then all zeroes.
+ */
+#define SMC_RMM_RTT_SCAN_ACCESS			SMC64_RMI_FID(U(0x2C))
+
+#define RMI_RTT_SCAN_ACCESSED_OFFSET		0UL
+#define RMI_RTT_SCAN_DIRTY_OFFSET		0x40UL
+
+/*
+ * arg0 == state the granules transition from, one of RMI_GRANULE_STATE_*
+ * arg1 == state the granules transition to, one of RMI_GRANULE_STATE_*
+ * arg2 == CPU index
+ * ret1 == number of transitions made by the CPU
+ *
+ * If arg0 == arg1, ret1 is instead the number of granules currently in the
+ * state, counted from the transitions of all the CPUs, and arg2 is ignored.
+ * This is not available for RMI_GRANULE_STATE_NS.
+ */
+#define SMC_RMM_GRANULE_STATS			SMC64_RMI_FID(U(0x2D))
+
+/* Granule states, as counted by RMI_GRANULE_STATS and RMI_REALM_FOOTPRINT */
+#define RMI_GRANULE_STATE_NS			0UL
+#define RMI_GRANULE_STATE_DELEGATED		1UL
+#define RMI_GRANULE_STATE_RD			2UL
+#define RMI_GRANULE_STATE_REC			3UL
+#define RMI_GRANULE_STATE_REC_AUX		4UL
+#define RMI_GRANULE_STATE_DATA			5UL
+#define RMI_GRANULE_STATE_RTT			6UL
+#define RMI_GRANULE_STATE_RTT_SHARED		7UL
+#define RMI_GRANULE_STATE_NR			8UL
+
+/*
+ * arg0 == NS address of the granule to copy the REC entry trace to
+ * arg1 == CPU index
+ */
+#define SMC_RMM_REC_EXIT_TRACE_DUMP		SMC64_RMI_FID(U(0x2E))
+
+/*
+ * arg0 == RD address
+ * arg1 == granule state, one of RMI_GRANULE_STATE_RD, _REC, _REC_AUX,
+ *	   _DATA or _RTT
+ * ret1 == number of granules of the Realm in the state
+ */
+#define SMC_RMM_REALM_FOOTPRINT			SMC64_RMI_FID(U(0x2F))
+
+/*
+ * arg0 == RD address
+ * arg1 == base address of the DELEGATED granules
+ * arg2 == number of granules
+ * ret1 == number of granules added to the RTT pool of the Realm
+ */
+#define SMC_RMM_RTT_POOL_DONATE			SMC64_RMI_FID(U(0x30))
+
+/*
+ * arg0 == RD address
+ * arg1 == NS address of the granule to write the list of used RTTs to
+ * ret1 == number of addresses written
+ * ret2 == number of granules left in the RTT pool
+ */
+#define SMC_RMM_RTT_POOL_REPORT			SMC64_RMI_FID(U(0x31))
+
+/*
+ * arg0 == RD address
+ * arg1 == map address
+ * arg2 == level of the deepest RTT to create
+ * arg3-5 == addresses of the RTTs, for the missing levels from the top,
+ *	     terminated by 0 if fewer than RMI_RTT_CREATE_MULTI_LEN
+ * ret1 == level of the deepest RTT which translates the map address
+ * ret2 == number of RTTs created, from the first address
+ */
+#define SMC_RMM_RTT_CREATE_MULTI		SMC64_RMI_FID(U(0x32))
+
+/* Maximum number of RTTs created by one RMI_RTT_CREATE_MULTI */
+#define RMI_RTT_CREATE_MULTI_LEN		3U
+
+/*
+ * arg0 == RD address
+ * arg1 == map address
+ * arg2 == level of the RTT at the top of the subtree
+ * arg3 == address of the NS list of destroyed RTTs
+ * ret1 == number of RTT addresses written to the list
+ * ret2 == 1 if the walk of the subtree completed, 0 if the list is full
+ *
+ * Returns RMI_ERROR_IN_USE once the walk has completed if an RTT of the
+ * subtree still holds a mapping. Its empty descendants are destroyed anyway.
+ */
+#define SMC_RMM_RTT_DESTROY_TREE		SMC64_RMI_FID(U(0x33))
+
+/*
+ * arg0 == RD address
+ * arg1 == base map address
+ * arg2 == top map address
+ * arg3 == address of the NS list of released data granules
+ * ret1 == top of the range processed
+ * ret2 == number of data granule addresses written to the list
+ */
+#define SMC_RMM_DATA_DESTROY_RANGE		SMC64_RMI_FID(U(0x34))
+
+/*
+ * arg0 == type of the job, one of RMI_JOB_*
+ * arg1 == first parameter of the job
+ * arg2 == second parameter of the job
+ * ret1 == identifier of the job
+ *
+ * Returns RMI_ERROR_IN_USE if RMI_JOB_QUEUE_LEN jobs are already queued.
+ */
+#define SMC_RMM_JOB_SUBMIT			SMC64_RMI_FID(U(0x35))
+
+/*
+ * arg0 == identifier of the job
+ * ret1 == RMI_JOB_PENDING or RMI_JOB_DONE
+ * ret2 == RMI status of the job, once it is done
+ * ret3 == number of granules processed by the job
+ *
+ * The job is freed once RMI_JOB_DONE has been returned.
+ */
+#define SMC_RMM_JOB_POLL			SMC64_RMI_FID(U(0x36))
+
+/* Maximum number of jobs submitted and not yet polled as done */
+#define RMI_JOB_QUEUE_LEN			16U
+
+/*
+ * Tear down a Realm as RMI_REALM_TEARDOWN does.
+ * arg1 == RD address
+ * arg2 == address of the NS list of reclaimed granules
+ * ret3 == number of granule addresses written to the list
+ */
+#define RMI_JOB_REALM_TEARDOWN			0UL
+
+/*
+ * Zero ahead of their undelegation the delegated granules of a range.
+ * arg1 == base address of the range
+ * arg2 == number of granules in the range
+ */
+#define RMI_JOB_GRANULE_SCRUB			1UL
+
+#define RMI_JOB_PENDING				0UL
+#define RMI_JOB_DONE				1UL
+
+/*
+ * arg0 == RD address
+ * arg1 == base address of the DELEGATED granules
+ * arg2 == number of granules
+ * ret1 == number of granules added to the DATA pool of the Realm
+ */
+#define SMC_RMM_DATA_POOL_DONATE		SMC64_RMI_FID(U(0x37))
+
+/*
+ * arg0 == RD address
+ * arg1 == NS address of the granule to write the list of
+ *	   struct rmi_data_pool_entry to
+ * ret1 == number of entries written
+ * ret2 == number of granules left in the DATA pool
+ */
+#define SMC_RMM_DATA_POOL_REPORT		SMC64_RMI_FID(U(0x38))
+
+/* Granule of the DATA pool mapped by the RMM on a stage 2 fault */
+struct rmi_data_pool_entry {
+	unsigned long ipa;
+	unsigned long addr;
+};
+
+/*
+ * arg0 == NS address of the granule to write a struct rmi_rtt_walk_hint to
+ *	   when an RMI command run on the calling CPU returns RMI_ERROR_RTT,
+ *	   or 0 to stop writing them
+ */
+#define SMC_RMM_RTT_WALK_HINT			SMC64_RMI_FID(U(0x39))
+
+/* Maximum number of missing RTTs reported by a walk hint */
+#define RMI_RTT_WALK_HINT_LEN			3U
+
+/* RTT to create with RMI_RTT_CREATE */
+struct rmi_rtt_walk_hint_rtt {
+	unsigned long map_addr;
+	unsigned long level;
+};
+
+/*
+ * RTTs missing for the walk of a failed command to reach its target level,
+ * from the shallowest one.
+ */
+struct rmi_rtt_walk_hint {
+	unsigned long map_addr;
+	unsigned long nr_rtts;
+	struct rmi_rtt_walk_hint_rtt rtts[RMI_RTT_WALK_HINT_LEN];
+};
+
+/*
+ * arg0 == number of granules to delegate
+ * arg1-arg16 == addresses of the granules
+ * ret1 == number of granules delegated
+ *
+ * Uses the SMCCC v1.2 extended registers, see RMM_SMCCC_EXT_REGS.
+ */
+#define SMC_RMM_GRANULE_DELEGATE_MULTI		SMC64_RMI_FID(U(0x3A))
+
+/* Maximum number of granules delegated by RMI_GRANULE_DELEGATE_MULTI */
+#define RMI_GRANULE_DELEGATE_MULTI_MAX		(SMC_EXT_ARGS - 1U)
+
+/*
+ * arg0 == base address of the target granule range
+ * arg1 == number of granules in the range
+ * ret1 == number of granules delegated
+ *
+ * Same as RMI_GRANULE_DELEGATE_RANGE, but the granules keep their content,
+ * for RMI_DATA_CREATE with RMI_DATA_CREATE_IN_PLACE to measure it.
+ */
+#define SMC_RMM_GRANULE_DELEGATE_PRESERVE_RANGE	SMC64_RMI_FID(U(0x3B))
+
+/*
+ * arg0 == base address of the granule range
+ * arg1 == number of granules in the range
+ * arg2 == address of the NS granule the states are written to
+ * ret1 == number of granules whose state was written
+ *
+ * The state of each granule, one of RMI_GRANULE_STATE_*, is written as
+ * RMI_GRANULE_STATE_QUERY_BITS bits: the state of granule i is in bits
+ * [4 * (i % 16) + 3 : 4 * (i % 16)] of the 64-bit word i / 16. At most
+ * RMI_GRANULE_STATE_QUERY_MAX granules are written by a call. The states are
+ * read without taking the locks of the granules, so a granule which changes
+ * state during the call may be reported in either state.
+ */
+#define SMC_RMM_GRANULE_STATE_QUERY		SMC64_RMI_FID(U(0x3C))
+
+#define RMI_GRANULE_STATE_QUERY_BITS		4U
+#define RMI_GRANULE_STATE_QUERY_MAX		\
+	((GRANULE_SIZE * 8U) / RMI_GRANULE_STATE_QUERY_BITS)
+
+/*
+ * arg0 == RD address
+ * arg1 == REC address
+ * arg2 == map address
+ * arg3 == level
+ * arg4 == s2tte mapping the unprotected alias of the map address
+ * arg5 == address of the NS list of released data granules
+ * ret1 == address up to which the range has been shared
+ * ret2 == number of data granule addresses written to the list
+ *
+ * Completes a RIPAS change to RMI_EMPTY requested by the REC, as
+ * RMI_RTT_SET_RIPAS, RMI_DATA_DESTROY and RMI_RTT_MAP_UNPROTECTED would for
+ * each entry of the RTT at the level, in one call per RTT.
+ */
+#define SMC_RMM_RTT_SHARE_RANGE			SMC64_RMI_FID(U(0x3D))
+
+/*
+ * arg0 == operation, one of RMI_RTT_SHARED_*
+ * arg1 == address of the shared RTT
+ * arg2 - arg4 == parameters of the operation, see below
+ * ret1 == number of s2ttes changed, for MAP and UNMAP
+ *
+ * A shared RTT is a last level RTT which only holds Unprotected s2ttes, and
+ * which several Realms can link to at the same Unprotected IPAs, instead of
+ * each of them having an RTT of its own with the same mappings.
+ *
+ * CREATE: the DELEGATED granule becomes an RTT whose s2ttes are all
+ *	   Unassigned.
+ * MAP: arg2 == index of the first s2tte, arg3 == number of s2ttes,
+ *	arg4 == s2tte of the first page, as for RMI_RTT_MAP_UNPROTECTED.
+ *	Consecutive s2ttes map consecutive pages, stopping at the first one
+ *	which is not Unassigned.
+ * UNMAP: arg2 == index of the first s2tte, arg3 == number of s2ttes,
+ *	  stopping at the first one which is not mapped.
+ * LINK: arg2 == RD address, arg3 == Unprotected IPA aligned to the size
+ *	 of the RTT. The Unassigned level 2 s2tte of the Realm translating
+ *	 it links to the shared RTT.
+ * DESTROY: the RTT becomes DELEGATED again.
+ *
+ * MAP, UNMAP and DESTROY fail with RMI_ERROR_IN_USE while a Realm links to
+ * the RTT, so that no TLB can hold its s2ttes. A Realm drops its link with
+ * RMI_RTT_DESTROY, RMI_REALM_TEARDOWN or RMI_JOB_SUBMIT, as for an RTT of
+ * its own, but the shared RTT is not freed or reported as freed. The link
+ * is kept by RMI_RTT_DESTROY_TREE and cannot be folded.
+ */
+#define SMC_RMM_RTT_SHARED			SMC64_RMI_FID(U(0x3E))
+
+#define RMI_RTT_SHARED_CREATE			0UL
+#define RMI_RTT_SHARED_MAP			1UL
+#define RMI_RTT_SHARED_UNMAP			2UL
+#define RMI_RTT_SHARED_LINK			3UL
+#define RMI_RTT_SHARED_DESTROY			4UL
+
+#define RMI_RTT_ENTRY_STATE_SHIFT		48U
+#define RMI_RTT_ENTRY_RIPAS_SHIFT		52U
+
+/* Maximum number of IPA regions whose MMIO writes go to the ring */
+#define RMI_MMIO_RING_NR_REGIONS		8U
+
+/* Maximum number of constant MMIO reads in the ring */
+#define RMI_MMIO_RING_NR_CONSTS			8U
+
+struct rmi_mmio_ring_region {
+	unsigned long base;
+	unsigned long size;
+};
+
+/*
+ * MMIO write of @size bytes of @value at @ipa, or constant MMIO read which
+ * returns @value for @size bytes at @ipa
+ */
+struct rmi_mmio_ring_entry {
+	unsigned long ipa;
+	unsigned long value;
+	unsigned long size;
+};
+
+#define RMI_MMIO_RING_ENTRIES	((GRANULE_SIZE - 0x200UL) / \
+				 sizeof(struct rmi_mmio_ring_entry))
+
+/*
+ * Ring of the MMIO writes of a REC, registered by RMI_REC_MMIO_RING.
+ *
+ * The regions are read by RMM when the ring is registered. Writes of the
+ * Realm to these Unprotected IPA regions which the Host can emulate are
+ * appended to the ring by RMM, instead of causing a REC exit, until the ring
+ * is full. RMM increments @head after writing an entry and the Host
+ * increments @tail after consuming one. Entry n is at index
+ * n % RMI_MMIO_RING_ENTRIES. The Host must drain the ring on each REC exit
+ * before handling it, as the entries precede the access causing the exit.
+ *
+ * The number of constant MMIO reads is read by RMM when the ring is
+ * registered, and the constants on each MMIO read of the Realm at an
+ * Unprotected IPA, so that the Host may update their values at any time. A
+ * read whose IPA and size in bytes match one of them returns its value,
+ * extended as the load instruction requires, without a REC exit.
+ */
+struct rmi_mmio_ring {
+	SET_MEMBER(struct {
+			unsigned long nr_regions;		/* 0x0 */
+			struct rmi_mmio_ring_region
+				regions[RMI_MMIO_RING_NR_REGIONS]; /* 0x8 */
+		   }, 0, 0x100);
+	/* Number of entries written by RMM */
+	SET_MEMBER(unsigned long head, 0x100, 0x108);		/* 0x100 */
+	/* Number of entries consumed by the Host */
+	SET_MEMBER(unsigned long tail, 0x108, 0x110);		/* 0x108 */
+	SET_MEMBER(struct {
+			unsigned long nr_consts;		/* 0x110 */
+			struct rmi_mmio_ring_entry
+				consts[RMI_MMIO_RING_NR_CONSTS]; /* 0x118 */
+		   }, 0x110, 0x200);
+	struct rmi_mmio_ring_entry entries[RMI_MMIO_RING_ENTRIES]; /* 0x200 */
+};
+
+COMPILER_ASSERT(sizeof(struct rmi_mmio_ring) <= GRANULE_SIZE);
+
+COMPILER_ASSERT(offsetof(struct rmi_mmio_ring, regions) == 0x8);
+COMPILER_ASSERT(offsetof(struct rmi_mmio_ring, head) == 0x100);
+COMPILER_ASSERT(offsetof(struct rmi_mmio_ring, tail) == 0x108);
+COMPILER_ASSERT(offsetof(struct rmi_mmio_ring, nr_consts) == 0x110);
+COMPILER_ASSERT(offsetof(struct rmi_mmio_ring, consts) == 0x118);
+COMPILER_ASSERT(offsetof(struct rmi_mmio_ring, entries) == 0x200);
+
+/* Number of RMI commands in struct rmi_stats_page, by FID index */
+#define RMI_STATS_PAGE_NR_CMDS			64U
+
+/* RMI_STATS_* of an RMI command in struct rmi_stats_page */
+struct rmi_stats_page_cmd {
+	unsigned long calls;
+	unsigned long errors;
+	unsigned long ticks;
+	unsigned long max_ticks;
+};
+
+/*
+ * Statistics of RMM written to the granule registered with RMI_STATS_PAGE,
+ * at the end of an RMI call once the interval since the last write has
+ * passed, so that the Host can read them without calling RMM.
+ *
+ * @seq is odd while RMM writes the page, and incremented again once it is
+ * written. The Host reads @seq before and after the other fields, and reads
+ * them again if it was odd or changed. The statistics of the options RMM is
+ * built without read as 0:
+ * - @cmds with RMM_RMI_STATS, summed over the CPUs, with the maximum of
+ *   max_ticks.
+ * - @granules with RMM_GRANULE_STATS, except for RMI_GRANULE_STATE_NS.
+ * - @rec_exits with RMM_REC_STATS, summed over the RECs.
+ * - @attest_heaps_* with RMM_ATTEST_HEAP_POOL.
+ */
+struct rmi_stats_page {
+	SET_MEMBER(struct {
+			unsigned long seq;			/* 0x0 */
+			/* CNTPCT_EL0 value when the page was written */
+			unsigned long timestamp;		/* 0x8 */
+			/* Attestation heaps in use, out of the pool */
+			unsigned long attest_heaps_used;	/* 0x10 */
+			unsigned long attest_heaps_nr;		/* 0x18 */
+			/* Granules in each RMI_GRANULE_STATE_* */
+			unsigned long granules
+				[RMI_GRANULE_STATE_NR];		/* 0x20 */
+			/* Realm exits for each RMI_REC_STATS_EXIT_* */
+			unsigned long rec_exits
+				[RMI_REC_STATS_NR_EXITS];	/* 0x60 */
+		   }, 0, 0x100);
+	struct rmi_stats_page_cmd cmds[RMI_STATS_PAGE_NR_CMDS];	/* 0x100 */
+};
+
+COMPILER_ASSERT(sizeof(struct rmi_stats_page) <= GRANULE_SIZE);
+
+COMPILER_ASSERT(offsetof(struct rmi_stats_page, granules) == 0x20);
+COMPILER_ASSERT(offsetof(struct rmi_stats_page, rec_exits) == 0x60);
+COMPILER_ASSERT(offsetof(struct rmi_stats_page, cmds) == 0x100);
+
 /* Size of Realm Personalization Value */
 #define RPV_SIZE		64
 
@@ -269,6 +1182,11 @@ struct rmi_realm_params {
 			long rtt_level_start;			/* 0x810 */
 			/* Number of starting level RTTs */
 			unsigned int rtt_num_start;		/* 0x818 */
+			/*
+			 * MPAM PARTID and PMG of the RECs, in the format of
+			 * MPAM1_EL1
+			 */
+			unsigned long mpam;			/* 0x820 */
 		   }, 0x800, 0x1000);
 };
 
@@ -281,6 +1199,7 @@ COMPILER_ASSERT(offsetof(struct rmi_realm_params, vmid) == 0x800);
 COMPILER_ASSERT(offsetof(struct rmi_realm_params, rtt_base) == 0x808);
 COMPILER_ASSERT(offsetof(struct rmi_realm_params, rtt_level_start) == 0x810);
 COMPILER_ASSERT(offsetof(struct rmi_realm_params, rtt_num_start) == 0x818);
+COMPILER_ASSERT(offsetof(struct rmi_realm_params, mpam) == 0x820);
 
 /*
  * The REC attribute parameters are shared by the Host via
@@ -301,6 +1220,11 @@ struct rmi_rec_params {
 			unsigned long num_aux;			/* 0x800 */
 			/* Addresses of auxiliary Granules */
 			unsigned long aux[MAX_REC_AUX_GRANULES];/* 0x808 */
+			/*
+			 * MPAM PARTID and PMG of the REC, used with
+			 * REC_PARAMS_FLAG_MPAM
+			 */
+			unsigned long mpam;			/* 0x888 */
 		   }, 0x800, 0x1000);
 };
 
@@ -312,6 +1236,17 @@ COMPILER_ASSERT(offsetof(struct rmi_rec_params, pc) == 0x200);
 COMPILER_ASSERT(offsetof(struct rmi_rec_params, gprs) == 0x300);
 COMPILER_ASSERT(offsetof(struct rmi_rec_params, num_aux) == 0x800);
 COMPILER_ASSERT(offsetof(struct rmi_rec_params, aux) == 0x808);
+COMPILER_ASSERT(offsetof(struct rmi_rec_params, mpam) == 0x888);
+
+/*
+ * Entry of the list passed to RMI_REC_CREATE_MULTI
+ */
+struct rmi_rec_create_entry {
+	/* Address of the REC granule */
+	unsigned long rec;
+	/* Address of the NS granule holding the struct rmi_rec_params */
+	unsigned long rec_params;
+};
 
 /*
  * Structure contains data passed from the Host to the RMM on REC entry
@@ -326,6 +1261,10 @@ struct rmi_rec_entry {
 			unsigned long gicv3_hcr;			/* 0x300 */
 			/* GICv3 List Registers */
 			unsigned long gicv3_lrs[REC_GIC_NUM_LRS];	/* 0x308 */
+			/* Number of queued virtual interrupts */
+			unsigned long gicv3_queued_nr;			/* 0x388 */
+			/* Queued virtual interrupts as LR values, at 0x390 */
+			unsigned long gicv3_queued_lrs[REC_GIC_NUM_QUEUED_LRS];
 		   }, 0x300, 0x800);
 };
 
@@ -335,6 +1274,8 @@ COMPILER_ASSERT(offsetof(struct rmi_rec_entry, flags) == 0);
 COMPILER_ASSERT(offsetof(struct rmi_rec_entry, gprs) == 0x200);
 COMPILER_ASSERT(offsetof(struct rmi_rec_entry, gicv3_hcr) == 0x300);
 COMPILER_ASSERT(offsetof(struct rmi_rec_entry, gicv3_lrs) == 0x308);
+COMPILER_ASSERT(offsetof(struct rmi_rec_entry, gicv3_queued_nr) == 0x388);
+COMPILER_ASSERT(offsetof(struct rmi_rec_entry, gicv3_queued_lrs) == 0x390);
 
 /*
  * Structure contains data passed from the RMM to the Host on REC exit
@@ -361,6 +1302,8 @@ struct rmi_rec_exit {
 			unsigned long gicv3_misr;	/* 0x388 */
 			/* GICv3 Virtual Machine Control Register */
 			unsigned long gicv3_vmcr;	/* 0x390 */
+			/* Number of queued virtual interrupts injected */
+			unsigned long gicv3_queued_done; /* 0x398 */
 		   }, 0x300, 0x400);
 	SET_MEMBER(struct {
 			/* Counter-timer Physical Timer Control Register */
@@ -372,6 +1315,10 @@ struct rmi_rec_exit {
 			/* Counter-timer Virtual Timer CompareValue Register */
 			unsigned long cntv_cval;	/* 0x418 */
 		   }, 0x400, 0x500);
+	/*
+	 * With RMM_REC_RUN_SPARSE_COPY, only ripas_base to ripas_split are
+	 * written back on a RIPAS change exit, see REC_EXIT_FIELDS_RIPAS.
+	 */
 	SET_MEMBER(struct {
 			/* Base address of pending RIPAS change */
 			unsigned long ripas_base;	/* 0x500 */
@@ -379,9 +1326,25 @@ struct rmi_rec_exit {
 			unsigned long ripas_size;	/* 0x508 */
 			/* RIPAS value of pending RIPAS change */
 			unsigned char ripas_value;	/* 0x510 */
+			/* Level of the first RMI_RTT_SET_RIPAS of the change */
+			unsigned long ripas_head_level;	/* 0x518 */
+			/* Level of the RTT walk at ripas_base */
+			unsigned long ripas_head_rtt_level; /* 0x520 */
+			/* Level of the last RMI_RTT_SET_RIPAS of the change */
+			unsigned long ripas_tail_level;	/* 0x528 */
+			/* Level of the RTT walk at the last one */
+			unsigned long ripas_tail_rtt_level; /* 0x530 */
+			/* RMI_RIPAS_SPLIT_* flags */
+			unsigned long ripas_split;	/* 0x538 */
 		   }, 0x500, 0x600);
 	/* Host call immediate value */
-	SET_MEMBER(unsigned int imm, 0x600, 0x800);	/* 0x600 */
+	SET_MEMBER(unsigned int imm, 0x600, 0x700);	/* 0x600 */
+	SET_MEMBER(struct {
+			/* PMU overflow status */
+			unsigned long pmu_ovf_status;	/* 0x700 */
+			/* SPE profiling buffer interrupt status */
+			unsigned long spe_irq_status;	/* 0x708 */
+		   }, 0x700, 0x800);
 };
 
 COMPILER_ASSERT(sizeof(struct rmi_rec_exit) == 0x800);
@@ -395,6 +1358,7 @@ COMPILER_ASSERT(offsetof(struct rmi_rec_exit, gicv3_hcr) == 0x300);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, gicv3_lrs) == 0x308);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, gicv3_misr) == 0x388);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, gicv3_vmcr) == 0x390);
+COMPILER_ASSERT(offsetof(struct rmi_rec_exit, gicv3_queued_done) == 0x398);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, cntp_ctl) == 0x400);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, cntp_cval) == 0x408);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, cntv_ctl) == 0x410);
@@ -402,7 +1366,14 @@ COMPILER_ASSERT(offsetof(struct rmi_rec_exit, cntv_cval) == 0x418);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, ripas_base) == 0x500);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, ripas_size) == 0x508);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, ripas_value) == 0x510);
+COMPILER_ASSERT(offsetof(struct rmi_rec_exit, ripas_head_level) == 0x518);
+COMPILER_ASSERT(offsetof(struct rmi_rec_exit, ripas_head_rtt_level) == 0x520);
+COMPILER_ASSERT(offsetof(struct rmi_rec_exit, ripas_tail_level) == 0x528);
+COMPILER_ASSERT(offsetof(struct rmi_rec_exit, ripas_tail_rtt_level) == 0x530);
+COMPILER_ASSERT(offsetof(struct rmi_rec_exit, ripas_split) == 0x538);
 COMPILER_ASSERT(offsetof(struct rmi_rec_exit, imm) == 0x600);
+COMPILER_ASSERT(offsetof(struct rmi_rec_exit, pmu_ovf_status) == 0x700);
+COMPILER_ASSERT(offsetof(struct rmi_rec_exit, spe_irq_status) == 0x708);
 
 /*
  * Structure contains shared information between RMM and Host
@@ -28,7 +28,7 @@
  * The minor version number of the RSI implementation.  Increase this when
  * a bug is fixed, or a feature is added without breaking binary compatibility.
  */
-#define RSI_ABI_VERSION_MINOR		0
+#define RSI_ABI_VERSION_MINOR		2
 
 #define RSI_ABI_VERSION			((RSI_ABI_VERSION_MAJOR << 16U) | \
 					 RSI_ABI_VERSION_MINOR)
@@ -107,6 +107,8 @@ typedef enum {
  * arg7: Challenge value, bytes: 40 - 47
  * arg8: Challenge value, bytes: 48 - 55
  * arg9: Challenge value, bytes: 56 - 63
+ * arg10: Size of the token buffer in bytes, a multiple of the granule size,
+ *        or 0 for a single granule
  * ret0: Status / error
  * ret1: Size of completed token in bytes
  */
@@ -174,4 +176,87 @@ COMPILER_ASSERT(offsetof(struct rsi_host_call,
  */
 #define SMC_RSI_HOST_CALL		SMC64_RSI_FID(U(0x9))
 
+/* Largest value a REM is extended with */
+#define RSI_MEASUREMENT_EXTEND_MAX_SIZE	64U
+
+/* A REM extension of SMC_RSI_MEASUREMENT_EXTEND_MULTI */
+struct rsi_measurement_extend_record {
+	/* Measurement index (1..4), measurement (REM) to extend */
+	SET_MEMBER(unsigned long index, 0, 0x8);		/* Offset 0 */
+	/* Measurement size in bytes */
+	SET_MEMBER(unsigned long size, 0x8, 0x10);		/* 0x8 */
+	/* Measurement value */
+	SET_MEMBER(unsigned char value[RSI_MEASUREMENT_EXTEND_MAX_SIZE],
+		   0x10, 0x80);					/* 0x10 */
+};
+
+COMPILER_ASSERT(sizeof(struct rsi_measurement_extend_record) == 0x80);
+
+COMPILER_ASSERT(offsetof(struct rsi_measurement_extend_record, index) == 0);
+COMPILER_ASSERT(offsetof(struct rsi_measurement_extend_record, size) == 0x8);
+COMPILER_ASSERT(offsetof(struct rsi_measurement_extend_record, value) == 0x10);
+
+/* Number of records of SMC_RSI_MEASUREMENT_EXTEND_MULTI in a 4KB granule */
+#define RSI_MEASUREMENT_EXTEND_MULTI_MAX	32U
+
+/*
+ * Extends REMs with the records of a granule, in order, as a sequence of
+ * SMC_RSI_MEASUREMENT_EXTEND calls would. No REM is extended if any of the
+ * records is invalid.
+ * arg1: IPA of a granule holding an array of
+ *       struct rsi_measurement_extend_record
+ * arg2: Number of records (1..RSI_MEASUREMENT_EXTEND_MULTI_MAX)
+ * ret0: Status / error
+ */
+#define SMC_RSI_MEASUREMENT_EXTEND_MULTI	SMC64_RSI_FID(U(0xA))
+
+/* Number of causes of Realm exits counted in struct rsi_rec_stats */
+#define RSI_REC_STATS_NR_EXITS		11U
+
+/*
+ * Statistics of a REC, as counted by RMM since the REC was created. The
+ * exits are counted by cause, in the order of the RMI_REC_STATS_EXIT_*
+ * statistics of RMI_REC_STATS. The ticks are CNTPCT_EL0 ticks. The counters
+ * from s2_faults to attest_iterations wrap around at 32 bits.
+ */
+struct rsi_rec_stats {
+	SET_MEMBER(unsigned long exits[RSI_REC_STATS_NR_EXITS],
+		   0, 0x58);					/* Offset 0 */
+	/* REC entries from the Host */
+	SET_MEMBER(unsigned long entries, 0x58, 0x60);		/* 0x58 */
+	/* Exits after which RMM re-entered the Realm without the Host */
+	SET_MEMBER(unsigned long fast_exits, 0x60, 0x68);	/* 0x60 */
+	/* Stage 2 faults at Protected IPAs reported to the Host */
+	SET_MEMBER(unsigned long s2_faults, 0x68, 0x70);	/* 0x68 */
+	/* Accesses to Unprotected IPAs emulated by the Host */
+	SET_MEMBER(unsigned long mmio_exits, 0x70, 0x78);	/* 0x70 */
+	/* MMIO reads served by RMM from the MMIO ring of the REC */
+	SET_MEMBER(unsigned long mmio_const_reads, 0x78, 0x80);	/* 0x78 */
+	/* SMC_RSI_HOST_CALL calls forwarded to the Host */
+	SET_MEMBER(unsigned long host_calls, 0x80, 0x88);	/* 0x80 */
+	/* SMC_RSI_IPA_STATE_SET requests made to the Host */
+	SET_MEMBER(unsigned long ripas_changes, 0x88, 0x90);	/* 0x88 */
+	/* Signing iterations of SMC_RSI_ATTEST_TOKEN_CONTINUE */
+	SET_MEMBER(unsigned long attest_iterations, 0x90, 0x98); /* 0x90 */
+	/* Ticks spent in the Realm and in RMM */
+	SET_MEMBER(unsigned long realm_ticks, 0x98, 0xA0);	/* 0x98 */
+	SET_MEMBER(unsigned long rmm_ticks, 0xA0, 0xA8);	/* 0xA0 */
+};
+
+COMPILER_ASSERT(sizeof(struct rsi_rec_stats) == 0xA8);
+
+COMPILER_ASSERT(offsetof(struct rsi_rec_stats, exits) == 0);
+COMPILER_ASSERT(offsetof(struct rsi_rec_stats, entries) == 0x58);
+COMPILER_ASSERT(offsetof(struct rsi_rec_stats, s2_faults) == 0x68);
+COMPILER_ASSERT(offsetof(struct rsi_rec_stats, rmm_ticks) == 0xA0);
+
+/*
+ * Writes the statistics of the calling REC to a granule, as
+ * struct rsi_rec_stats. Fails with RSI_ERROR_INPUT if RMM does not keep
+ * statistics of the RECs, see RMM_REC_STATS.
+ * arg1: IPA of a granule in the Protected IPA space
+ * ret0: Status / error
+ */
+#define SMC_RSI_REC_STATS			SMC64_RSI_FID(U(0xB))
+
 #endif /* SMC_RSI_H */
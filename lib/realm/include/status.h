@@ -57,6 +57,16 @@ typedef enum {
 	 */
 	RMI_ERROR_IN_USE = 5,
 
+	/*
+	 * A long running command was preempted before completion, as an
+	 * interrupt is pending for the Host or its time budget has expired.
+	 * The Host calls it again to resume it from the progress returned
+	 * in its first output value.
+	 *
+	 * index is zero.
+	 */
+	RMI_INCOMPLETE = 6,
+
 	RMI_ERROR_COUNT
 } status_t;
 
@@ -48,6 +48,8 @@ void restore_sve_p_ffr_state(unsigned char *data);
 
 void save_sve_state(struct sve_state *sve);
 void restore_sve_state(struct sve_state *sve);
+void save_sve_simd_state(struct sve_state *sve);
+void restore_sve_simd_state(struct sve_state *sve);
 
 #endif /* __ASSEMBLER__ */
 
@@ -8,14 +8,28 @@
 
 #include <arch_features.h>
 #include <memory.h>
+#include <ripas.h>
 
 #define MIN_IPA_BITS		32
 #define MAX_IPA_BITS		48
 #define MAX_IPA_SIZE		(1UL << MAX_IPA_BITS)
 
-#define MIN_STARTING_LEVEL	0
 #define RTT_PAGE_LEVEL		3
+
+/*
+ * With the 4KB granule, level 1 holds blocks and can be preceded by level 0.
+ * With the 16KB and 64KB granules, level 2 is the first holding blocks, and
+ * level 0 is not supported without FEAT_LPA2 (16KB) or at all (64KB).
+ */
+#if GRANULE_SIZE == 4096U
+#define MIN_STARTING_LEVEL	0
+#define RTT_MIN_BLOCK_LEVEL	1
+#else
+#define MIN_STARTING_LEVEL	1
 #define RTT_MIN_BLOCK_LEVEL	2
+#endif
+/* Level of the blocks mapped by RMI_DATA_CREATE and RMI_DATA_DESTROY */
+#define RTT_DATA_BLOCK_LEVEL	2
 
 /* TODO: Fix this when introducing LPA2 support */
 COMPILER_ASSERT(MIN_STARTING_LEVEL >= 0);
@@ -31,26 +45,75 @@ COMPILER_ASSERT(MIN_STARTING_LEVEL >= 0);
 #define S2TTES_PER_S2TT		(1 << S2TTE_STRIDE)
 
 struct rd;
-enum ripas;
+
+/* Type of an s2tte, as returned by s2tte_classify() */
+enum s2tte_type {
+	S2TTE_TYPE_UNASSIGNED,
+	S2TTE_TYPE_ASSIGNED,
+	S2TTE_TYPE_DESTROYED,
+	S2TTE_TYPE_EXPORTED,
+	S2TTE_TYPE_VALID,
+	S2TTE_TYPE_VALID_NS,
+	S2TTE_TYPE_TABLE,
+	/* Not an s2tte written by RMM */
+	S2TTE_TYPE_INVALID
+};
+
+/*
+ * Layout of the value returned by s2tte_classify(). The output address is
+ * the one of the block or page for the ASSIGNED, VALID and VALID_NS types,
+ * the one of the next level RTT for TABLE and 0 otherwise. The RIPAS is the
+ * one of the UNASSIGNED, ASSIGNED, EXPORTED and VALID types, and RMI_EMPTY
+ * otherwise.
+ */
+#define S2TTE_CLASS_TYPE_MASK	0x7UL
+#define S2TTE_CLASS_RIPAS_SHIFT	3
+
+static inline enum s2tte_type s2tte_class_type(unsigned long cls)
+{
+	return (enum s2tte_type)(cls & S2TTE_CLASS_TYPE_MASK);
+}
+
+static inline enum ripas s2tte_class_ripas(unsigned long cls)
+{
+	return (enum ripas)((cls >> S2TTE_CLASS_RIPAS_SHIFT) & 1UL);
+}
+
+static inline unsigned long s2tte_class_pa(unsigned long cls)
+{
+	return cls & GRANULE_MASK;
+}
+
+unsigned long s2tte_classify(unsigned long s2tte, long level);
+
+/* Width of the sequence number of the export kept in an EXPORTED s2tte */
+#define S2TTE_EXPORT_SEQ_BITS	36U
+#define S2TTE_EXPORT_SEQ_MAX	((1UL << S2TTE_EXPORT_SEQ_BITS) - 1UL)
 
 unsigned long s2tte_create_ripas(enum ripas ripas);
 unsigned long s2tte_create_unassigned(enum ripas ripas);
 unsigned long s2tte_create_destroyed(void);
+unsigned long s2tte_create_exported(unsigned long seq);
 unsigned long s2tte_create_assigned_empty(unsigned long pa, long level);
+unsigned long s2tte_create_assigned_ram(unsigned long pa, long level);
 unsigned long s2tte_create_valid(unsigned long pa, long level);
 unsigned long s2tte_create_invalid_ns(void);
 unsigned long s2tte_create_valid_ns(unsigned long s2tte, long level);
 unsigned long s2tte_create_table(unsigned long pa, long level);
+unsigned long s2tte_create_shared_table(unsigned long pa, long level);
 
 bool host_ns_s2tte_is_valid(unsigned long s2tte, long level);
 unsigned long host_ns_s2tte(unsigned long s2tte, long level);
 
 bool s2tte_is_unassigned(unsigned long s2tte);
 bool s2tte_is_destroyed(unsigned long s2tte);
+bool s2tte_is_exported(unsigned long s2tte);
+unsigned long s2tte_exported_seq(unsigned long s2tte);
 bool s2tte_is_assigned(unsigned long s2tte, long level);
 bool s2tte_is_valid(unsigned long s2tte, long level);
 bool s2tte_is_valid_ns(unsigned long s2tte, long level);
 bool s2tte_is_table(unsigned long s2tte, long level);
+bool s2tte_is_shared_table(unsigned long s2tte, long level);
 
 enum ripas s2tte_get_ripas(unsigned long s2tte);
 
@@ -60,16 +123,30 @@ void s2tt_init_assigned_empty(unsigned long *s2tt, unsigned long pa, long level)
 void s2tt_init_valid(unsigned long *s2tt, unsigned long pa, long level);
 void s2tt_init_valid_ns(unsigned long *s2tt, unsigned long pa, long level);
 
+bool s2tt_scan_access_dirty(unsigned long *s2tt, long level,
+			    unsigned long *accessed, unsigned long *dirty);
+bool s2tt_scan_dirty_wp(unsigned long *s2tt, long level, unsigned long *dirty);
+bool s2tte_set_writable(unsigned long *s2ttep, long level);
+
 unsigned long s2tte_pa(unsigned long s2tte, long level);
 unsigned long s2tte_pa_table(unsigned long s2tte, long level);
 bool addr_is_level_aligned(unsigned long addr, long level);
 bool addr_block_intersects_par(struct rd *rd, unsigned long addr, long level);
 unsigned long s2tte_map_size(int level);
+unsigned long s2_addr_to_idx(unsigned long addr, long level);
 
 struct realm_s2_context;
 void invalidate_page(const struct realm_s2_context *ctx, unsigned long addr);
 void invalidate_block(const struct realm_s2_context *ctx, unsigned long addr);
-void invalidate_pages_in_block(const struct realm_s2_context *ctx, unsigned long addr);
+void invalidate_table(const struct realm_s2_context *ctx, unsigned long addr);
+void invalidate_pages_in_block(const struct realm_s2_context *ctx, unsigned long addr,
+			       long level);
+void invalidate_range(const struct realm_s2_context *ctx, unsigned long addr,
+		      unsigned long size, long level);
+void invalidate_vmid(const struct realm_s2_context *ctx);
+#ifdef RMM_RMI_STATS
+unsigned long s2tt_s1_flush_count(void);
+#endif
 
 bool table_is_unassigned_block(unsigned long *table, enum ripas *ripas);
 bool table_is_destroyed_block(unsigned long *table);
@@ -90,6 +167,20 @@ void rtt_walk_lock_unlock(struct granule *g_root,
 			  unsigned long map_addr,
 			  long level,
 			  struct rtt_walk *wi);
+void rtt_walk_lock_unlock_ctx(const struct realm_s2_context *s2_ctx,
+			      unsigned long map_addr,
+			      long level,
+			      struct rtt_walk *wi);
+unsigned int rtt_walker_select(int start_level, unsigned long ipa_bits);
+void rtt_walk_cache_invalidate(void);
+
+unsigned long rtt_read_s2tte_lockless(struct granule *g_root,
+				      int start_level,
+				      unsigned long ipa_bits,
+				      unsigned long map_addr,
+				      long level,
+				      long *last_level);
+void rtt_wait_lockless_walkers(struct granule *g_root);
 
 /*
  * The MMU is a separate observer, and requires that translation table updates
@@ -10,5 +10,8 @@
 
 bool vmid_reserve(unsigned int vmid);
 void vmid_free(unsigned int vmid);
+bool vmid_find_free(unsigned int min_vmid, unsigned int *vmid);
+void vmid_set_realm_active(unsigned int vmid, bool active);
+bool vmid_realm_is_active(unsigned int vmid);
 
 #endif /* VMID_H */
@@ -4,6 +4,7 @@
  */
 
 #include <arch.h>
+#include <arch_features.h>
 #include <arch_helpers.h>
 #include <assert.h>
 #include <attestation_token.h>
@@ -14,7 +15,10 @@
 #include <errno.h>
 #include <gic.h>
 #include <granule.h>
+#include <measurement.h>
+#include <mecid.h>
 #include <memory_alloc.h>
+#include <percpu.h>
 #include <sizes.h>
 #include <slot_buf_arch.h>
 #include <stdbool.h>
@@ -43,6 +47,14 @@ COMPILER_ASSERT((RMM_SLOT_BUF_VA_SIZE) >= (1 << 16U));
 
 #define SLOT_BUF_MMAP_REGIONS		UL(1)
 
+/*
+ * Size of the chunks copied and hashed in turn by ns_buffer_read_hash(). A
+ * multiple of the block size of the SHA-256 and SHA-512 algorithms, small
+ * enough for a chunk to still be in the L1 cache when it is hashed.
+ */
+#define NS_READ_HASH_CHUNK		512U
+COMPILER_ASSERT((GRANULE_SIZE % NS_READ_HASH_CHUNK) == 0U);
+
 /*
  * Attributes for a buffer slot page descriptor.
  * Note that the AF bit on the descriptor is handled by the translation
@@ -53,33 +65,80 @@ COMPILER_ASSERT((RMM_SLOT_BUF_VA_SIZE) >= (1 << 16U));
 	(MT_RW_DATA | MT_SHAREABILITY_ISH | MT_NG)
 
 /*
- * The base tables for all the contexts are manually allocated as a continous
- * block of memory.
+ * The base table of the context of each CPU is manually allocated in its
+ * per-CPU area. The per-CPU areas are page aligned, so the alignment of the
+ * table holds for all the CPUs.
  */
-static uint64_t transient_base_table[XLAT_TABLE_ENTRIES * MAX_CPUS]
-				    __aligned(BASE_XLAT_TABLES_ALIGNMENT)
-				    __section("slot_buffer_xlat_tbls");
+static DEFINE_PER_CPU(uint64_t[XLAT_TABLE_ENTRIES], transient_base_table)
+				    __aligned(BASE_XLAT_TABLES_ALIGNMENT);
 
 /* Allocate per-cpu xlat_ctx_tbls */
-static struct xlat_ctx_tbls slot_buf_tbls[MAX_CPUS];
+static DEFINE_PER_CPU(struct xlat_ctx_tbls, slot_buf_tbls);
 
 /*
  * Allocate mmap regions and define common xlat_ctx_cfg shared will
- * all slot_buf_xlat_ctx
+ * all slot_buf_xlat_ctx. Each PE walks its own translation tables for the
+ * slot buffers, so the unmaps only invalidate the local TLBs.
  */
-XLAT_REGISTER_VA_SPACE(slot_buf, VA_HIGH_REGION,
-		       SLOT_BUF_MMAP_REGIONS,
-		       RMM_SLOT_BUF_VA_SIZE);
+XLAT_REGISTER_VA_SPACE_FULL_SPEC(slot_buf, VA_HIGH_REGION,
+				 SLOT_BUF_MMAP_REGIONS,
+				 RMM_SLOT_BUF_VA_SIZE,
+				 true);
 
 /* context definition */
-static struct xlat_ctx slot_buf_xlat_ctx[MAX_CPUS];
+static DEFINE_PER_CPU(struct xlat_ctx, slot_buf_xlat_ctx);
+
+/*
+ * The RD, REC and RTT slots are mapped to the same granules many times during
+ * an RMI call, for instance by every step of an RTT walk. The mapping of these
+ * slots is therefore kept after they are unmapped, and reused if the same PA
+ * is mapped again into the slot. Such a mapping is only invalidated when
+ * another PA is mapped into the slot or by buffer_slots_flush(), which is
+ * called before returning to the Host so that no mapping survives the RMI
+ * call.
+ *
+ * The mappings of the other slots are always invalidated by buffer_unmap(),
+ * as the granules mapped into them may change PAS during the call.
+ */
+struct slot_lazy_map {
+	/* PA last mapped into each lazy slot */
+	unsigned long pa[NR_CPU_SLOTS];
+	/* Lazy slots still mapped after buffer_unmap() */
+	unsigned long mask;
+};
+COMPILER_ASSERT(NR_CPU_SLOTS <= (sizeof(unsigned long) * 8U));
 
 /*
- * Allocate a cache to store the last level table entry where the slot buffers
- * are mapped to avoid needing to perform a table walk every time a buffer
- * slot operation is needed.
+ * State of the slot buffers of each CPU, used by every map and unmap. It is
+ * kept in one block per CPU aligned to the cache line size, so that the CPUs
+ * do not share the lines they update.
  */
-static struct xlat_table_entry te_cache[MAX_CPUS];
+struct slot_buf_cpu_data {
+	/*
+	 * Cache of the last level table entry where the slot buffers are
+	 * mapped to avoid needing to perform a table walk every time a buffer
+	 * slot operation is needed.
+	 */
+	struct xlat_table_entry te_cache;
+	/*
+	 * PTE of each slot in the te_cache table and descriptor templates of
+	 * the Realm and NS slots, with which a single slot is mapped or
+	 * unmapped by writing its descriptor directly.
+	 */
+	uint64_t *slot_pte[NR_CPU_SLOTS];
+	uint64_t desc_realm;
+	uint64_t desc_ns;
+	unsigned long max_pa;
+	/* FEAT_XS is implemented, see slot_unmap_fast() */
+	bool xs;
+	struct slot_lazy_map lazy;
+#ifdef RMM_RMI_STATS
+	/* Number of slot buffers mapped */
+	unsigned long map_count;
+#endif
+} __aligned(CACHE_WRITEBACK_GRANULE);
+
+static DEFINE_PER_CPU(struct slot_buf_cpu_data, slot_buf_cpu_data);
 
 uintptr_t slot_to_va(enum buffer_slot slot)
 {
@@ -90,12 +149,123 @@ uintptr_t slot_to_va(enum buffer_slot slot)
 
 static inline struct xlat_ctx *get_slot_buf_xlat_ctx(void)
 {
-	return &slot_buf_xlat_ctx[my_cpuid()];
+	return &per_cpu(slot_buf_xlat_ctx, my_cpuid());
+}
+
+static inline struct slot_buf_cpu_data *get_slot_buf_cpu_data(void)
+{
+	return &per_cpu(slot_buf_cpu_data, my_cpuid());
 }
 
 struct xlat_table_entry *get_cache_entry(void)
 {
-	return &te_cache[my_cpuid()];
+	return &get_slot_buf_cpu_data()->te_cache;
+}
+
+#ifdef RMM_RMI_STATS
+unsigned long buffer_slot_map_count(void)
+{
+	return get_slot_buf_cpu_data()->map_count;
+}
+
+static inline void slot_map_count_inc(void)
+{
+	get_slot_buf_cpu_data()->map_count++;
+}
+#else
+static inline void slot_map_count_inc(void)
+{
+}
+#endif /* RMM_RMI_STATS */
+
+static inline bool is_lazy_slot(enum buffer_slot slot)
+{
+	return ((slot >= SLOT_RD) && (slot <= SLOT_REC_RD)) ||
+	       (slot == SLOT_RTT) || (slot == SLOT_RTT2);
+}
+
+static inline enum buffer_slot va_to_slot(uintptr_t va)
+{
+	return (enum buffer_slot)((va - SLOT_VIRT) / GRANULE_SIZE);
+}
+
+/*
+ * Take the lazy mapping of @slot, if any. Return true if it maps @addr, in
+ * which case it can be used as is. Otherwise, return false, and add the VA
+ * of the slot to @stale if its stale mapping needs to be invalidated.
+ */
+static bool slot_lazy_take(enum buffer_slot slot, unsigned long addr,
+			   uintptr_t stale[], unsigned int *nr_stale)
+{
+	struct slot_lazy_map *lazy = &get_slot_buf_cpu_data()->lazy;
+	unsigned long bit = 1UL << (unsigned int)slot;
+
+	if ((lazy->mask & bit) == 0UL) {
+		return false;
+	}
+
+	lazy->mask &= ~bit;
+	if (lazy->pa[slot] == addr) {
+		return true;
+	}
+
+	stale[(*nr_stale)++] = slot_to_va(slot);
+	return false;
+}
+
+static inline void slot_lazy_set_pa(enum buffer_slot slot, unsigned long addr)
+{
+	if (is_lazy_slot(slot)) {
+		get_slot_buf_cpu_data()->lazy.pa[slot] = addr;
+	}
+}
+
+/*
+ * Unmap @slot by invalidating its descriptor. The slot buffer tables are
+ * private to each CPU, so only the local TLBs need to be invalidated.
+ *
+ * The slots only map Normal memory, which does not have the XS attribute,
+ * so with FEAT_XS the invalidation does not have to wait for the accesses
+ * to memory which has it.
+ */
+static inline void slot_unmap_fast(struct slot_buf_cpu_data *data,
+				   enum buffer_slot slot)
+{
+	xlat_write_descriptor(data->slot_pte[slot], INVALID_DESC);
+
+	dsb(nshst);
+	if (data->xs) {
+		tlbivae2nxs(TLBI_ADDR(slot_to_va(slot)));
+		dsb_nshnxs();
+	} else {
+		tlbivae2(TLBI_ADDR(slot_to_va(slot)));
+		dsb(nsh);
+	}
+	isb();
+}
+
+/*
+ * Invalidate the mappings of the slots of the current CPU kept after they
+ * were unmapped.
+ */
+void buffer_slots_flush(void)
+{
+	struct slot_lazy_map *lazy = &get_slot_buf_cpu_data()->lazy;
+	uintptr_t va[NR_CPU_SLOTS];
+	unsigned int nr = 0U;
+
+	if (lazy->mask == 0UL) {
+		return;
+	}
+
+	for (unsigned int i = 0U; i < NR_CPU_SLOTS; i++) {
+		if ((lazy->mask & (1UL << i)) != 0UL) {
+			va[nr++] = slot_to_va((enum buffer_slot)i);
+		}
+	}
+
+	lazy->mask = 0UL;
+	(void)xlat_unmap_memory_pages(get_cache_entry(), va, nr);
 }
 
 __unused static uint64_t slot_to_descriptor(enum buffer_slot slot)
@@ -115,9 +285,8 @@ void slot_buf_setup_xlat(void)
 	unsigned int cpuid = my_cpuid();
 	int ret = xlat_ctx_create_dynamic(get_slot_buf_xlat_ctx(),
 					  &slot_buf_xlat_ctx_cfg,
-					  &slot_buf_tbls[cpuid],
-					  &transient_base_table[
-						XLAT_TABLE_ENTRIES * cpuid],
+					  &per_cpu(slot_buf_tbls, cpuid),
+					  per_cpu(transient_base_table, cpuid),
 					  GET_NUM_BASE_LEVEL_ENTRIES(
 							RMM_SLOT_BUF_VA_SIZE),
 					  NULL,
@@ -176,6 +345,31 @@ void slot_buf_setup_xlat(void)
 	}
 }
 
+/*
+ * Cache the PTE of each slot and the descriptor templates of the current CPU,
+ * once the te_cache table is known.
+ */
+static void slot_buf_init_fast_path(void)
+{
+	struct slot_buf_cpu_data *data = get_slot_buf_cpu_data();
+
+	/* slot_unmap_fast() only invalidates the local TLBs */
+	assert(data->te_cache.local_tlbi);
+
+	for (unsigned int i = 0U; i < NR_CPU_SLOTS; i++) {
+		data->slot_pte[i] = xlat_get_pte_from_table(&data->te_cache,
+					slot_to_va((enum buffer_slot)i));
+		assert(data->slot_pte[i] != NULL);
+	}
+
+	data->desc_realm = xlat_page_desc_template(&data->te_cache,
+						   SLOT_DESC_ATTR | MT_REALM);
+	data->desc_ns = xlat_page_desc_template(&data->te_cache,
+						SLOT_DESC_ATTR | MT_NS);
+	data->max_pa = (1UL << arch_feat_get_pa_width()) - 1UL;
+	data->xs = is_feat_xs_present();
+}
+
 /*
  * Finishes initializing the slot buffer mechanism.
  * This function must be called after the MMU is enabled.
@@ -202,6 +396,8 @@ void slot_buf_init(void)
 
 		}
 	}
+
+	slot_buf_init_fast_path();
 }
 
 /*
@@ -232,6 +428,7 @@ static void *ns_granule_map(enum buffer_slot slot, struct granule *granule)
 	unsigned long addr = granule_addr(granule);
 
 	assert(is_ns_slot(slot));
+	slot_map_count_inc();
 	return buffer_arch_map(slot, addr, true);
 }
 
@@ -242,26 +439,162 @@ static void ns_buffer_unmap(enum buffer_slot slot)
 	buffer_arch_unmap((void *)slot_to_va(slot));
 }
 
+#ifdef RMM_GRANULE_DIRECT_MAP
+/*
+ * The REC auxiliary granules need to be mapped at consecutive VAs, so they
+ * keep using the slot buffers even when the memory is directly mapped.
+ */
+static inline bool is_rec_aux_slot(enum buffer_slot slot)
+{
+	return (slot >= SLOT_REC_AUX0) &&
+	       (slot < (SLOT_REC_AUX0 + MAX_REC_AUX_GRANULES));
+}
+
+/* The slot buffers are mapped at the top of the high VA region */
+static inline bool is_slot_va(void *buf)
+{
+	return (uintptr_t)buf >= SLOT_VIRT;
+}
+#endif /* RMM_GRANULE_DIRECT_MAP */
+
 /*
  * Maps a granule @g into the provided @slot, returning
  * the virtual address.
  *
+ * When RMM_GRANULE_DIRECT_MAP is enabled, the granule is accessed through the
+ * flat mapping of the DRAM set up by the platform and no translation table
+ * update is needed.
+ *
  * The caller must either hold @g::lock or hold a reference.
  */
+__hot_text
 void *granule_map(struct granule *g, enum buffer_slot slot)
 {
 	unsigned long addr = granule_addr(g);
 
 	assert(is_realm_slot(slot));
 
+#ifdef RMM_GRANULE_DIRECT_MAP
+	if (!is_rec_aux_slot(slot)) {
+		return (void *)addr;
+	}
+#endif
+
+	slot_map_count_inc();
 	return buffer_arch_map(slot, addr, false);
 }
 
+/*
+ * Maps a granule @g of the memory of a Realm into the provided @slot, so that
+ * RMM accesses it in the memory encryption context @mecid of the Realm. The
+ * granule is mapped by granule_map() if @mecid is MECID_RMM.
+ *
+ * Otherwise the granule is always mapped into the slot, even when
+ * RMM_GRANULE_DIRECT_MAP is enabled, as the flat mapping of the DRAM uses
+ * MECID_RMM. @slot must not be one of the slots reused lazily.
+ *
+ * The caller must either hold @g::lock or hold a reference.
+ */
+void *granule_map_mec(struct granule *g, enum buffer_slot slot,
+		      unsigned int mecid)
+{
+	if (mecid == MECID_RMM) {
+		return granule_map(g, slot);
+	}
+
+	assert(is_realm_slot(slot));
+
+	slot_map_count_inc();
+	return buffer_arch_map_mec(slot, granule_addr(g), mecid);
+}
+
+__hot_text
 void buffer_unmap(void *buf)
 {
+#ifdef RMM_GRANULE_DIRECT_MAP
+	if (!is_slot_va(buf)) {
+		return;
+	}
+#endif
+
 	buffer_arch_unmap(buf);
 }
 
+/*
+ * Map the @nr granules of @g into the slots of @slots, storing the virtual
+ * address of each of them in @bufs. The translation table updates of all
+ * the granules are completed with a single barrier.
+ *
+ * The caller must either hold the lock or a reference of each granule.
+ */
+void granule_map_group(struct granule *g[], const enum buffer_slot slots[],
+		       unsigned int nr, void *bufs[])
+{
+	enum buffer_slot map_slots[NR_CPU_SLOTS];
+	unsigned long map_addrs[NR_CPU_SLOTS];
+	void *map_bufs[NR_CPU_SLOTS];
+	unsigned int map_idx[NR_CPU_SLOTS];
+	unsigned int nr_map = 0U;
+
+	assert(nr <= NR_CPU_SLOTS);
+
+	for (unsigned int i = 0U; i < nr; i++) {
+		unsigned long addr = granule_addr(g[i]);
+
+		assert(is_realm_slot(slots[i]));
+
+#ifdef RMM_GRANULE_DIRECT_MAP
+		if (!is_rec_aux_slot(slots[i])) {
+			bufs[i] = (void *)addr;
+			continue;
+		}
+#endif
+		map_slots[nr_map] = slots[i];
+		map_addrs[nr_map] = addr;
+		map_idx[nr_map] = i;
+		nr_map++;
+		slot_map_count_inc();
+	}
+
+	if (nr_map == 0U) {
+		return;
+	}
+
+	buffer_arch_map_group(map_slots, map_addrs, nr_map, map_bufs);
+
+	for (unsigned int i = 0U; i < nr_map; i++) {
+		bufs[map_idx[i]] = map_bufs[i];
+	}
+}
+
+/*
+ * Unmap the @nr buffers of @bufs, completing the TLB maintenance of all of
+ * them with a single barrier.
+ */
+void buffer_unmap_group(void *bufs[], unsigned int nr)
+{
+#ifdef RMM_GRANULE_DIRECT_MAP
+	void *unmap_bufs[NR_CPU_SLOTS];
+	unsigned int nr_unmap = 0U;
+
+	assert(nr <= NR_CPU_SLOTS);
+
+	for (unsigned int i = 0U; i < nr; i++) {
+		if (is_slot_va(bufs[i])) {
+			unmap_bufs[nr_unmap++] = bufs[i];
+		}
+	}
+
+	if (nr_unmap != 0U) {
+		buffer_arch_unmap_group(unmap_bufs, nr_unmap);
+	}
+#else
+	assert(nr <= NR_CPU_SLOTS);
+
+	buffer_arch_unmap_group(bufs, nr);
+#endif
+}
+
 bool memcpy_ns_read(void *dest, const void *ns_src, unsigned long size);
 bool memcpy_ns_write(void *ns_dest, const void *src, unsigned long size);
 
@@ -273,6 +606,7 @@ bool memcpy_ns_write(void *ns_dest, const void *src, unsigned long size);
  * Only the least significant bits of @offset are considered, which allows the
  * full PA of a non-granule aligned buffer to be used for the @offset parameter.
  */
+__hot_text
 bool ns_buffer_read(enum buffer_slot slot,
 		    struct granule *ns_gr,
 		    unsigned int offset,
@@ -287,8 +621,8 @@ bool ns_buffer_read(enum buffer_slot slot,
 
 	/*
 	 * To simplify the trapping mechanism around NS access,
-	 * memcpy_ns_read uses a single 8-byte LDR instruction and
-	 * all parameters must be aligned accordingly.
+	 * memcpy_ns_read only uses 8-byte LDR and 16-byte LDP
+	 * instructions and all parameters must be aligned to 8 bytes.
 	 */
 	assert(ALIGNED(size, 8));
 	assert(ALIGNED(offset, 8));
@@ -312,6 +646,7 @@ bool ns_buffer_read(enum buffer_slot slot,
  * Only the least significant bits of @offset are considered, which allows the
  * full PA of a non-granule aligned buffer to be used for the @offset parameter.
  */
+__hot_text
 bool ns_buffer_write(enum buffer_slot slot,
 		     struct granule *ns_gr,
 		     unsigned int offset,
@@ -326,8 +661,8 @@ bool ns_buffer_write(enum buffer_slot slot,
 
 	/*
 	 * To simplify the trapping mechanism around NS access,
-	 * memcpy_ns_write uses a single 8-byte STR instruction and
-	 * all parameters must be aligned accordingly.
+	 * memcpy_ns_write only uses 8-byte STR and 16-byte STP
+	 * instructions and all parameters must be aligned to 8 bytes.
 	 */
 	assert(ALIGNED(size, 8));
 	assert(ALIGNED(offset, 8));
@@ -343,36 +678,307 @@ bool ns_buffer_write(enum buffer_slot slot,
 	return retval;
 }
 
+/*
+ * Map a Non secure granule @ns_gr into the slot @slot and, for each of the
+ * @nr_ranges entries of @ranges, read the bytes at @offset + range offset
+ * within the granule to the same range offset in @dest. The granule is
+ * mapped only once for all the ranges.
+ *
+ * It returns 'true' on success or `false` if not all data are copied.
+ * Only the least significant bits of @offset are considered.
+ */
+bool ns_buffer_read_ranges(enum buffer_slot slot,
+			   struct granule *ns_gr,
+			   unsigned int offset,
+			   const struct ns_buffer_range *ranges,
+			   unsigned int nr_ranges,
+			   void *dest)
+{
+	uintptr_t src;
+	bool retval = true;
+
+	assert(is_ns_slot(slot));
+	assert(ns_gr != NULL);
+	assert(ALIGNED(offset, 8));
+	assert(ALIGNED(dest, 8));
+
+	offset &= ~GRANULE_MASK;
+	src = (uintptr_t)ns_granule_map(slot, ns_gr) + offset;
+
+	for (unsigned int i = 0U; retval && (i < nr_ranges); i++) {
+		assert(ALIGNED(ranges[i].offset, 8));
+		assert(ALIGNED(ranges[i].size, 8));
+		assert(offset + ranges[i].offset + ranges[i].size <=
+		       GRANULE_SIZE);
+
+		retval = memcpy_ns_read((void *)((uintptr_t)dest +
+						 ranges[i].offset),
+					(void *)(src + ranges[i].offset),
+					ranges[i].size);
+	}
+
+	ns_buffer_unmap(slot);
+
+	return retval;
+}
+
+/*
+ * Map a Non secure granule @ns_gr into the slot @slot, copy it to @dest and
+ * write the hash of its content, computed with the algorithm of @ctx, to
+ * @out. The granule is copied in chunks which are hashed from @dest while
+ * they are still in the cache, so that the content is only brought in once.
+ *
+ * It returns 'true' on success or `false` if not all data are copied, in
+ * which case @out is not written.
+ */
+bool ns_buffer_read_hash(enum buffer_slot slot,
+			 struct granule *ns_gr,
+			 void *dest,
+			 struct measurement_ctx *ctx,
+			 unsigned char *out)
+{
+	uintptr_t src;
+	bool retval = true;
+
+	assert(is_ns_slot(slot));
+	assert(ns_gr != NULL);
+	assert(ALIGNED(dest, 8));
+
+	src = (uintptr_t)ns_granule_map(slot, ns_gr);
+	measurement_ctx_hash_start(ctx);
+
+	for (unsigned int off = 0U; retval && (off < GRANULE_SIZE);
+	     off += NS_READ_HASH_CHUNK) {
+		void *chunk = (void *)((uintptr_t)dest + off);
+
+		retval = memcpy_ns_read(chunk, (void *)(src + off),
+					NS_READ_HASH_CHUNK);
+		if (retval) {
+			measurement_ctx_hash_update(ctx, chunk,
+						    NS_READ_HASH_CHUNK);
+		}
+	}
+
+	if (retval) {
+		measurement_ctx_hash_finish(ctx, out);
+	}
+
+	ns_buffer_unmap(slot);
+
+	return retval;
+}
+
+/*
+ * Map a Non secure granule @ns_gr into the slot @slot and, for each of the
+ * @nr_ranges entries of @ranges, write the bytes at the range offset in
+ * @src to @offset + range offset within the granule. The granule is
+ * mapped only once for all the ranges.
+ *
+ * It returns 'true' on success or `false` if not all data are copied.
+ * Only the least significant bits of @offset are considered.
+ */
+bool ns_buffer_write_ranges(enum buffer_slot slot,
+			    struct granule *ns_gr,
+			    unsigned int offset,
+			    const struct ns_buffer_range *ranges,
+			    unsigned int nr_ranges,
+			    void *src)
+{
+	uintptr_t dest;
+	bool retval = true;
+
+	assert(is_ns_slot(slot));
+	assert(ns_gr != NULL);
+	assert(ALIGNED(offset, 8));
+	assert(ALIGNED(src, 8));
+
+	offset &= ~GRANULE_MASK;
+	dest = (uintptr_t)ns_granule_map(slot, ns_gr) + offset;
+
+	for (unsigned int i = 0U; retval && (i < nr_ranges); i++) {
+		assert(ALIGNED(ranges[i].offset, 8));
+		assert(ALIGNED(ranges[i].size, 8));
+		assert(offset + ranges[i].offset + ranges[i].size <=
+		       GRANULE_SIZE);
+
+		retval = memcpy_ns_write((void *)(dest + ranges[i].offset),
+					 (void *)((uintptr_t)src +
+						  ranges[i].offset),
+					 ranges[i].size);
+	}
+
+	ns_buffer_unmap(slot);
+
+	return retval;
+}
+
 /******************************************************************************
  * Internal helpers
  ******************************************************************************/
 
+/*
+ * Same checks and barriers as xlat_map_memory_page_with_attrs(), but the PTE
+ * and the descriptor of the slot are precomputed by slot_buf_init().
+ */
 void *buffer_map_internal(enum buffer_slot slot, unsigned long addr, bool ns)
 {
-	uint64_t attr = SLOT_DESC_ATTR;
+	struct slot_buf_cpu_data *data = get_slot_buf_cpu_data();
 	uintptr_t va = slot_to_va(slot);
-	struct xlat_table_entry *entry = get_cache_entry();
+	uint64_t *pte = data->slot_pte[slot];
 
 	assert(GRANULE_ALIGNED(addr));
 
-	attr |= (ns == true ? MT_NS : MT_REALM);
+	if (!ns && is_lazy_slot(slot)) {
+		uintptr_t stale;
+		unsigned int nr_stale = 0U;
 
-	if (xlat_map_memory_page_with_attrs(entry, va,
-					    (uintptr_t)addr, attr) != 0) {
+		if (slot_lazy_take(slot, addr, &stale, &nr_stale)) {
+			return (void *)va;
+		}
+
+		if (nr_stale != 0U) {
+			slot_unmap_fast(data, slot);
+		}
+	}
+
+	if ((xlat_read_descriptor(pte) != INVALID_DESC) ||
+	    (addr > data->max_pa)) {
 		/* Error mapping the buffer */
 		return NULL;
 	}
 
+	xlat_write_descriptor(pte, (ns ? data->desc_ns : data->desc_realm) |
+				   addr);
+
+	/* Ensure the translation table write has drained into memory */
+	dsb(ishst);
+	isb();
+
+	slot_lazy_set_pa(slot, addr);
 	return (void *)va;
 }
 
+/*
+ * The mapping has the AMEC bit set, so that it is accessed with the MECID of
+ * MECID_A1_EL2, which is set to @mecid. As the slot is not lazy, its mapping
+ * is invalidated on unmap and MECID_A1_EL2 can be changed by the next map.
+ */
+void *buffer_map_internal_mec(enum buffer_slot slot, unsigned long addr,
+			      unsigned int mecid)
+{
+	struct slot_buf_cpu_data *data = get_slot_buf_cpu_data();
+	uint64_t *pte = data->slot_pte[slot];
+
+	assert(GRANULE_ALIGNED(addr));
+	assert(!is_lazy_slot(slot));
+
+	if ((xlat_read_descriptor(pte) != INVALID_DESC) ||
+	    (addr > data->max_pa)) {
+		/* Error mapping the buffer */
+		return NULL;
+	}
+
+	write_mecid_a1_el2(mecid);
+	xlat_write_descriptor(pte, data->desc_realm | DESC_AMEC_BIT | addr);
+
+	/*
+	 * Ensure the translation table write has drained into memory, and
+	 * that the new MECID is used by the accesses through the mapping.
+	 */
+	dsb(ishst);
+	isb();
+
+	return (void *)slot_to_va(slot);
+}
+
 void buffer_unmap_internal(void *buf)
 {
+	enum buffer_slot slot = va_to_slot((uintptr_t)buf);
+
 	/*
 	 * Prevent the compiler from moving prior loads/stores to buf after the
 	 * update to the translation table. Otherwise, those could fault.
 	 */
 	COMPILER_BARRIER();
 
-	xlat_unmap_memory_page(get_cache_entry(), (uintptr_t)buf);
+	if (is_lazy_slot(slot)) {
+		get_slot_buf_cpu_data()->lazy.mask |= 1UL << (unsigned int)slot;
+		return;
+	}
+
+	slot_unmap_fast(get_slot_buf_cpu_data(), slot);
+}
+
+void buffer_map_internal_group(const enum buffer_slot slots[],
+			       const unsigned long addrs[],
+			       unsigned int nr, void *bufs[])
+{
+	uintptr_t va[NR_CPU_SLOTS], stale[NR_CPU_SLOTS];
+	uintptr_t map_pa[NR_CPU_SLOTS];
+	unsigned int nr_map = 0U, nr_stale = 0U;
+	unsigned long reused = 0UL;
+
+	assert(nr <= NR_CPU_SLOTS);
+
+	for (unsigned int i = 0U; i < nr; i++) {
+		assert(GRANULE_ALIGNED(addrs[i]));
+		bufs[i] = (void *)slot_to_va(slots[i]);
+
+		if (is_lazy_slot(slots[i]) &&
+		    slot_lazy_take(slots[i], addrs[i], stale, &nr_stale)) {
+			reused |= 1UL << (unsigned int)slots[i];
+			continue;
+		}
+
+		va[nr_map] = (uintptr_t)bufs[i];
+		map_pa[nr_map] = (uintptr_t)addrs[i];
+		nr_map++;
+	}
+
+	if (nr_stale != 0U) {
+		(void)xlat_unmap_memory_pages(get_cache_entry(), stale,
+					      nr_stale);
+	}
+
+	if ((nr_map != 0U) &&
+	    (xlat_map_memory_pages_with_attrs(get_cache_entry(), va, map_pa,
+					      nr_map,
+					      SLOT_DESC_ATTR | MT_REALM) != 0)) {
+		/* Error mapping the buffers, keep the reused mappings lazy */
+		get_slot_buf_cpu_data()->lazy.mask |= reused;
+		for (unsigned int i = 0U; i < nr; i++) {
+			bufs[i] = NULL;
+		}
+		return;
+	}
+
+	for (unsigned int i = 0U; i < nr; i++) {
+		slot_lazy_set_pa(slots[i], addrs[i]);
+	}
+}
+
+void buffer_unmap_internal_group(void *bufs[], unsigned int nr)
+{
+	uintptr_t va[NR_CPU_SLOTS];
+	unsigned int nr_unmap = 0U;
+
+	assert(nr <= NR_CPU_SLOTS);
+
+	/* See buffer_unmap_internal() */
+	COMPILER_BARRIER();
+
+	for (unsigned int i = 0U; i < nr; i++) {
+		enum buffer_slot slot = va_to_slot((uintptr_t)bufs[i]);
+
+		if (is_lazy_slot(slot)) {
+			get_slot_buf_cpu_data()->lazy.mask |=
+						1UL << (unsigned int)slot;
+		} else {
+			va[nr_unmap++] = (uintptr_t)bufs[i];
+		}
+	}
+
+	if (nr_unmap != 0U) {
+		(void)xlat_unmap_memory_pages(get_cache_entry(), va, nr_unmap);
+	}
 }
@@ -3,19 +3,177 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <arch_helpers.h>
 #include <assert.h>
+#include <atomics.h>
 #include <buffer.h>
+#include <cpuid.h>
 #include <debug.h>
 #include <granule.h>
+#include <memory.h>
 #include <mmio.h>
 #include <platform_api.h>
+#include <smc-rmi.h>
 #include <smc.h>
 #include <status.h>
 #include <stddef.h>
 #include <string.h>
 #include <utils_def.h>
 
-static struct granule granules[RMM_MAX_GRANULES];
+/*
+ * The granule table is not part of the BSS, as zeroing it can take a long time
+ * on systems with a lot of memory. It is zeroed in chunks instead, shared
+ * between the CPUs as they boot (see granule_table_init_share()), and the
+ * first RMI call waits for all of them to be done.
+ */
+static struct granule granules[RMM_MAX_GRANULES] __section("granules_table");
+
+/* Number of granules zeroed in one go */
+#define GRANULE_INIT_CHUNK	1024UL
+#define GRANULE_INIT_CHUNKS	((RMM_MAX_GRANULES + GRANULE_INIT_CHUNK - 1UL) / \
+				 GRANULE_INIT_CHUNK)
+
+/* Next chunk of the granule table to be zeroed */
+static uint64_t granules_init_next;
+
+/* Number of chunks of the granule table already zeroed */
+static uint64_t granules_init_done __hot_bss;
+
+/*
+ * One bit per granule, set while a DELEGATED granule may still hold the
+ * content it had before delegation. A bit is only accessed with the lock of
+ * its granule held, but it shares a word with the bits of other granules,
+ * hence the atomic updates.
+ */
+static uint64_t granules_to_scrub[(RMM_MAX_GRANULES + 63UL) / 64UL];
+
+/*
+ * One bit per granule, set while a DELEGATED granule holds content loaded by
+ * the Host before its delegation, to be measured in place by Data.Create.
+ * Such a granule also needs a scrub, but is left alone by
+ * granule_prescrub(). The bits follow the same rules as the ones above.
+ */
+static uint64_t granules_preloaded[(RMM_MAX_GRANULES + 63UL) / 64UL];
+
+/* Number of words of granules_to_scrub[] looked at per granule_prescrub() */
+#define PRESCRUB_SCAN_WORDS	4U
+
+/* Next word of granules_to_scrub[] to be looked at by granule_prescrub() */
+static uint64_t prescrub_cursor;
+
+#ifdef RMM_GRANULE_STATS
+COMPILER_ASSERT(RMI_GRANULE_STATE_NS == (unsigned long)GRANULE_STATE_NS);
+COMPILER_ASSERT(RMI_GRANULE_STATE_DELEGATED ==
+		(unsigned long)GRANULE_STATE_DELEGATED);
+COMPILER_ASSERT(RMI_GRANULE_STATE_RD == (unsigned long)GRANULE_STATE_RD);
+COMPILER_ASSERT(RMI_GRANULE_STATE_REC == (unsigned long)GRANULE_STATE_REC);
+COMPILER_ASSERT(RMI_GRANULE_STATE_REC_AUX ==
+		(unsigned long)GRANULE_STATE_REC_AUX);
+COMPILER_ASSERT(RMI_GRANULE_STATE_DATA == (unsigned long)GRANULE_STATE_DATA);
+COMPILER_ASSERT(RMI_GRANULE_STATE_RTT == (unsigned long)GRANULE_STATE_RTT);
+COMPILER_ASSERT(RMI_GRANULE_STATE_RTT_SHARED ==
+		(unsigned long)GRANULE_STATE_RTT_SHARED);
+COMPILER_ASSERT(RMI_GRANULE_STATE_NR == ((unsigned long)GRANULE_STATE_LAST + 1UL));
+
+/*
+ * Granule state transitions made by each CPU, indexed by the state before
+ * and after the transition. Each CPU only updates its own counters, so no
+ * synchronisation is needed.
+ */
+static unsigned long granule_transitions[MAX_CPUS][RMI_GRANULE_STATE_NR]
+					[RMI_GRANULE_STATE_NR];
+#endif
+
+#ifdef RMM_GRANULE_SUMMARY
+/* Width of the counter of a granule state in a summary word */
+#define SUMMARY_COUNTER_BITS	10U
+#define SUMMARY_COUNTER_MASK	((1UL << SUMMARY_COUNTER_BITS) - 1UL)
+
+COMPILER_ASSERT(GRANULE_SUMMARY_BLOCK_GRANULES <= SUMMARY_COUNTER_MASK);
+COMPILER_ASSERT(((unsigned long)GRANULE_STATE_LAST * SUMMARY_COUNTER_BITS) <=
+		64UL);
+
+/*
+ * For each block of GRANULE_SUMMARY_BLOCK_GRANULES entries of the granule
+ * table, the number of granules of the block in each state other than NS,
+ * packed in a word. A granule only changes state with its lock held, but
+ * the word is shared with the other granules of the block, hence the
+ * atomic updates. An all-zero word is a block of NS granules, which is
+ * what the zeroed granule table holds.
+ */
+static uint64_t granule_summary[(RMM_MAX_GRANULES +
+				 GRANULE_SUMMARY_BLOCK_GRANULES - 1UL) /
+				GRANULE_SUMMARY_BLOCK_GRANULES];
+#endif
+
+#ifdef RMM_GRANULE_HOT_SLOTS
+struct granule_hot granule_hot[RMM_GRANULE_HOT_SLOTS];
+
+/* Bit i is set while slot i of granule_hot[] is in use */
+static uint64_t granule_hot_used[(RMM_GRANULE_HOT_SLOTS + 63U) / 64U];
+#endif
+
+#ifdef RMM_GRANULE_CHECK_SAMPLE
+/* Number of granules looked at per granule_check_sweep() */
+#define GRANULE_CHECK_SWEEP_NR	16UL
+
+/* Granule lock and unlock operations of each CPU since its last check */
+static unsigned int granule_check_count[MAX_CPUS];
+
+/* Next granule of the table to be checked by granule_check_sweep() */
+static uint64_t granule_check_cursor;
+#endif
+
+/*
+ * Claim and zero the next chunk of the granule table. Returns false if all
+ * the chunks were already claimed.
+ */
+static bool granule_table_init_chunk(void)
+{
+	uint64_t chunk = atomic_load_add_release_64(&granules_init_next, 1L);
+	unsigned long start, nr;
+
+	if (chunk >= GRANULE_INIT_CHUNKS) {
+		return false;
+	}
+
+	start = chunk * GRANULE_INIT_CHUNK;
+	nr = RMM_MAX_GRANULES - start;
+	if (nr > GRANULE_INIT_CHUNK) {
+		nr = GRANULE_INIT_CHUNK;
+	}
+
+	(void)memset(&granules[start], 0, nr * sizeof(struct granule));
+
+	/* Publish the zeroed chunk to the CPU completing the table */
+	(void)atomic_load_add_release_64(&granules_init_done, 1L);
+	return true;
+}
+
+void granule_table_init_share(void)
+{
+	for (unsigned long i = 0UL;
+	     i < ((GRANULE_INIT_CHUNKS + MAX_CPUS - 1UL) / MAX_CPUS); i++) {
+		if (!granule_table_init_chunk()) {
+			break;
+		}
+	}
+}
+
+void granule_table_init_complete(void)
+{
+	if (SCA_READ64_ACQUIRE(&granules_init_done) == GRANULE_INIT_CHUNKS) {
+		return;
+	}
+
+	/* Zero the chunks no CPU has claimed yet */
+	while (granule_table_init_chunk()) {
+	}
+
+	/* Wait for the chunks claimed by other CPUs */
+	while (SCA_READ64_ACQUIRE(&granules_init_done) < GRANULE_INIT_CHUNKS) {
+	}
+}
 
 /*
  * Takes a valid pointer to a struct granule, and returns the granule physical
@@ -79,6 +237,7 @@ struct granule *addr_to_granule(unsigned long addr)
  *     - @addr is not aligned to the size of a granule.
  *     - @addr is out of range.
  */
+__hot_text
 struct granule *find_granule(unsigned long addr)
 {
 	unsigned long idx;
@@ -96,6 +255,56 @@ struct granule *find_granule(unsigned long addr)
 	return granule_from_idx(idx);
 }
 
+/*
+ * Verifies whether [@addr, @addr + @count * GRANULE_SIZE) is a range of valid
+ * granule physical addresses backed by consecutive entries of the granules
+ * array, and returns a pointer to the struct granule for @addr.
+ *
+ * The caller may then iterate over the @count entries starting from the
+ * returned pointer instead of looking up each granule address.
+ *
+ * This is purely a lookup, and provides no guarantees w.r.t the state of the
+ * granules (e.g. locking).
+ *
+ * Returns:
+ *     Pointer to the struct granule for @addr if the range is valid.
+ *     NULL if any of:
+ *     - @count is zero, exceeds RMM_MAX_GRANULES or the range overflows.
+ *     - @addr is not aligned to the size of a granule.
+ *     - Any address of the range is out of range.
+ *     - The range crosses a discontinuity of the platform memory layout.
+ */
+struct granule *find_granule_range(unsigned long addr, unsigned long count)
+{
+	unsigned long idx, last_idx, last_addr;
+
+	if ((count == 0UL) || (count > RMM_MAX_GRANULES)) {
+		return NULL;
+	}
+
+	last_addr = addr + ((count - 1UL) * GRANULE_SIZE);
+	if (last_addr < addr) {
+		return NULL;
+	}
+
+	if (!GRANULE_ALIGNED(addr)) {
+		return NULL;
+	}
+
+	idx = plat_granule_addr_to_idx(addr);
+	if (idx >= RMM_MAX_GRANULES) {
+		return NULL;
+	}
+
+	last_idx = plat_granule_addr_to_idx(last_addr);
+	if ((last_idx >= RMM_MAX_GRANULES) ||
+	    ((last_idx - idx) != (count - 1UL))) {
+		return NULL;
+	}
+
+	return granule_from_idx(idx);
+}
+
 /*
  * Obtain a pointer to a locked granule at @addr if @addr is a valid granule
  * physical address and the state of the granule at @addr is @expected_state.
@@ -108,6 +317,7 @@ struct granule *find_granule(unsigned long addr)
  *	- if the state of the granule at @addr is not
  *	@expected_state.
  */
+__hot_text
 struct granule *find_lock_granule(unsigned long addr,
 				  enum granule_state expected_state)
 {
@@ -125,32 +335,47 @@ struct granule *find_lock_granule(unsigned long addr,
 	return g;
 }
 
-struct granule_set {
-	unsigned int idx;
-	unsigned long addr;
-	enum granule_state state;
-	struct granule *g;
-	struct granule **g_ret;
+/*
+ * Comparators of a sorting network for FIND_LOCK_GRANULES_MAX inputs. The
+ * sequence of comparisons does not depend on the addresses, so that it is
+ * short and free of data-dependent loops.
+ */
+static const unsigned char sort_network[][2] = {
+	{0U, 1U}, {2U, 3U}, {4U, 5U}, {6U, 7U},
+	{0U, 2U}, {1U, 3U}, {4U, 6U}, {5U, 7U},
+	{1U, 2U}, {5U, 6U}, {0U, 4U}, {3U, 7U},
+	{1U, 5U}, {2U, 6U}, {1U, 4U}, {3U, 6U},
+	{2U, 4U}, {3U, 5U}, {3U, 4U}
 };
 
+COMPILER_ASSERT(FIND_LOCK_GRANULES_MAX == 8U);
+
 /*
- * Sort a set of granules by their address.
+ * Set @order to the indexes of the @n granules of @granules sorted by their
+ * address. The unused inputs of the network sort after all the others.
  */
-static void sort_granules(struct granule_set *granules,
-			unsigned long n)
+static void sort_granules(const struct granule_set *granules, unsigned int n,
+			  unsigned char order[FIND_LOCK_GRANULES_MAX])
 {
-	unsigned long i;
+	unsigned long key[FIND_LOCK_GRANULES_MAX];
 
-	for (i = 1UL; i < n; i++) {
-		struct granule_set temp = granules[i];
-		unsigned long j = i;
+	for (unsigned int i = 0U; i < FIND_LOCK_GRANULES_MAX; i++) {
+		key[i] = (i < n) ? granules[i].addr : ~0UL;
+		order[i] = (unsigned char)i;
+	}
 
-		while ((j > 0UL) && (granules[j - 1].addr > temp.addr)) {
-			granules[j] = granules[j - 1];
-			j--;
-		}
-		if (i != j) {
-			granules[j] = temp;
+	for (unsigned int i = 0U; i < ARRAY_SIZE(sort_network); i++) {
+		unsigned int a = sort_network[i][0];
+		unsigned int b = sort_network[i][1];
+
+		if (key[a] > key[b]) {
+			unsigned long k = key[a];
+			unsigned char o = order[a];
+
+			key[a] = key[b];
+			key[b] = k;
+			order[a] = order[b];
+			order[b] = o;
 		}
 	}
 }
@@ -158,12 +383,11 @@ static void sort_granules(struct granule_set *granules,
 /*
  * Find a set of granules and lock them in order of their address.
  *
- * @granules: Pointer to array of @n items.  Each item must be pre-populated
+ * @granules: Pointer to array of @n items. Each item must be pre-populated
  *		with ->addr set to the granule's address, and ->state set to
- *		the expected state of the granule, and ->g_ret pointing to
- *		a valid 'struct granule *'.
- *		This function sorts the supplied array in place.
- * @n: Number of struct granule_set in array pointed to by @granules
+ *		the expected state of the granule. The array is not reordered.
+ * @n: Number of struct granule_set in array pointed to by @granules, at
+ *     most FIND_LOCK_GRANULES_MAX.
  *
  * Returns:
  *     True if all granules in @granules were successfully locked.
@@ -178,44 +402,43 @@ static void sort_granules(struct granule_set *granules,
  * locking rules in granule_types.h.
  *
  * If the function succeeds, for all items in @granules, ->g points to a locked
- * granule in ->state and *->g_ret is set to the pointer value.
+ * granule in ->state.
  *
- * If the function fails, no lock is held and no *->g_ret pointers are
- * modified.
+ * If the function fails, no lock is held and no ->g pointer is modified.
  */
-static bool find_lock_granules(struct granule_set *granules,
-				unsigned long n)
+bool find_lock_granules(struct granule_set *granules, unsigned int n)
 {
-	long i;
+	unsigned char order[FIND_LOCK_GRANULES_MAX];
+	struct granule *g[FIND_LOCK_GRANULES_MAX];
+	unsigned int i;
 
-	for (i = 0L; i < n; i++) {
-		granules[i].idx = i;
-	}
+	assert(n <= FIND_LOCK_GRANULES_MAX);
 
-	sort_granules(granules, n);
+	sort_granules(granules, n, order);
+
+	for (i = 0U; i < n; i++) {
+		const struct granule_set *gs = &granules[order[i]];
 
-	for (i = 0L; i < n; i++) {
 		/* Check for duplicates */
-		if ((i > 0L) && (granules[i].addr == granules[i - 1].addr)) {
+		if ((i > 0U) && (gs->addr == granules[order[i - 1U]].addr)) {
 			goto out_err;
 		}
 
-		granules[i].g = find_lock_granule(granules[i].addr,
-						granules[i].state);
-		if (granules[i].g == NULL) {
+		g[i] = find_lock_granule(gs->addr, gs->state);
+		if (g[i] == NULL) {
 			goto out_err;
 		}
 	}
 
-	for (i = 0L; i < n; i++) {
-		*granules[i].g_ret = granules[i].g;
+	for (i = 0U; i < n; i++) {
+		granules[order[i]].g = g[i];
 	}
 
 	return true;
 
 out_err:
-	for (i = i - 1; i >= 0L; i--) {
-		granule_unlock(granules[i].g);
+	while (i-- > 0U) {
+		granule_unlock(g[i]);
 	}
 
 	return false;
@@ -235,13 +458,19 @@ bool find_lock_two_granules(
 			struct granule **g2)
 {
 	struct granule_set granules[] = {
-		{0U, addr1, expected_state1, NULL, g1},
-		{1U, addr2, expected_state2, NULL, g2}
+		{addr1, expected_state1, NULL},
+		{addr2, expected_state2, NULL}
 	};
 
 	assert((g1 != NULL) && (g2 != NULL));
 
-	return find_lock_granules(granules, ARRAY_SIZE(granules));
+	if (!find_lock_granules(granules, (unsigned int)ARRAY_SIZE(granules))) {
+		return false;
+	}
+
+	*g1 = granules[0].g;
+	*g2 = granules[1].g;
+	return true;
 }
 
 void granule_memzero(struct granule *g, enum buffer_slot slot)
@@ -251,11 +480,333 @@ void granule_memzero(struct granule *g, enum buffer_slot slot)
 	assert(g != NULL);
 
 	buf = granule_map(g, slot);
-	(void)memset(buf, 0, GRANULE_SIZE);
+	zero_granule(buf);
 	buffer_unmap(buf);
 }
 
 void granule_memzero_mapped(void *buf)
 {
-	(void)memset(buf, 0, GRANULE_SIZE);
+	zero_granule(buf);
+}
+
+void granule_mec_clean(struct granule *g)
+{
+	unsigned long addr = granule_addr(g);
+	unsigned long line = 4UL << EXTRACT(CTR_EL0_DMINLINE, read_ctr_el0());
+
+	for (unsigned long pa = addr; pa < (addr + GRANULE_SIZE); pa += line) {
+		dccipae(pa);
+	}
+	dsb(sy);
+}
+
+static uint64_t *granule_bitmap_word(uint64_t *bitmap, struct granule *g,
+				     int *bit)
+{
+	unsigned long idx;
+
+	assert(g != NULL);
+	assert(g >= &granules[0]);
+
+	idx = g - &granules[0];
+	*bit = (int)(idx % 64UL);
+
+	return &bitmap[idx / 64UL];
+}
+
+static uint64_t *granule_scrub_word(struct granule *g, int *bit)
+{
+	return granule_bitmap_word(granules_to_scrub, g, bit);
+}
+
+static void granule_clear_preloaded(struct granule *g)
+{
+	int bit;
+	uint64_t *word = granule_bitmap_word(granules_preloaded, g, &bit);
+
+	atomic_bit_clear_release_64(word, bit);
+}
+
+void granule_set_preloaded(struct granule *g)
+{
+	int bit;
+	uint64_t *word = granule_bitmap_word(granules_preloaded, g, &bit);
+
+	granule_set_needs_scrub(g);
+	atomic_bit_set_release_64(word, bit);
+}
+
+bool granule_is_preloaded(struct granule *g)
+{
+	int bit;
+	uint64_t *word = granule_bitmap_word(granules_preloaded, g, &bit);
+
+	return atomic_test_bit_acquire_64(word, bit);
+}
+
+void granule_set_needs_scrub(struct granule *g)
+{
+	int bit;
+	uint64_t *word = granule_scrub_word(g, &bit);
+
+	atomic_bit_set_release_64(word, bit);
+}
+
+void granule_clear_needs_scrub(struct granule *g)
+{
+	int bit;
+	uint64_t *word = granule_scrub_word(g, &bit);
+
+	atomic_bit_clear_release_64(word, bit);
+	granule_clear_preloaded(g);
+}
+
+/*
+ * Zero the granule if it has not been scrubbed since its delegation. The
+ * granule is only mapped in @slot when it needs to be zeroed.
+ */
+void granule_scrub(struct granule *g, enum buffer_slot slot)
+{
+	int bit;
+	uint64_t *word = granule_scrub_word(g, &bit);
+
+	if (atomic_test_bit_acquire_64(word, bit)) {
+		granule_memzero(g, slot);
+		atomic_bit_clear_release_64(word, bit);
+		granule_clear_preloaded(g);
+	}
+}
+
+/* Same as granule_scrub() for a granule already mapped at @buf */
+void granule_scrub_mapped(struct granule *g, void *buf)
+{
+	int bit;
+	uint64_t *word = granule_scrub_word(g, &bit);
+
+	if (atomic_test_bit_acquire_64(word, bit)) {
+		granule_memzero_mapped(buf);
+		atomic_bit_clear_release_64(word, bit);
+		granule_clear_preloaded(g);
+	}
+}
+
+/*
+ * The words of the bitmap are handed out from a shared cursor, so that
+ * concurrent callers look at different granules, and a caller only looks at
+ * PRESCRUB_SCAN_WORDS words. The cost of a call is therefore bounded by
+ * @budget granule zeroings, whether or not there is work left.
+ */
+void granule_prescrub(unsigned int budget)
+{
+	for (unsigned int i = 0U; (i < PRESCRUB_SCAN_WORDS) && (budget != 0U);
+	     i++) {
+		unsigned long w = atomic_load_add_release_64(&prescrub_cursor,
+							     1L) %
+				  ARRAY_SIZE(granules_to_scrub);
+		uint64_t bits = __sca_read64(&granules_to_scrub[w]) &
+				~__sca_read64(&granules_preloaded[w]);
+
+		while ((bits != 0UL) && (budget != 0U)) {
+			unsigned long idx = (w * 64UL) +
+					    (unsigned long)__builtin_ctzl(bits);
+			struct granule *g = &granules[idx];
+
+			bits &= bits - 1UL;
+
+			if (!granule_trylock_on_state_match(g,
+						GRANULE_STATE_DELEGATED)) {
+				continue;
+			}
+
+			/*
+			 * The bit may have been cleared, or the granule marked
+			 * as preloaded, before the lock.
+			 */
+			if (!granule_is_preloaded(g)) {
+				granule_scrub(g, SLOT_DELEGATED);
+			}
+			granule_unlock(g);
+			budget--;
+		}
+	}
+}
+
+#ifdef RMM_GRANULE_CHECK_SAMPLE
+bool granule_check_sampled(void)
+{
+	unsigned int *count = &granule_check_count[my_cpuid()];
+
+	if (++(*count) < RMM_GRANULE_CHECK_SAMPLE) {
+		return false;
+	}
+
+	*count = 0U;
+	return true;
+}
+
+void granule_check_sweep(void)
+{
+	for (unsigned long i = 0UL; i < GRANULE_CHECK_SWEEP_NR; i++) {
+		unsigned long idx = atomic_load_add_release_64(
+					&granule_check_cursor, 1L) %
+				    RMM_MAX_GRANULES;
+		struct granule *g = &granules[idx];
+		uint64_t word = __sca_read64((uint64_t *)(void *)&g->lock);
+		enum granule_state state = (enum granule_state)(word >> 32);
+
+		/*
+		 * The lock is only tried, in the state it was seen in, so that
+		 * the sweep never waits. A corrupted state is still locked and
+		 * caught by the check.
+		 */
+		if (!granule_trylock_on_state_match(g, state)) {
+			continue;
+		}
+
+		__granule_assert_unlocked_invariants(g, state);
+		spinlock_release(&g->lock);
+	}
+}
+#endif
+
+#ifdef RMM_GRANULE_STATS
+void granule_stats_transition(enum granule_state from, enum granule_state to)
+{
+	assert((unsigned long)from < RMI_GRANULE_STATE_NR);
+	assert((unsigned long)to < RMI_GRANULE_STATE_NR);
+
+	if (from != to) {
+		granule_transitions[my_cpuid()][from][to]++;
+	}
+}
+
+unsigned long granule_stats_transitions(unsigned int cpu,
+					enum granule_state from,
+					enum granule_state to)
+{
+	assert(cpu < MAX_CPUS);
+
+	return SCA_READ64(&granule_transitions[cpu][from][to]);
+}
+
+long granule_stats_count(enum granule_state state)
+{
+	long count = 0L;
+
+	for (unsigned int cpu = 0U; cpu < MAX_CPUS; cpu++) {
+		for (unsigned int s = 0U; s < RMI_GRANULE_STATE_NR; s++) {
+			count += (long)granule_stats_transitions(cpu,
+						(enum granule_state)s, state);
+			count -= (long)granule_stats_transitions(cpu,
+						state, (enum granule_state)s);
+		}
+	}
+
+	return count;
+}
+#endif
+
+#ifdef RMM_GRANULE_HOT_SLOTS
+void granule_hot_attach(struct granule *g)
+{
+	for (unsigned int i = 0U; i < RMM_GRANULE_HOT_SLOTS; i++) {
+		uint64_t *word = &granule_hot_used[i / 64U];
+
+		/* Skip the words of slots which are all in use */
+		if (((i % 64U) == 0U) && (SCA_READ64(word) == ~0UL)) {
+			i += 63U;
+			continue;
+		}
+
+		if (!atomic_bit_set_acquire_release_64(word, (int)(i % 64U))) {
+			granule_hot[i].refcount = g->refcount;
+			g->refcount = GRANULE_HOT_BIT | i;
+			return;
+		}
+	}
+
+	/* All the slots are in use, the refcount stays in the table */
+}
+
+void granule_hot_detach(struct granule *g)
+{
+	unsigned long i;
+
+	if ((g->refcount & GRANULE_HOT_BIT) == 0UL) {
+		return;
+	}
+
+	i = g->refcount & ~GRANULE_HOT_BIT;
+	assert(i < RMM_GRANULE_HOT_SLOTS);
+
+	g->refcount = granule_hot[i].refcount;
+	atomic_bit_clear_release_64(&granule_hot_used[i / 64U],
+				    (int)(i % 64U));
+}
+#endif
+
+#ifdef RMM_GRANULE_SUMMARY
+/* Value of a granule in @state in its summary word */
+static uint64_t summary_unit(enum granule_state state)
+{
+	if (state == GRANULE_STATE_NS) {
+		return 0UL;
+	}
+
+	return 1UL << (((unsigned int)state - 1U) * SUMMARY_COUNTER_BITS);
+}
+
+void granule_summary_transition(struct granule *g,
+				enum granule_state from,
+				enum granule_state to)
+{
+	unsigned long idx;
+
+	assert(g >= &granules[0]);
+
+	if (from == to) {
+		return;
+	}
+
+	idx = (unsigned long)(g - &granules[0]);
+
+	/* The subtraction wraps, adding it is still the right update */
+	atomic_add_64(&granule_summary[idx / GRANULE_SUMMARY_BLOCK_GRANULES],
+		      (long)(summary_unit(to) - summary_unit(from)));
+}
+
+bool granule_block_state(unsigned long addr, enum granule_state *state)
+{
+	struct granule *g;
+	unsigned long idx;
+	uint64_t word;
+
+	g = find_granule_range(addr, GRANULE_SUMMARY_BLOCK_GRANULES);
+	if (g == NULL) {
+		return false;
+	}
+
+	idx = (unsigned long)(g - &granules[0]);
+	if ((idx % GRANULE_SUMMARY_BLOCK_GRANULES) != 0UL) {
+		return false;
+	}
+
+	word = SCA_READ64(&granule_summary[idx /
+					   GRANULE_SUMMARY_BLOCK_GRANULES]);
+	if (word == 0UL) {
+		*state = GRANULE_STATE_NS;
+		return true;
+	}
+
+	for (unsigned int s = (unsigned int)GRANULE_STATE_DELEGATED;
+	     s <= (unsigned int)GRANULE_STATE_LAST; s++) {
+		if (word == (summary_unit((enum granule_state)s) *
+			     GRANULE_SUMMARY_BLOCK_GRANULES)) {
+			*state = (enum granule_state)s;
+			return true;
+		}
+	}
+
+	return false;
 }
+#endif
@@ -7,6 +7,9 @@
 #define SLOT_BUF_ARCH_H
 
 #define buffer_arch_map			buffer_map_internal
+#define buffer_arch_map_mec		buffer_map_internal_mec
 #define buffer_arch_unmap		buffer_unmap_internal
+#define buffer_arch_map_group		buffer_map_internal_group
+#define buffer_arch_unmap_group		buffer_unmap_internal_group
 
 #endif /* SLOT_BUF_ARCH_H */
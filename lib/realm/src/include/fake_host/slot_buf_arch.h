@@ -11,12 +11,39 @@
 static void *buffer_arch_map(enum buffer_slot slot,
 			      unsigned long addr, bool ns)
 {
+	HOST_COST(HOST_COST_SLOT_MAP);
 	return host_buffer_arch_map(slot, addr, ns);
 }
 
+/* The fake host has no memory encryption, @mecid is ignored */
+static void *buffer_arch_map_mec(enum buffer_slot slot,
+				  unsigned long addr, unsigned int mecid)
+{
+	(void)mecid;
+	HOST_COST(HOST_COST_SLOT_MAP);
+	return host_buffer_arch_map(slot, addr, false);
+}
+
 static void buffer_arch_unmap(void *buf)
 {
 	return host_buffer_arch_unmap(buf);
 }
 
+static void buffer_arch_map_group(const enum buffer_slot slots[],
+				  const unsigned long addrs[],
+				  unsigned int nr, void *bufs[])
+{
+	for (unsigned int i = 0U; i < nr; i++) {
+		HOST_COST(HOST_COST_SLOT_MAP);
+		bufs[i] = host_buffer_arch_map(slots[i], addrs[i], false);
+	}
+}
+
+static void buffer_arch_unmap_group(void *bufs[], unsigned int nr)
+{
+	for (unsigned int i = 0U; i < nr; i++) {
+		host_buffer_arch_unmap(bufs[i]);
+	}
+}
+
 #endif /* SLOT_BUF_ARCH_H */
@@ -3,26 +3,25 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <arch_features.h>
 #include <arch_helpers.h>
+#include <atomics.h>
 #include <attestation_token.h>
 #include <bitmap.h>
 #include <buffer.h>
+#include <cpuid.h>
 #include <gic.h>
 #include <granule.h>
 #include <memory_alloc.h>
 #include <realm.h>
 #include <ripas.h>
+#include <sizes.h>
 #include <smc.h>
 #include <status.h>
 #include <stddef.h>
 #include <string.h>
 #include <table.h>
 
-/*
- * For prototyping we assume 4K pages
- */
-#define BLOCK_L2_SIZE		(GRANULE_SIZE * S2TTES_PER_S2TT)
-
 /*
  * The maximum number of bits supported by the RMM for a stage 2 translation
  * output address (including stage 2 table entries).
@@ -47,6 +46,7 @@
 #define S2TTE_AP_SHIFT			6
 #define S2TTE_AP_MASK			(3UL << S2TTE_AP_SHIFT)
 #define S2TTE_AP_RW			(3UL << S2TTE_AP_SHIFT)
+#define S2TTE_AP_W			(2UL << S2TTE_AP_SHIFT)
 
 #define S2TTE_SH_SHIFT			8
 #define S2TTE_SH_MASK			(3UL << S2TTE_SH_SHIFT)
@@ -61,6 +61,7 @@
  */
 #define S2TTE_MEMATTR_FWB_NORMAL_WB	((1UL << 4) | (2UL << 2))
 #define S2TTE_AF			(1UL << 10)
+#define S2TTE_DBM			(1UL << 51)
 #define S2TTE_XN			(2UL << 53)
 #define S2TTE_NS			(1UL << 55)
 
@@ -104,9 +105,17 @@
  *						 S2TTE_INVALID_RIPAS_EMPTY)
  * Protected	ASSIGNED	RAM		Valid page / block with NS=0
  * Protected	DESTROYED	*		S2TTE_INVALID_DESTROYED
+ * Protected	EXPORTED	RAM		(S2TTE_INVALID_HIPAS_EXPORTED	|
+ *						 S2TTE_INVALID_RIPAS_RAM	|
+ *						 sequence number)
  * Unprotected	INVALID_NS	N/A		S2TTE_INVALID_UNPROTECTED
  * Unprotected	VALID_NS	N/A		Valid page / block with NS=1
  * ------------------------------------------------------------------------------
+ *
+ * HIPAS=EXPORTED is only used at the page level, for a DATA granule whose
+ * content the Host holds encrypted, see RMI_DATA_EXPORT. The sequence
+ * number of the export is kept where the output address of the other
+ * s2ttes is.
  */
 
 #define S2TTE_INVALID_HIPAS_SHIFT	2
@@ -116,6 +125,7 @@
 #define S2TTE_INVALID_HIPAS_UNASSIGNED	(INPLACE(S2TTE_INVALID_HIPAS, 0))
 #define S2TTE_INVALID_HIPAS_ASSIGNED	(INPLACE(S2TTE_INVALID_HIPAS, 1))
 #define S2TTE_INVALID_HIPAS_DESTROYED	(INPLACE(S2TTE_INVALID_HIPAS, 2))
+#define S2TTE_INVALID_HIPAS_EXPORTED	(INPLACE(S2TTE_INVALID_HIPAS, 3))
 
 #define S2TTE_INVALID_RIPAS_SHIFT	6
 #define S2TTE_INVALID_RIPAS_WIDTH	1
@@ -125,16 +135,158 @@
 #define S2TTE_INVALID_RIPAS_RAM		(INPLACE(S2TTE_INVALID_RIPAS, 1))
 
 #define S2TTE_INVALID_DESTROYED		S2TTE_INVALID_HIPAS_DESTROYED
+
+#define S2TTE_EXPORT_SEQ_SHIFT		GRANULE_SHIFT
+#define S2TTE_EXPORT_SEQ_WIDTH		S2TTE_EXPORT_SEQ_BITS
+#define S2TTE_EXPORT_SEQ_MASK		MASK(S2TTE_EXPORT_SEQ)
+
 #define S2TTE_INVALID_UNPROTECTED	0x0UL
 
 #define NR_RTT_LEVELS	4
 
 /*
- * Invalidates S2 TLB entries from [ipa, ipa + size] region tagged with `vmid`.
+ * Level hint passed to stage2_tlbi_ipa() when the level of the leaf entry
+ * for the invalidated range is not known, e.g. when a table descriptor has
+ * been removed.
+ */
+#define TLBI_NO_LEVEL_HINT	0L
+
+/*
+ * Invalidate the S2 TLB entries for @size bytes starting at @ipa, using a
+ * single instruction per granule. If FEAT_TTL is present, @level is encoded
+ * as a hint of the level that holds the leaf entries.
+ *
+ * If only final level entries at a known @level are invalidated, a single
+ * instruction is issued for each of them rather than for each granule.
+ */
+static void stage2_tlbi_ipa_granules(unsigned long ipa, unsigned long size,
+				     long level, bool last_level)
+{
+	unsigned long ttl = 0UL;
+	unsigned long step = GRANULE_SIZE;
+
+	if ((level != TLBI_NO_LEVEL_HINT) && is_feat_ttl_present()) {
+		ttl = TLBI_TTL(level);
+	}
+
+	if (last_level && (level != TLBI_NO_LEVEL_HINT)) {
+		step = s2tte_map_size((int)level);
+	}
+
+	while (true) {
+		if (last_level) {
+			tlbiipas2le1is(TLBI_ADDR(ipa) | ttl);
+		} else {
+			tlbiipas2e1is(TLBI_ADDR(ipa) | ttl);
+		}
+
+		if (size <= step) {
+			break;
+		}
+		size -= step;
+		ipa += step;
+	}
+}
+
+#ifdef RMM_S2_TLBI_VMID_THRESHOLD
+/* Number of instructions issued by stage2_tlbi_ipa_granules() */
+static unsigned long stage2_tlbi_ipa_count(unsigned long size, long level,
+					   bool last_level)
+{
+	unsigned long step = GRANULE_SIZE;
+
+	if (last_level && (level != TLBI_NO_LEVEL_HINT)) {
+		step = s2tte_map_size((int)level);
+	}
+
+	return (size + step - 1UL) / step;
+}
+#endif
+
+/*
+ * Invalidate the S2 TLB entries for @size bytes starting at @ipa using TLB
+ * range maintenance instructions (FEAT_TLBIRANGE). Each iteration covers the
+ * largest range that can be encoded with the remaining number of granules.
+ */
+static void stage2_tlbi_ipa_range(unsigned long ipa, unsigned long size,
+				  long level, bool last_level)
+{
+	unsigned long granules = size / GRANULE_SIZE;
+
+	while (granules != 0UL) {
+		unsigned int scale = TLBIR_SCALE_MAX;
+		unsigned long num, op;
+
+		if (granules == 1UL) {
+			stage2_tlbi_ipa_granules(ipa, GRANULE_SIZE,
+						 level, last_level);
+			return;
+		}
+
+		while (granules < TLBIR_SCALE_GRANULES(scale)) {
+			scale--;
+		}
+
+		num = granules / TLBIR_SCALE_GRANULES(scale);
+		if (num > (TLBIR_NUM_MAX + 1UL)) {
+			num = TLBIR_NUM_MAX + 1UL;
+		}
+
+		op = TLBIR_ADDR(ipa, num - 1UL, scale,
+				(level == TLBI_NO_LEVEL_HINT) ? 0L : level);
+		if (last_level) {
+			tlbiripas2le1is(op);
+		} else {
+			tlbiripas2e1is(op);
+		}
+
+		granules -= num * TLBIR_SCALE_GRANULES(scale);
+		ipa += num * TLBIR_SCALE_GRANULES(scale) * GRANULE_SIZE;
+	}
+}
+
+#ifdef RMM_RMI_STATS
+/*
+ * Number of invalidations of all the Stage 1 entries of a VMID issued by each
+ * CPU, reported per RMI command by RMI_STATS_S1_FLUSHES.
+ */
+static unsigned long s1_flush_count[MAX_CPUS];
+
+unsigned long s2tt_s1_flush_count(void)
+{
+	return s1_flush_count[my_cpuid()];
+}
+
+static inline void s1_flush_count_inc(void)
+{
+	s1_flush_count[my_cpuid()]++;
+}
+#else
+static inline void s1_flush_count_inc(void)
+{
+}
+#endif /* RMM_RMI_STATS */
+
+/*
+ * Invalidate the S2 TLB entries for @size bytes starting at @ipa for the
+ * realm described by @s2_ctx.
+ *
+ * @level is the level of the leaf entries which have been removed, or
+ * TLBI_NO_LEVEL_HINT if it is unknown or if a table entry has been removed.
+ * If @last_level is true, only the entries cached from the final level of
+ * the walk are invalidated, which is only valid if no table entry has been
+ * removed.
+ *
+ * If @s1_flush is false, the combined Stage 1 + Stage 2 entries are not
+ * invalidated, which is only valid if none of the removed entries was a
+ * valid leaf entry.
  */
 static void stage2_tlbi_ipa(const struct realm_s2_context *s2_ctx,
 			    unsigned long ipa,
-			    unsigned long size)
+			    unsigned long size,
+			    long level,
+			    bool last_level,
+			    bool s1_flush)
 {
 	/*
 	 * Notes:
@@ -142,11 +294,12 @@ static void stage2_tlbi_ipa(const struct realm_s2_context *s2_ctx,
 	 * - This follows the description provided in the Arm ARM on
 	 *   "Invalidation of TLB entries from stage 2 translations".
 	 *
-	 * - @TODO: Provide additional information to this primitive so that
-	 *   we can utilize:
-	 *   - The TTL level hint, see FEAT_TTL,
-	 *   - Final level lookup only invalidation,
-	 *   - Address range invalidation.
+	 * - The TTL hint (FEAT_TTL) and the range invalidation
+	 *   (FEAT_TLBIRANGE) are used when implemented by the PE.
+	 *
+	 * - The nXS forms (FEAT_XS) are not used, as they do not wait for
+	 *   the Realm accesses with the XS attribute, which the Realm can
+	 *   select with its stage 1 memory attributes.
 	 */
 
 	/*
@@ -161,14 +314,34 @@ static void stage2_tlbi_ipa(const struct realm_s2_context *s2_ctx,
 	write_vttbr_el2(INPLACE(VTTBR_EL2_VMID, s2_ctx->vmid));
 	isb();
 
+#ifdef RMM_S2_TLBI_VMID_THRESHOLD
+	/*
+	 * Without range invalidation, a large range needs one instruction per
+	 * entry. Beyond a threshold, invalidating all the entries of the VMID,
+	 * which also covers the combined Stage-1 + Stage-2 entries, is
+	 * cheaper than broadcasting them one by one.
+	 */
+	if (!is_feat_tlbirange_present() &&
+	    (stage2_tlbi_ipa_count(size, level, last_level) >
+	     RMM_S2_TLBI_VMID_THRESHOLD)) {
+		tlbivmalls12e1is();
+		s1_flush_count_inc();
+		dsb(ish);
+		isb();
+		write_vttbr_el2(old_vttbr_el2);
+		isb();
+		return;
+	}
+#endif
+
 	/*
 	 * Invalidate entries in S2 TLB caches that
 	 * match both `ipa` & the `current vmid`.
 	 */
-	while (size != 0UL) {
-		tlbiipas2e1is(ipa >> 12);
-		size -= GRANULE_SIZE;
-		ipa += GRANULE_SIZE;
+	if ((size > GRANULE_SIZE) && is_feat_tlbirange_present()) {
+		stage2_tlbi_ipa_range(ipa, size, level, last_level);
+	} else {
+		stage2_tlbi_ipa_granules(ipa, size, level, last_level);
 	}
 	dsb(ish);
 
@@ -176,9 +349,15 @@ static void stage2_tlbi_ipa(const struct realm_s2_context *s2_ctx,
 	 * The architecture does not require TLB invalidation by IPA to affect
 	 * combined Stage-1 + Stage-2 TLBs. Therefore we must invalidate all of
 	 * Stage-1 (tagged with the `current vmid`) after invalidating Stage-2.
+	 *
+	 * Combined entries are only created from valid Stage-2 leaf entries,
+	 * so this is skipped when only invalid entries have been removed.
 	 */
-	tlbivmalle1is();
-	dsb(ish);
+	if (s1_flush) {
+		tlbivmalle1is();
+		s1_flush_count_inc();
+		dsb(ish);
+	}
 	isb();
 
 	/*
@@ -195,30 +374,80 @@ static void stage2_tlbi_ipa(const struct realm_s2_context *s2_ctx,
  */
 void invalidate_page(const struct realm_s2_context *s2_ctx, unsigned long addr)
 {
-	stage2_tlbi_ipa(s2_ctx, addr, GRANULE_SIZE);
+	stage2_tlbi_ipa(s2_ctx, addr, GRANULE_SIZE, RTT_PAGE_LEVEL, true, true);
 }
 
 /*
  * Invalidate S2 TLB entries with "addr" IPA.
  * Call this function after:
- * 1.  A L2 block desc has been removed, or
- * 2a. A L2 table desc has been removed, where
- * 2b. All S2TTEs in L3 table that the L2 table desc was pointed to were invalid.
+ * 1.  A L2 block desc has been removed.
  */
 void invalidate_block(const struct realm_s2_context *s2_ctx, unsigned long addr)
 {
-	stage2_tlbi_ipa(s2_ctx, addr, GRANULE_SIZE);
+	stage2_tlbi_ipa(s2_ctx, addr, GRANULE_SIZE, TLBI_NO_LEVEL_HINT, false,
+			true);
 }
 
 /*
- * Invalidate S2 TLB entries with "addr" IPA.
+ * Invalidate S2 TLB entries with "addr" IPA, without invalidating the
+ * combined S1 + S2 entries of the realm.
  * Call this function after:
- * 1a. A L2 table desc has been removed, where
- * 1b. Some S2TTEs in the table that the L2 table desc was pointed to were valid.
+ * 1a. A L1 or L2 table desc has been removed, where
+ * 1b. All S2TTEs in the table that the table desc was pointed to were
+ *     invalid.
  */
-void invalidate_pages_in_block(const struct realm_s2_context *s2_ctx, unsigned long addr)
+void invalidate_table(const struct realm_s2_context *s2_ctx, unsigned long addr)
 {
-	stage2_tlbi_ipa(s2_ctx, addr, BLOCK_L2_SIZE);
+	stage2_tlbi_ipa(s2_ctx, addr, GRANULE_SIZE, TLBI_NO_LEVEL_HINT, false,
+			false);
+}
+
+/*
+ * Invalidate S2 TLB entries for IPAs in [addr, addr + size).
+ * Call this function after:
+ * 1. A contiguous run of L3 page or L2 block descs at "level" has been
+ *    removed.
+ */
+void invalidate_range(const struct realm_s2_context *s2_ctx,
+		      unsigned long addr, unsigned long size, long level)
+{
+	stage2_tlbi_ipa(s2_ctx, addr, size, level, true, true);
+}
+
+/*
+ * Invalidate all S1 and S2 TLB entries tagged with the VMID of the realm.
+ * Call this function after:
+ * 1. Most of the S2TTEs of the realm have been removed, for instance when
+ *    the realm is torn down, instead of invalidating each of their IPAs.
+ */
+void invalidate_vmid(const struct realm_s2_context *s2_ctx)
+{
+	unsigned long old_vttbr_el2 = read_vttbr_el2();
+
+	write_vttbr_el2(INPLACE(VTTBR_EL2_VMID, s2_ctx->vmid));
+	isb();
+
+	tlbivmalls12e1is();
+	s1_flush_count_inc();
+	dsb(ish);
+	isb();
+
+	write_vttbr_el2(old_vttbr_el2);
+	isb();
+}
+
+/*
+ * Invalidate S2 TLB entries for the IPAs of the block at "level" with base
+ * "addr".
+ * Call this function after:
+ * 1a. A L1 or L2 table desc has been removed, where
+ * 1b. Some S2TTEs in the table that the table desc was pointed to were valid.
+ */
+void invalidate_pages_in_block(const struct realm_s2_context *s2_ctx, unsigned long addr,
+			       long level)
+{
+	stage2_tlbi_ipa(s2_ctx, addr, s2tte_map_size((int)level),
+			TLBI_NO_LEVEL_HINT, false, true);
 }
 
 /*
@@ -230,7 +459,8 @@ void invalidate_pages_in_block(const struct realm_s2_context *s2_ctx, unsigned l
  * aarch64/translation/vmsa_addrcalc/AArch64.TTEntryAddress on which this is
  * modeled.
  */
-static unsigned long s2_addr_to_idx(unsigned long addr, long level)
+static __always_inline unsigned long __s2_addr_to_idx(unsigned long addr,
+							long level)
 {
 	int levels = RTT_PAGE_LEVEL - level;
 	int lsb = levels * S2TTE_STRIDE + GRANULE_SHIFT;
@@ -240,6 +470,11 @@ static unsigned long s2_addr_to_idx(unsigned long addr, long level)
 	return addr;
 }
 
+unsigned long s2_addr_to_idx(unsigned long addr, long level)
+{
+	return __s2_addr_to_idx(addr, level);
+}
+
 /*
  * Return the index of the entry describing @addr in the translation table
  * starting level.  This may return an index >= S2TTES_PER_S2TT when the
@@ -250,8 +485,9 @@ static unsigned long s2_addr_to_idx(unsigned long addr, long level)
  * aarch64/translation/vmsa_addrcalc/AArch64.S2SLTTEntryAddress on which
  * this is modeled.
  */
-static unsigned long s2_sl_addr_to_idx(unsigned long addr, int start_level,
-				       unsigned long ipa_bits)
+static __always_inline unsigned long s2_sl_addr_to_idx(unsigned long addr,
+							int start_level,
+							unsigned long ipa_bits)
 {
 	int levels = RTT_PAGE_LEVEL - start_level;
 	int lsb = levels * S2TTE_STRIDE + GRANULE_SHIFT;
@@ -280,8 +516,8 @@ static inline bool entry_is_table(unsigned long entry)
 	return (entry & DESC_TYPE_MASK) == S2TTE_L012_TABLE;
 }
 
-static unsigned long __table_get_entry(struct granule *g_tbl,
-				       unsigned long idx)
+static inline unsigned long __table_get_entry(struct granule *g_tbl,
+					      unsigned long idx)
 {
 	unsigned long *table, entry;
 
@@ -292,23 +528,28 @@ static unsigned long __table_get_entry(struct granule *g_tbl,
 	return entry;
 }
 
-static struct granule *__find_next_level_idx(struct granule *g_tbl,
-					     unsigned long idx)
+/*
+ * The walk stops at a table entry linking to a shared RTT, which does not
+ * belong to the realm, see s2tte_create_shared_table().
+ */
+static inline struct granule *__find_next_level_idx(struct granule *g_tbl,
+						    unsigned long idx)
 {
 	const unsigned long entry = __table_get_entry(g_tbl, idx);
 
-	if (!entry_is_table(entry)) {
+	if (!entry_is_table(entry) || ((entry & S2TTE_NS) != 0UL)) {
 		return NULL;
 	}
 
 	return addr_to_granule(table_entry_to_phys(entry));
 }
 
-static struct granule *__find_lock_next_level(struct granule *g_tbl,
-					      unsigned long map_addr,
-					      long level)
+static __always_inline struct granule *__find_lock_next_level(
+						struct granule *g_tbl,
+						unsigned long map_addr,
+						long level)
 {
-	const unsigned long idx = s2_addr_to_idx(map_addr, level);
+	const unsigned long idx = __s2_addr_to_idx(map_addr, level);
 	struct granule *g = __find_next_level_idx(g_tbl, idx);
 
 	if (g != NULL) {
@@ -318,6 +559,51 @@ static struct granule *__find_lock_next_level(struct granule *g_tbl,
 	return g;
 }
 
+/*
+ * Per-CPU cache of the last RTT reached by rtt_walk_lock_unlock().
+ *
+ * Hosts usually issue long runs of RMI commands at increasing IPAs, which
+ * end up in the same last level RTT. A cache hit allows the walk to lock
+ * that RTT directly, skipping the upper levels.
+ *
+ * @g_tbl is the RTT at @level reached by the last walk from @g_root, which
+ * translates the block of IPAs at level @level - 1 starting at @ipa_base.
+ * The entry is only valid if @gen matches rtt_walk_cache_gen.
+ */
+struct rtt_walk_cache {
+	struct granule *g_root;
+	struct granule *g_tbl;
+	unsigned long ipa_base;
+	long level;
+	uint64_t gen;
+};
+
+static struct rtt_walk_cache rtt_walk_cache[MAX_CPUS];
+
+/*
+ * Incremented every time an RTT is about to be unlinked from its parent,
+ * which invalidates all the entries of rtt_walk_cache.
+ */
+static uint64_t rtt_walk_cache_gen;
+
+/*
+ * Invalidate the RTT walk cache of all CPUs. This must be called before an
+ * RTT is unlinked from the realm, while holding the lock on the root RTT
+ * of the realm, which orders it against any walk starting later.
+ *
+ * RTTs at the starting level are never cached, hence nothing needs to be
+ * done when the root RTTs of a realm are freed.
+ */
+void rtt_walk_cache_invalidate(void)
+{
+	atomic_add_64(&rtt_walk_cache_gen, 1L);
+}
+
+static unsigned long rtt_walk_cache_base(unsigned long map_addr, long level)
+{
+	return map_addr & ~(s2tte_map_size((int)level - 1) - 1UL);
+}
+
 /*
  * Walk an RTT until level @level using @map_addr.
  * @g_root is the root (level 0) table and must be locked before the call.
@@ -333,12 +619,155 @@ static struct granule *__find_lock_next_level(struct granule *g_tbl,
  * - The entry found is a leaf entry (not an RTT Table entry), or
  * - Level @level is reached.
  *
+ * If the RTT which translates @map_addr at a level between @start_level and
+ * @level is found in the walk cache of this CPU, the walk starts from it
+ * instead. As the lock on @g_root is held, no RTT can have been unlinked
+ * since the cache entry was checked, so the cached RTT is still part of the
+ * realm and can be locked directly without breaking the locking order.
+ *
+ * This is instantiated for each constant @start_level and @concat, where
+ * @concat is false if the starting level RTTs of the realm are not
+ * concatenated. The loop over the levels is then unrolled, with the index
+ * of @map_addr at each level computed with constant shifts.
+ *
  * On return:
  * - rtt_walk::last_level is the last level that has been reached by the walk.
  * - rtt_walk.g_llt points to the TABLE granule at level @rtt_walk::level.
  *   The granule is locked.
  * - rtt_walk::index is the entry index at rtt_walk.g_llt for @map_addr.
  */
+static __always_inline void __rtt_walk_lock_unlock(struct granule *g_root,
+						   const int start_level,
+						   const bool concat,
+						   unsigned long ipa_bits,
+						   unsigned long map_addr,
+						   long level,
+						   struct rtt_walk *wi)
+{
+	struct rtt_walk_cache *cache = &rtt_walk_cache[my_cpuid()];
+	uint64_t gen = SCA_READ64(&rtt_walk_cache_gen);
+	struct granule *g_tbl = g_root;
+	long last_level;
+
+	assert(level >= start_level);
+	assert(map_addr < (1UL << ipa_bits));
+	assert(wi != NULL);
+
+	if ((cache->g_root == g_root) && (cache->gen == gen) &&
+	    (cache->level <= level) &&
+	    (cache->ipa_base == rtt_walk_cache_base(map_addr, cache->level))) {
+		last_level = cache->level;
+		g_tbl = cache->g_tbl;
+		granule_lock(g_tbl, GRANULE_STATE_RTT);
+		granule_unlock(g_root);
+	} else {
+		last_level = start_level;
+
+		/* Handle concatenated starting level (SL) tables */
+		if (concat) {
+			unsigned long sl_idx = s2_sl_addr_to_idx(map_addr,
+							start_level, ipa_bits);
+
+			if (sl_idx >= S2TTES_PER_S2TT) {
+				g_tbl = g_root + (sl_idx >> S2TTE_STRIDE);
+				granule_lock(g_tbl, GRANULE_STATE_RTT);
+				granule_unlock(g_root);
+			}
+		}
+	}
+
+#pragma GCC unroll 4
+	for (long i = start_level; i < RTT_PAGE_LEVEL; i++) {
+		struct granule *g_next;
+
+		if (i < last_level) {
+			continue;
+		}
+
+		if (i >= level) {
+			break;
+		}
+
+		/*
+		 * Lock next RTT level. Correct locking order is guaranteed
+		 * because reference is obtained from a locked granule
+		 * (previous level). Also, hand-over-hand locking/unlocking is
+		 * used to avoid race conditions.
+		 */
+		g_next = __find_lock_next_level(g_tbl, map_addr, i);
+		if (g_next == NULL) {
+			break;
+		}
+		granule_unlock(g_tbl);
+		g_tbl = g_next;
+		last_level = i + 1L;
+	}
+
+	if (last_level > start_level) {
+		cache->g_root = g_root;
+		cache->g_tbl = g_tbl;
+		cache->ipa_base = rtt_walk_cache_base(map_addr, last_level);
+		cache->level = last_level;
+		cache->gen = gen;
+	}
+
+	wi->last_level = last_level;
+	wi->g_llt = g_tbl;
+	wi->index = __s2_addr_to_idx(map_addr, last_level);
+}
+
+typedef void (*rtt_walker_fn)(struct granule *g_root,
+			      unsigned long ipa_bits,
+			      unsigned long map_addr,
+			      long level,
+			      struct rtt_walk *wi);
+
+#define RTT_WALKER(_sl, _concat)					\
+static void rtt_walk_sl##_sl##_##_concat(struct granule *g_root,	\
+					 unsigned long ipa_bits,	\
+					 unsigned long map_addr,	\
+					 long level,			\
+					 struct rtt_walk *wi)		\
+{									\
+	__rtt_walk_lock_unlock(g_root, _sl, _concat, ipa_bits,	\
+			       map_addr, level, wi);			\
+}
+
+RTT_WALKER(0, false)
+RTT_WALKER(0, true)
+RTT_WALKER(1, false)
+RTT_WALKER(1, true)
+RTT_WALKER(2, false)
+RTT_WALKER(2, true)
+RTT_WALKER(3, false)
+RTT_WALKER(3, true)
+
+/* Indexed by the value returned by rtt_walker_select() */
+static const rtt_walker_fn rtt_walkers[] = {
+	rtt_walk_sl0_false, rtt_walk_sl0_true,
+	rtt_walk_sl1_false, rtt_walk_sl1_true,
+	rtt_walk_sl2_false, rtt_walk_sl2_true,
+	rtt_walk_sl3_false, rtt_walk_sl3_true
+};
+
+/*
+ * Return the walker of the RTTs of a realm whose stage 2 translation starts
+ * at level @start_level for an IPA space of @ipa_bits, which is stored in
+ * realm_s2_context::rtt_walker at REALM_CREATE.
+ */
+unsigned int rtt_walker_select(int start_level, unsigned long ipa_bits)
+{
+	int levels = RTT_PAGE_LEVEL - start_level;
+	unsigned long lsb = (unsigned long)(levels * S2TTE_STRIDE +
+					    GRANULE_SHIFT);
+	bool concat = (ipa_bits > (lsb + (unsigned long)S2TTE_STRIDE));
+
+	assert(start_level >= MIN_STARTING_LEVEL);
+	assert(start_level <= RTT_PAGE_LEVEL);
+
+	return ((unsigned int)start_level * 2U) + (concat ? 1U : 0U);
+}
+
 void rtt_walk_lock_unlock(struct granule *g_root,
 			  int start_level,
 			  unsigned long ipa_bits,
@@ -346,47 +775,120 @@ void rtt_walk_lock_unlock(struct granule *g_root,
 			  long level,
 			  struct rtt_walk *wi)
 {
-	struct granule *g_tbls[NR_RTT_LEVELS] = { NULL };
-	unsigned long sl_idx;
-	int i, last_level;
+	unsigned int walker = rtt_walker_select(start_level, ipa_bits);
+
+	rtt_walkers[walker](g_root, ipa_bits, map_addr, level, wi);
+}
+
+/*
+ * Same as rtt_walk_lock_unlock() from the root RTT of the realm of @s2_ctx,
+ * with the walker selected at REALM_CREATE.
+ */
+void rtt_walk_lock_unlock_ctx(const struct realm_s2_context *s2_ctx,
+			      unsigned long map_addr,
+			      long level,
+			      struct rtt_walk *wi)
+{
+	assert(s2_ctx->rtt_walker < ARRAY_LEN(rtt_walkers));
+
+	rtt_walkers[s2_ctx->rtt_walker](s2_ctx->g_rtt, s2_ctx->ipa_bits,
+					map_addr, level, wi);
+}
+
+/*
+ * Root RTT of the realm for which each CPU is performing a lockless walk
+ * (see rtt_read_s2tte_lockless()), or 0UL if the CPU is not walking.
+ *
+ * Threads which remove an RTT from a realm call rtt_wait_lockless_walkers()
+ * after unlinking it, so that no lockless walker can still be reading the
+ * RTT when it is reused or returned to the Host.
+ */
+static unsigned long lockless_walk_root[MAX_CPUS];
+
+/*
+ * Walk an RTT until level @level using @map_addr, without taking any RTT
+ * granule lock, and return the s2tte found at the last level reached.
+ * The parameters are the same as for rtt_walk_lock_unlock(), except that
+ * @g_root must not be locked by the caller.
+ *
+ * This can only be used to read RTT entries. The value returned may be
+ * stale with respect to a concurrent RMI command updating the RTT, which
+ * is equivalent to the read having happened before the update. The caller
+ * must ensure that the realm cannot be destroyed during the call, usually
+ * by holding a reference to one of its RECs.
+ *
+ * On return, @last_level holds the last level reached by the walk.
+ */
+unsigned long rtt_read_s2tte_lockless(struct granule *g_root,
+				      int start_level,
+				      unsigned long ipa_bits,
+				      unsigned long map_addr,
+				      long level,
+				      long *last_level)
+{
+	unsigned long *walk_root = &lockless_walk_root[my_cpuid()];
+	struct granule *g_tbl = g_root;
+	unsigned long sl_idx, s2tte;
+	long i;
 
 	assert(start_level >= MIN_STARTING_LEVEL);
 	assert(level >= start_level);
 	assert(map_addr < (1UL << ipa_bits));
-	assert(wi != NULL);
+	assert(last_level != NULL);
 
 	/* Handle concatenated starting level (SL) tables */
 	sl_idx = s2_sl_addr_to_idx(map_addr, start_level, ipa_bits);
 	if (sl_idx >= S2TTES_PER_S2TT) {
-		unsigned int tt_num = (sl_idx >> S2TTE_STRIDE);
-		struct granule *g_concat_root = g_root + tt_num;
-
-		granule_lock(g_concat_root, GRANULE_STATE_RTT);
-		granule_unlock(g_root);
-		g_root = g_concat_root;
+		g_tbl = g_root + (sl_idx >> S2TTE_STRIDE);
 	}
 
-	g_tbls[start_level] = g_root;
-	for (i = start_level; i < level; i++) {
-		/*
-		 * Lock next RTT level. Correct locking order is guaranteed
-		 * because reference is obtained from a locked granule
-		 * (previous level). Also, hand-over-hand locking/unlocking is
-		 * used to avoid race conditions.
-		 */
-		g_tbls[i + 1] = __find_lock_next_level(g_tbls[i], map_addr, i);
-		if (g_tbls[i + 1] == NULL) {
-			last_level = i;
-			goto out;
+	/*
+	 * Publish the walk before reading any RTT entry. This pairs with
+	 * the barrier after the RTT entry update in the thread that unlinks
+	 * an RTT, so either that thread observes this walk or this walk
+	 * observes the updated entry.
+	 */
+	SCA_WRITE64(walk_root, (unsigned long)g_root);
+	dmb(ish);
+
+	for (i = (long)start_level; ; i++) {
+		unsigned long *table = granule_map(g_tbl, SLOT_RTT);
+
+		s2tte = s2tte_read(&table[s2_addr_to_idx(map_addr, i)]);
+		buffer_unmap(table);
+
+		if ((i == level) || !s2tte_is_table(s2tte, i)) {
+			break;
 		}
-		granule_unlock(g_tbls[i]);
+
+		g_tbl = addr_to_granule(s2tte_pa_table(s2tte, i));
 	}
 
-	last_level = level;
-out:
-	wi->last_level = last_level;
-	wi->g_llt = g_tbls[last_level];
-	wi->index = s2_addr_to_idx(map_addr, last_level);
+	/* Order the reads of the RTT entries before ending the walk */
+	SCA_WRITE64_RELEASE(walk_root, 0UL);
+
+	*last_level = i;
+	return s2tte;
+}
+
+/*
+ * Wait until no CPU is performing a lockless walk of the RTTs of the realm
+ * whose root RTT is @g_root. It must be called after an RTT has been
+ * unlinked from its parent and before the RTT granule is modified or
+ * transitioned out of the RTT state.
+ */
+void rtt_wait_lockless_walkers(struct granule *g_root)
+{
+	unsigned int cpu;
+
+	/* Order the update of the parent RTT entry before the checks below */
+	dsb(ish);
+
+	for (cpu = 0U; cpu < MAX_CPUS; cpu++) {
+		while (SCA_READ64_ACQUIRE(&lockless_walk_root[cpu]) ==
+		       (unsigned long)g_root) {
+		}
+	}
 }
 
 /*
@@ -416,6 +918,17 @@ unsigned long s2tte_create_destroyed(void)
 	return S2TTE_INVALID_DESTROYED;
 }
 
+/*
+ * Creates an invalid page s2tte with HIPAS=EXPORTED, RIPAS=RAM and the
+ * sequence number @seq of the export.
+ */
+unsigned long s2tte_create_exported(unsigned long seq)
+{
+	assert(seq <= S2TTE_EXPORT_SEQ_MAX);
+	return (INPLACE(S2TTE_EXPORT_SEQ, seq) |
+		S2TTE_INVALID_HIPAS_EXPORTED | S2TTE_INVALID_RIPAS_RAM);
+}
+
 /*
  * Creates an invalid s2tte with output address @pa, HIPAS=ASSIGNED and
  * RIPAS=EMPTY, at level @level.
@@ -427,6 +940,19 @@ unsigned long s2tte_create_assigned_empty(unsigned long pa, long level)
 	return (pa | S2TTE_INVALID_HIPAS_ASSIGNED | S2TTE_INVALID_RIPAS_EMPTY);
 }
 
+/*
+ * Creates an invalid s2tte with output address @pa, HIPAS=ASSIGNED and
+ * RIPAS=RAM, at level @level. This is only used transiently, to keep the
+ * output address of a valid s2tte which is being destroyed until the TLBs
+ * have been invalidated.
+ */
+unsigned long s2tte_create_assigned_ram(unsigned long pa, long level)
+{
+	assert(level >= RTT_MIN_BLOCK_LEVEL);
+	assert(addr_is_level_aligned(pa, level));
+	return (pa | S2TTE_INVALID_HIPAS_ASSIGNED | S2TTE_INVALID_RIPAS_RAM);
+}
+
 /*
  * Creates a page or block s2tte for a Protected IPA, with output address @pa.
  */
@@ -528,6 +1054,16 @@ unsigned long s2tte_create_table(unsigned long pa, long level)
 	return (pa | S2TTE_TABLE);
 }
 
+/*
+ * Creates a table s2tte at level @level linking to the shared RTT at @pa.
+ * The NS bit is ignored by the hardware in a table descriptor, and marks
+ * the RTT as shared for RMM.
+ */
+unsigned long s2tte_create_shared_table(unsigned long pa, long level)
+{
+	return s2tte_create_table(pa, level) | S2TTE_NS;
+}
+
 /*
  * Returns true if @s2tte has HIPAS=@hipas.
  */
@@ -558,6 +1094,24 @@ bool s2tte_is_destroyed(unsigned long s2tte)
 	return s2tte_has_hipas(s2tte, S2TTE_INVALID_HIPAS_DESTROYED);
 }
 
+/*
+ * Returns true if @s2tte has HIPAS=EXPORTED.
+ */
+bool s2tte_is_exported(unsigned long s2tte)
+{
+	return s2tte_has_hipas(s2tte, S2TTE_INVALID_HIPAS_EXPORTED);
+}
+
+/*
+ * Returns the sequence number of the export of @s2tte, which has
+ * HIPAS=EXPORTED.
+ */
+unsigned long s2tte_exported_seq(unsigned long s2tte)
+{
+	assert(s2tte_is_exported(s2tte));
+	return EXTRACT(S2TTE_EXPORT_SEQ, s2tte);
+}
+
 /*
  * Returns true if @s2tte has HIPAS=ASSIGNED.
  */
@@ -578,9 +1132,10 @@ static bool s2tte_check(unsigned long s2tte, long level, unsigned long ns)
 
 	desc_type = s2tte & DESC_TYPE_MASK;
 
-	/* Only pages at L3 and valid blocks at L2 allowed */
+	/* Only pages at L3 and valid blocks at L1 and L2 allowed */
 	if (((level == RTT_PAGE_LEVEL) && (desc_type == S2TTE_L3_PAGE)) ||
-	    ((level == RTT_MIN_BLOCK_LEVEL) && (desc_type == S2TTE_L012_BLOCK))) {
+	    ((level >= RTT_MIN_BLOCK_LEVEL) && (level < RTT_PAGE_LEVEL) &&
+	     (desc_type == S2TTE_L012_BLOCK))) {
 		return true;
 	}
 
@@ -617,6 +1172,118 @@ bool s2tte_is_table(unsigned long s2tte, long level)
 	return false;
 }
 
+/*
+ * Returns true if @s2tte is a table at level @level linking to a shared RTT.
+ */
+bool s2tte_is_shared_table(unsigned long s2tte, long level)
+{
+	return s2tte_is_table(s2tte, level) && ((s2tte & S2TTE_NS) != 0UL);
+}
+
+/*
+ * Index of s2tte_types[]: the descriptor type, the class of the level of the
+ * s2tte (below RTT_MIN_BLOCK_LEVEL, block level or page level), the NS bit
+ * and the HIPAS of the s2tte, which the invalid s2ttes written by RMM keep
+ * in the low two bits of the field.
+ */
+#define S2TTE_IDX_LVL_TABLE	0UL
+#define S2TTE_IDX_LVL_BLOCK	1UL
+#define S2TTE_IDX_LVL_PAGE	2UL
+
+#define S2TTE_IDX_DESC(_i)	((_i) & DESC_TYPE_MASK)
+#define S2TTE_IDX_LVL(_i)	(((_i) >> 2) & 3UL)
+#define S2TTE_IDX_NS(_i)	(((_i) >> 4) & 1UL)
+#define S2TTE_IDX_HIPAS(_i)	(((_i) >> 5) & 3UL)
+
+#define S2TTE_IDX_VALID(_i)						\
+	((S2TTE_IDX_NS(_i) != 0UL) ? S2TTE_TYPE_VALID_NS : S2TTE_TYPE_VALID)
+
+#define S2TTE_IDX_INVALID(_i)						\
+	((S2TTE_IDX_HIPAS(_i) == 0UL) ? S2TTE_TYPE_UNASSIGNED :		\
+	 (S2TTE_IDX_HIPAS(_i) == 1UL) ? S2TTE_TYPE_ASSIGNED :		\
+	 (S2TTE_IDX_HIPAS(_i) == 2UL) ? S2TTE_TYPE_DESTROYED :		\
+					S2TTE_TYPE_EXPORTED)
+
+#define S2TTE_IDX_TYPE(_i)						\
+	((S2TTE_IDX_DESC(_i) == S2TTE_Lx_INVALID) ?			\
+		S2TTE_IDX_INVALID(_i) :					\
+	 ((S2TTE_IDX_DESC(_i) == S2TTE_L012_BLOCK) &&			\
+	  (S2TTE_IDX_LVL(_i) == S2TTE_IDX_LVL_BLOCK)) ?			\
+		S2TTE_IDX_VALID(_i) :					\
+	 ((S2TTE_IDX_DESC(_i) == S2TTE_L3_PAGE) &&			\
+	  (S2TTE_IDX_LVL(_i) == S2TTE_IDX_LVL_PAGE)) ?			\
+		S2TTE_IDX_VALID(_i) :					\
+	 ((S2TTE_IDX_DESC(_i) == S2TTE_L012_TABLE) &&			\
+	  (S2TTE_IDX_LVL(_i) < S2TTE_IDX_LVL_PAGE)) ?			\
+		S2TTE_TYPE_TABLE : S2TTE_TYPE_INVALID)
+
+#define S2TTE_TYPES_4(_i)	S2TTE_IDX_TYPE(_i),			\
+				S2TTE_IDX_TYPE((_i) + 1UL),		\
+				S2TTE_IDX_TYPE((_i) + 2UL),		\
+				S2TTE_IDX_TYPE((_i) + 3UL)
+#define S2TTE_TYPES_16(_i)	S2TTE_TYPES_4(_i), S2TTE_TYPES_4((_i) + 4UL), \
+				S2TTE_TYPES_4((_i) + 8UL),		\
+				S2TTE_TYPES_4((_i) + 12UL)
+#define S2TTE_TYPES_64(_i)	S2TTE_TYPES_16(_i),			\
+				S2TTE_TYPES_16((_i) + 16UL),		\
+				S2TTE_TYPES_16((_i) + 32UL),		\
+				S2TTE_TYPES_16((_i) + 48UL)
+
+static const unsigned char s2tte_types[128] = {
+	S2TTE_TYPES_64(0UL), S2TTE_TYPES_64(64UL)
+};
+
+/*
+ * Types whose s2ttes have an output address, and whose have a RIPAS. The
+ * RIPAS of a valid s2tte is read from S2AP[0], which is set for RAM and
+ * sits where the invalid s2ttes keep the RIPAS.
+ */
+static const unsigned long s2tte_type_pa_mask[] = {
+	[S2TTE_TYPE_UNASSIGNED] = 0UL,
+	[S2TTE_TYPE_ASSIGNED] = ~0UL,
+	[S2TTE_TYPE_DESTROYED] = 0UL,
+	[S2TTE_TYPE_EXPORTED] = 0UL,
+	[S2TTE_TYPE_VALID] = ~0UL,
+	[S2TTE_TYPE_VALID_NS] = ~0UL,
+	[S2TTE_TYPE_TABLE] = ~0UL,
+	[S2TTE_TYPE_INVALID] = 0UL
+};
+
+static const unsigned long s2tte_type_ripas_mask[] = {
+	[S2TTE_TYPE_UNASSIGNED] = S2TTE_INVALID_RIPAS_MASK,
+	[S2TTE_TYPE_ASSIGNED] = S2TTE_INVALID_RIPAS_MASK,
+	[S2TTE_TYPE_DESTROYED] = 0UL,
+	[S2TTE_TYPE_EXPORTED] = S2TTE_INVALID_RIPAS_MASK,
+	[S2TTE_TYPE_VALID] = S2TTE_INVALID_RIPAS_MASK,
+	[S2TTE_TYPE_VALID_NS] = 0UL,
+	[S2TTE_TYPE_TABLE] = 0UL,
+	[S2TTE_TYPE_INVALID] = 0UL
+};
+
+/*
+ * Returns the type, the RIPAS and the output address of @s2tte at @level,
+ * packed as described in table.h, with a single lookup rather than a
+ * sequence of s2tte_is_*() calls.
+ */
+unsigned long s2tte_classify(unsigned long s2tte, long level)
+{
+	unsigned long lvl = ((level >= RTT_MIN_BLOCK_LEVEL) ? 1UL : 0UL) +
+			    ((level >= RTT_PAGE_LEVEL) ? 1UL : 0UL);
+	unsigned long idx = (s2tte & DESC_TYPE_MASK) | (lvl << 2) |
+			    (((s2tte & S2TTE_NS) != 0UL) ? (1UL << 4) : 0UL) |
+			    (((s2tte >> S2TTE_INVALID_HIPAS_SHIFT) & 3UL) << 5);
+	unsigned long type = s2tte_types[idx];
+	unsigned long pa, ripas;
+
+	pa = addr_level_mask(s2tte, (type == S2TTE_TYPE_TABLE) ?
+					RTT_PAGE_LEVEL : level);
+	ripas = (s2tte & s2tte_type_ripas_mask[type]) >>
+		S2TTE_INVALID_RIPAS_SHIFT;
+
+	return (pa & s2tte_type_pa_mask[type]) |
+	       (ripas << S2TTE_CLASS_RIPAS_SHIFT) | type;
+}
+
 /*
  * Returns RIPAS of @s2tte.
  *
@@ -742,6 +1409,122 @@ void s2tt_init_valid_ns(unsigned long *s2tt, unsigned long pa, long level)
 	dsb(ish);
 }
 
+/*
+ * Scan the s2ttes of @s2tt, an RTT at @level, for the Access flag and the
+ * dirty state updated by the PE when FEAT_HAFDBS is enabled for the realm,
+ * and clear them.
+ *
+ * Bit i of @accessed, resp. @dirty, is set if the s2tte at index i has
+ * HIPAS=VALID and has been accessed, resp. written, since it was created or
+ * last scanned. Both bitmaps hold S2TTES_PER_S2TT bits.
+ *
+ * A valid s2tte is made writable-clean by setting DBM and clearing S2AP[1],
+ * so that the next write of the realm sets S2AP[1] again. S2AP[0], which
+ * encodes RIPAS=RAM, is left unchanged. The s2ttes are updated with a
+ * compare-and-swap, as the PE can update them concurrently.
+ *
+ * Returns true if any s2tte has been updated, in which case the caller must
+ * invalidate the TLB entries for the IPAs translated by @s2tt.
+ */
+bool s2tt_scan_access_dirty(unsigned long *s2tt, long level,
+			    unsigned long *accessed, unsigned long *dirty)
+{
+	bool updated = false;
+
+	(void)memset(accessed, 0, S2TTES_PER_S2TT / 8U);
+	(void)memset(dirty, 0, S2TTES_PER_S2TT / 8U);
+
+	for (unsigned int i = 0U; i < S2TTES_PER_S2TT; i++) {
+		unsigned long s2tte = s2tte_read(&s2tt[i]);
+		unsigned long old, new;
+
+		if (!s2tte_is_valid(s2tte, level)) {
+			continue;
+		}
+
+		do {
+			old = s2tte;
+			new = (old & ~(S2TTE_AF | S2TTE_AP_W)) | S2TTE_DBM;
+			if (new == old) {
+				break;
+			}
+			s2tte = atomic_cas_acquire_64((uint64_t *)&s2tt[i],
+						      old, new);
+		} while (s2tte != old);
+
+		if ((old & S2TTE_AF) != 0UL) {
+			accessed[i / BITS_PER_UL] |= 1UL << (i % BITS_PER_UL);
+		}
+		if ((old & S2TTE_AP_W) != 0UL) {
+			dirty[i / BITS_PER_UL] |= 1UL << (i % BITS_PER_UL);
+		}
+		updated = updated || (new != old);
+	}
+
+	return updated;
+}
+
+/*
+ * Scan the s2ttes of @s2tt, an RTT at @level of a realm which tracks its
+ * dirty state by write-protection, and write-protect them.
+ *
+ * Bit i of @dirty is set if the s2tte at index i has HIPAS=VALID and is
+ * writable, that is it has been written since it was created or since
+ * s2tte_set_writable() gave write access back to it after the last scan.
+ * @dirty holds S2TTES_PER_S2TT bits.
+ *
+ * The caller holds the lock of @s2tt, so the PE, which does not update the
+ * dirty state of these s2ttes, cannot race with the update.
+ *
+ * Returns true if any s2tte has been updated, in which case the caller must
+ * invalidate the TLB entries for the IPAs translated by @s2tt.
+ */
+bool s2tt_scan_dirty_wp(unsigned long *s2tt, long level, unsigned long *dirty)
+{
+	bool updated = false;
+
+	(void)memset(dirty, 0, S2TTES_PER_S2TT / 8U);
+
+	for (unsigned int i = 0U; i < S2TTES_PER_S2TT; i++) {
+		unsigned long s2tte = s2tte_read(&s2tt[i]);
+
+		if (!s2tte_is_valid(s2tte, level) ||
+		    ((s2tte & S2TTE_AP_W) == 0UL)) {
+			continue;
+		}
+
+		s2tte_write(&s2tt[i], s2tte & ~S2TTE_AP_W);
+		dirty[i / BITS_PER_UL] |= 1UL << (i % BITS_PER_UL);
+		updated = true;
+	}
+
+	return updated;
+}
+
+/*
+ * Give write access back to the s2tte at @s2ttep, at @level, on the first
+ * write of the realm after it was write-protected by s2tt_scan_dirty_wp().
+ *
+ * Returns false if the s2tte does not have HIPAS=VALID or is already
+ * writable, in which case the fault was not caused by the write-protection
+ * or the TLBs still hold the entry from before the last update.
+ */
+bool s2tte_set_writable(unsigned long *s2ttep, long level)
+{
+	unsigned long s2tte = s2tte_read(s2ttep);
+
+	if (!s2tte_is_valid(s2tte, level) || ((s2tte & S2TTE_AP_W) != 0UL)) {
+		return false;
+	}
+
+	/*
+	 * Relaxing the permissions of a valid s2tte needs neither
+	 * break-before-make nor TLB invalidation.
+	 */
+	s2tte_write(s2ttep, s2tte | S2TTE_AP_W);
+	return true;
+}
+
 /* Returns physical address of a page entry or block */
 unsigned long s2tte_pa(unsigned long s2tte, long level)
 {
@@ -764,44 +1547,40 @@ bool addr_is_level_aligned(unsigned long addr, long level)
 	return (addr == addr_level_mask(addr, level));
 }
 
-typedef bool (*s2tte_type_checker)(unsigned long s2tte);
+/* Number of s2ttes compared per iteration by table_matches() */
+#define TABLE_MATCH_CHUNK	8U
 
-static bool __table_is_uniform_block(unsigned long *table,
-			      s2tte_type_checker s2tte_is_x,
-			      enum ripas *ripas_ptr)
+/*
+ * Returns true if, for each index i, the bits in @mask of the s2tte at
+ * index i in @table are equal to those of @s2tte + (i * @inc).
+ *
+ * The differences are accumulated over TABLE_MATCH_CHUNK s2ttes before being
+ * checked, which avoids a branch per s2tte and lets the compiler use paired
+ * loads. The table must be locked by the caller, so it cannot be updated
+ * while it is being read, and plain loads can be used.
+ */
+static bool table_matches(const unsigned long *table, unsigned long s2tte,
+			  unsigned long inc, unsigned long mask)
 {
-	unsigned long s2tte = s2tte_read(&table[0]);
-	enum ripas ripas;
-	unsigned int i;
+	unsigned int i, j;
 
-	if (!s2tte_is_x(s2tte)) {
-		return false;
-	}
+	for (i = 0U; i < S2TTES_PER_S2TT; i += TABLE_MATCH_CHUNK) {
+		unsigned long diff = 0UL;
 
-	if (ripas_ptr != NULL) {
-		ripas = s2tte_get_ripas(s2tte);
-	}
-
-	for (i = 1U; i < S2TTES_PER_S2TT; i++) {
-		s2tte = s2tte_read(&table[i]);
-
-		if (!s2tte_is_x(s2tte)) {
-			return false;
+		for (j = i; j < (i + TABLE_MATCH_CHUNK); j++) {
+			diff |= table[j] ^ (s2tte + (j * inc));
 		}
 
-		if ((ripas_ptr != NULL) &&
-		    (s2tte_get_ripas(s2tte) != ripas)) {
+		if ((diff & mask) != 0UL) {
 			return false;
 		}
 	}
 
-	if (ripas_ptr != NULL) {
-		*ripas_ptr = ripas;
-	}
-
 	return true;
 }
 
+COMPILER_ASSERT((S2TTES_PER_S2TT % TABLE_MATCH_CHUNK) == 0U);
+
 /*
  * Returns true if all s2ttes in @table have HIPAS=UNASSIGNED and
  * have the same RIPAS.
@@ -810,7 +1589,17 @@ static bool __table_is_uniform_block(unsigned long *table,
  */
 bool table_is_unassigned_block(unsigned long *table, enum ripas *ripas)
 {
-	return __table_is_uniform_block(table, s2tte_is_unassigned, ripas);
+	unsigned long s2tte = s2tte_read(&table[0]);
+
+	if (!s2tte_is_unassigned(s2tte) ||
+	    !table_matches(table, s2tte, 0UL,
+			   DESC_TYPE_MASK | S2TTE_INVALID_HIPAS_MASK |
+			   S2TTE_INVALID_RIPAS_MASK)) {
+		return false;
+	}
+
+	*ripas = s2tte_get_ripas(s2tte);
+	return true;
 }
 
 /*
@@ -818,44 +1607,31 @@ bool table_is_unassigned_block(unsigned long *table, enum ripas *ripas)
  */
 bool table_is_destroyed_block(unsigned long *table)
 {
-	return __table_is_uniform_block(table, s2tte_is_destroyed, NULL);
-}
+	unsigned long s2tte = s2tte_read(&table[0]);
 
-typedef bool (*s2tte_type_level_checker)(unsigned long s2tte, long level);
+	return s2tte_is_destroyed(s2tte) &&
+	       table_matches(table, s2tte, 0UL,
+			     DESC_TYPE_MASK | S2TTE_INVALID_HIPAS_MASK);
+}
 
+/*
+ * Returns true if the s2ttes in @table are of the same type as the first
+ * one, as identified by the bits in @type_mask, and refer to a contiguous
+ * block of granules aligned to @level - 1.
+ */
 static bool __table_maps_block(unsigned long *table,
 			       long level,
-			       s2tte_type_level_checker s2tte_is_x)
+			       unsigned long type_mask)
 {
-	unsigned long base_pa;
-	unsigned long map_size = s2tte_map_size(level);
 	unsigned long s2tte = s2tte_read(&table[0]);
-	unsigned int i;
-
-	if (!s2tte_is_x(s2tte, level)) {
-		return false;
-	}
+	unsigned long pa_mask = addr_level_mask(~0UL, level);
 
-	base_pa = s2tte_pa(s2tte, level);
-	if (!addr_is_level_aligned(base_pa, level - 1L)) {
+	if (!addr_is_level_aligned(s2tte_pa(s2tte, level), level - 1L)) {
 		return false;
 	}
 
-	for (i = 1U; i < S2TTES_PER_S2TT; i++) {
-		unsigned long expected_pa = base_pa + (i * map_size);
-
-		s2tte = s2tte_read(&table[i]);
-
-		if (!s2tte_is_x(s2tte, level)) {
-			return false;
-		}
-
-		if (s2tte_pa(s2tte, level) != expected_pa) {
-			return false;
-		}
-	}
-
-	return true;
+	return table_matches(table, s2tte, s2tte_map_size((int)level),
+			     type_mask | pa_mask);
 }
 
 /*
@@ -864,7 +1640,9 @@ static bool __table_maps_block(unsigned long *table,
  */
 bool table_maps_assigned_block(unsigned long *table, long level)
 {
-	return __table_maps_block(table, level, s2tte_is_assigned);
+	return s2tte_is_assigned(s2tte_read(&table[0]), level) &&
+	       __table_maps_block(table, level,
+				  DESC_TYPE_MASK | S2TTE_INVALID_HIPAS_MASK);
 }
 
 /*
@@ -873,7 +1651,8 @@ bool table_maps_assigned_block(unsigned long *table, long level)
  */
 bool table_maps_valid_block(unsigned long *table, long level)
 {
-	return __table_maps_block(table, level, s2tte_is_valid);
+	return s2tte_is_valid(s2tte_read(&table[0]), level) &&
+	       __table_maps_block(table, level, DESC_TYPE_MASK | S2TTE_NS);
 }
 
 /*
@@ -882,5 +1661,6 @@ bool table_maps_valid_block(unsigned long *table, long level)
  */
 bool table_maps_valid_ns_block(unsigned long *table, long level)
 {
-	return __table_maps_block(table, level, s2tte_is_valid_ns);
+	return s2tte_is_valid_ns(s2tte_read(&table[0]), level) &&
+	       __table_maps_block(table, level, DESC_TYPE_MASK | S2TTE_NS);
 }
@@ -34,3 +34,28 @@ void restore_sve_state(struct sve_state *sve)
 	restore_sve_p_ffr_state(sve->p_ffr);
 	restore_sve_zcr_fpu_state(sve->zcr_fpu);
 }
+
+/*
+ * Save the part of the SVE context that can be modified by Advanced SIMD and
+ * floating-point instructions: the Z registers, which alias the V registers,
+ * and FPSR/FPCR. The P registers and FFR are only accessed by SVE
+ * instructions, so they can be left in place while only FPU/SIMD is used.
+ */
+void save_sve_simd_state(struct sve_state *sve)
+{
+	assert(sve != NULL);
+
+	save_sve_zcr_fpu_state(sve->zcr_fpu);
+	save_sve_z_state(sve->z);
+}
+
+/*
+ * Restore the context saved by save_sve_simd_state().
+ */
+void restore_sve_simd_state(struct sve_state *sve)
+{
+	assert(sve != NULL);
+
+	restore_sve_z_state(sve->z);
+	restore_sve_zcr_fpu_state(sve->zcr_fpu);
+}
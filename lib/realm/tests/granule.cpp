@@ -347,6 +347,62 @@ TEST(granule, find_granule_TC3)
 	}
 }
 
+TEST(granule, find_granule_range_TC1)
+{
+	struct granule *granule;
+	unsigned int idx = get_rand_granule_idx();
+	unsigned long address;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Get a valid range of granules and verify that the returned
+	 * granule is the one for the base address of the range.
+	 * Test the full range of granules as well as a random range
+	 * ending at the last valid granule.
+	 ***************************************************************/
+	granule = find_granule_range(host_util_get_granule_base(),
+				     test_helper_get_nr_granules());
+	POINTERS_EQUAL(get_granule_struct_base(), granule);
+
+	address = (idx * GRANULE_SIZE) + host_util_get_granule_base();
+	granule = find_granule_range(address,
+				     test_helper_get_nr_granules() - idx);
+	POINTERS_EQUAL(get_granule_struct_base() + idx, granule);
+
+	/* Single granule ranges behave as find_granule() */
+	granule = find_granule_range(address, 1UL);
+	POINTERS_EQUAL(find_granule(address), granule);
+}
+
+TEST(granule, find_granule_range_TC2)
+{
+	unsigned int idx = get_rand_granule_idx();
+	unsigned long address;
+	struct granule *granule;
+
+	/***************************************************************
+	 * TEST CASE 2:
+	 *
+	 * Try to get an invalid range of granules: an empty range, a
+	 * range with an unaligned base and a range exceeding the last
+	 * valid granule.
+	 ***************************************************************/
+	address = (idx * GRANULE_SIZE) + host_util_get_granule_base();
+
+	granule = find_granule_range(address, 0UL);
+	POINTERS_EQUAL(NULL, granule);
+
+	granule = find_granule_range(address +
+				     get_rand_in_range(1, GRANULE_SIZE - 1),
+				     1UL);
+	POINTERS_EQUAL(NULL, granule);
+
+	granule = find_granule_range(address,
+				     test_helper_get_nr_granules() - idx + 1U);
+	POINTERS_EQUAL(NULL, granule);
+}
+
 TEST(granule, find_lock_two_granules_TC1)
 {
 	int g1_index, g2_index;
@@ -599,6 +655,61 @@ TEST(granule, find_lock_two_granules_TC5)
 	 */
 }
 
+TEST(granule, find_lock_granules_TC1)
+{
+	struct granule_set granules[FIND_LOCK_GRANULES_MAX];
+	int idx[FIND_LOCK_GRANULES_MAX];
+	bool retval;
+
+	/******************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Find and lock FIND_LOCK_GRANULES_MAX valid granules given in
+	 * decreasing order of their address, with valid expected states
+	 * (GRANULE_STATE_NS). Then try again with two identical addresses.
+	 ******************************************************************/
+
+	idx[0] = get_rand_in_range((int)FIND_LOCK_GRANULES_MAX,
+				   test_helper_get_nr_granules() - 1);
+	for (unsigned int i = 1U; i < FIND_LOCK_GRANULES_MAX; i++) {
+		idx[i] = get_rand_in_range((int)(FIND_LOCK_GRANULES_MAX - i),
+					   idx[i - 1U] - 1);
+	}
+
+	for (unsigned int i = 0U; i < FIND_LOCK_GRANULES_MAX; i++) {
+		granules[i].addr = (idx[i] * GRANULE_SIZE) +
+					host_util_get_granule_base();
+		granules[i].state = GRANULE_STATE_NS;
+		granules[i].g = NULL;
+	}
+
+	retval = find_lock_granules(granules, FIND_LOCK_GRANULES_MAX);
+
+	CHECK(retval);
+	for (unsigned int i = 0U; i < FIND_LOCK_GRANULES_MAX; i++) {
+		POINTERS_EQUAL(get_granule_struct_base() + idx[i],
+			       granules[i].g);
+		CHECK_FALSE(granules[i].g->lock.val == 0);
+		granule_unlock(granules[i].g);
+		granules[i].g = NULL;
+	}
+
+	granules[2].addr = granules[0].addr;
+	retval = find_lock_granules(granules, 3U);
+
+	CHECK_FALSE(retval);
+	for (unsigned int i = 0U; i < 3U; i++) {
+		POINTERS_EQUAL(NULL, granules[i].g);
+	}
+
+	/* None of the granules was left locked */
+	for (unsigned int i = 0U; i < FIND_LOCK_GRANULES_MAX; i++) {
+		struct granule *g = get_granule_struct_base() + idx[i];
+
+		CHECK_EQUAL(0, g->lock.val);
+	}
+}
+
 TEST(granule, find_lock_granule_TC1)
 {
 	struct granule *granule;
@@ -1547,3 +1658,170 @@ TEST(granule, granule_memzero_mapped_TC1)
 	 * is a wrapper for memset, so skip this test for now.
 	 */
 }
+
+TEST(granule, granule_scrub_TC1)
+{
+	unsigned long addr = (get_rand_granule_idx() * GRANULE_SIZE) +
+					host_util_get_granule_base();
+	struct granule *granule = addr_to_granule(addr);
+	int *val = (int *)addr;
+	/* A non-zero byte, so that a granule left untouched is not zero */
+	int pattern = get_rand_in_range(1, UCHAR_MAX);
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Mark a granule as needing a scrub and verify that
+	 * granule_scrub() zeroes it. Then verify that further calls to
+	 * granule_scrub() do not modify the granule, either once it has
+	 * been scrubbed or once the mark has been cleared.
+	 ***************************************************************/
+
+	memset((void *)addr, pattern, GRANULE_SIZE);
+	granule_set_needs_scrub(granule);
+	granule_scrub(granule, SLOT_DELEGATED);
+
+	for (unsigned int i = 0; i < (GRANULE_SIZE / sizeof(int)); i++) {
+		if (*(val + i) != 0) {
+			FAIL_TEST("Memory not properly scrubbed");
+		}
+	}
+
+	memset((void *)addr, pattern, GRANULE_SIZE);
+	granule_scrub(granule, SLOT_DELEGATED);
+	CHECK(*val != 0);
+
+	granule_set_needs_scrub(granule);
+	granule_clear_needs_scrub(granule);
+	granule_scrub(granule, SLOT_DELEGATED);
+	CHECK(*val != 0);
+}
+
+TEST(granule, granule_scrub_mapped_TC1)
+{
+	unsigned long addr = (get_rand_granule_idx() * GRANULE_SIZE) +
+					host_util_get_granule_base();
+	struct granule *granule = addr_to_granule(addr);
+	int *val = (int *)addr;
+	int pattern = get_rand_in_range(1, UCHAR_MAX);
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Same as granule_scrub_TC1 with the granule already mapped.
+	 * On the host platform the granule is mapped at its PA.
+	 ***************************************************************/
+
+	memset((void *)addr, pattern, GRANULE_SIZE);
+	granule_set_needs_scrub(granule);
+	granule_scrub_mapped(granule, (void *)addr);
+
+	for (unsigned int i = 0; i < (GRANULE_SIZE / sizeof(int)); i++) {
+		if (*(val + i) != 0) {
+			FAIL_TEST("Memory not properly scrubbed");
+		}
+	}
+
+	memset((void *)addr, pattern, GRANULE_SIZE);
+	granule_scrub_mapped(granule, (void *)addr);
+	CHECK(*val != 0);
+}
+
+TEST(granule, granule_prescrub_TC1)
+{
+	unsigned long addr = (get_rand_granule_idx() * GRANULE_SIZE) +
+					host_util_get_granule_base();
+	struct granule *granule = addr_to_granule(addr);
+	int *val = (int *)addr;
+	unsigned int calls = 0U;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Mark a DELEGATED granule as needing a scrub and verify that
+	 * repeated calls to granule_prescrub() eventually zero it. The
+	 * bitmap is scanned in chunks, so allow enough calls to cover
+	 * all the granules.
+	 ***************************************************************/
+
+	granule_lock(granule, GRANULE_STATE_NS);
+	granule_set_state(granule, GRANULE_STATE_DELEGATED);
+	memset((void *)addr, get_rand_in_range(1, UCHAR_MAX), GRANULE_SIZE);
+	granule_set_needs_scrub(granule);
+	granule_unlock(granule);
+
+	while ((*val != 0) && (calls++ < (RMM_MAX_GRANULES / 64U))) {
+		granule_prescrub(64U);
+	}
+
+	for (unsigned int i = 0; i < (GRANULE_SIZE / sizeof(int)); i++) {
+		if (*(val + i) != 0) {
+			FAIL_TEST("Memory not properly pre-scrubbed");
+		}
+	}
+
+	granule_lock(granule, GRANULE_STATE_DELEGATED);
+	granule_unlock_transition(granule, GRANULE_STATE_NS);
+}
+
+TEST(granule, granule_set_preloaded_TC1)
+{
+	unsigned long addr = (get_rand_granule_idx() * GRANULE_SIZE) +
+					host_util_get_granule_base();
+	struct granule *granule = addr_to_granule(addr);
+	int *val = (int *)addr;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Mark a DELEGATED granule as preloaded and verify that
+	 * granule_prescrub() leaves its content alone, then that
+	 * granule_scrub() still zeroes it and clears the mark.
+	 ***************************************************************/
+
+	granule_lock(granule, GRANULE_STATE_NS);
+	granule_set_state(granule, GRANULE_STATE_DELEGATED);
+	memset((void *)addr, get_rand_in_range(1, UCHAR_MAX), GRANULE_SIZE);
+	granule_set_preloaded(granule);
+	CHECK_TRUE(granule_is_preloaded(granule));
+	granule_unlock(granule);
+
+	for (unsigned int i = 0U; i < (RMM_MAX_GRANULES / 64U); i++) {
+		granule_prescrub(64U);
+	}
+	CHECK(*val != 0);
+
+	granule_lock(granule, GRANULE_STATE_DELEGATED);
+	CHECK_TRUE(granule_is_preloaded(granule));
+	granule_scrub(granule, SLOT_DELEGATED);
+	CHECK(*val == 0);
+	CHECK_FALSE(granule_is_preloaded(granule));
+	granule_unlock_transition(granule, GRANULE_STATE_NS);
+}
+
+TEST(granule, granule_unlocked_state_TC1)
+{
+	unsigned long addr = (get_rand_granule_idx() * GRANULE_SIZE) +
+					host_util_get_granule_base();
+	struct granule *granule = addr_to_granule(addr);
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Verify that granule_unlocked_state() returns the state of
+	 * the granule whether or not its lock is held.
+	 ***************************************************************/
+
+	CHECK_EQUAL(GRANULE_STATE_NS, granule_unlocked_state(granule));
+
+	granule_lock(granule, GRANULE_STATE_NS);
+	granule_set_state(granule, GRANULE_STATE_DELEGATED);
+	CHECK_EQUAL(GRANULE_STATE_DELEGATED, granule_unlocked_state(granule));
+	granule_unlock(granule);
+
+	CHECK_EQUAL(GRANULE_STATE_DELEGATED, granule_unlocked_state(granule));
+
+	granule_lock(granule, GRANULE_STATE_DELEGATED);
+	granule_unlock_transition(granule, GRANULE_STATE_NS);
+	CHECK_EQUAL(GRANULE_STATE_NS, granule_unlocked_state(granule));
+}
@@ -0,0 +1,420 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+extern "C" {
+#include <buffer.h>
+#include <granule.h>
+#include <host_utils.h>
+#include <ripas.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <table.h>	/* Interface to exercise */
+#include <test_helpers.h>
+#include <time.h>
+#include <utils_def.h>
+}
+
+/*
+ * Synthetic RTT tree timed by the benchmarks, built in the first granules of
+ * the host memory for a 48-bit IPA space starting at level 0:
+ *
+ * - Granule 0 is the root RTT, whose first entry points to the level 1 RTT.
+ * - Granule 1 is the level 1 RTT, whose first BENCH_NR_L2 entries point to
+ *   the level 2 RTTs.
+ * - Granules 2 to BENCH_NR_L2 + 1 are the level 2 RTTs, whose entries all
+ *   point to level 3 RTTs.
+ * - The remaining BENCH_NR_L3 granules are the level 3 RTTs, each mapping a
+ *   2MB block with HIPAS=ASSIGNED entries.
+ *
+ * This gives BENCH_NR_ENTRIES level 3 entries covering the first
+ * BENCH_IPA_SIZE bytes of IPA space.
+ */
+#define BENCH_IPA_BITS		(48UL)
+#define BENCH_START_LEVEL	(0)
+#define BENCH_NR_L2		(4UL)
+#define BENCH_NR_L3		(BENCH_NR_L2 * S2TTES_PER_S2TT)
+#define BENCH_FIRST_L3		(BENCH_NR_L2 + 2UL)
+#define BENCH_NR_TABLES		(BENCH_FIRST_L3 + BENCH_NR_L3)
+#define BENCH_NR_ENTRIES	(BENCH_NR_L3 * S2TTES_PER_S2TT)
+#define BENCH_IPA_SIZE		(BENCH_NR_L2 * s2tte_map_size(1))
+
+/*
+ * Output address of the blocks mapped by the level 3 RTTs. The blocks are
+ * never accessed, so they do not need to be in the host memory.
+ */
+#define BENCH_BLOCK_PA		(UL(0x100000000))
+
+/* Keeps the results of the benchmarked helpers alive */
+static volatile unsigned long bench_sink;
+
+/* Scratch RTTs used by the benchmarks which overwrite whole tables */
+static unsigned long scratch[BENCH_NR_L3 * S2TTES_PER_S2TT]
+						__aligned(GRANULE_SIZE);
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_report(const char *name, unsigned long ops, uint64_t ns)
+{
+	printf("\n%-40s %10lu ops %10.1f ns/op", name, ops,
+		(double)ns / (double)ops);
+}
+
+static unsigned long tree_addr(unsigned long idx)
+{
+	return host_util_get_granule_base() + (idx * GRANULE_SIZE);
+}
+
+static unsigned long *tree_table(unsigned long idx)
+{
+	return (unsigned long *)tree_addr(idx);
+}
+
+static unsigned long *scratch_table(unsigned long idx)
+{
+	return &scratch[idx * S2TTES_PER_S2TT];
+}
+
+static void tree_build(void)
+{
+	unsigned long *l0 = tree_table(0UL);
+	unsigned long *l1 = tree_table(1UL);
+
+	s2tt_init_unassigned(l0, RMI_EMPTY);
+	s2tt_init_unassigned(l1, RMI_EMPTY);
+	l0[0] = s2tte_create_table(tree_addr(1UL), 0L);
+
+	for (unsigned long i = 0UL; i < BENCH_NR_L2; i++) {
+		unsigned long *l2 = tree_table(2UL + i);
+
+		l1[i] = s2tte_create_table(tree_addr(2UL + i), 1L);
+
+		for (unsigned long j = 0UL; j < S2TTES_PER_S2TT; j++) {
+			unsigned long l3 = (i * S2TTES_PER_S2TT) + j;
+
+			l2[j] = s2tte_create_table(
+					tree_addr(BENCH_FIRST_L3 + l3), 2L);
+			s2tt_init_assigned_empty(
+					tree_table(BENCH_FIRST_L3 + l3),
+					BENCH_BLOCK_PA + (l3 * s2tte_map_size(2)),
+					3L);
+		}
+	}
+
+	for (unsigned long i = 0UL; i < BENCH_NR_TABLES; i++) {
+		struct granule *g = find_lock_granule(tree_addr(i),
+						      GRANULE_STATE_NS);
+
+		CHECK_TRUE(g != NULL);
+		granule_unlock_transition(g, GRANULE_STATE_RTT);
+	}
+}
+
+/*
+ * Time BENCH_NR_ENTRIES walks to @level, the IPA moving by @stride after
+ * each walk.
+ */
+static void bench_walk(const char *name, long level, unsigned long stride)
+{
+	struct granule *g_root = addr_to_granule(tree_addr(0UL));
+	unsigned long ipa = 0UL;
+	struct rtt_walk wi;
+	uint64_t start;
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_ENTRIES; i++) {
+		granule_lock(g_root, GRANULE_STATE_RTT);
+		rtt_walk_lock_unlock(g_root, BENCH_START_LEVEL, BENCH_IPA_BITS,
+				     ipa, level, &wi);
+		granule_unlock(wi.g_llt);
+		ipa = (ipa + stride) % BENCH_IPA_SIZE;
+	}
+	bench_report(name, BENCH_NR_ENTRIES, now_ns() - start);
+
+	CHECK_EQUAL(level, wi.last_level);
+}
+
+TEST_GROUP(s2tt_bench) {
+	TEST_SETUP()
+	{
+		test_helper_rmm_start(false);
+		host_util_set_cpuid(0U);
+
+		tree_build();
+		rtt_walk_cache_invalidate();
+	}
+
+	TEST_TEARDOWN()
+	{
+		/* Return the RTT granules to the NS state for the next tests */
+		(void)memset((void *)addr_to_granule(tree_addr(0UL)), 0,
+			     sizeof(struct granule) * BENCH_NR_TABLES);
+		rtt_walk_cache_invalidate();
+	}
+};
+
+TEST(s2tt_bench, rtt_walk_lock_unlock_TC1)
+{
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Walk to each level at consecutive IPAs, as the Host does when
+	 * it populates a Realm. Most walks hit the RTT walk cache.
+	 ***************************************************************/
+	bench_walk("rtt_walk_lock_unlock L1 sequential", 1L, GRANULE_SIZE);
+	bench_walk("rtt_walk_lock_unlock L2 sequential", 2L, GRANULE_SIZE);
+	bench_walk("rtt_walk_lock_unlock L3 sequential", 3L, GRANULE_SIZE);
+}
+
+TEST(s2tt_bench, rtt_walk_lock_unlock_TC2)
+{
+	/***************************************************************
+	 * TEST CASE 2:
+	 *
+	 * Walk to each level with each IPA in a different 2MB block, so
+	 * that no walk hits the RTT walk cache.
+	 ***************************************************************/
+	const unsigned long stride = s2tte_map_size(2) + GRANULE_SIZE;
+
+	bench_walk("rtt_walk_lock_unlock L1 scattered", 1L, stride);
+	bench_walk("rtt_walk_lock_unlock L2 scattered", 2L, stride);
+	bench_walk("rtt_walk_lock_unlock L3 scattered", 3L, stride);
+}
+
+TEST(s2tt_bench, s2tt_init_TC1)
+{
+	uint64_t start;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Initialize BENCH_NR_L3 level 3 RTTs with each type of s2tte.
+	 ***************************************************************/
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		s2tt_init_unassigned(scratch_table(i), RMI_RAM);
+	}
+	bench_report("s2tt_init_unassigned", BENCH_NR_L3, now_ns() - start);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		s2tt_init_destroyed(scratch_table(i));
+	}
+	bench_report("s2tt_init_destroyed", BENCH_NR_L3, now_ns() - start);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		s2tt_init_assigned_empty(scratch_table(i),
+				BENCH_BLOCK_PA + (i * s2tte_map_size(2)), 3L);
+	}
+	bench_report("s2tt_init_assigned_empty", BENCH_NR_L3,
+		     now_ns() - start);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		s2tt_init_valid(scratch_table(i),
+				BENCH_BLOCK_PA + (i * s2tte_map_size(2)), 3L);
+	}
+	bench_report("s2tt_init_valid", BENCH_NR_L3, now_ns() - start);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		s2tt_init_valid_ns(scratch_table(i),
+				BENCH_BLOCK_PA + (i * s2tte_map_size(2)), 3L);
+	}
+	bench_report("s2tt_init_valid_ns", BENCH_NR_L3, now_ns() - start);
+}
+
+TEST(s2tt_bench, table_is_unassigned_block_TC1)
+{
+	unsigned long matches = 0UL;
+	enum ripas ripas;
+	uint64_t start;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Check BENCH_NR_L3 level 3 RTTs which can all be folded, so
+	 * that every s2tte is compared.
+	 ***************************************************************/
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		s2tt_init_unassigned(scratch_table(i), RMI_RAM);
+	}
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		if (table_is_unassigned_block(scratch_table(i), &ripas)) {
+			matches++;
+		}
+	}
+	bench_report("table_is_unassigned_block", BENCH_NR_L3,
+		     now_ns() - start);
+
+	CHECK_EQUAL(BENCH_NR_L3, matches);
+	CHECK_TRUE(ripas == RMI_RAM);
+}
+
+TEST(s2tt_bench, table_maps_assigned_block_TC1)
+{
+	unsigned long matches = 0UL;
+	uint64_t start;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Check the level 3 RTTs of the tree, which all map a 2MB block
+	 * and can be folded.
+	 ***************************************************************/
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		if (table_maps_assigned_block(
+				tree_table(BENCH_FIRST_L3 + i), 3L)) {
+			matches++;
+		}
+	}
+	bench_report("table_maps_assigned_block", BENCH_NR_L3,
+		     now_ns() - start);
+
+	CHECK_EQUAL(BENCH_NR_L3, matches);
+}
+
+TEST(s2tt_bench, s2tte_create_TC1)
+{
+	unsigned long acc = 0UL;
+	uint64_t start;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Create BENCH_NR_ENTRIES level 3 s2ttes of each type.
+	 ***************************************************************/
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_ENTRIES; i++) {
+		acc ^= s2tte_create_unassigned(
+				((i & 1UL) != 0UL) ? RMI_RAM : RMI_EMPTY);
+	}
+	bench_report("s2tte_create_unassigned", BENCH_NR_ENTRIES,
+		     now_ns() - start);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_ENTRIES; i++) {
+		acc ^= s2tte_create_assigned_empty(
+				BENCH_BLOCK_PA + (i * GRANULE_SIZE), 3L);
+	}
+	bench_report("s2tte_create_assigned_empty", BENCH_NR_ENTRIES,
+		     now_ns() - start);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_ENTRIES; i++) {
+		acc ^= s2tte_create_valid(
+				BENCH_BLOCK_PA + (i * GRANULE_SIZE), 3L);
+	}
+	bench_report("s2tte_create_valid", BENCH_NR_ENTRIES,
+		     now_ns() - start);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_ENTRIES; i++) {
+		acc ^= s2tte_create_table(
+				BENCH_BLOCK_PA + (i * GRANULE_SIZE), 2L);
+	}
+	bench_report("s2tte_create_table", BENCH_NR_ENTRIES,
+		     now_ns() - start);
+
+	bench_sink = acc;
+}
+
+TEST(s2tt_bench, s2tte_is_TC1)
+{
+	unsigned long count = 0UL;
+	uint64_t start;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Check the type of the BENCH_NR_ENTRIES s2ttes of the level 3
+	 * RTTs of the tree, which are all HIPAS=ASSIGNED.
+	 ***************************************************************/
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		const unsigned long *l3 = tree_table(BENCH_FIRST_L3 + i);
+
+		for (unsigned long j = 0UL; j < S2TTES_PER_S2TT; j++) {
+			if (s2tte_is_assigned(l3[j], 3L)) {
+				count++;
+			}
+		}
+	}
+	bench_report("s2tte_is_assigned", BENCH_NR_ENTRIES, now_ns() - start);
+	CHECK_EQUAL(BENCH_NR_ENTRIES, count);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		const unsigned long *l3 = tree_table(BENCH_FIRST_L3 + i);
+
+		for (unsigned long j = 0UL; j < S2TTES_PER_S2TT; j++) {
+			if (s2tte_is_unassigned(l3[j]) ||
+			    s2tte_is_destroyed(l3[j])) {
+				count++;
+			}
+		}
+	}
+	bench_report("s2tte_is_unassigned + is_destroyed", BENCH_NR_ENTRIES,
+		     now_ns() - start);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		const unsigned long *l3 = tree_table(BENCH_FIRST_L3 + i);
+
+		for (unsigned long j = 0UL; j < S2TTES_PER_S2TT; j++) {
+			if (s2tte_is_valid(l3[j], 3L) ||
+			    s2tte_is_valid_ns(l3[j], 3L)) {
+				count++;
+			}
+		}
+	}
+	bench_report("s2tte_is_valid + is_valid_ns", BENCH_NR_ENTRIES,
+		     now_ns() - start);
+
+	/* None of the s2ttes is UNASSIGNED, DESTROYED, VALID or VALID_NS */
+	CHECK_EQUAL(BENCH_NR_ENTRIES, count);
+}
+
+TEST(s2tt_bench, s2tte_classify_TC1)
+{
+	unsigned long count = 0UL;
+	uint64_t start;
+
+	/***************************************************************
+	 * TEST CASE 1:
+	 *
+	 * Classify the BENCH_NR_ENTRIES s2ttes of the level 3 RTTs of
+	 * the tree with a single lookup each, to be compared with the
+	 * s2tte_is_*() chains of s2tte_is_TC1.
+	 ***************************************************************/
+	start = now_ns();
+	for (unsigned long i = 0UL; i < BENCH_NR_L3; i++) {
+		const unsigned long *l3 = tree_table(BENCH_FIRST_L3 + i);
+
+		for (unsigned long j = 0UL; j < S2TTES_PER_S2TT; j++) {
+			unsigned long cls = s2tte_classify(l3[j], 3L);
+
+			if (s2tte_class_type(cls) == S2TTE_TYPE_ASSIGNED) {
+				count++;
+			}
+			bench_sink = s2tte_class_pa(cls);
+		}
+	}
+	bench_report("s2tte_classify", BENCH_NR_ENTRIES, now_ns() - start);
+	CHECK_EQUAL(BENCH_NR_ENTRIES, count);
+}
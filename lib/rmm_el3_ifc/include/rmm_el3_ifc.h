@@ -10,6 +10,7 @@
 
 #include <arch_helpers.h>
 #include <sizes.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <utils_def.h>
@@ -54,16 +55,28 @@ int rmm_el3_ifc_init(unsigned long x0, unsigned long x1, unsigned long x2,
  * If the validation fails it will call into EL3 and will not return
  * to the caller.
  *
+ * On cold boot, the CPU Id is checked against MAX_CPUS. On warm boot, it is
+ * checked against the number of CPUs reported by EL3, as only these have a
+ * per-CPU area.
+ *
  * Args:
  *	- x0: CPU Id received from EL3.
+ *	- x1: Non-zero on cold boot.
  * Return:
  *	- Validated CPU Id or will not return on an error.
  */
-unsigned int rmm_el3_ifc_validate_cpuid(unsigned long x0);
+unsigned int rmm_el3_ifc_validate_cpuid(unsigned long x0,
+					unsigned long is_cold_boot);
+
+/*
+ * Return the number of CPUs in the system as reported by EL3 at boot.
+ */
+unsigned long rmm_el3_ifc_get_num_cpus(void);
 
 /*
  * Return a pointer to the RMM <-> EL3 shared pointer and lock it to prevent
- * concurrent access.
+ * concurrent access. When per-CPU shared buffers are in use, the buffer of
+ * the current CPU is returned and no lock is needed.
  *
  * Return:	Exclusive pointer to the RMM <-> EL3 shared area.
  */
@@ -78,14 +91,61 @@ void rmm_el3_ifc_release_shared_buf(void);
  * Boot Manifest functions and structures.
  ****************************************************************************/
 
-/* Boot manifest core structure as per v0.1 */
+/* DRAM bank structure as per v0.2 */
+struct rmm_dram_bank {
+	uintptr_t base;		/* Base address of the bank */
+	uint64_t size;		/* Size of the bank */
+};
+
+/* DRAM layout structure as per v0.2 */
+struct rmm_dram_info {
+	uint64_t num_banks;		/* Number of DRAM banks */
+	struct rmm_dram_bank *banks;	/* PA of the array of banks */
+	uint64_t checksum;		/* Checksum of the DRAM layout */
+};
+
+/* Per-CPU RMM <-> EL3 shared buffers structure as per v0.3 */
+struct rmm_cpu_bufs_info {
+	uint64_t num_bufs;		/* Number of 4KB buffers */
+	uintptr_t base;			/* PA of the buffer of CPU 0 */
+};
+
+/* NUMA node structure as per v0.4 */
+struct rmm_numa_node {
+	uintptr_t dram_base;	/* Base address of the DRAM of the node */
+	uint64_t dram_size;	/* Size of the DRAM of the node */
+	uintptr_t rmm_base;	/* PA of the RMM memory local to the node */
+	uint64_t rmm_size;	/* Size of the RMM memory local to the node */
+};
+
+/* NUMA layout structure as per v0.4 */
+struct rmm_numa_info {
+	uint64_t num_nodes;		/* Number of NUMA nodes */
+	struct rmm_numa_node *nodes;	/* PA of the array of nodes */
+	uint64_t checksum;		/* Checksum of the NUMA layout */
+};
+
+/* Boot manifest core structure as per v0.4 */
 struct rmm_core_manifest {
-	uint32_t version;	/* Manifest version */
-	uintptr_t plat_data;	/* Manifest platform data */
+	uint32_t version;		/* Manifest version */
+	uintptr_t plat_data;		/* Manifest platform data */
+	struct rmm_dram_info plat_dram;	/* Platform DRAM layout (v0.2) */
+	struct rmm_cpu_bufs_info cpu_bufs; /* Per-CPU shared buffers (v0.3) */
+	struct rmm_numa_info numa;	/* NUMA layout (v0.4) */
 };
 
 COMPILER_ASSERT(offsetof(struct rmm_core_manifest, version) == 0);
 COMPILER_ASSERT(offsetof(struct rmm_core_manifest, plat_data) == 8);
+COMPILER_ASSERT(offsetof(struct rmm_core_manifest, plat_dram) == 16);
+COMPILER_ASSERT(offsetof(struct rmm_dram_info, banks) == 8);
+COMPILER_ASSERT(offsetof(struct rmm_dram_info, checksum) == 16);
+COMPILER_ASSERT(sizeof(struct rmm_dram_bank) == 16);
+COMPILER_ASSERT(offsetof(struct rmm_core_manifest, cpu_bufs) == 40);
+COMPILER_ASSERT(offsetof(struct rmm_cpu_bufs_info, base) == 8);
+COMPILER_ASSERT(offsetof(struct rmm_core_manifest, numa) == 56);
+COMPILER_ASSERT(offsetof(struct rmm_numa_info, nodes) == 8);
+COMPILER_ASSERT(offsetof(struct rmm_numa_info, checksum) == 16);
+COMPILER_ASSERT(sizeof(struct rmm_numa_node) == 32);
 
 /*
  * Accessors to the Boot Manifest data.
@@ -102,6 +162,66 @@ unsigned int rmm_el3_ifc_get_manifest_version(void);
  */
 uintptr_t rmm_el3_ifc_get_plat_manifest_pa(void);
 
+/*
+ * Return a pointer to the DRAM layout received through the Boot Manifest.
+ *
+ * The layout is only present from Boot Manifest v0.2. It is validated
+ * against its checksum and its array of banks must lie in the RMM <-> EL3
+ * shared area. The same restrictions as rmm_el3_ifc_get_plat_manifest_pa()
+ * apply to this call.
+ *
+ * Return:
+ *	- 0 on success, with *info pointing to the DRAM layout.
+ *	- -ENOENT if EL3 did not provide a DRAM layout.
+ *	- -EINVAL if the DRAM layout is malformed.
+ */
+int rmm_el3_ifc_get_dram_info(struct rmm_dram_info **info);
+
+/*
+ * Return the per-CPU RMM <-> EL3 shared buffers received through the Boot
+ * Manifest. The N-th CPU uses the 4KB buffer at @base + (N * SZ_4K).
+ *
+ * The buffers are only present from Boot Manifest v0.3. There must be one
+ * for each of the CPUs reported by EL3. The same restrictions as
+ * rmm_el3_ifc_get_plat_manifest_pa() apply to this call.
+ *
+ * Return:
+ *	- 0 on success, with the PA of the first buffer in *base and the
+ *	  number of buffers in *num_bufs.
+ *	- -ENOENT if EL3 did not provide per-CPU buffers.
+ *	- -EINVAL if the buffers are malformed.
+ */
+int rmm_el3_ifc_get_cpu_bufs_info(uintptr_t *base, uint64_t *num_bufs);
+
+/*
+ * Return a pointer to the NUMA layout received through the Boot Manifest.
+ * Each node describes the range of PAs of its DRAM, which the DRAM banks of
+ * the node lie in, and a range of memory local to the node which EL3 has
+ * reserved for the RMM.
+ *
+ * The layout is only present from Boot Manifest v0.4. It is validated
+ * against its checksum and its array of nodes must lie in the RMM <-> EL3
+ * shared area. The same restrictions as rmm_el3_ifc_get_plat_manifest_pa()
+ * apply to this call.
+ *
+ * Return:
+ *	- 0 on success, with *info pointing to the NUMA layout.
+ *	- -ENOENT if EL3 did not provide a NUMA layout.
+ *	- -EINVAL if the NUMA layout is malformed.
+ */
+int rmm_el3_ifc_get_numa_info(struct rmm_numa_info **info);
+
+/*
+ * Use the per-CPU RMM <-> EL3 shared buffers, mapped by the platform at
+ * @va, for the runtime calls to EL3 instead of the global shared buffer.
+ * rmm_el3_ifc_get_shared_buf_locked() then returns the buffer of the
+ * calling CPU without taking any lock.
+ *
+ * This function must be called only once during cold boot, before the MMU
+ * is enabled.
+ */
+void rmm_el3_ifc_set_cpu_bufs(uintptr_t base, uintptr_t va);
+
 /****************************************************************************
  * RMM-EL3 Runtime APIs
  ***************************************************************************/
@@ -146,6 +266,46 @@ int rmm_el3_ifc_get_realm_attest_key(uintptr_t buf, size_t buflen,
 int rmm_el3_ifc_get_platform_token(uintptr_t buf, size_t buflen,
 				   size_t *len, size_t hash_size);
 
+/*
+ * Maximum number of granule addresses that can be passed to EL3 on a single
+ * call to rmm_el3_ifc_gpt_mark_list().
+ */
+#define RMM_EL3_IFC_GPT_LIST_MAX					\
+		(rmm_el3_ifc_get_shared_buf_size() / sizeof(unsigned long))
+
+/*
+ * Request EL3 to change the GPT PAS of a contiguous range of granules.
+ *
+ * Args:
+ *	- secure:	If true, the granules are transitioned to Realm PAS.
+ *			Otherwise they are transitioned to Non-secure PAS.
+ *	- base:		Granule aligned PA of the first granule of the range.
+ *	- count:	Number of granules in the range.
+ *
+ * Return:
+ *	- 0 On success or a negative error code otherwise.
+ */
+int rmm_el3_ifc_gpt_mark_range(bool secure, unsigned long base,
+			       unsigned long count);
+
+/*
+ * Request EL3 to change the GPT PAS of a list of granules. The list is
+ * passed to EL3 through the RMM-EL3 shared memory, which is locked for the
+ * duration of the call.
+ *
+ * Args:
+ *	- secure:	If true, the granules are transitioned to Realm PAS.
+ *			Otherwise they are transitioned to Non-secure PAS.
+ *	- addrs:	Array of granule aligned PAs.
+ *	- count:	Number of entries in @addrs. It must be at most
+ *			RMM_EL3_IFC_GPT_LIST_MAX.
+ *
+ * Return:
+ *	- 0 On success or a negative error code otherwise.
+ */
+int rmm_el3_ifc_gpt_mark_list(bool secure, const unsigned long *addrs,
+			      unsigned long count);
+
 #endif /* __ASSEMBLER__ */
 
 /*************************************
@@ -155,6 +315,12 @@ int rmm_el3_ifc_get_platform_token(uintptr_t buf, size_t buflen,
 #define SMC_RMM_GET_REALM_ATTEST_KEY	SMC64_STD_FID(RMM_EL3, U(2))
 #define SMC_RMM_GET_PLAT_TOKEN	SMC64_STD_FID(RMM_EL3, U(3))
 
+					/* 0x1B4 - 0x1B7 */
+#define SMC_RMM_GPT_MARK_SECURE_RANGE		SMC64_STD_FID(RMM_EL3, U(4))
+#define SMC_RMM_GPT_MARK_NONSECURE_RANGE	SMC64_STD_FID(RMM_EL3, U(5))
+#define SMC_RMM_GPT_MARK_SECURE_LIST		SMC64_STD_FID(RMM_EL3, U(6))
+#define SMC_RMM_GPT_MARK_NONSECURE_LIST		SMC64_STD_FID(RMM_EL3, U(7))
+
 					/* 0x1CF */
 #define SMC_RMM_BOOT_COMPLETE		SMC64_STD_FID(RMM_EL3, U(0x1F))
 
@@ -209,7 +375,7 @@ int rmm_el3_ifc_get_platform_token(uintptr_t buf, size_t buflen,
  * The Minor version value for the Boot Manifest supported by this
  * implementation of RMM.
  */
-#define RMM_EL3_MANIFEST_VERS_MINOR	(U(1))
+#define RMM_EL3_MANIFEST_VERS_MINOR	(U(4))
 
 #define RMM_EL3_MANIFEST_GET_VERS_MAJOR					\
 				RMM_EL3_IFC_GET_VERS_MAJOR
@@ -15,6 +15,8 @@
 /* Boot Interface arguments */
 static uintptr_t rmm_shared_buffer_start_pa;
 static unsigned long rmm_el3_ifc_abi_version;
+/* Also read by rmm_el3_ifc_validate_cpuid() on warm boot, with the MMU off */
+unsigned long rmm_el3_ifc_num_cpus;
 
 /* Platform paramters */
 uintptr_t rmm_shared_buffer_start_va;
@@ -91,6 +93,7 @@ int rmm_el3_ifc_init(unsigned long x0, unsigned long x1, unsigned long x2,
 	}
 
 	rmm_el3_ifc_abi_version = x1;
+	rmm_el3_ifc_num_cpus = x2;
 	rmm_shared_buffer_start_pa = (uintptr_t)x3;
 	rmm_shared_buffer_start_va = shared_buf_va;
 
@@ -100,6 +103,8 @@ int rmm_el3_ifc_init(unsigned long x0, unsigned long x1, unsigned long x2,
 			 sizeof(rmm_shared_buffer_start_pa));
 	flush_dcache_range((uintptr_t)(void *)&rmm_el3_ifc_abi_version,
 			 sizeof(rmm_el3_ifc_abi_version));
+	flush_dcache_range((uintptr_t)(void *)&rmm_el3_ifc_num_cpus,
+			 sizeof(rmm_el3_ifc_num_cpus));
 	flush_dcache_range((uintptr_t)(void *)&rmm_shared_buffer_start_va,
 			 sizeof(rmm_shared_buffer_start_va));
 	flush_dcache_range((uintptr_t)(void *)&initialized, sizeof(bool));
@@ -121,6 +126,13 @@ uintptr_t rmm_el3_ifc_get_shared_buf_pa(void)
 }
 
 /* Get the raw value of the boot interface version */
+unsigned long rmm_el3_ifc_get_num_cpus(void)
+{
+	assert(initialized == true);
+
+	return rmm_el3_ifc_num_cpus;
+}
+
 unsigned int rmm_el3_ifc_get_version(void)
 {
 	assert(initialized == true);
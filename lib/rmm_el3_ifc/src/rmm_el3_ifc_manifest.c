@@ -6,7 +6,10 @@
 #include <arch_helpers.h>
 #include <assert.h>
 #include <debug.h>
+#include <errno.h>
 #include <rmm_el3_ifc.h>
+#include <rmm_el3_ifc_priv.h>
+#include <sizes.h>
 #include <smc.h>
 #include <stdint.h>
 #include <string.h>
@@ -71,3 +74,134 @@ uintptr_t rmm_el3_ifc_get_plat_manifest_pa(void)
 
 	return local_core_manifest.plat_data;
 }
+
+/* Return true if the received manifest is at least version 0.@minor */
+static bool manifest_has_minor(unsigned int minor)
+{
+	return (RMM_EL3_MANIFEST_GET_VERS_MAJOR(local_core_manifest.version) !=
+								U(0)) ||
+	       (RMM_EL3_MANIFEST_GET_VERS_MINOR(local_core_manifest.version) >=
+								minor);
+}
+
+/* Size of the core manifest for the version received */
+static size_t manifest_size(void)
+{
+	if (manifest_has_minor(U(4))) {
+		return sizeof(struct rmm_core_manifest);
+	}
+
+	return manifest_has_minor(U(3)) ?
+			offsetof(struct rmm_core_manifest, numa) :
+			offsetof(struct rmm_core_manifest, cpu_bufs);
+}
+
+/*
+ * Return true if the array of @num elements of @size bytes at @addr, which
+ * is referenced by the manifest, follows it in the shared area.
+ */
+static bool manifest_array_valid(uintptr_t addr, uint64_t num, size_t size)
+{
+	uintptr_t shared_buf = rmm_el3_ifc_get_shared_buf_pa();
+	uintptr_t shared_end = shared_buf + rmm_el3_ifc_get_shared_buf_size();
+
+	return ALIGNED(addr, sizeof(uint64_t)) &&
+	       (addr >= (shared_buf + manifest_size())) &&
+	       (addr < shared_end) &&
+	       (num <= ((shared_end - addr) / size));
+}
+
+int rmm_el3_ifc_get_dram_info(struct rmm_dram_info **info)
+{
+	struct rmm_dram_info *dram = &local_core_manifest.plat_dram;
+	uintptr_t banks = (uintptr_t)dram->banks;
+	uint64_t checksum;
+
+	assert((manifest_processed == true) && (is_mmu_enabled() == false));
+	assert(info != NULL);
+
+	if (!manifest_has_minor(U(2))) {
+		return -ENOENT;
+	}
+
+	if (dram->num_banks == 0UL) {
+		return -ENOENT;
+	}
+
+	/* The array of banks must follow the manifest in the shared area */
+	if (!manifest_array_valid(banks, dram->num_banks,
+				  sizeof(struct rmm_dram_bank))) {
+		return -EINVAL;
+	}
+
+	/* The sum of all the fields, including the checksum, must be zero */
+	checksum = dram->num_banks + (uint64_t)banks + dram->checksum;
+	for (uint64_t i = 0UL; i < dram->num_banks; i++) {
+		checksum += dram->banks[i].base + dram->banks[i].size;
+	}
+
+	if (checksum != 0UL) {
+		return -EINVAL;
+	}
+
+	*info = dram;
+	return 0;
+}
+
+int rmm_el3_ifc_get_cpu_bufs_info(uintptr_t *base, uint64_t *num_bufs)
+{
+	struct rmm_cpu_bufs_info *bufs = &local_core_manifest.cpu_bufs;
+
+	assert((manifest_processed == true) && (is_mmu_enabled() == false));
+	assert((base != NULL) && (num_bufs != NULL));
+
+	if (!manifest_has_minor(U(3)) || (bufs->num_bufs == 0UL)) {
+		return -ENOENT;
+	}
+
+	if ((bufs->base == 0UL) || !ALIGNED(bufs->base, SZ_4K) ||
+	    (bufs->num_bufs < rmm_el3_ifc_get_num_cpus()) ||
+	    (bufs->num_bufs > MAX_CPUS)) {
+		return -EINVAL;
+	}
+
+	*base = bufs->base;
+	*num_bufs = bufs->num_bufs;
+	return 0;
+}
+
+int rmm_el3_ifc_get_numa_info(struct rmm_numa_info **info)
+{
+	struct rmm_numa_info *numa = &local_core_manifest.numa;
+	uintptr_t nodes = (uintptr_t)numa->nodes;
+	uint64_t checksum;
+
+	assert((manifest_processed == true) && (is_mmu_enabled() == false));
+	assert(info != NULL);
+
+	if (!manifest_has_minor(U(4)) || (numa->num_nodes == 0UL)) {
+		return -ENOENT;
+	}
+
+	/* The array of nodes must follow the manifest in the shared area */
+	if (!manifest_array_valid(nodes, numa->num_nodes,
+				  sizeof(struct rmm_numa_node))) {
+		return -EINVAL;
+	}
+
+	/* The sum of all the fields, including the checksum, must be zero */
+	checksum = numa->num_nodes + (uint64_t)nodes + numa->checksum;
+	for (uint64_t i = 0UL; i < numa->num_nodes; i++) {
+		const struct rmm_numa_node *node = &numa->nodes[i];
+
+		checksum += node->dram_base + node->dram_size +
+			    node->rmm_base + node->rmm_size;
+	}
+
+	if (checksum != 0UL) {
+		return -EINVAL;
+	}
+
+	*info = numa;
+	return 0;
+}
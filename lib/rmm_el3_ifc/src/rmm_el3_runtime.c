@@ -3,7 +3,9 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <arch_helpers.h>
 #include <assert.h>
+#include <cpuid.h>
 #include <debug.h>
 #include <rmm_el3_ifc.h>
 #include <sizes.h>
@@ -12,6 +14,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <xlat_defs.h>
 
 /* Platform parameter */
@@ -20,11 +23,38 @@ extern uintptr_t rmm_shared_buffer_start_va;
 /* Spinlock used to protect the EL3<->RMM shared area */
 static spinlock_t shared_area_lock = {0U};
 
+/*
+ * PA and VA of the per-CPU shared buffer of CPU 0, if EL3 provided them.
+ * Otherwise, all the CPUs share the global buffer.
+ */
+static uintptr_t cpu_bufs_pa;
+static uintptr_t cpu_bufs_va;
+
+void rmm_el3_ifc_set_cpu_bufs(uintptr_t base, uintptr_t va)
+{
+	assert(is_mmu_enabled() == false);
+	assert(cpu_bufs_va == 0UL);
+	assert(((base | va) & PAGE_SIZE_MASK) == 0UL);
+	assert(va != 0UL);
+
+	cpu_bufs_pa = base;
+	cpu_bufs_va = va;
+
+	flush_dcache_range((uintptr_t)(void *)&cpu_bufs_pa,
+			   sizeof(cpu_bufs_pa));
+	flush_dcache_range((uintptr_t)(void *)&cpu_bufs_va,
+			   sizeof(cpu_bufs_va));
+}
+
 /*
  * Get and lock a pointer to the start of the RMM<->EL3 shared buffer.
  */
 uintptr_t rmm_el3_ifc_get_shared_buf_locked(void)
 {
+	if (cpu_bufs_va != 0UL) {
+		return cpu_bufs_va + ((uintptr_t)my_cpuid() * SZ_4K);
+	}
+
 	spinlock_acquire(&shared_area_lock);
 
 	return rmm_shared_buffer_start_va;
@@ -35,9 +65,36 @@ uintptr_t rmm_el3_ifc_get_shared_buf_locked(void)
  */
 void rmm_el3_ifc_release_shared_buf(void)
 {
+	if (cpu_bufs_va != 0UL) {
+		return;
+	}
+
 	spinlock_release(&shared_area_lock);
 }
 
+/*
+ * Return the PA of @buflen bytes at @buf, which must be in the shared buffer
+ * returned by rmm_el3_ifc_get_shared_buf_locked().
+ */
+static unsigned long shared_buf_pa(uintptr_t buf, size_t buflen)
+{
+	uintptr_t start_va = rmm_shared_buffer_start_va;
+	uintptr_t start_pa = rmm_el3_ifc_get_shared_buf_pa();
+	unsigned long offset;
+
+	if (cpu_bufs_va != 0UL) {
+		start_va = cpu_bufs_va + ((uintptr_t)my_cpuid() * SZ_4K);
+		start_pa = cpu_bufs_pa + ((uintptr_t)my_cpuid() * SZ_4K);
+	}
+
+	offset = (unsigned long)(buf - start_va);
+
+	assert((offset + buflen) <= rmm_el3_ifc_get_shared_buf_size());
+	assert((buf & ~PAGE_SIZE_MASK) == start_va);
+
+	return (unsigned long)start_pa + offset;
+}
+
 /*
  * Get the realm attestation key to sign the realm attestation token. It is
  * expected that only the private key is retrieved in raw format.
@@ -46,14 +103,7 @@ int rmm_el3_ifc_get_realm_attest_key(uintptr_t buf, size_t buflen,
 				     size_t *len, unsigned int crv)
 {
 	struct smc_result smc_res;
-	unsigned long buffer_pa;
-	unsigned long offset =
-		(unsigned long)(buf - rmm_shared_buffer_start_va);
-
-	assert((offset + buflen) <= rmm_el3_ifc_get_shared_buf_size());
-	assert((buf & ~PAGE_SIZE_MASK) == rmm_shared_buffer_start_va);
-
-	buffer_pa = (unsigned long)rmm_el3_ifc_get_shared_buf_pa() + offset;
+	unsigned long buffer_pa = shared_buf_pa(buf, buflen);
 
 	monitor_call_with_res(SMC_RMM_GET_REALM_ATTEST_KEY,
 			      buffer_pa,
@@ -79,15 +129,7 @@ int rmm_el3_ifc_get_platform_token(uintptr_t buf, size_t buflen,
 				   size_t *len, size_t hash_size)
 {
 	struct smc_result smc_res;
-	unsigned long buffer_pa;
-	unsigned long offset =
-		(unsigned long)(buf - rmm_shared_buffer_start_va);
-
-	assert((offset + buflen) <= rmm_el3_ifc_get_shared_buf_size());
-	assert((buf & ~PAGE_SIZE_MASK) == rmm_shared_buffer_start_va);
-
-	buffer_pa = (unsigned long)rmm_el3_ifc_get_shared_buf_pa() + offset;
-	/* Get the available space on the buffer after the offset */
+	unsigned long buffer_pa = shared_buf_pa(buf, buflen);
 
 	monitor_call_with_res(SMC_RMM_GET_PLAT_TOKEN,
 			      buffer_pa,
@@ -105,3 +147,46 @@ int rmm_el3_ifc_get_platform_token(uintptr_t buf, size_t buflen,
 
 	return smc_res.x[0];
 }
+
+/*
+ * Request EL3 to change the GPT PAS of a contiguous range of granules.
+ */
+int rmm_el3_ifc_gpt_mark_range(bool secure, unsigned long base,
+			       unsigned long count)
+{
+	unsigned long fid = (secure ? SMC_RMM_GPT_MARK_SECURE_RANGE :
+				      SMC_RMM_GPT_MARK_NONSECURE_RANGE);
+
+	assert(count != 0UL);
+
+	return (int)monitor_call(fid, base, count, 0UL, 0UL, 0UL, 0UL);
+}
+
+/*
+ * Request EL3 to change the GPT PAS of a list of granules passed through
+ * the RMM-EL3 shared area.
+ */
+int rmm_el3_ifc_gpt_mark_list(bool secure, const unsigned long *addrs,
+			      unsigned long count)
+{
+	unsigned long fid = (secure ? SMC_RMM_GPT_MARK_SECURE_LIST :
+				      SMC_RMM_GPT_MARK_NONSECURE_LIST);
+	uintptr_t buf;
+	int ret;
+
+	assert(addrs != NULL);
+	assert((count != 0UL) && (count <= RMM_EL3_IFC_GPT_LIST_MAX));
+
+	buf = rmm_el3_ifc_get_shared_buf_locked();
+
+	(void)memcpy((void *)buf, (const void *)addrs,
+		     count * sizeof(unsigned long));
+
+	ret = (int)monitor_call(fid,
+				shared_buf_pa(buf, count * sizeof(unsigned long)),
+				count, 0UL, 0UL, 0UL, 0UL);
+
+	rmm_el3_ifc_release_shared_buf();
+
+	return ret;
+}
@@ -73,7 +73,7 @@
 #define SMC64_PSCI_FNUM_MAX	(U(0x14))
 
 #define SMC64_RMI_FNUM_MIN	(U(0x150))
-#define SMC64_RMI_FNUM_MAX	(U(0x169))
+#define SMC64_RMI_FNUM_MAX	(U(0x18E))
 
 #define SMC64_RSI_FNUM_MIN	(U(0x190))
 #define SMC64_RSI_FNUM_MAX	(U(0x1AF))
@@ -181,6 +181,23 @@ struct smc_result {
 	unsigned long x[SMC_RESULT_REGS];
 };
 
+/*
+ * Registers X0-X17 of an RMI call, which SMCCC v1.2 allows in both
+ * directions. handle_ns_smc() is called with X0-X3 zeroed and X4-X17 holding
+ * the registers of the call, which must be preserved unless they hold
+ * results. X0-X16 are returned to the Host, as SMC_RMM_REQ_COMPLETE takes X0.
+ */
+#define SMC_EXT_REGS		18U
+
+/* Arguments X1-X17 of an RMI call with the extended calling convention */
+#define SMC_EXT_ARGS		(SMC_EXT_REGS - 1U)
+
+union smc_regs {
+	unsigned long x[SMC_EXT_REGS];
+	/* X0-X4, as returned by the handlers of most RMI calls */
+	struct smc_result res;
+};
+
 void monitor_call_with_res(unsigned long id,
 			   unsigned long arg0,
 			   unsigned long arg1,
@@ -10,6 +10,9 @@ struct rec;
 struct rmi_rec_exit;
 
 bool check_pending_timers(struct rec *rec);
+bool inject_pending_timers(struct rec *rec);
 void report_timer_state_to_ns(struct rmi_rec_exit *rec_exit);
+void report_saved_timer_state_to_ns(struct rec *rec,
+				    struct rmi_rec_exit *rec_exit);
 
 #endif /* TIMERS_H */
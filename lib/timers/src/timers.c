@@ -21,6 +21,13 @@
 	(CNTx_CTL_ENABLE | CNTx_CTL_ISTATUS | CNTx_CTL_IMASK)) ==	\
 	(CNTx_CTL_ENABLE | CNTx_CTL_ISTATUS))
 
+/*
+ * Maximum number of extra reads of ICC_HPPIR1_EL1 done by
+ * check_pending_timers() while waiting for a masked timer interrupt to be
+ * retired from the CPU interface.
+ */
+#define TIMER_RETIRE_MAX_POLLS	U(64)
+
 /*
  * Check the pending state of the timers.
  *
@@ -32,7 +39,12 @@
  * unmasked such that if the timer output becomes asserted again, an exit from
  * the Realm happens due to a physical IRQ and we can inject a virtual
  * interrupt again.
+ *
+ * Returns 'true' if the REC must exit to the Host with RMI_EXIT_IRQ, either
+ * because the output of a timer changed since the last exit or because a
+ * masked timer interrupt was not retired in time.
  */
+__hot_text
 bool check_pending_timers(struct rec *rec)
 {
 	unsigned long cntv_ctl = read_cntv_ctl_el02();
@@ -61,8 +73,14 @@ bool check_pending_timers(struct rec *rec)
 	 * physical interrupt casused by one of the timer interrupts not having
 	 * been retired from the CPU interface yet. Check that the interrupts
 	 * are retired before entering the Realm.
+	 *
+	 * The poll is bounded so that the REC entry latency does not depend
+	 * on how fast the CPU interface retires the interrupt. If it is still
+	 * pending after TIMER_RETIRE_MAX_POLLS reads, exit to the Host with
+	 * an IRQ exit instead, which is what running the Realm would have
+	 * led to.
 	 */
-	while (true) {
+	for (unsigned int polls = 0U; ; polls++) {
 		unsigned long hppir = read_icc_hppir1_el1();
 		unsigned int intid = EXTRACT(ICC_HPPIR1_EL1_INTID, hppir);
 
@@ -72,6 +90,13 @@ bool check_pending_timers(struct rec *rec)
 			(intid == EL1_PHYS_TIMER_PPI)))) {
 			break;
 		}
+
+#ifdef RMM_REC_STATS
+		rec->stats.timer_polls++;
+#endif
+		if (polls == TIMER_RETIRE_MAX_POLLS) {
+			return true;
+		}
 	}
 
 	/*
@@ -84,6 +109,53 @@ bool check_pending_timers(struct rec *rec)
 		 TIMER_ASSERTED(rec->sysregs.cntp_ctl_el0));
 }
 
+/*
+ * Inject the change of output of the timers reported by
+ * check_pending_timers() into the LRs of the running REC, see
+ * REC_ENTRY_FLAG_TIMER_LOCAL. The saved timer state is then updated to the
+ * injected one, so that the next check only reports a new change.
+ *
+ * Returns 'true' if the REC can be resumed, or 'false' if it must exit to the
+ * Host with RMI_EXIT_IRQ, either because no LR is free or because nothing
+ * changed and check_pending_timers() failed to retire a timer interrupt.
+ */
+bool inject_pending_timers(struct rec *rec)
+{
+	struct gic_cpu_state *gicstate = &rec->sysregs.gicstate;
+	unsigned long cntv_ctl = read_cntv_ctl_el02();
+	unsigned long cntp_ctl = read_cntp_ctl_el02();
+	bool changed = false;
+
+	if (TIMER_ASSERTED(cntv_ctl) !=
+	    TIMER_ASSERTED(rec->sysregs.cntv_ctl_el0)) {
+		if (TIMER_ASSERTED(cntv_ctl)) {
+			if (!gic_inject_virq(gicstate, EL1_VIRT_TIMER_PPI)) {
+				return false;
+			}
+		} else {
+			gic_retire_ppi(gicstate, EL1_VIRT_TIMER_PPI);
+		}
+		rec->sysregs.cntv_ctl_el0 = cntv_ctl;
+		changed = true;
+	}
+
+	if (TIMER_ASSERTED(cntp_ctl) !=
+	    TIMER_ASSERTED(rec->sysregs.cntp_ctl_el0)) {
+		if (TIMER_ASSERTED(cntp_ctl)) {
+			if (!gic_inject_virq(gicstate, EL1_PHYS_TIMER_PPI)) {
+				return false;
+			}
+		} else {
+			gic_retire_ppi(gicstate, EL1_PHYS_TIMER_PPI);
+		}
+		rec->sysregs.cntp_ctl_el0 = cntp_ctl;
+		changed = true;
+	}
+
+	return changed;
+}
+
+__hot_text
 void report_timer_state_to_ns(struct rmi_rec_exit *rec_exit)
 {
 	/* Expose Realm EL1 timer state */
@@ -93,3 +165,40 @@ void report_timer_state_to_ns(struct rmi_rec_exit *rec_exit)
 	rec_exit->cntp_ctl = read_cntp_ctl_el02();
 	rec_exit->cntp_cval = read_cntp_cval_el02() - read_cntpoff_el2();
 }
+
+/*
+ * Return the value a timer control register saved as @ctl would read with
+ * the counter of the timer at @count, as ISTATUS is only updated by the
+ * hardware.
+ */
+static unsigned long saved_timer_ctl(unsigned long ctl, unsigned long cval,
+				     unsigned long count)
+{
+	ctl &= ~CNTx_CTL_ISTATUS;
+	if (((ctl & CNTx_CTL_ENABLE) != 0UL) && (count >= cval)) {
+		ctl |= CNTx_CTL_ISTATUS;
+	}
+
+	return ctl;
+}
+
+/*
+ * Same as report_timer_state_to_ns() for a REC whose timer state is not
+ * loaded in the CPU, from the state saved at its last exit.
+ */
+void report_saved_timer_state_to_ns(struct rec *rec,
+				    struct rmi_rec_exit *rec_exit)
+{
+	unsigned long cntpct = read_cntpct_el0();
+	struct sysreg_state *sysregs = &rec->sysregs;
+
+	rec_exit->cntv_ctl = saved_timer_ctl(sysregs->cntv_ctl_el0,
+					     sysregs->cntv_cval_el0,
+					     cntpct - sysregs->cntvoff_el2);
+	rec_exit->cntv_cval = sysregs->cntv_cval_el0 - sysregs->cntvoff_el2;
+
+	rec_exit->cntp_ctl = saved_timer_ctl(sysregs->cntp_ctl_el0,
+					     sysregs->cntp_cval_el0,
+					     cntpct - sysregs->cntpoff_el2);
+	rec_exit->cntp_cval = sysregs->cntp_cval_el0 - sysregs->cntpoff_el2;
+}
@@ -98,6 +98,13 @@ struct xlat_ctx_cfg {
 	 */
 	xlat_addr_region_id_t region;
 
+	/*
+	 * The translation tables of this context are only ever walked by the
+	 * PE which owns them, so stale TLB entries only need to be invalidated
+	 * on that PE rather than broadcast to the Inner Shareable domain.
+	 */
+	bool local_tlbi;
+
 	bool initialized;
 };
 
@@ -172,10 +179,12 @@ struct xlat_ctx {
 
 /*
  * Macro used to define the xlat_ctx_cfg and xlat_mmap_region array
- * associated with a context.
+ * associated with a context. @_local_tlbi must only be true for a context
+ * private to a PE, see xlat_ctx_cfg.local_tlbi.
  */
-#define XLAT_REGISTER_VA_SPACE(_ctx_name, _region, _mmap_count,		\
-			_virt_addr_space_size)				\
+#define XLAT_REGISTER_VA_SPACE_FULL_SPEC(_ctx_name, _region, _mmap_count,\
+			_virt_addr_space_size,				\
+			_local_tlbi)					\
 	COMPILER_ASSERT(((_region) < VA_REGIONS));			\
 	COMPILER_ASSERT(((unsigned long)(_virt_addr_space_size)		\
 					% GRANULE_SIZE) == UL(0));	\
@@ -194,9 +203,19 @@ struct xlat_ctx {
 		.base_level =						\
 			(GET_XLAT_TABLE_LEVEL_BASE((_virt_addr_space_size))),\
 		.region = (_region),					\
+		.local_tlbi = (_local_tlbi),				\
 		.initialized = false					\
 	}
 
+/*
+ * Same as XLAT_REGISTER_VA_SPACE_FULL_SPEC() for a context whose translation
+ * tables may be walked by any PE.
+ */
+#define XLAT_REGISTER_VA_SPACE(_ctx_name, _region, _mmap_count,		\
+			_virt_addr_space_size)				\
+	XLAT_REGISTER_VA_SPACE_FULL_SPEC(_ctx_name, (_region),		\
+			(_mmap_count), (_virt_addr_space_size), false)
+
 /*
  * Macro to generate a context and associate the translation table set passed
  * to it by ref.
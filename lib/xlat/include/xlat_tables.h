@@ -180,6 +180,7 @@ struct xlat_table_entry {
 	uintptr_t base_va;	/* Context base VA for the current entry. */
 	unsigned int level;	/* Table level of the current entry. */
 	unsigned int entries;   /* Number of entries used by this table. */
+	bool local_tlbi;	/* Only invalidate the TLBs of this PE. */
 };
 
 /******************************************************************************
@@ -270,6 +271,30 @@ int xlat_map_memory_page_with_attrs(const struct xlat_table_entry * const table,
 				    const uintptr_t pa,
 				    const uint64_t attrs);
 
+/*
+ * Same as xlat_unmap_memory_page() and xlat_map_memory_page_with_attrs()
+ * for the @count pages at the VAs of @va, issuing the barriers and the TLB
+ * maintenance completion once for all the pages.
+ *
+ * These functions return 0 on success or a negative error code otherwise,
+ * in which case no descriptor is modified.
+ */
+int xlat_unmap_memory_pages(struct xlat_table_entry * const table,
+			    const uintptr_t *va, unsigned int count);
+int xlat_map_memory_pages_with_attrs(const struct xlat_table_entry * const table,
+				     const uintptr_t *va,
+				     const uintptr_t *pa,
+				     unsigned int count,
+				     const uint64_t attrs);
+
+/*
+ * Return the descriptor of a page mapped with the attributes @attrs in the
+ * last level table of @table, without its output address, for the callers
+ * which map the pages of that table by writing the descriptors directly.
+ */
+uint64_t xlat_page_desc_template(const struct xlat_table_entry * const table,
+				 const uint64_t attrs);
+
 /*
  * This function finds the descriptor entry on a table given the corresponding
  * table entry structure and the VA for that descriptor.
@@ -292,6 +317,28 @@ uint64_t *xlat_get_pte_from_table(const struct xlat_table_entry * const table,
  */
 int xlat_arch_setup_mmu_cfg(struct xlat_ctx * const ctx);
 
+/* Values of the MMU configuration registers of a PE */
+struct xlat_mmu_cfg {
+	uint64_t mair;
+	uint64_t tcr;
+	uint64_t ttbr0;
+	uint64_t ttbr1;
+};
+
+/*
+ * Save the MMU configuration of the current PE, as set up by
+ * xlat_arch_setup_mmu_cfg() for all its contexts, so that it can be restored
+ * with xlat_arch_write_mmu_cfg() without going through the contexts again.
+ */
+void xlat_arch_read_mmu_cfg(struct xlat_mmu_cfg *cfg);
+
+/*
+ * Program the MMU configuration registers of the current PE with @cfg.
+ *
+ * Returns 0 on success or -EPERM if the MMU is already enabled.
+ */
+int xlat_arch_write_mmu_cfg(const struct xlat_mmu_cfg *cfg);
+
 /* MMU control */
 void xlat_enable_mmu_el2(void);
 
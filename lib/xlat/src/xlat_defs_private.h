@@ -49,6 +49,11 @@
 #define UXN			(ULL(1) << 2)
 #define PXN			(ULL(1) << 1)
 #define CONT_HINT		(ULL(1) << 0)
+/*
+ * Number of adjacent entries, aligned to the size they map, which can share a
+ * single TLB entry when all of them have the Contiguous hint set.
+ */
+#define CONT_ENTRIES		U(16)
 #define UPPER_ATTRS(x)		(((x) & ULL(0x7)) << 52)
 
 #define NON_GLOBAL		(UL(1) << 9)
@@ -7,6 +7,7 @@
 /* This file is derived from xlat_table_v2 library in TF-A project */
 
 #include <arch_features.h>
+#include <assert.h>
 #include <debug.h>
 #include <errno.h>
 #include <xlat_contexts.h>
@@ -173,11 +174,63 @@ int xlat_arch_setup_mmu_cfg(struct xlat_ctx * const ctx)
 	return 0;
 }
 
+void xlat_arch_read_mmu_cfg(struct xlat_mmu_cfg *cfg)
+{
+	assert(cfg != NULL);
+
+	cfg->mair = read_mair_el2();
+	cfg->tcr = read_tcr_el2();
+	cfg->ttbr0 = read_ttbr0_el2();
+	cfg->ttbr1 = read_ttbr1_el2();
+}
+
+int xlat_arch_write_mmu_cfg(const struct xlat_mmu_cfg *cfg)
+{
+	assert(cfg != NULL);
+
+	/* MMU cannot be enabled at this point */
+	if (is_mmu_enabled() == true) {
+		return -EPERM;
+	}
+
+	write_mair_el2(cfg->mair);
+	write_tcr_el2(cfg->tcr);
+	write_ttbr0_el2(cfg->ttbr0);
+	write_ttbr1_el2(cfg->ttbr1);
+
+	return 0;
+}
+
 uintptr_t xlat_arch_get_max_supported_pa(void)
 {
 	return (1UL << arch_feat_get_pa_width()) - 1UL;
 }
 
+/*
+ * With FEAT_XS, the nXS forms of TLBI and DSB do not wait for the memory
+ * accesses with the XS attribute, which RMM only gives to its Device
+ * mappings. These are set up at boot and never unmapped at runtime, so the
+ * nXS forms are used for the invalidations below, which then complete
+ * without waiting for any outstanding Device access.
+ */
+static inline void tlbi_vae2is(uintptr_t va)
+{
+	if (is_feat_xs_present()) {
+		tlbivae2isnxs(TLBI_ADDR(va));
+	} else {
+		tlbivae2is(TLBI_ADDR(va));
+	}
+}
+
+static inline void tlbi_vae2(uintptr_t va)
+{
+	if (is_feat_xs_present()) {
+		tlbivae2nxs(TLBI_ADDR(va));
+	} else {
+		tlbivae2(TLBI_ADDR(va));
+	}
+}
+
 void xlat_arch_tlbi_va(uintptr_t va)
 {
 	/*
@@ -186,7 +239,20 @@ void xlat_arch_tlbi_va(uintptr_t va)
 	 */
 	dsb(ishst);
 
-	tlbivae2is(TLBI_ADDR(va));
+	tlbi_vae2is(va);
+}
+
+void xlat_arch_tlbi_va_batch(const uintptr_t *va, unsigned int count)
+{
+	/*
+	 * Ensure all the translation table writes have drained into memory
+	 * before invalidating the TLB entries.
+	 */
+	dsb(ishst);
+
+	for (unsigned int i = 0U; i < count; i++) {
+		tlbi_vae2is(va[i]);
+	}
 }
 
 void xlat_arch_tlbi_va_sync(void)
@@ -201,7 +267,11 @@ void xlat_arch_tlbi_va_sync(void)
 	 * domain. See section D4.8.2 of the ARMv8 (issue k), paragraph
 	 * "Ordering and completion of TLB maintenance instructions".
 	 */
-	dsb(ish);
+	if (is_feat_xs_present()) {
+		dsb_ishnxs();
+	} else {
+		dsb(ish);
+	}
 
 	/*
 	 * The effects of a completed TLB maintenance instruction are
@@ -212,6 +282,40 @@ void xlat_arch_tlbi_va_sync(void)
 	isb();
 }
 
+void xlat_arch_tlbi_va_local(uintptr_t va)
+{
+	/*
+	 * The translation tables are only walked by this PE, so the write
+	 * only has to be visible to its own table walker.
+	 */
+	dsb(nshst);
+
+	tlbi_vae2(va);
+}
+
+void xlat_arch_tlbi_va_local_batch(const uintptr_t *va, unsigned int count)
+{
+	dsb(nshst);
+
+	for (unsigned int i = 0U; i < count; i++) {
+		tlbi_vae2(va[i]);
+	}
+}
+
+void xlat_arch_tlbi_va_local_sync(void)
+{
+	/*
+	 * A non-shareable DSB is enough to wait for the completion of a TLB
+	 * maintenance instruction which only applies to this PE.
+	 */
+	if (is_feat_xs_present()) {
+		dsb_nshnxs();
+	} else {
+		dsb(nsh);
+	}
+	isb();
+}
+
 /*
  * Determine the physical address space encoded in the 'attr' parameter.
  */
@@ -233,6 +233,57 @@ static action_t xlat_tables_map_region_action(const struct xlat_mmap_region *mm,
 	}
 }
 
+/*
+ * Returns true if the CONT_ENTRIES entries of the table starting at
+ * @table_idx can be written as block (or page) entries with the Contiguous
+ * hint for the region @mm. That is the case when the entries map a naturally
+ * aligned block of VA and PA entirely covered by the region and none of them
+ * is already in use.
+ */
+static bool xlat_tables_cont_group(const struct xlat_mmap_region *mm,
+				   const uint64_t *table_base,
+				   unsigned int table_idx,
+				   unsigned int table_entries,
+				   uintptr_t table_idx_va,
+				   uintptr_t table_idx_pa,
+				   unsigned int level)
+{
+	size_t group_size = XLAT_BLOCK_SIZE(level) * CONT_ENTRIES;
+	uintptr_t mm_end_va = mm->base_va + mm->size - 1UL;
+
+	if ((level < 2U) || (MT_TYPE(mm->attr) == MT_TRANSIENT)) {
+		return false;
+	}
+
+	if (((table_idx % CONT_ENTRIES) != 0U) ||
+	    ((table_idx + CONT_ENTRIES) > table_entries)) {
+		return false;
+	}
+
+	if (((table_idx_va | table_idx_pa) & (group_size - 1UL)) != 0UL) {
+		return false;
+	}
+
+	if ((table_idx_va < mm->base_va) ||
+	    ((table_idx_va + group_size - 1UL) > mm_end_va)) {
+		return false;
+	}
+
+	/* Block descriptors must be allowed for the region at this level */
+	if ((level < XLAT_TABLE_LEVEL_MAX) &&
+	    (mm->granularity < XLAT_BLOCK_SIZE(level))) {
+		return false;
+	}
+
+	for (unsigned int i = 0U; i < CONT_ENTRIES; i++) {
+		if (table_base[table_idx + i] != INVALID_DESC) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 /*
  * Recursive function that writes to the translation tables and maps the
  * specified region. On success, it returns the VA of the last byte that was
@@ -250,6 +301,8 @@ static uintptr_t xlat_tables_map_region(struct xlat_ctx *ctx,
 {
 	uintptr_t table_idx_va;
 	unsigned int table_idx;
+	/* Index of the end of the current Contiguous hint group, if any */
+	unsigned int cont_end_idx = 0U;
 	uintptr_t mm_end_va;
 	struct xlat_ctx_cfg *ctx_cfg;
 
@@ -281,14 +334,29 @@ static uintptr_t xlat_tables_map_region(struct xlat_ctx *ctx,
 
 		table_idx_pa = mm->base_pa + table_idx_va - mm->base_va;
 
+		if (xlat_tables_cont_group(mm, table_base, table_idx,
+					   table_entries, table_idx_va,
+					   table_idx_pa, level)) {
+			cont_end_idx = table_idx + CONT_ENTRIES;
+		}
+
 		action_t action = xlat_tables_map_region_action(mm,
 			(uint32_t)(desc & DESC_MASK), table_idx_pa,
 			table_idx_va, level);
 
 		if (action == ACTION_WRITE_BLOCK_ENTRY) {
+			uint64_t attr = mm->attr;
+
+			/*
+			 * Reduce the TLB footprint of the region by marking
+			 * the entries of aligned groups as contiguous.
+			 */
+			if (table_idx < cont_end_idx) {
+				attr |= MT_CONT;
+			}
 
 			table_base[table_idx] =
-				xlat_desc(mm->attr, table_idx_pa, level);
+				xlat_desc(attr, table_idx_pa, level);
 
 		} else if (action == ACTION_CREATE_NEW_TABLE) {
 			uintptr_t end_va;
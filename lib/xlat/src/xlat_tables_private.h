@@ -24,12 +24,27 @@ uint64_t xlat_arch_get_pas(uint64_t attr);
  */
 void xlat_arch_tlbi_va(uintptr_t va);
 
+/*
+ * Same as xlat_arch_tlbi_va() for each of the @count VAs of @va, with a
+ * single barrier before the invalidations.
+ */
+void xlat_arch_tlbi_va_batch(const uintptr_t *va, unsigned int count);
+
 /*
  * This function has to be called at the end of any code that uses the function
- * xlat_arch_tlbi_va().
+ * xlat_arch_tlbi_va() or xlat_arch_tlbi_va_batch().
  */
 void xlat_arch_tlbi_va_sync(void);
 
+/*
+ * Same as xlat_arch_tlbi_va(), xlat_arch_tlbi_va_batch() and
+ * xlat_arch_tlbi_va_sync() but the invalidations only apply to the PE that
+ * executes them. Only to be used for the contexts private to a PE.
+ */
+void xlat_arch_tlbi_va_local(uintptr_t va);
+void xlat_arch_tlbi_va_local_batch(const uintptr_t *va, unsigned int count);
+void xlat_arch_tlbi_va_local_sync(void);
+
 /* Print VA, PA, size and attributes of all regions in the mmap array. */
 void xlat_mmap_print(const struct xlat_ctx *ctx);
 
@@ -358,11 +358,17 @@ int xlat_unmap_memory_page(struct xlat_table_entry * const table,
 	 */
 	xlat_write_descriptor(entry, INVALID_DESC);
 
-	/* Invalidate any cached copy of this mapping in the TLBs. */
-	xlat_arch_tlbi_va(va);
-
-	/* Ensure completion of the invalidation. */
-	xlat_arch_tlbi_va_sync();
+	/*
+	 * Invalidate any cached copy of this mapping in the TLBs and ensure
+	 * completion of the invalidation.
+	 */
+	if (table->local_tlbi) {
+		xlat_arch_tlbi_va_local(va);
+		xlat_arch_tlbi_va_local_sync();
+	} else {
+		xlat_arch_tlbi_va(va);
+		xlat_arch_tlbi_va_sync();
+	}
 
 	return 0;
 }
@@ -417,6 +423,91 @@ int xlat_map_memory_page_with_attrs(const struct xlat_table_entry * const table,
 	return 0;
 }
 
+/*
+ * Unmap the @count pages at the VAs of @va from the descriptor table entry
+ * given, with a single TLB maintenance completion for all of them.
+ *
+ * This function returns 0 on success or an error code otherwise. No page is
+ * unmapped on error.
+ */
+int xlat_unmap_memory_pages(struct xlat_table_entry * const table,
+			    const uintptr_t *va, unsigned int count)
+{
+	assert(table != NULL);
+
+	for (unsigned int i = 0U; i < count; i++) {
+		if (xlat_get_pte_from_table(table, va[i]) == NULL) {
+			return -EFAULT;
+		}
+	}
+
+	for (unsigned int i = 0U; i < count; i++) {
+		xlat_write_descriptor(xlat_get_pte_from_table(table, va[i]),
+				      INVALID_DESC);
+	}
+
+	/*
+	 * Invalidate any cached copy of these mappings in the TLBs and ensure
+	 * completion of the invalidations.
+	 */
+	if (table->local_tlbi) {
+		xlat_arch_tlbi_va_local_batch(va, count);
+		xlat_arch_tlbi_va_local_sync();
+	} else {
+		xlat_arch_tlbi_va_batch(va, count);
+		xlat_arch_tlbi_va_sync();
+	}
+
+	return 0;
+}
+
+/*
+ * Map the @count pages of @pa at the VAs of @va, all with the attributes
+ * @attrs, with a single barrier for all of them. As for
+ * xlat_map_memory_page_with_attrs(), the descriptors must be invalid.
+ *
+ * This function returns 0 on success or an error code otherwise. No page is
+ * mapped on error.
+ */
+int xlat_map_memory_pages_with_attrs(const struct xlat_table_entry * const table,
+				     const uintptr_t *va,
+				     const uintptr_t *pa,
+				     unsigned int count,
+				     const uint64_t attrs)
+{
+	assert(table != NULL);
+
+	for (unsigned int i = 0U; i < count; i++) {
+		uint64_t *desc_ptr = xlat_get_pte_from_table(table, va[i]);
+
+		if ((desc_ptr == NULL) ||
+		    (xlat_read_descriptor(desc_ptr) != INVALID_DESC) ||
+		    (pa[i] > xlat_arch_get_max_supported_pa())) {
+			return -EFAULT;
+		}
+	}
+
+	for (unsigned int i = 0U; i < count; i++) {
+		xlat_write_descriptor(xlat_get_pte_from_table(table, va[i]),
+				      xlat_desc(attrs, pa[i], table->level));
+	}
+
+	/* Ensure the translation table writes have drained into memory */
+	dsb(ishst);
+	isb();
+
+	return 0;
+}
+
+uint64_t xlat_page_desc_template(const struct xlat_table_entry * const table,
+				 const uint64_t attrs)
+{
+	assert(table != NULL);
+	assert(table->level == XLAT_TABLE_LEVEL_MAX);
+
+	return xlat_desc(attrs, 0UL, table->level);
+}
+
 /*
  * Return a table entry structure given a context and a VA.
  * The return structure is populated on the retval field.
@@ -471,6 +562,7 @@ int xlat_get_table_from_va(struct xlat_table_entry * const retval,
 	retval->table = table;
 	retval->level = level;
 	retval->base_va = ctx_cfg->base_va;
+	retval->local_tlbi = ctx_cfg->local_tlbi;
 
 	return 0;
 }
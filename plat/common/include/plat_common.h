@@ -6,12 +6,53 @@
 #ifndef PLAT_COMMON_H
 #define PLAT_COMMON_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /* Forward declaration */
 struct xlat_mmap_region;
 
+/* A bank of DRAM which may hold granules delegated to the Realm world */
+struct plat_dram_bank {
+	unsigned long base;
+	unsigned long size;
+};
+
 int plat_cmn_setup(unsigned long x0, unsigned long x1,
 		   unsigned long x2, unsigned long x3,
 		   struct xlat_mmap_region *plat_regions);
 int plat_cmn_warmboot_setup(void);
 
+/*
+ * Register the DRAM banks of the platform. The granules of all the banks are
+ * given consecutive indexes in the struct granules array, in the address
+ * order of the banks, so that the holes between the banks do not use any
+ * granule entry. The banks must be granule aligned and must not overlap.
+ *
+ * A platform calls this during cold boot, before plat_cmn_setup(), to
+ * provide the layout to use when EL3 does not pass one in the Boot Manifest.
+ */
+int plat_cmn_init_dram_layout(const struct plat_dram_bank *banks,
+			      unsigned long nr_banks);
+
+/*
+ * Replace the DRAM layout registered by the platform with the one from the
+ * Boot Manifest, if EL3 provided one. This is called by plat_cmn_setup()
+ * and fails if neither layout is available.
+ */
+int plat_cmn_init_manifest_dram_layout(void);
+
+/*
+ * Fill @regions, an array of (PLAT_CMN_MAX_NUMA_NODES + 1) entries, with
+ * the mappings of the granule table at [@va, @va + @size), terminated by
+ * an empty region. If the Boot Manifest describes the NUMA nodes, the
+ * entries of the granules of each node are mapped to the RMM memory local
+ * to the node, so that the granule locks do not cross the interconnect.
+ * Otherwise the table is mapped flat.
+ *
+ * This is called by plat_cmn_setup(), once the DRAM layout is final.
+ */
+int plat_cmn_init_granules_regions(uintptr_t va, size_t size,
+				   struct xlat_mmap_region *regions);
+
 #endif /* PLAT_COMMON_H */
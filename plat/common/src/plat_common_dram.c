@@ -0,0 +1,287 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <assert.h>
+#include <debug.h>
+#include <errno.h>
+#include <granule_types.h>
+#include <plat_common.h>
+#include <platform_api.h>
+#include <rmm_el3_ifc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <utils_def.h>
+#include <xlat_tables.h>
+
+struct dram_bank_info {
+	unsigned long base;
+	unsigned long size;
+	/* Index of the first granule of the bank in the struct granules array */
+	unsigned long idx_base;
+};
+
+/* DRAM banks sorted by address */
+static struct {
+	unsigned long nr_banks;
+	struct dram_bank_info banks[PLAT_CMN_MAX_DRAM_BANKS];
+} dram_layout;
+
+int plat_cmn_init_dram_layout(const struct plat_dram_bank *banks,
+			      unsigned long nr_banks)
+{
+	struct dram_bank_info sorted[PLAT_CMN_MAX_DRAM_BANKS];
+	unsigned long idx_base = 0UL;
+
+	assert(banks != NULL);
+
+	if ((nr_banks == 0UL) || (nr_banks > PLAT_CMN_MAX_DRAM_BANKS)) {
+		ERROR("Invalid number of DRAM banks: %lu\n", nr_banks);
+		return -EINVAL;
+	}
+
+	/* Insertion sort, the number of banks is small */
+	for (unsigned long i = 0UL; i < nr_banks; i++) {
+		unsigned long base = banks[i].base;
+		unsigned long size = banks[i].size;
+		unsigned long j;
+
+		if ((size == 0UL) || !GRANULE_ALIGNED(base) ||
+		    !GRANULE_ALIGNED(size) || ((base + size - 1UL) < base)) {
+			ERROR("Invalid DRAM bank %lu: 0x%lx-0x%lx\n",
+			      i, base, base + size);
+			return -EINVAL;
+		}
+
+		for (j = i; (j > 0UL) && (sorted[j - 1UL].base > base); j--) {
+			sorted[j] = sorted[j - 1UL];
+		}
+
+		sorted[j].base = base;
+		sorted[j].size = size;
+	}
+
+	for (unsigned long i = 0UL; i < nr_banks; i++) {
+		if ((i != 0UL) &&
+		    (sorted[i].base < (sorted[i - 1UL].base +
+				       sorted[i - 1UL].size))) {
+			ERROR("DRAM bank 0x%lx overlaps bank 0x%lx\n",
+			      sorted[i].base, sorted[i - 1UL].base);
+			return -EINVAL;
+		}
+
+		if ((sorted[i].size / GRANULE_SIZE) >
+		    (RMM_MAX_GRANULES - idx_base)) {
+			ERROR("DRAM banks exceed RMM_MAX_GRANULES\n");
+			return -EINVAL;
+		}
+
+		sorted[i].idx_base = idx_base;
+		idx_base += sorted[i].size / GRANULE_SIZE;
+	}
+
+	for (unsigned long i = 0UL; i < nr_banks; i++) {
+		dram_layout.banks[i] = sorted[i];
+	}
+
+	dram_layout.nr_banks = nr_banks;
+
+	return 0;
+}
+
+int plat_cmn_init_manifest_dram_layout(void)
+{
+	struct plat_dram_bank banks[PLAT_CMN_MAX_DRAM_BANKS];
+	struct rmm_dram_info *info;
+	int ret;
+
+	ret = rmm_el3_ifc_get_dram_info(&info);
+	if (ret == -ENOENT) {
+		/* Keep the layout registered by the platform, if any */
+		return (dram_layout.nr_banks == 0UL) ? -EINVAL : 0;
+	}
+
+	if (ret != 0) {
+		ERROR("Invalid DRAM layout in the Boot Manifest\n");
+		return ret;
+	}
+
+	if (info->num_banks > PLAT_CMN_MAX_DRAM_BANKS) {
+		ERROR("Too many DRAM banks in the Boot Manifest: %lu\n",
+		      info->num_banks);
+		return -EINVAL;
+	}
+
+	for (unsigned long i = 0UL; i < info->num_banks; i++) {
+		banks[i].base = info->banks[i].base;
+		banks[i].size = info->banks[i].size;
+	}
+
+	return plat_cmn_init_dram_layout(banks, info->num_banks);
+}
+
+int plat_cmn_init_granules_regions(uintptr_t va, size_t size,
+				   struct xlat_mmap_region *regions)
+{
+	const struct dram_bank_info *banks = dram_layout.banks;
+	unsigned long nr_banks = dram_layout.nr_banks;
+	struct rmm_numa_info *info;
+	unsigned long bank = 0UL;
+	unsigned long nr = 0UL;
+	uintptr_t node_va = va;
+	int ret;
+
+	assert(regions != NULL);
+	assert(GRANULE_ALIGNED(va) && GRANULE_ALIGNED(size));
+
+	ret = rmm_el3_ifc_get_numa_info(&info);
+	if (ret == -ENOENT) {
+		/* The table stays in the memory of the RMM image */
+		regions[0].base_pa = va;
+		regions[0].base_va = va;
+		regions[0].size = size;
+		regions[0].attr = MT_RW_DATA | MT_REALM;
+		regions[0].granularity = REGION_DEFAULT_GRANULARITY;
+		regions[1].size = 0UL;
+		return 0;
+	}
+
+	if (ret != 0) {
+		ERROR("Invalid NUMA layout in the Boot Manifest\n");
+		return ret;
+	}
+
+	if (info->num_nodes > PLAT_CMN_MAX_NUMA_NODES) {
+		ERROR("Too many NUMA nodes in the Boot Manifest: %lu\n",
+		      info->num_nodes);
+		return -EINVAL;
+	}
+
+	/*
+	 * The granules of each node have consecutive indexes, as the nodes
+	 * and the banks are both in address order. A page of the table which
+	 * holds the entries of two nodes goes to the first one.
+	 */
+	for (unsigned long i = 0UL; i < info->num_nodes; i++) {
+		const struct rmm_numa_node *node = &info->nodes[i];
+		unsigned long node_end = node->dram_base + node->dram_size;
+		uintptr_t end_va;
+
+		if ((node_end < node->dram_base) ||
+		    !GRANULE_ALIGNED(node->rmm_base) ||
+		    ((i != 0UL) && (node->dram_base <
+				    (info->nodes[i - 1UL].dram_base +
+				     info->nodes[i - 1UL].dram_size)))) {
+			ERROR("Invalid NUMA node %lu\n", i);
+			return -EINVAL;
+		}
+
+		for (; (bank < nr_banks) && (banks[bank].base < node_end);
+		     bank++) {
+			if ((banks[bank].base < node->dram_base) ||
+			    ((banks[bank].base + banks[bank].size) >
+			     node_end)) {
+				ERROR("DRAM bank 0x%lx is not in a NUMA node\n",
+				      banks[bank].base);
+				return -EINVAL;
+			}
+		}
+
+		if (bank == nr_banks) {
+			end_va = va + size;
+		} else {
+			end_va = round_down(va + (banks[bank].idx_base *
+						  sizeof(struct granule)),
+					    GRANULE_SIZE);
+		}
+
+		if (end_va <= node_va) {
+			continue;
+		}
+
+		if ((end_va - node_va) > node->rmm_size) {
+			ERROR("NUMA node %lu: RMM memory too small\n", i);
+			return -EINVAL;
+		}
+
+		regions[nr].base_pa = node->rmm_base;
+		regions[nr].base_va = node_va;
+		regions[nr].size = end_va - node_va;
+		regions[nr].attr = MT_RW_DATA | MT_REALM;
+		regions[nr].granularity = REGION_DEFAULT_GRANULARITY;
+		nr++;
+		node_va = end_va;
+	}
+
+	if (bank != nr_banks) {
+		ERROR("DRAM bank 0x%lx is not in a NUMA node\n",
+		      banks[bank].base);
+		return -EINVAL;
+	}
+
+	regions[nr].size = 0UL;
+	return 0;
+}
+
+/*
+ * Return the last bank whose base address is lower or equal than @addr, or
+ * the first bank if there is none. The number of iterations only depends on
+ * the number of banks and the selection compiles to a conditional select.
+ */
+static const struct dram_bank_info *find_bank_by_addr(unsigned long addr)
+{
+	const struct dram_bank_info *bank = dram_layout.banks;
+	unsigned long n = dram_layout.nr_banks;
+
+	while (n > 1UL) {
+		unsigned long half = n / 2UL;
+
+		bank = (bank[half].base <= addr) ? &bank[half] : bank;
+		n -= half;
+	}
+
+	return bank;
+}
+
+/* Same as find_bank_by_addr() for the index of a granule */
+static const struct dram_bank_info *find_bank_by_idx(unsigned long idx)
+{
+	const struct dram_bank_info *bank = dram_layout.banks;
+	unsigned long n = dram_layout.nr_banks;
+
+	while (n > 1UL) {
+		unsigned long half = n / 2UL;
+
+		bank = (bank[half].idx_base <= idx) ? &bank[half] : bank;
+		n -= half;
+	}
+
+	return bank;
+}
+
+unsigned long plat_granule_addr_to_idx(unsigned long addr)
+{
+	const struct dram_bank_info *bank = find_bank_by_addr(addr);
+	unsigned long offset = addr - bank->base;
+
+	/*
+	 * An address below the first bank wraps around, so that a single
+	 * comparison rejects it as well as the holes between the banks.
+	 */
+	if (!GRANULE_ALIGNED(addr) || (offset >= bank->size)) {
+		return UINT64_MAX;
+	}
+
+	return bank->idx_base + (offset / GRANULE_SIZE);
+}
+
+unsigned long plat_granule_idx_to_addr(unsigned long idx)
+{
+	const struct dram_bank_info *bank = find_bank_by_idx(idx);
+
+	/* The index must be within the number of granules of the platform */
+	assert((idx - bank->idx_base) < (bank->size / GRANULE_SIZE));
+
+	return bank->base + ((idx - bank->idx_base) * GRANULE_SIZE);
+}
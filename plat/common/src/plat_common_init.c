@@ -5,13 +5,18 @@
 
 #include <arch_helpers.h>
 #include <assert.h>
+#include <boot_phase.h>
 #include <buffer.h>
 #include <cpuid.h>
 #include <debug.h>
+#include <errno.h>
 #include <gic.h>
 #include <import_sym.h>
+#include <percpu.h>
+#include <plat_common.h>
 #include <rmm_el3_ifc.h>
 #include <sizes.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <xlat_contexts.h>
 #include <xlat_tables.h>
@@ -22,19 +27,31 @@ IMPORT_SYM(uintptr_t, rmm_ro_start,		RMM_RO_START);
 IMPORT_SYM(uintptr_t, rmm_ro_end,		RMM_RO_END);
 IMPORT_SYM(uintptr_t, rmm_rw_start,		RMM_RW_START);
 IMPORT_SYM(uintptr_t, rmm_rw_end,		RMM_RW_END);
+IMPORT_SYM(uintptr_t, rmm_granules_start,	RMM_GRANULES_START);
+IMPORT_SYM(uintptr_t, rmm_granules_end,	RMM_GRANULES_END);
+IMPORT_SYM(uintptr_t, percpu_start,		RMM_PERCPU_START);
+IMPORT_SYM(uintptr_t, percpu_end,		RMM_PERCPU_END);
+IMPORT_SYM(uintptr_t, rmm_limit,		RMM_LIMIT);
 
 /*
  * Leave an invalid page between the end of RMM memory and the beginning
  * of the shared buffer VA. This will help to detect any memory access
- * underflow by RMM.
+ * underflow by RMM. The per-CPU areas are the last part of RMM memory,
+ * their number depends on the number of CPUs reported by EL3, so the
+ * shared buffer VA is placed after the largest RMM memory possible.
  */
-#define RMM_SHARED_BUFFER_START	(RMM_RW_END + SZ_4K)
+#define RMM_SHARED_BUFFER_START	(RMM_LIMIT + SZ_4K)
+
+/* The per-CPU shared buffers follow the global one, after a guard page */
+#define RMM_CPU_BUFS_START	(RMM_SHARED_BUFFER_START + (2UL * SZ_4K))
 /*
  * Memory map REGIONS used for the RMM runtime (static mappings)
  */
 #define RMM_CODE_SIZE		(RMM_CODE_END - RMM_CODE_START)
 #define RMM_RO_SIZE		(RMM_RO_END - RMM_RO_START)
 #define RMM_RW_SIZE		(RMM_RW_END - RMM_RW_START)
+#define RMM_GRANULES_SIZE	(RMM_GRANULES_END - RMM_GRANULES_START)
+#define RMM_PERCPU_STRIDE	(RMM_PERCPU_END - RMM_PERCPU_START)
 
 #define RMM_CODE		MAP_REGION_FLAT(			\
 					RMM_CODE_START,			\
@@ -51,6 +68,15 @@ IMPORT_SYM(uintptr_t, rmm_rw_end,		RMM_RW_END);
 					RMM_RW_SIZE,			\
 					MT_RW_DATA | MT_REALM)
 
+/*
+ * The per-CPU areas of the CPUs reported by EL3, the size of RMM_PERCPU is
+ * populated at runtime.
+ */
+#define RMM_PERCPU		MAP_REGION_FLAT(			\
+					RMM_PERCPU_START,		\
+					0U,				\
+					MT_RW_DATA | MT_REALM)
+
 /*
  * Some of the fields for the RMM_SHARED region will be populated
  * at runtime.
@@ -61,6 +87,16 @@ IMPORT_SYM(uintptr_t, rmm_rw_end,		RMM_RW_END);
 					0U,				\
 					MT_RW_DATA | MT_REALM)
 
+/*
+ * The per-CPU shared buffers are only mapped if EL3 provides them, in which
+ * case the fields of RMM_CPU_BUFS are also populated at runtime.
+ */
+#define RMM_CPU_BUFS		MAP_REGION(				\
+					0U,				\
+					RMM_CPU_BUFS_START,		\
+					0U,				\
+					MT_RW_DATA | MT_REALM)
+
 
 XLAT_REGISTER_CONTEXT(runtime, VA_LOW_REGION, PLAT_CMN_MAX_MMAP_REGIONS,
 		      PLAT_CMN_CTX_MAX_XLAT_TABLES,
@@ -82,12 +118,22 @@ int plat_cmn_setup(unsigned long x0, unsigned long x1,
 	int ret;
 
 	/* Initialize the RMM <-> EL3 interface */
+	boot_phase_start(BOOT_PHASE_EL3_IFC);
 	ret = rmm_el3_ifc_init(x0, x1, x2, x3, RMM_SHARED_BUFFER_START);
 	if (ret != 0) {
 		ERROR("%s (%u): Failed to initialized RMM EL3 Interface\n",
 		      __func__, __LINE__);
 		return ret;
 	}
+	boot_phase_end(BOOT_PHASE_EL3_IFC);
+
+	/* Set the DRAM layout before any granule lookup */
+	ret = plat_cmn_init_manifest_dram_layout();
+	if (ret != 0) {
+		ERROR("%s (%u): Failed to setup the DRAM layout\n",
+		      __func__, __LINE__);
+		return ret;
+	}
 
 	/*
 	 * xlat library might modify the memory mappings
@@ -97,12 +143,32 @@ int plat_cmn_setup(unsigned long x0, unsigned long x1,
 		RMM_CODE,
 		RMM_RO,
 		RMM_RW,
+		RMM_PERCPU,
 		RMM_SHARED,
+		RMM_CPU_BUFS,
 		{0}
 	};
+	struct xlat_mmap_region granules_regions[PLAT_CMN_MAX_NUMA_NODES + 1U];
+	unsigned long num_cpus = rmm_el3_ifc_get_num_cpus();
+	uintptr_t cpu_bufs_pa;
+	uint64_t num_cpu_bufs;
 
 	assert(plat_regions != NULL);
 
+	/*
+	 * The per-CPU areas are carved from the RMM memory after the image,
+	 * one per CPU reported by EL3, and must fit within RMM_MAX_SIZE.
+	 */
+	if (num_cpus > ((RMM_LIMIT - RMM_PERCPU_START) / RMM_PERCPU_STRIDE)) {
+		ERROR("%s (%u): No room for the per-CPU areas of %lu CPUs\n",
+			__func__, __LINE__, num_cpus);
+		return -ENOMEM;
+	}
+
+	runtime_regions[3].size = num_cpus * RMM_PERCPU_STRIDE;
+	percpu_init(num_cpus);
+
+	boot_phase_start(BOOT_PHASE_XLAT);
 	ret = xlat_mmap_add_ctx(&runtime_xlat_ctx, plat_regions, false);
 	if (ret != 0) {
 		ERROR("%s (%u): Failed to add platform regions to xlat mapping\n",
@@ -110,9 +176,38 @@ int plat_cmn_setup(unsigned long x0, unsigned long x1,
 		return ret;
 	}
 
+	/* Place the granule table in memory local to each NUMA node, if any */
+	ret = plat_cmn_init_granules_regions(RMM_GRANULES_START,
+					     RMM_GRANULES_SIZE,
+					     granules_regions);
+	if (ret == 0) {
+		ret = xlat_mmap_add_ctx(&runtime_xlat_ctx, granules_regions,
+					false);
+	}
+
+	if (ret != 0) {
+		ERROR("%s (%u): Failed to map the granule table\n",
+			__func__, __LINE__);
+		return ret;
+	}
+
 	/* Setup the parameters of the shared area */
-	runtime_regions[3].base_pa = rmm_el3_ifc_get_shared_buf_pa();
-	runtime_regions[3].size = rmm_el3_ifc_get_shared_buf_size();
+	runtime_regions[4].base_pa = rmm_el3_ifc_get_shared_buf_pa();
+	runtime_regions[4].size = rmm_el3_ifc_get_shared_buf_size();
+
+	/*
+	 * Give each CPU its own buffer for the runtime calls to EL3, if EL3
+	 * provides them, so that these calls are not serialized.
+	 */
+	ret = rmm_el3_ifc_get_cpu_bufs_info(&cpu_bufs_pa, &num_cpu_bufs);
+	if (ret == 0) {
+		runtime_regions[5].base_pa = cpu_bufs_pa;
+		runtime_regions[5].size = num_cpu_bufs * SZ_4K;
+	} else if (ret != -ENOENT) {
+		ERROR("%s (%u): Invalid per-CPU shared buffers\n",
+			__func__, __LINE__);
+		return ret;
+	}
 
 	ret = xlat_mmap_add_ctx(&runtime_xlat_ctx, runtime_regions, true);
 	if (ret != 0) {
@@ -126,6 +221,11 @@ int plat_cmn_setup(unsigned long x0, unsigned long x1,
 		ERROR("%s (%u): xlat initialization failed\n", __func__, __LINE__);
 		return ret;
 	}
+	boot_phase_end(BOOT_PHASE_XLAT);
+
+	if (runtime_regions[5].size != 0UL) {
+		rmm_el3_ifc_set_cpu_bufs(cpu_bufs_pa, RMM_CPU_BUFS_START);
+	}
 
 	/* Read supported GIC virtualization features and init GIC variables */
 	gic_get_virt_features();
@@ -133,6 +233,14 @@ int plat_cmn_setup(unsigned long x0, unsigned long x1,
 	return 0;
 }
 
+/*
+ * MMU configuration of each PE, saved on its first warm boot. The translation
+ * contexts do not change afterwards, so the later warm boots of the PE program
+ * the MMU registers from it directly.
+ */
+static struct xlat_mmu_cfg warmboot_mmu_cfg[MAX_CPUS];
+static bool warmboot_mmu_cfg_saved[MAX_CPUS];
+
 /*
  * Local PE common platform setup for RMM.
  *
@@ -142,8 +250,18 @@ int plat_cmn_setup(unsigned long x0, unsigned long x1,
  */
 int plat_cmn_warmboot_setup(void)
 {
+	unsigned int cpuid = my_cpuid();
 	int ret;
 
+	if (warmboot_mmu_cfg_saved[cpuid]) {
+		ret = xlat_arch_write_mmu_cfg(&warmboot_mmu_cfg[cpuid]);
+		if (ret != 0) {
+			ERROR("%s (%u): Failed to restore MMU cfg for CPU[%u]\n",
+					__func__, __LINE__, cpuid);
+		}
+		return ret;
+	}
+
 	/* Setup the MMU cfg for the low region (runtime context). */
 	ret = xlat_arch_setup_mmu_cfg(&runtime_xlat_ctx);
 	if (ret != 0) {
@@ -155,6 +273,9 @@ int plat_cmn_warmboot_setup(void)
 	/* Setup the MMU cfg for the slot buffer context (high region) */
 	slot_buf_setup_xlat();
 
-	VERBOSE("xlat tables configured for CPU[%u]\n", my_cpuid());
+	xlat_arch_read_mmu_cfg(&warmboot_mmu_cfg[cpuid]);
+	warmboot_mmu_cfg_saved[cpuid] = true;
+
+	VERBOSE("xlat tables configured for CPU[%u]\n", cpuid);
 	return 0;
 }
@@ -6,7 +6,9 @@
 #include <fvp_private.h>
 #include <pl011.h>
 #include <plat_common.h>
+#include <platform_api.h>
 #include <sizes.h>
+#include <utils_def.h>
 #include <xlat_tables.h>
 
 #define FVP_RMM_UART		MAP_REGION_FLAT(			\
@@ -14,9 +16,36 @@
 					SZ_4K,				\
 					MT_DEVICE | MT_RW | MT_REALM)
 
+#ifdef RMM_GRANULE_DIRECT_MAP
+/*
+ * Flat mappings of the DRAM banks in the Realm PAS. RMM accesses Realm
+ * granules through them instead of through the slot buffers.
+ */
+#define FVP_DRAM0		MAP_REGION_FLAT(			\
+					FVP_DRAM0_BASE,			\
+					FVP_DRAM0_SIZE,			\
+					MT_RW_DATA | MT_REALM)
+
+#define FVP_DRAM1		MAP_REGION_FLAT(			\
+					FVP_DRAM1_BASE,			\
+					FVP_DRAM1_SIZE,			\
+					MT_RW_DATA | MT_REALM)
+#endif /* RMM_GRANULE_DIRECT_MAP */
+
+COMPILER_ASSERT(RMM_MAX_GRANULES >= FVP_NR_GRANULES);
+
+static const struct plat_dram_bank fvp_dram_banks[] = {
+	{ FVP_DRAM0_BASE, FVP_DRAM0_SIZE },
+	{ FVP_DRAM1_BASE, FVP_DRAM1_SIZE }
+};
+
 /* TBD Initialize UART for early log */
 struct xlat_mmap_region plat_regions[] = {
 	FVP_RMM_UART,
+#ifdef RMM_GRANULE_DIRECT_MAP
+	FVP_DRAM0,
+	FVP_DRAM1,
+#endif
 	{0}
 };
 
@@ -40,6 +69,11 @@ void plat_warmboot_setup(uint64_t x0, uint64_t x1, uint64_t x2, uint64_t x3)
 	}
 }
 
+void plat_console_drain(void)
+{
+	uart_drain();
+}
+
 /*
  * Global platform setup for RMM.
  *
@@ -58,6 +92,11 @@ void plat_setup(uint64_t x0, uint64_t x1, uint64_t x2, uint64_t x3)
 
 	uart_init(RMM_UART_ADDR, FVP_UART_CLK_IN_HZ, FVP_UART_BAUDRATE);
 
+	if (plat_cmn_init_dram_layout(fvp_dram_banks,
+				      ARRAY_LEN(fvp_dram_banks)) != 0) {
+		panic();
+	}
+
 	/* Initialize xlat table */
 	if (plat_cmn_setup(x0, x1, x2, x3, plat_regions) != 0) {
 		panic();
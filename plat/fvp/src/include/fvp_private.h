@@ -25,9 +25,6 @@
 #define FVP_DRAM1_SIZE			UL(0x80000000)
 #define FVP_DRAM1_END			(FVP_DRAM1_BASE + FVP_DRAM1_SIZE - 1UL)
 
-/* Start index for DRAM1 */
-#define	FVP_DRAM1_IDX			(FVP_DRAM0_SIZE / GRANULE_SIZE)
-
 /* Total size of DRAM0 + DRAM1 */
 #define FVP_DRAM_SIZE			(FVP_DRAM0_SIZE + FVP_DRAM1_SIZE)
 
@@ -8,8 +8,10 @@
 
 #include <utils_def.h>
 
-/* Allocate 1GB of space to be used as physical granules */
-#define HOST_MEM_SIZE			UL(0x40000000)
+/*
+ * HOST_MEM_SIZE, the size of the memory used as physical granules, is set by
+ * the build. It must be a multiple of GRANULE_SIZE.
+ */
 
 /* Total number of granules on the current platform */
 #define HOST_NR_GRANULES		(HOST_MEM_SIZE/GRANULE_SIZE)
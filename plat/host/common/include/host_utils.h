@@ -6,6 +6,7 @@
 #ifndef HOST_UTILS_H
 #define HOST_UTILS_H
 
+#include <host_harness.h>
 #include <types.h>
 
 /***********************************************************************
@@ -123,8 +124,110 @@ void host_util_reset_all_sysreg_cb(void);
 unsigned long host_util_get_granule_base(void);
 
 /*
- * Set the current CPU emulated by the platform.
+ * Set the current CPU emulated by the platform. With HOST_THREADS, this is
+ * the CPU emulated by the calling thread.
  */
 void host_util_set_cpuid(unsigned int cpuid);
 
+/*
+ * Callback prototype invoked by host_run_realm() to emulate the Realm.
+ *
+ * Arguments:
+ *	regs - GPRs of the REC, updated as the Realm would before it takes
+ *	       an exception to RMM.
+ *
+ * Returns:
+ *	The exception taken by the Realm, one of ARM_EXCEPTION_*.
+ */
+typedef int (*host_realm_cb_t)(unsigned long *regs);
+
+/*
+ * Set the callback which emulates the Realm on REC entry. With no callback,
+ * the Realm takes a synchronous exception with the syndrome in ESR_EL2 as
+ * soon as it is entered.
+ */
+void host_util_set_realm_cb(host_realm_cb_t cb);
+
+/*
+ * Callback prototype invoked by host_monitor_call() and
+ * host_monitor_call_with_res() to emulate EL3.
+ *
+ * Arguments:
+ *	id - SMC Function ID of the call.
+ *	args - The 6 arguments of the call.
+ *	res - Result of the call. res->x[0] is also returned by
+ *	      host_monitor_call().
+ *
+ * Returns:
+ *	true if the call is emulated, false to leave it to the default
+ *	emulation, which does nothing and returns 0.
+ */
+typedef bool (*host_el3_cb_t)(unsigned long id, const unsigned long *args,
+			      struct smc_result *res);
+
+/* Set the callback which emulates the calls from RMM to EL3 */
+void host_util_set_el3_cb(host_el3_cb_t cb);
+
+#ifdef HOST_THREADS
+/* Maximum number of spinlocks whose wait time can be recorded */
+#define HOST_SPINLOCK_WATCH_MAX	(4U)
+
+/*
+ * Return the number of spinlock acquisitions which had to wait for another
+ * thread to release the lock.
+ */
+unsigned long host_util_get_spinlock_contended(void);
+
+struct spinlock_s;
+/*
+ * Record in slot @idx the time spent waiting for the spinlock @l, and reset
+ * it to zero. A NULL @l stops the recording.
+ */
+void host_util_spinlock_watch(unsigned int idx, struct spinlock_s *l);
+
+/*
+ * Return the time, in ns, spent waiting for the spinlock watched in slot
+ * @idx since host_util_spinlock_watch() was called, by all the threads.
+ */
+unsigned long host_util_get_spinlock_wait_ns(unsigned int idx);
+#endif
+
+#ifdef HOST_COST_MODEL
+/*
+ * Number of operations of each class counted by the cost model, across all
+ * the simulated CPUs.
+ */
+struct host_cost {
+	unsigned long ops[HOST_COST_NR_OPS];
+};
+
+/*
+ * Read the number of operations counted so far into @cost.
+ */
+void host_util_cost_read(struct host_cost *cost);
+
+/*
+ * Add to @total the operations counted since @start was read.
+ */
+void host_util_cost_accumulate(struct host_cost *total,
+			       const struct host_cost *start);
+
+/*
+ * Set the cycle weight of some classes of operations from @spec, a comma
+ * separated list of <class>=<cycles>, for instance "tlbi=500,dsb=80". The
+ * classes are tlbi, dsb, dmb, isb, dc, at, slot_map and other.
+ *
+ * Returns:
+ *	0 on success or -EINVAL if @spec is malformed, in which case some of
+ *	the weights may have been set.
+ */
+int host_util_cost_set_weights(const char *spec);
+
+/*
+ * Print the operations in @cost averaged over @calls operations of a
+ * benchmark, along with their weighted cost in cycles.
+ */
+void host_util_cost_report(const struct host_cost *cost, unsigned long calls);
+#endif /* HOST_COST_MODEL */
+
 #endif /* HOST_UTILS_H */
@@ -0,0 +1,139 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <errno.h>
+#include <host_harness.h>
+#include <host_utils.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Cost model of the operations which are no-ops on the fake host. The
+ * operations are counted by class, and each class is given a weight in
+ * cycles so that the counts can be turned into an estimate of the time the
+ * operations would take on hardware.
+ */
+static const char *const host_cost_names[HOST_COST_NR_OPS] = {
+	[HOST_COST_TLBI]	= "tlbi",
+	[HOST_COST_DSB]		= "dsb",
+	[HOST_COST_DMB]		= "dmb",
+	[HOST_COST_ISB]		= "isb",
+	[HOST_COST_DC]		= "dc",
+	[HOST_COST_AT]		= "at",
+	[HOST_COST_SLOT_MAP]	= "slot_map",
+	[HOST_COST_OTHER]	= "other"
+};
+
+/*
+ * Weight of each class, in cycles. The defaults are rough figures for a
+ * server class core. A TLBI is broadcast to the Inner Shareable domain and
+ * most of its cost is paid by the DSB which waits for it, so both are
+ * weighted. A slot mapping stands for the write of the slot TTE and the local
+ * TLBI when it is unmapped.
+ */
+static unsigned long host_cost_weights[HOST_COST_NR_OPS] = {
+	[HOST_COST_TLBI]	= 200UL,
+	[HOST_COST_DSB]		= 100UL,
+	[HOST_COST_DMB]		= 20UL,
+	[HOST_COST_ISB]		= 30UL,
+	[HOST_COST_DC]		= 50UL,
+	[HOST_COST_AT]		= 50UL,
+	[HOST_COST_SLOT_MAP]	= 80UL,
+	[HOST_COST_OTHER]	= 10UL
+};
+
+/* Counted with atomics, as each simulated CPU may run on its own thread */
+static unsigned long host_cost_ops[HOST_COST_NR_OPS];
+
+void host_cost_add(enum host_cost_op op)
+{
+	(void)__atomic_fetch_add(&host_cost_ops[op], 1UL, __ATOMIC_RELAXED);
+}
+
+void host_util_cost_read(struct host_cost *cost)
+{
+	for (unsigned int i = 0U; i < HOST_COST_NR_OPS; i++) {
+		cost->ops[i] = __atomic_load_n(&host_cost_ops[i],
+					       __ATOMIC_RELAXED);
+	}
+}
+
+void host_util_cost_accumulate(struct host_cost *total,
+			       const struct host_cost *start)
+{
+	struct host_cost now;
+
+	host_util_cost_read(&now);
+
+	for (unsigned int i = 0U; i < HOST_COST_NR_OPS; i++) {
+		total->ops[i] += now.ops[i] - start->ops[i];
+	}
+}
+
+static int host_cost_find_class(const char *name, size_t len)
+{
+	for (unsigned int i = 0U; i < HOST_COST_NR_OPS; i++) {
+		if ((strlen(host_cost_names[i]) == len) &&
+		    (strncmp(host_cost_names[i], name, len) == 0)) {
+			return (int)i;
+		}
+	}
+
+	return -1;
+}
+
+int host_util_cost_set_weights(const char *spec)
+{
+	while (*spec != '\0') {
+		const char *eq = strchr(spec, '=');
+		char *end;
+		unsigned long weight;
+		int idx;
+
+		if (eq == NULL) {
+			return -EINVAL;
+		}
+
+		idx = host_cost_find_class(spec, (size_t)(eq - spec));
+		if (idx < 0) {
+			return -EINVAL;
+		}
+
+		weight = strtoul(eq + 1, &end, 0);
+		if ((end == (eq + 1)) || ((*end != ',') && (*end != '\0'))) {
+			return -EINVAL;
+		}
+
+		host_cost_weights[idx] = weight;
+		spec = (*end == ',') ? (end + 1) : end;
+	}
+
+	return 0;
+}
+
+void host_util_cost_report(const struct host_cost *cost, unsigned long calls)
+{
+	double cycles = 0.0;
+
+	if (calls == 0UL) {
+		return;
+	}
+
+	printf("%-24s %10s", "", "per op:");
+
+	for (unsigned int i = 0U; i < HOST_COST_NR_OPS; i++) {
+		double ops = (double)cost->ops[i] / (double)calls;
+
+		if (cost->ops[i] == 0UL) {
+			continue;
+		}
+
+		printf(" %s %.2f", host_cost_names[i], ops);
+		cycles += ops * (double)host_cost_weights[i];
+	}
+
+	printf(" = %.1f cycles\n", cycles);
+}
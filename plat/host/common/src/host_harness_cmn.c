@@ -4,9 +4,30 @@
  */
 
 #include <arch.h>
+#include <assert.h>
 #include <host_utils.h>
+#include <smc.h>
 #include <spinlock.h>
 #include <string.h>
+#ifdef HOST_THREADS
+#include <time.h>
+#endif
+
+/* Emulation of the Realm run by host_run_realm(), if any */
+static host_realm_cb_t realm_cb;
+
+void host_util_set_realm_cb(host_realm_cb_t cb)
+{
+	realm_cb = cb;
+}
+
+/* Emulation of EL3 used by host_monitor_call(), if any */
+static host_el3_cb_t el3_cb;
+
+void host_util_set_el3_cb(host_el3_cb_t cb)
+{
+	el3_cb = cb;
+}
 
 bool host_memcpy_ns_read(void *dest, const void *ns_src, unsigned long size)
 {
@@ -28,14 +49,13 @@ unsigned long host_monitor_call(unsigned long id,
 			unsigned long arg4,
 			unsigned long arg5)
 {
-	/* Avoid MISRA C:2102-2.7 warnings */
-	(void)id;
-	(void)arg0;
-	(void)arg1;
-	(void)arg2;
-	(void)arg3;
-	(void)arg4;
-	(void)arg5;
+	unsigned long args[] = { arg0, arg1, arg2, arg3, arg4, arg5 };
+	struct smc_result res = { 0 };
+
+	if ((el3_cb != NULL) && el3_cb(id, args, &res)) {
+		return res.x[0];
+	}
+
 	return 0UL;
 }
 
@@ -48,23 +68,132 @@ void host_monitor_call_with_res(unsigned long id,
 			unsigned long arg5,
 			struct smc_result *res)
 {
-	/* Avoid MISRA C:2102-2.7 warnings */
-	(void)id;
-	(void)arg0;
-	(void)arg1;
-	(void)arg2;
-	(void)arg3;
-	(void)arg4;
-	(void)arg5;
-	(void)res;
+	unsigned long args[] = { arg0, arg1, arg2, arg3, arg4, arg5 };
+
+	if (el3_cb != NULL) {
+		(void)el3_cb(id, args, res);
+	}
 }
 
 int host_run_realm(unsigned long *regs)
 {
+	if (realm_cb != NULL) {
+		return realm_cb(regs);
+	}
+
 	/* Return an arbitrary exception */
 	return ARM_EXCEPTION_SYNC_LEL;
 }
 
+#ifdef HOST_THREADS
+/* Number of spinlock acquisitions which found the lock already held */
+static unsigned long spinlock_contended;
+
+/* Locks whose wait time is recorded, see host_util_spinlock_watch() */
+static spinlock_t *spinlock_watched[HOST_SPINLOCK_WATCH_MAX];
+static unsigned long spinlock_wait_ns[HOST_SPINLOCK_WATCH_MAX];
+
+static unsigned long spinlock_now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((unsigned long)ts.tv_sec * 1000000000UL) +
+		(unsigned long)ts.tv_nsec;
+}
+
+/* Add the time since @start to the wait time of @l, if it is watched */
+static void spinlock_account_wait(spinlock_t *l, unsigned long start)
+{
+	for (unsigned int i = 0U; i < HOST_SPINLOCK_WATCH_MAX; i++) {
+		if (__atomic_load_n(&spinlock_watched[i],
+				    __ATOMIC_RELAXED) == l) {
+			(void)__atomic_add_fetch(&spinlock_wait_ns[i],
+						 spinlock_now_ns() - start,
+						 __ATOMIC_RELAXED);
+			return;
+		}
+	}
+}
+
+#ifdef RMM_TICKET_LOCK
+/*
+ * Ticket lock with the same layout as the aarch64 one: the low halfword of
+ * the lock is the ticket being served and the high halfword the next ticket.
+ */
+void host_spinlock_acquire(spinlock_t *l)
+{
+	unsigned int old = __atomic_fetch_add(&l->val, 1U << 16,
+					      __ATOMIC_ACQUIRE);
+	unsigned short ticket = (unsigned short)(old >> 16);
+	unsigned short *owner = (unsigned short *)&l->val;
+
+	if ((unsigned short)old == ticket) {
+		return;
+	}
+
+	unsigned long start = spinlock_now_ns();
+
+	(void)__atomic_add_fetch(&spinlock_contended, 1UL, __ATOMIC_RELAXED);
+
+	while (__atomic_load_n(owner, __ATOMIC_ACQUIRE) != ticket) {
+	}
+
+	spinlock_account_wait(l, start);
+}
+
+void host_spinlock_release(spinlock_t *l)
+{
+	unsigned short *owner = (unsigned short *)&l->val;
+
+	__atomic_store_n(owner, (unsigned short)(*owner + 1U),
+			 __ATOMIC_RELEASE);
+}
+#else
+void host_spinlock_acquire(spinlock_t *l)
+{
+	if (__atomic_exchange_n(&l->val, 1U, __ATOMIC_ACQUIRE) == 0U) {
+		return;
+	}
+
+	unsigned long start = spinlock_now_ns();
+
+	(void)__atomic_add_fetch(&spinlock_contended, 1UL, __ATOMIC_RELAXED);
+
+	do {
+		while (__atomic_load_n(&l->val, __ATOMIC_RELAXED) != 0U) {
+		}
+	} while (__atomic_exchange_n(&l->val, 1U, __ATOMIC_ACQUIRE) != 0U);
+
+	spinlock_account_wait(l, start);
+}
+
+void host_spinlock_release(spinlock_t *l)
+{
+	__atomic_store_n(&l->val, 0U, __ATOMIC_RELEASE);
+}
+#endif /* RMM_TICKET_LOCK */
+
+unsigned long host_util_get_spinlock_contended(void)
+{
+	return __atomic_load_n(&spinlock_contended, __ATOMIC_RELAXED);
+}
+
+void host_util_spinlock_watch(unsigned int idx, struct spinlock_s *l)
+{
+	assert(idx < HOST_SPINLOCK_WATCH_MAX);
+
+	__atomic_store_n(&spinlock_watched[idx], l, __ATOMIC_RELAXED);
+	__atomic_store_n(&spinlock_wait_ns[idx], 0UL, __ATOMIC_RELAXED);
+}
+
+unsigned long host_util_get_spinlock_wait_ns(unsigned int idx)
+{
+	assert(idx < HOST_SPINLOCK_WATCH_MAX);
+
+	return __atomic_load_n(&spinlock_wait_ns[idx], __ATOMIC_RELAXED);
+}
+#else
 void host_spinlock_acquire(spinlock_t *l)
 {
 	l->val = 1;
@@ -74,6 +203,7 @@ void host_spinlock_release(spinlock_t *l)
 {
 	l->val = 0;
 }
+#endif /* HOST_THREADS */
 
 u_register_t host_read_sysreg(char *reg_name)
 {
@@ -8,18 +8,66 @@
 #include <host_defs.h>
 #include <host_utils.h>
 #include <plat_common.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <utils_def.h>
 #include <xlat_tables.h>
 
 static struct sysreg_data sysregs[SYSREG_MAX_CBS];
 static unsigned int installed_cb_idx;
-static unsigned int current_cpuid;
+
+#ifdef HOST_THREADS
+#define HOST_THREAD_LOCAL	__thread
+#else
+#define HOST_THREAD_LOCAL
+#endif
+
+/* Each thread emulates one CPU at a time */
+static HOST_THREAD_LOCAL unsigned int current_cpuid;
 
 /*
- * Allocate memory to emulate physical memory to initialize the
- * granule library.
+ * Hash index of the installed sysregs, by the hash of their name. Each bucket
+ * holds the index in sysregs[] plus one, or zero if it is empty. Collisions
+ * are resolved by linear probing.
  */
-static unsigned char granules_buffer[HOST_MEM_SIZE] __aligned(GRANULE_SIZE);
+#define SYSREG_HASH_BUCKETS	(64U)
+COMPILER_ASSERT(SYSREG_HASH_BUCKETS >= (2U * SYSREG_MAX_CBS));
+COMPILER_ASSERT((SYSREG_HASH_BUCKETS & (SYSREG_HASH_BUCKETS - 1U)) == 0U);
+
+static unsigned int sysreg_buckets[SYSREG_HASH_BUCKETS];
+static uint32_t sysreg_hashes[SYSREG_MAX_CBS];
+
+/*
+ * The accessors generated by DEFINE_SYSREG_READ_FUNC() and
+ * DEFINE_SYSREG_WRITE_FUNC() pass string literals, whose address is the same
+ * on every call. The index of the sysreg is cached by that address, so that
+ * the name is only hashed and compared on the first access. The cache is
+ * invalidated by bumping sysreg_generation when a sysreg is installed or the
+ * sysregs are reset.
+ */
+#define SYSREG_NAME_CACHE_SIZE	(256U)
+COMPILER_ASSERT((SYSREG_NAME_CACHE_SIZE & (SYSREG_NAME_CACHE_SIZE - 1U)) == 0U);
+
+struct sysreg_name_cache_entry {
+	const char *name;
+	unsigned long generation;
+	unsigned int idx;
+};
+
+static HOST_THREAD_LOCAL struct sysreg_name_cache_entry
+				sysreg_name_cache[SYSREG_NAME_CACHE_SIZE];
+static unsigned long sysreg_generation = 1UL;
+
+COMPILER_ASSERT((HOST_MEM_SIZE % GRANULE_SIZE) == 0UL);
+
+/*
+ * Memory emulating the physical memory used to initialize the granule
+ * library. It is reserved with mmap() on first use rather than being a static
+ * buffer, so that the host can emulate hundreds of GB of DRAM: the pages are
+ * only committed when they are touched.
+ */
+static unsigned char *granules_buffer;
 
 /*
  * Generic callback to access a sysreg for reading.
@@ -37,23 +85,102 @@ static void sysreg_wr_cb(u_register_t val, u_register_t *reg)
 	*reg = val;
 }
 
-struct sysreg_cb *host_util_get_sysreg_cb(char *name)
+/* FNV-1a hash of the first MAX_SYSREG_NAME_LEN characters of @name */
+static uint32_t sysreg_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	for (unsigned int i = 0U;
+	     (i < MAX_SYSREG_NAME_LEN) && (name[i] != '\0'); i++) {
+		hash ^= (uint32_t)(unsigned char)name[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static void sysreg_hash_insert(unsigned int idx)
+{
+	uint32_t hash = sysreg_name_hash(&sysregs[idx].name[0]);
+	unsigned int bucket = hash & (SYSREG_HASH_BUCKETS - 1U);
+
+	while (sysreg_buckets[bucket] != 0U) {
+		bucket = (bucket + 1U) & (SYSREG_HASH_BUCKETS - 1U);
+	}
+
+	sysreg_hashes[idx] = hash;
+	sysreg_buckets[bucket] = idx + 1U;
+}
+
+/*
+ * Return the index in sysregs[] of the first sysreg installed with @name, or
+ * SYSREG_MAX_CBS if there is none.
+ */
+static unsigned int sysreg_hash_lookup(const char *name)
 {
-	for (unsigned int i = 0U; i < SYSREG_MAX_CBS; i++) {
-		if (strncmp(name, &sysregs[i].name[0],
-			    MAX_SYSREG_NAME_LEN) == 0) {
-
-			/*
-			 * Get a pointer to the register value for the
-			 * current CPU.
-			 */
-			sysregs[i].callbacks.reg =
-					&(sysregs[i].value[current_cpuid]);
-			return &sysregs[i].callbacks;
+	uint32_t hash = sysreg_name_hash(name);
+	unsigned int bucket = hash & (SYSREG_HASH_BUCKETS - 1U);
+
+	while (sysreg_buckets[bucket] != 0U) {
+		unsigned int idx = sysreg_buckets[bucket] - 1U;
+
+		if ((sysreg_hashes[idx] == hash) &&
+		    (strncmp(name, &sysregs[idx].name[0],
+			     MAX_SYSREG_NAME_LEN) == 0)) {
+			return idx;
 		}
+		bucket = (bucket + 1U) & (SYSREG_HASH_BUCKETS - 1U);
+	}
+
+	return SYSREG_MAX_CBS;
+}
+
+static unsigned int sysreg_lookup(const char *name)
+{
+	uintptr_t addr = (uintptr_t)name;
+	unsigned long generation = __atomic_load_n(&sysreg_generation,
+						   __ATOMIC_ACQUIRE);
+	struct sysreg_name_cache_entry *entry = &sysreg_name_cache[
+		(addr ^ (addr >> 8)) & (SYSREG_NAME_CACHE_SIZE - 1U)];
+
+	if ((entry->name != name) || (entry->generation != generation)) {
+		entry->name = name;
+		entry->generation = generation;
+		entry->idx = sysreg_hash_lookup(name);
+	}
+
+	return entry->idx;
+}
+
+static void sysreg_cache_invalidate(void)
+{
+	(void)__atomic_add_fetch(&sysreg_generation, 1UL, __ATOMIC_RELEASE);
+}
+
+struct sysreg_cb *host_util_get_sysreg_cb(char *name)
+{
+	unsigned int i = sysreg_lookup(name);
+
+	if (i == SYSREG_MAX_CBS) {
+		return (struct sysreg_cb *)NULL;
 	}
 
-	return (struct sysreg_cb *)NULL;
+#ifdef HOST_THREADS
+	/*
+	 * Return a per-thread copy of the callbacks, so that the register
+	 * pointer set for the current CPU is not overwritten by another thread
+	 * before it is used.
+	 */
+	static __thread struct sysreg_cb callbacks;
+
+	callbacks = sysregs[i].callbacks;
+	callbacks.reg = &(sysregs[i].value[current_cpuid]);
+	return &callbacks;
+#else
+	/* Get a pointer to the register value for the current CPU */
+	sysregs[i].callbacks.reg = &(sysregs[i].value[current_cpuid]);
+	return &sysregs[i].callbacks;
+#endif
 }
 
 int host_util_set_sysreg_cb(char *name, rd_cb_t rd_cb, wr_cb_t wr_cb,
@@ -78,7 +205,9 @@ int host_util_set_sysreg_cb(char *name, rd_cb_t rd_cb, wr_cb_t wr_cb,
 		 */
 		sysregs[installed_cb_idx].name[MAX_SYSREG_NAME_LEN] = '\0';
 
+		sysreg_hash_insert(installed_cb_idx);
 		++installed_cb_idx;
+		sysreg_cache_invalidate();
 
 		return 0;
 	}
@@ -91,8 +220,10 @@ void host_util_reset_all_sysreg_cb(void)
 
 	(void)memset((void *)sysregs, 0,
 		     sizeof(struct sysreg_data) * SYSREG_MAX_CBS);
+	(void)memset((void *)sysreg_buckets, 0, sizeof(sysreg_buckets));
 
 	installed_cb_idx = 0U;
+	sysreg_cache_invalidate();
 }
 
 int host_util_set_default_sysreg_cb(char *name, u_register_t init)
@@ -103,6 +234,24 @@ int host_util_set_default_sysreg_cb(char *name, u_register_t init)
 
 unsigned long host_util_get_granule_base(void)
 {
+	void *buf;
+
+	if (granules_buffer != NULL) {
+		return (unsigned long)granules_buffer;
+	}
+
+	buf = mmap(NULL, HOST_MEM_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (buf == MAP_FAILED) {
+		ERROR("Failed to reserve 0x%lx bytes of host memory\n",
+		      HOST_MEM_SIZE);
+		panic();
+	}
+
+	/* mmap() returns page aligned memory, the granules must be as well */
+	assert(((uintptr_t)buf & (GRANULE_SIZE - 1UL)) == 0UL);
+
+	granules_buffer = buf;
 	return (unsigned long)granules_buffer;
 }
 
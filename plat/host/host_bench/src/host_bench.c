@@ -0,0 +1,1447 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <attestation.h>
+#include <attestation_token.h>
+#include <debug.h>
+#include <feature.h>
+#include <gic.h>
+#include <granule.h>
+#include <host_defs.h>
+#include <host_utils.h>
+#include <measurement.h>
+#include <memory_alloc.h>
+#include <platform_api.h>
+#ifdef HOST_THREADS
+#include <pthread.h>
+#endif
+#include <realm_attest.h>
+#include <rec.h>
+#include <rmm_el3_ifc.h>
+#include <sizes.h>
+#include <smc-rmi.h>
+#include <smc-rsi.h>
+#include <smc.h>
+#include <status.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <table.h>
+#include <time.h>
+#include <xlat_tables.h>
+
+#define RMM_EL3_IFC_ABI_VERSION		(RMM_EL3_IFC_SUPPORTED_VERSION)
+#ifdef HOST_THREADS
+#define RMM_EL3_MAX_CPUS		(MAX_CPUS)
+#else
+#define RMM_EL3_MAX_CPUS		(1U)
+#endif
+
+/* Default number of operations timed by each benchmark */
+#define BENCH_DEFAULT_OPS		(256UL)
+
+/* Number of REC entries between two attestation tokens of a vCPU */
+#define BENCH_ATTEST_PERIOD		(64UL)
+
+/* Size of the platform token returned by the fake EL3 */
+#define BENCH_PLAT_TOKEN_SIZE		(1024UL)
+
+/*
+ * Realm configuration used by the benchmarks: a 39-bit IPA space with a
+ * single level 1 root RTT, so that every level 3 RTT covers 2MB of IPA
+ * space.
+ */
+#define BENCH_IPA_BITS			(39UL)
+#define BENCH_RTT_LEVEL_START		(1L)
+#define BENCH_L3_MAP_SIZE		(UL(1) << 21)
+
+/* Implemented in init.c and handler.c and needed here */
+void rmm_main(void);
+void rmm_warmboot_main(void);
+void handle_ns_smc(unsigned long function_id,
+		   unsigned long arg0,
+		   unsigned long arg1,
+		   unsigned long arg2,
+		   unsigned long arg3,
+		   unsigned long arg4,
+		   unsigned long arg5,
+		   union smc_regs *regs);
+
+/*
+ * Define and set the Boot Interface arguments.
+ */
+static unsigned char el3_rmm_shared_buffer[PAGE_SIZE] __aligned(PAGE_SIZE);
+
+/*
+ * Create a basic boot manifest.
+ */
+static struct rmm_core_manifest *boot_manifest =
+			(struct rmm_core_manifest *)el3_rmm_shared_buffer;
+
+/*
+ * Buffers of the calls to the fake EL3. RMM uses the shared buffer at a VA
+ * which the fake host does not map, so it is given per-CPU buffers whose VA
+ * is their PA instead.
+ */
+static unsigned char el3_cpu_bufs[RMM_EL3_MAX_CPUS][PAGE_SIZE]
+							__aligned(PAGE_SIZE);
+
+/*
+ * Raw P-384 private key returned as the Realm Attestation Key by the fake
+ * EL3. This is the test key of RFC 6979, A.2.6.
+ */
+static const unsigned char bench_rak[] = {
+	0x6b, 0x9d, 0x3d, 0xad, 0x2e, 0x1b, 0x8c, 0x1c,
+	0x05, 0xb1, 0x98, 0x75, 0xb6, 0x65, 0x9f, 0x4d,
+	0xe2, 0x3c, 0x3b, 0x66, 0x7b, 0xf2, 0x97, 0xba,
+	0x9a, 0xa4, 0x77, 0x40, 0x78, 0x71, 0x37, 0xd8,
+	0x96, 0xd5, 0x72, 0x4e, 0x4c, 0x70, 0xa8, 0x25,
+	0xf8, 0x72, 0xc9, 0xea, 0x60, 0xd2, 0xed, 0xf5
+};
+
+/* Time spent in, and number of, the operations of one benchmark */
+struct bench_timer {
+	const char *name;
+	unsigned long ops;
+	uint64_t ns;
+	uint64_t start;
+#ifdef HOST_COST_MODEL
+	struct host_cost cost;
+	struct host_cost cost_start;
+#endif
+};
+
+/* Realm built by the benchmarks */
+struct bench_realm {
+	unsigned long rd;
+	unsigned long rtt_root;
+	unsigned long rtt_l2;
+	unsigned long *rtt_l3;
+	unsigned long nr_rtt_l3;
+};
+
+/* Next free granule of the host memory, all granules start as NS */
+static unsigned long next_granule;
+
+/* NS granule holding the parameters of every realm created */
+static struct rmi_realm_params *realm_params;
+
+/* Result of the last call made by the current thread */
+static __thread union smc_regs res;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static void timer_start(struct bench_timer *t)
+{
+#ifdef HOST_COST_MODEL
+	host_util_cost_read(&t->cost_start);
+#endif
+	t->start = now_ns();
+}
+
+static void timer_stop(struct bench_timer *t, unsigned long ops)
+{
+	t->ns += now_ns() - t->start;
+	t->ops += ops;
+#ifdef HOST_COST_MODEL
+	host_util_cost_accumulate(&t->cost, &t->cost_start);
+#endif
+}
+
+static void timer_report(struct bench_timer *t)
+{
+	double ns_per_op = (double)t->ns / (double)t->ops;
+
+	printf("%-24s %10lu ops %12.1f ns/op %14.1f ops/s\n",
+		t->name, t->ops, ns_per_op, 1.0e9 / ns_per_op);
+#ifdef HOST_COST_MODEL
+	host_util_cost_report(&t->cost, t->ops);
+#endif
+}
+
+/*
+ * Emulation of the EL3 calls made by the attestation initialisation, which
+ * is done by the first attestation_heap_ctx_assign_pe(), so that the
+ * attestation benchmarks can run.
+ */
+static bool bench_el3_call(unsigned long id, const unsigned long *args,
+			   struct smc_result *smc_res)
+{
+	unsigned char *buf = (unsigned char *)args[0];
+	unsigned long len;
+
+	switch (id) {
+	case SMC_RMM_GET_REALM_ATTEST_KEY:
+		len = sizeof(bench_rak);
+		if (len <= args[1]) {
+			(void)memcpy(buf, bench_rak, len);
+		}
+		break;
+	case SMC_RMM_GET_PLAT_TOKEN:
+		/*
+		 * The platform token is opaque to RMM. Keep the challenge
+		 * written to the buffer by RMM, the hash of the RAK, and pad
+		 * it to the size of a typical token.
+		 */
+		len = BENCH_PLAT_TOKEN_SIZE;
+		if (len <= args[1]) {
+			(void)memset(buf + args[2], 0xa5, len - args[2]);
+		}
+		break;
+	default:
+		return false;
+	}
+
+	/* Any non-zero status is an error for RMM */
+	smc_res->x[0] = (len <= args[1]) ? 0UL : 1UL;
+	smc_res->x[1] = len;
+	return true;
+}
+
+static unsigned long rmi(unsigned long fid, unsigned long arg0,
+			 unsigned long arg1, unsigned long arg2,
+			 unsigned long arg3, unsigned long arg4)
+{
+	handle_ns_smc(fid, arg0, arg1, arg2, arg3, arg4, 0UL, &res);
+	return res.x[0];
+}
+
+/*
+ * The benchmarks only time sequences of calls which succeed, so stop at
+ * the first unexpected failure rather than report meaningless numbers.
+ */
+static void expect_success(unsigned long ret, const char *what)
+{
+	if (ret != RMI_SUCCESS) {
+		ERROR("%s failed: 0x%lx\n", what, ret);
+		exit(1);
+	}
+}
+
+static unsigned long alloc_granule(void)
+{
+	unsigned long addr = next_granule;
+
+	if (addr >= (host_util_get_granule_base() + HOST_MEM_SIZE)) {
+		ERROR("Out of granules\n");
+		exit(1);
+	}
+
+	next_granule += GRANULE_SIZE;
+	return addr;
+}
+
+static unsigned long alloc_delegated_granule(void)
+{
+	unsigned long addr = alloc_granule();
+
+	expect_success(rmi(SMC_RMM_GRANULE_DELEGATE, addr, 0UL, 0UL, 0UL, 0UL),
+			"GRANULE_DELEGATE");
+	return addr;
+}
+
+static void undelegate_granule(unsigned long addr)
+{
+	expect_success(rmi(SMC_RMM_GRANULE_UNDELEGATE, addr, 0UL, 0UL, 0UL, 0UL),
+			"GRANULE_UNDELEGATE");
+}
+
+static void realm_create(struct bench_realm *realm)
+{
+	struct rmi_realm_params *params = realm_params;
+
+	(void)memset(params, 0, sizeof(*params));
+	params->features_0 = INPLACE(RMM_FEATURE_REGISTER_0_S2SZ,
+				     BENCH_IPA_BITS);
+	params->hash_algo = RMI_HASH_ALGO_SHA256;
+	params->vmid = 1U;
+	params->rtt_base = realm->rtt_root;
+	params->rtt_level_start = BENCH_RTT_LEVEL_START;
+	params->rtt_num_start = 1U;
+
+	expect_success(rmi(SMC_RMM_REALM_CREATE, realm->rd,
+			   (unsigned long)params, 0UL, 0UL, 0UL),
+			"REALM_CREATE");
+}
+
+static void realm_destroy(struct bench_realm *realm)
+{
+	expect_success(rmi(SMC_RMM_REALM_DESTROY, realm->rd,
+			   0UL, 0UL, 0UL, 0UL),
+			"REALM_DESTROY");
+}
+
+static void rtt_create(struct bench_realm *realm, unsigned long rtt,
+		       unsigned long map_addr, long level)
+{
+	expect_success(rmi(SMC_RMM_RTT_CREATE, rtt, realm->rd, map_addr,
+			   (unsigned long)level, 0UL),
+			"RTT_CREATE");
+}
+
+static void rtt_destroy(struct bench_realm *realm, unsigned long rtt,
+			unsigned long map_addr, long level)
+{
+	expect_success(rmi(SMC_RMM_RTT_DESTROY, rtt, realm->rd, map_addr,
+			   (unsigned long)level, 0UL),
+			"RTT_DESTROY");
+}
+
+/*
+ * Create a realm whose first @nr_rtt_l3 * 2MB of IPA space is covered by
+ * level 3 RTTs. The granules of the realm are delegated on the first call
+ * and reused when the realm is built again after realm_teardown().
+ */
+static void realm_build(struct bench_realm *realm, unsigned long nr_rtt_l3)
+{
+	if (realm->rd == 0UL) {
+		realm->rd = alloc_delegated_granule();
+		realm->rtt_root = alloc_delegated_granule();
+		realm->rtt_l2 = alloc_delegated_granule();
+		realm->nr_rtt_l3 = nr_rtt_l3;
+		realm->rtt_l3 = calloc(nr_rtt_l3 + 1UL, sizeof(unsigned long));
+		if (realm->rtt_l3 == NULL) {
+			ERROR("Out of memory\n");
+			exit(1);
+		}
+
+		for (unsigned long i = 0UL; i < nr_rtt_l3; i++) {
+			realm->rtt_l3[i] = alloc_delegated_granule();
+		}
+	}
+
+	realm_create(realm);
+	rtt_create(realm, realm->rtt_l2, 0UL, RTT_PAGE_LEVEL - 1L);
+
+	for (unsigned long i = 0UL; i < realm->nr_rtt_l3; i++) {
+		rtt_create(realm, realm->rtt_l3[i], i * BENCH_L3_MAP_SIZE,
+			   RTT_PAGE_LEVEL);
+	}
+}
+
+static void realm_teardown(struct bench_realm *realm)
+{
+	for (unsigned long i = 0UL; i < realm->nr_rtt_l3; i++) {
+		rtt_destroy(realm, realm->rtt_l3[i], i * BENCH_L3_MAP_SIZE,
+			    RTT_PAGE_LEVEL);
+	}
+
+	rtt_destroy(realm, realm->rtt_l2, 0UL, RTT_PAGE_LEVEL - 1L);
+	realm_destroy(realm);
+}
+
+/* Return the granules of a torn down realm to the NS world */
+static void realm_release(struct bench_realm *realm)
+{
+	for (unsigned long i = 0UL; i < realm->nr_rtt_l3; i++) {
+		undelegate_granule(realm->rtt_l3[i]);
+	}
+
+	undelegate_granule(realm->rtt_l2);
+	undelegate_granule(realm->rtt_root);
+	undelegate_granule(realm->rd);
+
+	free(realm->rtt_l3);
+	(void)memset(realm, 0, sizeof(*realm));
+}
+
+static void bench_granule_delegate(unsigned long nr_ops)
+{
+	struct bench_timer delegate = { .name = "GRANULE_DELEGATE" };
+	struct bench_timer undelegate = { .name = "GRANULE_UNDELEGATE" };
+	unsigned long base = alloc_granule();
+
+	for (unsigned long i = 1UL; i < nr_ops; i++) {
+		(void)alloc_granule();
+	}
+
+	timer_start(&delegate);
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		expect_success(rmi(SMC_RMM_GRANULE_DELEGATE,
+				   base + (i * GRANULE_SIZE),
+				   0UL, 0UL, 0UL, 0UL),
+				"GRANULE_DELEGATE");
+	}
+	timer_stop(&delegate, nr_ops);
+
+	timer_start(&undelegate);
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		expect_success(rmi(SMC_RMM_GRANULE_UNDELEGATE,
+				   base + (i * GRANULE_SIZE),
+				   0UL, 0UL, 0UL, 0UL),
+				"GRANULE_UNDELEGATE");
+	}
+	timer_stop(&undelegate, nr_ops);
+
+	timer_report(&delegate);
+	timer_report(&undelegate);
+}
+
+static void bench_realm_create(unsigned long nr_ops)
+{
+	struct bench_timer create = { .name = "REALM_CREATE" };
+	struct bench_timer destroy = { .name = "REALM_DESTROY" };
+	struct bench_realm realm = { 0 };
+
+	realm.rd = alloc_delegated_granule();
+	realm.rtt_root = alloc_delegated_granule();
+
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		timer_start(&create);
+		realm_create(&realm);
+		timer_stop(&create, 1UL);
+
+		timer_start(&destroy);
+		realm_destroy(&realm);
+		timer_stop(&destroy, 1UL);
+	}
+
+	undelegate_granule(realm.rtt_root);
+	undelegate_granule(realm.rd);
+
+	timer_report(&create);
+	timer_report(&destroy);
+}
+
+static void bench_rtt(unsigned long nr_ops)
+{
+	struct bench_timer create = { .name = "RTT_CREATE" };
+	struct bench_timer destroy = { .name = "RTT_DESTROY" };
+	struct bench_timer fold = { .name = "RTT_FOLD" };
+	struct bench_realm realm = { 0 };
+	unsigned long rtt;
+
+	/* A level 2 RTT has room for S2TTES_PER_S2TT level 3 RTTs */
+	if (nr_ops > (unsigned long)S2TTES_PER_S2TT) {
+		nr_ops = (unsigned long)S2TTES_PER_S2TT;
+	}
+
+	realm_build(&realm, 0UL);
+	rtt = alloc_delegated_granule();
+
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		unsigned long map_addr = i * BENCH_L3_MAP_SIZE;
+
+		timer_start(&create);
+		rtt_create(&realm, rtt, map_addr, RTT_PAGE_LEVEL);
+		timer_stop(&create, 1UL);
+
+		timer_start(&destroy);
+		rtt_destroy(&realm, rtt, map_addr, RTT_PAGE_LEVEL);
+		timer_stop(&destroy, 1UL);
+
+		/* A new level 3 RTT is homogeneous and can be folded */
+		rtt_create(&realm, rtt, map_addr, RTT_PAGE_LEVEL);
+
+		timer_start(&fold);
+		expect_success(rmi(SMC_RMM_RTT_FOLD, rtt, realm.rd, map_addr,
+				   (unsigned long)RTT_PAGE_LEVEL, 0UL),
+				"RTT_FOLD");
+		timer_stop(&fold, 1UL);
+	}
+
+	undelegate_granule(rtt);
+	realm_teardown(&realm);
+	realm_release(&realm);
+
+	timer_report(&create);
+	timer_report(&destroy);
+	timer_report(&fold);
+}
+
+static void bench_data_create(unsigned long nr_ops)
+{
+	struct bench_timer create = { .name = "DATA_CREATE" };
+	struct bench_timer destroy = { .name = "DATA_DESTROY" };
+	struct bench_realm realm = { 0 };
+	unsigned long nr_rtt_l3 = (nr_ops + S2TTES_PER_S2TT - 1UL) /
+				  S2TTES_PER_S2TT;
+	unsigned long *data;
+	unsigned char *src;
+
+	data = calloc(nr_ops, sizeof(unsigned long));
+	if (data == NULL) {
+		ERROR("Out of memory\n");
+		exit(1);
+	}
+
+	realm_build(&realm, nr_rtt_l3);
+
+	/* The same NS page is measured into every granule of the image */
+	src = (unsigned char *)alloc_granule();
+	for (unsigned long i = 0UL; i < GRANULE_SIZE; i++) {
+		src[i] = (unsigned char)i;
+	}
+
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		data[i] = alloc_delegated_granule();
+	}
+
+	timer_start(&create);
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		expect_success(rmi(SMC_RMM_DATA_CREATE, data[i], realm.rd,
+				   i * GRANULE_SIZE, (unsigned long)src,
+				   RMI_MEASURE_CONTENT),
+				"DATA_CREATE");
+	}
+	timer_stop(&create, nr_ops);
+
+	timer_start(&destroy);
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		expect_success(rmi(SMC_RMM_DATA_DESTROY, realm.rd,
+				   i * GRANULE_SIZE, 0UL, 0UL, 0UL),
+				"DATA_DESTROY");
+	}
+	timer_stop(&destroy, nr_ops);
+
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		undelegate_granule(data[i]);
+	}
+
+	realm_teardown(&realm);
+	realm_release(&realm);
+	free(data);
+
+	timer_report(&create);
+	timer_report(&destroy);
+}
+
+static void bench_rec(unsigned long nr_ops)
+{
+	struct bench_timer create = { .name = "REC_CREATE" };
+	struct bench_timer destroy = { .name = "REC_DESTROY" };
+	struct bench_timer enter = { .name = "REC_ENTER" };
+	struct bench_realm realm = { 0 };
+	struct rmi_rec_params *params;
+	struct rmi_rec_run *run;
+	unsigned long rec, num_aux;
+
+	realm_build(&realm, 0UL);
+	expect_success(rmi(SMC_RMM_REC_AUX_COUNT, realm.rd,
+			   0UL, 0UL, 0UL, 0UL),
+			"REC_AUX_COUNT");
+	num_aux = res.x[1];
+	realm_teardown(&realm);
+
+	params = (struct rmi_rec_params *)alloc_granule();
+	(void)memset(params, 0, sizeof(*params));
+	params->flags = REC_PARAMS_FLAG_RUNNABLE;
+	params->num_aux = num_aux;
+	for (unsigned long i = 0UL; i < num_aux; i++) {
+		params->aux[i] = alloc_delegated_granule();
+	}
+
+	rec = alloc_delegated_granule();
+
+	/*
+	 * The index of a REC is fixed by the number of RECs already created
+	 * in the realm, so REC_CREATE is timed on a new realm each time.
+	 */
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		realm_build(&realm, 0UL);
+
+		timer_start(&create);
+		expect_success(rmi(SMC_RMM_REC_CREATE, rec, realm.rd,
+				   (unsigned long)params, 0UL, 0UL),
+				"REC_CREATE");
+		timer_stop(&create, 1UL);
+
+		timer_start(&destroy);
+		expect_success(rmi(SMC_RMM_REC_DESTROY, rec,
+				   0UL, 0UL, 0UL, 0UL),
+				"REC_DESTROY");
+		timer_stop(&destroy, 1UL);
+
+		realm_teardown(&realm);
+	}
+
+	realm_build(&realm, 0UL);
+	expect_success(rmi(SMC_RMM_REC_CREATE, rec, realm.rd,
+			   (unsigned long)params, 0UL, 0UL),
+			"REC_CREATE");
+	expect_success(rmi(SMC_RMM_REALM_ACTIVATE, realm.rd,
+			   0UL, 0UL, 0UL, 0UL),
+			"REALM_ACTIVATE");
+
+	run = (struct rmi_rec_run *)alloc_granule();
+	(void)memset(run, 0, sizeof(*run));
+
+	/*
+	 * The fake_host Realm takes an exception with an unknown reason as
+	 * soon as it is entered, so each REC_ENTER is a full entry and exit
+	 * round trip back to the Host.
+	 */
+	timer_start(&enter);
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		expect_success(rmi(SMC_RMM_REC_ENTER, rec, (unsigned long)run,
+				   0UL, 0UL, 0UL),
+				"REC_ENTER");
+	}
+	timer_stop(&enter, nr_ops);
+
+	expect_success(rmi(SMC_RMM_REC_DESTROY, rec, 0UL, 0UL, 0UL, 0UL),
+			"REC_DESTROY");
+	undelegate_granule(rec);
+
+	for (unsigned long i = 0UL; i < num_aux; i++) {
+		undelegate_granule(params->aux[i]);
+	}
+
+	realm_teardown(&realm);
+	realm_release(&realm);
+
+	timer_report(&create);
+	timer_report(&destroy);
+	timer_report(&enter);
+}
+
+/*
+ * Time the creation and signing of Realm tokens, as done for
+ * RSI_ATTEST_TOKEN_INIT and RSI_ATTEST_TOKEN_CONTINUE, on the current CPU.
+ * The ops/s reported is the number of signatures per second on one core.
+ */
+static void bench_attest_sign(unsigned long nr_ops)
+{
+	static struct buffer_alloc_ctx heap_ctx;
+	static unsigned char heap[REC_HEAP_PAGES * SZ_4K]
+					__aligned(sizeof(unsigned long));
+	static unsigned char measurements[MEASUREMENT_SLOT_NR]
+					 [MAX_MEASUREMENT_SIZE];
+	static struct attest_realm_claims claims;
+	static struct token_sign_ctx sign_ctx;
+	static unsigned char token_buf[SZ_1K];
+	struct bench_timer sign = { .name = "ATTEST_TOKEN_SIGN" };
+	struct q_useful_buf_c rpv = { measurements[0], RPV_SIZE };
+	struct q_useful_buf_c token;
+	enum attest_token_err_t ret;
+
+	if (attestation_heap_ctx_assign_pe(&heap_ctx) != 0) {
+		printf("%-24s skipped, attestation is not initialised\n",
+			sign.name);
+		return;
+	}
+
+	if (attest_realm_claims_create(HASH_ALGO_SHA256,
+				measurements[RIM_MEASUREMENT_SLOT],
+				&rpv, &claims) != 0) {
+		printf("attest_realm_claims_create failed\n");
+		exit(1);
+	}
+
+	for (unsigned long i = 0UL; i < nr_ops; i++) {
+		struct q_useful_buf buf = { token_buf, sizeof(token_buf) };
+
+		/* Each token starts from a clean heap, as for a new REC */
+		(void)attestation_heap_ctx_init(heap, sizeof(heap));
+
+		timer_start(&sign);
+		if (attest_realm_token_create(HASH_ALGO_SHA256, measurements,
+					      MEASUREMENT_SLOT_NR, &claims,
+					      &sign_ctx, &buf) != 0) {
+			printf("attest_realm_token_create failed\n");
+			exit(1);
+		}
+
+		attest_realm_token_sign_continue_start();
+		do {
+			ret = attest_realm_token_sign(&sign_ctx.ctx, &token);
+		} while (ret == ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS);
+		attest_realm_token_sign_continue_finish();
+		timer_stop(&sign, 1UL);
+
+		if (ret != ATTEST_TOKEN_ERR_SUCCESS) {
+			printf("attest_realm_token_sign failed (%d)\n", ret);
+			exit(1);
+		}
+	}
+
+	(void)attestation_heap_ctx_unassign_pe(&heap_ctx);
+
+	timer_report(&sign);
+}
+
+/* Progress of the Realm emulated by bench_attest_realm_run() */
+struct bench_attest {
+	unsigned long token_ipa;
+	/* Last RSI call made by the emulated Realm, 0 before the first one */
+	unsigned long last_fid;
+	unsigned long tokens;
+	unsigned long continues;
+	unsigned long errors;
+	/* Time taken by RMM to handle each kind of attestation call */
+	uint64_t init_ns;
+	uint64_t continue_ns;
+	/* Time of the last exit of the emulated Realm */
+	uint64_t exit_ns;
+};
+
+static struct bench_attest bench_attest;
+
+/*
+ * Emulation of the Realm run by bench_attest_token(). On each entry the
+ * Realm gets an attestation token with RSI_ATTEST_TOKEN_INIT and as many
+ * RSI_ATTEST_TOKEN_CONTINUE as RMM asks for, and then exits to the Host
+ * with RSI_HOST_CALL. The time from an exit of the Realm to the next entry
+ * is the time RMM took to handle the RSI call. regs[0] holds the result of
+ * the previous call.
+ */
+static int bench_attest_realm_run(unsigned long *regs)
+{
+	struct bench_attest *ba = &bench_attest;
+	uint64_t ns = now_ns() - ba->exit_ns;
+	unsigned long fid;
+
+	switch (ba->last_fid) {
+	case SMC_RSI_ATTEST_TOKEN_INIT:
+		ba->init_ns += ns;
+		if (regs[0] == RSI_SUCCESS) {
+			fid = SMC_RSI_ATTEST_TOKEN_CONTINUE;
+		} else {
+			ba->errors++;
+			fid = SMC_RSI_HOST_CALL;
+		}
+		break;
+	case SMC_RSI_ATTEST_TOKEN_CONTINUE:
+		ba->continue_ns += ns;
+		ba->continues++;
+		if (regs[0] == RSI_INCOMPLETE) {
+			fid = SMC_RSI_ATTEST_TOKEN_CONTINUE;
+			break;
+		}
+
+		if (regs[0] == RSI_SUCCESS) {
+			ba->tokens++;
+		} else {
+			ba->errors++;
+		}
+		fid = SMC_RSI_HOST_CALL;
+		break;
+	default:
+		/* First entry, or entry after a host call */
+		fid = SMC_RSI_ATTEST_TOKEN_INIT;
+		break;
+	}
+
+	/* The host call structure overwrites the token, which is not used */
+	regs[0] = fid;
+	regs[1] = ba->token_ipa;
+	/* Use the default size of the token buffer */
+	regs[10] = 0UL;
+	ba->last_fid = fid;
+
+	write_esr_el2(ESR_EL2_EC_SMC);
+	ba->exit_ns = now_ns();
+	return ARM_EXCEPTION_SYNC_LEL;
+}
+
+/*
+ * Time the attestation tokens of a Realm as it gets them, through
+ * RSI_ATTEST_TOKEN_INIT and RSI_ATTEST_TOKEN_CONTINUE calls handled in
+ * REC_ENTER, so that the time-slicing of the signing in RSI_ATTEST_TOKEN_
+ * CONTINUE is included. Each token ends with an exit to the Host. Along
+ * with the number of tokens per second, report the number of CONTINUE calls
+ * per token, the peak usage of the heap of the REC and how the time of a
+ * token splits between INIT, where the claims are encoded with QCBOR and the
+ * t_cose signing is set up, and CONTINUE, where the signature is computed by
+ * mbedtls before the COSE_Sign1 and CCA tokens are completed.
+ */
+static void bench_attest_token(unsigned long nr_ops)
+{
+	static struct buffer_alloc_ctx heap_ctx;
+	struct bench_timer token = { .name = "ATTEST_TOKEN" };
+	struct bench_attest *ba = &bench_attest;
+	struct bench_realm realm = { 0 };
+	struct rmi_rec_params *params;
+	struct rmi_rec_run *run;
+	unsigned long aux[MAX_REC_AUX_GRANULES];
+	unsigned long rec, data, num_aux;
+	unsigned char *src;
+	size_t heap_peak;
+
+	if (attestation_heap_ctx_assign_pe(&heap_ctx) != 0) {
+		printf("%-24s skipped, attestation is not initialised\n",
+			token.name);
+		return;
+	}
+	(void)attestation_heap_ctx_unassign_pe(&heap_ctx);
+
+	realm_build(&realm, 1UL);
+	expect_success(rmi(SMC_RMM_REC_AUX_COUNT, realm.rd,
+			   0UL, 0UL, 0UL, 0UL),
+			"REC_AUX_COUNT");
+	num_aux = res.x[1];
+
+	(void)memset(ba, 0, sizeof(*ba));
+	ba->token_ipa = 0UL;
+
+	src = (unsigned char *)alloc_granule();
+	(void)memset(src, 0, GRANULE_SIZE);
+	data = alloc_delegated_granule();
+
+	expect_success(rmi(SMC_RMM_RTT_INIT_RIPAS, realm.rd, ba->token_ipa,
+			   3UL, 0UL, 0UL),
+			"RTT_INIT_RIPAS");
+	expect_success(rmi(SMC_RMM_DATA_CREATE, data, realm.rd, ba->token_ipa,
+			   (unsigned long)src, RMI_NO_MEASURE_CONTENT),
+			"DATA_CREATE");
+
+	params = (struct rmi_rec_params *)alloc_granule();
+	(void)memset(params, 0, sizeof(*params));
+	params->flags = REC_PARAMS_FLAG_RUNNABLE;
+	params->num_aux = num_aux;
+	for (unsigned long i = 0UL; i < num_aux; i++) {
+		aux[i] = alloc_delegated_granule();
+		params->aux[i] = aux[i];
+	}
+
+	rec = alloc_delegated_granule();
+	expect_success(rmi(SMC_RMM_REC_CREATE, rec, realm.rd,
+			   (unsigned long)params, 0UL, 0UL),
+			"REC_CREATE");
+	expect_success(rmi(SMC_RMM_REALM_ACTIVATE, realm.rd,
+			   0UL, 0UL, 0UL, 0UL),
+			"REALM_ACTIVATE");
+
+	run = (struct rmi_rec_run *)alloc_granule();
+	(void)memset(run, 0, sizeof(*run));
+
+	host_util_set_realm_cb(bench_attest_realm_run);
+
+	timer_start(&token);
+	while ((ba->tokens + ba->errors) < nr_ops) {
+		expect_success(rmi(SMC_RMM_REC_ENTER, rec, (unsigned long)run,
+				   0UL, 0UL, 0UL),
+				"REC_ENTER");
+		if (run->exit.exit_reason != RMI_EXIT_HOST_CALL) {
+			ERROR("Unexpected REC exit %lu\n",
+				run->exit.exit_reason);
+			exit(1);
+		}
+	}
+	timer_stop(&token, ba->tokens);
+
+	host_util_set_realm_cb(NULL);
+
+	/* The statistics of the heap are kept in the REC, which is not running */
+	heap_peak = ((struct rec *)rec)->alloc_info.ctx.stats.peak_bytes;
+
+	expect_success(rmi(SMC_RMM_REC_DESTROY, rec, 0UL, 0UL, 0UL, 0UL),
+			"REC_DESTROY");
+	expect_success(rmi(SMC_RMM_DATA_DESTROY, realm.rd, ba->token_ipa,
+			   0UL, 0UL, 0UL),
+			"DATA_DESTROY");
+	realm_teardown(&realm);
+	realm_release(&realm);
+
+	undelegate_granule(rec);
+	undelegate_granule(data);
+	for (unsigned long i = 0UL; i < num_aux; i++) {
+		undelegate_granule(aux[i]);
+	}
+
+	if (ba->tokens == 0UL) {
+		ERROR("No attestation token, %lu errors\n", ba->errors);
+		exit(1);
+	}
+
+	timer_report(&token);
+	printf("%-24s %10.2f CONTINUE per token %8lu errors %8zu heap peak bytes\n",
+		"", (double)ba->continues / (double)ba->tokens, ba->errors,
+		heap_peak);
+	printf("%-24s INIT %.1f us, CONTINUE %.1f us, other %.1f us per token\n",
+		"", (double)ba->init_ns / (1e3 * (double)ba->tokens),
+		(double)ba->continue_ns / (1e3 * (double)ba->tokens),
+		((double)(token.ns - ba->init_ns - ba->continue_ns)) /
+			(1e3 * (double)ba->tokens));
+}
+
+#ifdef HOST_THREADS
+/* A simulated PE issuing DATA_CREATE into a shared realm */
+struct bench_pe {
+	pthread_t thread;
+	unsigned int cpuid;
+	unsigned long rd;
+	unsigned long ipa_base;
+	unsigned long src;
+	unsigned long *data;
+	/* Latency of each call, in ns */
+	uint64_t *lat;
+	unsigned long nr_ops;
+};
+
+static pthread_barrier_t pe_barrier;
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Print the latency percentiles of the @nr calls recorded in @lat */
+static void report_latency(uint64_t *lat, unsigned long nr)
+{
+	qsort(lat, nr, sizeof(uint64_t), cmp_u64);
+
+	printf("%-24s p50 %lu p99 %lu p99.9 %lu max %lu ns\n", "",
+		(unsigned long)lat[nr / 2UL],
+		(unsigned long)lat[(nr * 99UL) / 100UL],
+		(unsigned long)lat[(nr * 999UL) / 1000UL],
+		(unsigned long)lat[nr - 1UL]);
+}
+
+static void *bench_pe_data_create(void *arg)
+{
+	struct bench_pe *pe = arg;
+
+	host_util_set_cpuid(pe->cpuid);
+	(void)pthread_barrier_wait(&pe_barrier);
+
+	for (unsigned long i = 0UL; i < pe->nr_ops; i++) {
+		uint64_t start = now_ns();
+
+		expect_success(rmi(SMC_RMM_DATA_CREATE, pe->data[i], pe->rd,
+				   pe->ipa_base + (i * GRANULE_SIZE), pe->src,
+				   RMI_MEASURE_CONTENT),
+				"DATA_CREATE");
+		pe->lat[i] = now_ns() - start;
+	}
+
+	return NULL;
+}
+
+/*
+ * Run DATA_CREATE concurrently from 1, 2, 4... RMM_EL3_MAX_CPUS PEs into
+ * a single realm, each PE populating its own level 3 RTT. All the calls
+ * take the same RD lock and walk the RTTs from the same root, so the
+ * throughput, the tail latency and the number of contended lock
+ * acquisitions show how the locking scales.
+ */
+static void bench_data_create_mt(unsigned long nr_ops)
+{
+	static struct bench_pe pes[RMM_EL3_MAX_CPUS];
+	unsigned long *data;
+	uint64_t *lat;
+	unsigned char *src;
+
+	if (nr_ops > (unsigned long)S2TTES_PER_S2TT) {
+		nr_ops = (unsigned long)S2TTES_PER_S2TT;
+	}
+
+	data = calloc(nr_ops * RMM_EL3_MAX_CPUS, sizeof(unsigned long));
+	lat = calloc(nr_ops * RMM_EL3_MAX_CPUS, sizeof(uint64_t));
+	if ((data == NULL) || (lat == NULL)) {
+		ERROR("Out of memory\n");
+		exit(1);
+	}
+
+	src = (unsigned char *)alloc_granule();
+	for (unsigned long i = 0UL; i < GRANULE_SIZE; i++) {
+		src[i] = (unsigned char)i;
+	}
+
+	for (unsigned long i = 0UL; i < (nr_ops * RMM_EL3_MAX_CPUS); i++) {
+		data[i] = alloc_delegated_granule();
+	}
+
+	for (unsigned int nr_pes = 1U; nr_pes <= RMM_EL3_MAX_CPUS;
+	     nr_pes *= 2U) {
+		struct bench_timer create = { 0 };
+		struct bench_realm realm = { 0 };
+		unsigned long contended;
+		char name[32];
+
+		(void)snprintf(name, sizeof(name), "DATA_CREATE x%u", nr_pes);
+		create.name = name;
+
+		realm_build(&realm, nr_pes);
+		(void)pthread_barrier_init(&pe_barrier, NULL, nr_pes + 1U);
+
+		for (unsigned int i = 0U; i < nr_pes; i++) {
+			pes[i].cpuid = i;
+			pes[i].rd = realm.rd;
+			pes[i].ipa_base = i * BENCH_L3_MAP_SIZE;
+			pes[i].src = (unsigned long)src;
+			pes[i].data = &data[i * nr_ops];
+			pes[i].lat = &lat[i * nr_ops];
+			pes[i].nr_ops = nr_ops;
+
+			if (pthread_create(&pes[i].thread, NULL,
+					   bench_pe_data_create, &pes[i]) != 0) {
+				ERROR("Cannot create PE thread\n");
+				exit(1);
+			}
+		}
+
+		contended = host_util_get_spinlock_contended();
+
+		timer_start(&create);
+		(void)pthread_barrier_wait(&pe_barrier);
+		for (unsigned int i = 0U; i < nr_pes; i++) {
+			(void)pthread_join(pes[i].thread, NULL);
+		}
+		timer_stop(&create, nr_ops * nr_pes);
+
+		contended = host_util_get_spinlock_contended() - contended;
+		(void)pthread_barrier_destroy(&pe_barrier);
+
+		for (unsigned int i = 0U; i < nr_pes; i++) {
+			for (unsigned long j = 0UL; j < nr_ops; j++) {
+				expect_success(rmi(SMC_RMM_DATA_DESTROY, realm.rd,
+						   pes[i].ipa_base +
+						   (j * GRANULE_SIZE),
+						   0UL, 0UL, 0UL),
+						"DATA_DESTROY");
+			}
+		}
+
+		realm_teardown(&realm);
+		realm_release(&realm);
+
+		timer_report(&create);
+		printf("%-24s %10lu contended lock acquisitions\n", "",
+			contended);
+		report_latency(lat, nr_ops * nr_pes);
+	}
+
+	for (unsigned long i = 0UL; i < (nr_ops * RMM_EL3_MAX_CPUS); i++) {
+		undelegate_granule(data[i]);
+	}
+
+	free(lat);
+	free(data);
+}
+
+/* A simulated PE running one REC of a realm shared with the other PEs */
+struct bench_vcpu {
+	pthread_t thread;
+	unsigned int cpuid;
+	unsigned long rec;
+	struct rmi_rec_run *run;
+	unsigned long aux[MAX_REC_AUX_GRANULES];
+	/* DATA granules holding the host call structure and the token */
+	unsigned long data;
+	unsigned long token;
+	unsigned long data_ipa;
+	unsigned long token_ipa;
+	unsigned long nr_ops;
+	/* Last RSI call made by the emulated Realm, 0 before the first one */
+	unsigned long last_fid;
+	unsigned long entries;
+	unsigned long tokens;
+	unsigned long errors;
+	uint64_t ns;
+};
+
+/* vCPU run by the current thread, and how often it asks for a token */
+static __thread struct bench_vcpu *cur_vcpu;
+static unsigned long attest_period;
+
+/*
+ * Emulation of the Realm run by bench_rec_enter_mt(). On each entry the
+ * vCPU reads the RIPAS of its data granule with RSI_IPA_STATE_GET, gets an
+ * attestation token once every attest_period entries and then exits to the
+ * Host with RSI_HOST_CALL. regs[0] holds the result of the previous call.
+ */
+static int bench_realm_run(unsigned long *regs)
+{
+	struct bench_vcpu *vcpu = cur_vcpu;
+	unsigned long fid;
+
+	switch (vcpu->last_fid) {
+	case SMC_RSI_IPA_STATE_GET:
+		if (regs[0] != RSI_SUCCESS) {
+			vcpu->errors++;
+		}
+
+		if ((attest_period != 0UL) &&
+		    ((vcpu->entries % attest_period) == 0UL)) {
+			fid = SMC_RSI_ATTEST_TOKEN_INIT;
+		} else {
+			fid = SMC_RSI_HOST_CALL;
+		}
+		break;
+	case SMC_RSI_ATTEST_TOKEN_INIT:
+		if (regs[0] == RSI_SUCCESS) {
+			fid = SMC_RSI_ATTEST_TOKEN_CONTINUE;
+		} else {
+			vcpu->errors++;
+			fid = SMC_RSI_HOST_CALL;
+		}
+		break;
+	case SMC_RSI_ATTEST_TOKEN_CONTINUE:
+		if (regs[0] == RSI_INCOMPLETE) {
+			fid = SMC_RSI_ATTEST_TOKEN_CONTINUE;
+			break;
+		}
+
+		if (regs[0] == RSI_SUCCESS) {
+			vcpu->tokens++;
+		} else {
+			vcpu->errors++;
+		}
+		fid = SMC_RSI_HOST_CALL;
+		break;
+	default:
+		/* First entry, or entry after a host call */
+		fid = SMC_RSI_IPA_STATE_GET;
+		break;
+	}
+
+	regs[0] = fid;
+	regs[1] = ((fid == SMC_RSI_ATTEST_TOKEN_INIT) ||
+		   (fid == SMC_RSI_ATTEST_TOKEN_CONTINUE)) ?
+			vcpu->token_ipa : vcpu->data_ipa;
+	/* Use the default size of the token buffer */
+	regs[10] = 0UL;
+	vcpu->last_fid = fid;
+
+	write_esr_el2(ESR_EL2_EC_SMC);
+	return ARM_EXCEPTION_SYNC_LEL;
+}
+
+static void *bench_pe_rec_enter(void *arg)
+{
+	struct bench_vcpu *vcpu = arg;
+	uint64_t start;
+
+	host_util_set_cpuid(vcpu->cpuid);
+	cur_vcpu = vcpu;
+	(void)pthread_barrier_wait(&pe_barrier);
+
+	start = now_ns();
+	for (unsigned long i = 0UL; i < vcpu->nr_ops; i++) {
+		expect_success(rmi(SMC_RMM_REC_ENTER, vcpu->rec,
+				   (unsigned long)vcpu->run, 0UL, 0UL, 0UL),
+				"REC_ENTER");
+		if (vcpu->run->exit.exit_reason != RMI_EXIT_HOST_CALL) {
+			vcpu->errors++;
+		}
+		vcpu->entries++;
+	}
+	vcpu->ns = now_ns() - start;
+
+	return NULL;
+}
+
+/*
+ * Run REC_ENTER concurrently from 1, 2, 4... RMM_EL3_MAX_CPUS PEs, each PE
+ * running its own REC of a single realm. The Realm is emulated by
+ * bench_realm_run(), so that each entry goes through rec_run_loop() and the
+ * handling of RSI_IPA_STATE_GET, of RSI_HOST_CALL and, periodically, of the
+ * attestation calls, which all take the RD lock or walk the RTTs from the
+ * root. The per-PE throughput and the time spent waiting for the RD and
+ * root RTT locks show how the Realm exit path scales.
+ */
+static void bench_rec_enter_mt(unsigned long nr_ops)
+{
+	static struct bench_vcpu vcpus[RMM_EL3_MAX_CPUS];
+	static struct buffer_alloc_ctx heap_ctx;
+	struct bench_realm realm = { 0 };
+	struct rmi_rec_params *params;
+	unsigned char *src;
+	unsigned long num_aux;
+
+	if (attestation_heap_ctx_assign_pe(&heap_ctx) == 0) {
+		(void)attestation_heap_ctx_unassign_pe(&heap_ctx);
+		attest_period = BENCH_ATTEST_PERIOD;
+	} else {
+		printf("%-24s attestation is not initialised, no tokens\n",
+			"REC_ENTER");
+		attest_period = 0UL;
+	}
+
+	realm_build(&realm, 0UL);
+	expect_success(rmi(SMC_RMM_REC_AUX_COUNT, realm.rd,
+			   0UL, 0UL, 0UL, 0UL),
+			"REC_AUX_COUNT");
+	num_aux = res.x[1];
+	realm_teardown(&realm);
+	realm_release(&realm);
+
+	params = (struct rmi_rec_params *)alloc_granule();
+	src = (unsigned char *)alloc_granule();
+	(void)memset(src, 0, GRANULE_SIZE);
+
+	/* Two granules of IPA space per vCPU, all in the first level 3 RTT */
+	for (unsigned int i = 0U; i < RMM_EL3_MAX_CPUS; i++) {
+		vcpus[i].cpuid = i;
+		vcpus[i].rec = alloc_delegated_granule();
+		vcpus[i].run = (struct rmi_rec_run *)alloc_granule();
+		vcpus[i].data = alloc_delegated_granule();
+		vcpus[i].token = alloc_delegated_granule();
+		vcpus[i].data_ipa = 2UL * i * GRANULE_SIZE;
+		vcpus[i].token_ipa = vcpus[i].data_ipa + GRANULE_SIZE;
+		vcpus[i].nr_ops = nr_ops;
+
+		for (unsigned long j = 0UL; j < num_aux; j++) {
+			vcpus[i].aux[j] = alloc_delegated_granule();
+		}
+	}
+
+	host_util_set_realm_cb(bench_realm_run);
+
+	for (unsigned int nr_pes = 1U; nr_pes <= RMM_EL3_MAX_CPUS;
+	     nr_pes *= 2U) {
+		struct bench_timer enter = { 0 };
+		unsigned long contended;
+		char name[32];
+
+		(void)snprintf(name, sizeof(name), "REC_ENTER x%u", nr_pes);
+		enter.name = name;
+
+		realm_build(&realm, 1UL);
+
+		for (unsigned int i = 0U; i < nr_pes; i++) {
+			struct bench_vcpu *vcpu = &vcpus[i];
+
+			for (unsigned long ipa = vcpu->data_ipa;
+			     ipa <= vcpu->token_ipa; ipa += GRANULE_SIZE) {
+				expect_success(rmi(SMC_RMM_RTT_INIT_RIPAS,
+						   realm.rd, ipa, 3UL,
+						   0UL, 0UL),
+						"RTT_INIT_RIPAS");
+			}
+
+			expect_success(rmi(SMC_RMM_DATA_CREATE, vcpu->data,
+					   realm.rd, vcpu->data_ipa,
+					   (unsigned long)src,
+					   RMI_NO_MEASURE_CONTENT),
+					"DATA_CREATE");
+			expect_success(rmi(SMC_RMM_DATA_CREATE, vcpu->token,
+					   realm.rd, vcpu->token_ipa,
+					   (unsigned long)src,
+					   RMI_NO_MEASURE_CONTENT),
+					"DATA_CREATE");
+
+			/* The MPIDR gives the REC index, i.e. i */
+			(void)memset(params, 0, sizeof(*params));
+			params->flags = REC_PARAMS_FLAG_RUNNABLE;
+			params->mpidr = i;
+			params->num_aux = num_aux;
+			for (unsigned long j = 0UL; j < num_aux; j++) {
+				params->aux[j] = vcpu->aux[j];
+			}
+
+			expect_success(rmi(SMC_RMM_REC_CREATE, vcpu->rec,
+					   realm.rd, (unsigned long)params,
+					   0UL, 0UL),
+					"REC_CREATE");
+
+			(void)memset(vcpu->run, 0, sizeof(*vcpu->run));
+			vcpu->last_fid = 0UL;
+			vcpu->entries = 0UL;
+			vcpu->tokens = 0UL;
+			vcpu->errors = 0UL;
+		}
+
+		expect_success(rmi(SMC_RMM_REALM_ACTIVATE, realm.rd,
+				   0UL, 0UL, 0UL, 0UL),
+				"REALM_ACTIVATE");
+
+		host_util_spinlock_watch(0U, &addr_to_granule(realm.rd)->lock);
+		host_util_spinlock_watch(1U,
+				&addr_to_granule(realm.rtt_root)->lock);
+		(void)pthread_barrier_init(&pe_barrier, NULL, nr_pes + 1U);
+
+		for (unsigned int i = 0U; i < nr_pes; i++) {
+			if (pthread_create(&vcpus[i].thread, NULL,
+					   bench_pe_rec_enter, &vcpus[i]) != 0) {
+				ERROR("Cannot create PE thread\n");
+				exit(1);
+			}
+		}
+
+		contended = host_util_get_spinlock_contended();
+
+		timer_start(&enter);
+		(void)pthread_barrier_wait(&pe_barrier);
+		for (unsigned int i = 0U; i < nr_pes; i++) {
+			(void)pthread_join(vcpus[i].thread, NULL);
+		}
+		timer_stop(&enter, nr_ops * nr_pes);
+
+		contended = host_util_get_spinlock_contended() - contended;
+		(void)pthread_barrier_destroy(&pe_barrier);
+
+		timer_report(&enter);
+		for (unsigned int i = 0U; i < nr_pes; i++) {
+			printf("%-24s PE%-2u %12.0f ops/s %6lu tokens %6lu errors\n",
+				"", i,
+				((double)nr_ops * 1e9) / (double)vcpus[i].ns,
+				vcpus[i].tokens, vcpus[i].errors);
+		}
+		printf("%-24s %10lu contended lock acquisitions\n", "",
+			contended);
+		printf("%-24s RD lock wait %.1f ns/op, root RTT lock wait %.1f ns/op\n",
+			"",
+			(double)host_util_get_spinlock_wait_ns(0U) /
+				(double)(nr_ops * nr_pes),
+			(double)host_util_get_spinlock_wait_ns(1U) /
+				(double)(nr_ops * nr_pes));
+
+		host_util_spinlock_watch(0U, NULL);
+		host_util_spinlock_watch(1U, NULL);
+
+		for (unsigned int i = 0U; i < nr_pes; i++) {
+			expect_success(rmi(SMC_RMM_REC_DESTROY, vcpus[i].rec,
+					   0UL, 0UL, 0UL, 0UL),
+					"REC_DESTROY");
+			expect_success(rmi(SMC_RMM_DATA_DESTROY, realm.rd,
+					   vcpus[i].data_ipa, 0UL, 0UL, 0UL),
+					"DATA_DESTROY");
+			expect_success(rmi(SMC_RMM_DATA_DESTROY, realm.rd,
+					   vcpus[i].token_ipa, 0UL, 0UL, 0UL),
+					"DATA_DESTROY");
+		}
+
+		realm_teardown(&realm);
+		realm_release(&realm);
+	}
+
+	host_util_set_realm_cb(NULL);
+
+	for (unsigned int i = 0U; i < RMM_EL3_MAX_CPUS; i++) {
+		undelegate_granule(vcpus[i].rec);
+		undelegate_granule(vcpus[i].data);
+		undelegate_granule(vcpus[i].token);
+
+		for (unsigned long j = 0UL; j < num_aux; j++) {
+			undelegate_granule(vcpus[i].aux[j]);
+		}
+	}
+}
+
+static void start_secondary_pes(void)
+{
+	for (unsigned int i = 1U; i < RMM_EL3_MAX_CPUS; i++) {
+		host_util_set_cpuid(i);
+		write_tpidr_el2(i);
+
+		plat_warmboot_setup(0UL,
+				    RMM_EL3_IFC_ABI_VERSION,
+				    RMM_EL3_MAX_CPUS,
+				    (uintptr_t)&el3_rmm_shared_buffer);
+
+		write_sctlr_el2(SCTLR_EL2_WXN | SCTLR_EL2_M);
+		rmm_warmboot_main();
+	}
+
+	host_util_set_cpuid(0U);
+}
+#endif /* HOST_THREADS */
+
+/*
+ * Performs some initialization needed before RMM can be ran, such as
+ * setting up callbacks for sysreg access.
+ */
+static void setup_sysreg_and_boot_manifest(void)
+{
+	host_util_set_cpuid(0U);
+
+	/*
+	 * Initialize ID_AA64MMFR0_EL1 with a physical address
+	 * range of 48 bits (PARange bits set to 0b0101)
+	 */
+	(void)host_util_set_default_sysreg_cb("id_aa64mmfr0_el1",
+				INPLACE(ID_AA64MMFR0_EL1_PARANGE, 5UL));
+
+	/*
+	 * Initialize ICH_VTR_EL2 with 6 preemption bits.
+	 * (PREbits is equal number of preemption bits minus one)
+	 */
+	(void)host_util_set_default_sysreg_cb("ich_vtr_el2",
+				INPLACE(ICH_VTR_EL2_PRE_BITS, 5UL));
+
+	/* SCTLR_EL2 is reset to zero */
+	(void)host_util_set_default_sysreg_cb("sctlr_el2", 0UL);
+
+	/* TPIDR_EL2 is reset to zero */
+	(void)host_util_set_default_sysreg_cb("tpidr_el2", 0UL);
+
+	/* ESR_EL2 is written by the Realm emulation of bench_rec_enter_mt() */
+	(void)host_util_set_default_sysreg_cb("esr_el2", 0UL);
+
+	/* Initialize the boot manifest */
+	boot_manifest->version = RMM_EL3_IFC_SUPPORTED_VERSION;
+	boot_manifest->plat_data = (uintptr_t)NULL;
+
+	/* Store current CPU ID into tpidr_el2 */
+	write_tpidr_el2(0);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long nr_ops = BENCH_DEFAULT_OPS;
+
+	if (argc > 1) {
+		nr_ops = strtoul(argv[1], NULL, 0);
+		if (nr_ops == 0UL) {
+			printf("usage: %s [operations per benchmark]\n", argv[0]);
+			return 1;
+		}
+	}
+
+#ifdef HOST_COST_MODEL
+	if ((getenv("HOST_COST_WEIGHTS") != NULL) &&
+	    (host_util_cost_set_weights(getenv("HOST_COST_WEIGHTS")) != 0)) {
+		printf("Invalid HOST_COST_WEIGHTS\n");
+		return 1;
+	}
+#endif
+
+	setup_sysreg_and_boot_manifest();
+
+	plat_setup(0UL,
+		   RMM_EL3_IFC_ABI_VERSION,
+		   RMM_EL3_MAX_CPUS,
+		   (uintptr_t)&el3_rmm_shared_buffer);
+
+	/*
+	 * Emulate the EL3 calls made by RMM, so that attestation can be
+	 * initialised. The buffers must be set before the MMU is enabled.
+	 */
+	rmm_el3_ifc_set_cpu_bufs((uintptr_t)el3_cpu_bufs,
+				 (uintptr_t)el3_cpu_bufs);
+	host_util_set_el3_cb(bench_el3_call);
+
+	/*
+	 * Enable the MMU. This is needed as some initialization code
+	 * called by rmm_main() asserts that the mmu is enabled.
+	 */
+	write_sctlr_el2(SCTLR_EL2_WXN | SCTLR_EL2_M);
+
+	rmm_main();
+
+#ifdef HOST_THREADS
+	start_secondary_pes();
+#endif
+
+	next_granule = host_util_get_granule_base();
+	realm_params = (struct rmi_realm_params *)alloc_granule();
+
+	bench_granule_delegate(nr_ops);
+	bench_realm_create(nr_ops);
+	bench_rtt(nr_ops);
+	bench_data_create(nr_ops);
+	bench_rec(nr_ops);
+	bench_attest_sign(nr_ops);
+	bench_attest_token(nr_ops);
+#ifdef HOST_THREADS
+	bench_data_create_mt(nr_ops);
+	bench_rec_enter_mt(nr_ops);
+#endif
+
+	return 0;
+}
@@ -0,0 +1,490 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <debug.h>
+#include <gic.h>
+#include <host_defs.h>
+#include <host_utils.h>
+#include <platform_api.h>
+#include <rmm_el3_ifc.h>
+#include <smc-rmi.h>
+#include <smc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xlat_tables.h>
+
+#define RMM_EL3_IFC_ABI_VERSION		(RMM_EL3_IFC_SUPPORTED_VERSION)
+#define RMM_EL3_MAX_CPUS		(1U)
+
+/*
+ * Replay file, in little endian:
+ *
+ * A struct replay_header, followed by records which each start with a
+ * struct replay_record_hdr:
+ *  - REPLAY_RECORD_SMC: a struct replay_smc, an RMI call made by the Host.
+ *  - REPLAY_RECORD_NS_PAGE: the address of an NS granule on 8 bytes, followed
+ *    by the GRANULE_SIZE bytes of content the granule has from then on, for
+ *    instance the parameters read by the next REALM_CREATE.
+ *
+ * The file is written by a recorder in the Host, or from the traces returned
+ * by RMI_TRACE_DUMP with tools/trace/decode_trace.py --replay, in which case
+ * it holds no NS page.
+ *
+ * Physical addresses in [dram_base, dram_base + dram_size) are rebased to the
+ * memory of the host platform, which must be large enough. This applies to
+ * the arguments of the RMI calls which are addresses of granules, and to the
+ * addresses of granules in the parameters of REALM_CREATE and REC_CREATE.
+ */
+#define REPLAY_MAGIC			U(0x50524d52)	/* "RMRP" */
+#define REPLAY_VERSION			U(1)
+
+#define REPLAY_RECORD_SMC		U(1)
+#define REPLAY_RECORD_NS_PAGE		U(2)
+
+/* Value of replay_smc.x0 when the result of the call was not recorded */
+#define REPLAY_X0_UNKNOWN		(~0UL)
+
+struct replay_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t dram_base;
+	uint64_t dram_size;
+};
+
+struct replay_record_hdr {
+	uint32_t type;
+	/* Size of the record following this header */
+	uint32_t size;
+};
+
+struct replay_smc {
+	uint64_t fid;
+	uint64_t args[6];
+	/* Result recorded for the call */
+	uint64_t x0;
+};
+
+/* Time spent in, and outcome of, the replayed calls of an RMI command */
+struct replay_stats {
+	unsigned long calls;
+	unsigned long mismatches;
+	uint64_t ns;
+#ifdef HOST_COST_MODEL
+	struct host_cost cost;
+#endif
+};
+
+/* Implemented in init.c and handler.c and needed here */
+void rmm_main(void);
+void handle_ns_smc(unsigned long function_id,
+		   unsigned long arg0,
+		   unsigned long arg1,
+		   unsigned long arg2,
+		   unsigned long arg3,
+		   unsigned long arg4,
+		   unsigned long arg5,
+		   union smc_regs *regs);
+
+/*
+ * Define and set the Boot Interface arguments.
+ */
+static unsigned char el3_rmm_shared_buffer[PAGE_SIZE] __aligned(PAGE_SIZE);
+
+/*
+ * Create a basic boot manifest.
+ */
+static struct rmm_core_manifest *boot_manifest =
+			(struct rmm_core_manifest *)el3_rmm_shared_buffer;
+
+static struct replay_stats stats[SMC64_NUM_FIDS_IN_RANGE(RMI)];
+
+static unsigned long dram_base;
+static unsigned long dram_size;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/* Return the address in the host memory of the recorded address @pa */
+static unsigned long rebase(unsigned long pa)
+{
+	if ((pa < dram_base) || ((pa - dram_base) >= dram_size)) {
+		return pa;
+	}
+
+	return host_util_get_granule_base() + (pa - dram_base);
+}
+
+/* Bitmap of the arguments of the RMI command @fid which are PAs */
+static unsigned int addr_args(unsigned long fid)
+{
+	switch (fid) {
+	case SMC_RMM_GRANULE_DELEGATE:
+	case SMC_RMM_GRANULE_UNDELEGATE:
+	case SMC_RMM_GRANULE_DELEGATE_RANGE:
+	case SMC_RMM_GRANULE_UNDELEGATE_RANGE:
+	case SMC_RMM_GRANULE_DELEGATE_PRESERVE_RANGE:
+	case SMC_RMM_DATA_DESTROY:
+	case SMC_RMM_REALM_ACTIVATE:
+	case SMC_RMM_REALM_DESTROY:
+	case SMC_RMM_REC_DESTROY:
+	case SMC_RMM_RTT_MAP_UNPROTECTED:
+	case SMC_RMM_RTT_READ_ENTRY:
+	case SMC_RMM_RTT_UNMAP_UNPROTECTED:
+	case SMC_RMM_REC_AUX_COUNT:
+	case SMC_RMM_RTT_RECLAIM:
+	case SMC_RMM_RTT_INIT_RIPAS_RANGE:
+	case SMC_RMM_REC_STATS:
+	case SMC_RMM_REC_ATTEST_SIGN:
+	case SMC_RMM_RTT_MAP_UNPROTECTED_RANGE:
+	case SMC_RMM_RTT_UNMAP_UNPROTECTED_RANGE:
+	case SMC_RMM_TRACE_DUMP:
+	case SMC_RMM_REC_EXIT_TRACE_DUMP:
+	case SMC_RMM_REALM_FOOTPRINT:
+	case SMC_RMM_RTT_WALK_HINT:
+		return 1U << 0;
+	case SMC_RMM_REALM_CREATE:
+	case SMC_RMM_REC_ENTER:
+	case SMC_RMM_PSCI_COMPLETE:
+	case SMC_RMM_RTT_SET_RIPAS:
+	case SMC_RMM_REC_MMIO_RING:
+	case SMC_RMM_REALM_TEARDOWN:
+	case SMC_RMM_REC_CREATE_MULTI:
+	case SMC_RMM_DATA_CREATE_UNKNOWN:
+	case SMC_RMM_RTT_CREATE:
+	case SMC_RMM_RTT_DESTROY:
+	case SMC_RMM_RTT_FOLD:
+	case SMC_RMM_RTT_POOL_DONATE:
+	case SMC_RMM_RTT_POOL_REPORT:
+	case SMC_RMM_DATA_POOL_DONATE:
+	case SMC_RMM_DATA_POOL_REPORT:
+	case SMC_RMM_DATA_IMPORT:
+		return (1U << 0) | (1U << 1);
+	case SMC_RMM_REC_CREATE:
+		return (1U << 0) | (1U << 1) | (1U << 2);
+	case SMC_RMM_JOB_SUBMIT:
+		/* The parameters of the jobs which are not PAs are small */
+		return (1U << 1) | (1U << 2);
+	case SMC_RMM_GRANULE_DELEGATE_MULTI:
+		/* Only the first five addresses are recorded */
+		return (1U << 1) | (1U << 2) | (1U << 3) | (1U << 4) |
+		       (1U << 5);
+	case SMC_RMM_DATA_CREATE:
+	case SMC_RMM_DATA_CREATE_RANGE:
+		return (1U << 0) | (1U << 1) | (1U << 3);
+	case SMC_RMM_RTT_READ_ENTRIES:
+	case SMC_RMM_RTT_SCAN_ACCESS:
+	case SMC_RMM_RTT_DESTROY_TREE:
+	case SMC_RMM_DATA_DESTROY_RANGE:
+		return (1U << 0) | (1U << 3);
+	case SMC_RMM_RTT_CREATE_MULTI:
+		return (1U << 0) | (1U << 3) | (1U << 4) | (1U << 5);
+	case SMC_RMM_GRANULE_STATE_QUERY:
+	case SMC_RMM_DATA_EXPORT:
+		return (1U << 0) | (1U << 2);
+	case SMC_RMM_RTT_SHARE_RANGE:
+		return (1U << 0) | (1U << 1) | (1U << 5);
+	case SMC_RMM_RTT_SHARED:
+		/* The RD of RMI_RTT_SHARED_LINK is rebased by rebase_params */
+		return 1U << 1;
+	case SMC_RMM_RTT_INIT_RIPAS:
+		return 1U << 1;
+	default:
+		return 0U;
+	}
+}
+
+/* Return true if @addr is a granule of the host memory */
+static bool is_host_granule(unsigned long addr)
+{
+	unsigned long base = host_util_get_granule_base();
+
+	return (addr >= base) && ((addr - base) < HOST_MEM_SIZE) &&
+		((addr & (GRANULE_SIZE - 1UL)) == 0UL);
+}
+
+/*
+ * Rebase the addresses of granules held by the parameters of REALM_CREATE
+ * and REC_CREATE, which the replay file records as the Host wrote them.
+ */
+static void rebase_params(unsigned long fid, unsigned long *args)
+{
+	if ((fid == SMC_RMM_REALM_CREATE) && is_host_granule(args[1])) {
+		struct rmi_realm_params *params =
+				(struct rmi_realm_params *)args[1];
+
+		params->rtt_base = rebase(params->rtt_base);
+	} else if ((fid == SMC_RMM_RTT_SHARED) &&
+		   (args[0] == RMI_RTT_SHARED_LINK)) {
+		args[2] = rebase(args[2]);
+	} else if ((fid == SMC_RMM_REC_CREATE) && is_host_granule(args[2])) {
+		struct rmi_rec_params *params =
+				(struct rmi_rec_params *)args[2];
+
+		for (unsigned long i = 0UL;
+		     (i < params->num_aux) && (i < MAX_REC_AUX_GRANULES); i++) {
+			params->aux[i] = rebase(params->aux[i]);
+		}
+	}
+}
+
+static void replay_smc(const struct replay_smc *smc, unsigned long idx)
+{
+	unsigned int mask = addr_args(smc->fid);
+	unsigned long args[6];
+	struct replay_stats *stat;
+	union smc_regs res = { 0 };
+	uint64_t start;
+#ifdef HOST_COST_MODEL
+	struct host_cost cost_start;
+#endif
+
+	if (!IS_SMC64_RMI_FID(smc->fid)) {
+		WARN("Record %lu: 0x%lx is not an RMI call, skipped\n",
+			idx, (unsigned long)smc->fid);
+		return;
+	}
+
+	for (unsigned int i = 0U; i < 6U; i++) {
+		args[i] = ((mask & (1U << i)) != 0U) ?
+				rebase(smc->args[i]) : smc->args[i];
+	}
+
+	rebase_params(smc->fid, args);
+
+	stat = &stats[SMC64_FID_OFFSET_FROM_RANGE_MIN(RMI, smc->fid)];
+
+#ifdef HOST_COST_MODEL
+	host_util_cost_read(&cost_start);
+#endif
+	start = now_ns();
+	handle_ns_smc(smc->fid, args[0], args[1], args[2], args[3], args[4],
+		      args[5], &res);
+	stat->ns += now_ns() - start;
+#ifdef HOST_COST_MODEL
+	host_util_cost_accumulate(&stat->cost, &cost_start);
+#endif
+	stat->calls++;
+
+	if ((smc->x0 != REPLAY_X0_UNKNOWN) && (res.x[0] != smc->x0)) {
+		WARN("Record %lu: 0x%lx returned 0x%lx instead of 0x%lx\n",
+			idx, (unsigned long)smc->fid, res.x[0],
+			(unsigned long)smc->x0);
+		stat->mismatches++;
+	}
+}
+
+static void replay_ns_page(const unsigned char *data, unsigned long idx)
+{
+	uint64_t pa;
+	unsigned long addr;
+
+	(void)memcpy(&pa, data, sizeof(pa));
+	addr = rebase(pa);
+
+	if (!is_host_granule(addr)) {
+		WARN("Record %lu: NS page 0x%lx is out of memory, skipped\n",
+			idx, (unsigned long)pa);
+		return;
+	}
+
+	(void)memcpy((void *)addr, data + sizeof(pa), GRANULE_SIZE);
+}
+
+static unsigned char *read_file(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	unsigned char *data;
+	long len;
+
+	if (f == NULL) {
+		return NULL;
+	}
+
+	if ((fseek(f, 0L, SEEK_END) != 0) || ((len = ftell(f)) < 0L) ||
+	    (fseek(f, 0L, SEEK_SET) != 0)) {
+		(void)fclose(f);
+		return NULL;
+	}
+
+	data = malloc((size_t)len + 1U);
+	if ((data != NULL) && (fread(data, 1U, (size_t)len, f) != (size_t)len)) {
+		free(data);
+		data = NULL;
+	}
+
+	(void)fclose(f);
+	*size = (size_t)len;
+	return data;
+}
+
+static int replay(const unsigned char *data, size_t size)
+{
+	struct replay_header hdr;
+	size_t offset = sizeof(hdr);
+	unsigned long idx = 0UL;
+
+	if (size < sizeof(hdr)) {
+		ERROR("Truncated replay header\n");
+		return 1;
+	}
+
+	(void)memcpy(&hdr, data, sizeof(hdr));
+	if ((hdr.magic != REPLAY_MAGIC) || (hdr.version != REPLAY_VERSION)) {
+		ERROR("Not a replay file, or unsupported version\n");
+		return 1;
+	}
+
+	if (hdr.dram_size > HOST_MEM_SIZE) {
+		ERROR("The recorded DRAM does not fit in the host memory\n");
+		return 1;
+	}
+
+	dram_base = hdr.dram_base;
+	dram_size = hdr.dram_size;
+
+	while ((size - offset) >= sizeof(struct replay_record_hdr)) {
+		struct replay_record_hdr rec;
+
+		(void)memcpy(&rec, data + offset, sizeof(rec));
+		offset += sizeof(rec);
+
+		if ((size - offset) < rec.size) {
+			ERROR("Record %lu is truncated\n", idx);
+			return 1;
+		}
+
+		if ((rec.type == REPLAY_RECORD_SMC) &&
+		    (rec.size == sizeof(struct replay_smc))) {
+			struct replay_smc smc;
+
+			(void)memcpy(&smc, data + offset, sizeof(smc));
+			replay_smc(&smc, idx);
+		} else if ((rec.type == REPLAY_RECORD_NS_PAGE) &&
+			   (rec.size == (sizeof(uint64_t) + GRANULE_SIZE))) {
+			replay_ns_page(data + offset, idx);
+		} else {
+			WARN("Record %lu: unknown type %u, skipped\n",
+				idx, rec.type);
+		}
+
+		offset += rec.size;
+		idx++;
+	}
+
+	return 0;
+}
+
+static void report(void)
+{
+	printf("%-12s %10s %10s %14s\n", "FID", "calls", "mismatch", "ns/call");
+
+	for (unsigned long i = 0UL; i < ARRAY_LEN(stats); i++) {
+		if (stats[i].calls == 0UL) {
+			continue;
+		}
+
+		printf("0x%-10lx %10lu %10lu %14.1f\n",
+			SMC64_RMI_FID(i), stats[i].calls, stats[i].mismatches,
+			(double)stats[i].ns / (double)stats[i].calls);
+#ifdef HOST_COST_MODEL
+		host_util_cost_report(&stats[i].cost, stats[i].calls);
+#endif
+	}
+}
+
+/*
+ * Performs some initialization needed before RMM can be ran, such as
+ * setting up callbacks for sysreg access.
+ */
+static void setup_sysreg_and_boot_manifest(void)
+{
+	host_util_set_cpuid(0U);
+
+	/*
+	 * Initialize ID_AA64MMFR0_EL1 with a physical address
+	 * range of 48 bits (PARange bits set to 0b0101)
+	 */
+	(void)host_util_set_default_sysreg_cb("id_aa64mmfr0_el1",
+				INPLACE(ID_AA64MMFR0_EL1_PARANGE, 5UL));
+
+	/*
+	 * Initialize ICH_VTR_EL2 with 6 preemption bits.
+	 * (PREbits is equal number of preemption bits minus one)
+	 */
+	(void)host_util_set_default_sysreg_cb("ich_vtr_el2",
+				INPLACE(ICH_VTR_EL2_PRE_BITS, 5UL));
+
+	/* SCTLR_EL2 is reset to zero */
+	(void)host_util_set_default_sysreg_cb("sctlr_el2", 0UL);
+
+	/* TPIDR_EL2 is reset to zero */
+	(void)host_util_set_default_sysreg_cb("tpidr_el2", 0UL);
+
+	/* Initialize the boot manifest */
+	boot_manifest->version = RMM_EL3_IFC_SUPPORTED_VERSION;
+	boot_manifest->plat_data = (uintptr_t)NULL;
+
+	/* Store current CPU ID into tpidr_el2 */
+	write_tpidr_el2(0);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned char *data;
+	size_t size;
+	int ret;
+
+	if (argc != 2) {
+		printf("usage: %s <replay file>\n", argv[0]);
+		return 1;
+	}
+
+#ifdef HOST_COST_MODEL
+	if ((getenv("HOST_COST_WEIGHTS") != NULL) &&
+	    (host_util_cost_set_weights(getenv("HOST_COST_WEIGHTS")) != 0)) {
+		printf("Invalid HOST_COST_WEIGHTS\n");
+		return 1;
+	}
+#endif
+
+	data = read_file(argv[1], &size);
+	if (data == NULL) {
+		ERROR("Cannot read %s\n", argv[1]);
+		return 1;
+	}
+
+	setup_sysreg_and_boot_manifest();
+
+	plat_setup(0UL,
+		   RMM_EL3_IFC_ABI_VERSION,
+		   RMM_EL3_MAX_CPUS,
+		   (uintptr_t)&el3_rmm_shared_buffer);
+
+	/*
+	 * Enable the MMU. This is needed as some initialization code
+	 * called by rmm_main() asserts that the mmu is enabled.
+	 */
+	write_sctlr_el2(SCTLR_EL2_WXN | SCTLR_EL2_M);
+
+	rmm_main();
+
+	ret = replay(data, size);
+	free(data);
+
+	if (ret == 0) {
+		report();
+	}
+
+	return ret;
+}
@@ -8,6 +8,8 @@
 #include <host_utils.h>
 #include <platform_api.h>
 #include <rmm_el3_ifc.h>
+#include <smc.h>
+#include <string.h>
 #include <xlat_tables.h>
 
 /* Implemented in init.c and needed here */
@@ -20,6 +22,9 @@ void rmm_main(void);
 #define RMM_EL3_IFC_ABI_VERSION		(RMM_EL3_IFC_SUPPORTED_VERSION)
 #define RMM_EL3_MAX_CPUS		(MAX_CPUS)
 
+/* Size of the platform token returned by the fake EL3 */
+#define TEST_PLAT_TOKEN_SIZE		(1024UL)
+
 static unsigned char el3_rmm_shared_buffer[PAGE_SIZE] __aligned(PAGE_SIZE);
 
 /*
@@ -28,6 +33,65 @@ static unsigned char el3_rmm_shared_buffer[PAGE_SIZE] __aligned(PAGE_SIZE);
 static struct rmm_core_manifest *boot_manifest =
 			(struct rmm_core_manifest *)el3_rmm_shared_buffer;
 
+/*
+ * Buffers of the calls to the fake EL3. RMM uses the shared buffer at a VA
+ * which the fake host does not map, so it is given per-CPU buffers whose VA
+ * is their PA instead.
+ */
+static unsigned char el3_cpu_bufs[RMM_EL3_MAX_CPUS][PAGE_SIZE]
+							__aligned(PAGE_SIZE);
+
+/*
+ * Raw P-384 private key returned as the Realm Attestation Key by the fake
+ * EL3. This is the test key of RFC 6979, A.2.6.
+ */
+static const unsigned char test_rak[] = {
+	0x6b, 0x9d, 0x3d, 0xad, 0x2e, 0x1b, 0x8c, 0x1c,
+	0x05, 0xb1, 0x98, 0x75, 0xb6, 0x65, 0x9f, 0x4d,
+	0xe2, 0x3c, 0x3b, 0x66, 0x7b, 0xf2, 0x97, 0xba,
+	0x9a, 0xa4, 0x77, 0x40, 0x78, 0x71, 0x37, 0xd8,
+	0x96, 0xd5, 0x72, 0x4e, 0x4c, 0x70, 0xa8, 0x25,
+	0xf8, 0x72, 0xc9, 0xea, 0x60, 0xd2, 0xed, 0xf5
+};
+
+/*
+ * Emulation of the EL3 calls made by the attestation initialisation, which
+ * is done on the first use of attestation, so that the tests can use the
+ * PRNGs of the CPUs.
+ */
+static bool test_el3_call(unsigned long id, const unsigned long *args,
+			  struct smc_result *smc_res)
+{
+	unsigned char *buf = (unsigned char *)args[0];
+	unsigned long len;
+
+	switch (id) {
+	case SMC_RMM_GET_REALM_ATTEST_KEY:
+		len = sizeof(test_rak);
+		if (len <= args[1]) {
+			(void)memcpy(buf, test_rak, len);
+		}
+		break;
+	case SMC_RMM_GET_PLAT_TOKEN:
+		/*
+		 * The platform token is opaque to RMM. Keep the challenge
+		 * written to the buffer by RMM and pad it.
+		 */
+		len = TEST_PLAT_TOKEN_SIZE;
+		if (len <= args[1]) {
+			(void)memset(buf + args[2], 0xa5, len - args[2]);
+		}
+		break;
+	default:
+		return false;
+	}
+
+	/* Any non-zero status is an error for RMM */
+	smc_res->x[0] = (len <= args[1]) ? 0UL : 1UL;
+	smc_res->x[1] = len;
+	return true;
+}
+
 /*
  * Performs some initialization needed before RMM can be run, such as
  * setting up callbacks for sysreg access.
@@ -78,17 +142,21 @@ static void start_primary_pe(void)
 		   RMM_EL3_MAX_CPUS,
 		   (uintptr_t)&el3_rmm_shared_buffer);
 
+	/*
+	 * Emulate the EL3 calls made by RMM, so that attestation can be
+	 * initialised. The buffers must be set before the MMU is enabled.
+	 */
+	rmm_el3_ifc_set_cpu_bufs((uintptr_t)el3_cpu_bufs,
+				 (uintptr_t)el3_cpu_bufs);
+	host_util_set_el3_cb(test_el3_call);
+
 	/*
 	 * Enable the MMU. This is needed as some initialization code
 	 * called by rmm_main() asserts that the mmu is enabled.
 	 */
 	enable_fake_mmu();
 
-	/*
-	 * rmm_main() finishhes the warmboot path.
-	 *
-	 * Note: It is expected that the attestation init will fail.
-	 */
+	/* rmm_main() finishhes the warmboot path. */
 	rmm_main();
 }
 
@@ -8,13 +8,18 @@
 #include <arch_helpers.h>
 #include <attestation_token.h>
 #include <buffer.h>
+#include <cpuid.h>
 #include <esr.h>
 #include <exit.h>
 #include <fpu_helpers.h>
 #include <gic.h>
 #include <granule.h>
 #include <inject_exp.h>
+#include <pc_sample.h>
 #include <memory_alloc.h>
+#include <pauth.h>
+#include <pmu.h>
+#include <pmu_profile.h>
 #include <psci.h>
 #include <realm.h>
 #include <realm_attest.h>
@@ -24,9 +29,11 @@
 #include <rsi-host-call.h>
 #include <rsi-logger.h>
 #include <rsi-memory.h>
+#include <rsi-rec-stats.h>
 #include <rsi-walk.h>
 #include <smc-rmi.h>
 #include <smc-rsi.h>
+#include <stack_profile.h>
 #include <status.h>
 #include <sve.h>
 #include <sysreg_traps.h>
@@ -35,6 +42,13 @@
 void save_fpu_state(struct fpu_state *fpu);
 void restore_fpu_state(struct fpu_state *fpu);
 
+/* Count an event in the statistics of @rec, see RMI_REC_STATS */
+#ifdef RMM_REC_STATS
+#define REC_STATS_INC(rec, stat)	((rec)->stats.stat++)
+#else
+#define REC_STATS_INC(rec, stat)	((void)(rec))
+#endif
+
 static void system_abort(void)
 {
 	/*
@@ -90,37 +104,20 @@ static bool access_in_rec_par(struct rec *rec, unsigned long addr)
  */
 static bool ipa_is_empty(unsigned long ipa, struct rec *rec)
 {
-	unsigned long s2tte, *ll_table;
-	struct rtt_walk wi;
 	enum ripas ripas;
-	bool ret;
+	unsigned long rtt_level;
 
 	assert(GRANULE_ALIGNED(ipa));
 
 	if (!addr_in_rec_par(rec, ipa)) {
 		return false;
 	}
-	granule_lock(rec->realm_info.g_rtt, GRANULE_STATE_RTT);
-
-	rtt_walk_lock_unlock(rec->realm_info.g_rtt,
-			     rec->realm_info.s2_starting_level,
-			     rec->realm_info.ipa_bits,
-			     ipa, RTT_PAGE_LEVEL, &wi);
 
-	ll_table = granule_map(wi.g_llt, SLOT_RTT);
-	s2tte = s2tte_read(&ll_table[wi.index]);
-
-	if (s2tte_is_destroyed(s2tte)) {
-		ret = false;
-		goto out_unmap_ll_table;
+	if (realm_ipa_get_ripas(rec, ipa, &ripas, &rtt_level) != WALK_SUCCESS) {
+		return false;
 	}
-	ripas = s2tte_get_ripas(s2tte);
-	ret = (ripas == RMI_EMPTY);
 
-out_unmap_ll_table:
-	buffer_unmap(ll_table);
-	granule_unlock(wi.g_llt);
-	return ret;
+	return (ripas == RMI_EMPTY);
 }
 
 static bool fsc_is_external_abort(unsigned long fsc)
@@ -214,6 +211,133 @@ void emulate_stage2_data_abort(struct rec *rec,
 	rec_exit->exit_reason = RMI_EXIT_SYNC;
 }
 
+static void advance_pc(void)
+{
+	unsigned long pc = read_elr_el2();
+
+	write_elr_el2(pc + 4UL);
+}
+
+/*
+ * Append the MMIO write of @size bytes of @value at @ipa to the ring of @rec,
+ * see struct rmi_mmio_ring. Return 'false' if the REC has no ring, if the
+ * access is not within one of the regions of the ring or if the ring is full,
+ * in which case the Host emulates the write on a REC exit.
+ */
+static bool mmio_ring_append(struct rec *rec, unsigned long ipa,
+			     unsigned long value, unsigned int size)
+{
+	struct granule *g_ring = rec->mmio_ring.g_ns;
+	struct rmi_mmio_ring_entry entry;
+	unsigned long head = rec->mmio_ring.head;
+	unsigned long offset;
+	bool in_region = false;
+
+	if (g_ring == NULL) {
+		return false;
+	}
+
+	for (unsigned long i = 0UL; i < rec->mmio_ring.nr_regions; i++) {
+		const struct rmi_mmio_ring_region *region =
+						&rec->mmio_ring.regions[i];
+
+		if ((ipa >= region->base) &&
+		    ((ipa - region->base) < region->size) &&
+		    (size <= (region->size - (ipa - region->base)))) {
+			in_region = true;
+			break;
+		}
+	}
+
+	if (!in_region) {
+		return false;
+	}
+
+	/* Only read the tail of the Host when the ring looks full */
+	if ((head - rec->mmio_ring.tail) >= RMI_MMIO_RING_ENTRIES) {
+		unsigned long tail;
+
+		if (!ns_buffer_read(SLOT_NS, g_ring,
+				    offsetof(struct rmi_mmio_ring, tail),
+				    sizeof(tail), &tail)) {
+			return false;
+		}
+
+		/*
+		 * This also rejects a tail beyond the head, which the Host
+		 * cannot have consumed.
+		 */
+		if ((head - tail) >= RMI_MMIO_RING_ENTRIES) {
+			return false;
+		}
+		rec->mmio_ring.tail = tail;
+	}
+
+	entry.ipa = ipa;
+	entry.value = value;
+	entry.size = size;
+
+	offset = offsetof(struct rmi_mmio_ring, entries) +
+		 ((head % RMI_MMIO_RING_ENTRIES) * sizeof(entry));
+	if (!ns_buffer_write(SLOT_NS, g_ring, (unsigned int)offset,
+			     sizeof(entry), &entry)) {
+		return false;
+	}
+
+	/* Make the entry visible to the Host before the new head */
+	dmb(ishst);
+
+	head++;
+	if (!ns_buffer_write(SLOT_NS, g_ring,
+			     offsetof(struct rmi_mmio_ring, head),
+			     sizeof(head), &head)) {
+		return false;
+	}
+
+	rec->mmio_ring.head = head;
+	return true;
+}
+
+/*
+ * Serve the MMIO read of the data abort @esr at @ipa from the constants of
+ * the MMIO ring of @rec, see struct rmi_mmio_ring. Return 'false' if none
+ * of them matches the access, in which case the Host emulates the read on
+ * a REC exit.
+ */
+static bool mmio_const_read(struct rec *rec, unsigned long ipa,
+			    unsigned long esr)
+{
+	struct rmi_mmio_ring_entry consts[RMI_MMIO_RING_NR_CONSTS];
+	unsigned long nr_consts = rec->mmio_ring.nr_consts;
+	unsigned int rt = esr_srt(esr);
+
+	if ((rec->mmio_ring.g_ns == NULL) || (nr_consts == 0UL)) {
+		return false;
+	}
+
+	if (!ns_buffer_read(SLOT_NS, rec->mmio_ring.g_ns,
+			    offsetof(struct rmi_mmio_ring, consts),
+			    (unsigned int)(nr_consts * sizeof(consts[0])),
+			    consts)) {
+		return false;
+	}
+
+	for (unsigned long i = 0UL; i < nr_consts; i++) {
+		if ((consts[i].ipa != ipa) ||
+		    (consts[i].size != (unsigned long)access_len(esr))) {
+			continue;
+		}
+
+		if (rt != 31U) {
+			rec->regs[rt] = esr_load_value(esr, consts[i].value);
+		}
+		REC_STATS_INC(rec, mmio_const_reads);
+		return true;
+	}
+
+	return false;
+}
+
 /*
  * Returns 'true' if the abort is handled and the RMM should return to the Realm,
  * and returns 'false' if the exception should be reported to the HS host.
@@ -244,18 +368,56 @@ static bool handle_data_abort(struct rec *rec, struct rmi_rec_exit *rec_exit,
 		return true;
 	}
 
+	/*
+	 * Resolve a write to an IPA write-protected to track the dirty state
+	 * of the Realm without exiting to the Host.
+	 */
+	if (((esr & ESR_EL2_ABORT_FSC_MASK & ~ESR_EL2_ABORT_FSC_LEVEL_MASK) ==
+	     ESR_EL2_ABORT_FSC_PERMISSION_FAULT) && esr_is_write(esr) &&
+	    access_in_rec_par(rec, fipa) && realm_wp_dirty_fault(rec, fipa)) {
+		return true;
+	}
+
+	/*
+	 * Resolve the first access to an Unassigned RIPAS RAM IPA from the
+	 * DATA pool of the Realm, if it has one, without exiting to the Host.
+	 */
+	if (((esr & ESR_EL2_ABORT_FSC_MASK & ~ESR_EL2_ABORT_FSC_LEVEL_MASK) ==
+	     ESR_EL2_ABORT_FSC_TRANSLATION_FAULT) &&
+	    access_in_rec_par(rec, fipa) && realm_data_pool_map(rec, fipa)) {
+		return true;
+	}
+
 	if (fixup_aarch32_data_abort(rec, &esr) ||
 	    access_in_rec_par(rec, fipa)) {
 		esr &= ESR_NONEMULATED_ABORT_MASK;
+		REC_STATS_INC(rec, s2_faults);
 		goto end;
 	}
 
 	if (esr_is_write(esr)) {
 		write_val = get_dabt_write_value(rec, esr);
+
+		if (((esr & ESR_EL2_ABORT_ISV_BIT) != 0UL) &&
+		    mmio_ring_append(rec,
+				     fipa | (read_far_el2() &
+					     HPFAR_EL2_FIPA_FAR_MASK),
+				     write_val, access_len(esr))) {
+			advance_pc();
+			return true;
+		}
+	} else if (((esr & ESR_EL2_ABORT_ISV_BIT) != 0UL) &&
+		   mmio_const_read(rec,
+				   fipa | (read_far_el2() &
+					   HPFAR_EL2_FIPA_FAR_MASK),
+				   esr)) {
+		advance_pc();
+		return true;
 	}
 
-	far = read_far_el2() & ~GRANULE_MASK;
+	far = read_far_el2() & HPFAR_EL2_FIPA_FAR_MASK;
 	esr &= ESR_EMULATED_ABORT_MASK;
+	REC_STATS_INC(rec, mmio_exits);
 
 end:
 	rec_exit->esr = esr;
@@ -311,8 +473,13 @@ static bool handle_instruction_abort(struct rec *rec, struct rmi_rec_exit *rec_e
 		return false;
 	}
 
+	if (realm_data_pool_map(rec, fipa)) {
+		return true;
+	}
+
 	rec_exit->hpfar = hpfar;
 	rec_exit->esr = esr & ESR_NONEMULATED_ABORT_MASK;
+	REC_STATS_INC(rec, s2_faults);
 
 	return false;
 }
@@ -330,13 +497,6 @@ static bool check_pending_irq(void)
 	return (pending_irq != 0UL);
 }
 
-static void advance_pc(void)
-{
-	unsigned long pc = read_elr_el2();
-
-	write_elr_el2(pc + 4UL);
-}
-
 static void return_result_to_realm(struct rec *rec, struct smc_result result)
 {
 	rec->regs[0] = result.x[0];
@@ -365,12 +525,18 @@ static bool handle_realm_rsi(struct rec *rec, struct rmi_rec_exit *rec_exit)
 		return true;
 	}
 
+#ifdef RMM_STACK_PROFILE
+	stack_profile_begin();
+#endif
+
 	switch (function_id) {
 	case SMCCC_VERSION:
 		rec->regs[0] = SMCCC_VERSION_NUMBER;
+		rec->trivial_exit = true;
 		break;
 	case SMC_RSI_ABI_VERSION:
 		rec->regs[0] = system_rsi_abi_version();
+		rec->trivial_exit = true;
 		break;
 	case SMC32_PSCI_FID_MIN ... SMC32_PSCI_FID_MAX:
 	case SMC64_PSCI_FID_MIN ... SMC64_PSCI_FID_MAX: {
@@ -404,14 +570,35 @@ static bool handle_realm_rsi(struct rec *rec, struct rmi_rec_exit *rec_exit)
 
 			advance_pc();
 			ret_to_rec = false;
+		} else if ((function_id == SMC32_PSCI_VERSION) ||
+			   (function_id == SMC32_PSCI_FEATURES)) {
+			rec->trivial_exit = true;
 		}
 		break;
 	}
 	case SMC_RSI_ATTEST_TOKEN_INIT:
+		if (!rec_attest_heap_acquire(rec)) {
+			/*
+			 * All the shared attestation heaps are in use. Exit to
+			 * the Host without advancing the PC, so that the Realm
+			 * retries the call once it is scheduled again.
+			 */
+			rec_exit->exit_reason = RMI_EXIT_IRQ;
+			ret_to_rec = false;
+			break;
+		}
 		rec->regs[0] = handle_rsi_attest_token_init(rec);
 		break;
 	case SMC_RSI_ATTEST_TOKEN_CONTINUE: {
 		struct attest_result res;
+
+#ifdef RMM_ATTEST_SIGN_BUDGET_US
+		unsigned long deadline = read_cntpct_el0() +
+			((RMM_ATTEST_SIGN_BUDGET_US * read_cntfrq_el0()) /
+			 1000000UL);
+#endif
+
+		rec_attest_heap_map(rec);
 		attest_realm_token_sign_continue_start();
 		while (true) {
 			/*
@@ -429,6 +616,15 @@ static bool handle_realm_rsi(struct rec *rec, struct rmi_rec_exit *rec_exit)
 			 *             validation failed.
 			 */
 			handle_rsi_attest_token_continue(rec, &res);
+			REC_STATS_INC(rec, attest_iterations);
+
+			if (res.deferred) {
+				/* Let the Host sign with RMI_REC_ATTEST_SIGN */
+				return_result_to_realm(rec, res.smc_res);
+				rec_exit->exit_reason = RMI_EXIT_ATTEST_SIGN;
+				ret_to_rec = false;
+				break;
+			}
 
 			if (res.incomplete) {
 				if (check_pending_irq()) {
@@ -437,6 +633,17 @@ static bool handle_realm_rsi(struct rec *rec, struct rmi_rec_exit *rec_exit)
 					ret_to_rec = false;
 					break;
 				}
+#ifdef RMM_ATTEST_SIGN_BUDGET_US
+				/*
+				 * Once the budget is spent, let the Realm call
+				 * again instead of running another iteration.
+				 */
+				if (read_cntpct_el0() >= deadline) {
+					return_result_to_realm(rec,
+							       res.smc_res);
+					break;
+				}
+#endif
 			} else {
 				if (res.walk_result.abort) {
 					emulate_stage2_data_abort(
@@ -456,10 +663,25 @@ static bool handle_realm_rsi(struct rec *rec, struct rmi_rec_exit *rec_exit)
 	}
 	case SMC_RSI_MEASUREMENT_READ:
 		rec->regs[0] = handle_rsi_read_measurement(rec);
+		rec->trivial_exit = true;
 		break;
 	case SMC_RSI_MEASUREMENT_EXTEND:
 		rec->regs[0] = handle_rsi_extend_measurement(rec);
 		break;
+	case SMC_RSI_MEASUREMENT_EXTEND_MULTI: {
+		struct rsi_walk_smc_result res;
+
+		res = handle_rsi_extend_measurement_multi(rec);
+		if (res.walk_result.abort) {
+			emulate_stage2_data_abort(rec, rec_exit,
+						  res.walk_result.rtt_level);
+			ret_to_rec = false; /* Exit to Host */
+		} else {
+			/* Return to Realm */
+			return_result_to_realm(rec, res.smc_res);
+		}
+		break;
+	}
 	case SMC_RSI_REALM_CONFIG: {
 		struct rsi_walk_smc_result res;
 
@@ -471,13 +693,13 @@ static bool handle_realm_rsi(struct rec *rec, struct rmi_rec_exit *rec_exit)
 		} else {
 			/* Return to Realm */
 			return_result_to_realm(rec, res.smc_res);
+			rec->trivial_exit = true;
 		}
 		break;
 	}
 	case SMC_RSI_IPA_STATE_SET:
-		if (handle_rsi_ipa_state_set(rec, rec_exit)) {
-			rec->regs[0] = RSI_ERROR_INPUT;
-		} else {
+		if (!handle_rsi_ipa_state_set(rec, rec_exit)) {
+			REC_STATS_INC(rec, ripas_changes);
 			advance_pc();
 			ret_to_rec = false; /* Return to Host */
 		}
@@ -494,6 +716,7 @@ static bool handle_realm_rsi(struct rec *rec, struct rmi_rec_exit *rec_exit)
 		} else {
 			/* Exit to Realm */
 			return_result_to_realm(rec, res.smc_res);
+			rec->trivial_exit = true;
 		}
 		break;
 	}
@@ -520,21 +743,87 @@ static bool handle_realm_rsi(struct rec *rec, struct rmi_rec_exit *rec_exit)
 				/* Exit to Host */
 				rec->host_call = true;
 				rec_exit->exit_reason = RMI_EXIT_HOST_CALL;
+				REC_STATS_INC(rec, host_calls);
 				ret_to_rec = false;
 			}
 		}
 		break;
 	}
+	case SMC_RSI_REC_STATS: {
+		struct rsi_walk_smc_result res;
+
+		res = handle_rsi_rec_stats(rec);
+		if (res.walk_result.abort) {
+			emulate_stage2_data_abort(rec, rec_exit,
+						  res.walk_result.rtt_level);
+			ret_to_rec = false; /* Exit to Host */
+		} else {
+			/* Return to Realm */
+			return_result_to_realm(rec, res.smc_res);
+			rec->trivial_exit = true;
+		}
+		break;
+	}
 	default:
 		rec->regs[0] = SMC_UNKNOWN;
 		break;
 	}
 
+#ifdef RMM_STACK_PROFILE
+	stack_profile_end(function_id);
+#endif
+
 	/* Log RSI call */
 	RSI_LOG_EXIT(function_id, rec->regs[0], ret_to_rec);
 	return ret_to_rec;
 }
 
+/*
+ * Called on a WFE trap. Return 'true' to resume the Realm without exiting to
+ * the Host, when the Host requested polling and the REC has not used up its
+ * window of consecutive WFE traps yet.
+ *
+ * As for halt-polling in KVM, the window adapts to the Realm: it is doubled
+ * when the Realm stops waiting within it and halved when it is used up.
+ * Every resume goes through check_pending_timers() again, so a timer which
+ * fires during the poll still causes an exit to the Host.
+ */
+static bool wfe_poll_resume(struct rec *rec)
+{
+	if (!rec->wfe_poll.enabled) {
+		return false;
+	}
+
+	if (rec->wfe_poll.count < rec->wfe_poll.window) {
+		rec->wfe_poll.count++;
+		return true;
+	}
+
+	if (rec->wfe_poll.window > REC_WFE_POLL_MIN) {
+		rec->wfe_poll.window /= 2U;
+	}
+	rec->wfe_poll.count = 0U;
+	return false;
+}
+
+/*
+ * Called on an exit after some WFE traps were resumed from RMM. If it is not
+ * another WFE trap, the Realm stopped waiting within the window.
+ */
+static void wfe_poll_update(struct rec *rec, int exception)
+{
+	if ((exception == ARM_EXCEPTION_SYNC_LEL) &&
+	    ((read_esr_el2() & (ESR_EL2_EC_MASK | ESR_EL2_WFx_TI_BIT)) ==
+	     (ESR_EL2_EC_WFX | ESR_EL2_WFx_TI_BIT))) {
+		return;
+	}
+
+	if (rec->wfe_poll.window < REC_WFE_POLL_MAX) {
+		rec->wfe_poll.window *= 2U;
+	}
+	rec->wfe_poll.count = 0U;
+}
+
 /*
  * Return 'true' if the RMM handled the exception,
  * 'false' to return to the Non-secure host.
@@ -545,6 +834,11 @@ static bool handle_exception_sync(struct rec *rec, struct rmi_rec_exit *rec_exit
 
 	switch (esr & ESR_EL2_EC_MASK) {
 	case ESR_EL2_EC_WFX:
+		if (((esr & ESR_EL2_WFx_TI_BIT) != 0UL) &&
+		    wfe_poll_resume(rec)) {
+			advance_pc();
+			return true;
+		}
 		rec_exit->esr = esr & (ESR_EL2_EC_MASK | ESR_EL2_WFx_TI_BIT);
 		advance_pc();
 		return false;
@@ -565,59 +859,57 @@ static bool handle_exception_sync(struct rec *rec, struct rmi_rec_exit *rec_exit
 		advance_pc();
 		return true;
 	case ESR_EL2_EC_SYSREG: {
-		bool ret = handle_sysreg_access_trap(rec, rec_exit, esr);
+		bool ret;
 
-		advance_pc();
-		return ret;
-	}
-	case ESR_EL2_EC_INST_ABORT:
-		return handle_instruction_abort(rec, rec_exit, esr);
-	case ESR_EL2_EC_DATA_ABORT:
-		return handle_data_abort(rec, rec_exit, esr);
-	case ESR_EL2_EC_FPU: {
-		unsigned long cptr;
+		/*
+		 * ID register reads are the most frequent sysreg traps and
+		 * are served from the table of the Realm, before any other
+		 * decoding of the trapped instruction.
+		 */
+		if ((esr & ESR_EL2_SYSREG_ID_MASK) == ESR_EL2_SYSREG_ID) {
+			handle_id_sysreg_trap(rec, esr);
+			advance_pc();
+			rec->trivial_exit = true;
+			return true;
+		}
 
 		/*
-		 * Realm has requested FPU/SIMD access, so save NS state and
-		 * load realm state.  Start by disabling traps so we can save
-		 * the NS state and load the realm state.
+		 * The first access of the Realm to the PMU loads its PMU
+		 * state, and the instruction is then executed again.
 		 */
-		cptr = read_cptr_el2();
-		cptr &= ~(CPTR_EL2_FPEN_MASK << CPTR_EL2_FPEN_SHIFT);
-		cptr |= (CPTR_EL2_FPEN_NO_TRAP_11 << CPTR_EL2_FPEN_SHIFT);
-		cptr &= ~(CPTR_EL2_ZEN_MASK << CPTR_EL2_ZEN_SHIFT);
-		cptr |= (CPTR_EL2_ZEN_NO_TRAP_11 << CPTR_EL2_ZEN_SHIFT);
-		write_cptr_el2(cptr);
+		if (pmu_handle_sysreg_trap(rec, esr)) {
+			return true;
+		}
 
 		/*
-		 * Save NS state, restore realm state, and set flag indicating
-		 * realm has used FPU so we know to save and restore NS state at
-		 * realm exit.
+		 * So is the first access to the pointer authentication keys,
+		 * once they are no longer trapped.
 		 */
-		if (rec->ns->sve != NULL) {
-			save_sve_state(rec->ns->sve);
-		} else {
-			assert(rec->ns->fpu != NULL);
-			fpu_save_state(rec->ns->fpu);
+		if (HAS_PAUTH && pauth_handle_sysreg_trap(rec, esr)) {
+			return true;
 		}
-		fpu_restore_state(&rec->fpu_ctx.fpu);
-		rec->fpu_ctx.used = true;
 
+		ret = handle_sysreg_access_trap(rec, rec_exit, esr);
+		advance_pc();
+		rec->trivial_exit = ret;
+		return ret;
+	}
+	case ESR_EL2_EC_INST_ABORT:
+		return handle_instruction_abort(rec, rec_exit, esr);
+	case ESR_EL2_EC_DATA_ABORT:
+		return handle_data_abort(rec, rec_exit, esr);
+	case ESR_EL2_EC_FPU:
 		/*
-		 * Disable SVE for now, until per rec save/restore is
-		 * implemented
+		 * Realm has requested FPU/SIMD access, so save NS state and
+		 * load realm state.
 		 */
-		cptr = read_cptr_el2();
-		cptr &= ~(CPTR_EL2_ZEN_MASK << CPTR_EL2_ZEN_SHIFT);
-		cptr |= (CPTR_EL2_ZEN_TRAP_ALL_00 << CPTR_EL2_ZEN_SHIFT);
-		write_cptr_el2(cptr);
+		rec_fpu_switch_in(rec);
 
 		/*
 		 * Return 'true' indicating that this exception
 		 * has been handled and execution can continue.
 		 */
 		return true;
-	}
 	default:
 		/*
 		 * TODO: Check if there are other exit reasons we could
@@ -699,7 +991,31 @@ static bool handle_exception_serror_lel(struct rec *rec, struct rmi_rec_exit *re
 
 static bool handle_exception_irq_lel(struct rec *rec, struct rmi_rec_exit *rec_exit)
 {
-	(void)rec;
+	/*
+	 * With REC_ENTRY_FLAG_TIMER_LOCAL, a timer interrupt of the Realm is
+	 * injected by rec_run_loop() before resuming the REC.
+	 */
+	if (rec->timer_local) {
+		unsigned int intid = EXTRACT(ICC_HPPIR1_EL1_INTID,
+					     read_icc_hppir1_el1());
+
+		if ((intid == EL1_VIRT_TIMER_PPI) ||
+		    (intid == EL1_PHYS_TIMER_PPI)) {
+			return true;
+		}
+	}
+
+	/*
+	 * With REC_ENTRY_FLAG_VIRQ_QUEUE, the underflow maintenance interrupt
+	 * enabled by RMM is handled by rec_run_loop(), which injects the next
+	 * queued interrupts into the freed LRs before resuming the REC.
+	 */
+	if ((rec->virq_queue.next != rec->virq_queue.nr) &&
+	    (EXTRACT(ICC_HPPIR1_EL1_INTID, read_icc_hppir1_el1()) ==
+	     GIC_MAINT_PPI) &&
+	    gic_is_local_maintenance(&rec->sysregs.gicstate)) {
+		return true;
+	}
 
 	rec_exit->exit_reason = RMI_EXIT_IRQ;
 
@@ -710,9 +1026,88 @@ static bool handle_exception_irq_lel(struct rec *rec, struct rmi_rec_exit *rec_e
 	return false;
 }
 
-/* Returns 'true' when returning to Realm (S) and false when to NS */
-bool handle_realm_exit(struct rec *rec, struct rmi_rec_exit *rec_exit, int exception)
+#if defined(RMM_REC_STATS) || defined(RMM_PMU_PROFILE) || \
+	defined(RMM_PC_SAMPLE)
+/*
+ * Return the cause of the Realm exit for @exception, as one of
+ * RMI_REC_STATS_EXIT_*, or RMI_REC_STATS_NR_EXITS if it is not recognized.
+ */
+static unsigned long realm_exit_cause(int exception)
 {
+	switch (exception) {
+	case ARM_EXCEPTION_SYNC_LEL:
+		switch (read_esr_el2() & ESR_EL2_EC_MASK) {
+		case ESR_EL2_EC_WFX:
+			return RMI_REC_STATS_EXIT_WFX;
+		case ESR_EL2_EC_HVC:
+			return RMI_REC_STATS_EXIT_HVC;
+		case ESR_EL2_EC_SMC:
+			return RMI_REC_STATS_EXIT_RSI;
+		case ESR_EL2_EC_SYSREG:
+			return RMI_REC_STATS_EXIT_SYSREG;
+		case ESR_EL2_EC_INST_ABORT:
+			return RMI_REC_STATS_EXIT_INST_ABORT;
+		case ESR_EL2_EC_DATA_ABORT:
+			return RMI_REC_STATS_EXIT_DATA_ABORT;
+		case ESR_EL2_EC_FPU:
+			return RMI_REC_STATS_EXIT_FPU;
+		default:
+			return RMI_REC_STATS_EXIT_SYNC_OTHER;
+		}
+	case ARM_EXCEPTION_IRQ_LEL:
+		return RMI_REC_STATS_EXIT_IRQ;
+	case ARM_EXCEPTION_FIQ_LEL:
+		return RMI_REC_STATS_EXIT_FIQ;
+	case ARM_EXCEPTION_SERROR_LEL:
+		return RMI_REC_STATS_EXIT_SERROR;
+	default:
+		return RMI_REC_STATS_NR_EXITS;
+	}
+}
+#endif /* RMM_REC_STATS || RMM_PMU_PROFILE || RMM_PC_SAMPLE */
+
+#ifdef RMM_REC_STATS
+/* Realm exits of all the RECs by cause, kept per CPU for RMI_STATS_PAGE */
+static unsigned long rec_exit_totals[MAX_CPUS][RMI_REC_STATS_NR_EXITS];
+
+static void rec_stats_count_exit(struct rec *rec, int exception)
+{
+	unsigned long stat = realm_exit_cause(exception);
+
+	if (stat == RMI_REC_STATS_NR_EXITS) {
+		return;
+	}
+
+	rec->stats.exits[stat]++;
+	rec->stats.last_exit = (unsigned int)stat;
+	rec_exit_totals[my_cpuid()][stat]++;
+}
+#endif /* RMM_REC_STATS */
+
+void rec_exit_totals_read(unsigned long *totals)
+{
+	for (unsigned long i = 0UL; i < RMI_REC_STATS_NR_EXITS; i++) {
+		totals[i] = 0UL;
+#ifdef RMM_REC_STATS
+		for (unsigned int cpu = 0U; cpu < MAX_CPUS; cpu++) {
+			totals[i] += SCA_READ64(&rec_exit_totals[cpu][i]);
+		}
+#endif
+	}
+}
+
+static bool realm_exit_dispatch(struct rec *rec, struct rmi_rec_exit *rec_exit,
+				int exception)
+{
+#ifdef RMM_REC_STATS
+	rec_stats_count_exit(rec, exception);
+#endif
+	rec->trivial_exit = false;
+
+	if (rec->wfe_poll.count != 0U) {
+		wfe_poll_update(rec, exception);
+	}
+
 	switch (exception) {
 	case ARM_EXCEPTION_SYNC_LEL: {
 		bool ret;
@@ -763,3 +1158,110 @@ bool handle_realm_exit(struct rec *rec, struct rmi_rec_exit *rec_exit, int excep
 
 	return false;
 }
+
+/* Returns 'true' when returning to Realm (S) and false when to NS */
+__hot_text
+bool handle_realm_exit(struct rec *rec, struct rmi_rec_exit *rec_exit,
+		       int exception)
+{
+#ifdef RMM_PMU_PROFILE
+	unsigned long cause = realm_exit_cause(exception);
+	struct pmu_profile_sample sample;
+	bool ret;
+
+	if (cause == RMI_REC_STATS_NR_EXITS) {
+		return realm_exit_dispatch(rec, rec_exit, exception);
+	}
+
+	pmu_profile_begin(&sample);
+	ret = realm_exit_dispatch(rec, rec_exit, exception);
+	pmu_profile_end(&sample, RMI_PMU_PROFILE_TABLE_REC_EXIT, cause);
+
+	return ret;
+#elif defined(RMM_PC_SAMPLE)
+	bool ret;
+
+	pc_sample_exit_begin(realm_exit_cause(exception));
+	ret = realm_exit_dispatch(rec, rec_exit, exception);
+	pc_sample_exit_end();
+
+	return ret;
+#else
+	return realm_exit_dispatch(rec, rec_exit, exception);
+#endif
+}
+
+/*
+ * Called by realm_exit with only x0-x18, x29 and x30 of the Realm saved to
+ * @rec, while x19-x28 of the Realm are still live in the callee-saved
+ * registers. Serve a synchronous exception which RMM emulates without
+ * touching x19-x28, and without any other effect on the REC run loop, then
+ * return 'true' to enter the Realm again straight away. Otherwise, return
+ * 'false' and realm_exit saves the rest of the GPRs and returns to
+ * rec_run_loop() which handles the exit with handle_realm_exit().
+ *
+ * The exits which are counted, traced or profiled always take the full path.
+ */
+__hot_text
+bool handle_realm_exit_fast(struct rec *rec, int exception)
+{
+#if defined(RMM_REC_STATS) || defined(RMM_REC_EXIT_TRACE) || \
+	defined(RMM_PMU_PROFILE) || defined(RMM_PC_SAMPLE)
+	(void)rec;
+	(void)exception;
+	return false;
+#else
+	unsigned long esr;
+
+	if (exception != ARM_EXCEPTION_SYNC_LEL) {
+		return false;
+	}
+
+	/*
+	 * Same conditions as the skip of the timer checks by rec_run_loop()
+	 * after a trivial exit, and nothing is left to inject.
+	 */
+	if ((rec->wfe_poll.count != 0U) || rec->sgi_local ||
+	    (rec->virq_queue.next != rec->virq_queue.nr) ||
+	    ((rec->sysregs.cnthctl_el2 &
+	      (CNTHCTL_EL2_CNTVMASK | CNTHCTL_EL2_CNTPMASK)) != 0UL)) {
+		return false;
+	}
+
+	esr = read_esr_el2();
+
+	switch (esr & ESR_EL2_EC_MASK) {
+	case ESR_EL2_EC_SYSREG: {
+		unsigned int rt = ESR_EL2_SYSREG_ISS_RT(esr);
+
+		if (((esr & ESR_EL2_SYSREG_ID_MASK) != ESR_EL2_SYSREG_ID) ||
+		    ((rt >= 19U) && (rt <= 28U))) {
+			return false;
+		}
+
+		handle_id_sysreg_trap(rec, esr);
+		break;
+	}
+	case ESR_EL2_EC_SMC: {
+		unsigned int function_id = (unsigned int)rec->regs[0];
+
+		if ((function_id != SMCCC_VERSION) &&
+		    (function_id != SMC_RSI_ABI_VERSION)) {
+			return false;
+		}
+
+		RSI_LOG_SET(rec->regs[1], rec->regs[2],
+			    rec->regs[3], rec->regs[4], rec->regs[5]);
+		rec->regs[0] = (function_id == SMCCC_VERSION) ?
+				SMCCC_VERSION_NUMBER : system_rsi_abi_version();
+		RSI_LOG_EXIT(function_id, rec->regs[0], true);
+		break;
+	}
+	default:
+		return false;
+	}
+
+	advance_pc();
+	return true;
+#endif
+}
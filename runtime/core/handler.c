@@ -6,13 +6,26 @@
 #include <arch.h>
 #include <arch_helpers.h>
 #include <assert.h>
+#include <attestation.h>
+#include <boot_phase.h>
 #include <buffer.h>
+#include <cpuid.h>
 #include <debug.h>
+#include <granule.h>
+#include <job.h>
+#include <pc_sample.h>
+#include <platform_api.h>
+#include <pmu_profile.h>
 #include <sizes.h>
 #include <smc-handler.h>
 #include <smc-rmi.h>
 #include <smc.h>
+#include <stack_profile.h>
+#include <stats_page.h>
 #include <status.h>
+#include <string.h>
+#include <table.h>
+#include <trace.h>
 #include <utils_def.h>
 
 #define STATUS_HANDLER(_id)[_id] = #_id
@@ -23,7 +36,8 @@ const char *status_handler[] = {
 	STATUS_HANDLER(RMI_ERROR_REALM),
 	STATUS_HANDLER(RMI_ERROR_REC),
 	STATUS_HANDLER(RMI_ERROR_RTT),
-	STATUS_HANDLER(RMI_ERROR_IN_USE)
+	STATUS_HANDLER(RMI_ERROR_IN_USE),
+	STATUS_HANDLER(RMI_INCOMPLETE)
 };
 COMPILER_ASSERT(ARRAY_LEN(status_handler) == RMI_ERROR_COUNT);
 
@@ -35,6 +49,10 @@ COMPILER_ASSERT(ARRAY_LEN(status_handler) == RMI_ERROR_COUNT);
  * Hence, the naming syntax is:
  * - `*_[0..4]` when no output values are returned, and
  * - `*_[0..4]_o` when the function returns some output values.
+ *
+ * The calls with the SMCCC v1.2 extended calling convention, of type
+ * `*_ext`, take their SMC_EXT_ARGS arguments in an array and return up to
+ * SMC_EXT_REGS - 1 values.
  */
 
 typedef unsigned long (*handler_0)(void);
@@ -48,8 +66,21 @@ typedef unsigned long (*handler_5)(unsigned long arg0, unsigned long arg1,
 				   unsigned long arg2, unsigned long arg3,
 				   unsigned long arg4);
 typedef void (*handler_1_o)(unsigned long arg0, struct smc_result *ret);
+typedef void (*handler_2_o)(unsigned long arg0, unsigned long arg1,
+			    struct smc_result *ret);
 typedef void (*handler_3_o)(unsigned long arg0, unsigned long arg1,
 			    unsigned long arg2, struct smc_result *ret);
+typedef void (*handler_4_o)(unsigned long arg0, unsigned long arg1,
+			    unsigned long arg2, unsigned long arg3,
+			    struct smc_result *ret);
+typedef void (*handler_5_o)(unsigned long arg0, unsigned long arg1,
+			    unsigned long arg2, unsigned long arg3,
+			    unsigned long arg4, struct smc_result *ret);
+typedef void (*handler_6_o)(unsigned long arg0, unsigned long arg1,
+			    unsigned long arg2, unsigned long arg3,
+			    unsigned long arg4, unsigned long arg5,
+			    struct smc_result *ret);
+typedef void (*handler_ext)(const unsigned long *args, union smc_regs *ret);
 
 enum rmi_type {
 	rmi_type_0,
@@ -59,7 +90,12 @@ enum rmi_type {
 	rmi_type_4,
 	rmi_type_5,
 	rmi_type_1_o,
-	rmi_type_3_o
+	rmi_type_2_o,
+	rmi_type_3_o,
+	rmi_type_4_o,
+	rmi_type_5_o,
+	rmi_type_6_o,
+	rmi_type_ext
 };
 
 struct smc_handler {
@@ -73,7 +109,12 @@ struct smc_handler {
 		handler_4	f4;
 		handler_5	f5;
 		handler_1_o	f1_o;
+		handler_2_o	f2_o;
 		handler_3_o	f3_o;
+		handler_4_o	f4_o;
+		handler_5_o	f5_o;
+		handler_6_o	f6_o;
+		handler_ext	f_ext;
 		void		*fn_dummy;
 	};
 	bool		log_exec;	/* print handler execution */
@@ -115,10 +156,30 @@ struct smc_handler {
 	.fn_name = #_id, \
 	.type = rmi_type_1_o, .f1_o = _fn, .log_exec = _exec, .log_error = _error, \
 	.out_values = _values }
+#define HANDLER_2_O(_id, _fn, _exec, _error, _values)[SMC_RMI_HANDLER_ID(_id)] = { \
+	.fn_name = #_id, \
+	.type = rmi_type_2_o, .f2_o = _fn, .log_exec = _exec, .log_error = _error, \
+	.out_values = _values }
 #define HANDLER_3_O(_id, _fn, _exec, _error, _values)[SMC_RMI_HANDLER_ID(_id)] = { \
 	.fn_name = #_id, \
 	.type = rmi_type_3_o, .f3_o = _fn, .log_exec = _exec, .log_error = _error, \
 	.out_values = _values }
+#define HANDLER_4_O(_id, _fn, _exec, _error, _values)[SMC_RMI_HANDLER_ID(_id)] = { \
+	.fn_name = #_id, \
+	.type = rmi_type_4_o, .f4_o = _fn, .log_exec = _exec, .log_error = _error, \
+	.out_values = _values }
+#define HANDLER_5_O(_id, _fn, _exec, _error, _values)[SMC_RMI_HANDLER_ID(_id)] = { \
+	.fn_name = #_id, \
+	.type = rmi_type_5_o, .f5_o = _fn, .log_exec = _exec, .log_error = _error, \
+	.out_values = _values }
+#define HANDLER_6_O(_id, _fn, _exec, _error, _values)[SMC_RMI_HANDLER_ID(_id)] = { \
+	.fn_name = #_id, \
+	.type = rmi_type_6_o, .f6_o = _fn, .log_exec = _exec, .log_error = _error, \
+	.out_values = _values }
+#define HANDLER_EXT(_id, _fn, _exec, _error, _values)[SMC_RMI_HANDLER_ID(_id)] = { \
+	.fn_name = #_id, \
+	.type = rmi_type_ext, .f_ext = _fn, .log_exec = _exec, .log_error = _error, \
+	.out_values = _values }
 
 /*
  * The 3rd value enables the execution log.
@@ -129,14 +190,14 @@ static const struct smc_handler smc_handlers[] = {
 	HANDLER_1_O(SMC_RMM_FEATURES,		 smc_read_feature_register,	true,  true, 1U),
 	HANDLER_1(SMC_RMM_GRANULE_DELEGATE,	 smc_granule_delegate,		false, true),
 	HANDLER_1(SMC_RMM_GRANULE_UNDELEGATE,	 smc_granule_undelegate,	false, true),
-	HANDLER_2(SMC_RMM_REALM_CREATE,		 smc_realm_create,		true,  true),
+	HANDLER_2_O(SMC_RMM_REALM_CREATE,	 smc_realm_create,		true,  true, 2U),
 	HANDLER_1(SMC_RMM_REALM_DESTROY,	 smc_realm_destroy,		true,  true),
 	HANDLER_1(SMC_RMM_REALM_ACTIVATE,	 smc_realm_activate,		true,  true),
 	HANDLER_3(SMC_RMM_REC_CREATE,		 smc_rec_create,		true,  true),
-	HANDLER_1(SMC_RMM_REC_DESTROY,		 smc_rec_destroy,		true,  true),
+	HANDLER_3_O(SMC_RMM_REC_DESTROY,	 smc_rec_destroy,		true,  true, 2U),
 	HANDLER_2(SMC_RMM_REC_ENTER,		 smc_rec_enter,			false, true),
 	HANDLER_5(SMC_RMM_DATA_CREATE,		 smc_data_create,		false, false),
-	HANDLER_3(SMC_RMM_DATA_CREATE_UNKNOWN,	 smc_data_create_unknown,	false, false),
+	HANDLER_4(SMC_RMM_DATA_CREATE_UNKNOWN,	 smc_data_create_unknown,	false, false),
 	HANDLER_2(SMC_RMM_DATA_DESTROY,		 smc_data_destroy,		false, true),
 	HANDLER_4(SMC_RMM_RTT_CREATE,		 smc_rtt_create,		false, true),
 	HANDLER_4(SMC_RMM_RTT_DESTROY,		 smc_rtt_destroy,		false, true),
@@ -147,13 +208,292 @@ static const struct smc_handler smc_handlers[] = {
 	HANDLER_2(SMC_RMM_PSCI_COMPLETE,	 smc_psci_complete,		true,  true),
 	HANDLER_1_O(SMC_RMM_REC_AUX_COUNT,	 smc_rec_aux_count,		true,  true, 1U),
 	HANDLER_3(SMC_RMM_RTT_INIT_RIPAS,	 smc_rtt_init_ripas,		false, true),
-	HANDLER_5(SMC_RMM_RTT_SET_RIPAS,	 smc_rtt_set_ripas,		false, true)
+	HANDLER_5_O(SMC_RMM_RTT_SET_RIPAS,	 smc_rtt_set_ripas,		false, true, 1U),
+	HANDLER_2_O(SMC_RMM_GRANULE_DELEGATE_RANGE, smc_granule_delegate_range, false, true, 1U),
+	HANDLER_2_O(SMC_RMM_GRANULE_UNDELEGATE_RANGE, smc_granule_undelegate_range, false, true, 1U),
+	HANDLER_6_O(SMC_RMM_DATA_CREATE_RANGE,	 smc_data_create_range,		false, false, 1U),
+	HANDLER_1_O(SMC_RMM_RTT_RECLAIM,	 smc_rtt_reclaim,		false, true, 2U),
+	HANDLER_4_O(SMC_RMM_RTT_INIT_RIPAS_RANGE, smc_rtt_init_ripas_range,	false, true, 1U),
+	HANDLER_3_O(SMC_RMM_RMI_STATS,		 smc_rmi_stats,			false, false, 2U),
+	HANDLER_2(SMC_RMM_TRACE_DUMP,		 smc_trace_dump,		false, false),
+	HANDLER_2_O(SMC_RMM_REC_STATS,		 smc_rec_stats,			false, false, 1U),
+	HANDLER_2(SMC_RMM_REC_MMIO_RING,	 smc_rec_mmio_ring,		true,  true),
+	HANDLER_1_O(SMC_RMM_REC_ATTEST_SIGN,	 smc_rec_attest_sign,		false, true, 1U),
+	HANDLER_0(SMC_RMM_PLATFORM_TOKEN_REFRESH, smc_platform_token_refresh,	true,  true),
+	HANDLER_1_O(SMC_RMM_VMID_FIND,		 smc_vmid_find,			false, true, 1U),
+	HANDLER_2_O(SMC_RMM_REALM_TEARDOWN,	 smc_realm_teardown,		true,  true, 1U),
+	HANDLER_3_O(SMC_RMM_REC_CREATE_MULTI,	 smc_rec_create_multi,		true,  true, 1U),
+	HANDLER_5_O(SMC_RMM_RTT_MAP_UNPROTECTED_RANGE, smc_rtt_map_unprotected_range, false, false, 1U),
+	HANDLER_4_O(SMC_RMM_RTT_UNMAP_UNPROTECTED_RANGE, smc_rtt_unmap_unprotected_range, false, false, 1U),
+	HANDLER_4_O(SMC_RMM_RTT_READ_ENTRIES,	 smc_rtt_read_entries,		false, true, 1U),
+	HANDLER_4_O(SMC_RMM_PMU_PROFILE,	 smc_pmu_profile,		false, false, 1U),
+	HANDLER_4_O(SMC_RMM_RTT_SCAN_ACCESS,	 smc_rtt_scan_access,		false, true, 1U),
+	HANDLER_3_O(SMC_RMM_GRANULE_STATS,	 smc_granule_stats,		false, false, 1U),
+	HANDLER_2(SMC_RMM_REC_EXIT_TRACE_DUMP,	 smc_rec_exit_trace_dump,	false, false),
+	HANDLER_2_O(SMC_RMM_REALM_FOOTPRINT,	 smc_realm_footprint,		false, false, 1U),
+	HANDLER_3_O(SMC_RMM_RTT_POOL_DONATE,	 smc_rtt_pool_donate,		false, true, 1U),
+	HANDLER_2_O(SMC_RMM_RTT_POOL_REPORT,	 smc_rtt_pool_report,		false, true, 2U),
+	HANDLER_6_O(SMC_RMM_RTT_CREATE_MULTI,	 smc_rtt_create_multi,		false, true, 2U),
+	HANDLER_4_O(SMC_RMM_RTT_DESTROY_TREE,	 smc_rtt_destroy_tree,		false, true, 2U),
+	HANDLER_4_O(SMC_RMM_DATA_DESTROY_RANGE,	 smc_data_destroy_range,	false, true, 2U),
+	HANDLER_3_O(SMC_RMM_JOB_SUBMIT,		 smc_job_submit,		true,  true, 1U),
+	HANDLER_1_O(SMC_RMM_JOB_POLL,		 smc_job_poll,			false, true, 3U),
+	HANDLER_3_O(SMC_RMM_DATA_POOL_DONATE,	 smc_data_pool_donate,		false, true, 1U),
+	HANDLER_2_O(SMC_RMM_DATA_POOL_REPORT,	 smc_data_pool_report,		false, true, 2U),
+	HANDLER_1(SMC_RMM_RTT_WALK_HINT,	 smc_rtt_walk_hint,		false, true),
+	HANDLER_EXT(SMC_RMM_GRANULE_DELEGATE_MULTI, smc_granule_delegate_multi, false, true, 1U),
+	HANDLER_2_O(SMC_RMM_GRANULE_DELEGATE_PRESERVE_RANGE, smc_granule_delegate_preserve_range, false, true, 1U),
+	HANDLER_3_O(SMC_RMM_GRANULE_STATE_QUERY, smc_granule_state_query,	false, false, 1U),
+	HANDLER_6_O(SMC_RMM_RTT_SHARE_RANGE,	 smc_rtt_share_range,		false, true, 2U),
+	HANDLER_5_O(SMC_RMM_RTT_SHARED,		 smc_rtt_shared,		false, true, 1U),
+	HANDLER_3_O(SMC_RMM_DATA_EXPORT,	 smc_data_export,		false, true, 3U),
+	HANDLER_5(SMC_RMM_DATA_IMPORT,		 smc_data_import,		false, true)
 };
 
+
 COMPILER_ASSERT(ARRAY_LEN(smc_handlers) == SMC64_NUM_FIDS_IN_RANGE(RMI));
 
-static bool rmi_call_log_enabled = true;
+COMPILER_ASSERT(RMI_BOOT_PHASE_EL3_IFC == (unsigned long)BOOT_PHASE_EL3_IFC);
+COMPILER_ASSERT(RMI_BOOT_PHASE_XLAT == (unsigned long)BOOT_PHASE_XLAT);
+COMPILER_ASSERT(RMI_BOOT_PHASE_GRANULES == (unsigned long)BOOT_PHASE_GRANULES);
+COMPILER_ASSERT(RMI_BOOT_PHASE_SLOT_BUF == (unsigned long)BOOT_PHASE_SLOT_BUF);
+COMPILER_ASSERT(RMI_BOOT_PHASE_PRNG == (unsigned long)BOOT_PHASE_PRNG);
+COMPILER_ASSERT(RMI_BOOT_PHASE_ATTEST_KEY ==
+		(unsigned long)BOOT_PHASE_ATTEST_KEY);
+COMPILER_ASSERT(RMI_BOOT_PHASE_PLAT_TOKEN ==
+		(unsigned long)BOOT_PHASE_PLAT_TOKEN);
+COMPILER_ASSERT(RMI_BOOT_PHASE_NR == (unsigned long)BOOT_PHASE_NR);
+
+#ifdef RMM_RMI_STATS
+struct rmi_handler_stats {
+	unsigned long calls;
+	unsigned long errors;
+	unsigned long ticks;
+	unsigned long max_ticks;
+	unsigned long slot_maps;
+	unsigned long s1_flushes;
+};
+
+/*
+ * Statistics of each RMI handler. They are kept per CPU so that updating
+ * them does not need any synchronisation.
+ */
+static struct rmi_handler_stats rmi_stats[MAX_CPUS][ARRAY_LEN(smc_handlers)];
+
+static void rmi_stats_update(unsigned long handler_id,
+			     unsigned long ticks,
+			     unsigned long slot_maps,
+			     unsigned long s1_flushes,
+			     struct smc_result *ret)
+{
+	struct rmi_handler_stats *stats = &rmi_stats[my_cpuid()][handler_id];
+
+	stats->calls++;
+	stats->ticks += ticks;
+	stats->slot_maps += slot_maps;
+	stats->s1_flushes += s1_flushes;
+
+	if (ticks > stats->max_ticks) {
+		stats->max_ticks = ticks;
+	}
+
+	/* RMM_VERSION returns the version number, not a status code */
+	if (SMC64_RMI_FID(handler_id) != SMC_RMM_VERSION) {
+		status_t status = unpack_return_code(ret->x[0]).status;
+
+		if ((status != RMI_SUCCESS) && (status != RMI_INCOMPLETE)) {
+			stats->errors++;
+		}
+	}
+}
+#endif /* RMM_RMI_STATS */
+
+COMPILER_ASSERT(ARRAY_LEN(smc_handlers) <= RMI_STATS_PAGE_NR_CMDS);
+
+void rmi_stats_sum(struct rmi_stats_page_cmd *cmds)
+{
+	(void)memset(cmds, 0, RMI_STATS_PAGE_NR_CMDS * sizeof(*cmds));
+
+#ifdef RMM_RMI_STATS
+	for (unsigned int cpu = 0U; cpu < MAX_CPUS; cpu++) {
+		for (unsigned int i = 0U; i < ARRAY_LEN(smc_handlers); i++) {
+			const struct rmi_handler_stats *stats =
+							&rmi_stats[cpu][i];
+
+			unsigned long max_ticks = SCA_READ64(&stats->max_ticks);
+
+			cmds[i].calls += SCA_READ64(&stats->calls);
+			cmds[i].errors += SCA_READ64(&stats->errors);
+			cmds[i].ticks += SCA_READ64(&stats->ticks);
+			if (max_ticks > cmds[i].max_ticks) {
+				cmds[i].max_ticks = max_ticks;
+			}
+		}
+	}
+#endif
+}
+
+void smc_rmi_stats(unsigned long fid,
+		   unsigned long cpu,
+		   unsigned long stat,
+		   struct smc_result *ret)
+{
+	if (stat == RMI_STATS_PAGE) {
+		ret->x[0] = stats_page_register(fid, cpu);
+		ret->x[1] = 0UL;
+		return;
+	}
+
+	if (stat == RMI_STATS_BOOT_PHASE) {
+		if ((cpu >= RMI_BOOT_PHASE_NR) ||
+		    !boot_phase_get((enum boot_phase)cpu, &ret->x[1],
+				    &ret->x[2])) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			ret->x[1] = 0UL;
+			ret->x[2] = 0UL;
+			return;
+		}
+
+		ret->x[0] = RMI_SUCCESS;
+		return;
+	}
+
+#ifdef RMM_STACK_PROFILE
+	if (stat == RMI_STATS_MAX_STACK) {
+		if (!stack_profile_read(fid, cpu, &ret->x[1])) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			ret->x[1] = 0UL;
+			return;
+		}
+
+		ret->x[0] = RMI_SUCCESS;
+		return;
+	}
+#endif
+#ifdef RMM_RMI_STATS
+	const struct rmi_handler_stats *stats;
+	unsigned long handler_id;
+
+	ret->x[1] = 0UL;
+
+	if (!IS_SMC64_RMI_FID(fid) || (cpu >= MAX_CPUS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	handler_id = SMC_RMI_HANDLER_ID(fid);
+	if (handler_id >= ARRAY_LEN(smc_handlers)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	stats = &rmi_stats[cpu][handler_id];
+
+	switch (stat) {
+	case RMI_STATS_CALLS:
+		ret->x[1] = stats->calls;
+		break;
+	case RMI_STATS_ERRORS:
+		ret->x[1] = stats->errors;
+		break;
+	case RMI_STATS_TICKS:
+		ret->x[1] = stats->ticks;
+		break;
+	case RMI_STATS_MAX_TICKS:
+		ret->x[1] = stats->max_ticks;
+		break;
+	case RMI_STATS_SLOT_MAPS:
+		ret->x[1] = stats->slot_maps;
+		break;
+	case RMI_STATS_S1_FLUSHES:
+		ret->x[1] = stats->s1_flushes;
+		break;
+	default:
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	ret->x[0] = RMI_SUCCESS;
+#else
+	(void)fid;
+	(void)cpu;
+	(void)stat;
+
+	/* The statistics are not collected by this build */
+	ret->x[0] = RMI_ERROR_INPUT;
+	ret->x[1] = 0UL;
+#endif /* RMM_RMI_STATS */
+}
+
+/*
+ * Start the budget of a preemptible RMI command. The command then calls
+ * rmi_budget_exhausted() between two steps which leave its objects in a
+ * consistent state, and returns with rmi_return_incomplete() if it is.
+ */
+void rmi_budget_start(struct rmi_budget *budget)
+{
+#ifdef RMM_RMI_BUDGET_US
+	budget->deadline = read_cntpct_el0() +
+		((RMM_RMI_BUDGET_US * read_cntfrq_el0()) / 1000000UL);
+#else
+	budget->deadline = 0UL;
+#endif
+}
+
+/*
+ * Return true if the preemptible RMI command should return to the Host,
+ * either to let it take a pending interrupt or because the command has run
+ * for longer than RMM_RMI_BUDGET_US.
+ */
+bool rmi_budget_exhausted(const struct rmi_budget *budget)
+{
+	if (read_isr_el1() != 0UL) {
+		return true;
+	}
+
+#ifdef RMM_RMI_BUDGET_US
+	return (read_cntpct_el0() >= budget->deadline);
+#else
+	(void)budget;
+	return false;
+#endif
+}
+
+/*
+ * Return RMI_INCOMPLETE from a preempted RMI command, with @progress as its
+ * first output value. The Host passes @progress back, as documented for
+ * each command, to resume it.
+ */
+void rmi_return_incomplete(struct smc_result *ret, unsigned long progress)
+{
+	ret->x[0] = pack_return_code(RMI_INCOMPLETE, 0U);
+	ret->x[1] = progress;
+}
 
+/*
+ * The calls are not logged on the console when they are recorded in the
+ * binary trace instead, or when INFO() is compiled out. The logger is then
+ * compiled out as well, so that the calls do not pay for decoding the
+ * return code and testing the log flags of their handler.
+ */
+#if defined(RMM_TRACE) || (LOG_LEVEL < LOG_LEVEL_INFO)
+static inline void rmi_log_on_exit(unsigned long handler_id,
+				   unsigned long arg0,
+				   unsigned long arg1,
+				   unsigned long arg2,
+				   unsigned long arg3,
+				   unsigned long arg4,
+				   struct smc_result *ret)
+{
+	(void)handler_id;
+	(void)arg0;
+	(void)arg1;
+	(void)arg2;
+	(void)arg3;
+	(void)arg4;
+	(void)ret;
+}
+#else
 static void rmi_log_on_exit(unsigned long handler_id,
 			    unsigned long arg0,
 			    unsigned long arg1,
@@ -209,39 +549,54 @@ static void rmi_log_on_exit(unsigned long handler_id,
 		INFO("\n");
 	}
 }
+#endif /* RMM_TRACE || LOG_LEVEL < LOG_LEVEL_INFO */
 
-void handle_ns_smc(unsigned long function_id,
-		   unsigned long arg0,
-		   unsigned long arg1,
-		   unsigned long arg2,
-		   unsigned long arg3,
-		   unsigned long arg4,
-		   unsigned long arg5,
-		   struct smc_result *ret)
+/*
+ * Call the handler of an RMI call with the extended calling convention, with
+ * X1-X17 of the call in an array. X7-X17 are read from @regs, where
+ * rmm_handler saved them.
+ */
+static void rmi_dispatch_ext(const struct smc_handler *handler,
+			     unsigned long arg0,
+			     unsigned long arg1,
+			     unsigned long arg2,
+			     unsigned long arg3,
+			     unsigned long arg4,
+			     unsigned long arg5,
+			     union smc_regs *regs)
 {
-	unsigned long handler_id;
-	const struct smc_handler *handler = NULL;
+	unsigned long args[SMC_EXT_ARGS] = {
+		arg0, arg1, arg2, arg3, arg4, arg5
+	};
 
-	if (IS_SMC64_RMI_FID(function_id)) {
-		handler_id = SMC_RMI_HANDLER_ID(function_id);
-		if (handler_id < ARRAY_LEN(smc_handlers)) {
-			handler = &smc_handlers[handler_id];
-		}
+	for (unsigned int i = 6U; i < SMC_EXT_ARGS; i++) {
+		args[i] = regs->x[i + 1U];
 	}
 
-	/*
-	 * Check if handler exists and 'fn_dummy' is not NULL
-	 * for not implemented 'function_id' calls in SMC RMI range.
-	 */
-	if ((handler == NULL) || (handler->fn_dummy == NULL)) {
-		VERBOSE("[%s] unknown function_id: %lx\n",
-			__func__, function_id);
-		ret->x[0] = SMC_UNKNOWN;
+	handler->f_ext(args, regs);
+}
+
+/*
+ * Call the handler of an RMI call. REC_ENTER, which is by far the most
+ * frequent call, is called directly rather than through the handler table.
+ */
+static inline void rmi_dispatch(unsigned long function_id,
+				const struct smc_handler *handler,
+				unsigned long arg0,
+				unsigned long arg1,
+				unsigned long arg2,
+				unsigned long arg3,
+				unsigned long arg4,
+				unsigned long arg5,
+				union smc_regs *regs)
+{
+	struct smc_result *ret = &regs->res;
+
+	if (function_id == SMC_RMM_REC_ENTER) {
+		ret->x[0] = smc_rec_enter(arg0, arg1);
 		return;
 	}
 
-	assert_cpu_slots_empty();
-
 	switch (handler->type) {
 	case rmi_type_0:
 		ret->x[0] = handler->f0();
@@ -264,17 +619,149 @@ void handle_ns_smc(unsigned long function_id,
 	case rmi_type_1_o:
 		handler->f1_o(arg0, ret);
 		break;
+	case rmi_type_2_o:
+		handler->f2_o(arg0, arg1, ret);
+		break;
 	case rmi_type_3_o:
 		handler->f3_o(arg0, arg1, arg2, ret);
 		break;
+	case rmi_type_4_o:
+		handler->f4_o(arg0, arg1, arg2, arg3, ret);
+		break;
+	case rmi_type_5_o:
+		handler->f5_o(arg0, arg1, arg2, arg3, arg4, ret);
+		break;
+	case rmi_type_6_o:
+		handler->f6_o(arg0, arg1, arg2, arg3, arg4, arg5, ret);
+		break;
+	case rmi_type_ext:
+		rmi_dispatch_ext(handler, arg0, arg1, arg2, arg3, arg4, arg5,
+				 regs);
+		break;
 	default:
 		assert(false);
 	}
+}
 
-	if (rmi_call_log_enabled) {
-		rmi_log_on_exit(handler_id, arg0, arg1, arg2, arg3, arg4, ret);
+__hot_text
+void handle_ns_smc(unsigned long function_id,
+		   unsigned long arg0,
+		   unsigned long arg1,
+		   unsigned long arg2,
+		   unsigned long arg3,
+		   unsigned long arg4,
+		   unsigned long arg5,
+		   union smc_regs *regs)
+{
+	struct smc_result *ret = &regs->res;
+	unsigned long handler_id;
+	const struct smc_handler *handler = NULL;
+#ifdef RMM_RMI_STATS
+	unsigned long start_ticks, start_slot_maps, start_s1_flushes;
+#endif
+#ifdef RMM_PMU_PROFILE
+	struct pmu_profile_sample sample;
+#endif
+
+	if (IS_SMC64_RMI_FID(function_id)) {
+		handler_id = SMC_RMI_HANDLER_ID(function_id);
+		if (handler_id < ARRAY_LEN(smc_handlers)) {
+			handler = &smc_handlers[handler_id];
+		}
 	}
 
+	/*
+	 * Check if handler exists and 'fn_dummy' is not NULL
+	 * for not implemented 'function_id' calls in SMC RMI range.
+	 */
+	if ((handler == NULL) || (handler->fn_dummy == NULL)) {
+		VERBOSE("[%s] unknown function_id: %lx\n",
+			__func__, function_id);
+		ret->x[0] = SMC_UNKNOWN;
+		return;
+	}
+
+	/* The granule table must be fully zeroed before the first RMI call */
+	granule_table_init_complete();
+
+	assert_cpu_slots_empty();
+
+#ifdef RMM_RMI_STATS
+	start_slot_maps = buffer_slot_map_count();
+	start_s1_flushes = s2tt_s1_flush_count();
+	start_ticks = read_cntpct_el0();
+#endif
+#ifdef RMM_PMU_PROFILE
+	pmu_profile_begin(&sample);
+#endif
+#ifdef RMM_STACK_PROFILE
+	stack_profile_begin();
+#endif
+#ifdef RMM_PC_SAMPLE
+	pc_sample_begin(function_id);
+#endif
+
+	rmi_dispatch(function_id, handler, arg0, arg1, arg2, arg3, arg4, arg5,
+		     regs);
+
+#ifdef RMM_PC_SAMPLE
+	pc_sample_end();
+#endif
+
+#ifdef RMM_STACK_PROFILE
+	stack_profile_end(function_id);
+#endif
+
+#ifdef RMM_PMU_PROFILE
+	pmu_profile_end(&sample, RMI_PMU_PROFILE_TABLE_RMI, handler_id);
+#endif
+
+#ifdef RMM_RMI_STATS
+	rmi_stats_update(handler_id, read_cntpct_el0() - start_ticks,
+			 buffer_slot_map_count() - start_slot_maps,
+			 s2tt_s1_flush_count() - start_s1_flushes, ret);
+#endif
+
+#ifdef RMM_TRACE
+	{
+		unsigned long args[5] = {arg0, arg1, arg2, arg3, arg4};
+
+		trace_call((unsigned int)function_id, 0U, args,
+			   ret->x[0], ret->x[1]);
+	}
+#endif
+
+	rmi_log_on_exit(handler_id, arg0, arg1, arg2, arg3, arg4, ret);
+
+#ifdef RMM_PRESCRUB_BUDGET
+	/*
+	 * Zero some delegated granules before returning to the Host, so
+	 * that the RMI calls creating Realm objects find them scrubbed.
+	 */
+	granule_prescrub(RMM_PRESCRUB_BUDGET);
+#endif
+
+	/* Make progress on the jobs the Host does not wait for */
+	rmi_jobs_run();
+
+	/* Refresh the statistics page of the Host, if it is due */
+	stats_page_update();
+
+	/* Send the log lines which did not fit in the UART when queued */
+	plat_console_drain();
+
+#ifdef RMM_GRANULE_CHECK_SAMPLE
+	/* Cover the granules whose lock operations were not sampled */
+	granule_check_sweep();
+#endif
+
+	/*
+	 * Reseed the PRNG of this CPU, if it is due, now rather than while
+	 * a Realm token is being signed.
+	 */
+	attestation_rnd_reseed();
+
+	buffer_slots_flush();
 	assert_cpu_slots_empty();
 }
 
@@ -326,7 +813,15 @@ struct rmm_trap_element {
  * The registered locations of load/store instructions that access NS memory.
  */
 extern void *ns_read;
+extern void *ns_read_64_0;
+extern void *ns_read_64_1;
+extern void *ns_read_64_2;
+extern void *ns_read_64_3;
 extern void *ns_write;
+extern void *ns_write_64_0;
+extern void *ns_write_64_1;
+extern void *ns_write_64_2;
+extern void *ns_write_64_3;
 
 /*
  * The new value of the PC when the GPF occurs on a registered location.
@@ -335,7 +830,15 @@ extern void *ns_access_ret_0;
 
 struct rmm_trap_element rmm_trap_list[] = {
 	RMM_TRAP_HANDLER(ns_read, ns_access_ret_0),
+	RMM_TRAP_HANDLER(ns_read_64_0, ns_access_ret_0),
+	RMM_TRAP_HANDLER(ns_read_64_1, ns_access_ret_0),
+	RMM_TRAP_HANDLER(ns_read_64_2, ns_access_ret_0),
+	RMM_TRAP_HANDLER(ns_read_64_3, ns_access_ret_0),
 	RMM_TRAP_HANDLER(ns_write, ns_access_ret_0),
+	RMM_TRAP_HANDLER(ns_write_64_0, ns_access_ret_0),
+	RMM_TRAP_HANDLER(ns_write_64_1, ns_access_ret_0),
+	RMM_TRAP_HANDLER(ns_write_64_2, ns_access_ret_0),
+	RMM_TRAP_HANDLER(ns_write_64_3, ns_access_ret_0),
 };
 #define RMM_TRAP_LIST_SIZE (sizeof(rmm_trap_list)/sizeof(struct rmm_trap_element))
 
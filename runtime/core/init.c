@@ -4,10 +4,14 @@
  */
 
 #include <arch_helpers.h>
-#include <attestation.h>
+#include <boot_phase.h>
 #include <buffer.h>
 #include <debug.h>
+#include <granule.h>
+#include <mecid.h>
+#include <pauth.h>
 #include <rmm_el3_ifc.h>
+#include <run.h>
 #include <smc-rmi.h>
 #include <smc-rsi.h>
 
@@ -27,10 +31,51 @@ static void rmm_arch_init(void)
 	MPAM(write_mpamhcr_el2(MPAMHCR_EL2_INIT));
 	SPE(write_pmscr_el2(PMSCR_EL2_INIT));
 
+	/* RMM accesses its own memory and the Realm memory with MECID_RMM */
+	MEC(write_mecid_p0_el2(MECID_RMM));
+	MEC(write_mecid_p1_el2(MECID_RMM));
+	MEC(write_mecid_a0_el2(MECID_RMM));
+	MEC(write_mecid_a1_el2(MECID_RMM));
+	MEC(write_vmecid_p_el2(MECID_RMM));
+	MEC(write_vmecid_a_el2(MECID_RMM));
+
 	write_cnthctl_el2(CNTHCTL_EL2_INIT);
 	write_mdcr_el2(MDCR_EL2_INIT);
 }
 
+/*
+ * Report the time spent in the phases of the cold boot which have run so
+ * far. The attestation phases only run on the first use of attestation, and
+ * are then reported by RMI_RMI_STATS.
+ */
+static void boot_phase_report(void)
+{
+	static const char *const names[BOOT_PHASE_NR] = {
+		[BOOT_PHASE_EL3_IFC]	= "el3_ifc",
+		[BOOT_PHASE_XLAT]	= "xlat",
+		[BOOT_PHASE_GRANULES]	= "granules",
+		[BOOT_PHASE_SLOT_BUF]	= "slot_buf",
+		[BOOT_PHASE_PRNG]	= "prng",
+		[BOOT_PHASE_ATTEST_KEY]	= "attest_key",
+		[BOOT_PHASE_PLAT_TOKEN]	= "plat_token"
+	};
+	unsigned long freq = read_cntfrq_el0();
+
+	if (freq == 0UL) {
+		return;
+	}
+
+	INFO("Boot phases (us):");
+	for (unsigned int i = 0U; i < (unsigned int)BOOT_PHASE_NR; i++) {
+		unsigned long ticks, start;
+
+		if (boot_phase_get((enum boot_phase)i, &ticks, &start)) {
+			INFO(" %s %lu", names[i], (ticks * 1000000UL) / freq);
+		}
+	}
+	INFO("\n");
+}
+
 void rmm_warmboot_main(void)
 {
 	/*
@@ -41,7 +86,20 @@ void rmm_warmboot_main(void)
 	/*
 	 * Finish initializing the slot buffer mechanism
 	 */
+	boot_phase_start(BOOT_PHASE_SLOT_BUF);
 	slot_buf_init();
+	boot_phase_end(BOOT_PHASE_SLOT_BUF);
+
+	/*
+	 * Zero a share of the granule table. The rest is done by the first
+	 * RMI call, if the other CPUs have not booted by then.
+	 */
+	boot_phase_start(BOOT_PHASE_GRANULES);
+	granule_table_init_share();
+	boot_phase_end(BOOT_PHASE_GRANULES);
+
+	realm_el2_state_reset();
+	pauth_reset();
 }
 
 void rmm_main(void)
@@ -82,7 +140,5 @@ void rmm_main(void)
 
 	rmm_warmboot_main();
 
-	if (attestation_init() != 0) {
-		WARN("Attestation init failed.\n");
-	}
+	boot_phase_report();
 }
@@ -0,0 +1,40 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <arch_helpers.h>
+#include <atomics.h>
+#include <mecid.h>
+#include <utils_def.h>
+
+/*
+ * Next MECID given to a Realm. The MECIDs are only given once per boot, as
+ * RMM cannot have the key of a MECID changed: the DATA granules of a Realm
+ * which has its own MECID are not zeroed when they are destroyed, so a later
+ * Realm with the same MECID could read their content.
+ */
+static uint64_t next_mecid = (uint64_t)MECID_RMM + 1UL;
+
+/*
+ * Return the MECID of a new Realm, or MECID_RMM if RMM is built without
+ * RMM_MEC or once all the MECIDs implemented have been given. A Realm with
+ * MECID_RMM shares the memory encryption context of RMM, and its DATA
+ * granules are zeroed when they are destroyed.
+ */
+unsigned int mecid_alloc(void)
+{
+	unsigned long nr_mecids;
+	unsigned long mecid;
+
+	if (!HAS_MEC) {
+		return MECID_RMM;
+	}
+
+	nr_mecids = 1UL << (EXTRACT(MECIDR_EL2_MECIDWIDTHM1,
+				    read_mecidr_el2()) + 1UL);
+	mecid = atomic_load_add_release_64(&next_mecid, 1L);
+
+	return (mecid < nr_mecids) ? (unsigned int)mecid : MECID_RMM;
+}
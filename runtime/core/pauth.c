@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <arch_helpers.h>
+#include <atomics.h>
+#include <cpuid.h>
+#include <pauth.h>
+#include <percpu.h>
+#include <rec.h>
+#include <run.h>
+#include <utils_def.h>
+
+/* Pointer Authentication is enabled for EL1&0 by any of these bits */
+#define SCTLR_EL1_PAUTH_EN	(SCTLR_EL1_EnIA | SCTLR_EL1_EnIB | \
+				 SCTLR_EL1_EnDA | SCTLR_EL1_EnDB)
+
+/* Identifier of the keys the CPU holds, zero if none */
+static DEFINE_PER_CPU(unsigned long, pauth_loaded_id);
+
+/* Next identifier given to keys, never reused as it is 64-bit wide */
+static uint64_t next_pauth_id = 1UL;
+
+unsigned long pauth_new_id(void)
+{
+	return atomic_load_add_release_64(&next_pauth_id, 1L);
+}
+
+void pauth_reset(void)
+{
+	per_cpu(pauth_loaded_id, my_cpuid()) = 0UL;
+}
+
+void pauth_enter_realm(struct rec *rec)
+{
+	unsigned long *loaded_id = &per_cpu(pauth_loaded_id, my_cpuid());
+	struct pauth_state *keys = &rec->sysregs.pauth;
+
+	if (rec->pauth_id == 0UL) {
+		return;
+	}
+
+	if (*loaded_id != rec->pauth_id) {
+		write_apiakeylo_el1(keys->apiakeylo_el1);
+		write_apiakeyhi_el1(keys->apiakeyhi_el1);
+		write_apibkeylo_el1(keys->apibkeylo_el1);
+		write_apibkeyhi_el1(keys->apibkeyhi_el1);
+		write_apdakeylo_el1(keys->apdakeylo_el1);
+		write_apdakeyhi_el1(keys->apdakeyhi_el1);
+		write_apdbkeylo_el1(keys->apdbkeylo_el1);
+		write_apdbkeyhi_el1(keys->apdbkeyhi_el1);
+		write_apgakeylo_el1(keys->apgakeylo_el1);
+		write_apgakeyhi_el1(keys->apgakeyhi_el1);
+		*loaded_id = rec->pauth_id;
+	}
+
+	/*
+	 * The keys are only accessed without trapping, and thus saved on
+	 * REC exit, while the Realm has Pointer Authentication enabled.
+	 */
+	if ((rec->sysregs.sctlr_el1 & SCTLR_EL1_PAUTH_EN) != 0UL) {
+		rec->sysregs.hcr_el2 |= HCR_APK;
+	}
+}
+
+void pauth_exit_realm(struct rec *rec)
+{
+	struct pauth_state *keys = &rec->sysregs.pauth;
+
+	if ((rec->sysregs.hcr_el2 & HCR_APK) == 0UL) {
+		return;
+	}
+
+	keys->apiakeylo_el1 = read_apiakeylo_el1();
+	keys->apiakeyhi_el1 = read_apiakeyhi_el1();
+	keys->apibkeylo_el1 = read_apibkeylo_el1();
+	keys->apibkeyhi_el1 = read_apibkeyhi_el1();
+	keys->apdakeylo_el1 = read_apdakeylo_el1();
+	keys->apdakeyhi_el1 = read_apdakeyhi_el1();
+	keys->apdbkeylo_el1 = read_apdbkeylo_el1();
+	keys->apdbkeyhi_el1 = read_apdbkeyhi_el1();
+	keys->apgakeylo_el1 = read_apgakeylo_el1();
+	keys->apgakeyhi_el1 = read_apgakeyhi_el1();
+
+	/*
+	 * The Realm may have changed the keys, in which case the copies held
+	 * by the other CPUs that ran the REC are stale.
+	 */
+	rec->pauth_id = pauth_new_id();
+	per_cpu(pauth_loaded_id, my_cpuid()) = rec->pauth_id;
+}
+
+bool pauth_handle_sysreg_trap(struct rec *rec, unsigned long esr)
+{
+	unsigned long sysreg = esr & ESR_EL2_SYSREG_MASK;
+
+	if ((rec->pauth_id == 0UL) ||
+	    ((sysreg & ESR_EL2_SYSREG_PAUTH_KEY_MASK) !=
+	     ESR_EL2_SYSREG_PAUTH_KEY)) {
+		return false;
+	}
+
+	/*
+	 * The keys are saved on this REC exit, and the HCR_EL2 recorded for
+	 * the CPU no longer matches the register.
+	 */
+	rec->sysregs.hcr_el2 |= HCR_APK;
+	write_hcr_el2(rec->sysregs.hcr_el2);
+	isb();
+	realm_el2_state_reset();
+
+	return true;
+}
@@ -0,0 +1,283 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <arch_features.h>
+#include <arch_helpers.h>
+#include <assert.h>
+#include <buffer.h>
+#include <cpuid.h>
+#include <granule.h>
+#include <pc_sample.h>
+#include <smc-rmi.h>
+#include <smc.h>
+#include <stdbool.h>
+#include <trace.h>
+
+#ifdef RMM_PC_SAMPLE
+/* Count the CPU cycles at Realm EL2 only, as for RMM_PMU_PROFILE */
+#define PC_SAMPLE_EVTYPER	(PMEVTYPER_EL0_P_BIT | PMEVTYPER_EL0_U_BIT | \
+				 PMEVTYPER_EL0_NSH_BIT | \
+				 PMEVTYPER_EL0_RLH_BIT | PMU_EVENT_CPU_CYCLES)
+
+/* The event counters used at EL2 are 32-bit wide unless MDCR_EL2.HLP */
+#define PC_SAMPLE_RELOAD	((0UL - (unsigned long)RMM_PC_SAMPLE_PERIOD) & \
+				 0xffffffffUL)
+
+struct pc_sample_cpu {
+	/* The counter is programmed for RMM */
+	bool active;
+	/* Context of the samples taken now, see struct pc_sample_record */
+	unsigned int ctx;
+	unsigned int flags;
+
+	/* NS state of the counter, saved by pc_sample_begin() */
+	unsigned long mdcr_el2;
+	unsigned long pmselr_el0;
+	unsigned long pmcntenset_el0;
+	unsigned long pmintenset_el1;
+	unsigned long pmovsset_el0;
+	unsigned long pmevcntr_el0;
+	unsigned long pmevtyper_el0;
+};
+
+static struct pc_sample_cpu pc_sample_cpus[MAX_CPUS];
+
+static struct pc_sample_buffer pc_sample_buffers[MAX_CPUS] = {
+	[0 ... (MAX_CPUS - 1U)] = {
+		.magic = PC_SAMPLE_MAGIC,
+		.version = PC_SAMPLE_VERSION
+	}
+};
+
+/*
+ * Return the index of the event counter used by RMM, the last one, or 0 if
+ * the PE does not have one left for the Realms.
+ */
+static unsigned int pc_sample_ctr(void)
+{
+	unsigned int num_ctrs;
+
+	if (!is_feat_pmuv3_present()) {
+		return 0U;
+	}
+
+	num_ctrs = (unsigned int)EXTRACT(PMCR_EL0_N, read_pmcr_el0());
+	if (num_ctrs < 2U) {
+		return 0U;
+	}
+
+	return num_ctrs - 1U;
+}
+
+static void pc_sample_record(unsigned long pc, unsigned int flags)
+{
+	unsigned int cpuid = my_cpuid();
+	struct pc_sample_cpu *cpu = &pc_sample_cpus[cpuid];
+	struct pc_sample_buffer *buf = &pc_sample_buffers[cpuid];
+	struct pc_sample_record *rec =
+			&buf->records[buf->head % PC_SAMPLE_ENTRIES];
+
+	rec->pc = pc;
+	rec->ctx = cpu->ctx;
+	rec->flags = cpu->flags | flags;
+	buf->head++;
+}
+
+/* Clear the overflow of counter @ctr and start a new period */
+static void pc_sample_reload(unsigned int ctr)
+{
+	unsigned long pmselr = read_pmselr_el0();
+
+	write_pmselr_el0(ctr);
+	isb();
+	write_pmxevcntr_el0(PC_SAMPLE_RELOAD);
+	write_pmovsclr_el0(1UL << ctr);
+	write_pmselr_el0(pmselr);
+	isb();
+}
+
+/* Record a sample if counter @ctr overflowed while IRQs were masked */
+static void pc_sample_poll(unsigned int ctr)
+{
+	if ((read_pmovsset_el0() & (1UL << ctr)) != 0UL) {
+		pc_sample_record(0UL, PC_SAMPLE_FLAG_POLLED);
+		pc_sample_reload(ctr);
+	}
+}
+
+/*
+ * Reserve counter @ctr for EL2. MDCR_EL2 is written again on REC entry and
+ * exit when the Realm uses the PMU, so this is done for each Realm exit
+ * handler as well.
+ */
+static void pc_sample_enable_el2(unsigned int ctr)
+{
+	unsigned long mdcr = read_mdcr_el2() | MDCR_EL2_HPME_BIT;
+
+	if (EXTRACT(MDCR_EL2_HPMN, mdcr) == 0UL) {
+		mdcr |= INPLACE(MDCR_EL2_HPMN, ctr);
+	}
+	write_mdcr_el2(mdcr);
+	isb();
+}
+
+void pc_sample_begin(unsigned long fid)
+{
+	struct pc_sample_cpu *cpu = &pc_sample_cpus[my_cpuid()];
+	unsigned int ctr = pc_sample_ctr();
+	unsigned long bit = 1UL << ctr;
+
+	if (ctr == 0U) {
+		return;
+	}
+
+	cpu->ctx = (unsigned int)fid;
+	cpu->flags = 0U;
+
+	cpu->mdcr_el2 = read_mdcr_el2();
+	cpu->pmselr_el0 = read_pmselr_el0();
+	cpu->pmcntenset_el0 = read_pmcntenset_el0() & bit;
+	cpu->pmintenset_el1 = read_pmintenset_el1() & bit;
+	cpu->pmovsset_el0 = read_pmovsset_el0() & bit;
+
+	/* Stop the counter of the NS world while RMM runs */
+	write_pmcntenclr_el0(bit);
+	write_pmintenclr_el1(bit);
+
+	write_pmselr_el0(ctr);
+	isb();
+	cpu->pmevcntr_el0 = read_pmxevcntr_el0();
+	cpu->pmevtyper_el0 = read_pmxevtyper_el0();
+	write_pmxevtyper_el0(PC_SAMPLE_EVTYPER);
+	write_pmselr_el0(cpu->pmselr_el0);
+
+	pc_sample_reload(ctr);
+	pc_sample_enable_el2(ctr);
+	write_pmintenset_el1(bit);
+	write_pmcntenset_el0(bit);
+	cpu->active = true;
+
+	/*
+	 * RMI_REC_ENTER runs with IRQs masked, as the REC exits are
+	 * reported to it through ELR_EL2 and SPSR_EL2.
+	 */
+	if (fid != SMC_RMM_REC_ENTER) {
+		enable_irq();
+	}
+}
+
+void pc_sample_end(void)
+{
+	struct pc_sample_cpu *cpu = &pc_sample_cpus[my_cpuid()];
+	unsigned int ctr = pc_sample_ctr();
+	unsigned long bit = 1UL << ctr;
+
+	disable_irq();
+
+	if (!cpu->active) {
+		return;
+	}
+
+	pc_sample_poll(ctr);
+	cpu->active = false;
+
+	write_mdcr_el2(cpu->mdcr_el2);
+	isb();
+
+	write_pmcntenclr_el0(bit);
+	write_pmintenclr_el1(bit);
+
+	write_pmselr_el0(ctr);
+	isb();
+	write_pmxevcntr_el0(cpu->pmevcntr_el0);
+	write_pmxevtyper_el0(cpu->pmevtyper_el0);
+
+	write_pmovsclr_el0(bit & ~cpu->pmovsset_el0);
+	write_pmintenset_el1(cpu->pmintenset_el1);
+	write_pmselr_el0(cpu->pmselr_el0);
+	write_pmcntenset_el0(cpu->pmcntenset_el0);
+}
+
+void pc_sample_exit_begin(unsigned long cause)
+{
+	struct pc_sample_cpu *cpu = &pc_sample_cpus[my_cpuid()];
+	unsigned int ctr;
+
+	if (!cpu->active) {
+		return;
+	}
+
+	ctr = pc_sample_ctr();
+	cpu->ctx = (unsigned int)cause;
+	cpu->flags = PC_SAMPLE_FLAG_REC_EXIT;
+	pc_sample_enable_el2(ctr);
+}
+
+void pc_sample_exit_end(void)
+{
+	struct pc_sample_cpu *cpu = &pc_sample_cpus[my_cpuid()];
+
+	if (!cpu->active) {
+		return;
+	}
+
+	pc_sample_poll(pc_sample_ctr());
+	cpu->ctx = (unsigned int)SMC_RMM_REC_ENTER;
+	cpu->flags = 0U;
+}
+
+void pc_sample_irq(unsigned long elr)
+{
+	struct pc_sample_cpu *cpu = &pc_sample_cpus[my_cpuid()];
+	unsigned int ctr = pc_sample_ctr();
+
+	if (cpu->active && ((read_pmovsset_el0() & (1UL << ctr)) != 0UL)) {
+		pc_sample_record(elr, 0U);
+		pc_sample_reload(ctr);
+		return;
+	}
+
+	/*
+	 * An interrupt of the Host, or the overflow interrupt which is not
+	 * deasserted yet. Leave it pending until the end of the command.
+	 */
+	write_spsr_el2(read_spsr_el2() | SPSR_EL2_I_BIT);
+}
+#endif /* RMM_PC_SAMPLE */
+
+/*
+ * Called by RMI_TRACE_DUMP with RMI_TRACE_DUMP_PC_SAMPLES, with the same
+ * caveat for the record being written.
+ */
+unsigned long pc_sample_dump(unsigned long ns_addr, unsigned long cpu)
+{
+#ifdef RMM_PC_SAMPLE
+	struct granule *g_ns;
+
+	if (cpu >= MAX_CPUS) {
+		return RMI_ERROR_INPUT;
+	}
+
+	g_ns = find_granule(ns_addr);
+	if ((g_ns == NULL) || (g_ns->state != GRANULE_STATE_NS)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (!ns_buffer_write(SLOT_NS, g_ns, 0U,
+			     (unsigned int)sizeof(struct pc_sample_buffer),
+			     &pc_sample_buffers[cpu])) {
+		return RMI_ERROR_INPUT;
+	}
+
+	return RMI_SUCCESS;
+#else
+	(void)ns_addr;
+	(void)cpu;
+
+	/* The samples are not built in */
+	return RMI_ERROR_INPUT;
+#endif /* RMM_PC_SAMPLE */
+}
@@ -0,0 +1,168 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <arch_features.h>
+#include <arch_helpers.h>
+#include <assert.h>
+#include <cpuid.h>
+#include <percpu.h>
+#include <pmu.h>
+#include <rec.h>
+#include <smc-rmi.h>
+
+/* PMU state of the NS world, saved while a Realm owns the PMU */
+static DEFINE_PER_CPU(struct pmu_state, ns_pmu_state);
+
+/*
+ * Bits of PMCNTENSET_EL0, PMINTENSET_EL1 and PMOVSSET_EL0 for the cycle
+ * counter and the first @num_ctrs event counters, which are the counters
+ * accessible to the Realm when MDCR_EL2.HPMN is @num_ctrs.
+ */
+static unsigned long pmu_ctrs_mask(unsigned int num_ctrs)
+{
+	return PMU_CYCLE_CTR_BIT | ((1UL << num_ctrs) - 1UL);
+}
+
+static void pmu_save_state(struct pmu_state *pmu, unsigned int num_ctrs)
+{
+	unsigned long mask = pmu_ctrs_mask(num_ctrs);
+
+	pmu->pmselr_el0 = read_pmselr_el0();
+	pmu->pmccfiltr_el0 = read_pmccfiltr_el0();
+	pmu->pmccntr_el0 = read_pmccntr_el0();
+	pmu->pmcntenset_el0 = read_pmcntenset_el0() & mask;
+	pmu->pmintenset_el1 = read_pmintenset_el1() & mask;
+	pmu->pmovsset_el0 = read_pmovsset_el0() & mask;
+
+	for (unsigned int i = 0U; i < num_ctrs; i++) {
+		write_pmselr_el0(i);
+		isb();
+		pmu->pmevcntr_el0[i] = read_pmxevcntr_el0();
+		pmu->pmevtyper_el0[i] = read_pmxevtyper_el0();
+	}
+}
+
+static void pmu_restore_state(struct pmu_state *pmu, unsigned int num_ctrs)
+{
+	unsigned long mask = pmu_ctrs_mask(num_ctrs);
+
+	for (unsigned int i = 0U; i < num_ctrs; i++) {
+		write_pmselr_el0(i);
+		isb();
+		write_pmxevcntr_el0(pmu->pmevcntr_el0[i]);
+		write_pmxevtyper_el0(pmu->pmevtyper_el0[i]);
+	}
+
+	write_pmselr_el0(pmu->pmselr_el0);
+	write_pmccfiltr_el0(pmu->pmccfiltr_el0);
+	write_pmccntr_el0(pmu->pmccntr_el0);
+
+	/* Only the bits of the counters in @mask are changed */
+	write_pmcntenclr_el0(mask & ~pmu->pmcntenset_el0);
+	write_pmcntenset_el0(pmu->pmcntenset_el0);
+	write_pmintenclr_el1(mask & ~pmu->pmintenset_el1);
+	write_pmintenset_el1(pmu->pmintenset_el1);
+	write_pmovsclr_el0(mask & ~pmu->pmovsset_el0);
+	write_pmovsset_el0(pmu->pmovsset_el0);
+}
+
+static void pmu_switch_to_realm(struct rec *rec)
+{
+	unsigned int num_ctrs = rec->realm_info.pmu_num_ctrs;
+	unsigned long pmuver = feat_pmu_version();
+	unsigned long mdcr;
+
+	assert(num_ctrs <= PMU_MAX_EVENT_CTRS);
+
+	/* The PMU state of the REC is held in one of its auxiliary granules */
+	rec_attest_heap_map(rec);
+
+	pmu_save_state(&per_cpu(ns_pmu_state, my_cpuid()), num_ctrs);
+	pmu_restore_state(rec->aux_data.pmu, num_ctrs);
+
+	/*
+	 * Give the Realm direct access to the first num_ctrs event counters
+	 * and to the cycle counter. The other counters are reserved for EL2,
+	 * and stay disabled as MDCR_EL2.HPME is 0. Counting at EL2 is
+	 * prohibited when the PMU supports it, so that the Realm does not
+	 * count the events of RMM.
+	 */
+	mdcr = (rec->common_sysregs.mdcr_el2 &
+		~(MDCR_EL2_TPM_BIT | MDCR_EL2_TPMCR_BIT)) |
+		INPLACE(MDCR_EL2_HPMN, num_ctrs);
+
+	if (pmuver >= ID_AA64DFR0_EL1_PMUVER_PMUV3P1) {
+		mdcr |= MDCR_EL2_HPMD;
+	}
+
+	if (pmuver >= ID_AA64DFR0_EL1_PMUVER_PMUV3P5) {
+		mdcr |= MDCR_EL2_HCCD;
+	}
+
+	write_mdcr_el2(mdcr);
+
+	rec->pmu_used = true;
+}
+
+void pmu_enter_realm(struct rec *rec)
+{
+	assert(!rec->pmu_used);
+
+	/*
+	 * Load the PMU state now if the counters of the Realm were enabled
+	 * on the last REC exit, so that they count from the REC entry.
+	 */
+	if (rec->realm_info.pmu_enabled &&
+	    ((rec->sysregs.pmcr_el0 & PMCR_EL0_E_BIT) != 0UL)) {
+		pmu_switch_to_realm(rec);
+	}
+}
+
+bool pmu_handle_sysreg_trap(struct rec *rec, unsigned long esr)
+{
+	unsigned long sysreg = esr & ESR_EL2_SYSREG_MASK;
+
+	if (!rec->realm_info.pmu_enabled || rec->pmu_used) {
+		return false;
+	}
+
+	if (((sysreg & ESR_EL2_SYSREG_PMU_MASK) != ESR_EL2_SYSREG_PMU) &&
+	    ((sysreg & ESR_EL2_SYSREG_PMU_EV_MASK) != ESR_EL2_SYSREG_PMU_EV)) {
+		return false;
+	}
+
+	pmu_switch_to_realm(rec);
+	return true;
+}
+
+void pmu_exit_realm(struct rec *rec, struct rmi_rec_exit *rec_exit)
+{
+	unsigned int num_ctrs = rec->realm_info.pmu_num_ctrs;
+	struct pmu_state *pmu = rec->aux_data.pmu;
+
+	rec_exit->pmu_ovf_status = RMI_PMU_OVERFLOW_NOT_ACTIVE;
+
+	if (!rec->pmu_used) {
+		return;
+	}
+
+	pmu_save_state(pmu, num_ctrs);
+
+	/*
+	 * The overflow interrupt of the Realm is asserted while the PMU is
+	 * enabled and an overflow flag is set for a counter for which the
+	 * interrupt is enabled. PMCR_EL0 still holds the value of the Realm.
+	 */
+	if (((read_pmcr_el0() & PMCR_EL0_E_BIT) != 0UL) &&
+	    ((pmu->pmovsset_el0 & pmu->pmintenset_el1) != 0UL)) {
+		rec_exit->pmu_ovf_status = RMI_PMU_OVERFLOW_ACTIVE;
+	}
+
+	pmu_restore_state(&per_cpu(ns_pmu_state, my_cpuid()), num_ctrs);
+	write_mdcr_el2(MDCR_EL2_INIT);
+
+	rec->pmu_used = false;
+}
@@ -0,0 +1,277 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <arch_features.h>
+#include <arch_helpers.h>
+#include <assert.h>
+#include <cpuid.h>
+#include <pmu_profile.h>
+#include <smc-handler.h>
+#include <smc-rmi.h>
+#include <smc.h>
+#include <status.h>
+
+#ifdef RMM_PMU_PROFILE
+/*
+ * Events counted by the PMU_PROFILE_NUM_CTRS counters, in the order of
+ * RMI_PMU_PROFILE_CYCLES to RMI_PMU_PROFILE_BR_MISPREDS.
+ */
+static const unsigned long pmu_profile_events[PMU_PROFILE_NUM_CTRS] = {
+	PMU_EVENT_CPU_CYCLES,
+	PMU_EVENT_L1D_CACHE_REFILL,
+	PMU_EVENT_L2D_CACHE_REFILL,
+	PMU_EVENT_DTLB_WALK,
+	PMU_EVENT_BR_MIS_PRED
+};
+
+/*
+ * Count at EL2 in Realm state only: P and U exclude EL1 and EL0, and RLH
+ * equal to NSH includes Realm EL2.
+ */
+#define PMU_PROFILE_EVTYPER	(PMEVTYPER_EL0_P_BIT | PMEVTYPER_EL0_U_BIT | \
+				 PMEVTYPER_EL0_NSH_BIT | PMEVTYPER_EL0_RLH_BIT)
+
+struct pmu_profile_entry {
+	unsigned long samples;
+	unsigned long ctrs[PMU_PROFILE_NUM_CTRS];
+};
+
+struct pmu_profile_cpu {
+	/* Number of samples in progress */
+	unsigned int depth;
+
+	/* NS state of the PMU, saved by the outermost sample */
+	unsigned long mdcr_el2;
+	unsigned long pmselr_el0;
+	unsigned long pmcntenset_el0;
+	unsigned long pmintenset_el1;
+	unsigned long pmovsset_el0;
+	unsigned long pmevcntr_el0[PMU_PROFILE_NUM_CTRS];
+	unsigned long pmevtyper_el0[PMU_PROFILE_NUM_CTRS];
+
+	struct pmu_profile_entry rmi[SMC64_NUM_FIDS_IN_RANGE(RMI)];
+	struct pmu_profile_entry rec_exit[RMI_REC_STATS_NR_EXITS];
+};
+
+/*
+ * Profile of each CPU. It is kept per CPU so that updating it does not need
+ * any synchronisation.
+ */
+static struct pmu_profile_cpu pmu_profile[MAX_CPUS];
+
+/*
+ * Return the index of the first event counter used by RMM, or 0 if the PE
+ * does not have enough counters for RMM and for at least one Realm counter.
+ */
+static unsigned int pmu_profile_first_ctr(void)
+{
+	unsigned int num_ctrs;
+
+	if (!is_feat_pmuv3_present()) {
+		return 0U;
+	}
+
+	num_ctrs = (unsigned int)EXTRACT(PMCR_EL0_N, read_pmcr_el0());
+	if (num_ctrs <= PMU_PROFILE_NUM_CTRS) {
+		return 0U;
+	}
+
+	return num_ctrs - PMU_PROFILE_NUM_CTRS;
+}
+
+static unsigned long pmu_profile_mask(unsigned int first)
+{
+	return ((1UL << PMU_PROFILE_NUM_CTRS) - 1UL) << first;
+}
+
+/* Read the counters used by RMM, preserving PMSELR_EL0 */
+static void pmu_profile_read(unsigned int first, unsigned long *ctrs)
+{
+	unsigned long pmselr = read_pmselr_el0();
+
+	for (unsigned int i = 0U; i < PMU_PROFILE_NUM_CTRS; i++) {
+		write_pmselr_el0(first + i);
+		isb();
+		ctrs[i] = read_pmxevcntr_el0();
+	}
+
+	write_pmselr_el0(pmselr);
+}
+
+static void pmu_profile_start(struct pmu_profile_cpu *cpu, unsigned int first)
+{
+	unsigned long mask = pmu_profile_mask(first);
+
+	cpu->mdcr_el2 = read_mdcr_el2();
+	cpu->pmselr_el0 = read_pmselr_el0();
+	cpu->pmcntenset_el0 = read_pmcntenset_el0();
+	cpu->pmintenset_el1 = read_pmintenset_el1() & mask;
+	cpu->pmovsset_el0 = read_pmovsset_el0() & mask;
+
+	/* Stop the counters of the NS world while RMM runs */
+	write_pmcntenclr_el0(cpu->pmcntenset_el0);
+	write_pmintenclr_el1(mask);
+
+	for (unsigned int i = 0U; i < PMU_PROFILE_NUM_CTRS; i++) {
+		write_pmselr_el0(first + i);
+		isb();
+		cpu->pmevcntr_el0[i] = read_pmxevcntr_el0();
+		cpu->pmevtyper_el0[i] = read_pmxevtyper_el0();
+		write_pmxevtyper_el0(PMU_PROFILE_EVTYPER | pmu_profile_events[i]);
+		write_pmxevcntr_el0(0UL);
+	}
+
+	write_pmselr_el0(cpu->pmselr_el0);
+	write_pmcntenset_el0(mask);
+}
+
+static void pmu_profile_stop(struct pmu_profile_cpu *cpu, unsigned int first)
+{
+	unsigned long mask = pmu_profile_mask(first);
+
+	write_mdcr_el2(cpu->mdcr_el2);
+	isb();
+
+	write_pmcntenclr_el0(mask);
+
+	for (unsigned int i = 0U; i < PMU_PROFILE_NUM_CTRS; i++) {
+		write_pmselr_el0(first + i);
+		isb();
+		write_pmxevcntr_el0(cpu->pmevcntr_el0[i]);
+		write_pmxevtyper_el0(cpu->pmevtyper_el0[i]);
+	}
+
+	write_pmovsclr_el0(mask & ~cpu->pmovsset_el0);
+	write_pmintenset_el1(cpu->pmintenset_el1);
+	write_pmselr_el0(cpu->pmselr_el0);
+	write_pmcntenset_el0(cpu->pmcntenset_el0);
+}
+
+void pmu_profile_begin(struct pmu_profile_sample *sample)
+{
+	struct pmu_profile_cpu *cpu = &pmu_profile[my_cpuid()];
+	unsigned int first = pmu_profile_first_ctr();
+	unsigned long mdcr;
+
+	sample->valid = (first != 0U);
+	if (!sample->valid) {
+		return;
+	}
+
+	if (cpu->depth == 0U) {
+		pmu_profile_start(cpu, first);
+	}
+	cpu->depth++;
+
+	/*
+	 * The counters used by RMM are reserved for EL2 by MDCR_EL2.HPMN and
+	 * enabled by MDCR_EL2.HPME. MDCR_EL2 is written again on REC entry
+	 * and exit when the Realm uses the PMU, so HPME is set on every
+	 * sample. HPMN is left to the number of counters of the Realm if it
+	 * is set.
+	 */
+	mdcr = read_mdcr_el2() | MDCR_EL2_HPME_BIT;
+	if (EXTRACT(MDCR_EL2_HPMN, mdcr) == 0UL) {
+		mdcr |= INPLACE(MDCR_EL2_HPMN, first);
+	}
+	write_mdcr_el2(mdcr);
+	isb();
+
+	pmu_profile_read(first, sample->ctrs);
+}
+
+void pmu_profile_end(struct pmu_profile_sample *sample,
+		     unsigned long table, unsigned long entry)
+{
+	struct pmu_profile_cpu *cpu = &pmu_profile[my_cpuid()];
+	unsigned int first = pmu_profile_first_ctr();
+	struct pmu_profile_entry *prof;
+	unsigned long ctrs[PMU_PROFILE_NUM_CTRS];
+
+	if (!sample->valid) {
+		return;
+	}
+
+	pmu_profile_read(first, ctrs);
+
+	if (table == RMI_PMU_PROFILE_TABLE_RMI) {
+		assert(entry < ARRAY_LEN(cpu->rmi));
+		prof = &cpu->rmi[entry];
+	} else {
+		assert(table == RMI_PMU_PROFILE_TABLE_REC_EXIT);
+		assert(entry < ARRAY_LEN(cpu->rec_exit));
+		prof = &cpu->rec_exit[entry];
+	}
+
+	/* The counters are 32-bit wide unless PMCR_EL0.LP is set */
+	for (unsigned int i = 0U; i < PMU_PROFILE_NUM_CTRS; i++) {
+		prof->ctrs[i] += (ctrs[i] - sample->ctrs[i]) & 0xffffffffUL;
+	}
+	prof->samples++;
+
+	assert(cpu->depth != 0U);
+	cpu->depth--;
+	if (cpu->depth == 0U) {
+		pmu_profile_stop(cpu, first);
+	}
+}
+#endif /* RMM_PMU_PROFILE */
+
+void smc_pmu_profile(unsigned long table,
+		     unsigned long entry,
+		     unsigned long cpu,
+		     unsigned long counter,
+		     struct smc_result *ret)
+{
+#ifdef RMM_PMU_PROFILE
+	const struct pmu_profile_entry *prof;
+
+	ret->x[1] = 0UL;
+
+	if ((cpu >= MAX_CPUS) || (counter > RMI_PMU_PROFILE_BR_MISPREDS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	switch (table) {
+	case RMI_PMU_PROFILE_TABLE_RMI:
+		if (!IS_SMC64_RMI_FID(entry)) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+		prof = &pmu_profile[cpu].rmi[
+				SMC64_FID_OFFSET_FROM_RANGE_MIN(RMI, entry)];
+		break;
+	case RMI_PMU_PROFILE_TABLE_REC_EXIT:
+		if (entry >= RMI_REC_STATS_NR_EXITS) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+		prof = &pmu_profile[cpu].rec_exit[entry];
+		break;
+	default:
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	if (counter == RMI_PMU_PROFILE_SAMPLES) {
+		ret->x[1] = prof->samples;
+	} else {
+		ret->x[1] = prof->ctrs[counter - RMI_PMU_PROFILE_CYCLES];
+	}
+
+	ret->x[0] = RMI_SUCCESS;
+#else
+	(void)table;
+	(void)entry;
+	(void)cpu;
+	(void)counter;
+
+	/* The profile is not collected by this build */
+	ret->x[0] = RMI_ERROR_INPUT;
+	ret->x[1] = 0UL;
+#endif /* RMM_PMU_PROFILE */
+}
@@ -6,33 +6,106 @@
 
 #include <arch.h>
 #include <arch_features.h>
+#include <arch_helpers.h>
 #include <attestation.h>
 #include <buffer.h>
 #include <cpuid.h>
 #include <exit.h>
 #include <fpu_helpers.h>
+#include <memory.h>
+#include <pauth.h>
+#include <percpu.h>
+#include <pmu.h>
 #include <rec.h>
 #include <run.h>
+#include <sgi.h>
 #include <smc-rmi.h>
+#include <spe.h>
+#include <spinlock.h>
+#include <string.h>
 #include <sve.h>
 #include <timers.h>
+#include <trace.h>
 
-static struct ns_state g_ns_data[MAX_CPUS];
-static uint8_t g_sve_data[MAX_CPUS][sizeof(struct sve_state)]
+/*
+ * Values last written by each CPU to the EL2 registers that only hold the
+ * state of a Realm. These registers are not changed by the calls to the
+ * Host, so re-entering a REC of the same Realm on the same CPU does not
+ * need to write them again.
+ */
+struct realm_el2_state {
+	bool valid;
+	unsigned long vmpidr_el2;
+	unsigned long vtcr_el2;
+	unsigned long vttbr_el2;
+	unsigned long hcr_el2;
+	unsigned long vmecid_p_el2;
+};
+
+/*
+ * State of each CPU used on every REC entry and exit. It is kept in one block
+ * in the per-CPU area of each CPU, aligned to the cache line size, with the
+ * fields touched by every entry first, so that an entry only touches a few
+ * lines owned by its CPU.
+ * The SVE/FPU buffer is last, as it is only used when the Realm uses SIMD.
+ */
+struct run_cpu_data {
+	struct realm_el2_state realm_el2;
+	struct ns_state ns;
+	uint8_t sve[sizeof(struct sve_state)]
 		__attribute__((aligned(sizeof(__uint128_t))));
+} __attribute__((aligned(CACHE_WRITEBACK_GRANULE)));
+
+static DEFINE_PER_CPU(struct run_cpu_data, run_cpu_data);
+
+#ifdef RMM_ATTEST_HEAP_POOL
+/*
+ * Attestation heaps shared by the RECs instead of being held in their
+ * auxiliary granules. A REC holds one from RSI_ATTEST_TOKEN_INIT until its
+ * token is signed, see rec_attest_heap_acquire().
+ */
+static unsigned char attest_heap_pool[RMM_ATTEST_HEAP_POOL]
+				     [REC_HEAP_PAGES * SZ_4K]
+					__aligned(sizeof(unsigned long));
+
+/* Bitmap of the heaps of attest_heap_pool held by a REC */
+static unsigned long attest_heap_pool_used;
+static spinlock_t attest_heap_pool_lock;
+
+COMPILER_ASSERT(RMM_ATTEST_HEAP_POOL <= (sizeof(unsigned long) * 8U));
+
+/* Bits of attest_heap_pool_used which refer to a heap, valid up to 64 */
+#define ATTEST_HEAP_POOL_MASK	(~0UL >> (64U - RMM_ATTEST_HEAP_POOL))
+#endif
 
 /*
  * Initialize the aux data and any buffer pointers to the aux granule memory for
- * use by REC when it is entered.
+ * use by REC when it is entered. The attestation heap is set up separately,
+ * see rec_attest_heap_map().
  */
 static void init_aux_data(struct rec_aux_data *aux_data,
 			  void *rec_aux,
 			  unsigned int num_rec_aux)
 {
-	aux_data->attest_heap_buf = (uint8_t *)rec_aux;
+	aux_data->aux = rec_aux;
+	aux_data->pmu = (struct pmu_state *)((uintptr_t)rec_aux +
+				(REC_AUX_HEAP_PAGES * GRANULE_SIZE));
 
 	/* Ensure we have enough aux granules for use by REC */
-	assert(num_rec_aux >= REC_HEAP_PAGES);
+	assert(num_rec_aux > REC_AUX_HEAP_PAGES);
+}
+
+/* Return the attestation heap of @rec, or NULL if it holds none */
+static uint8_t *rec_attest_heap_buf(struct rec *rec)
+{
+#ifdef RMM_ATTEST_HEAP_POOL
+	if (rec->alloc_info.pool_slot == REC_ATTEST_HEAP_NONE) {
+		return NULL;
+	}
+	return attest_heap_pool[rec->alloc_info.pool_slot];
+#else
+	return (uint8_t *)rec->aux_data.aux;
+#endif
 }
 
 /*
@@ -41,38 +114,252 @@ static void init_aux_data(struct rec_aux_data *aux_data,
  */
 static void *map_rec_aux(struct granule *rec_aux_pages[], unsigned long num_aux)
 {
-	void *rec_aux = NULL;
+	enum buffer_slot slots[MAX_REC_AUX_GRANULES];
+	void *aux[MAX_REC_AUX_GRANULES];
 
-	for (unsigned long i = 0UL; i < num_aux; i++) {
-		void *aux = granule_map(rec_aux_pages[i], SLOT_REC_AUX0 + i);
+	assert(num_aux <= MAX_REC_AUX_GRANULES);
 
-		if (i == 0UL) {
-			rec_aux = aux;
-		}
+	for (unsigned long i = 0UL; i < num_aux; i++) {
+		slots[i] = SLOT_REC_AUX0 + i;
 	}
-	return rec_aux;
+
+	granule_map_group(rec_aux_pages, slots, (unsigned int)num_aux, aux);
+
+	return (num_aux == 0UL) ? NULL : aux[0];
 }
 
 static void unmap_rec_aux(void *rec_aux, unsigned long num_aux)
 {
 	unsigned char *rec_aux_vaddr = (unsigned char *)rec_aux;
+	void *aux[MAX_REC_AUX_GRANULES];
+
+	assert(num_aux <= MAX_REC_AUX_GRANULES);
 
 	for (unsigned long i = 0UL; i < num_aux; i++) {
-		buffer_unmap(rec_aux_vaddr + i * GRANULE_SIZE);
+		aux[i] = rec_aux_vaddr + i * GRANULE_SIZE;
 	}
+
+	buffer_unmap_group(aux, (unsigned int)num_aux);
 }
 
-static void save_sysreg_state(struct sysreg_state *sysregs)
+/*
+ * Map the auxiliary granules of @rec and associate the attestation heap they
+ * hold with the current CPU, unless this was already done during the current
+ * REC entry. Only the attestation RSI calls use the heap, so the mapping is
+ * deferred to the first of these calls instead of being done on every REC
+ * entry. With RMM_ATTEST_HEAP_POOL, the heap is only associated while the REC
+ * holds one.
+ */
+void rec_attest_heap_map(struct rec *rec)
+{
+	if (rec->aux_data.aux == NULL) {
+		void *rec_aux = map_rec_aux(rec->g_aux, rec->num_rec_aux);
+
+		init_aux_data(&(rec->aux_data), rec_aux, rec->num_rec_aux);
+	}
+
+	if (rec->aux_data.attest_heap_buf != NULL) {
+		return;
+	}
+
+	rec->aux_data.attest_heap_buf = rec_attest_heap_buf(rec);
+	if (rec->aux_data.attest_heap_buf == NULL) {
+		return;
+	}
+
+	(void)attestation_heap_ctx_assign_pe(&rec->alloc_info.ctx);
+
+	/*
+	 * Initialise the heap for attestation if necessary.
+	 */
+	if (!rec->alloc_info.ctx_initialised) {
+		(void)attestation_heap_ctx_init(rec->aux_data.attest_heap_buf,
+						REC_HEAP_PAGES * SZ_4K);
+		rec->alloc_info.ctx_initialised = true;
+	}
+}
+
+/* Undo rec_attest_heap_map(), if it was called since the heap was unmapped */
+void rec_attest_heap_unmap(struct rec *rec)
+{
+	if (rec->aux_data.aux == NULL) {
+		return;
+	}
+
+	/* Undo the heap association */
+	if (rec->aux_data.attest_heap_buf != NULL) {
+		(void)attestation_heap_ctx_unassign_pe(&rec->alloc_info.ctx);
+		rec->aux_data.attest_heap_buf = NULL;
+	}
+
+	/* A shared heap is only kept while the token is being signed */
+	if (rec->token_sign_ctx.state != ATTEST_SIGN_IN_PROGRESS) {
+		rec_attest_heap_release(rec);
+	}
+
+	/* Unmap auxiliary granules */
+	unmap_rec_aux(rec->aux_data.aux, rec->num_rec_aux);
+
+	rec->aux_data.aux = NULL;
+	rec->aux_data.pmu = NULL;
+}
+
+/*
+ * Make sure that @rec holds an attestation heap, and map it as
+ * rec_attest_heap_map() does. Returns false if RMM_ATTEST_HEAP_POOL has no
+ * free heap.
+ */
+bool rec_attest_heap_acquire(struct rec *rec)
+{
+#ifdef RMM_ATTEST_HEAP_POOL
+	if (rec->alloc_info.pool_slot == REC_ATTEST_HEAP_NONE) {
+		unsigned long free_slots;
+
+		spinlock_acquire(&attest_heap_pool_lock);
+		free_slots = ~attest_heap_pool_used & ATTEST_HEAP_POOL_MASK;
+		if (free_slots == 0UL) {
+			spinlock_release(&attest_heap_pool_lock);
+			return false;
+		}
+
+		rec->alloc_info.pool_slot =
+				(unsigned int)__builtin_ctzl(free_slots);
+		attest_heap_pool_used |= (1UL << rec->alloc_info.pool_slot);
+		spinlock_release(&attest_heap_pool_lock);
+
+		/* The heap is laid out again for this REC */
+		rec->alloc_info.ctx_initialised = false;
+	}
+#endif
+	rec_attest_heap_map(rec);
+	return true;
+}
+
+/*
+ * Return the heap of RMM_ATTEST_HEAP_POOL held by @rec, if any, to the pool.
+ * The heap must not be associated with the current CPU.
+ */
+void rec_attest_heap_release(struct rec *rec)
+{
+#ifdef RMM_ATTEST_HEAP_POOL
+	unsigned int slot = rec->alloc_info.pool_slot;
+
+	if (slot == REC_ATTEST_HEAP_NONE) {
+		return;
+	}
+
+	/* Do not leave the signing state of the REC in the shared heap */
+	(void)memset(attest_heap_pool[slot], 0, sizeof(attest_heap_pool[slot]));
+
+	rec->alloc_info.pool_slot = REC_ATTEST_HEAP_NONE;
+	rec->alloc_info.ctx_initialised = false;
+
+	spinlock_acquire(&attest_heap_pool_lock);
+	attest_heap_pool_used &= ~(1UL << slot);
+	spinlock_release(&attest_heap_pool_lock);
+#else
+	(void)rec;
+#endif
+}
+
+/*
+ * Return the number of heaps of RMM_ATTEST_HEAP_POOL held by a REC, and the
+ * size of the pool in @nr. Both are 0 if RMM is built without the pool.
+ */
+unsigned long rec_attest_heaps_used(unsigned long *nr)
+{
+#ifdef RMM_ATTEST_HEAP_POOL
+	*nr = RMM_ATTEST_HEAP_POOL;
+	return (unsigned long)__builtin_popcountl(
+					SCA_READ64(&attest_heap_pool_used));
+#else
+	*nr = 0UL;
+	return 0UL;
+#endif
+}
+
+/*
+ * Save the NS FPU/SIMD state and load the one of @rec, and set the flag
+ * indicating that the Realm has used FPU so that the NS state is restored at
+ * Realm exit. Called on the FPU/SIMD trap of the Realm or eagerly at REC
+ * entry, see rec_fpu_eager().
+ */
+void rec_fpu_switch_in(struct rec *rec)
+{
+	unsigned long cptr;
+
+	assert(!rec->fpu_ctx.used);
+
+	/*
+	 * Start by disabling traps so we can save the NS state and load the
+	 * realm state.
+	 */
+	cptr = read_cptr_el2();
+	cptr &= ~(CPTR_EL2_FPEN_MASK << CPTR_EL2_FPEN_SHIFT);
+	cptr |= (CPTR_EL2_FPEN_NO_TRAP_11 << CPTR_EL2_FPEN_SHIFT);
+	cptr &= ~(CPTR_EL2_ZEN_MASK << CPTR_EL2_ZEN_SHIFT);
+	cptr |= (CPTR_EL2_ZEN_NO_TRAP_11 << CPTR_EL2_ZEN_SHIFT);
+	write_cptr_el2(cptr);
+
+	if (rec->ns->sve != NULL) {
+		/*
+		 * The Realm cannot use SVE, so its FPU/SIMD use leaves
+		 * the NS P registers and FFR untouched.
+		 */
+		save_sve_simd_state(rec->ns->sve);
+	} else {
+		assert(rec->ns->fpu != NULL);
+		fpu_save_state(rec->ns->fpu);
+	}
+	fpu_restore_state(&rec->fpu_ctx.fpu);
+	rec->fpu_ctx.used = true;
+
+	/*
+	 * Disable SVE for now, until per rec save/restore is
+	 * implemented
+	 */
+	cptr = read_cptr_el2();
+	cptr &= ~(CPTR_EL2_ZEN_MASK << CPTR_EL2_ZEN_SHIFT);
+	cptr |= (CPTR_EL2_ZEN_TRAP_ALL_00 << CPTR_EL2_ZEN_SHIFT);
+	write_cptr_el2(cptr);
+}
+
+/*
+ * Returns true if the FPU/SIMD state of @rec is to be switched in at REC
+ * entry, because the Realm used FPU/SIMD on the last REC_FPU_EAGER_THRESHOLD
+ * REC entries. Every REC_FPU_EAGER_PERIOD entries, the REC is entered with
+ * the trap instead, so that a Realm which no longer uses FPU/SIMD goes back
+ * to the lazy switch.
+ */
+static bool rec_fpu_eager(struct rec *rec)
+{
+	struct rec_fpu_context *ctx = &rec->fpu_ctx;
+
+	if (ctx->lazy_uses < REC_FPU_EAGER_THRESHOLD) {
+		return false;
+	}
+
+	if (++ctx->eager_entries < REC_FPU_EAGER_PERIOD) {
+		return true;
+	}
+
+	/* A trap on this entry switches back to the eager mode */
+	ctx->eager_entries = 0U;
+	ctx->lazy_uses = REC_FPU_EAGER_THRESHOLD - 1U;
+	return false;
+}
+
+/*
+ * Save the EL1 and EL0 registers which only hold the context of the guest
+ * last run at EL1, as opposed to the registers a VHE Host also uses itself.
+ * A Host which sets REC_ENTRY_FLAG_NS_EL1_DEAD does not need them to be
+ * preserved across REC_ENTER.
+ */
+static void save_el1_sysregs(struct sysreg_state *sysregs)
 {
-	sysregs->sp_el0 = read_sp_el0();
 	sysregs->sp_el1 = read_sp_el1();
 	sysregs->elr_el1 = read_elr_el12();
 	sysregs->spsr_el1 = read_spsr_el12();
-	sysregs->pmcr_el0 = read_pmcr_el0();
-	sysregs->pmuserenr_el0 = read_pmuserenr_el0();
-	sysregs->tpidrro_el0 = read_tpidrro_el0();
-	sysregs->tpidr_el0 = read_tpidr_el0();
-	sysregs->csselr_el1 = read_csselr_el1();
 	sysregs->sctlr_el1 = read_sctlr_el12();
 	sysregs->actlr_el1 = read_actlr_el1();
 	sysregs->cpacr_el1 = read_cpacr_el12();
@@ -90,19 +377,39 @@ static void save_sysreg_state(struct sysreg_state *sysregs)
 	sysregs->tpidr_el1 = read_tpidr_el1();
 	sysregs->amair_el1 = read_amair_el12();
 	sysregs->cntkctl_el1 = read_cntkctl_el12();
+
+	/* EL1 timer registers */
+	sysregs->cntp_ctl_el0 = read_cntp_ctl_el02();
+	sysregs->cntp_cval_el0 = read_cntp_cval_el02();
+	sysregs->cntv_ctl_el0 = read_cntv_ctl_el02();
+	sysregs->cntv_cval_el0 = read_cntv_cval_el02();
+}
+
+/* Save the registers which are not saved by save_el1_sysregs() */
+static void save_shared_sysregs(struct sysreg_state *sysregs)
+{
+	sysregs->sp_el0 = read_sp_el0();
+	sysregs->pmcr_el0 = read_pmcr_el0();
+	sysregs->pmuserenr_el0 = read_pmuserenr_el0();
+	sysregs->tpidrro_el0 = read_tpidrro_el0();
+	sysregs->tpidr_el0 = read_tpidr_el0();
+	sysregs->csselr_el1 = read_csselr_el1();
 	sysregs->par_el1 = read_par_el1();
 	sysregs->mdscr_el1 = read_mdscr_el1();
 	sysregs->mdccint_el1 = read_mdccint_el1();
 	sysregs->disr_el1 = read_disr_el1();
 	MPAM(sysregs->mpam0_el1 = read_mpam0_el1();)
+	MPAM(sysregs->mpam1_el1 = read_mpam1_el12();)
 
 	/* Timer registers */
 	sysregs->cntpoff_el2 = read_cntpoff_el2();
 	sysregs->cntvoff_el2 = read_cntvoff_el2();
-	sysregs->cntp_ctl_el0 = read_cntp_ctl_el02();
-	sysregs->cntp_cval_el0 = read_cntp_cval_el02();
-	sysregs->cntv_ctl_el0 = read_cntv_ctl_el02();
-	sysregs->cntv_cval_el0 = read_cntv_cval_el02();
+}
+
+static void save_sysreg_state(struct sysreg_state *sysregs)
+{
+	save_shared_sysregs(sysregs);
+	save_el1_sysregs(sysregs);
 }
 
 static void save_realm_state(struct rec *rec)
@@ -115,44 +422,52 @@ static void save_realm_state(struct rec *rec)
 	gic_save_state(&rec->sysregs.gicstate);
 }
 
-static void restore_sysreg_state(struct sysreg_state *sysregs)
-{
-	write_sp_el0(sysregs->sp_el0);
-	write_sp_el1(sysregs->sp_el1);
-	write_elr_el12(sysregs->elr_el1);
-	write_spsr_el12(sysregs->spsr_el1);
-	write_pmcr_el0(sysregs->pmcr_el0);
-	write_pmuserenr_el0(sysregs->pmuserenr_el0);
-	write_tpidrro_el0(sysregs->tpidrro_el0);
-	write_tpidr_el0(sysregs->tpidr_el0);
-	write_csselr_el1(sysregs->csselr_el1);
-	write_sctlr_el12(sysregs->sctlr_el1);
-	write_actlr_el1(sysregs->actlr_el1);
-	write_cpacr_el12(sysregs->cpacr_el1);
-	write_ttbr0_el12(sysregs->ttbr0_el1);
-	write_ttbr1_el12(sysregs->ttbr1_el1);
-	write_tcr_el12(sysregs->tcr_el1);
-	write_esr_el12(sysregs->esr_el1);
-	write_afsr0_el12(sysregs->afsr0_el1);
-	write_afsr1_el12(sysregs->afsr1_el1);
-	write_far_el12(sysregs->far_el1);
-	write_mair_el12(sysregs->mair_el1);
-	write_vbar_el12(sysregs->vbar_el1);
-
-	write_contextidr_el12(sysregs->contextidr_el1);
-	write_tpidr_el1(sysregs->tpidr_el1);
-	write_amair_el12(sysregs->amair_el1);
-	write_cntkctl_el12(sysregs->cntkctl_el1);
-	write_par_el1(sysregs->par_el1);
-	write_mdscr_el1(sysregs->mdscr_el1);
-	write_mdccint_el1(sysregs->mdccint_el1);
-	write_disr_el1(sysregs->disr_el1);
-	MPAM(write_mpam0_el1(sysregs->mpam0_el1);)
-	write_vmpidr_el2(sysregs->vmpidr_el2);
+/*
+ * Write the @_field of @_new with write_@_fn(), unless the register already
+ * holds that value, as recorded in @_cur. The register is always written if
+ * @_cur is NULL.
+ */
+#define WRITE_IF_CHANGED(_fn, _field, _new, _cur)		\
+	do {							\
+		if (((_cur) == NULL) ||				\
+		    ((_new)->_field != (_cur)->_field)) {	\
+			write_##_fn((_new)->_field);		\
+		}						\
+	} while (false)
 
-	/* Timer registers */
-	write_cntpoff_el2(sysregs->cntpoff_el2);
-	write_cntvoff_el2(sysregs->cntvoff_el2);
+/*
+ * Values of the registers of save_el1_sysregs() left to a Host which set
+ * REC_ENTRY_FLAG_NS_EL1_DEAD, so that the Realm values do not remain in them.
+ */
+static const struct sysreg_state el1_scrub_sysregs;
+
+/*
+ * Restore the registers saved by save_el1_sysregs() from @sysregs. They
+ * currently hold the values in @cur, or unknown values if @cur is NULL.
+ */
+static void restore_el1_sysregs(const struct sysreg_state *sysregs,
+				const struct sysreg_state *cur)
+{
+	WRITE_IF_CHANGED(sp_el1, sp_el1, sysregs, cur);
+	WRITE_IF_CHANGED(elr_el12, elr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(spsr_el12, spsr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(sctlr_el12, sctlr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(actlr_el1, actlr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(cpacr_el12, cpacr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(ttbr0_el12, ttbr0_el1, sysregs, cur);
+	WRITE_IF_CHANGED(ttbr1_el12, ttbr1_el1, sysregs, cur);
+	WRITE_IF_CHANGED(tcr_el12, tcr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(esr_el12, esr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(afsr0_el12, afsr0_el1, sysregs, cur);
+	WRITE_IF_CHANGED(afsr1_el12, afsr1_el1, sysregs, cur);
+	WRITE_IF_CHANGED(far_el12, far_el1, sysregs, cur);
+	WRITE_IF_CHANGED(mair_el12, mair_el1, sysregs, cur);
+	WRITE_IF_CHANGED(vbar_el12, vbar_el1, sysregs, cur);
+
+	WRITE_IF_CHANGED(contextidr_el12, contextidr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(tpidr_el1, tpidr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(amair_el12, amair_el1, sysregs, cur);
+	WRITE_IF_CHANGED(cntkctl_el12, cntkctl_el1, sysregs, cur);
 
 	/*
 	 * Restore CNTx_CVAL registers before CNTx_CTL to avoid
@@ -160,13 +475,87 @@ static void restore_sysreg_state(struct sysreg_state *sysregs)
 	 * it again due to some expired CVAL left in the timer
 	 * register.
 	 */
-	write_cntp_cval_el02(sysregs->cntp_cval_el0);
-	write_cntp_ctl_el02(sysregs->cntp_ctl_el0);
-	write_cntv_cval_el02(sysregs->cntv_cval_el0);
-	write_cntv_ctl_el02(sysregs->cntv_ctl_el0);
+	WRITE_IF_CHANGED(cntp_cval_el02, cntp_cval_el0, sysregs, cur);
+	WRITE_IF_CHANGED(cntp_ctl_el02, cntp_ctl_el0, sysregs, cur);
+	WRITE_IF_CHANGED(cntv_cval_el02, cntv_cval_el0, sysregs, cur);
+	WRITE_IF_CHANGED(cntv_ctl_el02, cntv_ctl_el0, sysregs, cur);
+}
+
+/*
+ * Restore the registers saved by save_shared_sysregs() from @sysregs, which
+ * currently hold the values in @cur. Only the registers whose value changes
+ * are written.
+ */
+static void restore_shared_sysregs(const struct sysreg_state *sysregs,
+				   const struct sysreg_state *cur)
+{
+	WRITE_IF_CHANGED(sp_el0, sp_el0, sysregs, cur);
+	WRITE_IF_CHANGED(pmcr_el0, pmcr_el0, sysregs, cur);
+	WRITE_IF_CHANGED(pmuserenr_el0, pmuserenr_el0, sysregs, cur);
+	WRITE_IF_CHANGED(tpidrro_el0, tpidrro_el0, sysregs, cur);
+	WRITE_IF_CHANGED(tpidr_el0, tpidr_el0, sysregs, cur);
+	WRITE_IF_CHANGED(csselr_el1, csselr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(par_el1, par_el1, sysregs, cur);
+	WRITE_IF_CHANGED(mdscr_el1, mdscr_el1, sysregs, cur);
+	WRITE_IF_CHANGED(mdccint_el1, mdccint_el1, sysregs, cur);
+	/* The PE can record a deferred SError in DISR_EL1 at any time */
+	write_disr_el1(sysregs->disr_el1);
+	MPAM(WRITE_IF_CHANGED(mpam0_el1, mpam0_el1, sysregs, cur);)
+	MPAM(WRITE_IF_CHANGED(mpam1_el12, mpam1_el1, sysregs, cur);)
+
+	/* Timer registers, before the EL1 timers which use the offsets */
+	WRITE_IF_CHANGED(cntpoff_el2, cntpoff_el2, sysregs, cur);
+	WRITE_IF_CHANGED(cntvoff_el2, cntvoff_el2, sysregs, cur);
+}
+
+static void restore_realm_el2_state(struct rec *rec, unsigned int cpuid)
+{
+	struct realm_el2_state *el2 = &per_cpu(run_cpu_data, cpuid).realm_el2;
+
+	if (!el2->valid ||
+	    (el2->vmpidr_el2 != rec->sysregs.vmpidr_el2)) {
+		write_vmpidr_el2(rec->sysregs.vmpidr_el2);
+		el2->vmpidr_el2 = rec->sysregs.vmpidr_el2;
+	}
+
+	if (!el2->valid ||
+	    (el2->vtcr_el2 != rec->common_sysregs.vtcr_el2)) {
+		write_vtcr_el2(rec->common_sysregs.vtcr_el2);
+		el2->vtcr_el2 = rec->common_sysregs.vtcr_el2;
+	}
+
+	if (!el2->valid ||
+	    (el2->vttbr_el2 != rec->common_sysregs.vttbr_el2)) {
+		write_vttbr_el2(rec->common_sysregs.vttbr_el2);
+		el2->vttbr_el2 = rec->common_sysregs.vttbr_el2;
+	}
+
+#ifdef RMM_MEC
+	if (!el2->valid ||
+	    (el2->vmecid_p_el2 != rec->realm_info.mecid)) {
+		write_vmecid_p_el2(rec->realm_info.mecid);
+		el2->vmecid_p_el2 = rec->realm_info.mecid;
+	}
+#endif
+
+	/* RMM runs with the HCR_EL2 of the last Realm entered */
+	if (!el2->valid || (el2->hcr_el2 != rec->sysregs.hcr_el2)) {
+		write_hcr_el2(rec->sysregs.hcr_el2);
+		el2->hcr_el2 = rec->sysregs.hcr_el2;
+	}
+
+	el2->valid = true;
+}
+
+void realm_el2_state_reset(void)
+{
+	unsigned int cpuid = my_cpuid();
+
+	assert(cpuid < MAX_CPUS);
+	per_cpu(run_cpu_data, cpuid).realm_el2.valid = false;
 }
 
-static void restore_realm_state(struct rec *rec)
+static void restore_realm_state(struct rec *rec, struct ns_state *ns_state)
 {
 	/*
 	 * Restore this early to give time to the timer mask to propagate to
@@ -176,23 +565,25 @@ static void restore_realm_state(struct rec *rec)
 	write_cnthctl_el2(rec->sysregs.cnthctl_el2);
 	isb();
 
-	restore_sysreg_state(&rec->sysregs);
+	/*
+	 * The EL1 registers were not saved when the Host declared them dead,
+	 * so their current values are unknown.
+	 */
+	restore_shared_sysregs(&rec->sysregs, &ns_state->sysregs);
+	restore_el1_sysregs(&rec->sysregs,
+			    rec->ns_el1_dead ? NULL : &ns_state->sysregs);
 	write_elr_el2(rec->pc);
 	write_spsr_el2(rec->pstate);
-	write_hcr_el2(rec->sysregs.hcr_el2);
 
 	gic_restore_state(&rec->sysregs.gicstate);
 }
 
-static void configure_realm_stage2(struct rec *rec)
-{
-	write_vtcr_el2(rec->common_sysregs.vtcr_el2);
-	write_vttbr_el2(rec->common_sysregs.vttbr_el2);
-}
-
-static void save_ns_state(struct ns_state *ns_state)
+static void save_ns_state(struct ns_state *ns_state, bool el1_dead)
 {
-	save_sysreg_state(&ns_state->sysregs);
+	save_shared_sysregs(&ns_state->sysregs);
+	if (!el1_dead) {
+		save_el1_sysregs(&ns_state->sysregs);
+	}
 
 	/*
 	 * CNTHCTL_EL2 is saved/restored separately from the main system
@@ -204,9 +595,13 @@ static void save_ns_state(struct ns_state *ns_state)
 	ns_state->icc_sre_el2 = read_icc_sre_el2();
 }
 
-static void restore_ns_state(struct ns_state *ns_state)
+static void restore_ns_state(struct ns_state *ns_state, struct rec *rec)
 {
-	restore_sysreg_state(&ns_state->sysregs);
+	restore_shared_sysregs(&ns_state->sysregs, &rec->sysregs);
+
+	/* The EL1 registers declared dead by the Host are scrubbed instead */
+	restore_el1_sysregs(rec->ns_el1_dead ? &el1_scrub_sysregs :
+			    &ns_state->sysregs, &rec->sysregs);
 
 	/*
 	 * CNTHCTL_EL2 is saved/restored separately from the main system
@@ -227,6 +622,13 @@ static void activate_events(struct rec *rec)
 		write_vsesr_el2(rec->serror_info.vsesr_el2);
 		write_hcr_el2(rec->sysregs.hcr_el2 | HCR_VSE);
 		rec->serror_info.inject = false;
+
+		/*
+		 * HCR_EL2.VSE is cleared when the virtual SError is taken, so
+		 * make the next REC entry on this CPU write HCR_EL2 again.
+		 */
+		per_cpu(run_cpu_data, my_cpuid()).realm_el2.hcr_el2 =
+			rec->sysregs.hcr_el2 | HCR_VSE;
 	}
 }
 
@@ -236,58 +638,78 @@ void inject_serror(struct rec *rec, unsigned long vsesr)
 	rec->serror_info.inject = true;
 }
 
+__hot_text
 void rec_run_loop(struct rec *rec, struct rmi_rec_exit *rec_exit)
 {
 	struct ns_state *ns_state;
+	uint8_t *simd;
 	int realm_exception_code;
-	void *rec_aux;
 	unsigned int cpuid = my_cpuid();
+	bool fpu_eager;
+#ifdef RMM_REC_STATS
+	unsigned long start_ticks = read_cntpct_el0();
+	unsigned long realm_ticks = 0UL;
+	unsigned long entry_ticks;
+	/* Time of the last exit from the Realm, 0 before the first one */
+	unsigned long exit_ticks = 0UL;
+	bool migrated;
+#endif
 
 	assert(rec->ns == NULL);
 
 	assert(cpuid < MAX_CPUS);
-	ns_state = &g_ns_data[cpuid];
+	ns_state = &per_cpu(run_cpu_data, cpuid).ns;
+	simd = per_cpu(run_cpu_data, cpuid).sve;
+
+#ifdef RMM_REC_STATS
+	migrated = (rec->stats.last_cpu != 0UL) &&
+		   (rec->stats.last_cpu != ((unsigned long)cpuid + 1UL));
+	rec->stats.last_cpu = (unsigned long)cpuid + 1UL;
+#endif
 
 	/* ensure SVE/FPU context is cleared */
 	assert(ns_state->sve == NULL);
 	assert(ns_state->fpu == NULL);
 
-	/* Map auxiliary granules */
-	rec_aux = map_rec_aux(rec->g_aux, rec->num_rec_aux);
-
-	init_aux_data(&(rec->aux_data), rec_aux, rec->num_rec_aux);
-
 	/*
-	 * The attset heap on the REC aux pages is mapped now. It is time to
-	 * associate it with the current CPU.
-	 * This heap will be used for attestation RSI calls when the
-	 * REC is running.
+	 * The auxiliary granules are mapped by the first attestation RSI
+	 * call, see rec_attest_heap_map(). The pointers left by a previous
+	 * REC entry refer to the slot buffers of the CPU it ran on.
 	 */
-	attestation_heap_ctx_assign_pe(&rec->alloc_info.ctx);
+	rec->aux_data.aux = NULL;
+	rec->aux_data.attest_heap_buf = NULL;
 
-	/*
-	 * Initialise the heap for attestation if necessary.
-	 */
-	if (!rec->alloc_info.ctx_initialised) {
-		(void)attestation_heap_ctx_init(rec->aux_data.attest_heap_buf,
-						REC_HEAP_PAGES * SZ_4K);
-		rec->alloc_info.ctx_initialised = true;
-	}
+	/* The RD is mapped for the whole REC entry by smc_rec_enter() */
+	assert(rec->rd != NULL);
 
 	if (is_feat_sve_present()) {
-		ns_state->sve = (struct sve_state *)&g_sve_data[cpuid];
+		ns_state->sve = (struct sve_state *)simd;
 	} else {
-		ns_state->fpu = (struct fpu_state *)&g_sve_data[cpuid];
+		ns_state->fpu = (struct fpu_state *)simd;
 	}
 
-	save_ns_state(ns_state);
-	restore_realm_state(rec);
+	save_ns_state(ns_state, rec->ns_el1_dead);
+	SPE(spe_enter_realm(rec);)
+	pmu_enter_realm(rec);
+	restore_realm_state(rec, ns_state);
+	PAUTH(pauth_enter_realm(rec);)
 
 	/* Prepare for lazy save/restore of FPU/SIMD registers. */
 	rec->ns = ns_state;
 	assert(rec->fpu_ctx.used == false);
 
-	configure_realm_stage2(rec);
+	fpu_eager = rec_fpu_eager(rec);
+	if (fpu_eager) {
+		rec_fpu_switch_in(rec);
+	}
+
+	restore_realm_el2_state(rec, cpuid);
+
+	rec->trivial_exit = false;
+
+	if (rec->sgi_local) {
+		sgi_open(rec);
+	}
 
 	do {
 		/*
@@ -295,16 +717,77 @@ void rec_run_loop(struct rec *rec, struct rmi_rec_exit *rec_exit)
 		 * iteration of the loop to ensure we update the timer
 		 * mask on each entry to the realm and that we report any
 		 * change in output level to the NS caller.
+		 *
+		 * This is skipped on the fast path, after an exit that RMM
+		 * emulated without changing the timers or the events, as long
+		 * as neither timer interrupt is masked. The timers were then
+		 * not asserted at the previous check, and if one of them has
+		 * become asserted since, its physical interrupt causes an
+		 * IRQ exit as soon as the Realm is entered.
 		 */
-		if (check_pending_timers(rec)) {
-			rec_exit->exit_reason = RMI_EXIT_IRQ;
-			break;
+		if (!rec->trivial_exit ||
+		    ((rec->sysregs.cnthctl_el2 &
+		      (CNTHCTL_EL2_CNTVMASK | CNTHCTL_EL2_CNTPMASK)) != 0UL)) {
+			if (check_pending_timers(rec) &&
+			    (!rec->timer_local ||
+			     !inject_pending_timers(rec))) {
+				rec_exit->exit_reason = RMI_EXIT_IRQ;
+				break;
+			}
+
+			activate_events(rec);
 		}
 
-		activate_events(rec);
+		if (rec->virq_queue.next != rec->virq_queue.nr) {
+			rec->virq_queue.next += gic_inject_lrs(
+				&rec->sysregs.gicstate,
+				&rec->virq_queue.lrs[rec->virq_queue.next],
+				rec->virq_queue.nr - rec->virq_queue.next);
+		}
+
+		if (rec->sgi_local) {
+			sgi_inject_posted(rec);
+		}
+#ifdef RMM_REC_STATS
+		else {
+			rec->stats.fast_exits++;
+		}
+
+		entry_ticks = read_cntpct_el0();
+		if (exit_ticks != 0UL) {
+			rec->stats.exit_ticks[rec->stats.last_exit] +=
+				entry_ticks - exit_ticks;
+		}
+#endif
+#ifdef RMM_REC_EXIT_TRACE
+		rec_exit_trace_realm_entry();
+#endif
 		realm_exception_code = run_realm(&rec->regs[0]);
+#ifdef RMM_REC_EXIT_TRACE
+		rec_exit_trace_realm_exit(read_esr_el2());
+#endif
+#ifdef RMM_REC_STATS
+		exit_ticks = read_cntpct_el0();
+		realm_ticks += exit_ticks - entry_ticks;
+#endif
 	} while (handle_realm_exit(rec, rec_exit, realm_exception_code));
 
+#ifdef RMM_REC_STATS
+	if (exit_ticks != 0UL) {
+		rec->stats.exit_ticks[rec->stats.last_exit] +=
+			read_cntpct_el0() - exit_ticks;
+	}
+#endif
+
+	/* Count the REC entries on which the Realm trapped on FPU/SIMD */
+	if (!fpu_eager) {
+		if (!rec->fpu_ctx.used) {
+			rec->fpu_ctx.lazy_uses = 0U;
+		} else if (rec->fpu_ctx.lazy_uses < REC_FPU_EAGER_THRESHOLD) {
+			rec->fpu_ctx.lazy_uses++;
+		}
+	}
+
 	/*
 	 * Check if FPU/SIMD was used, and if it was, save the realm state,
 	 * restore the NS state, and reenable traps in CPTR_EL2.
@@ -319,7 +802,7 @@ void rec_run_loop(struct rec *rec, struct rmi_rec_exit *rec_exit)
 
 		fpu_save_state(&rec->fpu_ctx.fpu);
 		if (ns_state->sve != NULL) {
-			restore_sve_state(ns_state->sve);
+			restore_sve_simd_state(ns_state->sve);
 		} else {
 			assert(ns_state->fpu != NULL);
 			fpu_restore_state(ns_state->fpu);
@@ -347,11 +830,39 @@ void rec_run_loop(struct rec *rec, struct rmi_rec_exit *rec_exit)
 
 	report_timer_state_to_ns(rec_exit);
 
+	pmu_exit_realm(rec, rec_exit);
+	if (rec->sgi_local) {
+		sgi_close(rec);
+	}
+
+	SPE(spe_exit_realm(rec, rec_exit);)
 	save_realm_state(rec);
-	restore_ns_state(ns_state);
+	PAUTH(pauth_exit_realm(rec);)
+	restore_ns_state(ns_state, rec);
+
+	rec_attest_heap_unmap(rec);
+
+#ifdef RMM_REC_STATS
+	rec->stats.realm_ticks += realm_ticks;
+	start_ticks = read_cntpct_el0() - start_ticks - realm_ticks;
+	rec->stats.rmm_ticks += start_ticks;
+	rec->stats.entries++;
+	if (migrated) {
+		rec->stats.migrations++;
+		rec->stats.migration_rmm_ticks += start_ticks;
+	}
+#endif
+}
 
-	/* Undo the heap association */
-	attestation_heap_ctx_unassign_pe(&rec->alloc_info.ctx);
-	/* Unmap auxiliary granules */
-	unmap_rec_aux(rec_aux, rec->num_rec_aux);
+/*
+ * Returns true if the last REC entered on @cpu is of the Realm of @rec, in
+ * which case the stage 2 context of the Realm is still loaded on @cpu. The
+ * value is only a hint, as @cpu can enter another REC at any time.
+ */
+bool rec_cpu_is_warm(const struct rec *rec, unsigned int cpu)
+{
+	assert(cpu < MAX_CPUS);
+
+	return SCA_READ64(&per_cpu(run_cpu_data, cpu).realm_el2.vttbr_el2) ==
+		rec->common_sysregs.vttbr_el2;
 }
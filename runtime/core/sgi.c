@@ -0,0 +1,110 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <atomics.h>
+#include <gic.h>
+#include <memory.h>
+#include <rec.h>
+#include <sgi.h>
+
+/* SGIs which are posted to a REC, in bits [15:0] of rec->sgi_post */
+#define SGI_POST_PENDING_MASK	((1UL << MIN_PPI_ID) - 1UL)
+
+void sgi_open(struct rec *rec)
+{
+	atomic_bit_set_release_64(&rec->sgi_post, REC_SGI_POST_OPEN_BIT);
+}
+
+void sgi_inject_posted(struct rec *rec)
+{
+	unsigned long pending = SCA_READ64_ACQUIRE(&rec->sgi_post) &
+				SGI_POST_PENDING_MASK;
+
+	while (pending != 0UL) {
+		unsigned int intid = (unsigned int)__builtin_ctzl(pending);
+
+		if (!gic_inject_virq(&rec->sysregs.gicstate, intid)) {
+			return;
+		}
+
+		/*
+		 * The SGI is only unposted once it is pending in an LR. If it
+		 * is posted again in between, the two SGIs are merged as
+		 * they would be by the GIC.
+		 */
+		atomic_bit_clear_release_64(&rec->sgi_post, (int)intid);
+		pending &= pending - 1UL;
+	}
+}
+
+void sgi_close(struct rec *rec)
+{
+	/*
+	 * Clearing the bit fails the compare-and-swap of a concurrent
+	 * sgi_post(), which then forwards its SGI to the Host.
+	 */
+	atomic_bit_clear_release_64(&rec->sgi_post, REC_SGI_POST_OPEN_BIT);
+	sgi_inject_posted(rec);
+}
+
+/* Post @intid to @target_rec, if it is running and accepts it */
+static bool sgi_post_to(struct rec *target_rec, unsigned int intid)
+{
+	uint64_t old = SCA_READ64(&target_rec->sgi_post);
+
+	while ((old & (1UL << REC_SGI_POST_OPEN_BIT)) != 0UL) {
+		uint64_t seen = atomic_cas_acquire_64(&target_rec->sgi_post,
+						      old,
+						      old | (1UL << intid));
+
+		if (seen == old) {
+			return true;
+		}
+		old = seen;
+	}
+
+	return false;
+}
+
+bool sgi_post(struct rec *rec, unsigned long sgi1r)
+{
+	unsigned long targets = EXTRACT(ICC_SGI1R_EL1_TARGETS, sgi1r);
+	unsigned long mpidr, rec_idx;
+	struct rec *target_rec;
+	bool posted;
+
+	/*
+	 * Only an SGI to a single REC takes the fast path. Aff0 of a REC is
+	 * at most 15, so RS is zero.
+	 */
+	if (!rec->sgi_local ||
+	    ((sgi1r & ICC_SGI1R_EL1_IRM_BIT) != 0UL) ||
+	    (EXTRACT(ICC_SGI1R_EL1_RS, sgi1r) != 0UL) ||
+	    (targets == 0UL) || ((targets & (targets - 1UL)) != 0UL)) {
+		return false;
+	}
+
+	mpidr = INPLACE(MPIDR_EL2_AFF0, (unsigned long)__builtin_ctzl(targets)) |
+		INPLACE(MPIDR_EL2_AFF1, EXTRACT(ICC_SGI1R_EL1_AFF1, sgi1r)) |
+		INPLACE(MPIDR_EL2_AFF2, EXTRACT(ICC_SGI1R_EL1_AFF2, sgi1r)) |
+		INPLACE(MPIDR_EL2_AFF3, EXTRACT(ICC_SGI1R_EL1_AFF3, sgi1r));
+	rec_idx = mpidr_to_rec_idx(mpidr);
+
+	if (rec_idx == rec->rec_idx) {
+		return false;
+	}
+
+	target_rec = rec_map_sibling(rec, rec_idx);
+	if (target_rec == NULL) {
+		return false;
+	}
+
+	posted = sgi_post_to(target_rec,
+			     (unsigned int)EXTRACT(ICC_SGI1R_EL1_INTID, sgi1r));
+	rec_unmap_sibling(target_rec);
+
+	return posted;
+}
@@ -0,0 +1,206 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch.h>
+#include <arch_helpers.h>
+#include <assert.h>
+#include <cpuid.h>
+#include <debug.h>
+#include <esr.h>
+#include <percpu.h>
+#include <realm.h>
+#include <rec.h>
+#include <sizes.h>
+#include <smc-rmi.h>
+#include <spe.h>
+
+/*
+ * Largest profiling buffer that the Realm can enable. Each of its granules is
+ * translated when the buffer is enabled, which bounds the time spent in RMM.
+ */
+#define SPE_BUFFER_MAX_SIZE	(UL(16) * SZ_1M)
+
+/* SPE state of the NS world, saved while a REC runs */
+static DEFINE_PER_CPU(struct spe_state, ns_spe_state);
+
+static void spe_save_state(struct spe_state *spe)
+{
+	/* Complete the writes of the profiling buffer before reading it */
+	psb_csync();
+	dsb(nsh);
+
+	spe->pmscr_el1 = read_pmscr_el12();
+	spe->pmsicr_el1 = read_pmsicr_el1();
+	spe->pmsirr_el1 = read_pmsirr_el1();
+	spe->pmsfcr_el1 = read_pmsfcr_el1();
+	spe->pmsevfr_el1 = read_pmsevfr_el1();
+	spe->pmslatfr_el1 = read_pmslatfr_el1();
+	spe->pmblimitr_el1 = read_pmblimitr_el1();
+	spe->pmbptr_el1 = read_pmbptr_el1();
+	spe->pmbsr_el1 = read_pmbsr_el1();
+}
+
+static void spe_restore_state(struct spe_state *spe)
+{
+	/* Keep the buffer disabled until it is fully programmed */
+	write_pmblimitr_el1(0UL);
+	isb();
+
+	write_pmbptr_el1(spe->pmbptr_el1);
+	write_pmbsr_el1(spe->pmbsr_el1);
+	write_pmsicr_el1(spe->pmsicr_el1);
+	write_pmsirr_el1(spe->pmsirr_el1);
+	write_pmsfcr_el1(spe->pmsfcr_el1);
+	write_pmsevfr_el1(spe->pmsevfr_el1);
+	write_pmslatfr_el1(spe->pmslatfr_el1);
+	write_pmscr_el12(spe->pmscr_el1);
+	isb();
+
+	write_pmblimitr_el1(spe->pmblimitr_el1);
+}
+
+void spe_enter_realm(struct rec *rec)
+{
+	spe_save_state(&per_cpu(ns_spe_state, my_cpuid()));
+	spe_restore_state(&rec->spe);
+
+	if (rec->realm_info.spe_enabled) {
+		write_mdcr_el2(rec->common_sysregs.mdcr_el2);
+	}
+}
+
+void spe_exit_realm(struct rec *rec, struct rmi_rec_exit *rec_exit)
+{
+	rec_exit->spe_irq_status = RMI_SPE_IRQ_NOT_ACTIVE;
+
+	if (rec->realm_info.spe_enabled) {
+		spe_save_state(&rec->spe);
+
+		/* PMBIRQ is asserted while PMBSR_EL1.S is set */
+		if ((rec->spe.pmbsr_el1 & PMBSR_EL1_S_BIT) != 0UL) {
+			rec_exit->spe_irq_status = RMI_SPE_IRQ_ACTIVE;
+		}
+
+		write_mdcr_el2(MDCR_EL2_INIT);
+	}
+
+	spe_restore_state(&per_cpu(ns_spe_state, my_cpuid()));
+}
+
+/*
+ * Check that every granule of the profiling buffer from @ptr to the limit
+ * in @limitr is mapped for writes by the stage 1 of the Realm to Protected
+ * IPA space. The EL1 registers hold the state of the Realm.
+ */
+static bool spe_buffer_is_protected(struct rec *rec, unsigned long ptr,
+				    unsigned long limitr)
+{
+	unsigned long base = ptr & GRANULE_MASK;
+	unsigned long limit = limitr & MASK(PMBLIMITR_EL1_LIMIT);
+	unsigned long par_el1;
+	bool ret = true;
+
+	/* The buffer is full, and nothing is written to it */
+	if (base >= limit) {
+		return true;
+	}
+
+	if ((limit - base) > SPE_BUFFER_MAX_SIZE) {
+		return false;
+	}
+
+	par_el1 = read_par_el1();
+
+	for (unsigned long va = base; va < limit; va += GRANULE_SIZE) {
+		unsigned long par;
+
+		ats1e1w(va);
+		isb();
+		par = read_par_el1();
+
+		if (((par & PAR_EL1_F_BIT) != 0UL) ||
+		    !addr_in_rec_par(rec, par & MASK(PAR_EL1_PA))) {
+			ret = false;
+			break;
+		}
+	}
+
+	write_par_el1(par_el1);
+	return ret;
+}
+
+/*
+ * Program the profiling buffer of the Realm with @ptr and @limitr. A buffer
+ * which is not in Protected IPA space is left disabled, and a stage 2 fault
+ * on the buffer is reported to the Realm.
+ */
+static void spe_write_buffer(struct rec *rec, unsigned long ptr,
+			     unsigned long limitr)
+{
+	if (((limitr & PMBLIMITR_EL1_E_BIT) != 0UL) &&
+	    !spe_buffer_is_protected(rec, ptr, limitr)) {
+		limitr &= ~PMBLIMITR_EL1_E_BIT;
+		write_pmbsr_el1(PMBSR_EL1_S_BIT |
+				INPLACE(PMBSR_EL1_EC, PMBSR_EL1_EC_FAULT_S2) |
+				INPLACE(PMBSR_EL1_FSC, PMBSR_EL1_FSC_PERM_L3));
+	}
+
+	write_pmbptr_el1(ptr);
+	write_pmblimitr_el1(limitr);
+	isb();
+}
+
+void spe_emulate_buffer_access(struct rec *rec, unsigned long esr)
+{
+	unsigned long sysreg = esr & ESR_EL2_SYSREG_MASK;
+	unsigned int rt = esr_sysreg_rt(esr);
+	unsigned long val = 0UL;
+
+	/* The buffer registers are RAZ/WI for the Realms without SPE_EN */
+	if (ESR_EL2_SYSREG_IS_WRITE(esr)) {
+		if (!rec->realm_info.spe_enabled) {
+			return;
+		}
+
+		if (rt != 31U) {
+			ARRAY_READ(rec->regs, rt, val);
+		}
+
+		switch (sysreg) {
+		case ESR_EL2_SYSREG_PMBLIMITR_EL1:
+			spe_write_buffer(rec, read_pmbptr_el1(), val);
+			break;
+		case ESR_EL2_SYSREG_PMBPTR_EL1:
+			spe_write_buffer(rec, val, read_pmblimitr_el1());
+			break;
+		case ESR_EL2_SYSREG_PMBSR_EL1:
+			write_pmbsr_el1(val);
+			break;
+		default:
+			break;
+		}
+		return;
+	}
+
+	if (rec->realm_info.spe_enabled) {
+		switch (sysreg) {
+		case ESR_EL2_SYSREG_PMBLIMITR_EL1:
+			val = read_pmblimitr_el1();
+			break;
+		case ESR_EL2_SYSREG_PMBPTR_EL1:
+			val = read_pmbptr_el1();
+			break;
+		case ESR_EL2_SYSREG_PMBSR_EL1:
+			val = read_pmbsr_el1();
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (rt != 31U) {
+		ARRAY_WRITE(rec->regs, rt, val);
+	}
+}
@@ -0,0 +1,162 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <assert.h>
+#include <cpuid.h>
+#include <memory.h>
+#include <percpu.h>
+#include <rmm_el3_ifc.h>
+#include <smc-rmi.h>
+#include <smc-rsi.h>
+#include <smc.h>
+#include <stack_profile.h>
+#include <stdint.h>
+#include <utils_def.h>
+
+#ifdef RMM_STACK_PROFILE
+/* Pattern painted on the unused part of the stacks */
+#define STACK_PAINT		0x5354414b50414e54UL
+
+/*
+ * Room left below the frame of stack_profile_begin() when painting, as the
+ * frame record of a function sits at the bottom of its frame.
+ */
+#define STACK_PAINT_MARGIN	64UL
+
+struct stack_profile_cpu {
+	/*
+	 * Lowest address of the stack which may no longer hold the paint,
+	 * or 0 if the stack has not been painted yet.
+	 */
+	uintptr_t dirty;
+
+	/* Number of calls being profiled */
+	unsigned int depth;
+
+	/* Lowest address used by the nested calls of the outermost one */
+	uintptr_t nested_low;
+
+	unsigned long rmi[SMC64_NUM_FIDS_IN_RANGE(RMI)];
+	unsigned long rsi[SMC64_NUM_FIDS_IN_RANGE(RSI)];
+};
+
+/* Profile of each CPU, only updated by the CPU itself */
+static DEFINE_PER_CPU(struct stack_profile_cpu, stack_profile);
+
+/* Lowest address of the stack of @cpu which no longer holds the paint */
+static uintptr_t stack_low(unsigned int cpu)
+{
+	const unsigned long *p = (const unsigned long *)percpu_stack_base(cpu);
+
+	while (*p == STACK_PAINT) {
+		p++;
+	}
+
+	return (uintptr_t)p;
+}
+
+void stack_profile_begin(void)
+{
+	unsigned int cpu = my_cpuid();
+	struct stack_profile_cpu *prof = &per_cpu(stack_profile, cpu);
+	uintptr_t sp = (uintptr_t)__builtin_frame_address(0) -
+		       STACK_PAINT_MARGIN;
+
+	if (percpu_stack_base(cpu) == 0UL) {
+		return;
+	}
+
+	if (prof->dirty == 0UL) {
+		prof->dirty = percpu_stack_base(cpu);
+		prof->nested_low = percpu_stack_top(cpu);
+	}
+
+	/* Keep what the enclosing call has used so far */
+	if (prof->depth != 0U) {
+		uintptr_t low = stack_low(cpu);
+
+		if (low < prof->nested_low) {
+			prof->nested_low = low;
+		}
+	}
+
+	/* No function is called while painting, so that no frame is lost */
+	for (unsigned long *p = (unsigned long *)prof->dirty;
+	     (uintptr_t)p < sp; p++) {
+		*p = STACK_PAINT;
+	}
+
+	if (sp > prof->dirty) {
+		prof->dirty = sp;
+	}
+	prof->depth++;
+}
+
+void stack_profile_end(unsigned long fid)
+{
+	unsigned int cpu = my_cpuid();
+	struct stack_profile_cpu *prof = &per_cpu(stack_profile, cpu);
+	uintptr_t low;
+	unsigned long depth;
+
+	if (percpu_stack_base(cpu) == 0UL) {
+		return;
+	}
+
+	assert(prof->depth != 0U);
+
+	low = stack_low(cpu);
+	prof->dirty = low;
+	prof->depth--;
+
+	if (prof->depth == 0U) {
+		if (prof->nested_low < low) {
+			low = prof->nested_low;
+		}
+		prof->nested_low = percpu_stack_top(cpu);
+	} else if (low < prof->nested_low) {
+		prof->nested_low = low;
+	}
+
+	depth = percpu_stack_top(cpu) - low;
+
+	if (IS_SMC64_RMI_FID(fid)) {
+		unsigned long *max = &prof->rmi[
+			SMC64_FID_OFFSET_FROM_RANGE_MIN(RMI, fid)];
+
+		*max = (depth > *max) ? depth : *max;
+	} else if (IS_SMC64_RSI_FID(fid)) {
+		unsigned long *max = &prof->rsi[
+			SMC64_FID_OFFSET_FROM_RANGE_MIN(RSI, fid)];
+
+		*max = (depth > *max) ? depth : *max;
+	}
+}
+
+bool stack_profile_read(unsigned long fid, unsigned long cpu,
+			unsigned long *depth)
+{
+	const struct stack_profile_cpu *prof;
+
+	/* Only the per-CPU areas of the CPUs reported by EL3 are mapped */
+	if (cpu >= rmm_el3_ifc_get_num_cpus()) {
+		return false;
+	}
+
+	prof = &per_cpu(stack_profile, cpu);
+
+	if (IS_SMC64_RMI_FID(fid)) {
+		*depth = SCA_READ64(&prof->rmi[
+				SMC64_FID_OFFSET_FROM_RANGE_MIN(RMI, fid)]);
+	} else if (IS_SMC64_RSI_FID(fid)) {
+		*depth = SCA_READ64(&prof->rsi[
+				SMC64_FID_OFFSET_FROM_RANGE_MIN(RSI, fid)]);
+	} else {
+		return false;
+	}
+
+	return true;
+}
+#endif /* RMM_STACK_PROFILE */
@@ -0,0 +1,132 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch_helpers.h>
+#include <buffer.h>
+#include <exit.h>
+#include <granule.h>
+#include <granule_types.h>
+#include <rec.h>
+#include <smc-handler.h>
+#include <smc-rmi.h>
+#include <spinlock.h>
+#include <stddef.h>
+#include <stats_page.h>
+#include <utils_def.h>
+
+/* NS address of the page, read without the lock at the end of RMI calls */
+static unsigned long page_addr __hot_bss;
+
+/* CNTPCT_EL0 value from which the page is written again */
+static unsigned long page_due __hot_bss;
+
+/* The fields below are protected by page_lock */
+static spinlock_t page_lock;
+static unsigned long page_interval;
+static unsigned long page_seq;
+static struct rmi_stats_page page;
+
+unsigned long stats_page_register(unsigned long ns_addr,
+				  unsigned long interval_us)
+{
+	struct granule *g_ns;
+
+	if (interval_us > RMI_STATS_PAGE_MAX_INTERVAL_US) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (ns_addr != 0UL) {
+		g_ns = find_granule(ns_addr);
+		if ((g_ns == NULL) || (g_ns->state != GRANULE_STATE_NS)) {
+			return RMI_ERROR_INPUT;
+		}
+	}
+
+	spinlock_acquire(&page_lock);
+	page_interval = (interval_us * read_cntfrq_el0()) / 1000000UL;
+	page_seq = 0UL;
+
+	/* The page is first written at the end of this call */
+	SCA_WRITE64(&page_due, 0UL);
+	SCA_WRITE64(&page_addr, ns_addr);
+	spinlock_release(&page_lock);
+
+	return RMI_SUCCESS;
+}
+
+static void stats_page_fill(unsigned long now)
+{
+	page.timestamp = now;
+	page.attest_heaps_used = rec_attest_heaps_used(&page.attest_heaps_nr);
+
+	for (unsigned long i = 0UL; i < RMI_GRANULE_STATE_NR; i++) {
+		page.granules[i] = 0UL;
+#ifdef RMM_GRANULE_STATS
+		if (i != RMI_GRANULE_STATE_NS) {
+			page.granules[i] = (unsigned long)granule_stats_count(
+						(enum granule_state)i);
+		}
+#endif
+	}
+
+	rec_exit_totals_read(page.rec_exits);
+	rmi_stats_sum(page.cmds);
+}
+
+static bool stats_page_write_seq(struct granule *g_ns, unsigned long seq)
+{
+	return ns_buffer_write(SLOT_NS, g_ns,
+			       (unsigned int)offsetof(struct rmi_stats_page, seq),
+			       (unsigned int)sizeof(seq), &seq);
+}
+
+void stats_page_update(void)
+{
+	struct granule *g_ns;
+	unsigned long now;
+	bool written;
+
+	if (SCA_READ64(&page_addr) == 0UL) {
+		return;
+	}
+
+	now = read_cntpct_el0();
+	if (now < SCA_READ64(&page_due)) {
+		return;
+	}
+
+	spinlock_acquire(&page_lock);
+
+	/* Another CPU may have written the page, or the Host removed it */
+	if ((page_addr == 0UL) || (now < page_due)) {
+		spinlock_release(&page_lock);
+		return;
+	}
+
+	SCA_WRITE64(&page_due, now + page_interval);
+	g_ns = find_granule(page_addr);
+
+	stats_page_fill(now);
+	page.seq = page_seq + 1UL;
+	written = (g_ns != NULL) && stats_page_write_seq(g_ns, page.seq);
+
+	/* Make the odd sequence number visible to the Host before the page */
+	dmb(ishst);
+	written = written &&
+		  ns_buffer_write(SLOT_NS, g_ns, 0U,
+				  (unsigned int)sizeof(page), &page);
+
+	/* And the page before the next even sequence number */
+	dmb(ishst);
+	page_seq += 2UL;
+	written = written && stats_page_write_seq(g_ns, page_seq);
+
+	/* Stop writing a granule the Host has delegated meanwhile */
+	if (!written) {
+		SCA_WRITE64(&page_addr, 0UL);
+	}
+
+	spinlock_release(&page_lock);
+}
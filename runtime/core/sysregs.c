@@ -9,8 +9,12 @@
 #include <debug.h>
 #include <esr.h>
 #include <memory_alloc.h>
+#include <realm.h>
 #include <rec.h>
+#include <sgi.h>
 #include <smc-rmi.h>
+#include <spe.h>
+#include <sysreg_traps.h>
 
 #define SYSREG_READ_CASE(reg) \
 	case ESR_EL2_SYSREG_##reg: return read_##reg()
@@ -41,41 +45,26 @@ static unsigned long read_idreg(unsigned int idreg)
 }
 
 /*
- * Handle ID_AA64XXX<n>_EL1 instructions
+ * Return the bits of the ID register @idreg which are hidden from a Realm
+ * with the PMU and SPE enabled as per @pmu_enabled and @spe_enabled.
  */
-static bool handle_id_sysreg_trap(struct rec *rec,
-				  struct rmi_rec_exit *rec_exit,
-				  unsigned long esr)
+static unsigned long idreg_mask(unsigned long idreg, bool pmu_enabled,
+				bool spe_enabled)
 {
-	unsigned int rt;
-	unsigned long idreg, mask;
-
-	/*
-	 * We only set HCR_EL2.TID3 to trap ID registers at the moment and
-	 * that only traps reads of registers. Seeing a write here indicates a
-	 * consistency problem with the RMM and we should panic immediately.
-	 */
-	assert(!ESR_EL2_SYSREG_IS_WRITE(esr));
-
-	/*
-	 * Read Rt value from the issued instruction,
-	 * the general-purpose register used for the transfer.
-	 */
-	rt = ESR_EL2_SYSREG_ISS_RT(esr);
-
-	/* Handle writes to XZR register */
-	if (rt == 31U) {
-		return true;
-	}
-
-	idreg = esr & ESR_EL2_SYSREG_MASK;
+	unsigned long mask;
 
 	if (idreg == ESR_EL2_SYSREG_ID_AA64ISAR1_EL1) {
-		/* Clear Address and Generic Authentication bits */
+		/*
+		 * Clear Address and Generic Authentication bits, unless the
+		 * Realms can use Pointer Authentication.
+		 */
 		mask = (0xfUL << ESR_EL2_SYSREG_ID_AA64ISAR1_APA_SHIFT) |
 		       (0xfUL << ESR_EL2_SYSREG_ID_AA64ISAR1_API_SHIFT) |
 		       (0xfUL << ESR_EL2_SYSREG_ID_AA64ISAR1_GPA_SHIFT) |
 		       (0xfUL << ESR_EL2_SYSREG_ID_AA64ISAR1_GPI_SHIFT);
+		if (HAS_PAUTH) {
+			mask = 0UL;
+		}
 	/*
 	 * Workaround for TF-A trapping AMU registers access
 	 * to EL3 in Realm state
@@ -89,20 +78,109 @@ static bool handle_id_sysreg_trap(struct rec *rec,
 		 * completely supports SVE.
 		 */
 		mask |= MASK(ID_AA64PFR0_EL1_SVE);
+
+		/* The partition of the Realm is chosen by the Host */
+		mask |= MASK(ID_AA64PFR0_EL1_MPAM);
+	} else if (idreg == ESR_EL2_SYSREG_ID_AA64PFR1_EL1) {
+		/* Clear the MPAM minor version along with the major one */
+		mask = MASK(ID_AA64PFR1_EL1_MPAM_FRAC);
+	} else if (idreg == ESR_EL2_SYSREG_ID_AA64DFR0_EL1) {
+		/* Clear support for PMU, unless it is enabled for the Realm */
+		mask = pmu_enabled ? 0UL : MASK(ID_AA64DFR0_EL1_PMUVER);
+
+		/* Clear support for SPE, unless it is enabled for the Realm */
+		if (!spe_enabled) {
+			mask |= MASK(ID_AA64DFR0_EL1_PMSVER);
+		}
 	} else {
 		mask = 0UL;
 	}
 
-	ARRAY_WRITE(rec->regs, rt, read_idreg(idreg) & ~mask);
+	return mask;
+}
 
-	return true;
+/*
+ * Fill @id_regs with the values of the ID registers, as returned to a Realm
+ * with the PMU and SPE enabled as per @pmu_enabled and @spe_enabled. Entry
+ * ((CRm - REALM_ID_REGS_CRM_BASE) * 8) + op2 holds the register at CRm and
+ * op2. The values only depend on the CPU and on the parameters of the Realm,
+ * so they are computed once when the Realm is created.
+ */
+void realm_id_regs_init(unsigned long *id_regs,
+			bool pmu_enabled, bool spe_enabled)
+{
+	for (unsigned int i = 0U; i < REALM_ID_REGS_LEN; i++) {
+		unsigned long idreg = SYSREG_ESR(3UL, 0UL, 0UL,
+					(unsigned long)((i / 8U) +
+						REALM_ID_REGS_CRM_BASE),
+					(unsigned long)(i % 8U));
+
+		id_regs[i] = read_idreg((unsigned int)idreg) &
+			     ~idreg_mask(idreg, pmu_enabled, spe_enabled);
+	}
+}
+
+/*
+ * Handle reads of the ID_AA64XXX<n>_EL1 registers, from the sanitised values
+ * of the Realm copied to the REC.
+ */
+void handle_id_sysreg_trap(struct rec *rec, unsigned long esr)
+{
+	unsigned int rt, crm, op2;
+
+	/*
+	 * We only set HCR_EL2.TID3 to trap ID registers at the moment and
+	 * that only traps reads of registers. Seeing a write here indicates a
+	 * consistency problem with the RMM and we should panic immediately.
+	 */
+	assert(!ESR_EL2_SYSREG_IS_WRITE(esr));
+
+	/*
+	 * Read Rt value from the issued instruction,
+	 * the general-purpose register used for the transfer.
+	 */
+	rt = ESR_EL2_SYSREG_ISS_RT(esr);
+
+	/* Handle writes to XZR register */
+	if (rt == 31U) {
+		return;
+	}
+
+	crm = (unsigned int)EXTRACT(ESR_EL2_SYSREG_TRAP_CRM, esr);
+	op2 = (unsigned int)EXTRACT(ESR_EL2_SYSREG_TRAP_OP2, esr);
+
+	/* All the other encodings are in the RES0 space */
+	if ((crm < REALM_ID_REGS_CRM_BASE) ||
+	    (crm >= (REALM_ID_REGS_CRM_BASE + (REALM_ID_REGS_LEN / 8U)))) {
+		ARRAY_WRITE(rec->regs, rt, 0UL);
+		return;
+	}
+
+	/* The RD is mapped for the whole REC entry, see rec_run_loop() */
+	ARRAY_WRITE(rec->regs, rt,
+		    rec->rd->id_regs[((crm - REALM_ID_REGS_CRM_BASE) * 8U) +
+				     op2]);
+}
+
+static unsigned long get_sysreg_write_value(struct rec *rec, unsigned long esr)
+{
+	unsigned int rt = esr_sysreg_rt(esr);
+	unsigned long val;
+
+	/* Handle reads from XZR register */
+	if (rt == 31U) {
+		return 0UL;
+	}
+
+	ARRAY_READ(rec->regs, rt, val);
+	return val;
 }
 
 static bool handle_icc_el1_sysreg_trap(struct rec *rec,
 				       struct rmi_rec_exit *rec_exit,
 				       unsigned long esr)
 {
-	__unused unsigned long sysreg = esr & ESR_EL2_SYSREG_MASK;
+	unsigned long sysreg = esr & ESR_EL2_SYSREG_MASK;
 
 	/*
 	 * We should only have configured ICH_HCR_EL2 to trap on DIR and we
@@ -120,11 +198,27 @@ static bool handle_icc_el1_sysreg_trap(struct rec *rec,
 	 */
 	assert(ESR_EL2_SYSREG_IS_WRITE(esr));
 
+	if ((sysreg == ESR_EL2_SYSREG_ICC_SGI1R_EL1) &&
+	    sgi_post(rec, get_sysreg_write_value(rec, esr))) {
+		return true;
+	}
+
 	rec_exit->exit_reason = RMI_EXIT_SYNC;
 	rec_exit->esr = esr;
 	return false;
 }
 
+/*
+ * Handle the SPE Profiling Buffer registers, trapped by MDCR_EL2.E2PB
+ */
+static bool handle_pmb_sysreg_trap(struct rec *rec,
+				   struct rmi_rec_exit *rec_exit,
+				   unsigned long esr)
+{
+	spe_emulate_buffer_access(rec, esr);
+	return true;
+}
+
 typedef bool (*sysreg_handler_fn)(struct rec *rec, struct rmi_rec_exit *rec_exit,
 				  unsigned long esr);
 
@@ -138,25 +232,11 @@ struct sysreg_handler {
 	{ .esr_mask = (_mask), .esr_value = (_value), .fn = _handler_fn }
 
 static const struct sysreg_handler sysreg_handlers[] = {
-	SYSREG_HANDLER(ESR_EL2_SYSREG_ID_MASK, ESR_EL2_SYSREG_ID, handle_id_sysreg_trap),
 	SYSREG_HANDLER(ESR_EL2_SYSREG_ICC_EL1_MASK, ESR_EL2_SYSREG_ICC_EL1, handle_icc_el1_sysreg_trap),
-	SYSREG_HANDLER(ESR_EL2_SYSREG_MASK, ESR_EL2_SYSREG_ICC_PMR_EL1, handle_icc_el1_sysreg_trap)
+	SYSREG_HANDLER(ESR_EL2_SYSREG_MASK, ESR_EL2_SYSREG_ICC_PMR_EL1, handle_icc_el1_sysreg_trap),
+	SYSREG_HANDLER(ESR_EL2_SYSREG_PMB_MASK, ESR_EL2_SYSREG_PMB, handle_pmb_sysreg_trap)
 };
 
-static unsigned long get_sysreg_write_value(struct rec *rec, unsigned long esr)
-{
-	unsigned int rt = esr_sysreg_rt(esr);
-	unsigned long val;
-
-	/* Handle reads from XZR register */
-	if (rt == 31U) {
-		return 0UL;
-	}
-
-	ARRAY_READ(rec->regs, rt, val);
-	return val;
-}
-
 static void emulate_sysreg_access_ns(struct rec *rec, struct rmi_rec_exit *rec_exit,
 				     unsigned long esr)
 {
@@ -0,0 +1,180 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <arch_helpers.h>
+#include <buffer.h>
+#include <cpuid.h>
+#include <granule.h>
+#include <pc_sample.h>
+#include <smc-handler.h>
+#include <smc-rmi.h>
+#include <trace.h>
+
+#ifdef RMM_TRACE
+static struct trace_buffer trace_buffers[MAX_CPUS] = {
+	[0 ... (MAX_CPUS - 1U)] = {
+		.magic = TRACE_MAGIC,
+		.version = TRACE_VERSION
+	}
+};
+
+void trace_call(unsigned int fid, unsigned int flags, unsigned long args[5],
+		unsigned long res0, unsigned long res1)
+{
+	struct trace_buffer *buf = &trace_buffers[my_cpuid()];
+	struct trace_record *rec = &buf->records[buf->head % TRACE_ENTRIES];
+
+	rec->timestamp = read_cntpct_el0();
+	rec->fid = fid;
+	rec->flags = flags;
+
+	for (unsigned int i = 0U; i < 5U; i++) {
+		rec->args[i] = args[i];
+	}
+
+	rec->res[0] = res0;
+	rec->res[1] = res1;
+
+	buf->head++;
+}
+#endif /* RMM_TRACE */
+
+#ifdef RMM_REC_EXIT_TRACE
+static struct rec_exit_trace_buffer rec_exit_trace_buffers[MAX_CPUS] = {
+	[0 ... (MAX_CPUS - 1U)] = {
+		.magic = REC_EXIT_TRACE_MAGIC,
+		.version = REC_EXIT_TRACE_VERSION
+	}
+};
+
+/* Record being written by the current CPU, at the head of its ring */
+static struct rec_exit_trace_record *rec_exit_trace_current(void)
+{
+	struct rec_exit_trace_buffer *buf = &rec_exit_trace_buffers[my_cpuid()];
+
+	return &buf->records[buf->head % REC_EXIT_TRACE_ENTRIES];
+}
+
+void rec_exit_trace_begin(void)
+{
+	struct rec_exit_trace_record *rec = rec_exit_trace_current();
+
+	rec->rmi_entry = read_cntpct_el0();
+	rec->realm_entry = 0UL;
+	rec->nr_exits = 0U;
+}
+
+void rec_exit_trace_realm_entry(void)
+{
+	struct rec_exit_trace_record *rec = rec_exit_trace_current();
+
+	if (rec->nr_exits == 0U) {
+		rec->realm_entry = read_cntpct_el0();
+	}
+}
+
+void rec_exit_trace_realm_exit(unsigned long esr)
+{
+	struct rec_exit_trace_record *rec = rec_exit_trace_current();
+
+	rec->realm_exit = read_cntpct_el0();
+	rec->esr = esr;
+	rec->nr_exits++;
+}
+
+void rec_exit_trace_end(unsigned long exit_reason)
+{
+	struct rec_exit_trace_buffer *buf = &rec_exit_trace_buffers[my_cpuid()];
+	struct rec_exit_trace_record *rec =
+			&buf->records[buf->head % REC_EXIT_TRACE_ENTRIES];
+
+	if (rec->nr_exits == 0U) {
+		return;
+	}
+
+	rec->rmi_return = read_cntpct_el0();
+	rec->exit_reason = (unsigned int)exit_reason;
+
+	buf->head++;
+}
+#endif /* RMM_REC_EXIT_TRACE */
+
+/*
+ * Implements RMI_TRACE_DUMP.
+ *
+ * Copy the trace ring of CPU @cpu to the NS granule at @ns_addr. The ring
+ * of another CPU may be updated during the copy, in which case the record
+ * being written can be torn.
+ */
+unsigned long smc_trace_dump(unsigned long ns_addr, unsigned long cpu)
+{
+	if ((cpu & RMI_TRACE_DUMP_PC_SAMPLES) != 0UL) {
+		return pc_sample_dump(ns_addr,
+				      cpu & ~RMI_TRACE_DUMP_PC_SAMPLES);
+	}
+
+#ifdef RMM_TRACE
+	struct granule *g_ns;
+
+	if (cpu >= MAX_CPUS) {
+		return RMI_ERROR_INPUT;
+	}
+
+	g_ns = find_granule(ns_addr);
+	if ((g_ns == NULL) || (g_ns->state != GRANULE_STATE_NS)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (!ns_buffer_write(SLOT_NS, g_ns, 0U,
+			     (unsigned int)sizeof(struct trace_buffer),
+			     &trace_buffers[cpu])) {
+		return RMI_ERROR_INPUT;
+	}
+
+	return RMI_SUCCESS;
+#else
+	(void)ns_addr;
+	(void)cpu;
+
+	/* The trace is not built in */
+	return RMI_ERROR_INPUT;
+#endif /* RMM_TRACE */
+}
+
+/*
+ * Implements RMI_REC_EXIT_TRACE_DUMP.
+ *
+ * Copy the REC entry trace ring of CPU @cpu to the NS granule at @ns_addr,
+ * with the same caveat as RMI_TRACE_DUMP for the record being written.
+ */
+unsigned long smc_rec_exit_trace_dump(unsigned long ns_addr, unsigned long cpu)
+{
+#ifdef RMM_REC_EXIT_TRACE
+	struct granule *g_ns;
+
+	if (cpu >= MAX_CPUS) {
+		return RMI_ERROR_INPUT;
+	}
+
+	g_ns = find_granule(ns_addr);
+	if ((g_ns == NULL) || (g_ns->state != GRANULE_STATE_NS)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (!ns_buffer_write(SLOT_NS, g_ns, 0U,
+			     (unsigned int)sizeof(struct rec_exit_trace_buffer),
+			     &rec_exit_trace_buffers[cpu])) {
+		return RMI_ERROR_INPUT;
+	}
+
+	return RMI_SUCCESS;
+#else
+	(void)ns_addr;
+	(void)cpu;
+
+	/* The trace is not built in */
+	return RMI_ERROR_INPUT;
+#endif /* RMM_REC_EXIT_TRACE */
+}
@@ -6,6 +6,7 @@
 #include <arch_features.h>
 #include <assert.h>
 #include <atomics.h>
+#include <memory.h>
 #include <sizes.h>
 #include <spinlock.h>
 #include <vmid.h>
@@ -20,6 +21,19 @@
  */
 static unsigned long vmids[VMID_ARRAY_LONG_SIZE];
 
+/*
+ * The bitmap of the VMIDs of the Realms in the REALM_STATE_ACTIVE state.
+ * It mirrors rd->state so that RMI_REC_ENTER can check the state of the
+ * Realm without mapping its RD.
+ */
+static unsigned long active_vmids[VMID_ARRAY_LONG_SIZE];
+
+/*
+ * VMID following the last one returned by vmid_find_free(), from which the
+ * next search starts. It is only a hint, so it is accessed without a lock.
+ */
+static unsigned long vmid_hint;
+
 /*
  * Marks the VMID value to be in use. It returns:
  * - True, on success
@@ -61,5 +75,105 @@ void vmid_free(unsigned int vmid)
 	assert(vmid < vmid_count);
 	offset = vmid / BITS_PER_UL;
 
+	atomic_bit_clear_release_64(&active_vmids[offset], vmid);
 	atomic_bit_clear_release_64(&vmids[offset], vmid);
 }
+
+/*
+ * Record whether the Realm using @vmid is in the REALM_STATE_ACTIVE state.
+ * This must be called with the RD locked, after the state has been updated.
+ */
+void vmid_set_realm_active(unsigned int vmid, bool active)
+{
+	unsigned int offset = vmid / BITS_PER_UL;
+
+	assert(vmid < MAX_VMID_COUNT);
+
+	if (active) {
+		atomic_bit_set_release_64(&active_vmids[offset], vmid);
+	} else {
+		atomic_bit_clear_release_64(&active_vmids[offset], vmid);
+	}
+}
+
+/*
+ * Returns true if the Realm using @vmid is in the REALM_STATE_ACTIVE state.
+ * The caller must hold a reference to the RD or to one of its RECs.
+ */
+bool vmid_realm_is_active(unsigned int vmid)
+{
+	unsigned int offset = vmid / BITS_PER_UL;
+
+	assert(vmid < MAX_VMID_COUNT);
+
+	return atomic_test_bit_acquire_64(&active_vmids[offset], vmid);
+}
+
+/*
+ * Look for a VMID not in use in [from, to), one bitmap word at a time.
+ */
+static bool vmid_scan(unsigned int from, unsigned int to, unsigned int *vmid)
+{
+	while (from < to) {
+		unsigned int offset = from / BITS_PER_UL;
+		unsigned long unused = ~SCA_READ64(&vmids[offset]);
+
+		/* Ignore the VMIDs below @from in the first word */
+		unused &= ~0UL << (from % BITS_PER_UL);
+
+		if (unused != 0UL) {
+			unsigned int found = (offset * BITS_PER_UL) +
+				(unsigned int)__builtin_ctzl(unused);
+
+			if (found >= to) {
+				return false;
+			}
+
+			*vmid = found;
+			return true;
+		}
+
+		from = (offset + 1U) * BITS_PER_UL;
+	}
+
+	return false;
+}
+
+/*
+ * Find a VMID value not in use which is greater than or equal to @min_vmid.
+ * The search starts after the VMID returned by the previous call, so that
+ * the VMIDs found by concurrent callers are unlikely to be the same.
+ *
+ * The VMID is not reserved, which is done by vmid_reserve() when the Realm
+ * is created. It returns:
+ * - True, on success, with the VMID value in @vmid
+ * - False, if @min_vmid is out of range or all the VMIDs are in use.
+ */
+bool vmid_find_free(unsigned int min_vmid, unsigned int *vmid)
+{
+	unsigned int vmid_count;
+	unsigned int start;
+
+	assert(vmid != NULL);
+
+	/* Number of supported VMID values */
+	vmid_count = is_feat_vmid16_present() ? VMID16_COUNT : VMID8_COUNT;
+
+	if (min_vmid >= vmid_count) {
+		return false;
+	}
+
+	start = (unsigned int)SCA_READ64(&vmid_hint);
+	if ((start < min_vmid) || (start >= vmid_count)) {
+		start = min_vmid;
+	}
+
+	/* Search from the hint to the end, then wrap around to @min_vmid */
+	if (!vmid_scan(start, vmid_count, vmid) &&
+	    !vmid_scan(min_vmid, start, vmid)) {
+		return false;
+	}
+
+	SCA_WRITE64(&vmid_hint, *vmid + 1U);
+	return true;
+}
@@ -12,5 +12,12 @@ struct rec;
 struct rmi_rec_exit;
 
 bool handle_realm_exit(struct rec *rec, struct rmi_rec_exit *rec_exit, int exception);
+bool handle_realm_exit_fast(struct rec *rec, int exception);
+
+/*
+ * Write to @totals the number of Realm exits of all the RECs for each
+ * RMI_REC_STATS_EXIT_*, or zeros if RMM is built without RMM_REC_STATS.
+ */
+void rec_exit_totals_read(unsigned long *totals);
 
 #endif /* EXIT_H */
@@ -21,12 +21,87 @@
 #define	RMI_NO_LPA2				UL(0)
 #define	RMI_LPA2				UL(1)
 
+#define RMM_FEATURE_REGISTER_0_PMU_EN_SHIFT	UL(22)
+#define RMM_FEATURE_REGISTER_0_PMU_EN_WIDTH	UL(1)
+
+#define RMM_FEATURE_REGISTER_0_PMU_NUM_CTRS_SHIFT	UL(23)
+#define RMM_FEATURE_REGISTER_0_PMU_NUM_CTRS_WIDTH	UL(5)
+
 #define RMM_FEATURE_REGISTER_0_HASH_SHA_256_SHIFT	UL(28)
 #define RMM_FEATURE_REGISTER_0_HASH_SHA_256_WIDTH	UL(1)
 
 #define RMM_FEATURE_REGISTER_0_HASH_SHA_512_SHIFT	UL(29)
 #define RMM_FEATURE_REGISTER_0_HASH_SHA_512_WIDTH	UL(1)
 
+/* Implementation defined: fold fully populated RTTs automatically */
+#define RMM_FEATURE_REGISTER_0_AUTO_FOLD_SHIFT	UL(30)
+#define RMM_FEATURE_REGISTER_0_AUTO_FOLD_WIDTH	UL(1)
+
+/*
+ * Implementation defined: apply RSI_IPA_STATE_SET to RIPAS EMPTY without
+ * exiting to the Host, when the RTTs of the range exist.
+ */
+#define RMM_FEATURE_REGISTER_0_AUTO_RIPAS_EMPTY_SHIFT	UL(31)
+#define RMM_FEATURE_REGISTER_0_AUTO_RIPAS_EMPTY_WIDTH	UL(1)
+
+/* Implementation defined: Statistical Profiling Extension, see RMM_SPE */
+#define RMM_FEATURE_REGISTER_0_SPE_EN_SHIFT	UL(32)
+#define RMM_FEATURE_REGISTER_0_SPE_EN_WIDTH	UL(1)
+
+/*
+ * Implementation defined: hardware management of the Access flag and of the
+ * dirty state of the Realm stage 2 (FEAT_HAFDBS), see RMI_RTT_SCAN_ACCESS
+ */
+#define RMM_FEATURE_REGISTER_0_HAFDBS_EN_SHIFT	UL(33)
+#define RMM_FEATURE_REGISTER_0_HAFDBS_EN_WIDTH	UL(1)
+
+/*
+ * Implementation defined: the NS EL1 registers are not preserved across
+ * RMI_REC_ENTER with REC_ENTRY_FLAG_NS_EL1_DEAD
+ */
+#define RMM_FEATURE_REGISTER_0_NS_EL1_DEAD_SHIFT	UL(34)
+#define RMM_FEATURE_REGISTER_0_NS_EL1_DEAD_WIDTH	UL(1)
+
+/*
+ * Implementation defined: RMI_REALM_CREATE ignores rtt_level_start and picks
+ * the starting level with the shallowest walk for the IPA size which needs
+ * at most rtt_num_start concatenated starting level RTTs
+ */
+#define RMM_FEATURE_REGISTER_0_AUTO_SL_SHIFT	UL(35)
+#define RMM_FEATURE_REGISTER_0_AUTO_SL_WIDTH	UL(1)
+
+/*
+ * Implementation defined: the RMI calls with the SMCCC v1.2 extended calling
+ * convention are supported, see RMM_SMCCC_EXT_REGS
+ */
+#define RMM_FEATURE_REGISTER_0_EXT_REGS_SHIFT	UL(36)
+#define RMM_FEATURE_REGISTER_0_EXT_REGS_WIDTH	UL(1)
+
+/*
+ * Implementation defined: dirty state of the Realm stage 2 tracked by
+ * write-protecting its entries, without FEAT_HAFDBS, see
+ * RMI_RTT_SCAN_ACCESS. Cannot be set together with HAFDBS_EN.
+ */
+#define RMM_FEATURE_REGISTER_0_WP_DIRTY_EN_SHIFT	UL(37)
+#define RMM_FEATURE_REGISTER_0_WP_DIRTY_EN_WIDTH	UL(1)
+
+/*
+ * Implementation defined: WFI and WFE executed by the RECs of the Realm are
+ * never trapped, whatever REC_ENTRY_FLAG_TRAP_WFI and REC_ENTRY_FLAG_TRAP_WFE,
+ * for Realms whose RECs run on dedicated physical CPUs
+ */
+#define RMM_FEATURE_REGISTER_0_WFX_NOTRAP_SHIFT	UL(38)
+#define RMM_FEATURE_REGISTER_0_WFX_NOTRAP_WIDTH	UL(1)
+
+/*
+ * Implementation defined: the Host can move the content of the pages of the
+ * Realm out of it and back, encrypted, with RMI_DATA_EXPORT and
+ * RMI_DATA_IMPORT
+ */
+#define RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN_SHIFT	UL(39)
+#define RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN_WIDTH	UL(1)
+
 bool validate_feature_register(unsigned long index, unsigned long value);
+bool validate_mpam_value(unsigned long value);
 
 #endif /* FEATURE_H */
@@ -0,0 +1,25 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef JOB_H
+#define JOB_H
+
+#include <smc-handler.h>
+#include <stdbool.h>
+
+/*
+ * Run a step of one of the jobs submitted with RMI_JOB_SUBMIT, if there
+ * is any, at the end of an RMI call.
+ */
+void rmi_jobs_run(void);
+
+unsigned long realm_teardown_step(unsigned long rd_addr,
+				  unsigned long list_addr,
+				  unsigned long limit,
+				  struct rmi_budget *budget,
+				  unsigned long *count,
+				  bool *done);
+
+#endif /* JOB_H */
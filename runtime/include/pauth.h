@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef PAUTH_H
+#define PAUTH_H
+
+#include <stdbool.h>
+
+struct rec;
+
+/*
+ * When RMM is built with RMM_PAUTH, the Realms use Pointer Authentication
+ * without trapping. EL3 firmware preserves the keys of the Realm world
+ * across the calls to the Host, so the keys of a REC are only loaded when
+ * the CPU does not hold their latest copy, as it last ran another REC or
+ * the REC ran on another CPU since. They are only saved on REC exit while
+ * the Realm may have changed them: when Pointer Authentication is disabled
+ * in SCTLR_EL1, the accesses to the keys are trapped instead.
+ */
+
+/* Return a new identifier for the keys of a REC, never zero */
+unsigned long pauth_new_id(void);
+
+/*
+ * Forget which keys the current CPU holds. To be called when the CPU starts,
+ * as the keys are UNKNOWN at that point.
+ */
+void pauth_reset(void);
+
+/*
+ * Load the keys of @rec, unless the current CPU still holds them, and let the
+ * Realm access them if it has enabled Pointer Authentication.
+ */
+void pauth_enter_realm(struct rec *rec);
+
+/*
+ * Save the keys of @rec, if the Realm could write them since REC entry, and
+ * give them a new identifier held by the current CPU only.
+ */
+void pauth_exit_realm(struct rec *rec);
+
+/*
+ * Stop trapping the accesses to the keys if @esr describes one of them, in
+ * which case the instruction is executed again and true is returned.
+ */
+bool pauth_handle_sysreg_trap(struct rec *rec, unsigned long esr);
+
+#endif /* PAUTH_H */
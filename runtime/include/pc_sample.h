@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef PC_SAMPLE_H
+#define PC_SAMPLE_H
+
+/*
+ * Statistical sampling of the PC of RMM.
+ *
+ * When RMM_PC_SAMPLE is enabled, the last PMU event counter of the PE counts
+ * the CPU cycles at Realm EL2 while RMM runs, and overflows every
+ * RMM_PC_SAMPLE_PERIOD cycles. IRQs are unmasked while RMM runs an RMI
+ * command other than RMI_REC_ENTER, so that the overflow interrupt is taken
+ * by RMM, which records ELR_EL2 with the FID of the command. The Realm exit
+ * handlers run with IRQs masked, as ELR_EL2 and SPSR_EL2 still hold the
+ * state of the Realm, so their samples are polled at the end of the handler
+ * and only record the cause of the exit.
+ *
+ * The interrupt is not acknowledged at the GIC: clearing the overflow flag
+ * of the counter deasserts it. Any other interrupt taken by RMM is left
+ * pending for the Host, and IRQs stay masked until the end of the command.
+ */
+
+#ifdef RMM_PC_SAMPLE
+/* Start sampling the RMI call @fid on the current CPU */
+void pc_sample_begin(unsigned long fid);
+
+/* Stop sampling the RMI call and restore the NS state of the counter */
+void pc_sample_end(void);
+
+/*
+ * Called around the handling of a Realm exit of @cause, one of
+ * RMI_REC_STATS_EXIT_*, by handle_realm_exit().
+ */
+void pc_sample_exit_begin(unsigned long cause);
+void pc_sample_exit_end(void);
+
+/*
+ * Called by the IRQ vector of the current EL with the interrupted PC. It
+ * may set SPSR_EL2.I so that IRQs stay masked on return.
+ */
+void pc_sample_irq(unsigned long elr);
+#endif /* RMM_PC_SAMPLE */
+
+/* Copy the ring of samples of CPU @cpu to the NS granule at @ns_addr */
+unsigned long pc_sample_dump(unsigned long ns_addr, unsigned long cpu);
+
+#endif /* PC_SAMPLE_H */
@@ -0,0 +1,38 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef PMU_H
+#define PMU_H
+
+#include <stdbool.h>
+
+struct rec;
+struct rmi_rec_exit;
+
+/*
+ * The PMU of a Realm created with PMU_EN is switched lazily. On REC entry,
+ * the PMU still holds the NS state and the accesses of the Realm to the PMU
+ * registers are trapped. The first of these accesses loads the PMU state of
+ * the REC, which is then owned by the Realm until the REC exits. The state
+ * is loaded on REC entry if the Realm left its counters enabled.
+ */
+
+/* Load the PMU state of @rec on REC entry, if the Realm has enabled it */
+void pmu_enter_realm(struct rec *rec);
+
+/*
+ * Handle the trapped access of the Realm to a PMU system register described
+ * by @esr. Returns true if the PMU state of @rec has been loaded, in which
+ * case the instruction is to be executed again without advancing the PC.
+ */
+bool pmu_handle_sysreg_trap(struct rec *rec, unsigned long esr);
+
+/*
+ * Save the PMU state of @rec, if it was loaded during the REC entry, and
+ * report its overflow status in @rec_exit.
+ */
+void pmu_exit_realm(struct rec *rec, struct rmi_rec_exit *rec_exit);
+
+#endif /* PMU_H */
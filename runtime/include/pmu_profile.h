@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef PMU_PROFILE_H
+#define PMU_PROFILE_H
+
+#include <stdbool.h>
+
+/*
+ * Number of PMU event counters used by RMM_PMU_PROFILE. They are the last
+ * event counters of the PE, which are then not available to the Realms.
+ */
+#define PMU_PROFILE_NUM_CTRS	5U
+
+/* Values of the counters at the start of a sample */
+struct pmu_profile_sample {
+	bool valid;
+	unsigned long ctrs[PMU_PROFILE_NUM_CTRS];
+};
+
+/*
+ * Start a sample of the EL2 events. The samples can be nested: the first
+ * one saves the NS state of the counters used by RMM and programs them,
+ * and the last one to end restores the NS state.
+ */
+void pmu_profile_begin(struct pmu_profile_sample *sample);
+
+/*
+ * End @sample and add the events counted since it started to the @entry of
+ * @table, one of RMI_PMU_PROFILE_TABLE_*, for the current CPU.
+ */
+void pmu_profile_end(struct pmu_profile_sample *sample,
+		     unsigned long table, unsigned long entry);
+
+#endif /* PMU_PROFILE_H */
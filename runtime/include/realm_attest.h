@@ -19,6 +19,12 @@ struct attest_result {
 	 */
 	bool incomplete;
 
+	/*
+	 * If true, the signing is left to RMI_REC_ATTEST_SIGN and @smc_result
+	 * is to be returned to the Realm before exiting to the Host.
+	 */
+	bool deferred;
+
 	/*
 	 * Result of RTT walk performed by RSI command.
 	 */
@@ -33,10 +39,13 @@ struct attest_result {
 
 unsigned long handle_rsi_read_measurement(struct rec *rec);
 unsigned long handle_rsi_extend_measurement(struct rec *rec);
+struct rsi_walk_smc_result handle_rsi_extend_measurement_multi(
+							struct rec *rec);
 unsigned long handle_rsi_attest_token_init(struct rec *rec);
 void attest_realm_token_sign_continue_start(void);
 void handle_rsi_attest_token_continue(struct rec *rec,
 				      struct attest_result *res);
 void attest_realm_token_sign_continue_finish(void);
+bool handle_rmi_attest_token_sign(struct rec *rec);
 
 #endif /* REALM_ATTEST_H */
@@ -7,6 +7,7 @@
 #define RSI_LOGGER_H
 
 #include <debug.h>
+#include <trace.h>
 
 /*
  * RSI_LOG_LEVEL debug level is set to one of:
@@ -17,7 +18,19 @@
  * LOG_LEVEL_INFO    = 40
  * LOG_LEVEL_VERBOSE = 50
  */
-#if (RSI_LOG_LEVEL >= LOG_LEVEL_ERROR) && (RSI_LOG_LEVEL <= LOG_LEVEL)
+#if defined(RMM_TRACE)
+
+/* Store SMC RSI parameters */
+# define RSI_LOG_SET(x0, x1, x2, x3, x4)	\
+	unsigned long rsi_log_args[5] = {x0, x1, x2, x3, x4}
+
+/* Record the RSI call in the binary trace */
+# define RSI_LOG_EXIT(id, res, ret)					\
+	trace_call(id, TRACE_FLAG_RSI |					\
+		   ((ret) ? TRACE_FLAG_EXIT_TO_REC : 0U),		\
+		   rsi_log_args, res, 0UL)
+
+#elif (RSI_LOG_LEVEL >= LOG_LEVEL_ERROR) && (RSI_LOG_LEVEL <= LOG_LEVEL)
 
 void rsi_log_on_exit(unsigned int function_id, unsigned long args[5],
 		     unsigned long res, bool exit_to_rec);
@@ -37,5 +50,5 @@ void rsi_log_on_exit(unsigned int function_id, unsigned long args[5],
 # define RSI_LOG_SET(x0, x1, x2, x3, x4)
 # define RSI_LOG_EXIT(id, res, ret)
 
-#endif /* (>= LOG_LEVEL_ERROR) && (<= LOG_LEVEL) */
+#endif /* RMM_TRACE */
 #endif /* RSI_LOGGER_H */
@@ -11,6 +11,11 @@
 struct rec;
 struct rmi_rec_exit;
 
+/*
+ * Returns true if RSI_IPA_STATE_SET completes in RMM, with its result in the
+ * GPRs of @rec, or false if the REC must exit to the Host to apply the
+ * change.
+ */
 bool handle_rsi_ipa_state_set(struct rec *rec, struct rmi_rec_exit *rec_exit);
 
 struct rsi_walk_smc_result handle_rsi_ipa_state_get(struct rec *rec);
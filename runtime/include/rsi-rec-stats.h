@@ -0,0 +1,15 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef RSI_REC_STATS_H
+#define RSI_REC_STATS_H
+
+#include <rsi-walk.h>
+
+struct rec;
+
+struct rsi_walk_smc_result handle_rsi_rec_stats(struct rec *rec);
+
+#endif /* RSI_REC_STATS_H */
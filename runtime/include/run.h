@@ -14,4 +14,11 @@
  */
 int run_realm(unsigned long *regs);
 
+/*
+ * Forget the values of the Realm EL2 registers recorded for the current CPU,
+ * so that they are all written on the next REC entry. To be called when the
+ * CPU starts, as the registers are UNKNOWN at that point.
+ */
+void realm_el2_state_reset(void);
+
 #endif /* RUN_H */
@@ -0,0 +1,38 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef SGI_H
+#define SGI_H
+
+#include <stdbool.h>
+
+struct rec;
+
+/*
+ * With REC_ENTRY_FLAG_SGI_LOCAL, an SGI sent by a REC to a single other REC
+ * of the Realm which is running is posted to the target REC instead of
+ * exiting to the Host. The target REC injects it into a free LR on its next
+ * pass through rec_run_loop(), at the latest on its next exit.
+ */
+
+/* Accept the SGIs posted to @rec while it runs */
+void sgi_open(struct rec *rec);
+
+/* Inject the SGIs posted to the running @rec into its free LRs */
+void sgi_inject_posted(struct rec *rec);
+
+/*
+ * Stop accepting SGIs for @rec and inject the ones posted so far. An SGI for
+ * which no LR is free stays posted until the next entry of @rec.
+ */
+void sgi_close(struct rec *rec);
+
+/*
+ * Post to its target REC the SGI that @rec wrote to ICC_SGI1R_EL1 as @sgi1r.
+ * Returns false if the SGI must be forwarded to the Host instead.
+ */
+bool sgi_post(struct rec *rec, unsigned long sgi1r);
+
+#endif /* SGI_H */
@@ -7,9 +7,27 @@
 #define SMC_HANDLER_H
 
 #include <smc.h>
+#include <stdbool.h>
+
+struct rmi_stats_page_cmd;
+
+/*
+ * Budget of a preemptible RMI command, which returns RMI_INCOMPLETE to the
+ * Host when it is exhausted.
+ */
+struct rmi_budget {
+	/* CNTPCT_EL0 value after which the budget is exhausted */
+	unsigned long deadline;
+};
+
+void rmi_budget_start(struct rmi_budget *budget);
+bool rmi_budget_exhausted(const struct rmi_budget *budget);
+void rmi_return_incomplete(struct smc_result *ret, unsigned long progress);
 
 unsigned long smc_version(void);
 
+unsigned long smc_platform_token_refresh(void);
+
 void smc_read_feature_register(unsigned long index,
 				struct smc_result *ret_struct);
 
@@ -21,19 +39,84 @@ unsigned long smc_data_create(unsigned long data_addr,
 
 unsigned long smc_data_create_unknown(unsigned long data_addr,
 				      unsigned long rd_addr,
-				      unsigned long map_addr);
+				      unsigned long map_addr,
+				      unsigned long flags);
+
+void smc_data_create_range(unsigned long data_base,
+			   unsigned long rd_addr,
+			   unsigned long map_base,
+			   unsigned long src_base,
+			   unsigned long flags,
+			   unsigned long count,
+			   struct smc_result *ret_struct);
 
 unsigned long smc_data_destroy(unsigned long rd_addr,
 			       unsigned long map_addr);
 
+void smc_data_destroy_range(unsigned long rd_addr,
+			    unsigned long base,
+			    unsigned long top,
+			    unsigned long list_addr,
+			    struct smc_result *ret_struct);
+
 unsigned long smc_granule_delegate(unsigned long addr);
 
 unsigned long smc_granule_undelegate(unsigned long addr);
 
+void smc_data_pool_donate(unsigned long rd_addr,
+			  unsigned long base,
+			  unsigned long count,
+			  struct smc_result *ret_struct);
+
+void smc_data_pool_report(unsigned long rd_addr,
+			  unsigned long list_addr,
+			  struct smc_result *ret_struct);
+
+unsigned long smc_rtt_walk_hint(unsigned long addr);
+
+void smc_job_submit(unsigned long type,
+		    unsigned long arg1,
+		    unsigned long arg2,
+		    struct smc_result *ret_struct);
+
+void smc_job_poll(unsigned long id, struct smc_result *ret_struct);
+
+void smc_granule_delegate_range(unsigned long base,
+				unsigned long count,
+				struct smc_result *ret_struct);
+
+void smc_granule_undelegate_range(unsigned long base,
+				  unsigned long count,
+				  struct smc_result *ret_struct);
+
+void smc_granule_delegate_multi(const unsigned long *args,
+				union smc_regs *ret);
+
+void smc_granule_delegate_preserve_range(unsigned long base,
+					 unsigned long count,
+					 struct smc_result *ret_struct);
+
+void smc_granule_state_query(unsigned long base,
+			     unsigned long count,
+			     unsigned long ns_addr,
+			     struct smc_result *ret_struct);
+
+void smc_granule_stats(unsigned long from,
+		       unsigned long to,
+		       unsigned long cpu,
+		       struct smc_result *ret_struct);
+
 unsigned long smc_realm_activate(unsigned long rd_addr);
 
-unsigned long smc_realm_create(unsigned long rd_addr,
-			     unsigned long realm_params_addr);
+void smc_realm_create(unsigned long rd_addr,
+		      unsigned long realm_params_addr,
+		      struct smc_result *res);
+
+void smc_vmid_find(unsigned long min_vmid, struct smc_result *res);
+
+void smc_realm_footprint(unsigned long rd_addr,
+			 unsigned long state,
+			 struct smc_result *res);
 
 unsigned long smc_realm_destroy(unsigned long rd_addr);
 
@@ -41,7 +124,25 @@ unsigned long smc_rec_create(unsigned long rec_addr,
 			     unsigned long rd_addr,
 			     unsigned long rec_params_addr);
 
-unsigned long smc_rec_destroy(unsigned long rec_addr);
+void smc_rec_create_multi(unsigned long rd_addr,
+			  unsigned long list_addr,
+			  unsigned long count,
+			  struct smc_result *ret_struct);
+
+void smc_rec_destroy(unsigned long rec_addr,
+		     unsigned long count,
+		     unsigned long flags,
+		     struct smc_result *ret);
+
+void smc_rec_stats(unsigned long rec_addr,
+		   unsigned long stat,
+		   struct smc_result *ret_struct);
+
+unsigned long smc_rec_mmio_ring(unsigned long rec_addr,
+				unsigned long ring_addr);
+
+void smc_rec_attest_sign(unsigned long rec_addr,
+			 struct smc_result *res);
 
 unsigned long smc_rec_enter(unsigned long rec_addr,
 			    unsigned long rec_run_addr);
@@ -73,11 +174,66 @@ unsigned long smc_rtt_unmap_unprotected(unsigned long rd_addr,
 					unsigned long map_addr,
 					unsigned long ulevel);
 
+void smc_rtt_map_unprotected_range(unsigned long rd_addr,
+				   unsigned long base,
+				   unsigned long top,
+				   unsigned long ulevel,
+				   unsigned long s2tte,
+				   struct smc_result *ret_struct);
+
+void smc_rtt_unmap_unprotected_range(unsigned long rd_addr,
+				     unsigned long base,
+				     unsigned long top,
+				     unsigned long ulevel,
+				     struct smc_result *ret_struct);
+
 void smc_rtt_read_entry(unsigned long rd_addr,
 			unsigned long map_addr,
 			unsigned long ulevel,
 			struct smc_result *ret_struct);
 
+void smc_rtt_read_entries(unsigned long rd_addr,
+			  unsigned long map_addr,
+			  unsigned long ulevel,
+			  unsigned long ns_addr,
+			  struct smc_result *ret_struct);
+
+void smc_rtt_scan_access(unsigned long rd_addr,
+			 unsigned long map_addr,
+			 unsigned long ulevel,
+			 unsigned long ns_addr,
+			 struct smc_result *ret_struct);
+
+void smc_rtt_reclaim(unsigned long rd_addr,
+		     struct smc_result *ret_struct);
+
+void smc_rtt_create_multi(unsigned long rd_addr,
+			  unsigned long map_addr,
+			  unsigned long ulevel,
+			  unsigned long rtt_addr0,
+			  unsigned long rtt_addr1,
+			  unsigned long rtt_addr2,
+			  struct smc_result *ret_struct);
+
+void smc_rtt_destroy_tree(unsigned long rd_addr,
+			  unsigned long map_addr,
+			  unsigned long ulevel,
+			  unsigned long list_addr,
+			  struct smc_result *ret_struct);
+
+void smc_rtt_pool_donate(unsigned long rd_addr,
+			 unsigned long base,
+			 unsigned long count,
+			 struct smc_result *ret_struct);
+
+void smc_rtt_pool_report(unsigned long rd_addr,
+			 unsigned long list_addr,
+			 struct smc_result *ret_struct);
+
+void smc_realm_teardown(unsigned long rd_addr,
+			unsigned long list_addr,
+			struct smc_result *ret_struct);
+
 unsigned long smc_psci_complete(unsigned long calling_rec_addr,
 				unsigned long target_rec_addr);
 
@@ -85,11 +241,67 @@ unsigned long smc_rtt_init_ripas(unsigned long rd_addr,
 				 unsigned long map_addr,
 				 unsigned long ulevel);
 
-unsigned long smc_rtt_set_ripas(unsigned long rd_addr,
-				unsigned long rec_addr,
-				unsigned long map_addr,
-				unsigned long ulevel,
-				unsigned long uripas);
+void smc_rtt_init_ripas_range(unsigned long rd_addr,
+			      unsigned long base,
+			      unsigned long top,
+			      unsigned long ulevel,
+			      struct smc_result *ret_struct);
+
+void smc_rmi_stats(unsigned long fid,
+		   unsigned long cpu,
+		   unsigned long stat,
+		   struct smc_result *ret_struct);
+
+/*
+ * Write to @cmds the RMI_STATS_* of each RMI command, by FID index, summed
+ * over the CPUs. They are zeros if RMM is built without RMM_RMI_STATS.
+ */
+void rmi_stats_sum(struct rmi_stats_page_cmd *cmds);
+
+void smc_pmu_profile(unsigned long table,
+		     unsigned long entry,
+		     unsigned long cpu,
+		     unsigned long counter,
+		     struct smc_result *ret_struct);
+
+unsigned long smc_trace_dump(unsigned long ns_addr,
+			     unsigned long cpu);
+
+unsigned long smc_rec_exit_trace_dump(unsigned long ns_addr,
+				      unsigned long cpu);
+
+void smc_rtt_set_ripas(unsigned long rd_addr,
+		       unsigned long rec_addr,
+		       unsigned long map_addr,
+		       unsigned long ulevel,
+		       unsigned long uripas,
+		       struct smc_result *ret_struct);
+
+void smc_rtt_share_range(unsigned long rd_addr,
+			 unsigned long rec_addr,
+			 unsigned long map_addr,
+			 unsigned long ulevel,
+			 unsigned long host_s2tte,
+			 unsigned long list_addr,
+			 struct smc_result *ret_struct);
+
+void smc_rtt_shared(unsigned long op,
+		    unsigned long rtt_addr,
+		    unsigned long arg2,
+		    unsigned long arg3,
+		    unsigned long arg4,
+		    struct smc_result *ret_struct);
+
+void smc_data_export(unsigned long rd_addr,
+		     unsigned long map_addr,
+		     unsigned long ns_addr,
+		     struct smc_result *ret_struct);
+
+unsigned long smc_data_import(unsigned long data_addr,
+			      unsigned long rd_addr,
+			      unsigned long map_addr,
+			      unsigned long tag_lo,
+			      unsigned long tag_hi);
 
 
 #endif /* SMC_HANDLER_H */
@@ -0,0 +1,35 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef SPE_H
+#define SPE_H
+
+struct rec;
+struct rmi_rec_exit;
+
+/*
+ * When RMM is built with RMM_SPE, the SPE state is switched on every REC
+ * entry and exit. A Realm created with SPE_EN programs the sampling controls
+ * directly, while its accesses to the Profiling Buffer registers are trapped
+ * so that the buffer is only enabled over Protected IPA space. The other
+ * Realms run with profiling disabled.
+ */
+
+/* Save the SPE state of the NS world and load the one of @rec */
+void spe_enter_realm(struct rec *rec);
+
+/*
+ * Save the SPE state of @rec, report in @rec_exit whether its profiling
+ * buffer interrupt is asserted, and restore the SPE state of the NS world.
+ */
+void spe_exit_realm(struct rec *rec, struct rmi_rec_exit *rec_exit);
+
+/*
+ * Emulate the trapped access of the Realm to a Profiling Buffer register
+ * described by @esr.
+ */
+void spe_emulate_buffer_access(struct rec *rec, unsigned long esr);
+
+#endif /* SPE_H */
@@ -0,0 +1,31 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef STACK_PROFILE_H
+#define STACK_PROFILE_H
+
+#include <stdbool.h>
+
+/*
+ * Paint the part of the stack of the current CPU below the caller with a
+ * known pattern, before the handling of an RMI or RSI call. The calls can
+ * be nested, as RSI calls are handled within RMI_REC_ENTER.
+ */
+void stack_profile_begin(void);
+
+/*
+ * Find how deep the stack has been used since the matching
+ * stack_profile_begin() and record it for the RMI or RSI call @fid.
+ */
+void stack_profile_end(unsigned long fid);
+
+/*
+ * Deepest use of its stack by @cpu, in bytes, while handling the RMI or RSI
+ * call @fid. Returns false if @fid or @cpu is invalid.
+ */
+bool stack_profile_read(unsigned long fid, unsigned long cpu,
+			unsigned long *depth);
+
+#endif /* STACK_PROFILE_H */
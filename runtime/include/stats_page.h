@@ -0,0 +1,23 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef STATS_PAGE_H
+#define STATS_PAGE_H
+
+/*
+ * Register the NS granule at @ns_addr as the statistics page of the Host,
+ * written every @interval_us microseconds at most, or stop writing it if
+ * @ns_addr is 0. Returns an RMI status code.
+ */
+unsigned long stats_page_register(unsigned long ns_addr,
+				  unsigned long interval_us);
+
+/*
+ * Write the statistics page at the end of an RMI call, if one is registered
+ * and its interval has passed since it was last written.
+ */
+void stats_page_update(void);
+
+#endif /* STATS_PAGE_H */
@@ -11,5 +11,8 @@ struct rmi_rec_exit;
 
 bool handle_sysreg_access_trap(struct rec *rec, struct rmi_rec_exit *rec_exit,
 			       unsigned long esr);
+void handle_id_sysreg_trap(struct rec *rec, unsigned long esr);
+void realm_id_regs_init(unsigned long *id_regs,
+			bool pmu_enabled, bool spe_enabled);
 
 #endif /* SYSREGS_H */
@@ -0,0 +1,193 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <utils_def.h>
+
+/*
+ * Binary trace of the RMI and RSI calls.
+ *
+ * When RMM_TRACE is enabled, each CPU appends a fixed size record to its own
+ * ring for every call it handles, instead of formatting the call on the
+ * console. The Host retrieves a copy of the ring of a CPU with RMI_TRACE_DUMP
+ * and decodes it offline with tools/trace/decode_trace.py. The layout below
+ * is therefore part of the interface with that tool, and TRACE_VERSION must
+ * be updated whenever it changes.
+ */
+
+/* "RMTR" */
+#define TRACE_MAGIC		U(0x52544d52)
+#define TRACE_VERSION		U(1)
+
+/* The record is for an RSI call, otherwise for an RMI call */
+#define TRACE_FLAG_RSI		(U(1) << 0)
+/* An RSI call returned to the REC, so res[0] holds its result */
+#define TRACE_FLAG_EXIT_TO_REC	(U(1) << 1)
+
+struct trace_record {
+	/* CNTPCT_EL0 when the call completed */
+	unsigned long timestamp;
+	/* Function ID of the call */
+	unsigned int fid;
+	/* TRACE_FLAG_* */
+	unsigned int flags;
+	/* First five arguments of the call */
+	unsigned long args[5];
+	/* First two result registers */
+	unsigned long res[2];
+};
+COMPILER_ASSERT(sizeof(struct trace_record) == 72U);
+
+/* Size of the header of struct trace_buffer */
+#define TRACE_HEADER_SIZE	16U
+
+/* Number of records kept per CPU, so that the ring fits in one granule */
+#define TRACE_ENTRIES		((GRANULE_SIZE - TRACE_HEADER_SIZE) / \
+				 sizeof(struct trace_record))
+
+struct trace_buffer {
+	unsigned int magic;
+	unsigned int version;
+	/*
+	 * Number of records written since boot. The most recent record is
+	 * at index (head - 1) % TRACE_ENTRIES.
+	 */
+	unsigned long head;
+	struct trace_record records[TRACE_ENTRIES];
+};
+COMPILER_ASSERT(__builtin_offsetof(struct trace_buffer, records) ==
+		TRACE_HEADER_SIZE);
+COMPILER_ASSERT(sizeof(struct trace_buffer) <= GRANULE_SIZE);
+
+#ifdef RMM_TRACE
+/*
+ * Append a record for the call @fid to the trace of the current CPU.
+ * Only the current CPU writes to its ring, so no lock is needed.
+ */
+void trace_call(unsigned int fid, unsigned int flags, unsigned long args[5],
+		unsigned long res0, unsigned long res1);
+#endif /* RMM_TRACE */
+
+/*
+ * Trace of the REC entries.
+ *
+ * When RMM_REC_EXIT_TRACE is enabled, each CPU appends a record to its own
+ * ring for every RMI_REC_ENTER which runs the Realm, with the CNTPCT_EL0
+ * values at the four steps of the world switches. The Host retrieves a copy
+ * of the ring of a CPU with RMI_REC_EXIT_TRACE_DUMP and builds latency
+ * histograms from it with tools/trace/rec_exit_hist.py, which must be
+ * updated along with REC_EXIT_TRACE_VERSION whenever the layout changes.
+ */
+
+/* "RMXT" */
+#define REC_EXIT_TRACE_MAGIC	U(0x54584d52)
+#define REC_EXIT_TRACE_VERSION	U(1)
+
+struct rec_exit_trace_record {
+	/* CNTPCT_EL0 on entry to RMI_REC_ENTER */
+	unsigned long rmi_entry;
+	/* CNTPCT_EL0 before the first entry into the Realm */
+	unsigned long realm_entry;
+	/* CNTPCT_EL0 after the last exit from the Realm */
+	unsigned long realm_exit;
+	/* CNTPCT_EL0 on return from RMI_REC_ENTER */
+	unsigned long rmi_return;
+	/* ESR_EL2 after the last exit from the Realm */
+	unsigned long esr;
+	/* RMI_EXIT_* reason returned to the Host */
+	unsigned int exit_reason;
+	/* Number of exits from the Realm, including the last one */
+	unsigned int nr_exits;
+};
+COMPILER_ASSERT(sizeof(struct rec_exit_trace_record) == 48U);
+
+/* Number of records kept per CPU, so that the ring fits in one granule */
+#define REC_EXIT_TRACE_ENTRIES	((GRANULE_SIZE - TRACE_HEADER_SIZE) / \
+				 sizeof(struct rec_exit_trace_record))
+
+struct rec_exit_trace_buffer {
+	unsigned int magic;
+	unsigned int version;
+	/*
+	 * Number of records written since boot. The most recent record is
+	 * at index (head - 1) % REC_EXIT_TRACE_ENTRIES.
+	 */
+	unsigned long head;
+	struct rec_exit_trace_record records[REC_EXIT_TRACE_ENTRIES];
+};
+COMPILER_ASSERT(__builtin_offsetof(struct rec_exit_trace_buffer, records) ==
+		TRACE_HEADER_SIZE);
+COMPILER_ASSERT(sizeof(struct rec_exit_trace_buffer) <= GRANULE_SIZE);
+
+#ifdef RMM_REC_EXIT_TRACE
+/*
+ * Start the record of an RMI_REC_ENTER on the current CPU. The record is
+ * only added to the ring by rec_exit_trace_end(), if the Realm was entered.
+ */
+void rec_exit_trace_begin(void);
+
+/* Called before and after each run of the Realm by rec_run_loop() */
+void rec_exit_trace_realm_entry(void);
+void rec_exit_trace_realm_exit(unsigned long esr);
+
+/* End the record started by rec_exit_trace_begin() */
+void rec_exit_trace_end(unsigned long exit_reason);
+#endif /* RMM_REC_EXIT_TRACE */
+
+/*
+ * Samples of the PC of RMM.
+ *
+ * When RMM_PC_SAMPLE is enabled, each CPU appends a record to its own ring
+ * every RMM_PC_SAMPLE_PERIOD CPU cycles spent at Realm EL2 (see pc_sample.h).
+ * The Host retrieves a copy of the ring of a CPU with RMI_TRACE_DUMP and
+ * RMI_TRACE_DUMP_PC_SAMPLES, and tools/trace/pc_sample_fold.py symbolises
+ * the PCs against the RMM ELF. PC_SAMPLE_VERSION must be updated along with
+ * that tool whenever the layout changes.
+ */
+
+/* "RMPS" */
+#define PC_SAMPLE_MAGIC		U(0x53504d52)
+#define PC_SAMPLE_VERSION	U(1)
+
+/* @ctx is an RMI_REC_STATS_EXIT_* cause, otherwise the FID of an RMI call */
+#define PC_SAMPLE_FLAG_REC_EXIT	(U(1) << 0)
+/*
+ * The period elapsed while the interrupts were masked, and the sample was
+ * taken at the end of the RMI call or of the Realm exit handler. @pc is 0.
+ */
+#define PC_SAMPLE_FLAG_POLLED	(U(1) << 1)
+
+struct pc_sample_record {
+	/* ELR_EL2 when the overflow interrupt was taken */
+	unsigned long pc;
+	/* Context of the sample, as per PC_SAMPLE_FLAG_REC_EXIT */
+	unsigned int ctx;
+	/* PC_SAMPLE_FLAG_* */
+	unsigned int flags;
+};
+COMPILER_ASSERT(sizeof(struct pc_sample_record) == 16U);
+
+/* Number of records kept per CPU, so that the ring fits in one granule */
+#define PC_SAMPLE_ENTRIES	((GRANULE_SIZE - TRACE_HEADER_SIZE) / \
+				 sizeof(struct pc_sample_record))
+
+struct pc_sample_buffer {
+	unsigned int magic;
+	unsigned int version;
+	/*
+	 * Number of records written since boot. The most recent record is
+	 * at index (head - 1) % PC_SAMPLE_ENTRIES.
+	 */
+	unsigned long head;
+	struct pc_sample_record records[PC_SAMPLE_ENTRIES];
+};
+COMPILER_ASSERT(__builtin_offsetof(struct pc_sample_buffer, records) ==
+		TRACE_HEADER_SIZE);
+COMPILER_ASSERT(sizeof(struct pc_sample_buffer) <= GRANULE_SIZE);
+
+#endif /* TRACE_H */
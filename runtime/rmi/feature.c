@@ -6,6 +6,7 @@
 #include <arch_features.h>
 #include <assert.h>
 #include <feature.h>
+#include <pmu_profile.h>
 #include <smc-handler.h>
 #include <smc-rmi.h>
 #include <status.h>
@@ -21,10 +22,67 @@ static unsigned long get_feature_register_0(void)
 		feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_LPA2, RMI_LPA2);
 	}
 
+	/* Set support for PMU and the number of event counters */
+	if (is_feat_pmuv3_present()) {
+		unsigned long num_ctrs = EXTRACT(PMCR_EL0_N, read_pmcr_el0());
+
+#ifdef RMM_PMU_PROFILE
+		/* The last event counters are used to profile RMM */
+		if (num_ctrs > PMU_PROFILE_NUM_CTRS) {
+			num_ctrs -= PMU_PROFILE_NUM_CTRS;
+		}
+#endif
+#ifdef RMM_PC_SAMPLE
+		/* The last event counter is used to sample the PC of RMM */
+		if (num_ctrs > 1UL) {
+			num_ctrs -= 1UL;
+		}
+#endif
+		feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_PMU_EN, 1);
+		feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_PMU_NUM_CTRS,
+				     num_ctrs);
+	}
+
+	/* Set support for SPE */
+	if (HAS_SPE && is_feat_spe_present()) {
+		feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_SPE_EN, 1);
+	}
+
+	/* Set support for access and dirty tracking of the Realm stage 2 */
+	if (is_feat_hafdbs_present()) {
+		feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_HAFDBS_EN, 1);
+	}
+
+	/* Set support for dirty tracking by write-protection */
+	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_WP_DIRTY_EN, 1);
+
 	/* Set support for SHA256 and SHA512 hash algorithms */
 	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_HASH_SHA_256, 1);
 	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_HASH_SHA_512, 1);
 
+	/* Set support for automatic RTT folding */
+	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_AUTO_FOLD, 1);
+
+	/* Set support for RIPAS changes to EMPTY applied by RMM */
+	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_AUTO_RIPAS_EMPTY, 1);
+
+	/* Set support for REC_ENTRY_FLAG_NS_EL1_DEAD */
+	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_NS_EL1_DEAD, 1);
+
+	/* Set support for the starting level chosen by RMM */
+	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_AUTO_SL, 1);
+
+	/* Set support for Realms whose WFI and WFE are never trapped */
+	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_WFX_NOTRAP, 1);
+
+	/* Set support for RMI_DATA_EXPORT and RMI_DATA_IMPORT */
+	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN, 1);
+
+#ifdef RMM_SMCCC_EXT_REGS
+	/* Set support for the SMCCC v1.2 extended registers */
+	feat_reg0 |= INPLACE(RMM_FEATURE_REGISTER_0_EXT_REGS, 1);
+#endif
+
 	return feat_reg0;
 }
 
@@ -58,6 +116,41 @@ static bool validate_feature_register_0(unsigned long value)
 		return false;
 	}
 
+	/*
+	 * Validate PMU_EN flag and the number of event counters. MDCR_EL2.HPMN
+	 * is set to the number of counters while the Realm owns the PMU, and
+	 * it must not be 0 without FEAT_HPMN0.
+	 */
+	if (EXTRACT(RMM_FEATURE_REGISTER_0_PMU_EN, value) != 0UL) {
+		unsigned long num_ctrs = EXTRACT(RMM_FEATURE_REGISTER_0_PMU_NUM_CTRS,
+						 value);
+
+		if ((EXTRACT(RMM_FEATURE_REGISTER_0_PMU_EN, feat_reg0) == 0UL) ||
+		    (num_ctrs == 0UL) ||
+		    (num_ctrs > EXTRACT(RMM_FEATURE_REGISTER_0_PMU_NUM_CTRS,
+					feat_reg0))) {
+			return false;
+		}
+	}
+
+	/* Validate SPE_EN flag */
+	if ((EXTRACT(RMM_FEATURE_REGISTER_0_SPE_EN, value) != 0UL) &&
+	    (EXTRACT(RMM_FEATURE_REGISTER_0_SPE_EN, feat_reg0) == 0UL)) {
+		return false;
+	}
+
+	/* Validate HAFDBS_EN flag */
+	if ((EXTRACT(RMM_FEATURE_REGISTER_0_HAFDBS_EN, value) != 0UL) &&
+	    (EXTRACT(RMM_FEATURE_REGISTER_0_HAFDBS_EN, feat_reg0) == 0UL)) {
+		return false;
+	}
+
+	/* The dirty state is tracked either by the PE or by RMM */
+	if ((EXTRACT(RMM_FEATURE_REGISTER_0_WP_DIRTY_EN, value) != 0UL) &&
+	    (EXTRACT(RMM_FEATURE_REGISTER_0_HAFDBS_EN, value) != 0UL)) {
+		return false;
+	}
+
 	return true;
 }
 
@@ -71,3 +164,29 @@ bool validate_feature_register(unsigned long index, unsigned long value)
 		return false;
 	}
 }
+
+/*
+ * Check the MPAM PARTID and PMG @value passed by the Host for a Realm or a
+ * REC, in the format of MPAM1_EL1. Only the default partition, 0, can be
+ * used when RMM is built without RMM_MPAM.
+ */
+bool validate_mpam_value(unsigned long value)
+{
+#if HAS_MPAM
+	unsigned long mpamidr = read_mpamidr_el1();
+	unsigned long partid_max = EXTRACT(MPAMIDR_EL1_PARTID_MAX, mpamidr);
+	unsigned long pmg_max = EXTRACT(MPAMIDR_EL1_PMG_MAX, mpamidr);
+	unsigned long fields = MASK(MPAM_EL1_PARTID_I) |
+			       MASK(MPAM_EL1_PARTID_D) |
+			       MASK(MPAM_EL1_PMG_I) |
+			       MASK(MPAM_EL1_PMG_D);
+
+	return ((value & ~fields) == 0UL) &&
+		(EXTRACT(MPAM_EL1_PARTID_I, value) <= partid_max) &&
+		(EXTRACT(MPAM_EL1_PARTID_D, value) <= partid_max) &&
+		(EXTRACT(MPAM_EL1_PMG_I, value) <= pmg_max) &&
+		(EXTRACT(MPAM_EL1_PMG_D, value) <= pmg_max);
+#else
+	return (value == 0UL);
+#endif
+}
@@ -5,9 +5,12 @@
 
 #include <asc.h>
 #include <granule.h>
+#include <sizes.h>
 #include <smc-handler.h>
 #include <smc-rmi.h>
 #include <smc.h>
+#include <string.h>
+#include <utils_def.h>
 
 unsigned long smc_granule_delegate(unsigned long addr)
 {
@@ -20,7 +23,7 @@ unsigned long smc_granule_delegate(unsigned long addr)
 
 	granule_set_state(g, GRANULE_STATE_DELEGATED);
 	asc_mark_secure(addr);
-	granule_memzero(g, SLOT_DELEGATED);
+	granule_set_needs_scrub(g);
 
 	granule_unlock(g);
 	return RMI_SUCCESS;
@@ -35,9 +38,294 @@ unsigned long smc_granule_undelegate(unsigned long addr)
 		return RMI_ERROR_INPUT;
 	}
 
+	/* Zero the granule if no user has since scrubbed it */
+	granule_scrub(g, SLOT_DELEGATED);
 	asc_mark_nonsecure(addr);
 	granule_set_state(g, GRANULE_STATE_NS);
 
 	granule_unlock(g);
 	return RMI_SUCCESS;
 }
+
+/*
+ * Transition up to RMI_GRANULE_RANGE_MAX_COUNT granules starting at @base
+ * from @from_state, stopping at the first granule which is not in
+ * @from_state.
+ *
+ * The granules are locked in ascending address order, as required by the
+ * locking rules, and their PAS is changed with a single call to EL3.
+ *
+ * On return, ret->x[1] holds the number of granules transitioned. The Host
+ * can resume the operation from @base + (ret->x[1] * GRANULE_SIZE).
+ * ret->x[0] is RMI_SUCCESS if all the granules of the current batch were
+ * transitioned, and RMI_ERROR_INPUT otherwise, in which case the granule at
+ * which the operation stopped is the one in the unexpected state.
+ *
+ * If @preloaded is true, the delegated granules are marked as holding
+ * content loaded by the Host, see granule_set_preloaded().
+ */
+static void granule_range_transition(unsigned long base, unsigned long count,
+				     enum granule_state from_state,
+				     bool preloaded,
+				     struct smc_result *ret)
+{
+	struct granule *g_base, *g;
+	unsigned long i, nr_locked;
+
+	ret->x[1] = 0UL;
+
+	if (count > RMI_GRANULE_RANGE_MAX_COUNT) {
+		count = RMI_GRANULE_RANGE_MAX_COUNT;
+	}
+
+	g_base = find_granule_range(base, count);
+	if (g_base == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	for (nr_locked = 0UL, g = g_base; nr_locked < count; nr_locked++, g++) {
+		if (!granule_lock_on_state_match(g, from_state)) {
+			break;
+		}
+	}
+
+	if (from_state == GRANULE_STATE_NS) {
+		asc_mark_secure_range(base, nr_locked);
+		for (i = 0UL, g = g_base; i < nr_locked; i++, g++) {
+			granule_set_state(g, GRANULE_STATE_DELEGATED);
+			if (preloaded) {
+				granule_set_preloaded(g);
+			} else {
+				granule_set_needs_scrub(g);
+			}
+			granule_unlock(g);
+		}
+	} else {
+		for (i = 0UL, g = g_base; i < nr_locked; i++, g++) {
+			granule_scrub(g, SLOT_DELEGATED);
+		}
+		asc_mark_nonsecure_range(base, nr_locked);
+		for (i = 0UL, g = g_base; i < nr_locked; i++, g++) {
+			granule_unlock_transition(g, GRANULE_STATE_NS);
+		}
+	}
+
+	ret->x[0] = (nr_locked == count) ? RMI_SUCCESS : RMI_ERROR_INPUT;
+	ret->x[1] = nr_locked;
+}
+
+void smc_granule_delegate_range(unsigned long base,
+				unsigned long count,
+				struct smc_result *ret)
+{
+	granule_range_transition(base, count, GRANULE_STATE_NS, false, ret);
+}
+
+void smc_granule_undelegate_range(unsigned long base,
+				  unsigned long count,
+				  struct smc_result *ret)
+{
+	granule_range_transition(base, count, GRANULE_STATE_DELEGATED, false,
+				 ret);
+}
+
+/*
+ * Implements RMI_GRANULE_DELEGATE_PRESERVE_RANGE.
+ *
+ * Same as RMI_GRANULE_DELEGATE_RANGE, except that the content of the
+ * granules is kept, for Data.Create to measure it in place. The content is
+ * only hashed once the granules are DELEGATED, so the Host cannot change it
+ * after its measurement.
+ */
+void smc_granule_delegate_preserve_range(unsigned long base,
+					 unsigned long count,
+					 struct smc_result *ret)
+{
+	granule_range_transition(base, count, GRANULE_STATE_NS, true, ret);
+}
+
+/*
+ * Delegate the args[0] granules at the addresses of args[1] onwards in turn,
+ * stopping at the first one which cannot be delegated. The addresses are
+ * passed in X2-X17, so that a small batch of scattered granules is delegated
+ * without the Host writing their addresses to an NS granule.
+ *
+ * On return, ret->x[1] holds the number of granules delegated.
+ */
+void smc_granule_delegate_multi(const unsigned long *args,
+				union smc_regs *ret)
+{
+#ifdef RMM_SMCCC_EXT_REGS
+	unsigned long count = args[0];
+	unsigned long i;
+
+	if ((count == 0UL) || (count > RMI_GRANULE_DELEGATE_MULTI_MAX)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		ret->x[1] = 0UL;
+		return;
+	}
+
+	ret->x[0] = RMI_SUCCESS;
+	for (i = 0UL; i < count; i++) {
+		ret->x[0] = smc_granule_delegate(args[i + 1UL]);
+		if (ret->x[0] != RMI_SUCCESS) {
+			break;
+		}
+	}
+	ret->x[1] = i;
+#else
+	(void)args;
+
+	/* EL3 does not forward X8-X17 of the RMI calls to this build */
+	ret->x[0] = RMI_ERROR_INPUT;
+	ret->x[1] = 0UL;
+#endif /* RMM_SMCCC_EXT_REGS */
+}
+
+void smc_granule_stats(unsigned long from,
+		       unsigned long to,
+		       unsigned long cpu,
+		       struct smc_result *ret)
+{
+#ifdef RMM_GRANULE_STATS
+	ret->x[1] = 0UL;
+
+	if ((from >= RMI_GRANULE_STATE_NR) || (to >= RMI_GRANULE_STATE_NR)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	if (from == to) {
+		/* Only the granules which have been delegated are counted */
+		if (from == RMI_GRANULE_STATE_NS) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+
+		ret->x[1] = (unsigned long)granule_stats_count(
+						(enum granule_state)from);
+	} else {
+		if (cpu >= MAX_CPUS) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+
+		ret->x[1] = granule_stats_transitions((unsigned int)cpu,
+						(enum granule_state)from,
+						(enum granule_state)to);
+	}
+
+	ret->x[0] = RMI_SUCCESS;
+#else
+	(void)from;
+	(void)to;
+	(void)cpu;
+
+	/* The statistics are not collected by this build */
+	ret->x[0] = RMI_ERROR_INPUT;
+	ret->x[1] = 0UL;
+#endif /* RMM_GRANULE_STATS */
+}
+
+/* Number of granule states packed in a word by RMI_GRANULE_STATE_QUERY */
+#define STATES_PER_UL	(BITS_PER_UL / RMI_GRANULE_STATE_QUERY_BITS)
+
+/* Number of words of states written to the NS granule at once */
+#define STATE_QUERY_CHUNK	64U
+#define STATE_QUERY_CHUNK_GRANULES	(STATES_PER_UL * STATE_QUERY_CHUNK)
+
+COMPILER_ASSERT(RMI_GRANULE_STATE_NR <= (1UL << RMI_GRANULE_STATE_QUERY_BITS));
+COMPILER_ASSERT((RMI_GRANULE_STATE_QUERY_MAX %
+		 STATE_QUERY_CHUNK_GRANULES) == 0UL);
+
+/*
+ * Implements RMI_GRANULE_STATE_QUERY.
+ *
+ * The states are read without the granule locks, so that the Host can
+ * rebuild its view of a large range of memory without contending with the
+ * other CPUs and without an RMI call per granule.
+ */
+void smc_granule_state_query(unsigned long base,
+			     unsigned long count,
+			     unsigned long ns_addr,
+			     struct smc_result *ret)
+{
+	unsigned long states[STATE_QUERY_CHUNK];
+	struct granule *g_ns, *g;
+	unsigned int offset = 0U;
+	/* Granules left in the uniform block being reported, if any */
+	unsigned long block_left = 0UL;
+	enum granule_state block_state = GRANULE_STATE_NS;
+
+	ret->x[1] = 0UL;
+
+	if (count > RMI_GRANULE_STATE_QUERY_MAX) {
+		count = RMI_GRANULE_STATE_QUERY_MAX;
+	}
+
+	g_ns = find_granule(ns_addr);
+	if ((count == 0UL) || (g_ns == NULL) ||
+	    (granule_unlocked_state(g_ns) != GRANULE_STATE_NS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g = find_granule_range(base, count);
+	if (g == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	for (unsigned long i = 0UL; i < count;
+	     i += STATE_QUERY_CHUNK_GRANULES) {
+		unsigned long n = count - i;
+
+		if (n > STATE_QUERY_CHUNK_GRANULES) {
+			n = STATE_QUERY_CHUNK_GRANULES;
+		}
+
+		(void)memset(states, 0, sizeof(states));
+
+		for (unsigned long j = 0UL; j < n; j++) {
+			enum granule_state state;
+			unsigned int shift = (unsigned int)(j % STATES_PER_UL) *
+					     RMI_GRANULE_STATE_QUERY_BITS;
+
+#ifdef RMM_GRANULE_SUMMARY
+			unsigned long addr = base + ((i + j) * GRANULE_SIZE);
+
+			/*
+			 * The granules of a block found uniform in the summary
+			 * are reported without being looked at.
+			 */
+			if ((block_left == 0UL) &&
+			    ALIGNED(addr, GRANULE_SUMMARY_BLOCK_SIZE) &&
+			    ((count - (i + j)) >=
+			     GRANULE_SUMMARY_BLOCK_GRANULES) &&
+			    granule_block_state(addr, &block_state)) {
+				block_left = GRANULE_SUMMARY_BLOCK_GRANULES;
+			}
+#endif
+			if (block_left != 0UL) {
+				state = block_state;
+				block_left--;
+			} else {
+				state = granule_unlocked_state(&g[i + j]);
+			}
+
+			states[j / STATES_PER_UL] |=
+					(unsigned long)state << shift;
+		}
+
+		if (!ns_buffer_write(SLOT_NS, g_ns, offset,
+				     (unsigned int)sizeof(states), states)) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+		offset += (unsigned int)sizeof(states);
+	}
+
+	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = count;
+}
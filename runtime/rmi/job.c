@@ -0,0 +1,241 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <assert.h>
+#include <granule.h>
+#include <job.h>
+#include <memory.h>
+#include <smc-handler.h>
+#include <smc-rmi.h>
+#include <smc.h>
+#include <spinlock.h>
+#include <utils_def.h>
+
+/*
+ * Maximum number of granules freed or scrubbed by a step of a job, so that
+ * a step only adds a bounded latency to the RMI call which runs it.
+ */
+#define JOB_STEP_GRANULES	64UL
+
+enum job_state {
+	JOB_FREE,
+	JOB_QUEUED,
+	/* A CPU runs a step of the job */
+	JOB_RUNNING,
+	JOB_DONE
+};
+
+struct rmi_job {
+	enum job_state state;
+	unsigned long type;
+	unsigned long arg1;
+	unsigned long arg2;
+	/* Granules processed so far, the result of the job once done */
+	unsigned long count;
+	/* RMI status of the job once done */
+	unsigned long status;
+};
+
+static struct rmi_job jobs[RMI_JOB_QUEUE_LEN];
+static spinlock_t jobs_lock;
+
+/* Number of jobs JOB_QUEUED, read without the lock by rmi_jobs_run() */
+static unsigned long nr_queued_jobs __hot_bss;
+
+/* Next job looked at by rmi_jobs_run(), so that the jobs take turns */
+static unsigned int next_job;
+
+/*
+ * Zero the delegated granules of the range of @job which still need it, so
+ * that their undelegation or their use as a Realm object does not.
+ */
+static bool job_scrub_step(struct rmi_job *job)
+{
+	struct granule *g = find_granule(job->arg1) + job->count;
+	unsigned long end = job->count + JOB_STEP_GRANULES;
+
+	if (end > job->arg2) {
+		end = job->arg2;
+	}
+
+	for (; job->count < end; job->count++, g++) {
+		if (!granule_trylock_on_state_match(g,
+					GRANULE_STATE_DELEGATED)) {
+			continue;
+		}
+
+		granule_scrub(g, SLOT_DELEGATED);
+		granule_unlock(g);
+	}
+
+	return (job->count == job->arg2);
+}
+
+/* Run a step of @job, returns true if the job is done */
+static bool job_run_step(struct rmi_job *job)
+{
+	struct rmi_budget budget;
+	bool done = true;
+
+	switch (job->type) {
+	case RMI_JOB_REALM_TEARDOWN:
+		rmi_budget_start(&budget);
+		job->status = realm_teardown_step(job->arg1, job->arg2,
+						  JOB_STEP_GRANULES, &budget,
+						  &job->count, &done);
+		if (job->status != RMI_SUCCESS) {
+			done = true;
+		}
+		break;
+	case RMI_JOB_GRANULE_SCRUB:
+		job->status = RMI_SUCCESS;
+		done = job_scrub_step(job);
+		break;
+	default:
+		assert(false);
+	}
+
+	return done;
+}
+
+void rmi_jobs_run(void)
+{
+	struct rmi_job *job = NULL;
+	bool done;
+
+	if (SCA_READ64(&nr_queued_jobs) == 0UL) {
+		return;
+	}
+
+	spinlock_acquire(&jobs_lock);
+	for (unsigned int i = 0U; i < RMI_JOB_QUEUE_LEN; i++) {
+		unsigned int idx = (next_job + i) % RMI_JOB_QUEUE_LEN;
+
+		if (jobs[idx].state == JOB_QUEUED) {
+			job = &jobs[idx];
+			job->state = JOB_RUNNING;
+			next_job = idx + 1U;
+			SCA_WRITE64(&nr_queued_jobs, nr_queued_jobs - 1UL);
+			break;
+		}
+	}
+	spinlock_release(&jobs_lock);
+
+	if (job == NULL) {
+		return;
+	}
+
+	/* The job is RUNNING, so no other CPU looks at it meanwhile */
+	done = job_run_step(job);
+
+	spinlock_acquire(&jobs_lock);
+	if (done) {
+		job->state = JOB_DONE;
+	} else {
+		job->state = JOB_QUEUED;
+		SCA_WRITE64(&nr_queued_jobs, nr_queued_jobs + 1UL);
+	}
+	spinlock_release(&jobs_lock);
+}
+
+/*
+ * Implements RMI_JOB_SUBMIT.
+ *
+ * Queue a job which is run in the background, one bounded step at the end
+ * of each RMI call made on any CPU, so that the Host does not block on it.
+ * The parameters are checked when the job is submitted, but the objects
+ * they refer to are only looked up by each step.
+ */
+void smc_job_submit(unsigned long type,
+		    unsigned long arg1,
+		    unsigned long arg2,
+		    struct smc_result *ret)
+{
+	unsigned int idx;
+
+	switch (type) {
+	case RMI_JOB_REALM_TEARDOWN:
+		if (!GRANULE_ALIGNED(arg1) || !GRANULE_ALIGNED(arg2)) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+		break;
+	case RMI_JOB_GRANULE_SCRUB:
+		if ((arg2 == 0UL) || (find_granule_range(arg1, arg2) == NULL)) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+		break;
+	default:
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	spinlock_acquire(&jobs_lock);
+	for (idx = 0U; idx < RMI_JOB_QUEUE_LEN; idx++) {
+		if (jobs[idx].state == JOB_FREE) {
+			break;
+		}
+	}
+
+	if (idx == RMI_JOB_QUEUE_LEN) {
+		spinlock_release(&jobs_lock);
+		ret->x[0] = RMI_ERROR_IN_USE;
+		return;
+	}
+
+	jobs[idx] = (struct rmi_job) {
+		.state = JOB_QUEUED,
+		.type = type,
+		.arg1 = arg1,
+		.arg2 = arg2
+	};
+	SCA_WRITE64(&nr_queued_jobs, nr_queued_jobs + 1UL);
+	spinlock_release(&jobs_lock);
+
+	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = idx;
+}
+
+/*
+ * Implements RMI_JOB_POLL.
+ *
+ * A job which is done is freed once its result has been returned.
+ */
+void smc_job_poll(unsigned long id, struct smc_result *ret)
+{
+	struct rmi_job *job;
+
+	if (id >= RMI_JOB_QUEUE_LEN) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	job = &jobs[id];
+
+	spinlock_acquire(&jobs_lock);
+	switch (job->state) {
+	case JOB_FREE:
+		ret->x[0] = RMI_ERROR_INPUT;
+		break;
+	case JOB_QUEUED:
+	case JOB_RUNNING:
+		ret->x[0] = RMI_SUCCESS;
+		ret->x[1] = RMI_JOB_PENDING;
+		ret->x[2] = 0UL;
+		ret->x[3] = job->count;
+		break;
+	case JOB_DONE:
+		ret->x[0] = RMI_SUCCESS;
+		ret->x[1] = RMI_JOB_DONE;
+		ret->x[2] = job->status;
+		ret->x[3] = job->count;
+		job->state = JOB_FREE;
+		break;
+	default:
+		assert(false);
+	}
+	spinlock_release(&jobs_lock);
+}
@@ -4,16 +4,21 @@
  */
 
 #include <assert.h>
+#include <attestation_token.h>
 #include <buffer.h>
+#include <debug.h>
 #include <feature.h>
 #include <granule.h>
+#include <limits.h>
 #include <measurement.h>
+#include <mecid.h>
 #include <realm.h>
 #include <smc-handler.h>
 #include <smc-rmi.h>
 #include <smc.h>
 #include <stddef.h>
 #include <string.h>
+#include <sysreg_traps.h>
 #include <table.h>
 #include <vmid.h>
 
@@ -30,7 +35,18 @@ unsigned long smc_realm_activate(unsigned long rd_addr)
 
 	rd = granule_map(g_rd, SLOT_RD);
 	if (get_rd_state_locked(rd) == REALM_STATE_NEW) {
+		struct q_useful_buf_c rpv = { &rd->rpv[0], RPV_SIZE };
+
+		/* The RIM and the other static claims are final from now on */
+		if (attest_realm_claims_create(rd->algorithm,
+				rd->measurement[RIM_MEASUREMENT_SLOT],
+				&rpv, &rd->attest_claims) != 0) {
+			ERROR("FATAL_ERROR: Realm claims encoding failed\n");
+			panic();
+		}
+
 		set_rd_state(rd, REALM_STATE_ACTIVE);
+		vmid_set_realm_active(rd->s2_ctx.vmid, true);
 		ret = RMI_SUCCESS;
 	} else {
 		ret = RMI_ERROR_REALM;
@@ -93,6 +109,7 @@ static bool validate_ipa_bits_and_sl(unsigned int ipa_bits, long sl)
 	 * We assume ARMv8.4-TTST is supported with RME so the only SL
 	 * configuration we need to check with 4K granules is SL == 0 following
 	 * the library pseudocode aarch64/translation/vmsa_faults/AArch64.S2InvalidSL.
+	 * With the 16K and 64K granules, SL == 0 is rejected above.
 	 *
 	 * Note that this only checks invalid SL values against the properties
 	 * of the hardware platform, other misconfigurations between IPA size
@@ -127,6 +144,30 @@ static unsigned int s2_num_root_rtts(unsigned int ipa_bits, int sl)
 	return (1U << (ipa_bits - sl_ipa_bits));
 }
 
+/*
+ * Return the starting level with the shallowest stage 2 walk for @ipa_bits
+ * which needs at most @max_rtts concatenated starting level RTTs, or a level
+ * below MIN_STARTING_LEVEL if there is none.
+ */
+static long auto_starting_level(unsigned int ipa_bits, unsigned int max_rtts)
+{
+	long sl;
+
+	for (sl = RTT_PAGE_LEVEL; sl >= MIN_STARTING_LEVEL; sl--) {
+		if (validate_ipa_bits_and_sl(ipa_bits, sl) &&
+		    (s2_num_root_rtts(ipa_bits, (int)sl) <= max_rtts)) {
+			break;
+		}
+	}
+
+	return sl;
+}
+
+/*
+ * Validate the Realm parameters @p. With RMM_FEATURE_REGISTER_0_AUTO_SL,
+ * the starting level and the number of starting level RTTs of @p are
+ * updated to the ones chosen by RMM.
+ */
 static bool validate_realm_params(struct rmi_realm_params *p)
 {
 	if (!validate_feature_register(RMM_FEATURE_REGISTER_0_INDEX,
@@ -134,6 +175,22 @@ static bool validate_realm_params(struct rmi_realm_params *p)
 		return false;
 	}
 
+	if (EXTRACT(RMM_FEATURE_REGISTER_0_AUTO_SL, p->features_0) != 0UL) {
+		/* Up to 16 RTTs can be concatenated at the starting level */
+		if ((p->rtt_num_start == 0U) || (p->rtt_num_start > 16U)) {
+			return false;
+		}
+
+		p->rtt_level_start = auto_starting_level(requested_ipa_bits(p),
+							 p->rtt_num_start);
+		if (p->rtt_level_start < MIN_STARTING_LEVEL) {
+			return false;
+		}
+
+		p->rtt_num_start = s2_num_root_rtts(requested_ipa_bits(p),
+						    (int)p->rtt_level_start);
+	}
+
 	if (!validate_ipa_bits_and_sl(requested_ipa_bits(p),
 					p->rtt_level_start)) {
 		return false;
@@ -159,6 +216,10 @@ static bool validate_realm_params(struct rmi_realm_params *p)
 		return false;
 	}
 
+	if (!validate_mpam_value(p->mpam)) {
+		return false;
+	}
+
 	/* Check VMID collision and reserve it atomically if available */
 	return vmid_reserve((unsigned int)p->vmid);
 }
@@ -252,20 +313,23 @@ out_err:
 	return false;
 }
 
-unsigned long smc_realm_create(unsigned long rd_addr,
-			       unsigned long realm_params_addr)
+void smc_realm_create(unsigned long rd_addr,
+		      unsigned long realm_params_addr,
+		      struct smc_result *res)
 {
 	struct granule *g_rd, *g_rtt_base;
 	struct rd *rd;
 	struct rmi_realm_params p;
 	unsigned int i;
 
+	res->x[0] = RMI_ERROR_INPUT;
+
 	if (!get_realm_params(&p, realm_params_addr)) {
-		return RMI_ERROR_INPUT;
+		return;
 	}
 
 	if (!validate_realm_params(&p)) {
-		return RMI_ERROR_INPUT;
+		return;
 	}
 
 	/*
@@ -280,32 +344,75 @@ unsigned long smc_realm_create(unsigned long rd_addr,
 
 		/* Free reserved VMID before returning */
 		vmid_free((unsigned int)p.vmid);
-		return RMI_ERROR_INPUT;
+		return;
 	}
 
 	if (!find_lock_rd_granules(rd_addr, &g_rd, p.rtt_base,
 				  p.rtt_num_start, &g_rtt_base)) {
 		/* Free reserved VMID */
 		vmid_free((unsigned int)p.vmid);
-		return RMI_ERROR_INPUT;
+		return;
+	}
+
+	/* The starting level RTTs are used as zeroed, unassigned tables */
+	for (i = 0U; i < p.rtt_num_start; i++) {
+		granule_scrub(g_rtt_base + i, SLOT_RTT);
 	}
 
 	rd = granule_map(g_rd, SLOT_RD);
+	granule_scrub_mapped(g_rd, rd);
 	set_rd_state(rd, REALM_STATE_NEW);
 	set_rd_rec_count(rd, 0UL);
 	rd->s2_ctx.g_rtt = find_granule(p.rtt_base);
 	rd->s2_ctx.ipa_bits = requested_ipa_bits(&p);
 	rd->s2_ctx.s2_starting_level = p.rtt_level_start;
 	rd->s2_ctx.num_root_rtts = p.rtt_num_start;
+	rd->s2_ctx.rtt_walker = rtt_walker_select(p.rtt_level_start,
+						  rd->s2_ctx.ipa_bits);
 	memcpy(&rd->rpv[0], &p.rpv[0], RPV_SIZE);
 
 	rd->s2_ctx.vmid = (unsigned int)p.vmid;
-
-	rd->num_rec_aux = MAX_REC_AUX_GRANULES;
+	rd->s2_ctx.mecid = mecid_alloc();
+
+	rd->num_rec_aux = REC_NUM_AUX_GRANULES;
+
+	rd->auto_fold = (EXTRACT(RMM_FEATURE_REGISTER_0_AUTO_FOLD,
+				 p.features_0) != 0UL);
+	rd->auto_ripas_empty = (EXTRACT(RMM_FEATURE_REGISTER_0_AUTO_RIPAS_EMPTY,
+					p.features_0) != 0UL);
+	rd->pmu_enabled = (EXTRACT(RMM_FEATURE_REGISTER_0_PMU_EN,
+				   p.features_0) != 0UL);
+	rd->pmu_num_ctrs = (unsigned int)EXTRACT(
+				RMM_FEATURE_REGISTER_0_PMU_NUM_CTRS,
+				p.features_0);
+	rd->spe_enabled = (EXTRACT(RMM_FEATURE_REGISTER_0_SPE_EN,
+				   p.features_0) != 0UL);
+	rd->hafdbs_enabled = (EXTRACT(RMM_FEATURE_REGISTER_0_HAFDBS_EN,
+				      p.features_0) != 0UL);
+	rd->wp_dirty_enabled = (EXTRACT(RMM_FEATURE_REGISTER_0_WP_DIRTY_EN,
+					p.features_0) != 0UL);
+	rd->wfx_notrap = (EXTRACT(RMM_FEATURE_REGISTER_0_WFX_NOTRAP,
+				  p.features_0) != 0UL);
+	rd->data_export_enabled = (EXTRACT(
+				RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN,
+				p.features_0) != 0UL);
+	realm_id_regs_init(rd->id_regs, rd->pmu_enabled, rd->spe_enabled);
+	rd->mpam = p.mpam;
+	rd->nr_reclaim_rtts = 0U;
+	rd->nr_skipped_folds = 0UL;
+	rd->nr_rtt_pool = 0U;
+	rd->nr_rtt_pool_used = 0U;
+	rd->nr_data_pool = 0U;
+	rd->nr_data_pool_used = 0U;
+	rd->export_key_valid = false;
+	rd->export_seq = 0UL;
+	rd->footprint[RMI_GRANULE_STATE_RD] = 1UL;
+	rd->footprint[RMI_GRANULE_STATE_RTT] = p.rtt_num_start;
 
 	(void)memcpy(&rd->rpv[0], &p.rpv[0], RPV_SIZE);
 
 	rd->algorithm = p.hash_algo;
+	rd->meas_gen = 1UL;
 
 	switch (p.hash_algo) {
 	case RMI_HASH_ALGO_SHA256:
@@ -325,7 +432,68 @@ unsigned long smc_realm_create(unsigned long rd_addr,
 		granule_unlock_transition(g_rtt_base + i, GRANULE_STATE_RTT);
 	}
 
-	return RMI_SUCCESS;
+	res->x[0] = RMI_SUCCESS;
+	res->x[1] = (unsigned long)p.rtt_level_start;
+	res->x[2] = p.rtt_num_start;
+}
+
+/*
+ * Implements RMI_VMID_FIND.
+ *
+ * Return in ret->x[1] a VMID not in use by any Realm, which the Host can
+ * pass to RMI_REALM_CREATE. The VMID is not reserved, so the creation may
+ * still fail if another Realm takes it first.
+ */
+void smc_vmid_find(unsigned long min_vmid, struct smc_result *res)
+{
+	unsigned int vmid;
+
+	if ((min_vmid > UINT_MAX) ||
+	    !vmid_find_free((unsigned int)min_vmid, &vmid)) {
+		res->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	res->x[0] = RMI_SUCCESS;
+	res->x[1] = vmid;
+}
+
+/*
+ * Implements RMI_REALM_FOOTPRINT.
+ *
+ * Return in ret->x[1] the number of granules of the Realm in @state. The
+ * count is read without taking the lock of the RD, so it can be stale by
+ * the commands in flight on other CPUs.
+ */
+void smc_realm_footprint(unsigned long rd_addr,
+			 unsigned long state,
+			 struct smc_result *res)
+{
+	struct granule *g_rd;
+	struct rd *rd;
+
+	if ((state != RMI_GRANULE_STATE_RD) &&
+	    (state != RMI_GRANULE_STATE_REC) &&
+	    (state != RMI_GRANULE_STATE_REC_AUX) &&
+	    (state != RMI_GRANULE_STATE_DATA) &&
+	    (state != RMI_GRANULE_STATE_RTT)) {
+		res->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		res->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+	res->x[1] = SCA_READ64(&rd->footprint[state]);
+	buffer_unmap(rd);
+
+	granule_unlock(g_rd);
+
+	res->x[0] = RMI_SUCCESS;
 }
 
 static unsigned long total_root_rtt_refcount(struct granule *g_rtt,
@@ -356,6 +524,10 @@ unsigned long smc_realm_destroy(unsigned long rd_addr)
 	struct granule *g_rtt;
 	struct rd *rd;
 	unsigned int num_rtts;
+	unsigned long rtt_pool[RTT_POOL_LEN];
+	unsigned int nr_rtt_pool;
+	unsigned long data_pool[DATA_POOL_LEN];
+	unsigned int nr_data_pool;
 
 	/* RD should not be destroyed if refcount != 0. */
 	g_rd = find_lock_unused_granule(rd_addr, GRANULE_STATE_RD);
@@ -366,6 +538,10 @@ unsigned long smc_realm_destroy(unsigned long rd_addr)
 	rd = granule_map(g_rd, SLOT_RD);
 	g_rtt = rd->s2_ctx.g_rtt;
 	num_rtts = rd->s2_ctx.num_root_rtts;
+	nr_rtt_pool = rd->nr_rtt_pool;
+	(void)memcpy(rtt_pool, rd->rtt_pool, sizeof(rtt_pool));
+	nr_data_pool = rd->nr_data_pool;
+	(void)memcpy(data_pool, rd->data_pool, sizeof(data_pool));
 
 	/*
 	 * All the mappings in the Realm have been removed and the TLB caches
@@ -384,6 +560,22 @@ unsigned long smc_realm_destroy(unsigned long rd_addr)
 
 	free_sl_rtts(g_rtt, num_rtts);
 
+	/* Return the unused granules of the RTT pool to the Host */
+	for (unsigned int i = 0U; i < nr_rtt_pool; i++) {
+		struct granule *g_pool = addr_to_granule(rtt_pool[i]);
+
+		granule_lock(g_pool, GRANULE_STATE_RTT);
+		granule_unlock_transition(g_pool, GRANULE_STATE_DELEGATED);
+	}
+
+	/* The unused granules of the DATA pool are still zeroed */
+	for (unsigned int i = 0U; i < nr_data_pool; i++) {
+		struct granule *g_pool = addr_to_granule(data_pool[i]);
+
+		granule_lock(g_pool, GRANULE_STATE_DATA);
+		granule_unlock_transition(g_pool, GRANULE_STATE_DELEGATED);
+	}
+
 	/* This implictly destroys the measurement */
 	granule_memzero(g_rd, SLOT_RD);
 	granule_unlock_transition(g_rd, GRANULE_STATE_DELEGATED);
@@ -5,16 +5,21 @@
 
 #include <arch.h>
 #include <arch_features.h>
+#include <asc.h>
 #include <attestation.h>
 #include <buffer.h>
 #include <cpuid.h>
+#include <feature.h>
 #include <gic.h>
 #include <granule.h>
 #include <mbedtls/memory_buffer_alloc.h>
 #include <measurement.h>
 #include <memory_alloc.h>
+#include <pauth.h>
+#include <percpu.h>
 #include <psci.h>
 #include <realm.h>
+#include <realm_attest.h>
 #include <rec.h>
 #include <smc-handler.h>
 #include <smc-rmi.h>
@@ -26,13 +31,18 @@
 /*
  * Allocate a dummy rec_params for copying relevant parameters for measurement
  */
-static struct rmi_rec_params rec_params_per_cpu[MAX_CPUS];
+static DEFINE_PER_CPU(struct rmi_rec_params, rec_params_copy);
 
-static void rec_params_measure(struct rd *rd, struct rmi_rec_params *rec_params)
+/*
+ * Extend the RIM of @rd with @rec_params, using the measurement context
+ * @mctx opened by the caller with the algorithm of the Realm.
+ */
+static void rec_params_measure(struct measurement_ctx *mctx, struct rd *rd,
+			       struct rmi_rec_params *rec_params)
 {
 	struct measurement_desc_rec measure_desc = {0};
 	struct rmi_rec_params *rec_params_measured =
-		&(rec_params_per_cpu[my_cpuid()]);
+		&per_cpu(rec_params_copy, my_cpuid());
 
 	memset(rec_params_measured, 0, sizeof(*rec_params_measured));
 
@@ -40,7 +50,7 @@ static void rec_params_measure(struct rd *rd, struct rmi_rec_params *rec_params)
 	 * measured
 	 */
 	rec_params_measured->pc = rec_params->pc;
-	rec_params_measured->flags = rec_params->flags;
+	rec_params_measured->flags = rec_params->flags & ~REC_PARAMS_FLAG_MPAM;
 	memcpy(rec_params_measured->gprs,
 	       rec_params->gprs,
 	       sizeof(rec_params->gprs));
@@ -56,19 +66,16 @@ static void rec_params_measure(struct rd *rd, struct rmi_rec_params *rec_params)
 	 * Hashing the REC params structure and store the result in the
 	 * measurement descriptor structure.
 	 */
-	measurement_hash_compute(rd->algorithm,
-				rec_params_measured,
-				sizeof(*rec_params_measured),
-				measure_desc.content);
+	measurement_ctx_hash(mctx, rec_params_measured,
+			     sizeof(*rec_params_measured),
+			     measure_desc.content);
 
 	/*
 	 * Hashing the measurement descriptor structure; the result is the
 	 * updated RIM.
 	 */
-	measurement_hash_compute(rd->algorithm,
-			       &measure_desc,
-			       sizeof(measure_desc),
-			       rd->measurement[RIM_MEASUREMENT_SLOT]);
+	measurement_ctx_hash(mctx, &measure_desc, sizeof(measure_desc),
+			     rd->measurement[RIM_MEASUREMENT_SLOT]);
 }
 
 static void init_rec_sysregs(struct rec *rec, unsigned long mpidr)
@@ -87,10 +94,17 @@ static void init_rec_sysregs(struct rec *rec, unsigned long mpidr)
  * lookup to VTCR_EL2.SL0[7:6].
  */
 static const unsigned long sl0_val[] = {
+#if GRANULE_SIZE == 4096U
 	VTCR_SL0_4K_L0,
 	VTCR_SL0_4K_L1,
 	VTCR_SL0_4K_L2,
 	VTCR_SL0_4K_L3
+#else
+	VTCR_SL0_16K_L0,
+	VTCR_SL0_16K_64K_L1,
+	VTCR_SL0_16K_64K_L2,
+	VTCR_SL0_16K_64K_L3
+#endif
 };
 
 static unsigned long realm_vtcr(struct rd *rd)
@@ -101,7 +115,8 @@ static unsigned long realm_vtcr(struct rd *rd)
 	int s2_starting_level = realm_rtt_starting_level(rd);
 
 	/* TODO: Support LPA2 with -1 */
-	assert((s2_starting_level >= 0) && (s2_starting_level <= 3));
+	assert((s2_starting_level >= MIN_STARTING_LEVEL) &&
+	       (s2_starting_level <= 3));
 	sl0 = sl0_val[s2_starting_level];
 
 	t0sz = 64UL - realm_ipa_bits(rd);
@@ -110,6 +125,10 @@ static unsigned long realm_vtcr(struct rd *rd)
 	vtcr |= t0sz;
 	vtcr |= sl0;
 
+	if (rd->hafdbs_enabled) {
+		vtcr |= VTCR_HA | VTCR_HD;
+	}
+
 	return vtcr;
 }
 
@@ -121,6 +140,14 @@ static void init_common_sysregs(struct rec *rec, struct rd *rd)
 	rec->common_sysregs.vttbr_el2 = granule_addr(rd->s2_ctx.g_rtt);
 	rec->common_sysregs.vttbr_el2 &= MASK(TTBRx_EL2_BADDR);
 	rec->common_sysregs.vttbr_el2 |= INPLACE(VTTBR_EL2_VMID, rd->s2_ctx.vmid);
+	rec->common_sysregs.mdcr_el2 = rd->spe_enabled ?
+					MDCR_EL2_INIT_SPE : MDCR_EL2_INIT;
+
+	/* Pointer Authentication instructions are no longer trapped */
+	if (HAS_PAUTH && is_feat_pauth_present()) {
+		rec->common_sysregs.hcr_el2 |= HCR_API;
+		rec->pauth_id = pauth_new_id();
+	}
 }
 
 static void init_rec_regs(struct rec *rec,
@@ -130,10 +157,9 @@ static void init_rec_regs(struct rec *rec,
 	unsigned int i;
 
 	/*
-	 * We only need to set non-zero values here because we're intializing
-	 * data structures in the rec granule which was just converted from
-	 * the DELEGATED state to REC state, and we can rely on the RMM
-	 * invariant that DELEGATED granules are always zero-filled.
+	 * We only need to set non-zero values here because the rec granule
+	 * has been zeroed by granule_scrub_mapped() in rec_init(), before it
+	 * is initialised.
 	 */
 
 	for (i = 0U; i < REC_CREATE_NR_GPRS; i++) {
@@ -150,114 +176,150 @@ static void init_rec_regs(struct rec *rec,
 
 	init_rec_sysregs(rec, rec_params->mpidr);
 	init_common_sysregs(rec, rd);
+
+	/*
+	 * The REC runs at EL1 and EL0 with the MPAM partition of the Realm,
+	 * unless the Host has chosen one for this REC.
+	 */
+	if ((rec_params->flags & REC_PARAMS_FLAG_MPAM) != 0UL) {
+		rec->sysregs.mpam1_el1 = rec_params->mpam;
+	} else {
+		rec->sysregs.mpam1_el1 = rd->mpam;
+	}
+	rec->sysregs.mpam0_el1 = rec->sysregs.mpam1_el1;
 }
 
 /*
- * This function will only be invoked when the REC create fails
- * or when REC is being destroyed. Hence the REC will not be in
- * use when this function is called and therefore no lock is
- * acquired before its invocation.
+ * This function will only be invoked when the REC create fails, before
+ * the auxiliary granules are used. Hence the REC will not be in use when
+ * this function is called and therefore no lock is acquired before its
+ * invocation. The REC destroy path scrubs them, see rec_destroy_locked().
  */
 static void free_rec_aux_granules(struct granule *rec_aux[],
-				  unsigned int cnt, bool scrub)
+				  unsigned int cnt)
 {
 	for (unsigned int i = 0U; i < cnt; i++) {
 		struct granule *g_rec_aux = rec_aux[i];
 
 		granule_lock(g_rec_aux, GRANULE_STATE_REC_AUX);
-		if (scrub) {
-			granule_memzero(g_rec_aux, SLOT_REC_AUX0 + i);
-		}
 		granule_unlock_transition(g_rec_aux, GRANULE_STATE_DELEGATED);
 	}
 }
 
-unsigned long smc_rec_create(unsigned long rec_addr,
-			     unsigned long rd_addr,
-			     unsigned long rec_params_addr)
+/*
+ * Read the parameters of a new REC from the NS granule at @rec_params_addr.
+ */
+static bool rec_params_read(unsigned long rec_params_addr,
+			    struct rmi_rec_params *rec_params)
 {
-	struct granule *g_rd;
-	struct granule *g_rec;
-	struct granule *rec_aux_granules[MAX_REC_AUX_GRANULES];
 	struct granule *g_rec_params;
-	struct rec *rec;
-	struct rd *rd;
-	struct rmi_rec_params rec_params;
-	unsigned long rec_idx;
-	enum granule_state new_rec_state = GRANULE_STATE_DELEGATED;
-	unsigned long ret;
-	bool ns_access_ok;
-	unsigned int num_rec_aux;
 
 	g_rec_params = find_granule(rec_params_addr);
 	if ((g_rec_params == NULL) || (g_rec_params->state != GRANULE_STATE_NS)) {
-		return RMI_ERROR_INPUT;
+		return false;
 	}
 
-	ns_access_ok = ns_buffer_read(SLOT_NS, g_rec_params, 0U,
-				      sizeof(rec_params), &rec_params);
-
-	if (!ns_access_ok) {
-		return RMI_ERROR_INPUT;
+	if (!ns_buffer_read(SLOT_NS, g_rec_params, 0U,
+			    sizeof(*rec_params), rec_params)) {
+		return false;
 	}
 
-	num_rec_aux = (unsigned int)rec_params.num_aux;
-	if (num_rec_aux > MAX_REC_AUX_GRANULES) {
-		return RMI_ERROR_INPUT;
-	}
+	return (rec_params->num_aux <= MAX_REC_AUX_GRANULES);
+}
+
+/*
+ * Transition the auxiliary granules listed in @rec_params from DELEGATED to
+ * REC_AUX and return them in @rec_aux. With @try_lock, fail instead of
+ * waiting for a locked granule, as the caller already holds the rd lock.
+ */
+static bool rec_aux_granules_claim(struct rmi_rec_params *rec_params,
+				   struct granule *rec_aux[], bool try_lock)
+{
+	unsigned int num_rec_aux = (unsigned int)rec_params->num_aux;
 
-	/* Loop through rec_aux_granules and transit them */
 	for (unsigned int i = 0U; i < num_rec_aux; i++) {
-		struct granule *g_rec_aux = find_lock_granule(
-						rec_params.aux[i],
-						GRANULE_STATE_DELEGATED);
+		struct granule *g_rec_aux;
+
+		if (try_lock) {
+			g_rec_aux = find_granule(rec_params->aux[i]);
+			if ((g_rec_aux != NULL) &&
+			    !granule_trylock_on_state_match(g_rec_aux,
+						GRANULE_STATE_DELEGATED)) {
+				g_rec_aux = NULL;
+			}
+		} else {
+			g_rec_aux = find_lock_granule(rec_params->aux[i],
+						      GRANULE_STATE_DELEGATED);
+		}
+
 		if (g_rec_aux == NULL) {
-			free_rec_aux_granules(rec_aux_granules, i, false);
-			return RMI_ERROR_INPUT;
+			free_rec_aux_granules(rec_aux, i);
+			return false;
 		}
+		granule_scrub(g_rec_aux, SLOT_REC_AUX0 + i);
 		granule_unlock_transition(g_rec_aux, GRANULE_STATE_REC_AUX);
-		rec_aux_granules[i] = g_rec_aux;
-	}
-
-	if (!find_lock_two_granules(rec_addr,
-				GRANULE_STATE_DELEGATED,
-				&g_rec,
-				rd_addr,
-				GRANULE_STATE_RD,
-				&g_rd)) {
-		ret = RMI_ERROR_INPUT;
-		goto out_free_aux;
+		rec_aux[i] = g_rec_aux;
 	}
 
-	rec = granule_map(g_rec, SLOT_REC);
-	rd = granule_map(g_rd, SLOT_RD);
+	return true;
+}
 
+/*
+ * Check @rec_params against the Realm @rd, with the rd lock held.
+ */
+static unsigned long rec_params_check(struct rd *rd,
+				      struct rmi_rec_params *rec_params)
+{
 	if (get_rd_state_locked(rd) != REALM_STATE_NEW) {
-		ret = RMI_ERROR_REALM;
-		goto out_unmap;
+		return RMI_ERROR_REALM;
 	}
 
-	rec_idx = get_rd_rec_count_locked(rd);
-	if (!mpidr_is_valid(rec_params.mpidr) ||
-	   (rec_idx != mpidr_to_rec_idx(rec_params.mpidr))) {
-		ret = RMI_ERROR_INPUT;
-		goto out_unmap;
+	if (!mpidr_is_valid(rec_params->mpidr) ||
+	   (get_rd_rec_count_locked(rd) !=
+				mpidr_to_rec_idx(rec_params->mpidr))) {
+		return RMI_ERROR_INPUT;
 	}
 
 	/* Verify the auxiliary granule count with rd lock held */
-	if (num_rec_aux != rd->num_rec_aux) {
-		ret = RMI_ERROR_INPUT;
-		goto out_unmap;
+	if ((unsigned int)rec_params->num_aux != rd->num_rec_aux) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (((rec_params->flags & REC_PARAMS_FLAG_MPAM) != 0UL) &&
+	    !validate_mpam_value(rec_params->mpam)) {
+		return RMI_ERROR_INPUT;
 	}
 
+	return RMI_SUCCESS;
+}
+
+/*
+ * Initialize the REC mapped at @rec as the next REC of the Realm @rd, with
+ * both granules locked and @rec_params checked by rec_params_check().
+ */
+static void rec_init(struct rd *rd, struct granule *g_rd,
+		     struct rec *rec, struct granule *g_rec,
+		     struct rmi_rec_params *rec_params,
+		     struct granule *rec_aux[],
+		     struct measurement_ctx *mctx)
+{
+	unsigned long rec_idx = get_rd_rec_count_locked(rd);
+	unsigned int num_rec_aux = (unsigned int)rec_params->num_aux;
+
+	granule_scrub_mapped(g_rec, rec);
+
 	rec->g_rec = g_rec;
 	rec->rec_idx = rec_idx;
 
-	init_rec_regs(rec, &rec_params, rd);
+	if (rec_idx < RD_REC_TABLE_LEN) {
+		rd->g_recs[rec_idx] = g_rec;
+	}
+
+	init_rec_regs(rec, rec_params, rd);
 	gic_cpu_state_init(&rec->sysregs.gicstate);
 
 	/* Copy addresses of auxiliary granules */
-	(void)memcpy(rec->g_aux, rec_aux_granules,
+	(void)memcpy(rec->g_aux, rec_aux,
 			num_rec_aux * sizeof(rec->g_aux[0]));
 
 	rec->num_rec_aux = num_rec_aux;
@@ -266,8 +328,14 @@ unsigned long smc_rec_create(unsigned long rec_addr,
 	rec->realm_info.s2_starting_level = realm_rtt_starting_level(rd);
 	rec->realm_info.g_rtt = rd->s2_ctx.g_rtt;
 	rec->realm_info.g_rd = g_rd;
+	rec->realm_info.vmid = rd->s2_ctx.vmid;
+	rec->realm_info.mecid = rd->s2_ctx.mecid;
+	rec->realm_info.pmu_enabled = rd->pmu_enabled;
+	rec->realm_info.pmu_num_ctrs = rd->pmu_num_ctrs;
+	rec->realm_info.spe_enabled = rd->spe_enabled;
+	rec->realm_info.wfx_notrap = rd->wfx_notrap;
 
-	rec_params_measure(rd, &rec_params);
+	rec_params_measure(mctx, rd, rec_params);
 
 	/*
 	 * RD has a lock-free access from RMI_REC_DESTROY, hence increment
@@ -276,16 +344,67 @@ unsigned long smc_rec_create(unsigned long rec_addr,
 	 * release/acquire semantics are not required.
 	 */
 	atomic_granule_get(g_rd);
-	new_rec_state = GRANULE_STATE_REC;
-	rec->runnable = rec_params.flags & REC_PARAMS_FLAG_RUNNABLE;
+	rec->runnable = rec_params->flags & REC_PARAMS_FLAG_RUNNABLE;
 
 	rec->alloc_info.ctx_initialised = false;
+	rec->alloc_info.pool_slot = REC_ATTEST_HEAP_NONE;
 	/* Initialize attestation state */
 	rec->token_sign_ctx.state = ATTEST_SIGN_NOT_STARTED;
 
+	rec->wfe_poll.window = REC_WFE_POLL_MIN;
+	rec->mmio_ring.g_ns = NULL;
+	rec->mmio_ring.nr_consts = 0UL;
+
 	set_rd_rec_count(rd, rec_idx + 1U);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_REC, 1L);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_REC_AUX, (long)num_rec_aux);
+}
+
+unsigned long smc_rec_create(unsigned long rec_addr,
+			     unsigned long rd_addr,
+			     unsigned long rec_params_addr)
+{
+	struct granule *g_rd;
+	struct granule *g_rec;
+	struct granule *rec_aux_granules[MAX_REC_AUX_GRANULES];
+	struct measurement_ctx mctx;
+	struct rec *rec;
+	struct rd *rd;
+	struct rmi_rec_params rec_params;
+	enum granule_state new_rec_state = GRANULE_STATE_DELEGATED;
+	unsigned long ret;
 
-	ret = RMI_SUCCESS;
+	if (!rec_params_read(rec_params_addr, &rec_params)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (!rec_aux_granules_claim(&rec_params, rec_aux_granules, false)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (!find_lock_two_granules(rec_addr,
+				GRANULE_STATE_DELEGATED,
+				&g_rec,
+				rd_addr,
+				GRANULE_STATE_RD,
+				&g_rd)) {
+		ret = RMI_ERROR_INPUT;
+		goto out_free_aux;
+	}
+
+	rec = granule_map(g_rec, SLOT_REC);
+	rd = granule_map(g_rd, SLOT_RD);
+
+	ret = rec_params_check(rd, &rec_params);
+	if (ret != RMI_SUCCESS) {
+		goto out_unmap;
+	}
+
+	measurement_ctx_begin(&mctx, rd->algorithm);
+	rec_init(rd, g_rd, rec, g_rec, &rec_params, rec_aux_granules, &mctx);
+	measurement_ctx_end(&mctx);
+
+	new_rec_state = GRANULE_STATE_REC;
 
 out_unmap:
 	buffer_unmap(rd);
@@ -296,34 +415,238 @@ out_unmap:
 
 out_free_aux:
 	if (ret != RMI_SUCCESS) {
-		free_rec_aux_granules(rec_aux_granules, num_rec_aux, false);
+		free_rec_aux_granules(rec_aux_granules,
+				      (unsigned int)rec_params.num_aux);
 	}
 	return ret;
 }
 
-unsigned long smc_rec_destroy(unsigned long rec_addr)
+/*
+ * Create the REC described by @entry in the Realm @rd, whose granule is
+ * locked by the caller. The REC and auxiliary granules are locked without
+ * waiting, since they may be locked by a command waiting for the rd.
+ */
+static unsigned long rec_create_locked(struct rd *rd, struct granule *g_rd,
+				       struct rmi_rec_create_entry *entry,
+				       struct rmi_rec_params *rec_params,
+				       struct measurement_ctx *mctx)
 {
+	struct granule *rec_aux_granules[MAX_REC_AUX_GRANULES];
 	struct granule *g_rec;
-	struct granule *g_rd;
 	struct rec *rec;
+	unsigned long ret;
 
-	/* REC should not be destroyed if refcount != 0 */
-	g_rec = find_lock_unused_granule(rec_addr, GRANULE_STATE_REC);
-	if (ptr_is_err(g_rec)) {
-		return (unsigned long)ptr_status(g_rec);
+	if (!rec_params_read(entry->rec_params, rec_params)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	ret = rec_params_check(rd, rec_params);
+	if (ret != RMI_SUCCESS) {
+		return ret;
+	}
+
+	g_rec = find_granule(entry->rec);
+	if ((g_rec == NULL) ||
+	    !granule_trylock_on_state_match(g_rec, GRANULE_STATE_DELEGATED)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (!rec_aux_granules_claim(rec_params, rec_aux_granules, true)) {
+		granule_unlock(g_rec);
+		return RMI_ERROR_INPUT;
+	}
+
+	rec = granule_map(g_rec, SLOT_REC);
+	rec_init(rd, g_rd, rec, g_rec, rec_params, rec_aux_granules, mctx);
+	buffer_unmap(rec);
+
+	granule_unlock_transition(g_rec, GRANULE_STATE_REC);
+
+	return RMI_SUCCESS;
+}
+
+/*
+ * Implements RMI_REC_CREATE_MULTI.
+ *
+ * Create the @count RECs listed at @list_addr in the Realm at @rd_addr, in
+ * order, as RMI_REC_CREATE would for each entry of the list. The rd lock is
+ * taken and the measurement context opened once for all the RECs. On error,
+ * ret->x[1] holds the number of RECs created before the failing entry.
+ */
+void smc_rec_create_multi(unsigned long rd_addr,
+			  unsigned long list_addr,
+			  unsigned long count,
+			  struct smc_result *ret)
+{
+	struct granule *g_list;
+	struct granule *g_rd;
+	struct measurement_ctx mctx;
+	struct rmi_rec_params rec_params;
+	struct rd *rd;
+	unsigned long i;
+
+	ret->x[0] = RMI_ERROR_INPUT;
+	ret->x[1] = 0UL;
+
+	if ((count == 0UL) || (count > RMI_REC_CREATE_MULTI_LEN)) {
+		return;
+	}
+
+	g_list = find_granule(list_addr);
+	if ((g_list == NULL) || (g_list->state != GRANULE_STATE_NS)) {
+		return;
+	}
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		return;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+	measurement_ctx_begin(&mctx, rd->algorithm);
+
+	for (i = 0UL; i < count; i++) {
+		struct rmi_rec_create_entry entry;
+
+		if (!ns_buffer_read(SLOT_NS, g_list,
+				(unsigned int)(i * sizeof(entry)),
+				sizeof(entry), &entry)) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			break;
+		}
+
+		ret->x[0] = rec_create_locked(rd, g_rd, &entry, &rec_params,
+					      &mctx);
+		if (ret->x[0] != RMI_SUCCESS) {
+			break;
+		}
+	}
+
+	measurement_ctx_end(&mctx);
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+
+	ret->x[1] = i;
+}
+
+struct rec *rec_map_sibling(struct rec *rec, unsigned long rec_idx)
+{
+	struct granule *g_rd = rec->realm_info.g_rd;
+	struct granule *g_sibling;
+	struct rec *sibling;
+	struct rd *rd;
+
+	if (rec_idx >= RD_REC_TABLE_LEN) {
+		return NULL;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+	g_sibling = rd->g_recs[rec_idx];
+	buffer_unmap(rd);
+
+	/*
+	 * The running REC does not hold any granule lock, so locking the
+	 * sibling REC here cannot cause a deadlock.
+	 */
+	if ((g_sibling == NULL) ||
+	    !granule_lock_on_state_match(g_sibling, GRANULE_STATE_REC)) {
+		return NULL;
+	}
+
+	/* The granule may have been reused since the REC was created */
+	sibling = granule_map(g_sibling, SLOT_REC2);
+	if ((sibling->realm_info.g_rd != g_rd) ||
+	    (sibling->rec_idx != rec_idx)) {
+		buffer_unmap(sibling);
+		granule_unlock(g_sibling);
+		return NULL;
+	}
+
+	return sibling;
+}
+
+void rec_unmap_sibling(struct rec *sibling)
+{
+	struct granule *g_sibling = sibling->g_rec;
+
+	buffer_unmap(sibling);
+	granule_unlock(g_sibling);
+}
+
+/*
+ * Release the REC or auxiliary granule @g, locked and zeroed, which becomes
+ * DELEGATED, or NS if @undelegate is true.
+ */
+static void rec_granule_release(struct granule *g, bool undelegate)
+{
+	if (undelegate) {
+		asc_mark_nonsecure(granule_addr(g));
+		granule_unlock_transition(g, GRANULE_STATE_NS);
+	} else {
+		granule_unlock_transition(g, GRANULE_STATE_DELEGATED);
 	}
+}
+
+/*
+ * Destroy the REC locked at @g_rec, which has a zero refcount, and release
+ * it and its auxiliary granules as rec_granule_release() does. If @freed
+ * is not NULL, the addresses of the granules released are stored there.
+ * Returns their number.
+ */
+static unsigned int rec_destroy_locked(struct granule *g_rec, bool undelegate,
+				       unsigned long *freed)
+{
+	struct granule *g_aux[MAX_REC_AUX_GRANULES];
+	struct granule *g_rd;
+	struct rec *rec;
+	struct rd *rd;
+	unsigned int num_rec_aux;
 
 	rec = granule_map(g_rec, SLOT_REC);
 
 	g_rd = rec->realm_info.g_rd;
+	num_rec_aux = rec->num_rec_aux;
+
+	/* Lock and scrub all the auxiliary granules before releasing them */
+	for (unsigned int i = 0U; i < num_rec_aux; i++) {
+		g_aux[i] = rec->g_aux[i];
+		granule_lock(g_aux[i], GRANULE_STATE_REC_AUX);
+		granule_memzero(g_aux[i], SLOT_REC_AUX0 + i);
+	}
+
+	/* Return the shared attestation heap, if the REC still holds one */
+	rec_attest_heap_release(rec);
 
-	/* Free and scrub the auxiliary granules */
-	free_rec_aux_granules(rec->g_aux, rec->num_rec_aux, true);
+#ifdef RMM_ATTEST_BATCH
+	/* Do not leave the batch of the REC waiting for its signature */
+	if (rec->token_sign_ctx.state == ATTEST_SIGN_IN_PROGRESS) {
+		attest_realm_token_batch_abort(&rec->token_sign_ctx);
+	}
+#endif
 
 	granule_memzero_mapped(rec);
 	buffer_unmap(rec);
 
-	granule_unlock_transition(g_rec, GRANULE_STATE_DELEGATED);
+	for (unsigned int i = 0U; i < num_rec_aux; i++) {
+		if (freed != NULL) {
+			freed[i + 1U] = granule_addr(g_aux[i]);
+		}
+		rec_granule_release(g_aux[i], undelegate);
+	}
+
+	if (freed != NULL) {
+		freed[0] = granule_addr(g_rec);
+	}
+	rec_granule_release(g_rec, undelegate);
+
+	/*
+	 * The RD cannot be destroyed before its refcount is decremented
+	 * below, so it is mapped without taking its lock.
+	 */
+	rd = granule_map(g_rd, SLOT_RD);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_REC, -1L);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_REC_AUX, -(long)num_rec_aux);
+	buffer_unmap(rd);
 
 	/*
 	 * Decrement refcount. The refcount should be balanced before
@@ -335,9 +658,259 @@ unsigned long smc_rec_destroy(unsigned long rec_addr)
 	 */
 	atomic_granule_put(g_rd);
 
+	return num_rec_aux + 1U;
+}
+
+/* The granules freed by RMI_REC_DESTROY with a list fit in the list */
+COMPILER_ASSERT((RMI_REC_DESTROY_LIST_LEN * (MAX_REC_AUX_GRANULES + 1U)) <=
+		(GRANULE_SIZE / sizeof(unsigned long)));
+
+/*
+ * Destroy the @n RECs of @recs, found and locked together with
+ * find_lock_granules(), and append the addresses of the granules released
+ * to the NS list @g_list, from entry @ret->x[2].
+ */
+static unsigned long rec_destroy_batch(struct granule_set *recs,
+				       unsigned int n, bool undelegate,
+				       struct granule *g_list,
+				       struct smc_result *ret)
+{
+	unsigned long freed[MAX_REC_AUX_GRANULES + 1U];
+	unsigned int i, nr_freed;
+
+	if (!find_lock_granules(recs, n)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	/*
+	 * Granules can have lock-free access (e.g. REC), thus using acquire
+	 * semantics to avoid race conditions.
+	 */
+	for (i = 0U; i < n; i++) {
+		if (granule_refcount_read_acquire(recs[i].g)) {
+			for (i = 0U; i < n; i++) {
+				granule_unlock(recs[i].g);
+			}
+			return RMI_ERROR_IN_USE;
+		}
+	}
+
+	for (i = 0U; i < n; i++) {
+		nr_freed = rec_destroy_locked(recs[i].g, undelegate, freed);
+
+		/*
+		 * A failed write only means that the Host loses track of some
+		 * freed granules, as with any other malformed NS buffer.
+		 */
+		(void)ns_buffer_write(SLOT_NS, g_list,
+				(unsigned int)(ret->x[2] * sizeof(freed[0])),
+				nr_freed * (unsigned int)sizeof(freed[0]),
+				freed);
+		ret->x[1]++;
+		ret->x[2] += nr_freed;
+	}
+
 	return RMI_SUCCESS;
 }
 
+/*
+ * Implements RMI_REC_DESTROY with RMI_REC_DESTROY_LIST.
+ *
+ * Destroy the @count RECs listed at @list_addr, as RMI_REC_DESTROY would for
+ * each of them, in batches of up to FIND_LOCK_GRANULES_MAX RECs locked
+ * together. The RECs of a batch are all destroyed, or none of them if one
+ * cannot be. On error, ret->x[1] holds the number of RECs destroyed before
+ * the failing batch.
+ */
+static void rec_destroy_list(unsigned long list_addr,
+			     unsigned long count,
+			     unsigned long flags,
+			     struct smc_result *ret)
+{
+	unsigned long addrs[RMI_REC_DESTROY_LIST_LEN];
+	struct granule_set recs[FIND_LOCK_GRANULES_MAX];
+	bool undelegate = ((flags & RMI_REC_DESTROY_UNDELEGATE) != 0UL);
+	struct granule *g_list;
+	unsigned long i;
+	unsigned int n;
+
+	ret->x[0] = RMI_ERROR_INPUT;
+	ret->x[1] = 0UL;
+	ret->x[2] = 0UL;
+
+	if ((count == 0UL) || (count > RMI_REC_DESTROY_LIST_LEN) ||
+	    ((flags & ~RMI_REC_DESTROY_UNDELEGATE) != 0UL)) {
+		return;
+	}
+
+	g_list = find_granule(list_addr);
+	if ((g_list == NULL) || (g_list->state != GRANULE_STATE_NS)) {
+		return;
+	}
+
+	/* The list is overwritten with the granules freed */
+	if (!ns_buffer_read(SLOT_NS, g_list, 0U,
+			    (unsigned int)(count * sizeof(addrs[0])), addrs)) {
+		return;
+	}
+
+	ret->x[0] = RMI_SUCCESS;
+	for (i = 0UL; (i < count) && (ret->x[0] == RMI_SUCCESS); i += n) {
+		n = (unsigned int)(count - i);
+		if (n > FIND_LOCK_GRANULES_MAX) {
+			n = FIND_LOCK_GRANULES_MAX;
+		}
+
+		for (unsigned int j = 0U; j < n; j++) {
+			recs[j] = (struct granule_set) {
+				.addr = addrs[i + j],
+				.state = GRANULE_STATE_REC
+			};
+		}
+
+		ret->x[0] = rec_destroy_batch(recs, n, undelegate, g_list, ret);
+	}
+}
+
+/*
+ * Implements RMI_REC_DESTROY.
+ *
+ * @count and @flags are only used with RMI_REC_DESTROY_LIST, which is never
+ * set in the address of a REC.
+ */
+void smc_rec_destroy(unsigned long rec_addr,
+		     unsigned long count,
+		     unsigned long flags,
+		     struct smc_result *ret)
+{
+	struct granule *g_rec;
+
+	if ((rec_addr & RMI_REC_DESTROY_LIST) != 0UL) {
+		rec_destroy_list(rec_addr & ~RMI_REC_DESTROY_LIST, count,
+				 flags, ret);
+		return;
+	}
+
+	/* REC should not be destroyed if refcount != 0 */
+	g_rec = find_lock_unused_granule(rec_addr, GRANULE_STATE_REC);
+	if (ptr_is_err(g_rec)) {
+		ret->x[0] = (unsigned long)ptr_status(g_rec);
+		return;
+	}
+
+	(void)rec_destroy_locked(g_rec, false, NULL);
+
+	ret->x[0] = RMI_SUCCESS;
+}
+
+/* Header of struct rmi_mmio_ring, read when the ring is registered */
+struct mmio_ring_regions {
+	unsigned long nr_regions;
+	struct rmi_mmio_ring_region regions[RMI_MMIO_RING_NR_REGIONS];
+};
+
+COMPILER_ASSERT(offsetof(struct mmio_ring_regions, regions) ==
+		offsetof(struct rmi_mmio_ring, regions));
+
+/*
+ * Return 'true' if the regions of @ring are all within the Unprotected IPA
+ * space of @rec.
+ */
+static bool validate_mmio_ring_regions(struct rec *rec,
+				       struct mmio_ring_regions *ring)
+{
+	unsigned long ipa_top = 1UL << rec->realm_info.ipa_bits;
+
+	if (ring->nr_regions > RMI_MMIO_RING_NR_REGIONS) {
+		return false;
+	}
+
+	for (unsigned long i = 0UL; i < ring->nr_regions; i++) {
+		unsigned long base = ring->regions[i].base;
+		unsigned long size = ring->regions[i].size;
+
+		if ((size == 0UL) || addr_in_rec_par(rec, base) ||
+		    (base >= ipa_top) || (size > (ipa_top - base))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Implements RMI_REC_MMIO_RING.
+ *
+ * Register the NS granule at @ring_addr as the ring of coalesced MMIO writes
+ * of the REC at @rec_addr, see struct rmi_mmio_ring, or remove the ring of
+ * the REC when @ring_addr is 0. The constant MMIO reads of the REC are
+ * those of the ring, if there is one.
+ */
+unsigned long smc_rec_mmio_ring(unsigned long rec_addr,
+				unsigned long ring_addr)
+{
+	struct granule *g_rec;
+	struct granule *g_ring = NULL;
+	struct rec *rec;
+	struct mmio_ring_regions ring;
+	unsigned long nr_consts = 0UL;
+	unsigned long head = 0UL;
+	unsigned long ret = RMI_SUCCESS;
+
+	if (ring_addr != 0UL) {
+		g_ring = find_granule(ring_addr);
+		if ((g_ring == NULL) || (g_ring->state != GRANULE_STATE_NS)) {
+			return RMI_ERROR_INPUT;
+		}
+
+		if (!ns_buffer_read(SLOT_NS, g_ring, 0U,
+				    sizeof(struct mmio_ring_regions), &ring) ||
+		    !ns_buffer_read(SLOT_NS, g_ring,
+				    offsetof(struct rmi_mmio_ring, nr_consts),
+				    sizeof(nr_consts), &nr_consts)) {
+			return RMI_ERROR_INPUT;
+		}
+	}
+
+	g_rec = find_lock_unused_granule(rec_addr, GRANULE_STATE_REC);
+	if (ptr_is_err(g_rec)) {
+		return (unsigned long)ptr_status(g_rec);
+	}
+
+	rec = granule_map(g_rec, SLOT_REC);
+
+	if (g_ring == NULL) {
+		rec->mmio_ring.g_ns = NULL;
+		goto out_unmap;
+	}
+
+	if (!validate_mmio_ring_regions(rec, &ring) ||
+	    (nr_consts > RMI_MMIO_RING_NR_CONSTS)) {
+		ret = RMI_ERROR_INPUT;
+		goto out_unmap;
+	}
+
+	if (!ns_buffer_write(SLOT_NS, g_ring,
+			     offsetof(struct rmi_mmio_ring, head),
+			     sizeof(head), &head)) {
+		ret = RMI_ERROR_INPUT;
+		goto out_unmap;
+	}
+
+	rec->mmio_ring.g_ns = g_ring;
+	rec->mmio_ring.head = head;
+	rec->mmio_ring.tail = head;
+	rec->mmio_ring.nr_regions = ring.nr_regions;
+	(void)memcpy(rec->mmio_ring.regions, ring.regions,
+		     sizeof(rec->mmio_ring.regions));
+	rec->mmio_ring.nr_consts = nr_consts;
+
+out_unmap:
+	buffer_unmap(rec);
+	granule_unlock(g_rec);
+	return ret;
+}
+
 void smc_rec_aux_count(unsigned long rd_addr, struct smc_result *ret_struct)
 {
 	unsigned int num_rec_aux;
@@ -359,11 +932,167 @@ void smc_rec_aux_count(unsigned long rd_addr, struct smc_result *ret_struct)
 	ret_struct->x[1] = (unsigned long)num_rec_aux;
 }
 
+#ifdef RMM_REC_STATS
+/* Return the RMI_REC_STATS_HEAP_* statistic @stat which needs a heap walk */
+static unsigned long rec_heap_free_stat(struct rec *rec, unsigned long stat)
+{
+	size_t free_bytes = 0UL;
+	size_t largest_free = 0UL;
+
+	/* The heap is laid out on the first use of attestation */
+	if (rec->alloc_info.ctx_initialised) {
+		rec->aux_data.aux = NULL;
+		rec->aux_data.attest_heap_buf = NULL;
+		rec_attest_heap_map(rec);
+		buffer_alloc_ctx_free_info(&rec->alloc_info.ctx,
+					   &free_bytes, &largest_free);
+		rec_attest_heap_unmap(rec);
+	}
+
+	if (stat == RMI_REC_STATS_HEAP_FREE_BYTES) {
+		return free_bytes;
+	} else if (stat == RMI_REC_STATS_HEAP_LARGEST_FREE) {
+		return largest_free;
+	} else if (free_bytes == 0UL) {
+		return 0UL;
+	}
+
+	return ((free_bytes - largest_free) * 100UL) / free_bytes;
+}
+
+/* Return the RMI_REC_STATS_HEAP_* statistic @stat kept by the allocator */
+static unsigned long rec_heap_stat(struct rec *rec, unsigned long stat)
+{
+	struct buffer_alloc_stats *stats = &rec->alloc_info.ctx.stats;
+
+	switch (stat) {
+	case RMI_REC_STATS_HEAP_ALLOCS:
+		return stats->allocs;
+	case RMI_REC_STATS_HEAP_ALLOC_FAILURES:
+		return stats->alloc_failures;
+	case RMI_REC_STATS_HEAP_FREES:
+		return stats->frees;
+	case RMI_REC_STATS_HEAP_CUR_BYTES:
+		return stats->cur_bytes;
+	case RMI_REC_STATS_HEAP_PEAK_BYTES:
+		return stats->peak_bytes;
+	case RMI_REC_STATS_HEAP_ALLOC_TICKS:
+		return stats->alloc_ticks;
+	case RMI_REC_STATS_HEAP_MAX_ALLOC_TICKS:
+		return stats->max_alloc_ticks;
+	default:
+		return rec_heap_free_stat(rec, stat);
+	}
+}
+#endif /* RMM_REC_STATS */
+
+/*
+ * Implements RMI_REC_STATS.
+ *
+ * The counters of a REC which is running on another CPU can be updated
+ * while they are read here, in which case the value returned may be one
+ * exit or one REC_ENTER behind. The statistics which walk the heap of the
+ * REC fail with RMI_ERROR_IN_USE instead.
+ */
+void smc_rec_stats(unsigned long rec_addr,
+		   unsigned long stat,
+		   struct smc_result *ret_struct)
+{
+#ifdef RMM_REC_STATS
+	struct granule *g_rec;
+	struct rec *rec;
+	unsigned long value;
+
+	if (stat > RMI_REC_STATS_ATTEST_ITERATIONS) {
+		ret_struct->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	if ((stat >= RMI_REC_STATS_HEAP_FREE_BYTES) &&
+	    (stat <= RMI_REC_STATS_HEAP_FRAGMENTATION)) {
+		g_rec = find_lock_unused_granule(rec_addr, GRANULE_STATE_REC);
+		if (ptr_is_err(g_rec)) {
+			ret_struct->x[0] = (unsigned long)ptr_status(g_rec);
+			return;
+		}
+	} else {
+		g_rec = find_lock_granule(rec_addr, GRANULE_STATE_REC);
+		if (g_rec == NULL) {
+			ret_struct->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+	}
+
+	rec = granule_map(g_rec, SLOT_REC);
+
+	if (stat < RMI_REC_STATS_NR_EXITS) {
+		value = rec->stats.exits[stat];
+	} else if (stat == RMI_REC_STATS_REALM_TICKS) {
+		value = rec->stats.realm_ticks;
+	} else if (stat == RMI_REC_STATS_RMM_TICKS) {
+		value = rec->stats.rmm_ticks;
+	} else if (stat < RMI_REC_STATS_FAST_EXITS) {
+		value = rec->stats.exit_ticks[stat - RMI_REC_STATS_EXIT_TICKS];
+	} else if (stat == RMI_REC_STATS_FAST_EXITS) {
+		value = rec->stats.fast_exits;
+	} else if (stat == RMI_REC_STATS_TIMER_POLLS) {
+		value = rec->stats.timer_polls;
+	} else if (stat == RMI_REC_STATS_EARLY_IRQ_EXITS) {
+		value = rec->stats.early_irq_exits;
+	} else if (stat == RMI_REC_STATS_LAST_CPU) {
+		value = rec->stats.last_cpu - 1UL;
+	} else if (stat == RMI_REC_STATS_LAST_CPU_WARM) {
+		value = ((rec->stats.last_cpu != 0UL) &&
+			 rec_cpu_is_warm(rec,
+				(unsigned int)rec->stats.last_cpu - 1U)) ?
+			1UL : 0UL;
+	} else if (stat == RMI_REC_STATS_FPU_EAGER) {
+		value = (rec->fpu_ctx.lazy_uses >= REC_FPU_EAGER_THRESHOLD) ?
+			1UL : 0UL;
+	} else if (stat == RMI_REC_STATS_ENTRIES) {
+		value = rec->stats.entries;
+	} else if (stat == RMI_REC_STATS_MIGRATIONS) {
+		value = rec->stats.migrations;
+	} else if (stat == RMI_REC_STATS_MIGRATION_RMM_TICKS) {
+		value = rec->stats.migration_rmm_ticks;
+	} else if (stat == RMI_REC_STATS_MMIO_CONST_READS) {
+		value = rec->stats.mmio_const_reads;
+	} else if (stat == RMI_REC_STATS_S2_FAULTS) {
+		value = rec->stats.s2_faults;
+	} else if (stat == RMI_REC_STATS_MMIO_EXITS) {
+		value = rec->stats.mmio_exits;
+	} else if (stat == RMI_REC_STATS_HOST_CALLS) {
+		value = rec->stats.host_calls;
+	} else if (stat == RMI_REC_STATS_RIPAS_CHANGES) {
+		value = rec->stats.ripas_changes;
+	} else if (stat == RMI_REC_STATS_ATTEST_ITERATIONS) {
+		value = rec->stats.attest_iterations;
+	} else {
+		value = rec_heap_stat(rec, stat);
+	}
+
+	buffer_unmap(rec);
+	granule_unlock(g_rec);
+
+	ret_struct->x[0] = RMI_SUCCESS;
+	ret_struct->x[1] = value;
+#else
+	(void)rec_addr;
+	(void)stat;
+
+	/* The statistics are not built in */
+	ret_struct->x[0] = RMI_ERROR_INPUT;
+#endif /* RMM_REC_STATS */
+}
+
 unsigned long smc_psci_complete(unsigned long calling_rec_addr,
 				unsigned long target_rec_addr)
 {
 	struct granule *g_calling_rec, *g_target_rec;
 	struct rec  *calling_rec, *target_rec;
+	struct granule *g_recs[2];
+	const enum buffer_slot rec_slots[2] = { SLOT_REC, SLOT_REC2 };
+	void *recs[2];
 	unsigned long ret;
 
 	assert(calling_rec_addr != 0UL);
@@ -401,16 +1130,59 @@ unsigned long smc_psci_complete(unsigned long calling_rec_addr,
 		goto out_unlock;
 	}
 
-	calling_rec = granule_map(g_calling_rec, SLOT_REC);
-	target_rec = granule_map(g_target_rec, SLOT_REC2);
+	g_recs[0] = g_calling_rec;
+	g_recs[1] = g_target_rec;
+	granule_map_group(g_recs, rec_slots, 2U, recs);
+	calling_rec = recs[0];
+	target_rec = recs[1];
 
 	ret = psci_complete_request(calling_rec, target_rec);
 
-	buffer_unmap(target_rec);
-	buffer_unmap(calling_rec);
+	buffer_unmap_group(recs, 2U);
 out_unlock:
 	granule_unlock(g_calling_rec);
 	granule_unlock(g_target_rec);
 
 	return ret;
 }
+
+/*
+ * Implements RMI_REC_ATTEST_SIGN.
+ *
+ * Sign the Realm token of the REC at @rec_addr, on a CPU which the Host can
+ * spare for it, while the REC is not running. This is the second half of
+ * RSI_ATTEST_TOKEN_CONTINUE when REC_ENTRY_FLAG_ATTEST_SIGN_DEFER is set,
+ * which is then completed by the next RSI_ATTEST_TOKEN_CONTINUE of the REC.
+ */
+void smc_rec_attest_sign(unsigned long rec_addr,
+			 struct smc_result *res)
+{
+	struct granule *g_rec;
+	struct rec *rec;
+
+	/* The REC must not run while its token is being signed */
+	g_rec = find_lock_unused_granule(rec_addr, GRANULE_STATE_REC);
+	if (ptr_is_err(g_rec)) {
+		res->x[0] = (unsigned long)ptr_status(g_rec);
+		return;
+	}
+
+	atomic_granule_get(g_rec);
+	granule_unlock(g_rec);
+
+	rec = granule_map(g_rec, SLOT_REC);
+
+	if (rec->token_sign_ctx.state != ATTEST_SIGN_IN_PROGRESS) {
+		res->x[0] = RMI_ERROR_REC;
+	} else {
+		rec->aux_data.aux = NULL;
+		rec->aux_data.attest_heap_buf = NULL;
+		rec_attest_heap_map(rec);
+		res->x[1] = handle_rmi_attest_token_sign(rec) ? 1UL : 0UL;
+		rec_attest_heap_unmap(rec);
+		res->x[0] = RMI_SUCCESS;
+	}
+
+	buffer_unmap(rec);
+	atomic_granule_put_release(g_rec);
+}
@@ -4,13 +4,20 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <assert.h>
+#include <attestation_export.h>
 #include <buffer.h>
+#include <cpuid.h>
 #include <granule.h>
+#include <job.h>
 #include <measurement.h>
+#include <mecid.h>
+#include <percpu.h>
 #include <realm.h>
 #include <ripas.h>
 #include <smc-handler.h>
 #include <smc-rmi.h>
+#include <sizes.h>
 #include <smc.h>
 #include <stddef.h>
 #include <string.h>
@@ -33,6 +40,69 @@ static bool validate_map_addr(unsigned long map_addr,
 	return true;
 }
 
+/*
+ * Per CPU NS granule set by RMI_RTT_WALK_HINT, to which rtt_walk_error()
+ * writes the RTTs missing for the walk of a failed command, or 0.
+ */
+static unsigned long rtt_walk_hint_addr[MAX_CPUS];
+
+/*
+ * Implements RMI_RTT_WALK_HINT. @addr is the NS granule, or 0 to stop
+ * writing the hints of the commands run on this CPU.
+ */
+unsigned long smc_rtt_walk_hint(unsigned long addr)
+{
+	struct granule *g;
+
+	if (addr != 0UL) {
+		g = find_granule(addr);
+		if ((g == NULL) || (g->state != GRANULE_STATE_NS)) {
+			return RMI_ERROR_INPUT;
+		}
+	}
+
+	rtt_walk_hint_addr[my_cpuid()] = addr;
+	return RMI_SUCCESS;
+}
+
+/*
+ * Return RMI_ERROR_RTT for the walk @wi of @map_addr, which stopped above
+ * @level. If the Host has set a walk hint granule for this CPU, the RTTs to
+ * create for the walk to reach @level are written to it first, so that the
+ * Host can create them all before retrying the command.
+ */
+static unsigned long rtt_walk_error(const struct rtt_walk *wi,
+				    unsigned long map_addr, long level)
+{
+	unsigned long addr = rtt_walk_hint_addr[my_cpuid()];
+	struct rmi_rtt_walk_hint hint = { 0 };
+	struct granule *g;
+
+	assert(wi->last_level < level);
+
+	if (addr != 0UL) {
+		hint.map_addr = map_addr;
+
+		for (long l = wi->last_level + 1L; (l <= level) &&
+		     (hint.nr_rtts < RMI_RTT_WALK_HINT_LEN); l++) {
+			hint.rtts[hint.nr_rtts].map_addr = map_addr &
+				~(s2tte_map_size((int)(l - 1L)) - 1UL);
+			hint.rtts[hint.nr_rtts].level = (unsigned long)l;
+			hint.nr_rtts++;
+		}
+
+		/* The granule may have been delegated since it was set */
+		g = find_granule(addr);
+		if (g->state == GRANULE_STATE_NS) {
+			(void)ns_buffer_write(SLOT_NS, g, 0U,
+					      (unsigned int)sizeof(hint),
+					      &hint);
+		}
+	}
+
+	return pack_return_code(RMI_ERROR_RTT, (unsigned int)wi->last_level);
+}
+
 /*
  * Structure commands can operate on all RTTs except for the root RTT so
  * the minimal valid level is the stage 2 starting level + 1.
@@ -78,6 +148,108 @@ static bool validate_rtt_entry_cmds(unsigned long map_addr,
 	return validate_map_addr(map_addr, level, rd);
 }
 
+/*
+ * Initialise the new RTT @g_tbl at @rtt_addr, mapped at @s2tt, from the
+ * s2tte at @index of its parent RTT @g_llt, mapped at @parent_s2tt, and link
+ * it there to translate @map_addr at @level. Both RTTs must be locked, and
+ * the rd must be mapped at @rd.
+ *
+ * On RMI_SUCCESS, @g_tbl is in GRANULE_STATE_RTT.
+ */
+static unsigned long rtt_link(struct rd *rd,
+			      const struct realm_s2_context *s2_ctx,
+			      struct granule *g_llt,
+			      unsigned long *parent_s2tt,
+			      unsigned long index,
+			      struct granule *g_tbl,
+			      unsigned long *s2tt,
+			      unsigned long rtt_addr,
+			      unsigned long map_addr,
+			      long level)
+{
+	unsigned long parent_s2tte = s2tte_read(&parent_s2tt[index]);
+	unsigned long cls = s2tte_classify(parent_s2tte, level - 1L);
+	unsigned long block_pa = s2tte_class_pa(cls);
+
+	switch (s2tte_class_type(cls)) {
+	case S2TTE_TYPE_UNASSIGNED:
+		/*
+		 * Note that if map_addr is an Unprotected IPA, the RIPAS field
+		 * is guaranteed to be zero, in both parent and child s2ttes.
+		 */
+		s2tt_init_unassigned(s2tt, s2tte_class_ripas(cls));
+
+		/*
+		 * Increase the refcount of the parent, the granule was
+		 * locked while table walking and hand-over-hand locking.
+		 * Atomicity and acquire/release semantics not required because
+		 * the table is accessed always locked.
+		 */
+		__granule_get(g_llt);
+		break;
+	case S2TTE_TYPE_DESTROYED:
+		s2tt_init_destroyed(s2tt);
+		__granule_get(g_llt);
+		break;
+	case S2TTE_TYPE_ASSIGNED:
+		/*
+		 * We should observe parent assigned s2tte only when
+		 * we create tables above this level.
+		 */
+		assert(level > RTT_MIN_BLOCK_LEVEL);
+
+		s2tt_init_assigned_empty(s2tt, block_pa, level);
+
+		/*
+		 * Increase the refcount to mark the granule as in-use. refcount
+		 * is incremented by S2TTES_PER_S2TT (ref RTT unfolding).
+		 */
+		__granule_refcount_inc(g_tbl, S2TTES_PER_S2TT);
+		break;
+	case S2TTE_TYPE_VALID:
+	case S2TTE_TYPE_VALID_NS:
+		/*
+		 * We should observe parent valid or valid_ns s2tte only when
+		 * we create tables above this level.
+		 */
+		assert(level > RTT_MIN_BLOCK_LEVEL);
+
+		/*
+		 * Break before make. This may cause spurious S2 aborts.
+		 */
+		s2tte_write(&parent_s2tt[index], 0UL);
+		invalidate_block(s2_ctx, map_addr);
+
+		if (s2tte_class_type(cls) == S2TTE_TYPE_VALID) {
+			s2tt_init_valid(s2tt, block_pa, level);
+		} else {
+			s2tt_init_valid_ns(s2tt, block_pa, level);
+		}
+
+		/*
+		 * Increase the refcount to mark the granule as in-use. refcount
+		 * is incremented by S2TTES_PER_S2TT (ref RTT unfolding).
+		 */
+		__granule_refcount_inc(g_tbl, S2TTES_PER_S2TT);
+		break;
+	case S2TTE_TYPE_TABLE:
+		return pack_return_code(RMI_ERROR_RTT,
+					(unsigned int)(level - 1L));
+	default:
+		assert(false);
+	}
+
+	/* All the entries of the new RTT have been written */
+	granule_clear_needs_scrub(g_tbl);
+	granule_set_state(g_tbl, GRANULE_STATE_RTT);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_RTT, 1L);
+
+	parent_s2tte = s2tte_create_table(rtt_addr, level - 1L);
+	s2tte_write(&parent_s2tt[index], parent_s2tte);
+
+	return RMI_SUCCESS;
+}
+
 unsigned long smc_rtt_create(unsigned long rtt_addr,
 			     unsigned long rd_addr,
 			     unsigned long map_addr,
@@ -88,12 +260,12 @@ unsigned long smc_rtt_create(unsigned long rtt_addr,
 	struct rd *rd;
 	struct granule *g_table_root;
 	struct rtt_walk wi;
-	unsigned long *s2tt, *parent_s2tt, parent_s2tte;
+	struct granule *g_tbls[2];
+	const enum buffer_slot tbl_slots[2] = { SLOT_RTT, SLOT_DELEGATED };
+	void *tbls[2];
 	long level = (long)ulevel;
-	unsigned long ipa_bits;
 	unsigned long ret;
 	struct realm_s2_context s2_ctx;
-	int sl;
 
 	if (!find_lock_two_granules(rtt_addr,
 				    GRANULE_STATE_DELEGATED,
@@ -114,10 +286,7 @@ unsigned long smc_rtt_create(unsigned long rtt_addr,
 	}
 
 	g_table_root = rd->s2_ctx.g_rtt;
-	sl = realm_rtt_starting_level(rd);
-	ipa_bits = realm_ipa_bits(rd);
 	s2_ctx = rd->s2_ctx;
-	buffer_unmap(rd);
 
 	/*
 	 * Lock the RTT root. Enforcing locking order RD->RTT is enough to
@@ -125,176 +294,177 @@ unsigned long smc_rtt_create(unsigned long rtt_addr,
 	 */
 	granule_lock(g_table_root, GRANULE_STATE_RTT);
 
-	/* Unlock RD after locking RTT Root */
+	/*
+	 * Unlock RD after locking RTT Root. The rd stays mapped to account
+	 * for the new RTT: the Realm cannot be destroyed while one of its
+	 * RTTs is locked.
+	 */
 	granule_unlock(g_rd);
 
-	rtt_walk_lock_unlock(g_table_root, sl, ipa_bits,
-				map_addr, level - 1L, &wi);
+	rtt_walk_lock_unlock_ctx(&s2_ctx, map_addr, level - 1L, &wi);
 	if (wi.last_level != level - 1L) {
-		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
+		ret = rtt_walk_error(&wi, map_addr, level - 1L);
 		goto out_unlock_llt;
 	}
 
-	parent_s2tt = granule_map(wi.g_llt, SLOT_RTT);
-	parent_s2tte = s2tte_read(&parent_s2tt[wi.index]);
-	s2tt = granule_map(g_tbl, SLOT_DELEGATED);
-
-	if (s2tte_is_unassigned(parent_s2tte)) {
-		/*
-		 * Note that if map_addr is an Unprotected IPA, the RIPAS field
-		 * is guaranteed to be zero, in both parent and child s2ttes.
-		 */
-		enum ripas ripas = s2tte_get_ripas(parent_s2tte);
-
-		s2tt_init_unassigned(s2tt, ripas);
-
-		/*
-		 * Increase the refcount of the parent, the granule was
-		 * locked while table walking and hand-over-hand locking.
-		 * Atomicity and acquire/release semantics not required because
-		 * the table is accessed always locked.
-		 */
-		__granule_get(wi.g_llt);
+	g_tbls[0] = wi.g_llt;
+	g_tbls[1] = g_tbl;
+	granule_map_group(g_tbls, tbl_slots, 2U, tbls);
 
-	} else if (s2tte_is_destroyed(parent_s2tte)) {
-		s2tt_init_destroyed(s2tt);
-		__granule_get(wi.g_llt);
+	ret = rtt_link(rd, &s2_ctx, wi.g_llt, tbls[0], wi.index,
+		       g_tbl, tbls[1], rtt_addr, map_addr, level);
 
-	} else if (s2tte_is_assigned(parent_s2tte, level - 1L)) {
-		unsigned long block_pa;
+	buffer_unmap_group(tbls, 2U);
+out_unlock_llt:
+	granule_unlock(wi.g_llt);
+	granule_unlock(g_tbl);
+	buffer_unmap(rd);
+	return ret;
+}
 
-		/*
-		 * We should observe parent assigned s2tte only when
-		 * we create tables above this level.
-		 */
-		assert(level > RTT_MIN_BLOCK_LEVEL);
+/*
+ * Create the RTTs missing to translate @map_addr down to @ulevel, with a
+ * single walk. The RTTs at @rtt_addr0.. are used in turn for the missing
+ * levels, from the top.
+ *
+ * On return, ret->x[1] holds the level of the deepest RTT which translates
+ * @map_addr and ret->x[2] the number of RTTs created. ret->x[0] is
+ * RMI_SUCCESS if an RTT at @ulevel translates @map_addr, and reports why
+ * the next RTT could not be created otherwise.
+ */
+void smc_rtt_create_multi(unsigned long rd_addr,
+			  unsigned long map_addr,
+			  unsigned long ulevel,
+			  unsigned long rtt_addr0,
+			  unsigned long rtt_addr1,
+			  unsigned long rtt_addr2,
+			  struct smc_result *ret)
+{
+	struct granule_set g[RMI_RTT_CREATE_MULTI_LEN + 1U] = {
+		{rtt_addr0, GRANULE_STATE_DELEGATED, NULL},
+		{rtt_addr1, GRANULE_STATE_DELEGATED, NULL},
+		{rtt_addr2, GRANULE_STATE_DELEGATED, NULL}
+	};
+	const enum buffer_slot tbl_slots[2] = { SLOT_RTT, SLOT_DELEGATED };
+	struct granule *g_tbls[2];
+	void *tbls[2];
+	struct granule *g_rd;
+	struct rd *rd;
+	struct rtt_walk wi;
+	struct realm_s2_context s2_ctx;
+	long level = (long)ulevel;
+	unsigned int nr_rtts = 0U;
+	unsigned int i;
 
-		block_pa = s2tte_pa(parent_s2tte, level - 1L);
+	ret->x[1] = 0UL;
+	ret->x[2] = 0UL;
 
-		s2tt_init_assigned_empty(s2tt, block_pa, level);
+	while ((nr_rtts < RMI_RTT_CREATE_MULTI_LEN) &&
+	       (g[nr_rtts].addr != 0UL)) {
+		nr_rtts++;
+	}
 
-		/*
-		 * Increase the refcount to mark the granule as in-use. refcount
-		 * is incremented by S2TTES_PER_S2TT (ref RTT unfolding).
-		 */
-		__granule_refcount_inc(g_tbl, S2TTES_PER_S2TT);
+	/* The RD is put next to the RTTs to be locked with them */
+	g[nr_rtts].addr = rd_addr;
+	g[nr_rtts].state = GRANULE_STATE_RD;
 
-	} else if (s2tte_is_valid(parent_s2tte, level - 1L)) {
-		unsigned long block_pa;
+	if ((nr_rtts == 0U) || !find_lock_granules(g, nr_rtts + 1U)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
 
-		/*
-		 * We should observe parent valid s2tte only when
-		 * we create tables above this level.
-		 */
-		assert(level > RTT_MIN_BLOCK_LEVEL);
+	g_rd = g[nr_rtts].g;
+	rd = granule_map(g_rd, SLOT_RD);
 
-		/*
-		 * Break before make. This may cause spurious S2 aborts.
-		 */
-		s2tte_write(&parent_s2tt[wi.index], 0UL);
-		invalidate_block(&s2_ctx, map_addr);
+	if (!validate_rtt_structure_cmds(map_addr, level, rd)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		for (i = 0U; i < nr_rtts; i++) {
+			granule_unlock(g[i].g);
+		}
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
 
-		block_pa = s2tte_pa(parent_s2tte, level - 1L);
+	s2_ctx = rd->s2_ctx;
 
-		s2tt_init_valid(s2tt, block_pa, level);
+	/* Same locking sequence as RMI_RTT_CREATE */
+	granule_lock(s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	granule_unlock(g_rd);
 
-		/*
-		 * Increase the refcount to mark the granule as in-use. refcount
-		 * is incremented by S2TTES_PER_S2TT (ref RTT unfolding).
-		 */
-		__granule_refcount_inc(g_tbl, S2TTES_PER_S2TT);
+	rtt_walk_lock_unlock_ctx(&s2_ctx, map_addr, level - 1L, &wi);
 
-	} else if (s2tte_is_valid_ns(parent_s2tte, level - 1L)) {
-		unsigned long block_pa;
+	ret->x[0] = RMI_SUCCESS;
 
-		/*
-		 * We should observe parent valid_ns s2tte only when
-		 * we create tables above this level.
-		 */
-		assert(level > RTT_MIN_BLOCK_LEVEL);
+	/* Each new RTT is linked below the previous one, still locked */
+	for (i = 0U; (i < nr_rtts) && (wi.last_level < level); i++) {
+		long new_level = wi.last_level + 1L;
 
-		/*
-		 * Break before make. This may cause spurious S2 aborts.
-		 */
-		s2tte_write(&parent_s2tt[wi.index], 0UL);
-		invalidate_block(&s2_ctx, map_addr);
+		g_tbls[0] = wi.g_llt;
+		g_tbls[1] = g[i].g;
+		granule_map_group(g_tbls, tbl_slots, 2U, tbls);
 
-		block_pa = s2tte_pa(parent_s2tte, level - 1L);
+		ret->x[0] = rtt_link(rd, &s2_ctx, wi.g_llt, tbls[0], wi.index,
+				     g[i].g, tbls[1], g[i].addr, map_addr,
+				     new_level);
 
-		s2tt_init_valid_ns(s2tt, block_pa, level);
+		buffer_unmap_group(tbls, 2U);
 
-		/*
-		 * Increase the refcount to mark the granule as in-use. refcount
-		 * is incremented by S2TTES_PER_S2TT (ref RTT unfolding).
-		 */
-		__granule_refcount_inc(g_tbl, S2TTES_PER_S2TT);
+		if (ret->x[0] != RMI_SUCCESS) {
+			break;
+		}
 
-	} else if (s2tte_is_table(parent_s2tte, level - 1L)) {
-		ret = pack_return_code(RMI_ERROR_RTT,
-					(unsigned int)(level - 1L));
-		goto out_unmap_table;
+		granule_unlock(wi.g_llt);
+		wi.g_llt = g[i].g;
+		wi.last_level = new_level;
+		wi.index = s2_addr_to_idx(map_addr, new_level);
+	}
 
-	} else {
-		assert(false);
+	if ((ret->x[0] == RMI_SUCCESS) && (wi.last_level < level)) {
+		/* Not enough RTTs were given to reach @level */
+		ret->x[0] = rtt_walk_error(&wi, map_addr, level);
 	}
 
-	ret = RMI_SUCCESS;
+	ret->x[1] = (unsigned long)wi.last_level;
+	ret->x[2] = i;
 
-	granule_set_state(g_tbl, GRANULE_STATE_RTT);
+	granule_unlock(wi.g_llt);
 
-	parent_s2tte = s2tte_create_table(rtt_addr, level - 1L);
-	s2tte_write(&parent_s2tt[wi.index], parent_s2tte);
+	/* Unlock the RTTs which have not been used */
+	for (; i < nr_rtts; i++) {
+		granule_unlock(g[i].g);
+	}
 
-out_unmap_table:
-	buffer_unmap(s2tt);
-	buffer_unmap(parent_s2tt);
-out_unlock_llt:
-	granule_unlock(wi.g_llt);
-	granule_unlock(g_tbl);
-	return ret;
+	buffer_unmap(rd);
 }
 
-unsigned long smc_rtt_fold(unsigned long rtt_addr,
-			   unsigned long rd_addr,
-			   unsigned long map_addr,
-			   unsigned long ulevel)
+/*
+ * Fold the RTT at @rtt_addr, which translates @map_addr at @level, into its
+ * parent s2tte.
+ *
+ * The rd must be mapped at @rd, which need not be locked. The root RTT of the
+ * Realm must be locked by the caller and is unlocked on return.
+ */
+static unsigned long rtt_fold(struct rd *rd,
+			      unsigned long rtt_addr,
+			      unsigned long map_addr,
+			      long level)
 {
-	struct granule *g_rd;
+	const struct realm_s2_context *s2_ctx = &rd->s2_ctx;
 	struct granule *g_tbl;
-	struct rd *rd;
-	struct granule *g_table_root;
+	struct granule *g_table_root = s2_ctx->g_rtt;
 	struct rtt_walk wi;
 	unsigned long *table, *parent_s2tt, parent_s2tte;
-	long level = (long)ulevel;
-	unsigned long ipa_bits;
 	unsigned long ret;
-	struct realm_s2_context s2_ctx;
-	int sl;
 	enum ripas ripas;
 
-	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
-	if (g_rd == NULL) {
-		return RMI_ERROR_INPUT;
-	}
-
-	rd = granule_map(g_rd, SLOT_RD);
-
-	if (!validate_rtt_structure_cmds(map_addr, level, rd)) {
-		buffer_unmap(rd);
-		granule_unlock(g_rd);
-		return RMI_ERROR_INPUT;
-	}
-
-	g_table_root = rd->s2_ctx.g_rtt;
-	sl = realm_rtt_starting_level(rd);
-	ipa_bits = realm_ipa_bits(rd);
-	s2_ctx = rd->s2_ctx;
-	buffer_unmap(rd);
-	granule_lock(g_table_root, GRANULE_STATE_RTT);
-	granule_unlock(g_rd);
+	/*
+	 * The RTT may be unlinked below, invalidate the walk cache while
+	 * holding the lock on the RTT root.
+	 */
+	rtt_walk_cache_invalidate();
 
-	rtt_walk_lock_unlock(g_table_root, sl, ipa_bits,
-				map_addr, level - 1L, &wi);
+	rtt_walk_lock_unlock_ctx(s2_ctx, map_addr, level - 1L, &wi);
 	if (wi.last_level != level - 1UL) {
 		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
 		goto out_unlock_parent_table;
@@ -312,7 +482,8 @@ unsigned long smc_rtt_fold(unsigned long rtt_addr,
 	 * Check that the 'rtt_addr' RTT is used at (map_addr, level).
 	 * Note that this also verifies that the rtt_addr is properly aligned.
 	 */
-	if (rtt_addr != s2tte_pa_table(parent_s2tte, level - 1L)) {
+	if ((rtt_addr != s2tte_pa_table(parent_s2tte, level - 1L)) ||
+	    s2tte_is_shared_table(parent_s2tte, level - 1L)) {
 		ret = pack_return_code(RMI_ERROR_RTT,
 					(unsigned int)(level - 1L));
 		goto out_unmap_parent_table;
@@ -378,10 +549,17 @@ unsigned long smc_rtt_fold(unsigned long rtt_addr,
 		/*
 		 * The table must also refer to a contiguous block through
 		 * the same type of s2tte, either Assigned, Valid  or Valid_NS.
+		 *
+		 * DATA granules are only mapped by blocks up to
+		 * RTT_DATA_BLOCK_LEVEL, so that RMI_DATA_DESTROY and the
+		 * teardown of the realm can always release a block in one
+		 * call. Only Valid_NS blocks are created above it.
 		 */
-		if (table_maps_assigned_block(table, level)) {
+		if ((level > RTT_DATA_BLOCK_LEVEL) &&
+		    table_maps_assigned_block(table, level)) {
 			parent_s2tte = s2tte_create_assigned_empty(block_pa, level - 1L);
-		} else if (table_maps_valid_block(table, level)) {
+		} else if ((level > RTT_DATA_BLOCK_LEVEL) &&
+			   table_maps_valid_block(table, level)) {
 			parent_s2tte = s2tte_create_valid(block_pa, level - 1L);
 		} else if (table_maps_valid_ns_block(table, level)) {
 			parent_s2tte = s2tte_create_valid_ns(block_pa, level - 1L);
@@ -409,15 +587,17 @@ unsigned long smc_rtt_fold(unsigned long rtt_addr,
 
 	if (s2tte_is_valid(parent_s2tte, level - 1L) ||
 	    s2tte_is_valid_ns(parent_s2tte, level - 1L)) {
-		invalidate_pages_in_block(&s2_ctx, map_addr);
+		invalidate_pages_in_block(s2_ctx, map_addr, level - 1L);
 	} else {
-		invalidate_block(&s2_ctx, map_addr);
+		invalidate_table(s2_ctx, map_addr);
 	}
 
 	s2tte_write(&parent_s2tt[wi.index], parent_s2tte);
+	rtt_wait_lockless_walkers(g_table_root);
 
 	granule_memzero_mapped(table);
 	granule_set_state(g_tbl, GRANULE_STATE_DELEGATED);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_RTT, -1L);
 
 out_unmap_table:
 	buffer_unmap(table);
@@ -429,23 +609,15 @@ out_unlock_parent_table:
 	return ret;
 }
 
-unsigned long smc_rtt_destroy(unsigned long rtt_addr,
-			      unsigned long rd_addr,
-			      unsigned long map_addr,
-			      unsigned long ulevel)
+unsigned long smc_rtt_fold(unsigned long rtt_addr,
+			   unsigned long rd_addr,
+			   unsigned long map_addr,
+			   unsigned long ulevel)
 {
 	struct granule *g_rd;
-	struct granule *g_tbl;
 	struct rd *rd;
-	struct granule *g_table_root;
-	struct rtt_walk wi;
-	unsigned long *table, *parent_s2tt, parent_s2tte;
 	long level = (long)ulevel;
-	unsigned long ipa_bits;
 	unsigned long ret;
-	struct realm_s2_context s2_ctx;
-	int sl;
-	bool in_par;
 
 	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
 	if (g_rd == NULL) {
@@ -460,658 +632,3462 @@ unsigned long smc_rtt_destroy(unsigned long rtt_addr,
 		return RMI_ERROR_INPUT;
 	}
 
-	g_table_root = rd->s2_ctx.g_rtt;
-	sl = realm_rtt_starting_level(rd);
-	ipa_bits = realm_ipa_bits(rd);
-	s2_ctx = rd->s2_ctx;
-	in_par = addr_in_par(rd, map_addr);
-	buffer_unmap(rd);
-	granule_lock(g_table_root, GRANULE_STATE_RTT);
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
 	granule_unlock(g_rd);
 
-	rtt_walk_lock_unlock(g_table_root, sl, ipa_bits,
-				map_addr, level - 1L, &wi);
-	if (wi.last_level != level - 1UL) {
-		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
-		goto out_unlock_parent_table;
-	}
-
-	parent_s2tt = granule_map(wi.g_llt, SLOT_RTT);
-	parent_s2tte = s2tte_read(&parent_s2tt[wi.index]);
-	if (!s2tte_is_table(parent_s2tte, level - 1L)) {
-		ret = pack_return_code(RMI_ERROR_RTT,
-					(unsigned int)(level - 1L));
-		goto out_unmap_parent_table;
-	}
-
 	/*
-	 * Check that the 'rtt_addr' RTT is used at (map_addr, level).
-	 * Note that this also verifies that the rtt_addr is properly aligned.
+	 * The rd stays mapped to account for the folded RTT. The Realm
+	 * cannot be destroyed while rtt_fold() holds one of its RTTs locked.
 	 */
-	if (rtt_addr != s2tte_pa_table(parent_s2tte, level - 1L)) {
-		ret = RMI_ERROR_INPUT;
-		goto out_unmap_parent_table;
-	}
+	ret = rtt_fold(rd, rtt_addr, map_addr, level);
+	buffer_unmap(rd);
 
-	/*
-	 * Lock the RTT granule. The 'rtt_addr' is verified, thus can be treated
-	 * as an internal granule.
-	 */
-	g_tbl = find_lock_granule(rtt_addr, GRANULE_STATE_RTT);
+	return ret;
+}
 
-	/*
-	 * A table descriptor S2TTE always points to a TABLE granule.
-	 */
-	assert(g_tbl != NULL);
+/*
+ * Fold the last level RTT at @rtt_addr, which translates @map_addr, if the
+ * realm has enabled automatic folding and the RTT can be folded. The freed
+ * RTT is added to the reclaim list of the realm. If the list is full, the
+ * fold is skipped and counted, see RMI_RTT_RECLAIM.
+ *
+ * The RD granule must be locked and mapped at @rd, and no RTT lock may be
+ * held by the caller.
+ */
+static void rtt_auto_fold(struct rd *rd, unsigned long rtt_addr,
+			  unsigned long map_addr)
+{
+	unsigned long block_addr;
 
-	/*
-	 * Read the refcount value. RTT granule is always accessed locked, thus
-	 * the refcount can be accessed without atomic operations.
-	 */
-	if (g_tbl->refcount != 0UL) {
-		ret = RMI_ERROR_IN_USE;
-		goto out_unlock_table;
+	if (!rd->auto_fold) {
+		return;
 	}
 
-	ret = RMI_SUCCESS;
-
-	table = granule_map(g_tbl, SLOT_RTT2);
-
-	if (in_par) {
-		parent_s2tte = s2tte_create_destroyed();
-	} else {
-		parent_s2tte = s2tte_create_invalid_ns();
+	if (rd->nr_reclaim_rtts == RTT_RECLAIM_LIST_LEN) {
+		rd->nr_skipped_folds++;
+		return;
 	}
 
-	__granule_put(wi.g_llt);
-
-	/*
-	 * Break before make. Note that this may cause spurious S2 aborts.
-	 */
-	s2tte_write(&parent_s2tt[wi.index], 0UL);
-	invalidate_block(&s2_ctx, map_addr);
-	s2tte_write(&parent_s2tt[wi.index], parent_s2tte);
-
-	granule_memzero_mapped(table);
-	granule_set_state(g_tbl, GRANULE_STATE_DELEGATED);
+	block_addr = map_addr & ~(s2tte_map_size(RTT_PAGE_LEVEL - 1) - 1UL);
 
-	buffer_unmap(table);
-out_unlock_table:
-	granule_unlock(g_tbl);
-out_unmap_parent_table:
-	buffer_unmap(parent_s2tt);
-out_unlock_parent_table:
-	granule_unlock(wi.g_llt);
-	return ret;
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	if (rtt_fold(rd, rtt_addr, block_addr,
+		     RTT_PAGE_LEVEL) == RMI_SUCCESS) {
+		rd->reclaim_rtts[rd->nr_reclaim_rtts++] = rtt_addr;
+	}
 }
 
-enum map_unmap_ns_op {
-	MAP_NS,
-	UNMAP_NS
-};
-
-/*
- * We don't hold a reference on the NS granule when it is
- * mapped into a realm. Instead we rely on the guarantees
- * provided by the architecture to ensure that a NS access
- * to a protected granule is prohibited even within the realm.
- */
-static unsigned long map_unmap_ns(unsigned long rd_addr,
-				  unsigned long map_addr,
-				  long level,
-				  unsigned long host_s2tte,
-				  enum map_unmap_ns_op op)
+void smc_rtt_reclaim(unsigned long rd_addr, struct smc_result *ret)
 {
 	struct granule *g_rd;
 	struct rd *rd;
-	struct granule *g_table_root;
-	unsigned long *s2tt, s2tte;
-	struct rtt_walk wi;
-	unsigned long ipa_bits;
-	unsigned long ret;
-	struct realm_s2_context s2_ctx;
-	int sl;
 
 	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
 	if (g_rd == NULL) {
-		return RMI_ERROR_INPUT;
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
 	}
 
 	rd = granule_map(g_rd, SLOT_RD);
 
-	if (!validate_rtt_map_cmds(map_addr, level, rd)) {
-		buffer_unmap(rd);
-		granule_unlock(g_rd);
-		return RMI_ERROR_INPUT;
-	}
-
-	g_table_root = rd->s2_ctx.g_rtt;
-	sl = realm_rtt_starting_level(rd);
-	ipa_bits = realm_ipa_bits(rd);
-
-	/*
-	 * We don't have to check PAR boundaries for unmap_ns
-	 * operation because we already test that the s2tte is Valid_NS
-	 * and only outside-PAR IPAs can be translated by such s2tte.
-	 *
-	 * For "map_ns", however, the s2tte is verified to be Unassigned
-	 * but both inside & outside PAR IPAs can be translated by such s2ttes.
-	 */
-	if ((op == MAP_NS) && addr_in_par(rd, map_addr)) {
-		buffer_unmap(rd);
-		granule_unlock(g_rd);
-		return RMI_ERROR_INPUT;
-	}
+	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = (rd->nr_reclaim_rtts == 0U) ? 0UL :
+			rd->reclaim_rtts[--rd->nr_reclaim_rtts];
+	ret->x[2] = rd->nr_skipped_folds;
+	rd->nr_skipped_folds = 0UL;
 
-	s2_ctx = rd->s2_ctx;
 	buffer_unmap(rd);
-
-	granule_lock(g_table_root, GRANULE_STATE_RTT);
 	granule_unlock(g_rd);
+}
 
-	rtt_walk_lock_unlock(g_table_root, sl, ipa_bits,
-				map_addr, level, &wi);
-	if (wi.last_level != level) {
-		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
-		goto out_unlock_llt;
-	}
+/*
+ * Link an RTT from the RTT pool of the realm @rd below the s2tte at
+ * @wi->index of the RTT @wi->g_llt, which must be locked, if that s2tte is
+ * Unassigned. The RD granule must be locked and mapped at @rd.
+ *
+ * Returns false if the pool is empty or the s2tte is not Unassigned.
+ */
+static bool rtt_pool_link(struct rd *rd, struct rtt_walk *wi)
+{
+	unsigned long *parent_s2tt, parent_s2tte, *s2tt;
+	unsigned long rtt_addr;
+	struct granule *g_tbl;
+	bool linked = false;
 
-	s2tt = granule_map(wi.g_llt, SLOT_RTT);
-	s2tte = s2tte_read(&s2tt[wi.index]);
+	if (rd->nr_rtt_pool == 0U) {
+		return false;
+	}
 
-	if (op == MAP_NS) {
-		if (!s2tte_is_unassigned(s2tte)) {
-			ret = pack_return_code(RMI_ERROR_RTT,
-						(unsigned int)level);
-			goto out_unmap_table;
-		}
+	parent_s2tt = granule_map(wi->g_llt, SLOT_RTT);
+	parent_s2tte = s2tte_read(&parent_s2tt[wi->index]);
 
-		s2tte = s2tte_create_valid_ns(host_s2tte, level);
-		s2tte_write(&s2tt[wi.index], s2tte);
-		__granule_get(wi.g_llt);
+	if (s2tte_is_unassigned(parent_s2tte)) {
+		rtt_addr = rd->rtt_pool[--rd->nr_rtt_pool];
+		g_tbl = addr_to_granule(rtt_addr);
+
+		/* The granules of the pool are only reachable through the rd */
+		granule_lock(g_tbl, GRANULE_STATE_RTT);
+		s2tt = granule_map(g_tbl, SLOT_DELEGATED);
+		s2tt_init_unassigned(s2tt, s2tte_get_ripas(parent_s2tte));
+		buffer_unmap(s2tt);
+		granule_clear_needs_scrub(g_tbl);
+		granule_unlock(g_tbl);
 
-	} else if (op == UNMAP_NS) {
-		/*
-		 * The following check also verifies that map_addr is outside
-		 * PAR, as valid_NS s2tte may only cover outside PAR IPA range.
-		 */
-		if (!s2tte_is_valid_ns(s2tte, level)) {
-			ret = pack_return_code(RMI_ERROR_RTT,
-						(unsigned int)level);
-			goto out_unmap_table;
-		}
+		s2tte_write(&parent_s2tt[wi->index],
+			    s2tte_create_table(rtt_addr, wi->last_level));
+		__granule_get(wi->g_llt);
 
-		s2tte = s2tte_create_invalid_ns();
-		s2tte_write(&s2tt[wi.index], s2tte);
-		__granule_put(wi.g_llt);
-		if (level == RTT_PAGE_LEVEL) {
-			invalidate_page(&s2_ctx, map_addr);
-		} else {
-			invalidate_block(&s2_ctx, map_addr);
-		}
+		rd->rtt_pool_used[rd->nr_rtt_pool_used++] = rtt_addr;
+		linked = true;
 	}
 
-	ret = RMI_SUCCESS;
-
-out_unmap_table:
-	buffer_unmap(s2tt);
-out_unlock_llt:
-	granule_unlock(wi.g_llt);
-	return ret;
+	buffer_unmap(parent_s2tt);
+	return linked;
 }
 
-unsigned long smc_rtt_map_unprotected(unsigned long rd_addr,
+/*
+ * Same as rtt_walk_lock_unlock() from the root RTT of the realm @rd, which
+ * must be locked by the caller, except that the RTTs missing to reach @level
+ * below an Unassigned s2tte are created from the RTT pool of the realm, as
+ * long as it is not empty. The RD granule must be locked and mapped at @rd.
+ */
+static void rtt_walk_lock_unlock_pool(struct rd *rd,
 				      unsigned long map_addr,
-				      unsigned long ulevel,
-				      unsigned long s2tte)
+				      long level,
+				      struct rtt_walk *wi)
 {
-	long level = (long)ulevel;
+	struct granule *g_table_root = rd->s2_ctx.g_rtt;
 
-	if (!host_ns_s2tte_is_valid(s2tte, level)) {
-		return RMI_ERROR_INPUT;
-	}
+	while (true) {
+		rtt_walk_lock_unlock_ctx(&rd->s2_ctx, map_addr, level, wi);
 
-	return map_unmap_ns(rd_addr, map_addr, level, s2tte, MAP_NS);
-}
+		if ((wi->last_level == level) || !rtt_pool_link(rd, wi)) {
+			return;
+		}
 
-unsigned long smc_rtt_unmap_unprotected(unsigned long rd_addr,
-					unsigned long map_addr,
-					unsigned long ulevel)
-{
-	return map_unmap_ns(rd_addr, map_addr, (long)ulevel, 0UL, UNMAP_NS);
+		/* Walk again through the new RTT */
+		granule_unlock(wi->g_llt);
+		granule_lock(g_table_root, GRANULE_STATE_RTT);
+	}
 }
 
-void smc_rtt_read_entry(unsigned long rd_addr,
-			unsigned long map_addr,
-			unsigned long ulevel,
-			struct smc_result *ret)
+/*
+ * Add up to @count DELEGATED granules starting at @base to the RTT pool of
+ * the realm at @rd_addr, stopping at the first granule which is not
+ * DELEGATED or when the pool is full.
+ */
+void smc_rtt_pool_donate(unsigned long rd_addr,
+			 unsigned long base,
+			 unsigned long count,
+			 struct smc_result *ret)
 {
-	struct granule *g_rd, *g_rtt_root;
+	struct granule *g_rd, *g_base;
 	struct rd *rd;
-	struct rtt_walk wi;
-	unsigned long *s2tt, s2tte;
-	unsigned long ipa_bits;
-	long level = (long)ulevel;
-	int sl;
+	unsigned long i;
 
+	ret->x[1] = 0UL;
+
+	if (count > RTT_POOL_LEN) {
+		count = RTT_POOL_LEN;
+	}
+
+	g_base = find_granule_range(base, count);
 	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
-	if (g_rd == NULL) {
+	if ((g_base == NULL) || (g_rd == NULL)) {
+		if (g_rd != NULL) {
+			granule_unlock(g_rd);
+		}
 		ret->x[0] = RMI_ERROR_INPUT;
 		return;
 	}
 
 	rd = granule_map(g_rd, SLOT_RD);
 
-	if (!validate_rtt_entry_cmds(map_addr, level, rd)) {
-		buffer_unmap(rd);
-		granule_unlock(g_rd);
-		ret->x[0] = RMI_ERROR_INPUT;
-		return;
+	for (i = 0UL; (i < count) &&
+	     ((rd->nr_rtt_pool + rd->nr_rtt_pool_used) < RTT_POOL_LEN); i++) {
+		/* The RD is locked, so the granules are not waited on */
+		if (!granule_trylock_on_state_match(&g_base[i],
+						    GRANULE_STATE_DELEGATED)) {
+			break;
+		}
+
+		granule_unlock_transition(&g_base[i], GRANULE_STATE_RTT);
+		rd->rtt_pool[rd->nr_rtt_pool++] = base + (i * GRANULE_SIZE);
 	}
 
-	g_rtt_root = rd->s2_ctx.g_rtt;
-	sl = realm_rtt_starting_level(rd);
-	ipa_bits = realm_ipa_bits(rd);
-	buffer_unmap(rd);
+	/* The granules of the pool are accounted as RTTs of the Realm */
+	realm_footprint_add(rd, RMI_GRANULE_STATE_RTT, (long)i);
 
-	granule_lock(g_rtt_root, GRANULE_STATE_RTT);
+	buffer_unmap(rd);
 	granule_unlock(g_rd);
 
-	rtt_walk_lock_unlock(g_rtt_root, sl, ipa_bits,
-				map_addr, level, &wi);
-	s2tt = granule_map(wi.g_llt, SLOT_RTT);
-	s2tte = s2tte_read(&s2tt[wi.index]);
-	ret->x[1] =  wi.last_level;
-	ret->x[3] = 0UL;
-	ret->x[4] = 0UL;
-
-	if (s2tte_is_unassigned(s2tte)) {
-		enum ripas ripas = s2tte_get_ripas(s2tte);
-
-		ret->x[2] = RMI_RTT_STATE_UNASSIGNED;
-		ret->x[4] = (unsigned long)ripas;
-	} else if (s2tte_is_destroyed(s2tte)) {
-		ret->x[2] = RMI_RTT_STATE_DESTROYED;
-	} else if (s2tte_is_assigned(s2tte, wi.last_level)) {
-		ret->x[2] = RMI_RTT_STATE_ASSIGNED;
-		ret->x[3] = s2tte_pa(s2tte, wi.last_level);
-		ret->x[4] = RMI_EMPTY;
-	} else if (s2tte_is_valid(s2tte, wi.last_level)) {
-		ret->x[2] = RMI_RTT_STATE_ASSIGNED;
-		ret->x[3] = s2tte_pa(s2tte, wi.last_level);
-		ret->x[4] = RMI_RAM;
-	} else if (s2tte_is_valid_ns(s2tte, wi.last_level)) {
-		ret->x[2] = RMI_RTT_STATE_VALID_NS;
-		ret->x[3] = host_ns_s2tte(s2tte, wi.last_level);
-	} else if (s2tte_is_table(s2tte, wi.last_level)) {
-		ret->x[2] = RMI_RTT_STATE_TABLE;
-		ret->x[3] = s2tte_pa_table(s2tte, wi.last_level);
-	} else {
-		assert(false);
-	}
-
-	buffer_unmap(s2tt);
-	granule_unlock(wi.g_llt);
-
 	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = i;
 }
 
-static void data_granule_measure(struct rd *rd, void *data,
-				 unsigned long ipa,
-				 unsigned long flags)
+/*
+ * Write the addresses of the granules of the RTT pool of the realm at
+ * @rd_addr which have been linked as RTTs since the previous call to the NS
+ * granule at @list_addr, freeing their room in the pool.
+ */
+void smc_rtt_pool_report(unsigned long rd_addr,
+			 unsigned long list_addr,
+			 struct smc_result *ret)
 {
-	struct measurement_desc_data measure_desc = {0};
+	struct granule *g_rd, *g_list;
+	struct rd *rd;
+	unsigned int nr_used;
 
-	/* Initialize the measurement descriptior structure */
-	measure_desc.desc_type = MEASURE_DESC_TYPE_DATA;
-	measure_desc.len = sizeof(struct measurement_desc_data);
-	measure_desc.ipa = ipa;
-	measure_desc.flags = flags;
-	memcpy(measure_desc.rim,
-	       &rd->measurement[RIM_MEASUREMENT_SLOT],
-	       measurement_get_size(rd->algorithm));
+	g_list = find_granule(list_addr);
+	if ((g_list == NULL) || (g_list->state != GRANULE_STATE_NS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
 
-	if (flags == RMI_MEASURE_CONTENT) {
-		/*
-		 * Hashing the data granules and store the result in the
-		 * measurement descriptor structure.
-		 */
-		measurement_hash_compute(rd->algorithm,
-					data,
-					GRANULE_SIZE,
-					measure_desc.content);
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
 	}
 
-	/*
-	 * Hashing the measurement descriptor structure; the result is the
+	rd = granule_map(g_rd, SLOT_RD);
+
+	nr_used = rd->nr_rtt_pool_used;
+	ret->x[0] = RMI_SUCCESS;
+
+	if ((nr_used != 0U) &&
+	    !ns_buffer_write(SLOT_NS, g_list, 0U,
+			     nr_used * (unsigned int)sizeof(rd->rtt_pool_used[0]),
+			     rd->rtt_pool_used)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		nr_used = 0U;
+	}
+
+	rd->nr_rtt_pool_used -= nr_used;
+	ret->x[1] = nr_used;
+	ret->x[2] = rd->nr_rtt_pool;
+
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+}
+
+/*
+ * Add up to @count DELEGATED granules starting at @base to the DATA pool of
+ * the realm at @rd_addr, stopping at the first granule which is not
+ * DELEGATED or when the pool is full. The granules are zeroed here, so that
+ * mapping them on a stage 2 fault does not have to.
+ */
+void smc_data_pool_donate(unsigned long rd_addr,
+			  unsigned long base,
+			  unsigned long count,
+			  struct smc_result *ret)
+{
+	struct granule *g_rd, *g_base;
+	struct rd *rd;
+	unsigned long i;
+
+	ret->x[1] = 0UL;
+
+	if (count > DATA_POOL_LEN) {
+		count = DATA_POOL_LEN;
+	}
+
+	g_base = find_granule_range(base, count);
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if ((g_base == NULL) || (g_rd == NULL)) {
+		if (g_rd != NULL) {
+			granule_unlock(g_rd);
+		}
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	for (i = 0UL; (i < count) &&
+	     ((rd->nr_data_pool + rd->nr_data_pool_used) < DATA_POOL_LEN);
+	     i++) {
+		/* The RD is locked, so the granules are not waited on */
+		if (!granule_trylock_on_state_match(&g_base[i],
+						    GRANULE_STATE_DELEGATED)) {
+			break;
+		}
+
+		granule_scrub(&g_base[i], SLOT_DELEGATED);
+
+		/*
+		 * The granule is mapped on a fault without any maintenance.
+		 * A Realm with its own memory encryption context must not get
+		 * the zeroed lines written back with the MECID of RMM over
+		 * its data, as for RMI_DATA_CREATE_UNKNOWN.
+		 */
+		if (rd->s2_ctx.mecid != MECID_RMM) {
+			granule_mec_clean(&g_base[i]);
+		}
+		granule_unlock_transition(&g_base[i], GRANULE_STATE_DATA);
+		rd->data_pool[rd->nr_data_pool++] = base + (i * GRANULE_SIZE);
+	}
+
+	/* The granules of the pool are accounted as DATA of the Realm */
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, (long)i);
+
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+
+	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = i;
+}
+
+/*
+ * Write the IPAs and addresses of the granules of the DATA pool of the realm
+ * at @rd_addr which have been mapped since the previous call to the NS
+ * granule at @list_addr, freeing their room in the pool.
+ */
+void smc_data_pool_report(unsigned long rd_addr,
+			  unsigned long list_addr,
+			  struct smc_result *ret)
+{
+	struct granule *g_rd, *g_list;
+	struct rd *rd;
+	unsigned int nr_used;
+
+	g_list = find_granule(list_addr);
+	if ((g_list == NULL) || (g_list->state != GRANULE_STATE_NS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	nr_used = rd->nr_data_pool_used;
+	ret->x[0] = RMI_SUCCESS;
+
+	if ((nr_used != 0U) &&
+	    !ns_buffer_write(SLOT_NS, g_list, 0U,
+			     nr_used *
+			     (unsigned int)sizeof(rd->data_pool_used[0]),
+			     rd->data_pool_used)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		nr_used = 0U;
+	}
+
+	rd->nr_data_pool_used -= nr_used;
+	ret->x[1] = nr_used;
+	ret->x[2] = rd->nr_data_pool;
+
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+}
+
+/*
+ * Map a granule of the DATA pool of the Realm of @rec at the Protected IPA
+ * @ipa, on a stage 2 translation fault of the REC, if its s2tte is
+ * Unassigned with RIPAS RAM. The RTTs missing to reach the page level are
+ * created from the RTT pool. No TLB invalidation is needed as the s2tte
+ * was not valid.
+ *
+ * Returns true if the granule is mapped, in which case the REC can retry
+ * the access without exiting to the Host.
+ */
+bool realm_data_pool_map(struct rec *rec, unsigned long ipa)
+{
+	struct rd *rd = rec->rd;
+	struct rtt_walk wi;
+	unsigned long *s2tt, s2tte, data_addr;
+	bool mapped = false;
+
+	assert(GRANULE_ALIGNED(ipa));
+
+	granule_lock(rec->realm_info.g_rd, GRANULE_STATE_RD);
+
+	if (rd->nr_data_pool == 0U) {
+		goto out_unlock_rd;
+	}
+
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	rtt_walk_lock_unlock_pool(rd, ipa, RTT_PAGE_LEVEL, &wi);
+	if (wi.last_level != RTT_PAGE_LEVEL) {
+		goto out_unlock_llt;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	s2tte = s2tte_read(&s2tt[wi.index]);
+
+	if (s2tte_is_unassigned(s2tte) &&
+	    (s2tte_get_ripas(s2tte) == RMI_RAM)) {
+		data_addr = rd->data_pool[--rd->nr_data_pool];
+
+		s2tte_write(&s2tt[wi.index],
+			    s2tte_create_valid(data_addr, RTT_PAGE_LEVEL));
+		__granule_get(wi.g_llt);
+
+		rd->data_pool_used[rd->nr_data_pool_used].ipa = ipa;
+		rd->data_pool_used[rd->nr_data_pool_used].addr = data_addr;
+		rd->nr_data_pool_used++;
+		mapped = true;
+	}
+
+	buffer_unmap(s2tt);
+out_unlock_llt:
+	granule_unlock(wi.g_llt);
+out_unlock_rd:
+	granule_unlock(rec->realm_info.g_rd);
+	return mapped;
+}
+
+/*
+ * Give write access back to the s2tte which maps the Protected IPA @ipa, on
+ * a stage 2 permission fault of a write of @rec, if its Realm tracks its
+ * dirty state by write-protection. The s2tte is then reported as dirty by
+ * the next RMI_RTT_SCAN_ACCESS.
+ *
+ * Returns true if the REC can retry the access without exiting to the Host.
+ */
+bool realm_wp_dirty_fault(struct rec *rec, unsigned long ipa)
+{
+	struct rd *rd = rec->rd;
+	struct rtt_walk wi;
+	unsigned long *s2tt;
+	bool handled;
+
+	if (!rd->wp_dirty_enabled) {
+		return false;
+	}
+
+	/* The RTTs of the Realm are not destroyed while it has a REC */
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	rtt_walk_lock_unlock_ctx(&rd->s2_ctx, ipa, RTT_PAGE_LEVEL, &wi);
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	handled = s2tte_set_writable(&s2tt[wi.index], wi.last_level);
+
+	/*
+	 * A valid s2tte which is already writable can still fault while the
+	 * TLBs hold it as write-protected. Drop the stale entries, so that
+	 * the retried access does not fault again.
+	 */
+	if (!handled && s2tte_is_valid(s2tte_read(&s2tt[wi.index]),
+				       wi.last_level)) {
+		invalidate_block(&rd->s2_ctx, ipa);
+		handled = true;
+	}
+	buffer_unmap(s2tt);
+
+	granule_unlock(wi.g_llt);
+	return handled;
+}
+
+/* Number of reclaimed granule addresses buffered before writing them */
+#define TEARDOWN_BUF_LEN	16U
+
+struct realm_teardown {
+	struct granule *g_root;
+	struct granule *g_list;
+	/* Number of addresses written to the NS list */
+	unsigned long count;
+	/* Addresses not yet written to the NS list */
+	unsigned long buf[TEARDOWN_BUF_LEN];
+	unsigned int nr_buf;
+	/* Number of RTTs and data granules freed */
+	unsigned long nr_rtts;
+	unsigned long nr_data;
+	/* MECID of the Realm, see data_granule_release() */
+	unsigned int mecid;
+	/* Budget of the teardown, NULL if the walk is not preemptible */
+	struct rmi_budget *budget;
+	/* Number of addresses after which the walk is preempted, or 0 */
+	unsigned long limit;
+	bool preempted;
+};
+
+/*
+ * Transition the DATA granule @g_data of a Realm with the MECID @mecid, locked
+ * by the caller, to the DELEGATED state.
+ *
+ * The content of the granule is zeroed, unless the Realm has its own memory
+ * encryption context, which no other Realm uses: the content cannot then be
+ * read in any other context, so the granule is only cleaned to the Point of
+ * Encryption. It is marked as needing a scrub, so that it is still zeroed
+ * before RMM or a Realm with MECID_RMM uses it, or the Host gets it back.
+ */
+static void data_granule_release(struct granule *g_data, unsigned int mecid)
+{
+	if (mecid == MECID_RMM) {
+		granule_memzero(g_data, SLOT_DELEGATED);
+	} else {
+		granule_mec_clean(g_data);
+		granule_set_needs_scrub(g_data);
+	}
+	granule_unlock_transition(g_data, GRANULE_STATE_DELEGATED);
+}
+
+static void teardown_flush(struct realm_teardown *td)
+{
+	if (td->nr_buf == 0U) {
+		return;
+	}
+
+	/*
+	 * A failed write only means that the Host loses track of some
+	 * DELEGATED granules, as with any other malformed NS buffer.
+	 */
+	(void)ns_buffer_write(SLOT_NS, td->g_list,
+			      (unsigned int)(td->count * sizeof(td->buf[0])),
+			      td->nr_buf * (unsigned int)sizeof(td->buf[0]),
+			      td->buf);
+	td->count += td->nr_buf;
+	td->nr_buf = 0U;
+}
+
+static void teardown_add(struct realm_teardown *td, unsigned long addr)
+{
+	td->buf[td->nr_buf++] = addr;
+	if (td->nr_buf == TEARDOWN_BUF_LEN) {
+		teardown_flush(td);
+	}
+}
+
+/* A DATA block at RTT_DATA_BLOCK_LEVEL fits in an empty NS list */
+COMPILER_ASSERT(S2TTES_PER_S2TT <= RMI_REALM_TEARDOWN_LIST_LEN);
+
+/* Return true if @nr_granules more addresses fit in the NS list */
+static bool teardown_fits(struct realm_teardown *td, unsigned long nr_granules)
+{
+	return (td->count + td->nr_buf + nr_granules) <=
+		RMI_REALM_TEARDOWN_LIST_LEN;
+}
+
+/*
+ * Return true if the walk should stop to return to the Host, which is only
+ * considered once some granules have been freed so that the teardown always
+ * makes progress.
+ */
+static bool teardown_preempted(struct realm_teardown *td)
+{
+	if ((td->budget == NULL) || ((td->nr_rtts + td->nr_data) == 0UL)) {
+		return false;
+	}
+
+	if (!td->preempted) {
+		td->preempted = ((td->limit != 0UL) &&
+				 ((td->count + td->nr_buf) >= td->limit)) ||
+				rmi_budget_exhausted(td->budget);
+	}
+
+	return td->preempted;
+}
+
+/*
+ * Remove the S2TTEs of the locked RTT @g_tbl at @level, freeing the data
+ * granules and RTTs they point to, until the NS list is full or the walk is
+ * preempted. The TLBs are not invalidated, this is left to the caller.
+ *
+ * Returns true if the RTT no longer holds any S2TTE that needs to be
+ * removed.
+ */
+static bool rtt_teardown(struct realm_teardown *td, struct granule *g_tbl,
+			 long level)
+{
+	unsigned long *s2tt = granule_map(g_tbl, SLOT_RTT);
+	bool empty;
+
+	for (unsigned long i = 0UL;
+	     (i < (unsigned long)S2TTES_PER_S2TT) && (g_tbl->refcount != 0UL);
+	     i++) {
+		unsigned long s2tte, cls;
+		enum s2tte_type type;
+
+		if (teardown_preempted(td)) {
+			break;
+		}
+
+		s2tte = s2tte_read(&s2tt[i]);
+		cls = s2tte_classify(s2tte, level);
+		type = s2tte_class_type(cls);
+
+		if (s2tte_is_shared_table(s2tte, level)) {
+			/* The shared RTT stays with the Host */
+			s2tte_write(&s2tt[i], s2tte_create_invalid_ns());
+			__granule_put(g_tbl);
+			rtt_wait_lockless_walkers(td->g_root);
+			atomic_granule_put(find_granule(s2tte_class_pa(cls)));
+		} else if (type == S2TTE_TYPE_TABLE) {
+			unsigned long rtt_addr = s2tte_class_pa(cls);
+			struct granule *g_child;
+
+			if (!teardown_fits(td, 1UL)) {
+				break;
+			}
+
+			/*
+			 * Only one RTT is mapped at a time, so that the walk
+			 * can go down to the last level with a single slot.
+			 */
+			buffer_unmap(s2tt);
+			g_child = find_lock_granule(rtt_addr, GRANULE_STATE_RTT);
+			assert(g_child != NULL);
+			empty = rtt_teardown(td, g_child, level + 1L);
+			s2tt = granule_map(g_tbl, SLOT_RTT);
+
+			if (!empty || !teardown_fits(td, 1UL)) {
+				granule_unlock(g_child);
+				break;
+			}
+
+			s2tte_write(&s2tt[i], s2tte_create_unassigned(RMI_EMPTY));
+			__granule_put(g_tbl);
+			rtt_wait_lockless_walkers(td->g_root);
+
+			granule_memzero(g_child, SLOT_RTT2);
+			granule_unlock_transition(g_child,
+						  GRANULE_STATE_DELEGATED);
+			teardown_add(td, rtt_addr);
+			td->nr_rtts++;
+		} else if ((type == S2TTE_TYPE_VALID) ||
+			   (type == S2TTE_TYPE_ASSIGNED)) {
+			unsigned long data_addr = s2tte_class_pa(cls);
+			unsigned long nr_granules =
+				s2tte_map_size(level) / GRANULE_SIZE;
+
+			/* See rtt_fold(), it fits in an empty NS list */
+			assert(level >= RTT_DATA_BLOCK_LEVEL);
+
+			if (!teardown_fits(td, nr_granules)) {
+				break;
+			}
+
+			s2tte_write(&s2tt[i], s2tte_create_unassigned(RMI_EMPTY));
+			__granule_put(g_tbl);
+
+			for (unsigned long j = 0UL; j < nr_granules; j++) {
+				unsigned long addr = data_addr +
+						     (j * GRANULE_SIZE);
+				struct granule *g_data;
+
+				g_data = find_lock_granule(addr,
+						GRANULE_STATE_DATA);
+				assert(g_data != NULL);
+				data_granule_release(g_data, td->mecid);
+				teardown_add(td, addr);
+			}
+			td->nr_data += nr_granules;
+		} else if (type == S2TTE_TYPE_VALID_NS) {
+			s2tte_write(&s2tt[i], s2tte_create_invalid_ns());
+			__granule_put(g_tbl);
+		}
+	}
+
+	empty = (g_tbl->refcount == 0UL);
+	buffer_unmap(s2tt);
+	return empty;
+}
+
+/*
+ * Tear down the Realm of @rd_addr with @td, whose NS list and budget are set
+ * by the caller. See smc_realm_teardown().
+ */
+static unsigned long realm_teardown(unsigned long rd_addr,
+				    struct realm_teardown *td)
+{
+	struct realm_s2_context s2_ctx;
+	struct granule *g_rd;
+	struct rd *rd;
+	int sl;
+
+	if ((td->g_list == NULL) ||
+	    (td->g_list->state != GRANULE_STATE_NS)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	/* A Realm with RECs cannot be torn down */
+	g_rd = find_lock_unused_granule(rd_addr, GRANULE_STATE_RD);
+	if (ptr_is_err(g_rd)) {
+		return (unsigned long)ptr_status(g_rd);
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	/* Report the RTTs freed by automatic folding first */
+	while ((rd->nr_reclaim_rtts != 0U) && teardown_fits(td, 1UL)) {
+		teardown_add(td, rd->reclaim_rtts[--rd->nr_reclaim_rtts]);
+	}
+
+	/* The Realm has no REC which could look the summary up meanwhile */
+	realm_ripas_summary_clear(rd, 0UL, realm_par_size(rd));
+
+	s2_ctx = rd->s2_ctx;
+	sl = realm_rtt_starting_level(rd);
+
+	td->g_root = s2_ctx.g_rtt;
+	td->mecid = s2_ctx.mecid;
+	granule_lock(td->g_root, GRANULE_STATE_RTT);
+
+	/* The RTTs are unlinked below */
+	rtt_walk_cache_invalidate();
+
+	for (unsigned int i = 0U; i < s2_ctx.num_root_rtts; i++) {
+		struct granule *g_sl = td->g_root + i;
+		bool empty;
+
+		/* The concatenated starting level RTTs are locked separately */
+		if (i != 0U) {
+			granule_lock(g_sl, GRANULE_STATE_RTT);
+		}
+
+		empty = rtt_teardown(td, g_sl, (long)sl);
+
+		if (i != 0U) {
+			granule_unlock(g_sl);
+		}
+
+		if (!empty) {
+			break;
+		}
+	}
+
+	invalidate_vmid(&s2_ctx);
+
+	realm_footprint_add(rd, RMI_GRANULE_STATE_RTT, -(long)td->nr_rtts);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, -(long)td->nr_data);
+	buffer_unmap(rd);
+
+	granule_unlock(td->g_root);
+	granule_unlock(g_rd);
+
+	teardown_flush(td);
+
+	return RMI_SUCCESS;
+}
+
+/*
+ * Implements RMI_REALM_TEARDOWN.
+ *
+ * Remove all the mappings of a Realm which has no REC, freeing its data
+ * granules and the RTTs below its starting level, in a single walk of its
+ * RTTs rather than one RMI call per granule. The addresses of the freed
+ * granules, which are DELEGATED, are written to the NS granule at
+ * @list_addr. When the list is full the call returns, and the Host calls it
+ * again to continue the teardown. The teardown is complete when no address
+ * is returned, after which the Realm can be destroyed. The walk is also
+ * preempted once some granules have been freed if the RMI budget is
+ * exhausted, in which case RMI_INCOMPLETE is returned with the same output
+ * and the Host calls it again in the same way.
+ *
+ * The TLB entries of the Realm are invalidated once per call, by VMID. No
+ * REC of the Realm can run and its VMID cannot be reused until
+ * RMI_REALM_DESTROY, so the stale entries cannot be used in the meantime.
+ */
+void smc_realm_teardown(unsigned long rd_addr,
+			unsigned long list_addr,
+			struct smc_result *ret)
+{
+	struct realm_teardown td = { 0 };
+	struct rmi_budget budget;
+
+	rmi_budget_start(&budget);
+	td.budget = &budget;
+	td.g_list = find_granule(list_addr);
+
+	ret->x[0] = realm_teardown(rd_addr, &td);
+	if (ret->x[0] != RMI_SUCCESS) {
+		return;
+	}
+
+	if (td.preempted) {
+		rmi_return_incomplete(ret, td.count);
+		return;
+	}
+
+	ret->x[1] = td.count;
+}
+
+/*
+ * Run a step of the background teardown of the Realm of @rd_addr, which
+ * appends the addresses of the granules it frees to the @*count ones
+ * already written to the NS list at @list_addr. The step stops after
+ * @limit more addresses or when @budget is exhausted, and @*done is then
+ * false. Otherwise the teardown has gone as far as RMI_REALM_TEARDOWN
+ * would.
+ */
+unsigned long realm_teardown_step(unsigned long rd_addr,
+				  unsigned long list_addr,
+				  unsigned long limit,
+				  struct rmi_budget *budget,
+				  unsigned long *count,
+				  bool *done)
+{
+	struct realm_teardown td = { 0 };
+	unsigned long ret;
+
+	td.budget = budget;
+	td.count = *count;
+	td.limit = *count + limit;
+	td.g_list = find_granule(list_addr);
+
+	ret = realm_teardown(rd_addr, &td);
+
+	*count = td.count;
+	*done = !td.preempted;
+	return ret;
+}
+
+/*
+ * Remove the link at @s2ttep of the locked RTT @g_llt, which translates
+ * @map_addr, to a shared RTT, see RMI_RTT_SHARED. The reference of the
+ * Realm on the shared RTT is dropped once its TLB entries are gone, after
+ * which the Host can change the shared RTT again if no other Realm links
+ * to it.
+ */
+static unsigned long rtt_shared_unlink(const struct realm_s2_context *s2_ctx,
+				       struct granule *g_llt,
+				       unsigned long *s2ttep,
+				       unsigned long map_addr)
+{
+	unsigned long rtt_addr = s2tte_pa_table(s2tte_read(s2ttep),
+						RTT_PAGE_LEVEL - 1L);
+
+	__granule_put(g_llt);
+
+	/*
+	 * Break before make. Note that this may cause spurious S2 aborts.
+	 */
+	s2tte_write(s2ttep, 0UL);
+	invalidate_table(s2_ctx, map_addr);
+	s2tte_write(s2ttep, s2tte_create_invalid_ns());
+	rtt_wait_lockless_walkers(s2_ctx->g_rtt);
+
+	atomic_granule_put(find_granule(rtt_addr));
+	return RMI_SUCCESS;
+}
+
+unsigned long smc_rtt_destroy(unsigned long rtt_addr,
+			      unsigned long rd_addr,
+			      unsigned long map_addr,
+			      unsigned long ulevel)
+{
+	struct granule *g_rd;
+	struct granule *g_tbl;
+	struct rd *rd;
+	struct granule *g_table_root;
+	struct rtt_walk wi;
+	unsigned long *table, *parent_s2tt, parent_s2tte;
+	long level = (long)ulevel;
+	unsigned long ret;
+	struct realm_s2_context s2_ctx;
+	bool in_par;
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!validate_rtt_structure_cmds(map_addr, level, rd)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		return RMI_ERROR_INPUT;
+	}
+
+	g_table_root = rd->s2_ctx.g_rtt;
+	s2_ctx = rd->s2_ctx;
+	in_par = addr_in_par(rd, map_addr);
+
+	/* The RD stays mapped to update the RIPAS summary */
+	granule_lock(g_table_root, GRANULE_STATE_RTT);
+	granule_unlock(g_rd);
+
+	/*
+	 * The RTT may be unlinked below, invalidate the walk cache while
+	 * holding the lock on the RTT root.
+	 */
+	rtt_walk_cache_invalidate();
+
+	rtt_walk_lock_unlock_ctx(&s2_ctx, map_addr, level - 1L, &wi);
+	if (wi.last_level != level - 1UL) {
+		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
+		goto out_unlock_parent_table;
+	}
+
+	parent_s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	parent_s2tte = s2tte_read(&parent_s2tt[wi.index]);
+	if (!s2tte_is_table(parent_s2tte, level - 1L)) {
+		ret = pack_return_code(RMI_ERROR_RTT,
+					(unsigned int)(level - 1L));
+		goto out_unmap_parent_table;
+	}
+
+	/*
+	 * Check that the 'rtt_addr' RTT is used at (map_addr, level).
+	 * Note that this also verifies that the rtt_addr is properly aligned.
+	 */
+	if (rtt_addr != s2tte_pa_table(parent_s2tte, level - 1L)) {
+		ret = RMI_ERROR_INPUT;
+		goto out_unmap_parent_table;
+	}
+
+	if (s2tte_is_shared_table(parent_s2tte, level - 1L)) {
+		ret = rtt_shared_unlink(&s2_ctx, wi.g_llt,
+					&parent_s2tt[wi.index], map_addr);
+		goto out_unmap_parent_table;
+	}
+
+	/*
+	 * Lock the RTT granule. The 'rtt_addr' is verified, thus can be treated
+	 * as an internal granule.
+	 */
+	g_tbl = find_lock_granule(rtt_addr, GRANULE_STATE_RTT);
+
+	/*
+	 * A table descriptor S2TTE always points to a TABLE granule.
+	 */
+	assert(g_tbl != NULL);
+
+	/*
+	 * Read the refcount value. RTT granule is always accessed locked, thus
+	 * the refcount can be accessed without atomic operations.
+	 */
+	if (g_tbl->refcount != 0UL) {
+		ret = RMI_ERROR_IN_USE;
+		goto out_unlock_table;
+	}
+
+	ret = RMI_SUCCESS;
+
+	table = granule_map(g_tbl, SLOT_RTT2);
+
+	if (in_par) {
+		parent_s2tte = s2tte_create_destroyed();
+	} else {
+		parent_s2tte = s2tte_create_invalid_ns();
+	}
+
+	__granule_put(wi.g_llt);
+
+	/*
+	 * Break before make. Note that this may cause spurious S2 aborts.
+	 */
+	s2tte_write(&parent_s2tt[wi.index], 0UL);
+	invalidate_table(&s2_ctx, map_addr);
+	s2tte_write(&parent_s2tt[wi.index], parent_s2tte);
+	if (in_par) {
+		realm_ripas_summary_clear(rd, map_addr,
+				map_addr + s2tte_map_size((int)(level - 1L)));
+	}
+	rtt_wait_lockless_walkers(g_table_root);
+
+	granule_memzero_mapped(table);
+	granule_set_state(g_tbl, GRANULE_STATE_DELEGATED);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_RTT, -1L);
+
+	buffer_unmap(table);
+out_unlock_table:
+	granule_unlock(g_tbl);
+out_unmap_parent_table:
+	buffer_unmap(parent_s2tt);
+out_unlock_parent_table:
+	granule_unlock(wi.g_llt);
+	buffer_unmap(rd);
+	return ret;
+}
+
+/* Number of unlinked RTTs kept locked until the TLBs are invalidated */
+#define DESTROY_TREE_BATCH_LEN	16U
+
+struct rtt_destroy_tree {
+	struct realm_teardown td;
+	struct rd *rd;
+	struct realm_s2_context s2_ctx;
+	/* Unlinked RTTs, not yet zeroed and freed */
+	struct granule *g_batch[DESTROY_TREE_BATCH_LEN];
+	unsigned long batch_addr[DESTROY_TREE_BATCH_LEN];
+	unsigned int nr_batch;
+};
+
+/*
+ * Free the RTTs unlinked since the last call. They stay locked until the
+ * TLBs have been invalidated, so that no stale walk cache entry can point
+ * to a granule the Host can use again.
+ */
+static void destroy_tree_flush(struct rtt_destroy_tree *dt)
+{
+	if (dt->nr_batch == 0U) {
+		return;
+	}
+
+	invalidate_vmid(&dt->s2_ctx);
+	rtt_wait_lockless_walkers(dt->td.g_root);
+
+	for (unsigned int i = 0U; i < dt->nr_batch; i++) {
+		granule_memzero(dt->g_batch[i], SLOT_RTT2);
+		granule_unlock_transition(dt->g_batch[i],
+					  GRANULE_STATE_DELEGATED);
+		teardown_add(&dt->td, dt->batch_addr[i]);
+	}
+
+	realm_footprint_add(dt->rd, RMI_GRANULE_STATE_RTT,
+			    -(long)dt->nr_batch);
+	dt->nr_batch = 0U;
+}
+
+/*
+ * Replace the table s2tte @s2ttep of the locked RTT @g_parent, which points
+ * to the empty and locked RTT @g_tbl at @level translating @map_addr, as
+ * RMI_RTT_DESTROY does. @g_tbl is added to the batch of RTTs to free.
+ */
+static void destroy_tree_unlink(struct rtt_destroy_tree *dt,
+				unsigned long *s2ttep,
+				struct granule *g_parent,
+				struct granule *g_tbl,
+				unsigned long rtt_addr,
+				unsigned long map_addr,
+				long level)
+{
+	unsigned long size = s2tte_map_size((int)(level - 1L));
+
+	/*
+	 * The RTT holds no valid s2tte, so the parent s2tte can go from table
+	 * to invalid without a break, the TLBs are invalidated by
+	 * destroy_tree_flush() before the RTT is freed.
+	 */
+	if (addr_in_par(dt->rd, map_addr)) {
+		s2tte_write(s2ttep, s2tte_create_destroyed());
+		realm_ripas_summary_clear(dt->rd, map_addr, map_addr + size);
+	} else {
+		s2tte_write(s2ttep, s2tte_create_invalid_ns());
+	}
+	__granule_put(g_parent);
+
+	dt->g_batch[dt->nr_batch] = g_tbl;
+	dt->batch_addr[dt->nr_batch] = rtt_addr;
+	if (++dt->nr_batch == DESTROY_TREE_BATCH_LEN) {
+		destroy_tree_flush(dt);
+	}
+}
+
+/* Return true if one more destroyed RTT fits in the NS list */
+static bool destroy_tree_fits(struct rtt_destroy_tree *dt)
+{
+	return teardown_fits(&dt->td, (unsigned long)dt->nr_batch + 1UL);
+}
+
+/*
+ * Destroy the empty RTTs below the locked RTT @g_tbl at @level, which
+ * translates @map_addr, until the NS list is full. @complete is cleared if
+ * the walk stopped early.
+ *
+ * The refcount of an RTT counts its s2ttes which are neither Unassigned nor
+ * Destroyed, table s2ttes included. An RTT with a null refcount is empty
+ * without being scanned, and the scan of an RTT stops once all of its
+ * counted s2ttes have been seen. Last level RTTs are never scanned.
+ *
+ * Returns true if @g_tbl is empty, in which case its caller unlinks it.
+ */
+static bool rtt_destroy_empty(struct rtt_destroy_tree *dt,
+			      struct granule *g_tbl,
+			      unsigned long map_addr,
+			      long level,
+			      bool *complete)
+{
+	unsigned long nr_live = g_tbl->refcount;
+	unsigned long *s2tt;
+
+	if ((nr_live == 0UL) || (level == RTT_PAGE_LEVEL)) {
+		return nr_live == 0UL;
+	}
+
+	s2tt = granule_map(g_tbl, SLOT_RTT);
+
+	for (unsigned long i = 0UL;
+	     (i < (unsigned long)S2TTES_PER_S2TT) && (nr_live != 0UL); i++) {
+		unsigned long s2tte = s2tte_read(&s2tt[i]);
+		unsigned long cls = s2tte_classify(s2tte, level);
+		unsigned long addr = map_addr + (i * s2tte_map_size((int)level));
+		unsigned long rtt_addr;
+		struct granule *g_child;
+		bool empty;
+
+		switch (s2tte_class_type(cls)) {
+		case S2TTE_TYPE_UNASSIGNED:
+		case S2TTE_TYPE_DESTROYED:
+			continue;
+		case S2TTE_TYPE_TABLE:
+			/* A link to a shared RTT is kept as a mapping */
+			if (s2tte_is_shared_table(s2tte, level)) {
+				nr_live--;
+				continue;
+			}
+			break;
+		default:
+			nr_live--;
+			continue;
+		}
+
+		if (!destroy_tree_fits(dt)) {
+			*complete = false;
+			break;
+		}
+
+		/*
+		 * Only one RTT is mapped at a time, so that the walk can go
+		 * down to the last level with a single slot.
+		 */
+		rtt_addr = s2tte_class_pa(cls);
+		buffer_unmap(s2tt);
+		g_child = find_lock_granule(rtt_addr, GRANULE_STATE_RTT);
+		assert(g_child != NULL);
+		empty = rtt_destroy_empty(dt, g_child, addr, level + 1L,
+					  complete);
+		s2tt = granule_map(g_tbl, SLOT_RTT);
+
+		if (!empty) {
+			granule_unlock(g_child);
+			if (!*complete) {
+				break;
+			}
+			nr_live--;
+			continue;
+		}
+
+		destroy_tree_unlink(dt, &s2tt[i], g_tbl, g_child, rtt_addr,
+				    addr, level + 1L);
+		nr_live--;
+	}
+
+	buffer_unmap(s2tt);
+	return g_tbl->refcount == 0UL;
+}
+
+/*
+ * Implements RMI_RTT_DESTROY_TREE.
+ *
+ * Destroy the RTT at @ulevel which translates @map_addr together with all
+ * the RTTs below it, in a single walk rather than one RMI_RTT_DESTROY per
+ * RTT, as long as they hold no mapping. An RTT which still holds one is
+ * kept, but its empty descendants are destroyed anyway. The addresses of the
+ * destroyed RTTs, which are DELEGATED, are written to the NS granule at
+ * @list_addr. When the list is full the call returns, and the Host calls it
+ * again to continue the walk.
+ *
+ * The Realm may be running, so the TLB entries of the Realm are invalidated
+ * by VMID before each batch of unlinked RTTs is freed.
+ */
+void smc_rtt_destroy_tree(unsigned long rd_addr,
+			  unsigned long map_addr,
+			  unsigned long ulevel,
+			  unsigned long list_addr,
+			  struct smc_result *ret)
+{
+	struct rtt_destroy_tree dt = { 0 };
+	struct granule *g_rd;
+	struct granule *g_tbl;
+	struct rtt_walk wi;
+	unsigned long *parent_s2tt, parent_s2tte;
+	unsigned long rtt_addr;
+	long level = (long)ulevel;
+	bool complete = true;
+	bool destroyed = false;
+
+	dt.td.g_list = find_granule(list_addr);
+	if ((dt.td.g_list == NULL) ||
+	    (dt.td.g_list->state != GRANULE_STATE_NS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	dt.rd = granule_map(g_rd, SLOT_RD);
+
+	if (!validate_rtt_structure_cmds(map_addr, level, dt.rd)) {
+		buffer_unmap(dt.rd);
+		granule_unlock(g_rd);
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	dt.s2_ctx = dt.rd->s2_ctx;
+	dt.td.g_root = dt.s2_ctx.g_rtt;
+	dt.td.mecid = dt.s2_ctx.mecid;
+
+	/* The RD stays mapped to update the RIPAS summary */
+	granule_lock(dt.td.g_root, GRANULE_STATE_RTT);
+	granule_unlock(g_rd);
+
+	/* The RTTs are unlinked below */
+	rtt_walk_cache_invalidate();
+
+	rtt_walk_lock_unlock_ctx(&dt.s2_ctx, map_addr, level - 1L, &wi);
+	if (wi.last_level != level - 1L) {
+		ret->x[0] = pack_return_code(RMI_ERROR_RTT,
+					     (unsigned int)wi.last_level);
+		goto out_unlock_parent_table;
+	}
+
+	parent_s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	parent_s2tte = s2tte_read(&parent_s2tt[wi.index]);
+	buffer_unmap(parent_s2tt);
+
+	if (!s2tte_is_table(parent_s2tte, level - 1L) ||
+	    s2tte_is_shared_table(parent_s2tte, level - 1L)) {
+		ret->x[0] = pack_return_code(RMI_ERROR_RTT,
+					     (unsigned int)(level - 1L));
+		goto out_unlock_parent_table;
+	}
+
+	rtt_addr = s2tte_pa_table(parent_s2tte, level - 1L);
+	g_tbl = find_lock_granule(rtt_addr, GRANULE_STATE_RTT);
+	assert(g_tbl != NULL);
+
+	if (rtt_destroy_empty(&dt, g_tbl, map_addr, level, &complete) &&
+	    complete) {
+		if (destroy_tree_fits(&dt)) {
+			parent_s2tt = granule_map(wi.g_llt, SLOT_RTT);
+			destroy_tree_unlink(&dt, &parent_s2tt[wi.index],
+					    wi.g_llt, g_tbl, rtt_addr,
+					    map_addr, level);
+			buffer_unmap(parent_s2tt);
+			destroyed = true;
+		} else {
+			granule_unlock(g_tbl);
+			complete = false;
+		}
+	} else {
+		granule_unlock(g_tbl);
+	}
+
+	destroy_tree_flush(&dt);
+
+	if (complete && !destroyed) {
+		ret->x[0] = RMI_ERROR_IN_USE;
+	} else {
+		ret->x[0] = RMI_SUCCESS;
+	}
+
+out_unlock_parent_table:
+	granule_unlock(wi.g_llt);
+	buffer_unmap(dt.rd);
+
+	teardown_flush(&dt.td);
+
+	ret->x[1] = dt.td.count;
+	ret->x[2] = complete ? 1UL : 0UL;
+}
+
+enum map_unmap_ns_op {
+	MAP_NS,
+	UNMAP_NS
+};
+
+/*
+ * We don't hold a reference on the NS granule when it is
+ * mapped into a realm. Instead we rely on the guarantees
+ * provided by the architecture to ensure that a NS access
+ * to a protected granule is prohibited even within the realm.
+ *
+ * The entries of the RTT at @level which translates @base are mapped or
+ * unmapped starting at @base and stopping at the first entry at or above
+ * @top, at the end of the RTT, or at the first entry which cannot be
+ * changed. For MAP_NS, consecutive entries map consecutive NS addresses
+ * starting at the output address of @host_s2tte. For UNMAP_NS, the TLB is
+ * invalidated once for all the entries unmapped.
+ *
+ * On RMI_SUCCESS, *next holds the IPA following the last entry changed.
+ */
+static unsigned long map_unmap_ns(unsigned long rd_addr,
+				  unsigned long base,
+				  unsigned long top,
+				  long level,
+				  unsigned long host_s2tte,
+				  enum map_unmap_ns_op op,
+				  unsigned long *next)
+{
+	struct granule *g_rd;
+	struct rd *rd;
+	struct granule *g_table_root;
+	unsigned long *s2tt, s2tte;
+	struct rtt_walk wi;
+	unsigned long addr, map_size, index;
+	unsigned long ret;
+	struct realm_s2_context s2_ctx;
+
+	if (top <= base) {
+		return RMI_ERROR_INPUT;
+	}
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!validate_rtt_map_cmds(base, level, rd)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		return RMI_ERROR_INPUT;
+	}
+
+	g_table_root = rd->s2_ctx.g_rtt;
+
+	/*
+	 * We don't have to check PAR boundaries for unmap_ns
+	 * operation because we already test that the s2tte is Valid_NS
+	 * and only outside-PAR IPAs can be translated by such s2tte.
+	 *
+	 * For "map_ns", however, the s2tte is verified to be Unassigned
+	 * but both inside & outside PAR IPAs can be translated by such s2ttes.
+	 * The PAR starts at IPA 0, so the entries above @base are outside
+	 * PAR as well.
+	 */
+	if ((op == MAP_NS) && addr_in_par(rd, base)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		return RMI_ERROR_INPUT;
+	}
+
+	s2_ctx = rd->s2_ctx;
+
+	granule_lock(g_table_root, GRANULE_STATE_RTT);
+
+	if ((op == MAP_NS) && (rd->nr_rtt_pool != 0U)) {
+		/* The RD stays locked while RTTs may be taken from the pool */
+		rtt_walk_lock_unlock_pool(rd, base, level, &wi);
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+	} else {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		rtt_walk_lock_unlock_ctx(&s2_ctx, base, level, &wi);
+	}
+	if (wi.last_level != level) {
+		ret = rtt_walk_error(&wi, base, level);
+		goto out_unlock_llt;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	map_size = s2tte_map_size((int)level);
+
+	for (addr = base, index = wi.index;
+	     (addr < top) && (index < S2TTES_PER_S2TT);
+	     addr += map_size, index++) {
+		s2tte = s2tte_read(&s2tt[index]);
+
+		if (op == MAP_NS) {
+			if (!s2tte_is_unassigned(s2tte) ||
+			    !host_ns_s2tte_is_valid(host_s2tte, level)) {
+				break;
+			}
+
+			s2tte = s2tte_create_valid_ns(host_s2tte, level);
+			s2tte_write(&s2tt[index], s2tte);
+			__granule_get(wi.g_llt);
+			host_s2tte += map_size;
+		} else {
+			/*
+			 * The following check also verifies that the entry is
+			 * outside PAR, as valid_NS s2tte may only cover outside
+			 * PAR IPA range.
+			 */
+			if (!s2tte_is_valid_ns(s2tte, level)) {
+				break;
+			}
+
+			s2tte = s2tte_create_invalid_ns();
+			s2tte_write(&s2tt[index], s2tte);
+			__granule_put(wi.g_llt);
+		}
+	}
+
+	if (addr == base) {
+		ret = pack_return_code(RMI_ERROR_RTT, (unsigned int)level);
+		goto out_unmap_table;
+	}
+
+	if (op == UNMAP_NS) {
+		if ((addr - base) > map_size) {
+			invalidate_range(&s2_ctx, base, addr - base, level);
+		} else if (level == RTT_PAGE_LEVEL) {
+			invalidate_page(&s2_ctx, base);
+		} else {
+			invalidate_block(&s2_ctx, base);
+		}
+	}
+
+	*next = addr;
+	ret = RMI_SUCCESS;
+
+out_unmap_table:
+	buffer_unmap(s2tt);
+out_unlock_llt:
+	granule_unlock(wi.g_llt);
+	return ret;
+}
+
+unsigned long smc_rtt_map_unprotected(unsigned long rd_addr,
+				      unsigned long map_addr,
+				      unsigned long ulevel,
+				      unsigned long s2tte)
+{
+	long level = (long)ulevel;
+	unsigned long next;
+
+	if (!host_ns_s2tte_is_valid(s2tte, level)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	/* Only the entry at @map_addr starts below @map_addr + 1 */
+	return map_unmap_ns(rd_addr, map_addr, map_addr + 1UL, level, s2tte,
+			    MAP_NS, &next);
+}
+
+unsigned long smc_rtt_unmap_unprotected(unsigned long rd_addr,
+					unsigned long map_addr,
+					unsigned long ulevel)
+{
+	unsigned long next;
+
+	return map_unmap_ns(rd_addr, map_addr, map_addr + 1UL, (long)ulevel,
+			    0UL, UNMAP_NS, &next);
+}
+
+void smc_rtt_map_unprotected_range(unsigned long rd_addr,
+				   unsigned long base,
+				   unsigned long top,
+				   unsigned long ulevel,
+				   unsigned long s2tte,
+				   struct smc_result *ret)
+{
+	long level = (long)ulevel;
+	unsigned long next = base;
+
+	if (!host_ns_s2tte_is_valid(s2tte, level)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	ret->x[0] = map_unmap_ns(rd_addr, base, top, level, s2tte,
+				 MAP_NS, &next);
+	ret->x[1] = next;
+}
+
+void smc_rtt_unmap_unprotected_range(unsigned long rd_addr,
+				     unsigned long base,
+				     unsigned long top,
+				     unsigned long ulevel,
+				     struct smc_result *ret)
+{
+	unsigned long next = base;
+
+	ret->x[0] = map_unmap_ns(rd_addr, base, top, (long)ulevel, 0UL,
+				 UNMAP_NS, &next);
+	ret->x[1] = next;
+}
+
+static unsigned long rtt_shared_create(unsigned long rtt_addr)
+{
+	struct granule *g_tbl;
+	unsigned long *s2tt;
+
+	g_tbl = find_lock_granule(rtt_addr, GRANULE_STATE_DELEGATED);
+	if (g_tbl == NULL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	s2tt = granule_map(g_tbl, SLOT_DELEGATED);
+	s2tt_init_unassigned(s2tt, RMI_EMPTY);
+	buffer_unmap(s2tt);
+
+	/* All the entries of the new RTT have been written */
+	granule_clear_needs_scrub(g_tbl);
+	granule_unlock_transition(g_tbl, GRANULE_STATE_RTT_SHARED);
+	return RMI_SUCCESS;
+}
+
+/*
+ * Map or unmap up to @count s2ttes of the shared RTT at @rtt_addr starting
+ * at @index, see map_unmap_ns(). On RMI_SUCCESS, *count holds the number of
+ * s2ttes changed.
+ */
+static unsigned long rtt_shared_map_unmap(unsigned long rtt_addr,
+					  unsigned long index,
+					  unsigned long *count,
+					  unsigned long host_s2tte,
+					  enum map_unmap_ns_op op)
+{
+	struct granule *g_tbl;
+	unsigned long *s2tt;
+	unsigned long i, ret;
+
+	if ((index >= S2TTES_PER_S2TT) ||
+	    ((op == MAP_NS) &&
+	     !host_ns_s2tte_is_valid(host_s2tte, RTT_PAGE_LEVEL))) {
+		return RMI_ERROR_INPUT;
+	}
+
+	g_tbl = find_lock_granule(rtt_addr, GRANULE_STATE_RTT_SHARED);
+	if (g_tbl == NULL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	/* The links are only taken with the lock held */
+	if (granule_refcount_read_acquire(g_tbl) != 0UL) {
+		granule_unlock(g_tbl);
+		return RMI_ERROR_IN_USE;
+	}
+
+	s2tt = granule_map(g_tbl, SLOT_RTT);
+
+	for (i = index; (i < S2TTES_PER_S2TT) && ((i - index) < *count);
+	     i++) {
+		unsigned long s2tte = s2tte_read(&s2tt[i]);
+
+		if (op == MAP_NS) {
+			if (!s2tte_is_unassigned(s2tte)) {
+				break;
+			}
+
+			s2tte_write(&s2tt[i],
+				    s2tte_create_valid_ns(host_s2tte,
+							  RTT_PAGE_LEVEL));
+			host_s2tte += GRANULE_SIZE;
+		} else {
+			if (!s2tte_is_valid_ns(s2tte, RTT_PAGE_LEVEL)) {
+				break;
+			}
+
+			s2tte_write(&s2tt[i], s2tte_create_invalid_ns());
+		}
+	}
+
+	buffer_unmap(s2tt);
+	granule_unlock(g_tbl);
+
+	if (i == index) {
+		ret = pack_return_code(RMI_ERROR_RTT,
+				       (unsigned int)RTT_PAGE_LEVEL);
+	} else {
+		*count = i - index;
+		ret = RMI_SUCCESS;
+	}
+
+	return ret;
+}
+
+static unsigned long rtt_shared_link(unsigned long rtt_addr,
+				     unsigned long rd_addr,
+				     unsigned long map_addr)
+{
+	const long level = RTT_PAGE_LEVEL;
+	struct granule *g_tbl;
+	struct granule *g_rd;
+	struct granule *g_table_root;
+	struct rd *rd;
+	struct rtt_walk wi;
+	unsigned long *parent_s2tt;
+	unsigned long ipa_bits;
+	unsigned long ret;
+	int sl;
+
+	if (!find_lock_two_granules(rtt_addr,
+				    GRANULE_STATE_RTT_SHARED,
+				    &g_tbl,
+				    rd_addr,
+				    GRANULE_STATE_RD,
+				    &g_rd)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!validate_rtt_structure_cmds(map_addr, level, rd) ||
+	    !validate_map_addr(map_addr, level - 1L, rd) ||
+	    addr_in_par(rd, map_addr)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		granule_unlock(g_tbl);
+		return RMI_ERROR_INPUT;
+	}
+
+	g_table_root = rd->s2_ctx.g_rtt;
+	sl = realm_rtt_starting_level(rd);
+	ipa_bits = realm_ipa_bits(rd);
+
+	granule_lock(g_table_root, GRANULE_STATE_RTT);
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+
+	rtt_walk_lock_unlock(g_table_root, sl, ipa_bits,
+				map_addr, level - 1L, &wi);
+	if (wi.last_level != level - 1L) {
+		ret = rtt_walk_error(&wi, map_addr, level - 1L);
+		goto out_unlock_llt;
+	}
+
+	parent_s2tt = granule_map(wi.g_llt, SLOT_RTT);
+
+	if (s2tte_is_unassigned(s2tte_read(&parent_s2tt[wi.index]))) {
+		s2tte_write(&parent_s2tt[wi.index],
+			    s2tte_create_shared_table(rtt_addr, level - 1L));
+		__granule_get(wi.g_llt);
+		atomic_granule_get(g_tbl);
+		ret = RMI_SUCCESS;
+	} else {
+		ret = pack_return_code(RMI_ERROR_RTT,
+				       (unsigned int)(level - 1L));
+	}
+
+	buffer_unmap(parent_s2tt);
+out_unlock_llt:
+	granule_unlock(wi.g_llt);
+	granule_unlock(g_tbl);
+	return ret;
+}
+
+static unsigned long rtt_shared_destroy(unsigned long rtt_addr)
+{
+	struct granule *g_tbl;
+
+	g_tbl = find_lock_granule(rtt_addr, GRANULE_STATE_RTT_SHARED);
+	if (g_tbl == NULL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (granule_refcount_read_acquire(g_tbl) != 0UL) {
+		granule_unlock(g_tbl);
+		return RMI_ERROR_IN_USE;
+	}
+
+	granule_memzero(g_tbl, SLOT_RTT);
+	granule_unlock_transition(g_tbl, GRANULE_STATE_DELEGATED);
+	return RMI_SUCCESS;
+}
+
+/*
+ * Implements RMI_RTT_SHARED.
+ *
+ * Build a last level RTT of Unprotected mappings once, and link it into
+ * the Unprotected IPA space of several Realms, see SMC_RMM_RTT_SHARED.
+ */
+void smc_rtt_shared(unsigned long op,
+		    unsigned long rtt_addr,
+		    unsigned long arg2,
+		    unsigned long arg3,
+		    unsigned long arg4,
+		    struct smc_result *ret)
+{
+	unsigned long count = arg3;
+
+	switch (op) {
+	case RMI_RTT_SHARED_CREATE:
+		ret->x[0] = rtt_shared_create(rtt_addr);
+		break;
+	case RMI_RTT_SHARED_MAP:
+		ret->x[0] = rtt_shared_map_unmap(rtt_addr, arg2, &count, arg4,
+						 MAP_NS);
+		break;
+	case RMI_RTT_SHARED_UNMAP:
+		ret->x[0] = rtt_shared_map_unmap(rtt_addr, arg2, &count, 0UL,
+						 UNMAP_NS);
+		break;
+	case RMI_RTT_SHARED_LINK:
+		ret->x[0] = rtt_shared_link(rtt_addr, arg2, arg3);
+		break;
+	case RMI_RTT_SHARED_DESTROY:
+		ret->x[0] = rtt_shared_destroy(rtt_addr);
+		break;
+	default:
+		ret->x[0] = RMI_ERROR_INPUT;
+		break;
+	}
+
+	ret->x[1] = ((ret->x[0] == RMI_SUCCESS) &&
+		     ((op == RMI_RTT_SHARED_MAP) ||
+		      (op == RMI_RTT_SHARED_UNMAP))) ? count : 0UL;
+}
+
+/*
+ * Decode @s2tte at @level into the state, output address and RIPAS reported
+ * to the Host by RMI_RTT_READ_ENTRY.
+ */
+static void rtt_entry_decode(unsigned long s2tte, long level,
+			     unsigned long *state, unsigned long *addr,
+			     unsigned long *ripas)
+{
+	unsigned long cls = s2tte_classify(s2tte, level);
+
+	*addr = s2tte_class_pa(cls);
+	*ripas = (unsigned long)s2tte_class_ripas(cls);
+
+	switch (s2tte_class_type(cls)) {
+	case S2TTE_TYPE_UNASSIGNED:
+		*state = RMI_RTT_STATE_UNASSIGNED;
+		break;
+	case S2TTE_TYPE_DESTROYED:
+		*state = RMI_RTT_STATE_DESTROYED;
+		break;
+	case S2TTE_TYPE_EXPORTED:
+		*state = RMI_RTT_STATE_EXPORTED;
+		break;
+	case S2TTE_TYPE_ASSIGNED:
+	case S2TTE_TYPE_VALID:
+		*state = RMI_RTT_STATE_ASSIGNED;
+		break;
+	case S2TTE_TYPE_VALID_NS:
+		*state = RMI_RTT_STATE_VALID_NS;
+		*addr = host_ns_s2tte(s2tte, level);
+		break;
+	case S2TTE_TYPE_TABLE:
+		*state = RMI_RTT_STATE_TABLE;
+		break;
+	default:
+		assert(false);
+	}
+}
+
+void smc_rtt_read_entry(unsigned long rd_addr,
+			unsigned long map_addr,
+			unsigned long ulevel,
+			struct smc_result *ret)
+{
+	struct granule *g_rd, *g_rtt_root;
+	struct rd *rd;
+	struct rtt_walk wi;
+	unsigned long *s2tt, s2tte;
+	unsigned long ipa_bits;
+	long level = (long)ulevel;
+	int sl;
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!validate_rtt_entry_cmds(map_addr, level, rd)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g_rtt_root = rd->s2_ctx.g_rtt;
+	sl = realm_rtt_starting_level(rd);
+	ipa_bits = realm_ipa_bits(rd);
+	buffer_unmap(rd);
+
+	granule_lock(g_rtt_root, GRANULE_STATE_RTT);
+	granule_unlock(g_rd);
+
+	rtt_walk_lock_unlock(g_rtt_root, sl, ipa_bits,
+				map_addr, level, &wi);
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	s2tte = s2tte_read(&s2tt[wi.index]);
+	ret->x[1] =  wi.last_level;
+
+	rtt_entry_decode(s2tte, wi.last_level, &ret->x[2], &ret->x[3],
+			 &ret->x[4]);
+
+	buffer_unmap(s2tt);
+	granule_unlock(wi.g_llt);
+
+	ret->x[0] = RMI_SUCCESS;
+}
+
+/* Entries of an RTT encoded for RMI_RTT_READ_ENTRIES */
+static DEFINE_PER_CPU(unsigned long[S2TTES_PER_S2TT], rtt_entries);
+
+/*
+ * Implements RMI_RTT_READ_ENTRIES.
+ *
+ * Write the S2TTES_PER_S2TT entries of the RTT at @ulevel which translates
+ * @map_addr to the NS granule at @ns_addr, each encoded as described for
+ * RMI_RTT_READ_ENTRIES. On success, ret->x[1] holds the IPA translated by
+ * the first entry of the RTT.
+ */
+void smc_rtt_read_entries(unsigned long rd_addr,
+			  unsigned long map_addr,
+			  unsigned long ulevel,
+			  unsigned long ns_addr,
+			  struct smc_result *ret)
+{
+	struct granule *g_rd, *g_rtt_root, *g_ns;
+	struct rd *rd;
+	struct rtt_walk wi;
+	unsigned long *s2tt;
+	unsigned long *entries = per_cpu(rtt_entries, my_cpuid());
+	unsigned long ipa_bits, rtt_size;
+	bool ns_access_ok;
+	long level = (long)ulevel;
+	int sl;
+
+	g_ns = find_granule(ns_addr);
+	if ((g_ns == NULL) || (g_ns->state != GRANULE_STATE_NS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!validate_rtt_entry_cmds(map_addr, level, rd)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g_rtt_root = rd->s2_ctx.g_rtt;
+	sl = realm_rtt_starting_level(rd);
+	ipa_bits = realm_ipa_bits(rd);
+	buffer_unmap(rd);
+
+	granule_lock(g_rtt_root, GRANULE_STATE_RTT);
+	granule_unlock(g_rd);
+
+	rtt_walk_lock_unlock(g_rtt_root, sl, ipa_bits,
+				map_addr, level, &wi);
+	if (wi.last_level != level) {
+		ret->x[0] = pack_return_code(RMI_ERROR_RTT, wi.last_level);
+		granule_unlock(wi.g_llt);
+		return;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+
+	for (unsigned int i = 0U; i < S2TTES_PER_S2TT; i++) {
+		unsigned long state, addr, ripas;
+
+		rtt_entry_decode(s2tte_read(&s2tt[i]), level,
+				 &state, &addr, &ripas);
+		entries[i] = addr |
+			     (state << RMI_RTT_ENTRY_STATE_SHIFT) |
+			     (ripas << RMI_RTT_ENTRY_RIPAS_SHIFT);
+	}
+
+	buffer_unmap(s2tt);
+	granule_unlock(wi.g_llt);
+
+	ns_access_ok = ns_buffer_write(SLOT_NS, g_ns, 0U,
+				       S2TTES_PER_S2TT * sizeof(entries[0]),
+				       entries);
+	if (!ns_access_ok) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	rtt_size = s2tte_map_size((int)level) * S2TTES_PER_S2TT;
+	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = map_addr & ~(rtt_size - 1UL);
+}
+
+/* Bitmaps of an RTT written by RMI_RTT_SCAN_ACCESS */
+static DEFINE_PER_CPU(unsigned long[2U * S2TTES_PER_S2TT / BITS_PER_UL],
+		      rtt_scan_bitmaps);
+
+COMPILER_ASSERT((RMI_RTT_SCAN_DIRTY_OFFSET - RMI_RTT_SCAN_ACCESSED_OFFSET) ==
+		(S2TTES_PER_S2TT / 8U));
+
+/*
+ * Implements RMI_RTT_SCAN_ACCESS.
+ *
+ * Write the accessed and dirty bitmaps of the RTT at @ulevel which
+ * translates @map_addr to the NS granule at @ns_addr, and clear the state
+ * tracked by FEAT_HAFDBS in its entries. On success, ret->x[1] holds the IPA
+ * translated by the first entry of the RTT.
+ *
+ * For a realm which tracks its dirty state by write-protection, the
+ * entries are write-protected instead and the accessed bitmap is empty.
+ */
+void smc_rtt_scan_access(unsigned long rd_addr,
+			 unsigned long map_addr,
+			 unsigned long ulevel,
+			 unsigned long ns_addr,
+			 struct smc_result *ret)
+{
+	struct granule *g_rd, *g_rtt_root, *g_ns;
+	struct rd *rd;
+	struct rtt_walk wi;
+	struct realm_s2_context s2_ctx;
+	unsigned long *s2tt;
+	unsigned long *accessed = per_cpu(rtt_scan_bitmaps, my_cpuid());
+	unsigned long *dirty = accessed + (S2TTES_PER_S2TT / BITS_PER_UL);
+	unsigned long rtt_size, rtt_base;
+	bool ns_access_ok, updated, wp_dirty;
+	long level = (long)ulevel;
+
+	g_ns = find_granule(ns_addr);
+	if ((g_ns == NULL) || (g_ns->state != GRANULE_STATE_NS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!rd->hafdbs_enabled && !rd->wp_dirty_enabled) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		ret->x[0] = RMI_ERROR_REALM;
+		return;
+	}
+	wp_dirty = rd->wp_dirty_enabled;
+
+	if (!validate_rtt_entry_cmds(map_addr, level, rd)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	g_rtt_root = rd->s2_ctx.g_rtt;
+	s2_ctx = rd->s2_ctx;
+	buffer_unmap(rd);
+
+	granule_lock(g_rtt_root, GRANULE_STATE_RTT);
+	granule_unlock(g_rd);
+
+	rtt_walk_lock_unlock_ctx(&s2_ctx, map_addr, level, &wi);
+	if (wi.last_level != level) {
+		ret->x[0] = pack_return_code(RMI_ERROR_RTT, wi.last_level);
+		granule_unlock(wi.g_llt);
+		return;
+	}
+
+	rtt_size = s2tte_map_size((int)level) * S2TTES_PER_S2TT;
+	rtt_base = map_addr & ~(rtt_size - 1UL);
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	if (wp_dirty) {
+		(void)memset(accessed, 0, S2TTES_PER_S2TT / 8U);
+		updated = s2tt_scan_dirty_wp(s2tt, level, dirty);
+	} else {
+		updated = s2tt_scan_access_dirty(s2tt, level, accessed, dirty);
+	}
+	buffer_unmap(s2tt);
+
+	/*
+	 * The TLBs may hold the entries with the Access flag set or writable,
+	 * which would not update the s2ttes on the next access.
+	 */
+	if (updated) {
+		invalidate_range(&s2_ctx, rtt_base, rtt_size, level);
+	}
+
+	granule_unlock(wi.g_llt);
+
+	ns_access_ok = ns_buffer_write(SLOT_NS, g_ns, 0U,
+				       2U * S2TTES_PER_S2TT / 8U, accessed);
+	if (!ns_access_ok) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = rtt_base;
+}
+
+/*
+ * Extend the RIM with the DATA granule at @ipa, whose contents hash is
+ * @content if @flags is RMI_MEASURE_CONTENT. @ctx must have been opened
+ * with the algorithm of the realm.
+ */
+static void data_desc_measure(struct measurement_ctx *ctx,
+			      struct rd *rd,
+			      unsigned long ipa,
+			      unsigned long flags,
+			      const unsigned char *content)
+{
+	struct measurement_desc_data measure_desc = {0};
+
+	/* Initialize the measurement descriptior structure */
+	measure_desc.desc_type = MEASURE_DESC_TYPE_DATA;
+	measure_desc.len = sizeof(struct measurement_desc_data);
+	measure_desc.ipa = ipa;
+	measure_desc.flags = flags;
+	memcpy(measure_desc.rim,
+	       &rd->measurement[RIM_MEASUREMENT_SLOT],
+	       measurement_get_size(rd->algorithm));
+
+	if (flags == RMI_MEASURE_CONTENT) {
+		memcpy(measure_desc.content, content,
+		       measurement_get_size(rd->algorithm));
+	}
+
+	/*
+	 * Hashing the measurement descriptor structure; the result is the
 	 * updated RIM.
 	 */
-	measurement_hash_compute(rd->algorithm,
-			       &measure_desc,
-			       sizeof(measure_desc),
-			       rd->measurement[RIM_MEASUREMENT_SLOT]);
+	measurement_ctx_hash(ctx, &measure_desc, sizeof(measure_desc),
+			     rd->measurement[RIM_MEASUREMENT_SLOT]);
+}
+
+/*
+ * Extend the RIM with the DATA granule at @ipa. @ctx must have been opened
+ * with the algorithm of the realm.
+ */
+static void data_granule_measure(struct measurement_ctx *ctx,
+				 struct rd *rd, void *data,
+				 unsigned long ipa,
+				 unsigned long flags)
+{
+	unsigned char content[MAX_MEASUREMENT_SIZE];
+
+	if (flags == RMI_MEASURE_CONTENT) {
+		/* Hashing the data granule */
+		measurement_ctx_hash(ctx, data, GRANULE_SIZE, content);
+	}
+
+	data_desc_measure(ctx, rd, ipa, flags, content);
+}
+
+static unsigned long validate_data_create_unknown(unsigned long map_addr,
+						  long level,
+						  struct rd *rd)
+{
+	if (!addr_in_par(rd, map_addr) ||
+	    !addr_in_par(rd, map_addr + s2tte_map_size(level) - 1UL)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if (!validate_map_addr(map_addr, level, rd)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	return RMI_SUCCESS;
+}
+
+static unsigned long validate_data_create(unsigned long map_addr,
+					  long level,
+					  struct rd *rd)
+{
+	if (get_rd_state_locked(rd) != REALM_STATE_NEW) {
+		return RMI_ERROR_REALM;
+	}
+
+	return validate_data_create_unknown(map_addr, level, rd);
+}
+
+/*
+ * Lock up to @count DELEGATED granules starting at @g_data, stopping at the
+ * first granule which is not DELEGATED, together with the RD granule @g_rd.
+ * The granules are locked in order of their address.
+ *
+ * Returns the number of DATA granules locked, or 0 if no granule could be
+ * locked, in which case no lock is held.
+ */
+static unsigned long lock_data_range_and_rd(struct granule *g_data,
+					    unsigned long count,
+					    struct granule *g_rd)
+{
+	unsigned long i;
+	bool rd_first = (g_rd < g_data);
+
+	if (rd_first && !granule_lock_on_state_match(g_rd, GRANULE_STATE_RD)) {
+		return 0UL;
+	}
+
+	for (i = 0UL; i < count; i++) {
+		if (!granule_lock_on_state_match(&g_data[i],
+						 GRANULE_STATE_DELEGATED)) {
+			break;
+		}
+	}
+
+	if ((i != 0UL) && !rd_first &&
+	    !granule_lock_on_state_match(g_rd, GRANULE_STATE_RD)) {
+		while (i != 0UL) {
+			granule_unlock(&g_data[--i]);
+		}
+	}
+
+	if ((i == 0UL) && rd_first) {
+		granule_unlock(g_rd);
+	}
+
+	return i;
+}
+
+/*
+ * Number of attempts to lock the RD granule out of order in
+ * data_create_copy_first() before falling back to the ordered locking.
+ */
+#define DATA_CREATE_RD_TRYLOCK_RETRIES	64U
+
+/*
+ * Map the DATA granules from @g_data at @map_addr in the realm @rd, with the
+ * RD granule and the DATA granules locked by the caller. The caller
+ * transitions the DATA granules to GRANULE_STATE_DATA if RMI_SUCCESS is
+ * returned.
+ *
+ * If @copied is true, the content of the source granules has already been
+ * copied to the DATA granules, or was preloaded in them by the Host.
+ * @content is then either the precomputed hash of the content of a single
+ * DATA granule, or NULL to have the content hashed here.
+ */
+static unsigned long data_create_locked(struct rd *rd,
+					struct granule *g_data,
+					unsigned long data_addr,
+					unsigned long map_addr,
+					struct granule *g_src,
+					unsigned long flags,
+					long level,
+					bool copied,
+					const unsigned char *content)
+{
+	struct rtt_walk wi;
+	struct measurement_ctx mctx;
+	unsigned long s2tte, *s2tt;
+	enum ripas ripas;
+	unsigned long nr_granules = s2tte_map_size(level) / GRANULE_SIZE;
+	unsigned long i;
+	unsigned long ret;
+	bool fold = false;
+
+	ret = (g_src != NULL) ?
+		validate_data_create(map_addr, level, rd) :
+		validate_data_create_unknown(map_addr, level, rd);
+
+	if (ret != RMI_SUCCESS) {
+		return ret;
+	}
+
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	rtt_walk_lock_unlock_pool(rd, map_addr, level, &wi);
+	if (wi.last_level != level) {
+		ret = rtt_walk_error(&wi, map_addr, level);
+		goto out_unlock_ll_table;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	s2tte = s2tte_read(&s2tt[wi.index]);
+	if (!s2tte_is_unassigned(s2tte)) {
+		ret = pack_return_code(RMI_ERROR_RTT, level);
+		goto out_unmap_ll_table;
+	}
+
+	ripas = s2tte_get_ripas(s2tte);
+
+	if (g_src != NULL) {
+		measurement_ctx_begin(&mctx, rd->algorithm);
+	}
+
+	/*
+	 * Data.CreateUnknown leaves the content of the granules zeroed, or
+	 * only unreadable if the Realm has its own memory encryption context,
+	 * as any content is then decrypted with the key of the Realm.
+	 */
+	for (i = 0UL; (g_src == NULL) && (i < nr_granules); i++) {
+		if (rd->s2_ctx.mecid == MECID_RMM) {
+			granule_scrub(&g_data[i], SLOT_DELEGATED);
+		} else {
+			granule_mec_clean(&g_data[i]);
+			granule_clear_needs_scrub(&g_data[i]);
+		}
+	}
+
+	for (i = 0UL; (g_src != NULL) && (i < nr_granules); i++) {
+		unsigned long ipa = map_addr + (i * GRANULE_SIZE);
+		unsigned char hash[MAX_MEASUREMENT_SIZE];
+		bool ns_access_ok = true;
+		void *data;
+
+		/*
+		 * Each granule of a block is measured as if it had been
+		 * created on its own, so the RIM does not depend on the
+		 * mapping level.
+		 */
+		if (copied && (content != NULL)) {
+			data_desc_measure(&mctx, rd, ipa, flags, content);
+			continue;
+		}
+
+		if (!copied && (rd->s2_ctx.mecid != MECID_RMM)) {
+			granule_mec_clean(&g_data[i]);
+		}
+
+		data = granule_map_mec(&g_data[i], SLOT_DELEGATED,
+				       rd->s2_ctx.mecid);
+
+		if (copied) {
+			data_granule_measure(&mctx, rd, data, ipa, flags);
+		} else if (flags == RMI_MEASURE_CONTENT) {
+			/* Hash the content while it is copied */
+			ns_access_ok = ns_buffer_read_hash(SLOT_NS, &g_src[i],
+							   data, &mctx, hash);
+		} else {
+			ns_access_ok = ns_buffer_read(SLOT_NS, &g_src[i], 0U,
+						      GRANULE_SIZE, data);
+		}
+
+		if (!ns_access_ok) {
+			/*
+			 * Some data may be copied before the failure. The
+			 * g_data granules remain in delegated state, so have
+			 * them scrubbed before their next use.
+			 */
+			buffer_unmap(data);
+			measurement_ctx_end(&mctx);
+			do {
+				granule_set_needs_scrub(&g_data[i]);
+			} while (i-- != 0UL);
+			ret = RMI_ERROR_INPUT;
+			goto out_unmap_ll_table;
+		}
+
+		granule_clear_needs_scrub(&g_data[i]);
+
+		if (!copied) {
+			data_desc_measure(&mctx, rd, ipa, flags, hash);
+		}
+
+		buffer_unmap(data);
+	}
+
+	if (g_src != NULL) {
+		measurement_ctx_end(&mctx);
+	}
+
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, (long)nr_granules);
+
+	s2tte = (ripas == RMI_EMPTY) ?
+		s2tte_create_assigned_empty(data_addr, level) :
+		s2tte_create_valid(data_addr, level);
+
+	s2tte_write(&s2tt[wi.index], s2tte);
+	__granule_get(wi.g_llt);
+	fold = (level == RTT_PAGE_LEVEL) &&
+	       (wi.g_llt->refcount == S2TTES_PER_S2TT);
+
+	ret = RMI_SUCCESS;
+
+out_unmap_ll_table:
+	buffer_unmap(s2tt);
+out_unlock_ll_table:
+	granule_unlock(wi.g_llt);
+	if (fold) {
+		rtt_auto_fold(rd, granule_addr(wi.g_llt), map_addr);
+	}
+	return ret;
+}
+
+/*
+ * Lock the RD granule @g_rd with the DATA granules from @g_data locked. The
+ * lock is only tried when @g_rd is below @g_data, as waiting on it would
+ * break the lock ordering.
+ */
+static bool data_create_lock_rd(struct granule *g_rd, struct granule *g_data)
+{
+	if (g_rd > g_data) {
+		return granule_lock_on_state_match(g_rd, GRANULE_STATE_RD);
+	}
+
+	for (unsigned int i = 0U; i < DATA_CREATE_RD_TRYLOCK_RETRIES; i++) {
+		if (granule_trylock_on_state_match(g_rd, GRANULE_STATE_RD)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Data.Create with the source granules copied, and the content of a single
+ * DATA granule hashed, before the RD granule is locked. Data.Create commands
+ * into the same realm then only serialise on the RTT walk and the RIM
+ * extension.
+ *
+ * Returns false, with no lock held, if the RD granule could not be locked
+ * after the copy, in which case the caller is expected to lock all the
+ * granules in order and start over.
+ */
+static bool data_create_copy_first(struct granule *g_data,
+				   struct granule *g_rd,
+				   unsigned long data_addr,
+				   unsigned long map_addr,
+				   struct granule *g_src,
+				   unsigned long flags,
+				   long level,
+				   unsigned long *ret)
+{
+	unsigned char content[MAX_MEASUREMENT_SIZE];
+	unsigned long nr_granules = s2tte_map_size(level) / GRANULE_SIZE;
+	enum granule_state new_data_state = GRANULE_STATE_DELEGATED;
+	struct measurement_ctx mctx;
+	enum hash_algo algorithm;
+	unsigned int mecid;
+	bool measured, copied;
+	struct rd *rd;
+	unsigned long i;
+
+	/*
+	 * The algorithm and the MECID of a realm do not change once it is
+	 * created
+	 */
+	if (!granule_lock_on_state_match(g_rd, GRANULE_STATE_RD)) {
+		*ret = RMI_ERROR_INPUT;
+		return true;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+	algorithm = rd->algorithm;
+	mecid = rd->s2_ctx.mecid;
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+
+	for (i = 0UL; i < nr_granules; i++) {
+		if (!granule_lock_on_state_match(&g_data[i],
+						 GRANULE_STATE_DELEGATED)) {
+			while (i != 0UL) {
+				granule_unlock(&g_data[--i]);
+			}
+			*ret = RMI_ERROR_INPUT;
+			return true;
+		}
+	}
+
+	*ret = RMI_SUCCESS;
+
+	/* The content of a block is hashed with the RD locked */
+	measured = (nr_granules == 1UL) && (flags == RMI_MEASURE_CONTENT);
+	if (measured) {
+		measurement_ctx_begin(&mctx, algorithm);
+	}
+
+	for (i = 0UL; i < nr_granules; i++) {
+		void *data;
+		bool ns_access_ok;
+
+		if (mecid != MECID_RMM) {
+			granule_mec_clean(&g_data[i]);
+		}
+
+		data = granule_map_mec(&g_data[i], SLOT_DELEGATED, mecid);
+
+		if (measured) {
+			/* Hash the content while it is copied */
+			ns_access_ok = ns_buffer_read_hash(SLOT_NS, &g_src[i],
+							   data, &mctx,
+							   content);
+		} else {
+			ns_access_ok = ns_buffer_read(SLOT_NS, &g_src[i], 0U,
+						      GRANULE_SIZE, data);
+		}
+
+		buffer_unmap(data);
+
+		if (!ns_access_ok) {
+			*ret = RMI_ERROR_INPUT;
+			break;
+		}
+	}
+
+	if (measured) {
+		measurement_ctx_end(&mctx);
+	}
+
+	if (*ret == RMI_SUCCESS) {
+		if (!data_create_lock_rd(g_rd, g_data)) {
+			for (i = 0UL; i < nr_granules; i++) {
+				granule_set_needs_scrub(&g_data[i]);
+				granule_unlock(&g_data[i]);
+			}
+			return false;
+		}
+
+		rd = granule_map(g_rd, SLOT_RD);
+
+		/*
+		 * @g_rd may have been reused by another realm in between, in
+		 * which case the copy is made again if its MECID differs.
+		 */
+		copied = (rd->s2_ctx.mecid == mecid);
+		*ret = data_create_locked(rd, g_data, data_addr, map_addr,
+				g_src, flags, level, copied,
+				(copied && measured &&
+				 (rd->algorithm == algorithm)) ?
+					content : NULL);
+
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+	}
+
+	if (*ret == RMI_SUCCESS) {
+		new_data_state = GRANULE_STATE_DATA;
+	}
+
+	for (i = 0UL; i < nr_granules; i++) {
+		/*
+		 * Some data may be copied before a failure. The granules
+		 * remain in delegated state, so have them scrubbed before
+		 * their next use.
+		 */
+		if (*ret == RMI_SUCCESS) {
+			granule_clear_needs_scrub(&g_data[i]);
+		} else {
+			granule_set_needs_scrub(&g_data[i]);
+		}
+		granule_unlock_transition(&g_data[i], new_data_state);
+	}
+
+	return true;
+}
+
+/*
+ * Implements both Data.Create and Data.CreateUnknown
+ *
+ * if @g_src == NULL, this implemented Data.CreateUnknown
+ * and otherwise this implemented Data.Create.
+ *
+ * The data is mapped by a single s2tte at @level. For a block level, the
+ * data, map and source addresses refer to runs of contiguous granules of
+ * the size of the block, and @g_src points to the first source granule.
+ *
+ * If @g_src is the first DATA granule, the content of the DATA granules,
+ * preloaded by the Host, is measured in place and nothing is copied.
+ */
+static unsigned long data_create(unsigned long data_addr,
+				 unsigned long rd_addr,
+				 unsigned long map_addr,
+				 struct granule *g_src,
+				 unsigned long flags,
+				 long level)
+{
+	struct granule *g_data;
+	struct granule *g_rd;
+	struct rd *rd;
+	enum granule_state new_data_state = GRANULE_STATE_DELEGATED;
+	unsigned long nr_granules = s2tte_map_size(level) / GRANULE_SIZE;
+	unsigned long i;
+	unsigned long ret;
+	bool in_place;
+
+	if (!addr_is_level_aligned(data_addr, level)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	g_data = find_granule_range(data_addr, nr_granules);
+	g_rd = find_granule(rd_addr);
+	if ((g_data == NULL) || (g_rd == NULL)) {
+		return RMI_ERROR_INPUT;
+	}
+
+	in_place = (g_src == g_data);
+
+	if ((g_src != NULL) && !in_place &&
+	    data_create_copy_first(g_data, g_rd, data_addr, map_addr,
+				   g_src, flags, level, &ret)) {
+		return ret;
+	}
+
+	i = lock_data_range_and_rd(g_data, nr_granules, g_rd);
+	if (i != nr_granules) {
+		if (i != 0UL) {
+			granule_unlock(g_rd);
+			while (i != 0UL) {
+				granule_unlock(&g_data[--i]);
+			}
+		}
+		return RMI_ERROR_INPUT;
+	}
+
+	for (i = 0UL; in_place && (i < nr_granules); i++) {
+		if (!granule_is_preloaded(&g_data[i])) {
+			granule_unlock(g_rd);
+			for (i = 0UL; i < nr_granules; i++) {
+				granule_unlock(&g_data[i]);
+			}
+			return RMI_ERROR_INPUT;
+		}
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	/*
+	 * The content preloaded by the Host was written in the memory
+	 * encryption context of the Host, so a Realm with its own one could
+	 * not read it.
+	 */
+	if (in_place && (rd->s2_ctx.mecid != MECID_RMM)) {
+		ret = RMI_ERROR_INPUT;
+	} else {
+		ret = data_create_locked(rd, g_data, data_addr, map_addr,
+					 g_src, flags, level, in_place, NULL);
+	}
+	if (ret == RMI_SUCCESS) {
+		new_data_state = GRANULE_STATE_DATA;
+	}
+
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+	for (i = 0UL; i < nr_granules; i++) {
+		granule_unlock_transition(&g_data[i], new_data_state);
+	}
+	return ret;
 }
 
-static unsigned long validate_data_create_unknown(unsigned long map_addr,
-						  struct rd *rd)
+/*
+ * Returns the level of the s2tte created by Data.Create and
+ * Data.CreateUnknown for @flags.
+ */
+static long data_create_level(unsigned long flags)
+{
+	return ((flags & RMI_DATA_CREATE_BLOCK) != 0UL) ?
+		RTT_DATA_BLOCK_LEVEL : RTT_PAGE_LEVEL;
+}
+
+unsigned long smc_data_create(unsigned long data_addr,
+			      unsigned long rd_addr,
+			      unsigned long map_addr,
+			      unsigned long src_addr,
+			      unsigned long flags)
+{
+	struct granule *g_src;
+	unsigned long i, nr_granules, measure;
+	enum granule_state src_state = GRANULE_STATE_NS;
+	long level;
+
+	if ((flags & ~(RMI_MEASURE_CONTENT | RMI_DATA_CREATE_BLOCK |
+		       RMI_DATA_CREATE_IN_PLACE)) != 0UL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	if ((flags & RMI_DATA_CREATE_IN_PLACE) != 0UL) {
+		if (src_addr != data_addr) {
+			return RMI_ERROR_INPUT;
+		}
+		src_state = GRANULE_STATE_DELEGATED;
+	}
+
+	level = data_create_level(flags);
+	measure = flags & RMI_MEASURE_CONTENT;
+	nr_granules = s2tte_map_size(level) / GRANULE_SIZE;
+
+	g_src = find_granule_range(src_addr, nr_granules);
+	if (g_src == NULL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	for (i = 0UL; i < nr_granules; i++) {
+		if (g_src[i].state != src_state) {
+			return RMI_ERROR_INPUT;
+		}
+	}
+
+	return data_create(data_addr, rd_addr, map_addr, g_src, measure, level);
+}
+
+unsigned long smc_data_create_unknown(unsigned long data_addr,
+				      unsigned long rd_addr,
+				      unsigned long map_addr,
+				      unsigned long flags)
+{
+	if ((flags & ~RMI_DATA_CREATE_BLOCK) != 0UL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	return data_create(data_addr, rd_addr, map_addr, NULL, 0,
+			   data_create_level(flags));
+}
+
+/* Number of DATA granules whose contents are hashed together */
+#define DATA_HASH_BATCH_LEN	2U
+
+/*
+ * Implements Data.Create for a run of @count granules at consecutive data,
+ * map and source addresses which are all translated by the same last level
+ * RTT. The RTT walk is done once for the whole run.
+ *
+ * On return, ret->x[1] holds the number of granules created, which may be
+ * smaller than @count if the run crosses the end of the last level RTT, in
+ * which case the Host is expected to reissue the command for the remaining
+ * granules. ret->x[0] is RMI_SUCCESS if all the granules processed by this
+ * call were created, and reports the error for the first granule which
+ * could not be created otherwise.
+ */
+void smc_data_create_range(unsigned long data_base,
+			   unsigned long rd_addr,
+			   unsigned long map_base,
+			   unsigned long src_base,
+			   unsigned long flags,
+			   unsigned long count,
+			   struct smc_result *ret)
+{
+	const enum buffer_slot data_slots[DATA_HASH_BATCH_LEN] = {
+		SLOT_DELEGATED, SLOT_DELEGATED2
+	};
+	struct granule *g_data, *g_src, *g_rd;
+	struct rd *rd;
+	struct rtt_walk wi;
+	struct measurement_ctx mctx;
+	unsigned long s2tte, *s2tt;
+	unsigned long i, nr_locked, nr_done = 0UL;
+	bool fold = false;
+
+	ret->x[1] = 0UL;
+
+	if ((flags != RMI_NO_MEASURE_CONTENT) &&
+	    (flags != RMI_MEASURE_CONTENT)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	/* Limit the run to the entries of the last level RTT */
+	i = (map_base >> GRANULE_SHIFT) & (S2TTES_PER_S2TT - 1UL);
+	if (count > (S2TTES_PER_S2TT - i)) {
+		count = S2TTES_PER_S2TT - i;
+	}
+
+	g_data = find_granule_range(data_base, count);
+	g_src = find_granule_range(src_base, count);
+	g_rd = find_granule(rd_addr);
+	if ((g_data == NULL) || (g_src == NULL) || (g_rd == NULL)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	for (i = 0UL; i < count; i++) {
+		if (g_src[i].state != GRANULE_STATE_NS) {
+			ret->x[0] = RMI_ERROR_INPUT;
+			return;
+		}
+	}
+
+	nr_locked = lock_data_range_and_rd(g_data, count, g_rd);
+	if (nr_locked == 0UL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	ret->x[0] = validate_data_create(map_base, RTT_PAGE_LEVEL, rd);
+	if (ret->x[0] != RMI_SUCCESS) {
+		goto out_unmap_rd;
+	}
+
+	if (!addr_in_par(rd, map_base + ((nr_locked - 1UL) * GRANULE_SIZE))) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		goto out_unmap_rd;
+	}
+
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	rtt_walk_lock_unlock_pool(rd, map_base, RTT_PAGE_LEVEL, &wi);
+	if (wi.last_level != RTT_PAGE_LEVEL) {
+		ret->x[0] = rtt_walk_error(&wi, map_base, RTT_PAGE_LEVEL);
+		goto out_unlock_ll_table;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	measurement_ctx_begin(&mctx, rd->algorithm);
+
+	while ((nr_done < nr_locked) && (ret->x[0] == RMI_SUCCESS)) {
+		unsigned char content[DATA_HASH_BATCH_LEN][MAX_MEASUREMENT_SIZE];
+		unsigned char *hash_out[DATA_HASH_BATCH_LEN];
+		void *data[DATA_HASH_BATCH_LEN];
+		unsigned int nr_batch = 0U;
+
+		/*
+		 * Copy up to DATA_HASH_BATCH_LEN granules, keeping them mapped
+		 * so that their contents are hashed together.
+		 */
+		while ((nr_batch < DATA_HASH_BATCH_LEN) &&
+		       ((nr_done + nr_batch) < nr_locked)) {
+			unsigned long j = nr_done + nr_batch;
+
+			s2tte = s2tte_read(&s2tt[wi.index + j]);
+			if (!s2tte_is_unassigned(s2tte)) {
+				ret->x[0] = pack_return_code(RMI_ERROR_RTT,
+							     RTT_PAGE_LEVEL);
+				break;
+			}
+
+			if (rd->s2_ctx.mecid != MECID_RMM) {
+				granule_mec_clean(&g_data[j]);
+			}
+
+			data[nr_batch] = granule_map_mec(&g_data[j],
+						data_slots[nr_batch],
+						rd->s2_ctx.mecid);
+
+			if (!ns_buffer_read(SLOT_NS, &g_src[j], 0U,
+					    GRANULE_SIZE, data[nr_batch])) {
+				/*
+				 * Some data may be copied before the failure.
+				 * The granule remains in delegated state, so
+				 * have it scrubbed before its next use.
+				 */
+				buffer_unmap(data[nr_batch]);
+				granule_set_needs_scrub(&g_data[j]);
+				ret->x[0] = RMI_ERROR_INPUT;
+				break;
+			}
+
+			granule_clear_needs_scrub(&g_data[j]);
+			hash_out[nr_batch] = content[nr_batch];
+			nr_batch++;
+		}
+
+		/* The contents are hashed while they are still in the caches */
+		if (flags == RMI_MEASURE_CONTENT) {
+			measurement_ctx_hash_multi(&mctx, data, GRANULE_SIZE,
+						   hash_out, nr_batch);
+		}
+
+		/* Extend the RIM in increasing IPA order */
+		for (unsigned int k = 0U; k < nr_batch; k++, nr_done++) {
+			unsigned long index = wi.index + nr_done;
+			unsigned long data_addr = data_base +
+						  (nr_done * GRANULE_SIZE);
+
+			data_desc_measure(&mctx, rd,
+					  map_base + (nr_done * GRANULE_SIZE),
+					  flags, content[k]);
+			buffer_unmap(data[k]);
+
+			s2tte = s2tte_read(&s2tt[index]);
+			s2tte = (s2tte_get_ripas(s2tte) == RMI_EMPTY) ?
+				s2tte_create_assigned_empty(data_addr,
+							    RTT_PAGE_LEVEL) :
+				s2tte_create_valid(data_addr, RTT_PAGE_LEVEL);
+
+			s2tte_write(&s2tt[index], s2tte);
+			__granule_get(wi.g_llt);
+		}
+	}
+
+	measurement_ctx_end(&mctx);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, (long)nr_done);
+
+	if ((nr_done == nr_locked) && (nr_locked != count)) {
+		/* Report the granule which is not in DELEGATED state */
+		ret->x[0] = RMI_ERROR_INPUT;
+	}
+
+	fold = (wi.g_llt->refcount == S2TTES_PER_S2TT);
+	buffer_unmap(s2tt);
+out_unlock_ll_table:
+	granule_unlock(wi.g_llt);
+	if (fold) {
+		rtt_auto_fold(rd, granule_addr(wi.g_llt), map_base);
+	}
+out_unmap_rd:
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+
+	for (i = 0UL; i < nr_locked; i++) {
+		if (i < nr_done) {
+			granule_unlock_transition(&g_data[i],
+						  GRANULE_STATE_DATA);
+		} else {
+			granule_unlock(&g_data[i]);
+		}
+	}
+
+	ret->x[1] = nr_done;
+}
+
+unsigned long smc_data_destroy(unsigned long rd_addr,
+			       unsigned long map_addr)
 {
-	if (!addr_in_par(rd, map_addr)) {
+	struct granule *g_data;
+	struct granule *g_rd;
+	struct granule *g_table_root;
+	struct rtt_walk wi;
+	unsigned long data_addr, s2tte, *s2tt;
+	struct rd *rd;
+	unsigned long i, nr_granules;
+	unsigned long ret;
+	struct realm_s2_context s2_ctx;
+	bool valid;
+	long level;
+
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		return RMI_ERROR_INPUT;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!validate_map_addr(map_addr, RTT_PAGE_LEVEL, rd)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
 		return RMI_ERROR_INPUT;
 	}
 
-	if (!validate_map_addr(map_addr, RTT_PAGE_LEVEL, rd)) {
-		return RMI_ERROR_INPUT;
-	}
+	g_table_root = rd->s2_ctx.g_rtt;
+	s2_ctx = rd->s2_ctx;
+
+	/*
+	 * The RD stays mapped to record the unmapping below. It cannot be
+	 * destroyed while its RTTs hold the mapping.
+	 */
+	granule_lock(g_table_root, GRANULE_STATE_RTT);
+	granule_unlock(g_rd);
+
+	rtt_walk_lock_unlock_ctx(&s2_ctx, map_addr, RTT_PAGE_LEVEL, &wi);
+
+	/*
+	 * Data can also be mapped by a block s2tte at RTT_DATA_BLOCK_LEVEL,
+	 * in which case @map_addr must be the base of the block. A larger
+	 * block has to be split with RMI_RTT_CREATE first, so that the number
+	 * of granules scrubbed by one call remains bounded.
+	 */
+	level = wi.last_level;
+	if ((level != RTT_PAGE_LEVEL) &&
+	    ((level != RTT_DATA_BLOCK_LEVEL) ||
+	     !addr_is_level_aligned(map_addr, level))) {
+		ret = pack_return_code(RMI_ERROR_RTT, level);
+		goto out_unlock_ll_table;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	s2tte = s2tte_read(&s2tt[wi.index]);
+
+	valid = s2tte_is_valid(s2tte, level);
+
+	/* The content of an Exported page is discarded, as if it was valid */
+	if ((level == RTT_PAGE_LEVEL) && s2tte_is_exported(s2tte)) {
+		s2tte_write(&s2tt[wi.index], s2tte_create_destroyed());
+		realm_ripas_summary_clear(rd, map_addr,
+					  map_addr + GRANULE_SIZE);
+		ret = RMI_SUCCESS;
+		goto out_unmap_ll_table;
+	}
+
+	/*
+	 * Check if either HIPAS=ASSIGNED or map_addr is a
+	 * valid Protected IPA.
+	 */
+	if (!valid && !s2tte_is_assigned(s2tte, level)) {
+		ret = pack_return_code(RMI_ERROR_RTT, level);
+		goto out_unmap_ll_table;
+	}
+
+	data_addr = s2tte_pa(s2tte, level);
+	nr_granules = s2tte_map_size(level) / GRANULE_SIZE;
+
+	/*
+	 * We have already established either HIPAS=ASSIGNED or a valid mapping.
+	 * If valid, transition HIPAS to DESTROYED and if HIPAS=ASSIGNED,
+	 * transition to UNASSIGNED.
+	 */
+	s2tte = valid ? s2tte_create_destroyed() :
+			s2tte_create_unassigned(RMI_EMPTY);
+
+	s2tte_write(&s2tt[wi.index], s2tte);
+	realm_ripas_summary_clear(rd, map_addr, map_addr + s2tte_map_size(level));
+
+	if (valid) {
+		if (level == RTT_PAGE_LEVEL) {
+			invalidate_page(&s2_ctx, map_addr);
+		} else {
+			invalidate_block(&s2_ctx, map_addr);
+		}
+		realm_s2_unmap_gen_inc(rd);
+	}
+
+	__granule_put(wi.g_llt);
+
+	/*
+	 * Lock the data granules and check expected state. Correct locking
+	 * order is guaranteed because granule address is obtained from a locked
+	 * granule by table walk. This lock needs to be acquired before a state
+	 * transition to or from GRANULE_STATE_DATA for granule address can
+	 * happen. Only one DATA granule is locked at a time.
+	 */
+	for (i = 0UL; i < nr_granules; i++) {
+		g_data = find_lock_granule(data_addr + (i * GRANULE_SIZE),
+					   GRANULE_STATE_DATA);
+		assert(g_data);
+		data_granule_release(g_data, s2_ctx.mecid);
+	}
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, -(long)nr_granules);
+
+	ret = RMI_SUCCESS;
 
-	return RMI_SUCCESS;
+out_unmap_ll_table:
+	buffer_unmap(s2tt);
+out_unlock_ll_table:
+	granule_unlock(wi.g_llt);
+	buffer_unmap(rd);
+
+	return ret;
 }
 
-static unsigned long validate_data_create(unsigned long map_addr,
-					  struct rd *rd)
+/*
+ * Release the @nr_granules DATA granules starting at @data_addr, which an
+ * s2tte of a locked RTT mapped until the TLBs were invalidated, and add
+ * them as DELEGATED granules to the NS list of @td.
+ *
+ * As in smc_data_destroy(), the granule addresses are read from a locked
+ * RTT and only one DATA granule is locked at a time.
+ */
+static void data_release(struct realm_teardown *td, unsigned long data_addr,
+			 unsigned long nr_granules)
 {
-	if (get_rd_state_locked(rd) != REALM_STATE_NEW) {
-		return RMI_ERROR_REALM;
+	for (unsigned long i = 0UL; i < nr_granules; i++) {
+		unsigned long pa = data_addr + (i * GRANULE_SIZE);
+		struct granule *g_data;
+
+		g_data = find_lock_granule(pa, GRANULE_STATE_DATA);
+		assert(g_data != NULL);
+		data_granule_release(g_data, td->mecid);
+		teardown_add(td, pa);
 	}
-
-	return validate_data_create_unknown(map_addr, rd);
 }
 
 /*
- * Implements both Data.Create and Data.CreateUnknown
+ * Implements RMI_DATA_DESTROY_RANGE.
  *
- * if @g_src == NULL, this implemented Data.CreateUnknown
- * and otherwise this implemented Data.Create.
+ * Destroy the data granules mapped by the s2ttes of one RTT from @base up
+ * to @top, with a single walk and a single range TLB invalidation, instead
+ * of one RMI_DATA_DESTROY per granule. Unassigned and Destroyed s2ttes are
+ * skipped. The addresses of the released granules, which are DELEGATED, are
+ * written to the NS granule at @list_addr. The call stops at the first s2tte
+ * which is neither, at the end of the RTT, or when the list is full, and
+ * returns the address it stopped at.
+ *
+ * The valid s2ttes are first made invalid with their output address kept,
+ * so that the data granules are only scrubbed and released once the TLBs
+ * have been invalidated.
  */
-static unsigned long data_create(unsigned long data_addr,
-				 unsigned long rd_addr,
-				 unsigned long map_addr,
-				 struct granule *g_src,
-				 unsigned long flags)
+void smc_data_destroy_range(unsigned long rd_addr,
+			    unsigned long base,
+			    unsigned long top,
+			    unsigned long list_addr,
+			    struct smc_result *ret)
 {
-	struct granule *g_data;
+	struct realm_teardown td = { 0 };
 	struct granule *g_rd;
 	struct granule *g_table_root;
-	struct rd *rd;
 	struct rtt_walk wi;
-	unsigned long s2tte, *s2tt;
-	enum ripas ripas;
-	enum granule_state new_data_state = GRANULE_STATE_DELEGATED;
-	unsigned long ipa_bits;
-	unsigned long ret;
-	int __unused meas_ret;
-	int sl;
+	unsigned long *s2tt, s2tte;
+	unsigned long addr, map_size, index, nr_granules;
+	unsigned long nr_data = 0UL;
+	struct realm_s2_context s2_ctx;
+	struct rd *rd;
+	bool valid = false;
+	long level;
 
-	if (!find_lock_two_granules(data_addr,
-				    GRANULE_STATE_DELEGATED,
-				    &g_data,
-				    rd_addr,
-				    GRANULE_STATE_RD,
-				    &g_rd)) {
-		return RMI_ERROR_INPUT;
+	td.g_list = find_granule(list_addr);
+	if ((top <= base) || (td.g_list == NULL) ||
+	    (td.g_list->state != GRANULE_STATE_NS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
 	}
 
-	rd = granule_map(g_rd, SLOT_RD);
+	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
+	if (g_rd == NULL) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
 
-	ret = (g_src != NULL) ?
-		validate_data_create(map_addr, rd) :
-		validate_data_create_unknown(map_addr, rd);
+	rd = granule_map(g_rd, SLOT_RD);
 
-	if (ret != RMI_SUCCESS) {
-		goto out_unmap_rd;
+	if (!validate_map_addr(base, RTT_PAGE_LEVEL, rd)) {
+		buffer_unmap(rd);
+		granule_unlock(g_rd);
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
 	}
 
 	g_table_root = rd->s2_ctx.g_rtt;
-	sl = realm_rtt_starting_level(rd);
-	ipa_bits = realm_ipa_bits(rd);
+	s2_ctx = rd->s2_ctx;
+	td.mecid = s2_ctx.mecid;
+
+	/* The RD stays mapped to record the unmapping below */
 	granule_lock(g_table_root, GRANULE_STATE_RTT);
-	rtt_walk_lock_unlock(g_table_root, sl, ipa_bits,
-			     map_addr, RTT_PAGE_LEVEL, &wi);
-	if (wi.last_level != RTT_PAGE_LEVEL) {
-		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
+	granule_unlock(g_rd);
+
+	rtt_walk_lock_unlock_ctx(&s2_ctx, base, RTT_PAGE_LEVEL, &wi);
+
+	/* As for RMI_DATA_DESTROY, blocks are only destroyed at their base */
+	level = wi.last_level;
+	if ((level != RTT_PAGE_LEVEL) &&
+	    ((level != RTT_DATA_BLOCK_LEVEL) ||
+	     !addr_is_level_aligned(base, level))) {
+		ret->x[0] = pack_return_code(RMI_ERROR_RTT,
+					     (unsigned int)level);
 		goto out_unlock_ll_table;
 	}
 
 	s2tt = granule_map(wi.g_llt, SLOT_RTT);
-	s2tte = s2tte_read(&s2tt[wi.index]);
-	if (!s2tte_is_unassigned(s2tte)) {
-		ret = pack_return_code(RMI_ERROR_RTT, RTT_PAGE_LEVEL);
-		goto out_unmap_ll_table;
-	}
-
-	ripas = s2tte_get_ripas(s2tte);
+	map_size = s2tte_map_size((int)level);
+	nr_granules = map_size / GRANULE_SIZE;
+
+	/* Make the valid s2ttes in the range invalid */
+	for (addr = base, index = wi.index;
+	     (addr < top) && (index < S2TTES_PER_S2TT);
+	     addr += map_size, index++) {
+		unsigned long cls = s2tte_classify(s2tte_read(&s2tt[index]),
+						   level);
+		enum s2tte_type type = s2tte_class_type(cls);
+
+		if ((type == S2TTE_TYPE_UNASSIGNED) ||
+		    (type == S2TTE_TYPE_DESTROYED)) {
+			continue;
+		}
 
-	if (g_src != NULL) {
-		bool ns_access_ok;
-		void *data = granule_map(g_data, SLOT_DELEGATED);
+		if ((type != S2TTE_TYPE_VALID) &&
+		    (type != S2TTE_TYPE_ASSIGNED)) {
+			break;
+		}
 
-		ns_access_ok = ns_buffer_read(SLOT_NS, g_src, 0U,
-					      GRANULE_SIZE, data);
+		if (!teardown_fits(&td, nr_data + nr_granules)) {
+			break;
+		}
 
-		if (!ns_access_ok) {
-			/*
-			 * Some data may be copied before the failure. Zero
-			 * g_data granule as it will remain in delegated state.
-			 */
-			(void)memset(data, 0, GRANULE_SIZE);
-			buffer_unmap(data);
-			ret = RMI_ERROR_INPUT;
-			goto out_unmap_ll_table;
+		if (type == S2TTE_TYPE_VALID) {
+			s2tte_write(&s2tt[index], s2tte_create_assigned_ram(
+					s2tte_class_pa(cls), level));
+			valid = true;
 		}
+		nr_data += nr_granules;
+	}
 
+	if (addr == base) {
+		ret->x[0] = pack_return_code(RMI_ERROR_RTT,
+					     (unsigned int)level);
+		goto out_unmap_ll_table;
+	}
 
-		data_granule_measure(rd, data, map_addr, flags);
+	realm_ripas_summary_clear(rd, base, addr);
 
-		buffer_unmap(data);
+	if (valid) {
+		invalidate_range(&s2_ctx, base, addr - base, level);
+		realm_s2_unmap_gen_inc(rd);
 	}
 
-	new_data_state = GRANULE_STATE_DATA;
+	/* Release the data granules, now that no TLB entry maps them */
+	for (unsigned long a = base, i = wi.index; a < addr;
+	     a += map_size, i++) {
+		unsigned long data_addr;
 
-	s2tte = (ripas == RMI_EMPTY) ?
-		s2tte_create_assigned_empty(data_addr, RTT_PAGE_LEVEL) :
-		s2tte_create_valid(data_addr, RTT_PAGE_LEVEL);
+		s2tte = s2tte_read(&s2tt[i]);
+		if (!s2tte_is_assigned(s2tte, level)) {
+			continue;
+		}
 
-	s2tte_write(&s2tt[wi.index], s2tte);
-	__granule_get(wi.g_llt);
+		/* A valid s2tte had RIPAS RAM, it becomes Destroyed */
+		data_addr = s2tte_pa(s2tte, level);
+		s2tte_write(&s2tt[i], (s2tte_get_ripas(s2tte) == RMI_RAM) ?
+				s2tte_create_destroyed() :
+				s2tte_create_unassigned(RMI_EMPTY));
+		__granule_put(wi.g_llt);
+		data_release(&td, data_addr, nr_granules);
+	}
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, -(long)nr_data);
 
-	ret = RMI_SUCCESS;
+	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = addr;
 
 out_unmap_ll_table:
 	buffer_unmap(s2tt);
 out_unlock_ll_table:
 	granule_unlock(wi.g_llt);
-out_unmap_rd:
 	buffer_unmap(rd);
-	granule_unlock(g_rd);
-	granule_unlock_transition(g_data, new_data_state);
-	return ret;
+
+	teardown_flush(&td);
+	ret->x[2] = td.count;
 }
 
-unsigned long smc_data_create(unsigned long data_addr,
-			      unsigned long rd_addr,
-			      unsigned long map_addr,
-			      unsigned long src_addr,
-			      unsigned long flags)
+/* Size of the chunks in which the content of a granule is exported */
+#define DATA_EXPORT_CHUNK_SIZE	256U
+
+/*
+ * Encrypt the content of the DATA granule @g_data, mapped at @map_addr in
+ * the realm @rd, to the NS granule @g_ns, and return its tag in @tag. The
+ * IPA is authenticated with the content, and @seq is the IV.
+ *
+ * The content is encrypted in chunks through the stack, rather than in
+ * place, so that the granule still holds it if the export fails.
+ */
+static bool data_export_seal(struct rd *rd, struct granule *g_data,
+			     struct granule *g_ns, unsigned long map_addr,
+			     unsigned long seq, unsigned char *tag)
 {
-	struct granule *g_src;
-	unsigned long ret;
+	struct attest_export_ctx ctx;
+	unsigned char chunk[DATA_EXPORT_CHUNK_SIZE];
+	unsigned char *data;
+	bool ok = true;
 
-	if (flags != RMI_NO_MEASURE_CONTENT && flags != RMI_MEASURE_CONTENT) {
-		return RMI_ERROR_INPUT;
+	if (attest_export_start(&ctx, rd->export_key, true, seq,
+				&map_addr, sizeof(map_addr)) != 0) {
+		return false;
 	}
 
-	g_src = find_granule(src_addr);
-	if ((g_src == NULL) || (g_src->state != GRANULE_STATE_NS)) {
-		return RMI_ERROR_INPUT;
+	data = granule_map(g_data, SLOT_DELEGATED);
+	for (unsigned int off = 0U; ok && (off < GRANULE_SIZE);
+	     off += DATA_EXPORT_CHUNK_SIZE) {
+		ok = (attest_export_update(&ctx, &data[off], chunk,
+					   sizeof(chunk)) == 0) &&
+		     ns_buffer_write(SLOT_NS, g_ns, off, sizeof(chunk), chunk);
 	}
+	buffer_unmap(data);
 
-	ret = data_create(data_addr, rd_addr, map_addr, g_src, flags);
+	/* The context is released even if an update has failed */
+	if (attest_export_finish(&ctx, tag) != 0) {
+		ok = false;
+	}
 
-	return ret;
+	return ok;
 }
 
-unsigned long smc_data_create_unknown(unsigned long data_addr,
-				      unsigned long rd_addr,
-				      unsigned long map_addr)
+/*
+ * Decrypt in place the content of the DELEGATED granule @g_data, exported
+ * from @map_addr in the realm @rd with the sequence number @seq, and check
+ * it against @tag.
+ */
+static bool data_import_open(struct rd *rd, struct granule *g_data,
+			     unsigned long map_addr, unsigned long seq,
+			     unsigned char *tag)
 {
-	return data_create(data_addr, rd_addr, map_addr, NULL, 0);
+	struct attest_export_ctx ctx;
+	void *data;
+	bool ok;
+
+	if (attest_export_start(&ctx, rd->export_key, false, seq,
+				&map_addr, sizeof(map_addr)) != 0) {
+		return false;
+	}
+
+	data = granule_map(g_data, SLOT_DELEGATED);
+	ok = (attest_export_update(&ctx, data, data, GRANULE_SIZE) == 0);
+	buffer_unmap(data);
+
+	if (attest_export_finish(&ctx, tag) != 0) {
+		ok = false;
+	}
+
+	return ok;
 }
 
-unsigned long smc_data_destroy(unsigned long rd_addr,
-			       unsigned long map_addr)
+/*
+ * Unmap the page at @map_addr in the realm @rd, export its content to
+ * @g_ns with the sequence number @seq and release its DATA granule. The
+ * RTT root of the realm is locked by the caller.
+ */
+static void data_export_locked(struct rd *rd,
+			       const struct realm_s2_context *s2_ctx,
+			       unsigned long map_addr,
+			       unsigned long seq,
+			       struct granule *g_ns,
+			       struct smc_result *ret)
 {
+	unsigned char tag[EXPORT_TAG_SIZE];
+	unsigned long s2tte, *s2tt, data_addr;
 	struct granule *g_data;
-	struct granule *g_rd;
-	struct granule *g_table_root;
 	struct rtt_walk wi;
-	unsigned long data_addr, s2tte, *s2tt;
-	struct rd *rd;
-	unsigned long ipa_bits;
-	unsigned long ret;
+
+	rtt_walk_lock_unlock_ctx(s2_ctx, map_addr, RTT_PAGE_LEVEL, &wi);
+	if (wi.last_level != RTT_PAGE_LEVEL) {
+		ret->x[0] = pack_return_code(RMI_ERROR_RTT,
+					     (unsigned int)wi.last_level);
+		granule_unlock(wi.g_llt);
+		return;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	s2tte = s2tte_read(&s2tt[wi.index]);
+	if (!s2tte_is_valid(s2tte, RTT_PAGE_LEVEL)) {
+		ret->x[0] = pack_return_code(RMI_ERROR_RTT, RTT_PAGE_LEVEL);
+		goto out_unmap_ll_table;
+	}
+
+	/*
+	 * The page is unmapped before its content is read, so that the Realm
+	 * cannot change it afterwards. The output address is kept in the
+	 * s2tte until the content has been exported.
+	 */
+	data_addr = s2tte_pa(s2tte, RTT_PAGE_LEVEL);
+	s2tte_write(&s2tt[wi.index],
+		    s2tte_create_assigned_ram(data_addr, RTT_PAGE_LEVEL));
+	invalidate_page(s2_ctx, map_addr);
+	realm_s2_unmap_gen_inc(rd);
+
+	/* As in smc_data_destroy(), the address is read from a locked RTT */
+	g_data = find_lock_granule(data_addr, GRANULE_STATE_DATA);
+	assert(g_data != NULL);
+
+	if (!data_export_seal(rd, g_data, g_ns, map_addr, seq, tag)) {
+		/* The content of the granule is unchanged */
+		s2tte_write(&s2tt[wi.index], s2tte);
+		granule_unlock(g_data);
+		ret->x[0] = RMI_ERROR_INPUT;
+		goto out_unmap_ll_table;
+	}
+
+	s2tte_write(&s2tt[wi.index], s2tte_create_exported(seq));
+	realm_ripas_summary_clear(rd, map_addr, map_addr + GRANULE_SIZE);
+	__granule_put(wi.g_llt);
+
+	data_granule_release(g_data, MECID_RMM);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, -1L);
+
+	ret->x[0] = RMI_SUCCESS;
+	ret->x[1] = data_addr;
+	(void)memcpy(&ret->x[2], tag, sizeof(tag));
+
+out_unmap_ll_table:
+	buffer_unmap(s2tt);
+	granule_unlock(wi.g_llt);
+}
+
+/*
+ * Implements RMI_DATA_EXPORT.
+ *
+ * Export the content of a page of a Realm to the Host, encrypted and
+ * authenticated with a key of the Realm, so that the Host can reuse its
+ * DATA granule. See SMC_RMM_DATA_EXPORT.
+ */
+void smc_data_export(unsigned long rd_addr,
+		     unsigned long map_addr,
+		     unsigned long ns_addr,
+		     struct smc_result *ret)
+{
 	struct realm_s2_context s2_ctx;
-	bool valid;
-	int sl;
+	struct granule *g_rd, *g_ns;
+	unsigned long seq;
+	struct rd *rd;
+
+	g_ns = find_granule(ns_addr);
+	if ((g_ns == NULL) || (g_ns->state != GRANULE_STATE_NS)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
 
 	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
 	if (g_rd == NULL) {
-		return RMI_ERROR_INPUT;
+		ret->x[0] = RMI_ERROR_INPUT;
+		return;
 	}
 
 	rd = granule_map(g_rd, SLOT_RD);
 
-	if (!validate_map_addr(map_addr, RTT_PAGE_LEVEL, rd)) {
-		buffer_unmap(rd);
-		granule_unlock(g_rd);
-		return RMI_ERROR_INPUT;
+	if (!rd->data_export_enabled) {
+		ret->x[0] = RMI_ERROR_REALM;
+		goto out_unlock_rd;
 	}
 
-	g_table_root = rd->s2_ctx.g_rtt;
-	sl = realm_rtt_starting_level(rd);
-	ipa_bits = realm_ipa_bits(rd);
+	/*
+	 * The content written with the key of a Realm with its own memory
+	 * encryption context could not be read back in place on import.
+	 */
+	if (!validate_map_addr(map_addr, RTT_PAGE_LEVEL, rd) ||
+	    (rd->s2_ctx.mecid != MECID_RMM)) {
+		ret->x[0] = RMI_ERROR_INPUT;
+		goto out_unlock_rd;
+	}
+
+	/*
+	 * No more granule can be exported once all the sequence numbers have
+	 * been used, or if no key can be generated.
+	 */
+	if ((rd->export_seq > S2TTE_EXPORT_SEQ_MAX) ||
+	    (!rd->export_key_valid &&
+	     (attest_export_key_generate(rd->export_key) != 0))) {
+		ret->x[0] = RMI_ERROR_REALM;
+		goto out_unlock_rd;
+	}
+
+	/* A sequence number is not used again, even if the export fails */
+	rd->export_key_valid = true;
+	seq = rd->export_seq++;
 	s2_ctx = rd->s2_ctx;
+
+	/*
+	 * The RD stays mapped to read the key, which no longer changes, and
+	 * to record the unmapping. It cannot be destroyed while its RTTs hold
+	 * the mapping.
+	 */
+	granule_lock(s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	granule_unlock(g_rd);
+
+	data_export_locked(rd, &s2_ctx, map_addr, seq, g_ns, ret);
+
 	buffer_unmap(rd);
+	return;
 
-	granule_lock(g_table_root, GRANULE_STATE_RTT);
+out_unlock_rd:
+	buffer_unmap(rd);
 	granule_unlock(g_rd);
+}
 
-	rtt_walk_lock_unlock(g_table_root, sl, ipa_bits,
-				map_addr, RTT_PAGE_LEVEL, &wi);
-	if (wi.last_level != RTT_PAGE_LEVEL) {
-		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
-		goto out_unlock_ll_table;
-	}
+/* The tag is passed in two registers */
+COMPILER_ASSERT((2U * sizeof(unsigned long)) == EXPORT_TAG_SIZE);
 
-	s2tt = granule_map(wi.g_llt, SLOT_RTT);
-	s2tte = s2tte_read(&s2tt[wi.index]);
+/*
+ * Implements RMI_DATA_IMPORT.
+ *
+ * Put back the content of a page exported with RMI_DATA_EXPORT, decrypted
+ * in place in the granule at @data_addr. See SMC_RMM_DATA_IMPORT.
+ */
+unsigned long smc_data_import(unsigned long data_addr,
+			      unsigned long rd_addr,
+			      unsigned long map_addr,
+			      unsigned long tag_lo,
+			      unsigned long tag_hi)
+{
+	enum granule_state new_data_state = GRANULE_STATE_DELEGATED;
+	unsigned long tag[2] = { tag_lo, tag_hi };
+	struct granule *g_rd, *g_data;
+	unsigned long s2tte, *s2tt;
+	struct rtt_walk wi;
+	struct rd *rd;
+	bool fold = false;
+	unsigned long ret;
 
-	valid = s2tte_is_valid(s2tte, RTT_PAGE_LEVEL);
+	g_data = find_granule(data_addr);
+	g_rd = find_granule(rd_addr);
+	if ((g_data == NULL) || (g_rd == NULL)) {
+		return RMI_ERROR_INPUT;
+	}
 
-	/*
-	 * Check if either HIPAS=ASSIGNED or map_addr is a
-	 * valid Protected IPA.
-	 */
-	if (!valid && !s2tte_is_assigned(s2tte, RTT_PAGE_LEVEL)) {
-		ret = pack_return_code(RMI_ERROR_RTT, RTT_PAGE_LEVEL);
-		goto out_unmap_ll_table;
+	/* The granules are locked in order of their address */
+	if (lock_data_range_and_rd(g_data, 1UL, g_rd) != 1UL) {
+		return RMI_ERROR_INPUT;
 	}
 
-	data_addr = s2tte_pa(s2tte, RTT_PAGE_LEVEL);
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!rd->data_export_enabled) {
+		ret = RMI_ERROR_REALM;
+		goto out_unlock_rd;
+	}
 
 	/*
-	 * We have already established either HIPAS=ASSIGNED or a valid mapping.
-	 * If valid, transition HIPAS to DESTROYED and if HIPAS=ASSIGNED,
-	 * transition to UNASSIGNED.
+	 * The content must have been loaded by the Host before the granule
+	 * was delegated, so that it cannot change once authenticated.
 	 */
-	s2tte = valid ? s2tte_create_destroyed() :
-			s2tte_create_unassigned(RMI_EMPTY);
-
-	s2tte_write(&s2tt[wi.index], s2tte);
+	if (!granule_is_preloaded(g_data) ||
+	    !validate_map_addr(map_addr, RTT_PAGE_LEVEL, rd) ||
+	    (rd->s2_ctx.mecid != MECID_RMM) || !rd->export_key_valid) {
+		ret = RMI_ERROR_INPUT;
+		goto out_unlock_rd;
+	}
 
-	if (valid) {
-		invalidate_page(&s2_ctx, map_addr);
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	rtt_walk_lock_unlock_ctx(&rd->s2_ctx, map_addr, RTT_PAGE_LEVEL, &wi);
+	if (wi.last_level != RTT_PAGE_LEVEL) {
+		ret = pack_return_code(RMI_ERROR_RTT,
+				       (unsigned int)wi.last_level);
+		goto out_unlock_ll_table;
 	}
 
-	__granule_put(wi.g_llt);
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	s2tte = s2tte_read(&s2tt[wi.index]);
+	if (!s2tte_is_exported(s2tte)) {
+		ret = pack_return_code(RMI_ERROR_RTT, RTT_PAGE_LEVEL);
+		goto out_unmap_ll_table;
+	}
 
 	/*
-	 * Lock the data granule and check expected state. Correct locking order
-	 * is guaranteed because granule address is obtained from a locked
-	 * granule by table walk. This lock needs to be acquired before a state
-	 * transition to or from GRANULE_STATE_DATA for granule address can happen.
+	 * The sequence number kept in the s2tte makes the content of an
+	 * older export of the IPA fail the check.
 	 */
-	g_data = find_lock_granule(data_addr, GRANULE_STATE_DATA);
-	assert(g_data);
-	granule_memzero(g_data, SLOT_DELEGATED);
-	granule_unlock_transition(g_data, GRANULE_STATE_DELEGATED);
+	if (!data_import_open(rd, g_data, map_addr,
+			      s2tte_exported_seq(s2tte),
+			      (unsigned char *)tag)) {
+		/* The decrypted content may be left in the granule */
+		granule_memzero(g_data, SLOT_DELEGATED);
+		ret = RMI_ERROR_INPUT;
+		goto out_unmap_ll_table;
+	}
 
+	granule_clear_needs_scrub(g_data);
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, 1L);
+
+	s2tte_write(&s2tt[wi.index],
+		    s2tte_create_valid(data_addr, RTT_PAGE_LEVEL));
+	__granule_get(wi.g_llt);
+	fold = (wi.g_llt->refcount == S2TTES_PER_S2TT);
+	new_data_state = GRANULE_STATE_DATA;
 	ret = RMI_SUCCESS;
 
 out_unmap_ll_table:
 	buffer_unmap(s2tt);
 out_unlock_ll_table:
 	granule_unlock(wi.g_llt);
-
+	if (fold) {
+		rtt_auto_fold(rd, granule_addr(wi.g_llt), map_addr);
+	}
+out_unlock_rd:
+	buffer_unmap(rd);
+	granule_unlock(g_rd);
+	granule_unlock_transition(g_data, new_data_state);
 	return ret;
 }
 
 static bool update_ripas(unsigned long *s2tte, unsigned long level,
 			 enum ripas ripas)
 {
-	if (s2tte_is_table(*s2tte, level)) {
-		return false;
-	}
+	unsigned long cls = s2tte_classify(*s2tte, (long)level);
 
-	if (s2tte_is_valid(*s2tte, level)) {
+	switch (s2tte_class_type(cls)) {
+	case S2TTE_TYPE_VALID:
 		if (ripas == RMI_EMPTY) {
-			unsigned long pa = s2tte_pa(*s2tte, level);
-			*s2tte = s2tte_create_assigned_empty(pa, level);
+			*s2tte = s2tte_create_assigned_empty(
+					s2tte_class_pa(cls), level);
 		}
 		return true;
-	}
-
-	if (s2tte_is_unassigned(*s2tte) || s2tte_is_assigned(*s2tte, level)) {
+	case S2TTE_TYPE_UNASSIGNED:
+	case S2TTE_TYPE_ASSIGNED:
 		*s2tte |= s2tte_create_ripas(ripas);
 		return true;
+	default:
+		return false;
 	}
-
-	return false;
-}
-
-static void ripas_granule_measure(struct rd *rd,
-				  unsigned long ipa,
-				  unsigned long level)
-{
-	struct measurement_desc_ripas measure_desc = {0};
-
-	/* Initialize the measurement descriptior structure */
-	measure_desc.desc_type = MEASURE_DESC_TYPE_RIPAS;
-	measure_desc.len = sizeof(struct measurement_desc_ripas);
-	measure_desc.ipa = ipa;
-	measure_desc.level = level;
-	memcpy(measure_desc.rim,
-	       &rd->measurement[RIM_MEASUREMENT_SLOT],
-	       measurement_get_size(rd->algorithm));
-
-	/*
-	 * Hashing the measurement descriptor structure; the result is the
-	 * updated RIM.
-	 */
-	measurement_hash_compute(rd->algorithm,
-				 &measure_desc,
-				 sizeof(measure_desc),
-				 rd->measurement[RIM_MEASUREMENT_SLOT]);
 }
 
-unsigned long smc_rtt_init_ripas(unsigned long rd_addr,
-				 unsigned long map_addr,
-				 unsigned long ulevel)
+/*
+ * Set the RIPAS of the unassigned entries of the RTT at @level which
+ * translates @base to RAM, starting at @base and stopping at the first entry
+ * at or above @top, at the end of the RTT, or at the first entry which is
+ * not unassigned.
+ *
+ * The RIM is extended for every entry initialised, in increasing IPA order,
+ * so the result is the same as initialising the entries one at a time.
+ *
+ * On RMI_SUCCESS, *next holds the IPA following the last entry initialised.
+ */
+static unsigned long rtt_init_ripas(unsigned long rd_addr,
+				    unsigned long base,
+				    unsigned long top,
+				    long level,
+				    unsigned long *next)
 {
 	struct granule *g_rd, *g_rtt_root;
 	struct rd *rd;
 	unsigned long ipa_bits;
 	struct rtt_walk wi;
 	unsigned long s2tte, *s2tt;
+	unsigned long addr, map_size, index;
 	unsigned long ret;
-	long level = (long)ulevel;
+	enum ripas ripas;
+	bool fold = false;
 	int sl;
 
 	g_rd = find_lock_granule(rd_addr, GRANULE_STATE_RD);
@@ -1127,13 +4103,14 @@ unsigned long smc_rtt_init_ripas(unsigned long rd_addr,
 		return RMI_ERROR_REALM;
 	}
 
-	if (!validate_rtt_entry_cmds(map_addr, level, rd)) {
+	if (!validate_rtt_entry_cmds(base, level, rd)) {
 		buffer_unmap(rd);
 		granule_unlock(g_rd);
 		return RMI_ERROR_INPUT;
 	}
 
-	if (!addr_in_par(rd, map_addr)) {
+	if (!addr_in_par(rd, base) || (top <= base) ||
+	    (top > realm_par_size(rd))) {
 		buffer_unmap(rd);
 		granule_unlock(g_rd);
 		return RMI_ERROR_INPUT;
@@ -1147,58 +4124,137 @@ unsigned long smc_rtt_init_ripas(unsigned long rd_addr,
 	granule_unlock(g_rd);
 
 	rtt_walk_lock_unlock(g_rtt_root, sl, ipa_bits,
-				map_addr, level, &wi);
+				base, level, &wi);
 	if (wi.last_level != level) {
-		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
+		ret = rtt_walk_error(&wi, base, level);
 		goto out_unlock_llt;
 	}
 
 	s2tt = granule_map(wi.g_llt, SLOT_RTT);
-	s2tte = s2tte_read(&s2tt[wi.index]);
+	map_size = s2tte_map_size((int)level);
+
+	for (addr = base, index = wi.index;
+	     (addr < top) && (index < S2TTES_PER_S2TT);
+	     addr += map_size, index++) {
+		s2tte = s2tte_read(&s2tt[index]);
+
+		/* Allowed only for HIPAS=UNASSIGNED */
+		if (s2tte_is_table(s2tte, level) ||
+		    !s2tte_is_unassigned(s2tte)) {
+			break;
+		}
+
+		s2tte |= s2tte_create_ripas(RMI_RAM);
+		s2tte_write(&s2tt[index], s2tte);
+	}
 
-	/* Allowed only for HIPAS=UNASSIGNED */
-	if (s2tte_is_table(s2tte, level) || !s2tte_is_unassigned(s2tte)) {
+	if (addr == base) {
 		ret = pack_return_code(RMI_ERROR_RTT, (unsigned int)level);
 		goto out_unmap_llt;
 	}
 
-	s2tte |= s2tte_create_ripas(RMI_RAM);
-
-	s2tte_write(&s2tt[wi.index], s2tte);
+	/*
+	 * Hashing the measurement descriptors of the entries initialised;
+	 * the result is the updated RIM.
+	 */
+	measurement_ripas_extend_range(rd->algorithm,
+				       rd->measurement[RIM_MEASUREMENT_SLOT],
+				       base, map_size,
+				       (addr - base) / map_size,
+				       (unsigned long)level);
 
-	ripas_granule_measure(rd, map_addr, level);
+	/*
+	 * Hosts initialise the RIPAS in increasing IPA order, so only try to
+	 * fold the RTT once its last entry has been initialised.
+	 */
+	fold = rd->auto_fold && (level == RTT_PAGE_LEVEL) &&
+	       (index == S2TTES_PER_S2TT) &&
+	       table_is_unassigned_block(s2tt, &ripas) && (ripas == RMI_RAM);
 
+	*next = addr;
 	ret = RMI_SUCCESS;
 
 out_unmap_llt:
 	buffer_unmap(s2tt);
 out_unlock_llt:
-	buffer_unmap(rd);
 	granule_unlock(wi.g_llt);
+
+	/*
+	 * The RD has been unlocked above, relock it to update its reclaim
+	 * list. If the realm has been destroyed in the meantime, the fold
+	 * is skipped. The granule may also hold the RD of another realm by
+	 * then, which is only folded into if it uses the same RTT root:
+	 * rtt_fold() then walks the RTTs of that realm again, so only an RTT
+	 * of that realm which can be folded is folded.
+	 */
+	if (fold && granule_lock_on_state_match(g_rd, GRANULE_STATE_RD)) {
+		if (rd->s2_ctx.g_rtt == g_rtt_root) {
+			rtt_auto_fold(rd, granule_addr(wi.g_llt), base);
+		}
+		granule_unlock(g_rd);
+	}
+
+	buffer_unmap(rd);
 	return ret;
 }
 
-unsigned long smc_rtt_set_ripas(unsigned long rd_addr,
-				unsigned long rec_addr,
-				unsigned long map_addr,
-				unsigned long ulevel,
-				unsigned long uripas)
+unsigned long smc_rtt_init_ripas(unsigned long rd_addr,
+				 unsigned long map_addr,
+				 unsigned long ulevel)
+{
+	unsigned long next;
+
+	/* Only the entry at @map_addr starts below @map_addr + 1 */
+	return rtt_init_ripas(rd_addr, map_addr, map_addr + 1UL,
+			      (long)ulevel, &next);
+}
+
+void smc_rtt_init_ripas_range(unsigned long rd_addr,
+			      unsigned long base,
+			      unsigned long top,
+			      unsigned long ulevel,
+			      struct smc_result *ret)
+{
+	unsigned long next = base;
+
+	ret->x[0] = rtt_init_ripas(rd_addr, base, top, (long)ulevel, &next);
+	ret->x[1] = next;
+}
+
+/*
+ * Implements RMI_RTT_SET_RIPAS.
+ *
+ * The RIPAS of the entries of the RTT at @ulevel which translates @map_addr
+ * is changed starting at @map_addr, until either the end of the RTT or the
+ * end of the region requested by the Realm is reached, or an entry whose
+ * RIPAS cannot be changed is found. The TLB is invalidated once for all
+ * the entries changed.
+ *
+ * On success, ret->x[1] holds the address up to which the RIPAS has been
+ * changed, which is the @map_addr to be used for the next call.
+ */
+void smc_rtt_set_ripas(unsigned long rd_addr,
+		       unsigned long rec_addr,
+		       unsigned long map_addr,
+		       unsigned long ulevel,
+		       unsigned long uripas,
+		       struct smc_result *res)
 {
 	struct granule *g_rd, *g_rec, *g_rtt_root;
 	struct rec *rec;
 	struct rd *rd;
-	unsigned long map_size, ipa_bits;
+	unsigned long map_size, addr, index;
 	struct rtt_walk wi;
 	unsigned long s2tte, *s2tt;
 	struct realm_s2_context s2_ctx;
 	long level = (long)ulevel;
 	enum ripas ripas = (enum ripas)uripas;
 	unsigned long ret;
-	bool valid;
-	int sl;
+	bool invalidate = false;
 
 	if (ripas > RMI_RAM) {
-		return RMI_ERROR_INPUT;
+		res->x[0] = RMI_ERROR_INPUT;
+		return;
 	}
 
 	if (!find_lock_two_granules(rd_addr,
@@ -1207,7 +4263,8 @@ unsigned long smc_rtt_set_ripas(unsigned long rd_addr,
 				   rec_addr,
 				   GRANULE_STATE_REC,
 				   &g_rec)) {
-		return RMI_ERROR_INPUT;
+		res->x[0] = RMI_ERROR_INPUT;
+		return;
 	}
 
 	if (granule_refcount_read_acquire(g_rec) != 0UL) {
@@ -1248,41 +4305,309 @@ unsigned long smc_rtt_set_ripas(unsigned long rd_addr,
 	}
 
 	g_rtt_root = rd->s2_ctx.g_rtt;
-	sl = realm_rtt_starting_level(rd);
-	ipa_bits = realm_ipa_bits(rd);
 	s2_ctx = rd->s2_ctx;
 
 	granule_lock(g_rtt_root, GRANULE_STATE_RTT);
 
-	rtt_walk_lock_unlock(g_rtt_root, sl, ipa_bits,
-				map_addr, level, &wi);
+	rtt_walk_lock_unlock_ctx(&s2_ctx, map_addr, level, &wi);
 	if (wi.last_level != level) {
-		ret = pack_return_code(RMI_ERROR_RTT, wi.last_level);
+		ret = rtt_walk_error(&wi, map_addr, level);
 		goto out_unlock_llt;
 	}
 
 	s2tt = granule_map(wi.g_llt, SLOT_RTT);
-	s2tte = s2tte_read(&s2tt[wi.index]);
 
-	valid = s2tte_is_valid(s2tte, level);
+	for (addr = map_addr, index = wi.index;
+	     (index < S2TTES_PER_S2TT) &&
+	     ((addr + map_size) <= rec->set_ripas.end);
+	     addr += map_size, index++) {
+		s2tte = s2tte_read(&s2tt[index]);
+
+		if (s2tte_is_valid(s2tte, level) && (ripas == RMI_EMPTY)) {
+			invalidate = true;
+		}
+
+		if (!update_ripas(&s2tte, level, ripas)) {
+			break;
+		}
 
-	if (!update_ripas(&s2tte, level, ripas)) {
+		s2tte_write(&s2tt[index], s2tte);
+	}
+
+	if (addr == map_addr) {
 		ret = pack_return_code(RMI_ERROR_RTT, (unsigned int)level);
 		goto out_unmap_llt;
 	}
 
-	s2tte_write(&s2tt[wi.index], s2tte);
+	if (ripas == RMI_EMPTY) {
+		realm_ripas_summary_clear(rd, map_addr, addr);
+	}
 
-	if (valid && (ripas == RMI_EMPTY)) {
-		if (level == RTT_PAGE_LEVEL) {
-			invalidate_page(&s2_ctx, map_addr);
-		} else {
-			invalidate_block(&s2_ctx, map_addr);
+	if (invalidate) {
+		invalidate_range(&s2_ctx, map_addr, addr - map_addr, level);
+		realm_s2_unmap_gen_inc(rd);
+	}
+
+	rec->set_ripas.addr = addr;
+	res->x[1] = addr;
+
+	ret = RMI_SUCCESS;
+
+out_unmap_llt:
+	buffer_unmap(s2tt);
+out_unlock_llt:
+	granule_unlock(wi.g_llt);
+out_unmap_rd:
+	buffer_unmap(rd);
+out_unmap_rec:
+	buffer_unmap(rec);
+out_unlock_rec_rd:
+	granule_unlock(g_rec);
+	granule_unlock(g_rd);
+	res->x[0] = ret;
+}
+
+/*
+ * Map the unprotected aliases of the entries of the RTT at @level from
+ * @base up to @top to consecutive NS addresses, starting at the output
+ * address of @host_s2tte. The RTTs missing to reach @level are created from
+ * the RTT pool of the realm. An entry which already maps the expected NS
+ * address is left as it is, so that a call which stopped short on the
+ * protected side can be repeated. The RD granule must be locked and mapped
+ * at @rd.
+ *
+ * On RMI_SUCCESS, *next holds the (protected) IPA following the last entry
+ * mapped.
+ */
+static unsigned long share_map_ns(struct rd *rd,
+				  unsigned long base,
+				  unsigned long top,
+				  long level,
+				  unsigned long host_s2tte,
+				  unsigned long *next)
+{
+	unsigned long ns_base = base + realm_par_size(rd);
+	unsigned long map_size = s2tte_map_size((int)level);
+	unsigned long addr, index, *s2tt;
+	struct rtt_walk wi;
+
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	rtt_walk_lock_unlock_pool(rd, ns_base, level, &wi);
+	if (wi.last_level != level) {
+		unsigned long ret = rtt_walk_error(&wi, ns_base, level);
+
+		granule_unlock(wi.g_llt);
+		return ret;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+
+	for (addr = base, index = wi.index;
+	     (addr < top) && (index < S2TTES_PER_S2TT);
+	     addr += map_size, index++) {
+		unsigned long s2tte = s2tte_read(&s2tt[index]);
+
+		if (!host_ns_s2tte_is_valid(host_s2tte, level)) {
+			break;
+		}
+
+		if (s2tte_is_unassigned(s2tte)) {
+			s2tte_write(&s2tt[index],
+				    s2tte_create_valid_ns(host_s2tte, level));
+			__granule_get(wi.g_llt);
+		} else if (s2tte != s2tte_create_valid_ns(host_s2tte, level)) {
+			break;
+		}
+		host_s2tte += map_size;
+	}
+
+	buffer_unmap(s2tt);
+	granule_unlock(wi.g_llt);
+
+	if (addr == base) {
+		return pack_return_code(RMI_ERROR_RTT, (unsigned int)level);
+	}
+
+	*next = addr;
+	return RMI_SUCCESS;
+}
+
+/*
+ * Implements RMI_RTT_SHARE_RANGE.
+ *
+ * Complete the change to RIPAS EMPTY requested by @rec_addr for the entries
+ * of the RTT at @ulevel which translates @map_addr, in a single call per RTT
+ * instead of an RMI_RTT_SET_RIPAS, an RMI_DATA_DESTROY and an
+ * RMI_RTT_MAP_UNPROTECTED per entry:
+ *
+ * - the unprotected aliases of the entries are mapped to the NS memory
+ *   described by @host_s2tte, see share_map_ns(),
+ * - the protected entries become Unassigned with RIPAS EMPTY, with a single
+ *   range TLB invalidation for those which were valid,
+ * - the DATA granules they mapped are scrubbed and their addresses, which
+ *   are DELEGATED, are written to the NS granule at @list_addr.
+ *
+ * The call stops at the end of the RTT or of the requested region, at the
+ * first entry which cannot be shared, or when the list is full. As with
+ * RMI_RTT_SET_RIPAS, ret->x[1] holds the address up to which the range has
+ * been shared, which is the @map_addr to be used for the next call.
+ */
+void smc_rtt_share_range(unsigned long rd_addr,
+			 unsigned long rec_addr,
+			 unsigned long map_addr,
+			 unsigned long ulevel,
+			 unsigned long host_s2tte,
+			 unsigned long list_addr,
+			 struct smc_result *res)
+{
+	struct realm_teardown td = { 0 };
+	struct granule *g_rd, *g_rec;
+	struct rec *rec;
+	struct rd *rd;
+	struct rtt_walk wi;
+	struct realm_s2_context s2_ctx;
+	unsigned long *s2tt, s2tte;
+	unsigned long map_size, nr_granules, top, ns_top, addr, index;
+	unsigned long nr_data = 0UL;
+	long level = (long)ulevel;
+	unsigned long ret;
+	bool invalidate = false;
+
+	td.g_list = find_granule(list_addr);
+	if ((td.g_list == NULL) || (td.g_list->state != GRANULE_STATE_NS) ||
+	    !host_ns_s2tte_is_valid(host_s2tte, level)) {
+		res->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	if (!find_lock_two_granules(rd_addr,
+				   GRANULE_STATE_RD,
+				   &g_rd,
+				   rec_addr,
+				   GRANULE_STATE_REC,
+				   &g_rec)) {
+		res->x[0] = RMI_ERROR_INPUT;
+		return;
+	}
+
+	if (granule_refcount_read_acquire(g_rec) != 0UL) {
+		ret = RMI_ERROR_IN_USE;
+		goto out_unlock_rec_rd;
+	}
+
+	rec = granule_map(g_rec, SLOT_REC);
+
+	if (g_rd != rec->realm_info.g_rd) {
+		ret = RMI_ERROR_REC;
+		goto out_unmap_rec;
+	}
+
+	if ((rec->set_ripas.ripas != RMI_EMPTY) ||
+	    (map_addr != rec->set_ripas.addr)) {
+		ret = RMI_ERROR_INPUT;
+		goto out_unmap_rec;
+	}
+
+	rd = granule_map(g_rd, SLOT_RD);
+
+	if (!validate_rtt_entry_cmds(map_addr, level, rd)) {
+		ret = RMI_ERROR_INPUT;
+		goto out_unmap_rd;
+	}
+
+	map_size = s2tte_map_size(level);
+	if (map_addr + map_size > rec->set_ripas.end) {
+		ret = RMI_ERROR_INPUT;
+		goto out_unmap_rd;
+	}
+
+	/* Stop at the end of the RTT or of the requested region */
+	top = round_down(map_addr, map_size * S2TTES_PER_S2TT) +
+	      (map_size * S2TTES_PER_S2TT);
+	if (top > round_down(rec->set_ripas.end, map_size)) {
+		top = round_down(rec->set_ripas.end, map_size);
+	}
+
+	/*
+	 * The aliases are mapped first, so that the protected entries are
+	 * only released once the Realm can reach the shared memory.
+	 */
+	ret = share_map_ns(rd, map_addr, top, level, host_s2tte, &ns_top);
+	if (ret != RMI_SUCCESS) {
+		goto out_unmap_rd;
+	}
+
+	s2_ctx = rd->s2_ctx;
+	td.mecid = s2_ctx.mecid;
+
+	granule_lock(s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	rtt_walk_lock_unlock_ctx(&s2_ctx, map_addr, level, &wi);
+	if (wi.last_level != level) {
+		ret = rtt_walk_error(&wi, map_addr, level);
+		goto out_unlock_llt;
+	}
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	nr_granules = map_size / GRANULE_SIZE;
+
+	/*
+	 * Make the entries Unassigned with RIPAS EMPTY. The data entries keep
+	 * their output address until the TLBs have been invalidated.
+	 */
+	for (addr = map_addr, index = wi.index; addr < ns_top;
+	     addr += map_size, index++) {
+		unsigned long cls = s2tte_classify(s2tte_read(&s2tt[index]),
+						   level);
+		enum s2tte_type type = s2tte_class_type(cls);
+
+		if (type == S2TTE_TYPE_UNASSIGNED) {
+			s2tte_write(&s2tt[index],
+				    s2tte_create_unassigned(RMI_EMPTY));
+			continue;
+		}
+
+		if (((type != S2TTE_TYPE_VALID) &&
+		     (type != S2TTE_TYPE_ASSIGNED)) ||
+		    !teardown_fits(&td, nr_data + nr_granules)) {
+			break;
+		}
+
+		if (type == S2TTE_TYPE_VALID) {
+			invalidate = true;
 		}
+		s2tte_write(&s2tt[index], s2tte_create_assigned_empty(
+				s2tte_class_pa(cls), level));
+		nr_data += nr_granules;
+	}
+
+	if (addr == map_addr) {
+		ret = pack_return_code(RMI_ERROR_RTT, (unsigned int)level);
+		goto out_unmap_llt;
+	}
+
+	realm_ripas_summary_clear(rd, map_addr, addr);
+
+	if (invalidate) {
+		invalidate_range(&s2_ctx, map_addr, addr - map_addr, level);
+		realm_s2_unmap_gen_inc(rd);
 	}
 
-	rec->set_ripas.addr += map_size;
+	/* Release the data granules, now that no TLB entry maps them */
+	for (unsigned long a = map_addr, i = wi.index; a < addr;
+	     a += map_size, i++) {
+		s2tte = s2tte_read(&s2tt[i]);
+		if (!s2tte_is_assigned(s2tte, level)) {
+			continue;
+		}
+
+		s2tte_write(&s2tt[i], s2tte_create_unassigned(RMI_EMPTY));
+		__granule_put(wi.g_llt);
+		data_release(&td, s2tte_pa(s2tte, level), nr_granules);
+	}
+	realm_footprint_add(rd, RMI_GRANULE_STATE_DATA, -(long)nr_data);
 
+	rec->set_ripas.addr = addr;
+	res->x[1] = addr;
 	ret = RMI_SUCCESS;
 
 out_unmap_llt:
@@ -1296,5 +4621,8 @@ out_unmap_rec:
 out_unlock_rec_rd:
 	granule_unlock(g_rec);
 	granule_unlock(g_rd);
-	return ret;
+
+	teardown_flush(&td);
+	res->x[0] = ret;
+	res->x[2] = td.count;
 }
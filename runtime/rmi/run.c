@@ -4,6 +4,7 @@
  */
 
 #include <arch.h>
+#include <buffer.h>
 #include <debug.h>
 #include <esr.h>
 #include <gic.h>
@@ -18,7 +19,10 @@
 #include <smc-rmi.h>
 #include <smc-rsi.h>
 #include <smc.h>
+#include <string.h>
 #include <timers.h>
+#include <trace.h>
+#include <vmid.h>
 
 static void reset_last_run_info(struct rec *rec)
 {
@@ -47,21 +51,7 @@ static bool complete_mmio_emulation(struct rec *rec, struct rmi_rec_entry *rec_e
 	 * Emulate mmio read (unless the load is to xzr)
 	 */
 	if (!esr_is_write(esr) && (rt != 31U)) {
-		unsigned long val;
-
-		val = rec_entry->gprs[0] & access_mask(esr);
-
-		if (esr_sign_extend(esr)) {
-			unsigned int bit_count = access_len(esr) * 8U;
-			unsigned long mask = 1UL << (bit_count - 1U);
-
-			val = (val ^ mask) - mask;
-			if (!esr_sixty_four(esr)) {
-				val &= (1UL << 32U) - 1UL;
-			}
-		}
-
-		rec->regs[rt] = val;
+		rec->regs[rt] = esr_load_value(esr, rec_entry->gprs[0]);
 	}
 
 	rec->pc = rec->pc + 4UL;
@@ -156,23 +146,229 @@ static bool complete_host_call(struct rec *rec, struct rmi_rec_run *rec_run)
 	return true;
 }
 
+#ifdef RMM_REC_RUN_SPARSE_COPY
+/* Fields of struct rmi_rec_entry consumed by RMM */
+static const struct ns_buffer_range rec_entry_ranges[] __hot_rodata = {
+	{ offsetof(struct rmi_rec_entry, flags), sizeof(unsigned long) },
+	{ offsetof(struct rmi_rec_entry, gprs),
+	  REC_EXIT_NR_GPRS * sizeof(unsigned long) },
+	/* gicv3_hcr, gicv3_lrs and gicv3_queued_nr */
+	{ offsetof(struct rmi_rec_entry, gicv3_hcr),
+	  (2U + REC_GIC_NUM_LRS) * sizeof(unsigned long) }
+};
+
+/* Groups of fields of struct rmi_rec_exit, each written back as a whole */
+enum rec_exit_fields {
+	REC_EXIT_FIELDS_REASON,
+	REC_EXIT_FIELDS_FAULT,
+	REC_EXIT_FIELDS_GPRS,
+	REC_EXIT_FIELDS_GIC,
+	REC_EXIT_FIELDS_TIMER,
+	REC_EXIT_FIELDS_RIPAS,
+	REC_EXIT_FIELDS_IMM,
+	REC_EXIT_FIELDS_PMU,
+	NR_REC_EXIT_FIELDS
+};
+
+#define REC_EXIT_FIELD(_f)	(U(1) << (REC_EXIT_FIELDS_##_f))
+
+static const struct ns_buffer_range __hot_rodata
+				rec_exit_ranges[NR_REC_EXIT_FIELDS] = {
+	[REC_EXIT_FIELDS_REASON] = {
+		offsetof(struct rmi_rec_exit, exit_reason),
+		sizeof(unsigned long) },
+	/* esr, far and hpfar */
+	[REC_EXIT_FIELDS_FAULT] = {
+		offsetof(struct rmi_rec_exit, esr),
+		3U * sizeof(unsigned long) },
+	[REC_EXIT_FIELDS_GPRS] = {
+		offsetof(struct rmi_rec_exit, gprs),
+		REC_EXIT_NR_GPRS * sizeof(unsigned long) },
+	/* gicv3_hcr, gicv3_lrs, gicv3_misr, gicv3_vmcr and gicv3_queued_done */
+	[REC_EXIT_FIELDS_GIC] = {
+		offsetof(struct rmi_rec_exit, gicv3_hcr),
+		(4U + REC_GIC_NUM_LRS) * sizeof(unsigned long) },
+	/* cntp_ctl, cntp_cval, cntv_ctl and cntv_cval */
+	[REC_EXIT_FIELDS_TIMER] = {
+		offsetof(struct rmi_rec_exit, cntp_ctl),
+		4U * sizeof(unsigned long) },
+	/* ripas_base to ripas_split */
+	[REC_EXIT_FIELDS_RIPAS] = {
+		offsetof(struct rmi_rec_exit, ripas_base),
+		offsetof(struct rmi_rec_exit, ripas_split) +
+		sizeof(unsigned long) -
+		offsetof(struct rmi_rec_exit, ripas_base) },
+	[REC_EXIT_FIELDS_IMM] = {
+		offsetof(struct rmi_rec_exit, imm),
+		sizeof(unsigned long) },
+	/* pmu_ovf_status and spe_irq_status */
+	[REC_EXIT_FIELDS_PMU] = {
+		offsetof(struct rmi_rec_exit, pmu_ovf_status),
+		2U * sizeof(unsigned long) }
+};
+
+/*
+ * Fields produced for each exit reason, in addition to the exit reason, the
+ * GIC state, the timer state and the PMU and SPE interrupt status which are
+ * returned on every exit.
+ */
+static const unsigned int rec_exit_fields[] __hot_rodata = {
+	[RMI_EXIT_SYNC] = REC_EXIT_FIELD(FAULT) | REC_EXIT_FIELD(GPRS),
+	[RMI_EXIT_IRQ] = 0U,
+	[RMI_EXIT_FIQ] = 0U,
+	[RMI_EXIT_PSCI] = REC_EXIT_FIELD(GPRS),
+	[RMI_EXIT_RIPAS_CHANGE] = REC_EXIT_FIELD(RIPAS),
+	[RMI_EXIT_HOST_CALL] = REC_EXIT_FIELD(GPRS) | REC_EXIT_FIELD(IMM),
+	[RMI_EXIT_SERROR] = REC_EXIT_FIELD(FAULT),
+	[RMI_EXIT_ATTEST_SIGN] = 0U
+};
+
+/*
+ * Zero the fields of @rec_exit which can be written back to the Host. The
+ * struct rmi_rec_exit is mostly padding, so this is much cheaper than
+ * zeroing the whole structure on every REC entry.
+ */
+static void clear_rec_exit(struct rmi_rec_exit *rec_exit)
+{
+	for (unsigned int i = 0U; i < (unsigned int)NR_REC_EXIT_FIELDS; i++) {
+		(void)memset((unsigned char *)rec_exit + rec_exit_ranges[i].offset,
+			     0, rec_exit_ranges[i].size);
+	}
+}
+
+static bool read_rec_entry(struct granule *g_run,
+			   struct rmi_rec_entry *rec_entry)
+{
+	return ns_buffer_read_ranges(SLOT_NS, g_run,
+				     offsetof(struct rmi_rec_run, entry),
+				     rec_entry_ranges,
+				     (unsigned int)ARRAY_LEN(rec_entry_ranges),
+				     rec_entry);
+}
+
+/* Read the gicv3_queued_nr first LR values of gicv3_queued_lrs */
+static bool read_rec_entry_queued_lrs(struct granule *g_run,
+				      struct rmi_rec_entry *rec_entry)
+{
+	return ns_buffer_read(SLOT_NS, g_run,
+			      offsetof(struct rmi_rec_run, entry) +
+			      offsetof(struct rmi_rec_entry, gicv3_queued_lrs),
+			      (unsigned int)rec_entry->gicv3_queued_nr *
+			      (unsigned int)sizeof(unsigned long),
+			      rec_entry->gicv3_queued_lrs);
+}
+
+/*
+ * Write back only the fields of @rec_exit which are defined for its exit
+ * reason. The other fields of the exit structure in the NS granule keep
+ * the values they had before the REC entry.
+ */
+static bool write_rec_exit(struct granule *g_run,
+			   struct rmi_rec_exit *rec_exit)
+{
+	struct ns_buffer_range ranges[NR_REC_EXIT_FIELDS];
+	unsigned int fields = REC_EXIT_FIELD(REASON) | REC_EXIT_FIELD(GIC) |
+			      REC_EXIT_FIELD(TIMER) | REC_EXIT_FIELD(PMU);
+	unsigned int nr_ranges = 0U;
+
+	assert(rec_exit->exit_reason < ARRAY_LEN(rec_exit_fields));
+	fields |= rec_exit_fields[rec_exit->exit_reason];
+
+	for (unsigned int i = 0U; i < (unsigned int)NR_REC_EXIT_FIELDS; i++) {
+		if ((fields & (U(1) << i)) != 0U) {
+			ranges[nr_ranges++] = rec_exit_ranges[i];
+		}
+	}
+
+	return ns_buffer_write_ranges(SLOT_NS, g_run,
+				      offsetof(struct rmi_rec_run, exit),
+				      ranges, nr_ranges, rec_exit);
+}
+#else
+static void clear_rec_exit(struct rmi_rec_exit *rec_exit)
+{
+	(void)memset(rec_exit, 0, sizeof(struct rmi_rec_exit));
+}
+
+static bool read_rec_entry(struct granule *g_run,
+			   struct rmi_rec_entry *rec_entry)
+{
+	return ns_buffer_read(SLOT_NS, g_run,
+			      offsetof(struct rmi_rec_run, entry),
+			      sizeof(struct rmi_rec_entry), rec_entry);
+}
+
+static bool read_rec_entry_queued_lrs(struct granule *g_run,
+				      struct rmi_rec_entry *rec_entry)
+{
+	(void)g_run;
+	(void)rec_entry;
+	return true;
+}
+
+static bool write_rec_exit(struct granule *g_run,
+			   struct rmi_rec_exit *rec_exit)
+{
+	return ns_buffer_write(SLOT_NS, g_run,
+			       offsetof(struct rmi_rec_run, exit),
+			       sizeof(struct rmi_rec_exit), rec_exit);
+}
+#endif /* RMM_REC_RUN_SPARSE_COPY */
+
+/*
+ * Return true, with an IRQ exit in @rec_exit, if a physical IRQ is already
+ * pending, in which case the Realm would exit as soon as it is entered. The
+ * state of the REC is then reported to the Host from its saved copy, without
+ * switching to the Realm context.
+ *
+ * The overflow status of the PMU is only known once its state, kept in the
+ * auxiliary granules, is loaded, so the check is not done for a Realm with
+ * the PMU enabled.
+ */
+static bool rec_enter_irq_pending(struct rec *rec,
+				  struct rmi_rec_exit *rec_exit)
+{
+	if (rec->realm_info.pmu_enabled || (read_isr_el1() == 0UL)) {
+		return false;
+	}
+
+	rec_exit->exit_reason = RMI_EXIT_IRQ;
+	report_saved_timer_state_to_ns(rec, rec_exit);
+
+	rec_exit->pmu_ovf_status = RMI_PMU_OVERFLOW_NOT_ACTIVE;
+	rec_exit->spe_irq_status = RMI_SPE_IRQ_NOT_ACTIVE;
+	if (rec->realm_info.spe_enabled &&
+	    ((rec->spe.pmbsr_el1 & PMBSR_EL1_S_BIT) != 0UL)) {
+		rec_exit->spe_irq_status = RMI_SPE_IRQ_ACTIVE;
+	}
+
+#ifdef RMM_REC_STATS
+	rec->stats.early_irq_exits++;
+#endif
+	return true;
+}
+
+__hot_text
 unsigned long smc_rec_enter(unsigned long rec_addr,
 			    unsigned long rec_run_addr)
 {
 	struct granule *g_rec;
 	struct granule *g_run;
 	struct rec *rec;
-	struct rd *rd;
 	struct rmi_rec_run rec_run;
 	unsigned long realm_state, ret;
 	bool success;
 
 	/*
 	 * The content of `rec_run.exit` shall be returned to the host.
-	 * Zero the structure to avoid the leakage of
+	 * Zero the fields written back to avoid the leakage of
 	 * the content of the RMM's stack.
 	 */
-	(void)memset(&rec_run.exit, 0, sizeof(struct rmi_rec_exit));
+	clear_rec_exit(&rec_run.exit);
+
+#ifdef RMM_REC_EXIT_TRACE
+	rec_exit_trace_begin();
+#endif
 
 	g_run = find_granule(rec_run_addr);
 	if ((g_run == NULL) || (g_run->state != GRANULE_STATE_NS)) {
@@ -196,8 +392,7 @@ unsigned long smc_rec_enter(unsigned long rec_addr,
 	/* Unlock the granule before switching to realm world. */
 	granule_unlock(g_rec);
 
-	success = ns_buffer_read(SLOT_NS, g_run, 0U,
-				 sizeof(struct rmi_rec_entry), &rec_run.entry);
+	success = read_rec_entry(g_run, &rec_run.entry);
 
 	if (!success) {
 		/*
@@ -210,9 +405,20 @@ unsigned long smc_rec_enter(unsigned long rec_addr,
 
 	rec = granule_map(g_rec, SLOT_REC);
 
-	rd = granule_map(rec->realm_info.g_rd, SLOT_RD);
-	realm_state = get_rd_state_unlocked(rd);
-	buffer_unmap(rd);
+	/*
+	 * Map the RD once for the whole REC entry, in a slot of its own, so
+	 * that the RSI handlers share the mapping instead of each mapping the
+	 * RD again. The REC holds a reference to the RD, which cannot be
+	 * destroyed meanwhile.
+	 */
+	rec->rd = granule_map(rec->realm_info.g_rd, SLOT_REC_RD);
+
+	/* The active state of the Realm is mirrored by its VMID */
+	if (vmid_realm_is_active(rec->realm_info.vmid)) {
+		realm_state = REALM_STATE_ACTIVE;
+	} else {
+		realm_state = get_rd_state_unlocked(rec->rd);
+	}
 
 	switch (realm_state) {
 	case REALM_STATE_NEW:
@@ -251,6 +457,20 @@ unsigned long smc_rec_enter(unsigned long rec_addr,
 		goto out_unmap_buffers;
 	}
 
+	if ((rec_run.entry.flags & REC_ENTRY_FLAG_VIRQ_QUEUE) == 0UL) {
+		rec_run.entry.gicv3_queued_nr = 0UL;
+	} else if (rec_run.entry.gicv3_queued_nr > REC_GIC_NUM_QUEUED_LRS) {
+		ret = RMI_ERROR_REC;
+		goto out_unmap_buffers;
+	} else if (!read_rec_entry_queued_lrs(g_run, &rec_run.entry)) {
+		ret = RMI_ERROR_INPUT;
+		goto out_unmap_buffers;
+	} else if (!gic_validate_lrs(rec_run.entry.gicv3_queued_lrs,
+			(unsigned int)rec_run.entry.gicv3_queued_nr)) {
+		ret = RMI_ERROR_REC;
+		goto out_unmap_buffers;
+	}
+
 	if (!complete_mmio_emulation(rec, &rec_run.entry)) {
 		ret = RMI_ERROR_REC;
 		goto out_unmap_buffers;
@@ -272,33 +492,70 @@ unsigned long smc_rec_enter(unsigned long rec_addr,
 
 	reset_last_run_info(rec);
 
+	/*
+	 * The RECs of a Realm on dedicated CPUs idle in WFI or WFE without
+	 * exiting, and the Host gets the CPU back with its physical IRQs.
+	 */
 	rec->sysregs.hcr_el2 = rec->common_sysregs.hcr_el2;
-	if ((rec_run.entry.flags & REC_ENTRY_FLAG_TRAP_WFI) != 0UL) {
+	if (((rec_run.entry.flags & REC_ENTRY_FLAG_TRAP_WFI) != 0UL) &&
+	    !rec->realm_info.wfx_notrap) {
 		rec->sysregs.hcr_el2 |= HCR_TWI;
 	}
-	if ((rec_run.entry.flags & REC_ENTRY_FLAG_TRAP_WFE) != 0UL) {
+	if (((rec_run.entry.flags & REC_ENTRY_FLAG_TRAP_WFE) != 0UL) &&
+	    !rec->realm_info.wfx_notrap) {
 		rec->sysregs.hcr_el2 |= HCR_TWE;
 	}
 
+	rec->wfe_poll.enabled =
+		((rec_run.entry.flags & REC_ENTRY_FLAG_WFE_POLL) != 0UL);
+	rec->wfe_poll.count = 0U;
+
+	rec->attest_sign_defer =
+		((rec_run.entry.flags & REC_ENTRY_FLAG_ATTEST_SIGN_DEFER) != 0UL);
+
+	rec->psci_info.local =
+		((rec_run.entry.flags & REC_ENTRY_FLAG_PSCI_LOCAL) != 0UL);
+
+	rec->timer_local =
+		((rec_run.entry.flags & REC_ENTRY_FLAG_TIMER_LOCAL) != 0UL);
+
+	rec->sgi_local =
+		((rec_run.entry.flags & REC_ENTRY_FLAG_SGI_LOCAL) != 0UL);
+
+	rec->ns_el1_dead =
+		((rec_run.entry.flags & REC_ENTRY_FLAG_NS_EL1_DEAD) != 0UL);
+
+	rec->virq_queue.lrs = rec_run.entry.gicv3_queued_lrs;
+	rec->virq_queue.nr = (unsigned int)rec_run.entry.gicv3_queued_nr;
+	rec->virq_queue.next = 0U;
+
 	ret = RMI_SUCCESS;
 
-	rec_run_loop(rec, &rec_run.exit);
+	if (!rec_enter_irq_pending(rec, &rec_run.exit)) {
+		rec_run_loop(rec, &rec_run.exit);
+	}
 	/* Undo the heap association */
 
 	gic_copy_state_to_ns(&rec->sysregs.gicstate, &rec_run.exit);
+	rec_run.exit.gicv3_queued_done = rec->virq_queue.next;
+	rec->virq_queue.lrs = NULL;
 
 out_unmap_buffers:
+	buffer_unmap(rec->rd);
+	rec->rd = NULL;
 	buffer_unmap(rec);
 
 	if (ret == RMI_SUCCESS) {
-		if (!ns_buffer_write(SLOT_NS, g_run,
-				     offsetof(struct rmi_rec_run, exit),
-				     sizeof(struct rmi_rec_exit), &rec_run.exit)) {
+		if (!write_rec_exit(g_run, &rec_run.exit)) {
 			ret = RMI_ERROR_INPUT;
 		}
 	}
 
 	atomic_granule_put_release(g_rec);
 
+#ifdef RMM_REC_EXIT_TRACE
+	rec_exit_trace_end(rec_run.exit.exit_reason);
+#endif
+
 	return ret;
 }
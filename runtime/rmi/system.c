@@ -3,9 +3,11 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 #include <assert.h>
+#include <attestation.h>
 #include <debug.h>
 #include <smc-handler.h>
 #include <smc-rmi.h>
+#include <status.h>
 
 COMPILER_ASSERT(RMI_ABI_VERSION_MAJOR <= 0x7FFF);
 COMPILER_ASSERT(RMI_ABI_VERSION_MINOR <= 0xFFFF);
@@ -14,3 +16,20 @@ unsigned long smc_version(void)
 {
 	return RMI_ABI_VERSION;
 }
+
+/*
+ * Implements RMI_PLATFORM_TOKEN_REFRESH.
+ *
+ * Retrieve the platform token from EL3 again, for the Host to call after
+ * the platform token has been rotated. The CCA tokens written to the
+ * Realms afterwards contain the new platform token.
+ */
+unsigned long smc_platform_token_refresh(void)
+{
+	if (attest_refresh_platform_token() != 0) {
+		/* The previous platform token is still in use */
+		return RMI_ERROR_INPUT;
+	}
+
+	return RMI_SUCCESS;
+}
@@ -13,7 +13,7 @@ struct rsi_walk_smc_result  handle_rsi_realm_config(struct rec *rec)
 {
 	struct rsi_walk_smc_result res = { 0 };
 	unsigned long ipa = rec->regs[1];
-	struct rd *rd;
+	struct rd *rd = rec->rd;
 	enum s2_walk_status walk_status;
 	struct s2_walk_result walk_res;
 	struct granule *gr;
@@ -24,8 +24,6 @@ struct rsi_walk_smc_result  handle_rsi_realm_config(struct rec *rec)
 		return res;
 	}
 
-	rd = granule_map(rec->realm_info.g_rd, SLOT_RD);
-
 	walk_status = realm_ipa_to_pa(rd, ipa, &walk_res);
 
 	if (walk_status == WALK_FAIL) {
@@ -36,18 +34,19 @@ struct rsi_walk_smc_result  handle_rsi_realm_config(struct rec *rec)
 			res.walk_result.abort = true;
 			res.walk_result.rtt_level = walk_res.rtt_level;
 		}
-		goto out_unmap_rd;
+		return res;
 	}
 
 	if (walk_status == WALK_INVALID_PARAMS) {
 		/* Return error to Realm */
 		res.smc_res.x[0] = RSI_ERROR_INPUT;
-		goto out_unmap_rd;
+		return res;
 	}
 
 	/* Map Realm data granule to RMM address space */
 	gr = find_granule(walk_res.pa);
-	config = (struct rsi_realm_config *)granule_map(gr, SLOT_RSI_CALL);
+	config = (struct rsi_realm_config *)granule_map_mec(gr, SLOT_RSI_CALL,
+						rec->realm_info.mecid);
 
 	/* Populate config structure */
 	config->ipa_width = rec->realm_info.ipa_bits;
@@ -61,7 +60,5 @@ struct rsi_walk_smc_result  handle_rsi_realm_config(struct rec *rec)
 	/* Write output values */
 	res.smc_res.x[0] = RSI_SUCCESS;
 
-out_unmap_rd:
-	buffer_unmap(rd);
 	return res;
 }
@@ -11,6 +11,41 @@
 #include <status.h>
 #include <string.h>
 
+/*
+ * Return the DATA granule cached for @page_ipa by the previous host call of
+ * @rec, locked, or NULL if the cached translation is no longer valid.
+ *
+ * DATA_DESTROY and RTT_SET_RIPAS increment the s2_unmap_gen of the Realm
+ * after updating the S2TTE and before the granule can be released, so
+ * reading an unchanged value with the granule locked means that it is still
+ * mapped at @page_ipa.
+ */
+static struct granule *host_call_cached_granule(struct rec *rec,
+						struct rd *rd,
+						unsigned long page_ipa)
+{
+	struct granule *gr;
+
+	if (!rec->host_call_cache.valid ||
+	    (rec->host_call_cache.ipa != page_ipa)) {
+		return NULL;
+	}
+
+	gr = find_lock_granule(rec->host_call_cache.pa, GRANULE_STATE_DATA);
+	if (gr == NULL) {
+		rec->host_call_cache.valid = false;
+		return NULL;
+	}
+
+	if (realm_s2_unmap_gen(rd) != rec->host_call_cache.gen) {
+		granule_unlock(gr);
+		rec->host_call_cache.valid = false;
+		return NULL;
+	}
+
+	return gr;
+}
+
 /*
  * If the RIPAS of the target IPA is empty then return value is RSI_ERROR_INPUT.
  *
@@ -25,6 +60,10 @@
  *   - If @rec_exit is NULL and @rec_entry is not NULL, then copy host call
  *     results to host call data structure (in Realm memory).
  *   - Return value is RSI_SUCCESS.
+ *
+ * The translation found by the walk is cached in @rec, so that the
+ * completion of the host call and the next host calls to the same page do
+ * not walk the RTTs again.
  */
 static unsigned int do_host_call(struct rec *rec,
 				 struct rmi_rec_exit *rec_exit,
@@ -35,42 +74,56 @@ static unsigned int do_host_call(struct rec *rec,
 	struct s2_walk_result walk_result;
 	unsigned long ipa = rec->regs[1];
 	unsigned long page_ipa;
-	struct rd *rd;
+	struct rd *rd = rec->rd;
 	struct granule *gr;
 	unsigned char *data;
 	struct rsi_host_call *host_call;
 	unsigned int i;
 	unsigned int ret = RSI_SUCCESS;
+	uint64_t gen;
 
 	assert(addr_in_rec_par(rec, ipa));
 
 	/* Only 'rec_entry' or 'rec_exit' should be set */
 	assert((rec_entry != NULL) ^ (rec_exit != NULL));
 
-	rd = granule_map(rec->realm_info.g_rd, SLOT_RD);
-
 	page_ipa = ipa & GRANULE_MASK;
-	walk_status = realm_ipa_to_pa(rd, page_ipa, &walk_result);
-
-	switch (walk_status) {
-	case WALK_SUCCESS:
-		break;
-	case WALK_FAIL:
-		if (s2_walk_result_match_ripas(&walk_result, RMI_EMPTY)) {
-			ret = RSI_ERROR_INPUT;
-		} else {
-			rsi_walk_result->abort = true;
-			rsi_walk_result->rtt_level = walk_result.rtt_level;
+
+	gr = host_call_cached_granule(rec, rd, page_ipa);
+	if (gr != NULL) {
+		walk_result.llt = NULL;
+	} else {
+		/* Read the generation before the walk, see above */
+		gen = realm_s2_unmap_gen(rd);
+		walk_status = realm_ipa_to_pa(rd, page_ipa, &walk_result);
+
+		switch (walk_status) {
+		case WALK_SUCCESS:
+			break;
+		case WALK_FAIL:
+			if (s2_walk_result_match_ripas(&walk_result, RMI_EMPTY)) {
+				ret = RSI_ERROR_INPUT;
+			} else {
+				rsi_walk_result->abort = true;
+				rsi_walk_result->rtt_level = walk_result.rtt_level;
+			}
+			return ret;
+		case WALK_INVALID_PARAMS:
+			assert(false);
+			break;
 		}
-		goto out;
-	case WALK_INVALID_PARAMS:
-		assert(false);
-		break;
+
+		gr = find_granule(walk_result.pa);
+
+		rec->host_call_cache.ipa = page_ipa;
+		rec->host_call_cache.pa = walk_result.pa;
+		rec->host_call_cache.gen = gen;
+		rec->host_call_cache.valid = true;
 	}
 
 	/* Map Realm data granule to RMM address space */
-	gr = find_granule(walk_result.pa);
-	data = (unsigned char *)granule_map(gr, SLOT_RSI_CALL);
+	data = (unsigned char *)granule_map_mec(gr, SLOT_RSI_CALL,
+						  rec->realm_info.mecid);
 	host_call = (struct rsi_host_call *)(data + (ipa - page_ipa));
 
 	if (rec_exit != NULL) {
@@ -89,11 +142,13 @@ static unsigned int do_host_call(struct rec *rec,
 	/* Unmap Realm data granule */
 	buffer_unmap(data);
 
-	/* Unlock last level RTT */
-	granule_unlock(walk_result.llt);
+	if (walk_result.llt != NULL) {
+		/* Unlock last level RTT */
+		granule_unlock(walk_result.llt);
+	} else {
+		granule_unlock(gr);
+	}
 
-out:
-	buffer_unmap(rd);
 	return ret;
 }
 
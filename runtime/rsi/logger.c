@@ -10,8 +10,8 @@
 #include <smc-rsi.h>
 #include <utils_def.h>
 
-/* RMI handler uses 29 chars for function name */
-#define	MAX_NAME_LEN	29U
+/* RSI handler uses 32 chars for function name */
+#define	MAX_NAME_LEN	32U
 
 /* 5 64-bit parameters separated by space + 1 trailing space */
 #define PARAMS_STR_LEN	(5U * sizeof("0123456789ABCDEF") + 1U)
@@ -34,7 +34,9 @@ static const char *rsi_logger[] = {
 	RSI_FUNCTION(REALM_CONFIG),		/* 0xC4000196 */
 	RSI_FUNCTION(IPA_STATE_SET),		/* 0xC4000197 */
 	RSI_FUNCTION(IPA_STATE_GET),		/* 0xC4000198 */
-	RSI_FUNCTION(HOST_CALL)			/* 0xC4000199 */
+	RSI_FUNCTION(HOST_CALL),		/* 0xC4000199 */
+	RSI_FUNCTION(MEASUREMENT_EXTEND_MULTI),	/* 0xC400019A */
+	RSI_FUNCTION(REC_STATS)			/* 0xC400019B */
 };
 
 #define RSI_STATUS_HANDLER(id)[id] = #id
@@ -51,11 +53,11 @@ COMPILER_ASSERT(ARRAY_LEN(rsi_status_handler) == RSI_ERROR_COUNT);
 static int print_entry(unsigned int id, unsigned long args[5],
 		       char *buf, size_t len)
 {
-	char name[sizeof("SMC_RSI_ATTEST_TOKEN_CONTINUE")];
+	char name[sizeof("SMC_RSI_MEASUREMENT_EXTEND_MULTI")];
 	int cnt __unused;
 
 	switch (id) {
-	case SMC_RSI_ABI_VERSION ... SMC_RSI_HOST_CALL:
+	case SMC_RSI_ABI_VERSION ... SMC_RSI_REC_STATS:
 
 		if (rsi_logger[id - SMC_RSI_ABI_VERSION] != NULL) {
 			cnt = snprintf(name, sizeof(name), "%s%s", "SMC_RSI_",
@@ -82,7 +84,7 @@ static int print_entry(unsigned int id, unsigned long args[5],
 
 	assert((cnt > 0) && (cnt < sizeof(name)));
 
-	return snprintf(buf, len, "%-29s %8lx %8lx %8lx %8lx %8lx ",
+	return snprintf(buf, len, "%-32s %8lx %8lx %8lx %8lx %8lx ",
 			name, args[0], args[1], args[2], args[3], args[4]);
 }
 
@@ -119,7 +121,7 @@ void rsi_log_on_exit(unsigned int function_id, unsigned long args[5],
 	/* Print result when execution continues in REC */
 	if (exit_to_rec) {
 		if ((function_id >= SMC_RSI_MEASUREMENT_READ) &&
-		    (function_id <= SMC_RSI_HOST_CALL)) {
+		    (function_id <= SMC_RSI_REC_STATS)) {
 			/* Print status */
 			cnt = print_status(buf_ptr, buf_len, res);
 		} else {
@@ -4,19 +4,187 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <buffer.h>
+#include <granule.h>
 #include <realm.h>
 #include <ripas.h>
 #include <rsi-memory.h>
 #include <smc-rsi.h>
 #include <status.h>
+#include <table.h>
+
+/*
+ * Set the RIPAS of the Protected IPAs in [@addr, @end) to EMPTY, one RTT at a
+ * time with a single TLB invalidation for each of them, and return the
+ * address up to which the change has been applied.
+ *
+ * The change stops at the first entry which the Host must update, i.e. a
+ * DESTROYED entry or a block which is only partly covered by the range.
+ */
+static unsigned long ripas_empty_in_place(struct rd *rd, unsigned long addr,
+					  unsigned long end)
+{
+	struct granule *g_root = rd->s2_ctx.g_rtt;
+
+	while (addr < end) {
+		struct rtt_walk wi;
+		unsigned long *s2tt, map_size, index;
+		unsigned long base = addr;
+		bool invalidate = false;
+		bool stop = false;
+		long level;
+
+		granule_lock(g_root, GRANULE_STATE_RTT);
+		rtt_walk_lock_unlock_ctx(&rd->s2_ctx, addr, RTT_PAGE_LEVEL,
+					 &wi);
+		level = wi.last_level;
+		map_size = s2tte_map_size((int)level);
+
+		if (!addr_is_level_aligned(addr, level) ||
+		    ((addr + map_size) > end)) {
+			granule_unlock(wi.g_llt);
+			break;
+		}
+
+		s2tt = granule_map(wi.g_llt, SLOT_RTT);
+
+		for (index = wi.index;
+		     (index < S2TTES_PER_S2TT) && ((addr + map_size) <= end);
+		     index++, addr += map_size) {
+			unsigned long s2tte = s2tte_read(&s2tt[index]);
+
+			if (s2tte_is_valid(s2tte, level)) {
+				s2tte = s2tte_create_assigned_empty(
+						s2tte_pa(s2tte, level), level);
+				invalidate = true;
+			} else if (s2tte_is_unassigned(s2tte)) {
+				s2tte = s2tte_create_unassigned(RMI_EMPTY);
+			} else if (s2tte_is_table(s2tte, level)) {
+				/* Walk down to the table from its address */
+				break;
+			} else if (!s2tte_is_assigned(s2tte, level)) {
+				stop = true;
+				break;
+			}
+
+			s2tte_write(&s2tt[index], s2tte);
+		}
+
+		realm_ripas_summary_clear(rd, base, addr);
+
+		if (invalidate) {
+			invalidate_range(&rd->s2_ctx, base, addr - base, level);
+			realm_s2_unmap_gen_inc(rd);
+		}
+
+		buffer_unmap(s2tt);
+		granule_unlock(wi.g_llt);
+
+		if (stop) {
+			break;
+		}
+	}
+
+	return addr;
+}
+
+/*
+ * Return the level of the RMI_RTT_SET_RIPAS which the Host issues at @addr
+ * for a change ending at @end, i.e. the one of the largest block at @addr
+ * which the range covers.
+ */
+static long ripas_change_level(unsigned long addr, unsigned long end)
+{
+	long level;
+
+	for (level = RTT_MIN_BLOCK_LEVEL; level < RTT_PAGE_LEVEL; level++) {
+		if (addr_is_level_aligned(addr, level) &&
+		    ((addr + s2tte_map_size((int)level)) <= end)) {
+			break;
+		}
+	}
+
+	return level;
+}
+
+/*
+ * Walk the RTTs of @rd at @addr and return the level at which the walk
+ * stops. @split is set if the entry there is a block mapping which has to
+ * be split for an RMI_RTT_SET_RIPAS at @level.
+ */
+static long ripas_change_walk(struct rd *rd, unsigned long addr, long level,
+			      bool *split)
+{
+	struct rtt_walk wi;
+	unsigned long *s2tt, s2tte;
+
+	granule_lock(rd->s2_ctx.g_rtt, GRANULE_STATE_RTT);
+	rtt_walk_lock_unlock_ctx(&rd->s2_ctx, addr, level, &wi);
+
+	s2tt = granule_map(wi.g_llt, SLOT_RTT);
+	s2tte = s2tte_read(&s2tt[wi.index]);
+	buffer_unmap(s2tt);
+	granule_unlock(wi.g_llt);
+
+	*split = (wi.last_level < level) &&
+		 s2tte_is_assigned(s2tte, wi.last_level);
+
+	return wi.last_level;
+}
+
+/*
+ * Report in @rec_exit the RTT levels the Host needs for the RIPAS change of
+ * [@addr, @end), so that it can create them, splitting blocks as needed,
+ * before its first RMI_RTT_SET_RIPAS. Only the two ends of the range need
+ * RTTs deeper than the largest block they cover.
+ */
+static void ripas_change_hint(struct rd *rd, unsigned long addr,
+			      unsigned long end, struct rmi_rec_exit *rec_exit)
+{
+	unsigned long tail = end - GRANULE_SIZE;
+	long head_level = ripas_change_level(addr, end);
+	long tail_level;
+	bool split;
+
+	/* The last RMI_RTT_SET_RIPAS is at the largest block ending at @end */
+	for (tail_level = RTT_MIN_BLOCK_LEVEL; tail_level < RTT_PAGE_LEVEL;
+	     tail_level++) {
+		unsigned long size = s2tte_map_size((int)tail_level);
+
+		if (addr_is_level_aligned(end, tail_level) &&
+		    ((end - addr) >= size)) {
+			tail = end - size;
+			break;
+		}
+	}
+
+	rec_exit->ripas_split = 0UL;
+
+	rec_exit->ripas_head_level = (unsigned long)head_level;
+	rec_exit->ripas_head_rtt_level = (unsigned long)ripas_change_walk(rd,
+						addr, head_level, &split);
+	if (split) {
+		rec_exit->ripas_split |= RMI_RIPAS_SPLIT_HEAD;
+	}
+
+	rec_exit->ripas_tail_level = (unsigned long)tail_level;
+	rec_exit->ripas_tail_rtt_level = (unsigned long)ripas_change_walk(rd,
+						tail, tail_level, &split);
+	if (split) {
+		rec_exit->ripas_split |= RMI_RIPAS_SPLIT_TAIL;
+	}
+}
 
 bool handle_rsi_ipa_state_set(struct rec *rec, struct rmi_rec_exit *rec_exit)
 {
 	unsigned long start = rec->regs[1];
 	unsigned long size = rec->regs[2];
 	unsigned long end = start + size;
+	unsigned long addr = start;
 	enum ripas ripas = (enum ripas)rec->regs[3];
 
+	rec->regs[0] = RSI_ERROR_INPUT;
+
 	if (ripas > RMI_RAM) {
 		return true;
 	}
@@ -38,15 +206,27 @@ bool handle_rsi_ipa_state_set(struct rec *rec, struct rmi_rec_exit *rec_exit)
 		return true;
 	}
 
+	if ((ripas == RMI_EMPTY) && rec->rd->auto_ripas_empty) {
+		addr = ripas_empty_in_place(rec->rd, start, end);
+
+		if (addr == end) {
+			rec->regs[0] = RSI_SUCCESS;
+			rec->regs[1] = end;
+			return true;
+		}
+	}
+
 	rec->set_ripas.start = start;
 	rec->set_ripas.end = end;
-	rec->set_ripas.addr = start;
+	rec->set_ripas.addr = addr;
 	rec->set_ripas.ripas = ripas;
 
+	/* Only the part of the range not changed by RMM is left to the Host */
 	rec_exit->exit_reason = RMI_EXIT_RIPAS_CHANGE;
-	rec_exit->ripas_base = start;
-	rec_exit->ripas_size = size;
+	rec_exit->ripas_base = addr;
+	rec_exit->ripas_size = end - addr;
 	rec_exit->ripas_value = (unsigned int)ripas;
+	ripas_change_hint(rec->rd, addr, end, rec_exit);
 
 	return false;
 }
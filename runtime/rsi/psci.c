@@ -3,6 +3,7 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <arch_helpers.h>
 #include <granule.h>
 #include <psci.h>
 #include <realm.h>
@@ -10,6 +11,7 @@
 #include <smc-rmi.h>
 #include <smc.h>
 #include <stdint.h>
+#include <vmid.h>
 
 static struct psci_result psci_version(struct rec *rec)
 {
@@ -76,14 +78,55 @@ static void psci_reset_rec(struct rec *rec, unsigned long caller_sctlr_el1)
 	rec->sysregs.sctlr_el1 |= caller_sctlr_el1 & SCTLR_EL1_EE;
 }
 
-static unsigned long rd_map_read_rec_count(struct granule *g_rd)
+/*
+ * In the following two functions, it is only safe to access the runnable field
+ * on the target_rec once the target_rec is no longer running on another PE and
+ * all writes performed by the other PE as part of smc_rec_enter is also
+ * guaranteed to be observed here, which we know when we read a zero refcount
+ * on the target rec using acquire semantics paired with the release semantics
+ * on the reference count in smc_rec_enter. If we observe a non-zero refcount
+ * it simply means that the target_rec is running and we can return the
+ * corresponding value.
+ */
+static unsigned long complete_psci_cpu_on(struct rec *target_rec,
+					  unsigned long entry_point_address,
+					  unsigned long caller_sctlr_el1)
+{
+	if ((granule_refcount_read_acquire(target_rec->g_rec) != 0UL) ||
+		target_rec->runnable) {
+		return PSCI_RETURN_ALREADY_ON;
+	}
+
+	psci_reset_rec(target_rec, caller_sctlr_el1);
+	target_rec->pc = entry_point_address;
+	target_rec->runnable = true;
+	return PSCI_RETURN_SUCCESS;
+}
+
+static unsigned long complete_psci_affinity_info(struct rec *target_rec)
+{
+	if ((granule_refcount_read_acquire(target_rec->g_rec) != 0UL) ||
+		target_rec->runnable) {
+		return PSCI_AFFINITY_INFO_ON;
+	}
+
+	return PSCI_AFFINITY_INFO_OFF;
+}
+
+/*
+ * Lock and map the REC of the Realm of @rec with index @rec_idx, so that a
+ * PSCI request of @rec targeting it can be completed without exiting to the
+ * Host. Returns NULL if the Host did not allow it on this REC entry or if the
+ * target REC cannot be mapped, in which case the request is forwarded to the
+ * Host as usual.
+ */
+static struct rec *psci_map_target_rec(struct rec *rec, unsigned long rec_idx)
 {
-	unsigned long rec_count;
-	struct rd *rd = granule_map(g_rd, SLOT_RD);
+	if (!rec->psci_info.local) {
+		return NULL;
+	}
 
-	rec_count = get_rd_rec_count_unlocked(rd);
-	buffer_unmap(rd);
-	return rec_count;
+	return rec_map_sibling(rec, rec_idx);
 }
 
 static struct psci_result psci_cpu_on(struct rec *rec,
@@ -93,6 +136,7 @@ static struct psci_result psci_cpu_on(struct rec *rec,
 {
 	struct psci_result result = { 0 };
 	unsigned long target_rec_idx;
+	struct rec *target_rec;
 
 	/* Check that entry_point_address is a Protected Realm Address */
 	if (!addr_in_rec_par(rec, entry_point_address)) {
@@ -108,7 +152,7 @@ static struct psci_result psci_cpu_on(struct rec *rec,
 	 * Note that the RMM enforces that the REC are created with
 	 * consecutively increasing indexes starting from zero.
 	 */
-	if (target_rec_idx >= rd_map_read_rec_count(rec->realm_info.g_rd)) {
+	if (target_rec_idx >= get_rd_rec_count_unlocked(rec->rd)) {
 		result.smc_res.x[0] = PSCI_RETURN_INVALID_PARAMS;
 		return result;
 	}
@@ -119,6 +163,22 @@ static struct psci_result psci_cpu_on(struct rec *rec,
 		return result;
 	}
 
+	target_rec = psci_map_target_rec(rec, target_rec_idx);
+	if (target_rec != NULL) {
+		result.smc_res.x[0] = complete_psci_cpu_on(target_rec,
+							   entry_point_address,
+							   read_sctlr_el12());
+		rec_unmap_sibling(target_rec);
+
+		/* Let the Host know that it can schedule the target REC */
+		if (result.smc_res.x[0] == PSCI_RETURN_SUCCESS) {
+			result.hvc_forward.forward_psci_call = true;
+			result.hvc_forward.x1 = target_cpu;
+			result.hvc_forward.x2 = RMI_EXIT_PSCI_COMPLETED;
+		}
+		return result;
+	}
+
 	rec->psci_info.pending = true;
 
 	result.hvc_forward.forward_psci_call = true;
@@ -132,6 +192,7 @@ static struct psci_result psci_affinity_info(struct rec *rec,
 {
 	struct psci_result result = { 0 };
 	unsigned long target_rec_idx;
+	struct rec *target_rec;
 
 	if (lowest_affinity_level != 0UL) {
 		result.smc_res.x[0] = PSCI_RETURN_INVALID_PARAMS;
@@ -146,7 +207,7 @@ static struct psci_result psci_affinity_info(struct rec *rec,
 	 * Note that the RMM enforces that the REC are created with
 	 * consecutively increasing indexes starting from zero.
 	 */
-	if (target_rec_idx >= rd_map_read_rec_count(rec->realm_info.g_rd)) {
+	if (target_rec_idx >= get_rd_rec_count_unlocked(rec->rd)) {
 		result.smc_res.x[0] = PSCI_RETURN_INVALID_PARAMS;
 		return result;
 	}
@@ -157,6 +218,13 @@ static struct psci_result psci_affinity_info(struct rec *rec,
 		return result;
 	}
 
+	target_rec = psci_map_target_rec(rec, target_rec_idx);
+	if (target_rec != NULL) {
+		result.smc_res.x[0] = complete_psci_affinity_info(target_rec);
+		rec_unmap_sibling(target_rec);
+		return result;
+	}
+
 	rec->psci_info.pending = true;
 
 	result.hvc_forward.forward_psci_call = true;
@@ -172,7 +240,7 @@ static struct psci_result psci_affinity_info(struct rec *rec,
  */
 static void system_off_reboot(struct rec *rec)
 {
-	struct rd *rd;
+	struct rd *rd = rec->rd;
 	struct granule *g_rd = rec->realm_info.g_rd;
 
 	/*
@@ -181,11 +249,10 @@ static void system_off_reboot(struct rec *rec)
 	 * the rd lock here before we set the Realm's new state.
 	 */
 	granule_lock(g_rd, GRANULE_STATE_RD);
-	rd = granule_map(rec->realm_info.g_rd, SLOT_RD);
 
 	set_rd_state(rd, REALM_STATE_SYSTEM_OFF);
+	vmid_set_realm_active(rd->s2_ctx.vmid, false);
 
-	buffer_unmap(rd);
 	granule_unlock(g_rd);
 
 	/* TODO: Invalidate all stage 2 entris to ensure REC exits */
@@ -291,41 +358,6 @@ struct psci_result psci_rsi(struct rec *rec,
 	return result;
 }
 
-/*
- * In the following two functions, it is only safe to access the runnable field
- * on the target_rec once the target_rec is no longer running on another PE and
- * all writes performed by the other PE as part of smc_rec_enter is also
- * guaranteed to be observed here, which we know when we read a zero refcount
- * on the target rec using acquire semantics paired with the release semantics
- * on the reference count in smc_rec_enter. If we observe a non-zero refcount
- * it simply means that the target_rec is running and we can return the
- * corresponding value.
- */
-static unsigned long complete_psci_cpu_on(struct rec *target_rec,
-					  unsigned long entry_point_address,
-					  unsigned long caller_sctlr_el1)
-{
-	if ((granule_refcount_read_acquire(target_rec->g_rec) != 0UL) ||
-		target_rec->runnable) {
-		return PSCI_RETURN_ALREADY_ON;
-	}
-
-	psci_reset_rec(target_rec, caller_sctlr_el1);
-	target_rec->pc = entry_point_address;
-	target_rec->runnable = true;
-	return PSCI_RETURN_SUCCESS;
-}
-
-static unsigned long complete_psci_affinity_info(struct rec *target_rec)
-{
-	if ((granule_refcount_read_acquire(target_rec->g_rec) != 0UL) ||
-		target_rec->runnable) {
-		return PSCI_AFFINITY_INFO_ON;
-	}
-
-	return PSCI_AFFINITY_INFO_OFF;
-}
-
 unsigned long psci_complete_request(struct rec *calling_rec,
 				    struct rec *target_rec)
 {
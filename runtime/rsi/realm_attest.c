@@ -3,9 +3,11 @@
  * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
  */
 
+#include <arch_helpers.h>
 #include <attestation.h>
 #include <attestation_token.h>
 #include <debug.h>
+#include <fpu_helpers.h>
 #include <granule.h>
 #include <measurement.h>
 #include <realm.h>
@@ -15,28 +17,15 @@
 #include <string.h>
 #include <utils_def.h>
 
-#define MAX_EXTENDED_SIZE		(64U)
-
-/*
- * Return the Realm Personalization Value.
- *
- * Arguments:
- * rd    - The Realm descriptor.
- * claim - The structure to return the Realm Personalization Value claim
- */
-static void get_rpv(struct rd *rd, struct q_useful_buf_c *claim)
-{
-	claim->ptr = (uint8_t *)&(rd->rpv[0]);
-	claim->len = RPV_SIZE;
-}
-
 /*
  * Save the input parameters in the context for later iterations to check for
  * consistency.
  */
-static void save_input_parameters(struct rec *rec)
+static void save_input_parameters(struct rec *rec, unsigned long buf_size)
 {
 	rec->token_sign_ctx.token_ipa = rec->regs[1];
+	rec->token_sign_ctx.token_buf_size = buf_size;
+	rec->token_sign_ctx.token_written = 0U;
 	(void)memcpy(rec->token_sign_ctx.challenge, &rec->regs[2],
 		     ATTEST_CHALLENGE_SIZE);
 }
@@ -50,6 +39,34 @@ static bool verify_input_parameters_consistency(struct rec *rec)
 	return rec->token_sign_ctx.token_ipa == rec->regs[1];
 }
 
+/*
+ * Return true if the last Realm token of @rec was signed for the challenge
+ * of the RSI_ATTEST_TOKEN_INIT call and the current measurements, in which
+ * case it can be written to the Realm buffer again.
+ */
+static bool realm_token_cached(struct rec *rec)
+{
+	return (rec->token_sign_ctx.meas_gen == rec->rd->meas_gen) &&
+		(memcmp(rec->token_sign_ctx.challenge, &rec->regs[2],
+			ATTEST_CHALLENGE_SIZE) == 0);
+}
+
+/* Run a signing iteration of the Realm token of @rec */
+static enum attest_token_err_t realm_token_sign(struct rec *rec)
+{
+#ifdef RMM_ATTEST_BATCH
+	struct q_useful_buf token_buf = {
+		rec->rmm_realm_token_buf, sizeof(rec->rmm_realm_token_buf)};
+
+	return attest_realm_token_batch_sign(&(rec->token_sign_ctx),
+					     &token_buf,
+					     &(rec->rmm_realm_token));
+#else
+	return attest_realm_token_sign(&(rec->token_sign_ctx.ctx),
+				       &(rec->rmm_realm_token));
+#endif
+}
+
 /*
  * Function to continue with the sign operation.
  * It returns void as the result will be updated in the
@@ -61,11 +78,15 @@ static void attest_token_continue_sign_state(struct rec *rec,
 	/*
 	 * Sign and finish creating the token.
 	 */
-	enum attest_token_err_t ret =
-		attest_realm_token_sign(&(rec->token_sign_ctx.ctx),
-					&(rec->rmm_realm_token));
+	enum attest_token_err_t ret = realm_token_sign(rec);
 
-	if ((ret == ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS) ||
+	if (ret == ATTEST_TOKEN_ERR_BATCH_WAIT) {
+		/*
+		 * Let the Realm call again instead of spinning until the
+		 * rest of the batch is ready.
+		 */
+		res->smc_res.x[0] = RSI_INCOMPLETE;
+	} else if ((ret == ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS) ||
 		(ret == ATTEST_TOKEN_ERR_SUCCESS)) {
 		/*
 		 * Return to RSI handler function after each iteration
@@ -87,73 +108,134 @@ static void attest_token_continue_sign_state(struct rec *rec,
 	}
 }
 
+/* Number of PA extents of the token buffer translated by a single walk */
+#define TOKEN_WRITE_EXTENTS	4U
+
+/*
+ * Write the CCA token of @rec to the @nr_extents @extents of the Realm
+ * buffer, one granule at a time from ctx->token_written. Returns the length
+ * of the token, or 0 if the platform token changed.
+ */
+static size_t token_write_extents(struct rec *rec,
+				  struct s2_walk_extent *extents,
+				  unsigned int nr_extents)
+{
+	struct token_sign_ctx *ctx = &rec->token_sign_ctx;
+	struct q_useful_buf chunk_buf;
+	size_t attest_token_len = 0U;
+
+	for (unsigned int i = 0U; i < nr_extents; i++) {
+		for (unsigned long offset = 0UL; offset < extents[i].size;
+		     offset += GRANULE_SIZE) {
+			/* Map realm data granule to RMM address space */
+			chunk_buf.ptr = granule_map_mec(
+					find_granule(extents[i].pa + offset),
+					SLOT_RSI_CALL, rec->realm_info.mecid);
+			chunk_buf.len = GRANULE_SIZE;
+
+			attest_token_len = attest_cca_token_read(
+							&rec->rmm_realm_token,
+							ctx->token_written,
+							&chunk_buf,
+							&ctx->token_gen);
+
+			/* Unmap realm granule */
+			buffer_unmap(chunk_buf.ptr);
+
+			if ((attest_token_len == 0U) ||
+			    (attest_token_len > ctx->token_buf_size)) {
+				return attest_token_len;
+			}
+
+			ctx->token_written += GRANULE_SIZE;
+			if (ctx->token_written >= attest_token_len) {
+				return attest_token_len;
+			}
+		}
+	}
+
+	return attest_token_len;
+}
+
 /*
  * Function to continue with the token write operation.
  * It returns void as the result will be updated in the
  * struct attest_result passed as argument.
+ *
+ * The part of the Realm buffer left to write is translated with a single
+ * RTT walk for each last level table, and the progress is kept in the token
+ * sign context, so that the write resumes from the granule which could not
+ * be translated once the Host has mapped it.
  */
 static void attest_token_continue_write_state(struct rec *rec,
 					      struct attest_result *res)
 {
-	struct rd *rd = NULL;
-	struct granule *gr;
-	uint8_t *realm_att_token;
-	unsigned long realm_att_token_ipa = rec->regs[1];
+	struct token_sign_ctx *ctx = &rec->token_sign_ctx;
+	struct rd *rd = rec->rd;
+	struct s2_walk_extent extents[TOKEN_WRITE_EXTENTS];
+	unsigned int nr_extents;
 	enum s2_walk_status walk_status;
 	struct s2_walk_result walk_res = { 0UL };
-	struct q_useful_buf     attest_token_buf;
-	size_t    attest_token_len;
-
-	/*
-	 * The refcount on rd and rec will protect from any changes
-	 * while REC is running.
-	 */
-	rd = granule_map(rec->realm_info.g_rd, SLOT_RD);
+	size_t attest_token_len;
 
-	/*
-	 * Translate realm granule IPA to PA. If returns with
-	 * WALK_SUCCESS then the last level page table (llt),
-	 * which holds the realm_att_token_buf mapping, is locked.
-	 */
-	walk_status = realm_ipa_to_pa(rd, realm_att_token_ipa, &walk_res);
-	buffer_unmap(rd);
-
-	/* Walk parameter validity was checked by RSI_ATTESTATION_TOKEN_INIT */
-	assert(walk_status != WALK_INVALID_PARAMS);
+	while (true) {
+		/*
+		 * Translate the rest of the realm buffer. If returns with
+		 * WALK_SUCCESS then the last level page table (llt),
+		 * which holds the mapping of the extents, is locked.
+		 */
+		nr_extents = TOKEN_WRITE_EXTENTS;
+		walk_status = realm_ipa_range_to_pa(rd,
+				ctx->token_ipa + ctx->token_written,
+				ctx->token_buf_size - ctx->token_written,
+				extents, &nr_extents, &walk_res);
 
-	if (walk_status == WALK_FAIL) {
-		if (s2_walk_result_match_ripas(&walk_res, RMI_EMPTY)) {
-			res->smc_res.x[0] = RSI_ERROR_INPUT;
-		} else {
-			/*
-			 * Translation failed, IPA is not mapped. Return to NS host to
-			 * fix the issue.
-			 */
-			res->walk_result.abort = true;
-			res->walk_result.rtt_level = walk_res.rtt_level;
-			res->smc_res.x[0] = RSI_INCOMPLETE;
+		/*
+		 * Walk parameter validity was checked by
+		 * RSI_ATTESTATION_TOKEN_INIT
+		 */
+		assert(walk_status != WALK_INVALID_PARAMS);
+
+		if (walk_status == WALK_FAIL) {
+			if (s2_walk_result_match_ripas(&walk_res, RMI_EMPTY)) {
+				res->smc_res.x[0] = RSI_ERROR_INPUT;
+			} else {
+				/*
+				 * Translation failed, IPA is not mapped.
+				 * Return to NS host to fix the issue.
+				 */
+				res->walk_result.abort = true;
+				res->walk_result.rtt_level = walk_res.rtt_level;
+				res->smc_res.x[0] = RSI_INCOMPLETE;
+			}
+			return;
 		}
-		return;
-	}
 
-	/* Map realm data granule to RMM address space */
-	gr = find_granule(walk_res.pa);
-	realm_att_token = granule_map(gr, SLOT_RSI_CALL);
+		attest_token_len = token_write_extents(rec, extents,
+						       nr_extents);
 
-	attest_token_buf.ptr = realm_att_token;
-	attest_token_buf.len = ATTEST_TOKEN_BUFFER_SIZE;
+		/* Unlock last level page table (walk_res.g_llt) */
+		granule_unlock(walk_res.llt);
 
-	attest_token_len = attest_cca_token_create(&attest_token_buf,
-						   &rec->rmm_realm_token);
+		if (attest_token_len == 0U) {
+			/* The platform token changed, start over */
+			ctx->token_written = 0U;
+			continue;
+		}
 
-	/* Unmap realm granule */
-	buffer_unmap(realm_att_token);
+		if (attest_token_len > ctx->token_buf_size) {
+			attest_token_len = 0U;
+			break;
+		}
 
-	/* Unlock last level page table (walk_res.g_llt) */
-	granule_unlock(walk_res.llt);
+		if (ctx->token_written >= attest_token_len) {
+			break;
+		}
+	}
 
 	/* Write output parameters */
-	if (attest_token_len == 0) {
+	if (attest_token_len == 0U) {
+		ERROR("CCA output token buffer too small\n");
 		res->smc_res.x[0] = RSI_ERROR_INPUT;
 	} else {
 		res->smc_res.x[0] = RSI_SUCCESS;
@@ -161,17 +243,17 @@ static void attest_token_continue_write_state(struct rec *rec,
 	}
 
 	/* The signing has either succeeded or failed. Reset the state. */
-	rec->token_sign_ctx.state = ATTEST_SIGN_NOT_STARTED;
+	ctx->state = ATTEST_SIGN_NOT_STARTED;
 }
 
 unsigned long handle_rsi_attest_token_init(struct rec *rec)
 {
-	struct rd *rd = NULL;
+	struct rd *rd = rec->rd;
 	unsigned long ret;
 	unsigned long realm_buf_ipa = rec->regs[1];
+	unsigned long realm_buf_size = rec->regs[10];
 	struct q_useful_buf rmm_realm_token_buf = {
 		rec->rmm_realm_token_buf, sizeof(rec->rmm_realm_token_buf)};
-	struct q_useful_buf_c rpv;
 	int att_ret;
 
 	assert(rec != NULL);
@@ -184,6 +266,13 @@ unsigned long handle_rsi_attest_token_init(struct rec *rec)
 	if (rec->token_sign_ctx.state != ATTEST_SIGN_NOT_STARTED) {
 		int restart;
 
+#ifdef RMM_ATTEST_BATCH
+		attest_realm_token_batch_abort(&rec->token_sign_ctx);
+#endif
+		/* The token is only kept once it is signed */
+		if (rec->token_sign_ctx.state == ATTEST_SIGN_IN_PROGRESS) {
+			rec->token_sign_ctx.meas_gen = 0UL;
+		}
 		rec->token_sign_ctx.state = ATTEST_SIGN_NOT_STARTED;
 		restart = attestation_heap_reinit_pe(rec->aux_data.attest_heap_buf,
 						      REC_HEAP_PAGES * SZ_4K);
@@ -193,7 +282,13 @@ unsigned long handle_rsi_attest_token_init(struct rec *rec)
 		}
 	}
 
-	if (!GRANULE_ALIGNED(realm_buf_ipa)) {
+	if (realm_buf_size == 0UL) {
+		realm_buf_size = ATTEST_TOKEN_BUFFER_SIZE;
+	}
+
+	if (!GRANULE_ALIGNED(realm_buf_ipa) ||
+	    !GRANULE_ALIGNED(realm_buf_size) ||
+	    ((realm_buf_ipa + realm_buf_size) < realm_buf_ipa)) {
 		return RSI_ERROR_INPUT;
 	}
 
@@ -202,22 +297,33 @@ unsigned long handle_rsi_attest_token_init(struct rec *rec)
 	 * simultaneously by another rec
 	 */
 	granule_lock(rec->realm_info.g_rd, GRANULE_STATE_RD);
-	rd = granule_map(rec->realm_info.g_rd, SLOT_RD);
-	if (!addr_in_par(rd, realm_buf_ipa)) {
+	if (!addr_in_par(rd, realm_buf_ipa) ||
+	    !addr_in_par(rd, realm_buf_ipa + realm_buf_size - 1UL)) {
 		ret = RSI_ERROR_INPUT;
-		goto out_unmap_rd;
+		goto out_unlock_rd;
+	}
+
+	/*
+	 * A retry of the last request, with the same challenge and no REM
+	 * extended since, gets the token signed for it.
+	 */
+	if (realm_token_cached(rec)) {
+		save_input_parameters(rec, realm_buf_size);
+		rec->token_sign_ctx.state = ATTEST_SIGN_TOKEN_WRITE_IN_PROGRESS;
+		ret = RSI_SUCCESS;
+		goto out_unlock_rd;
 	}
 
 	/*
 	 * Save the input parameters in the context for later iterations
 	 * to check.
 	 */
-	save_input_parameters(rec);
+	save_input_parameters(rec, realm_buf_size);
+	rec->token_sign_ctx.meas_gen = rd->meas_gen;
 
-	get_rpv(rd, &rpv);
 	att_ret = attest_realm_token_create(rd->algorithm, rd->measurement,
 					    MEASUREMENT_SLOT_NR,
-					    &rpv,
+					    &rd->attest_claims,
 					    &rec->token_sign_ctx,
 					    &rmm_realm_token_buf);
 	if (att_ret != 0) {
@@ -228,8 +334,7 @@ unsigned long handle_rsi_attest_token_init(struct rec *rec)
 	rec->token_sign_ctx.state = ATTEST_SIGN_IN_PROGRESS;
 	ret = RSI_SUCCESS;
 
-out_unmap_rd:
-	buffer_unmap(rd);
+out_unlock_rd:
 	granule_unlock(rec->realm_info.g_rd);
 	return ret;
 }
@@ -244,6 +349,40 @@ void attest_realm_token_sign_continue_finish(void)
 	fpu_restore_my_state();
 }
 
+/*
+ * Sign the Realm token of @rec, which is not running, on behalf of
+ * RMI_REC_ATTEST_SIGN. The signing stops early if an IRQ is pending, and
+ * the next RMI_REC_ATTEST_SIGN or RSI_ATTEST_TOKEN_CONTINUE resumes it.
+ *
+ * Return true if the token is signed.
+ */
+bool handle_rmi_attest_token_sign(struct rec *rec)
+{
+	enum attest_token_err_t ret;
+
+	assert(rec->token_sign_ctx.state == ATTEST_SIGN_IN_PROGRESS);
+
+	attest_realm_token_sign_continue_start();
+	do {
+		ret = realm_token_sign(rec);
+	} while ((ret == ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS) &&
+		 (read_isr_el1() == 0UL));
+	attest_realm_token_sign_continue_finish();
+
+	if ((ret == ATTEST_TOKEN_ERR_COSE_SIGN_IN_PROGRESS) ||
+	    (ret == ATTEST_TOKEN_ERR_BATCH_WAIT)) {
+		return false;
+	}
+
+	if (ret != ATTEST_TOKEN_ERR_SUCCESS) {
+		ERROR("FATAL_ERROR: Realm token creation failed\n");
+		panic();
+	}
+
+	rec->token_sign_ctx.state = ATTEST_SIGN_TOKEN_WRITE_IN_PROGRESS;
+	return true;
+}
+
 void handle_rsi_attest_token_continue(struct rec *rec,
 				      struct attest_result *res)
 {
@@ -252,6 +391,7 @@ void handle_rsi_attest_token_continue(struct rec *rec,
 
 	/* Initialize attest_result */
 	res->incomplete = false;
+	res->deferred = false;
 	res->walk_result.abort = false;
 
 	if (!verify_input_parameters_consistency(rec)) {
@@ -269,6 +409,11 @@ void handle_rsi_attest_token_continue(struct rec *rec,
 		res->smc_res.x[0] = RSI_ERROR_STATE;
 		break;
 	case ATTEST_SIGN_IN_PROGRESS:
+		if (rec->attest_sign_defer) {
+			res->deferred = true;
+			res->smc_res.x[0] = RSI_INCOMPLETE;
+			break;
+		}
 		attest_token_continue_sign_state(rec, res);
 		break;
 	case ATTEST_SIGN_TOKEN_WRITE_IN_PROGRESS:
@@ -301,7 +446,7 @@ unsigned long handle_rsi_extend_measurement(struct rec *rec)
 
 	assert(g_rd != NULL);
 
-	rd = granule_map(rec->realm_info.g_rd, SLOT_RD);
+	rd = rec->rd;
 
 	/*
 	 * X1:     index
@@ -313,14 +458,14 @@ unsigned long handle_rsi_extend_measurement(struct rec *rec)
 	if ((index == RIM_MEASUREMENT_SLOT) ||
 	    (index >= MEASUREMENT_SLOT_NR)) {
 		ret = RSI_ERROR_INPUT;
-		goto out_unmap_rd;
+		goto out_unlock_rd;
 	}
 
 	size  = rec->regs[2];
 
-	if (size > MAX_EXTENDED_SIZE) {
+	if (size > RSI_MEASUREMENT_EXTEND_MAX_SIZE) {
 		ret = RSI_ERROR_INPUT;
-		goto out_unmap_rd;
+		goto out_unlock_rd;
 	}
 
 	extend_measurement = &rec->regs[3];
@@ -331,15 +476,111 @@ unsigned long handle_rsi_extend_measurement(struct rec *rec)
 			   extend_measurement,
 			   size,
 			   current_measurement);
+	rd->meas_gen++;
 
 	ret = RSI_SUCCESS;
 
-out_unmap_rd:
-	buffer_unmap(rd);
+out_unlock_rd:
 	granule_unlock(g_rd);
 	return ret;
 }
 
+struct rsi_walk_smc_result handle_rsi_extend_measurement_multi(
+							struct rec *rec)
+{
+	struct rsi_walk_smc_result res = { 0 };
+	unsigned long ipa = rec->regs[1];
+	unsigned long nr_records = rec->regs[2];
+	unsigned char rems[MEASUREMENT_SLOT_NR][MAX_MEASUREMENT_SIZE];
+	struct rsi_measurement_extend_record *records;
+	struct rsi_measurement_extend_record record;
+	enum s2_walk_status walk_status;
+	struct s2_walk_result walk_res;
+	struct rd *rd;
+
+	if (!GRANULE_ALIGNED(ipa) || !addr_in_rec_par(rec, ipa) ||
+	    (nr_records == 0UL) ||
+	    (nr_records > RSI_MEASUREMENT_EXTEND_MULTI_MAX)) {
+		res.smc_res.x[0] = RSI_ERROR_INPUT;
+		return res;
+	}
+
+	/*
+	 * rd lock is acquired so that measurement cannot be updated
+	 * simultaneously by another rec
+	 */
+	granule_lock(rec->realm_info.g_rd, GRANULE_STATE_RD);
+	rd = rec->rd;
+
+	walk_status = realm_ipa_to_pa(rd, ipa, &walk_res);
+
+	if (walk_status == WALK_FAIL) {
+		if (s2_walk_result_match_ripas(&walk_res, RMI_EMPTY)) {
+			res.smc_res.x[0] = RSI_ERROR_INPUT;
+		} else {
+			/* Exit to Host */
+			res.walk_result.abort = true;
+			res.walk_result.rtt_level = walk_res.rtt_level;
+		}
+		goto out_unlock_rd;
+	}
+
+	if (walk_status == WALK_INVALID_PARAMS) {
+		/* Return error to Realm */
+		res.smc_res.x[0] = RSI_ERROR_INPUT;
+		goto out_unlock_rd;
+	}
+
+	/* Map Realm data granule to RMM address space */
+	records = granule_map_mec(find_granule(walk_res.pa), SLOT_RSI_CALL,
+				  rec->realm_info.mecid);
+
+	/*
+	 * Extend a copy of the measurements, so that none of them changes
+	 * if one of the records is invalid.
+	 */
+	(void)memcpy(rems, rd->measurement, sizeof(rems));
+	res.smc_res.x[0] = RSI_SUCCESS;
+
+	/* Save the FPU state once for all the extensions */
+	fpu_save_my_state();
+
+	for (unsigned long i = 0UL; i < nr_records; i++) {
+		/* The Realm can change the record, check and use a copy */
+		(void)memcpy(&record, &records[i], sizeof(record));
+
+		if ((record.index == RIM_MEASUREMENT_SLOT) ||
+		    (record.index >= MEASUREMENT_SLOT_NR) ||
+		    (record.size > RSI_MEASUREMENT_EXTEND_MAX_SIZE)) {
+			res.smc_res.x[0] = RSI_ERROR_INPUT;
+			break;
+		}
+
+		measurement_extend(rd->algorithm,
+				   rems[record.index],
+				   record.value,
+				   record.size,
+				   rems[record.index]);
+	}
+
+	fpu_restore_my_state();
+
+	if (res.smc_res.x[0] == RSI_SUCCESS) {
+		(void)memcpy(rd->measurement, rems, sizeof(rems));
+		rd->meas_gen++;
+	}
+
+	/* Unmap Realm data granule */
+	buffer_unmap(records);
+
+	/* Unlock last level RTT */
+	granule_unlock(walk_res.llt);
+
+out_unlock_rd:
+	granule_unlock(rec->realm_info.g_rd);
+	return res;
+}
+
 unsigned long handle_rsi_read_measurement(struct rec *rec)
 {
 	struct rd *rd;
@@ -360,7 +601,7 @@ unsigned long handle_rsi_read_measurement(struct rec *rec)
 	 * simultaneously by another rec
 	 */
 	granule_lock(rec->realm_info.g_rd, GRANULE_STATE_RD);
-	rd = granule_map(rec->realm_info.g_rd, SLOT_RD);
+	rd = rec->rd;
 
 	measurement_size = measurement_get_size(rd->algorithm);
 
@@ -372,7 +613,6 @@ unsigned long handle_rsi_read_measurement(struct rec *rec)
 			     0, MAX_MEASUREMENT_SIZE - measurement_size);
 	}
 
-	buffer_unmap(rd);
 	granule_unlock(rec->realm_info.g_rd);
 
 	return RSI_SUCCESS;
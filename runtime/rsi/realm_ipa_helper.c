@@ -7,60 +7,101 @@
 #include <granule.h>
 #include <realm.h>
 
+/*
+ * Add the PA range [@pa, @pa + @size) to the @nr extents of @extents,
+ * merging it with the last one if they are contiguous. Returns false if
+ * all the @max_extents extents are used.
+ */
+static bool extent_add(struct s2_walk_extent *extents, unsigned int *nr,
+		       unsigned int max_extents, unsigned long pa,
+		       unsigned long size)
+{
+	if (*nr != 0U) {
+		struct s2_walk_extent *last = &extents[*nr - 1U];
+
+		if ((last->pa + last->size) == pa) {
+			last->size += size;
+			return true;
+		}
+	}
+
+	if (*nr == max_extents) {
+		return false;
+	}
+
+	extents[*nr].pa = pa;
+	extents[*nr].size = size;
+	(*nr)++;
+	return true;
+}
+
 /**
- * Translate a realm granule IPA to PA.
+ * Translate a range of realm IPAs to a list of contiguous PA extents.
+ *
+ * A single RTT walk is done, to the last level table (llt) holding the
+ * mapping of @ipa, which can be a page or a block mapping. The range is
+ * translated from there until its end, the end of the llt, the first
+ * entry which is not valid or until @nr_extents is exhausted. Only the
+ * llt is locked, the caller is expected to call again for the rest of
+ * the range once it has unlocked it.
  *
  * Parameters:
  * [in]   rd		    Pointer to realm descriptor granule.
- * [in]   ipa		    The intermediate physical address of the realm granule.
+ * [in]   ipa		    The intermediate physical address of the range.
+ * [in]   size		    The size of the range.
+ * [out]  extents	    The PA extents backing the translated part of
+ *			    the range, in IPA order.
+ * [in]   nr_extents	    Number of entries of @extents.
+ * [out]  nr_extents	    Number of entries of @extents filled.
  * [in]   s2_walk	    Address of s2_walk_result structure to return:
- * [out]  s2_walk.pa	    The physical address of the realm granule.
+ * [out]  s2_walk.pa	    The physical address of @ipa.
+ * [out]  s2_walk.size	    The size of the range translated from @ipa.
  * [out]  s2_walk.rtt_level The last level reached by the table walk.
- * [out]  s2_walk.ripas	    RIPAS of s2tte.
- * [out]  s2_walk.destroyed 'true', if s2tte has HIPAS=DESTROYED.
- * [out]  s2_walk.llt	    Pointer to the last level page table which contains
- *			    the mapping of the granule. If function returns with
- *			    WALK_SUCCESS then 'llt' must be unlocked by the caller.
- *			    Lock avoids to destoy the realm granule while RMM
- *			    accessing to it.
+ * [out]  s2_walk.ripas	    RIPAS of the s2tte of @ipa.
+ * [out]  s2_walk.destroyed 'true', if the s2tte of @ipa has HIPAS=DESTROYED.
+ * [out]  s2_walk.llt	    Pointer to the llt. If function returns with
+ *			    WALK_SUCCESS then 'llt' must be unlocked by the
+ *			    caller.
  * Returns:
- * WALK_SUCCESS		Translation succeeded.
- * WALK_INVALID_PARAMS	Parameter 'ipa' is unaligned or is not a Protected IPA.
- * WALK_FAIL		Mapping is not in the page table. NS Host needs to fix.
+ * WALK_SUCCESS		Translation of at least one granule succeeded.
+ * WALK_INVALID_PARAMS	The range is unaligned or is not in the Protected
+ *			IPA space.
+ * WALK_FAIL		Mapping of @ipa is not in the page table. NS Host
+ *			needs to fix.
  */
-enum s2_walk_status realm_ipa_to_pa(struct rd *rd,
-				    unsigned long ipa,
-				    struct s2_walk_result *s2_walk)
+enum s2_walk_status realm_ipa_range_to_pa(struct rd *rd,
+					  unsigned long ipa,
+					  unsigned long size,
+					  struct s2_walk_extent *extents,
+					  unsigned int *nr_extents,
+					  struct s2_walk_result *s2_walk)
 {
 	struct granule *g_table_root;
 	struct rtt_walk wi;
-	unsigned long s2tte, *ll_table, offset;
-	enum s2_walk_status walk_status;
+	unsigned long s2tte, *ll_table, map_size, offset, len;
+	unsigned long index;
+	unsigned int max_extents = *nr_extents;
+
+	assert(extents != NULL);
+	assert(max_extents != 0U);
 
-	if (!GRANULE_ALIGNED(ipa) || !addr_in_par(rd, ipa)) {
+	*nr_extents = 0U;
+
+	if (!GRANULE_ALIGNED(ipa) || !GRANULE_ALIGNED(size) ||
+	    (size == 0UL) || !addr_in_par(rd, ipa) ||
+	    (size > (realm_par_size(rd) - ipa))) {
 		return WALK_INVALID_PARAMS;
 	}
 
-	/*
-	 * SW table walk to find corresponding PA. It handles cases when buffer
-	 * is mapped on page level or on block level.
-	 *
-	 * Todo:
-	 * - Page mapping is assumed.
-	 */
 	g_table_root = rd->s2_ctx.g_rtt;
 	granule_lock(g_table_root, GRANULE_STATE_RTT);
-	rtt_walk_lock_unlock(g_table_root,
-			     realm_rtt_starting_level(rd),
-			     realm_ipa_bits(rd),
-			     ipa,
-			     RTT_PAGE_LEVEL,
-			     &wi);
+	rtt_walk_lock_unlock_ctx(&rd->s2_ctx, ipa, RTT_PAGE_LEVEL, &wi);
 
 	ll_table = granule_map(wi.g_llt, SLOT_RTT);
 
 	/* Must be unlocked by caller */
 	s2_walk->llt = wi.g_llt;
+	s2_walk->rtt_level = wi.last_level;
 	s2tte = s2tte_read(&ll_table[wi.index]);
 
 	if (!s2tte_is_valid(s2tte, wi.last_level)) {
@@ -70,29 +111,163 @@ enum s2_walk_status realm_ipa_to_pa(struct rd *rd,
 		 * emulate a Data Abort back to the Host or return error
 		 * back to Realm.
 		 */
-		s2_walk->rtt_level = wi.last_level;
 		if (s2tte_is_destroyed(s2tte)) {
 			s2_walk->destroyed = true;
 		} else {
 			s2_walk->ripas = s2tte_get_ripas(s2tte);
 		}
 		granule_unlock(wi.g_llt);
-		walk_status = WALK_FAIL;
-		goto out_unmap_table;
+		buffer_unmap(ll_table);
+		return WALK_FAIL;
 	}
 
-	s2_walk->pa = s2tte_pa(s2tte, wi.last_level);
-	offset = ipa & (s2tte_map_size(wi.last_level) - 1UL);
-	s2_walk->pa += offset;
+	map_size = s2tte_map_size((int)wi.last_level);
+	s2_walk->pa = s2tte_pa(s2tte, wi.last_level) +
+					(ipa & (map_size - 1UL));
+	s2_walk->size = 0UL;
 	s2_walk->ripas = RMI_RAM;
 
-	walk_status = WALK_SUCCESS;
+	for (index = wi.index; index < S2TTES_PER_S2TT; index++) {
+		if (index != wi.index) {
+			s2tte = s2tte_read(&ll_table[index]);
+			if (!s2tte_is_valid(s2tte, wi.last_level)) {
+				break;
+			}
+		}
+
+		/* The first entry can be a block only partly in the range */
+		offset = ipa & (map_size - 1UL);
+		len = map_size - offset;
+		if (len > size) {
+			len = size;
+		}
+
+		if (!extent_add(extents, nr_extents, max_extents,
+				s2tte_pa(s2tte, wi.last_level) + offset,
+				len)) {
+			break;
+		}
+
+		ipa += len;
+		size -= len;
+		s2_walk->size += len;
+
+		if (size == 0UL) {
+			break;
+		}
+	}
 
-out_unmap_table:
 	buffer_unmap(ll_table);
-	return walk_status;
+	return WALK_SUCCESS;
 }
 
+/**
+ * Translate a realm granule IPA to PA.
+ *
+ * Parameters:
+ * [in]   rd		    Pointer to realm descriptor granule.
+ * [in]   ipa		    The intermediate physical address of the realm granule.
+ * [in]   s2_walk	    Address of s2_walk_result structure to return:
+ * [out]  s2_walk.pa	    The physical address of the realm granule.
+ * [out]  s2_walk.rtt_level The last level reached by the table walk.
+ * [out]  s2_walk.ripas	    RIPAS of s2tte.
+ * [out]  s2_walk.destroyed 'true', if s2tte has HIPAS=DESTROYED.
+ * [out]  s2_walk.llt	    Pointer to the last level page table which contains
+ *			    the mapping of the granule. If function returns with
+ *			    WALK_SUCCESS then 'llt' must be unlocked by the caller.
+ *			    Lock avoids to destoy the realm granule while RMM
+ *			    accessing to it.
+ * Returns:
+ * WALK_SUCCESS		Translation succeeded.
+ * WALK_INVALID_PARAMS	Parameter 'ipa' is unaligned or is not a Protected IPA.
+ * WALK_FAIL		Mapping is not in the page table. NS Host needs to fix.
+ */
+enum s2_walk_status realm_ipa_to_pa(struct rd *rd,
+				    unsigned long ipa,
+				    struct s2_walk_result *s2_walk)
+{
+	struct s2_walk_extent extent;
+	unsigned int nr_extents = 1U;
+
+	return realm_ipa_range_to_pa(rd, ipa, GRANULE_SIZE,
+				     &extent, &nr_extents, s2_walk);
+}
+
+#ifdef RMM_RIPAS_SUMMARY
+#define RIPAS_SUMMARY_BLOCKS	(RIPAS_SUMMARY_WORDS * 64UL)
+
+/*
+ * Invalidate the RIPAS summary of the blocks of @rd which intersect
+ * [@base, @top). Must be called after the S2TTEs changing their RIPAS or
+ * HIPAS have been written, while the RTTs holding them are locked.
+ */
+void realm_ripas_summary_clear(struct rd *rd, unsigned long base,
+			       unsigned long top)
+{
+	unsigned long blk = base >> RIPAS_SUMMARY_BLOCK_SHIFT;
+	unsigned long end;
+
+	end = (top + (1UL << RIPAS_SUMMARY_BLOCK_SHIFT) - 1UL) >>
+		RIPAS_SUMMARY_BLOCK_SHIFT;
+	if (end > RIPAS_SUMMARY_BLOCKS) {
+		end = RIPAS_SUMMARY_BLOCKS;
+	}
+
+	/*
+	 * Increment the generation before clearing the bits, so that a
+	 * lookup which sets a bit concurrently notices it, see
+	 * ripas_summary_set().
+	 */
+	(void)atomic_load_add_release_64(&rd->ripas_summary_gen, 1L);
+
+	for (; blk < end; blk++) {
+		uint64_t *word = &rd->ripas_summary[blk / 64UL];
+		int bit = (int)(blk % 64UL);
+
+		if (atomic_test_bit_acquire_64(word, bit)) {
+			atomic_bit_clear_release_64(word, bit);
+		}
+	}
+}
+
+static bool ripas_summary_is_ram(struct rd *rd, unsigned long ipa)
+{
+	unsigned long blk = ipa >> RIPAS_SUMMARY_BLOCK_SHIFT;
+
+	if (blk >= RIPAS_SUMMARY_BLOCKS) {
+		return false;
+	}
+
+	return atomic_test_bit_acquire_64(&rd->ripas_summary[blk / 64UL],
+					  (int)(blk % 64UL));
+}
+
+/*
+ * Record that the block of @ipa has RIPAS RAM, as found by a walk started
+ * when the generation of the summary was @gen. The bit is cleared again if
+ * the summary has been invalidated since, as the walk may have read the
+ * S2TTE before it was changed.
+ */
+static void ripas_summary_set(struct rd *rd, unsigned long ipa, uint64_t gen)
+{
+	unsigned long blk = ipa >> RIPAS_SUMMARY_BLOCK_SHIFT;
+	uint64_t *word;
+	int bit;
+
+	if (blk >= RIPAS_SUMMARY_BLOCKS) {
+		return;
+	}
+
+	word = &rd->ripas_summary[blk / 64UL];
+	bit = (int)(blk % 64UL);
+
+	(void)atomic_bit_set_acquire_release_64(word, bit);
+	if (SCA_READ64_ACQUIRE(&rd->ripas_summary_gen) != gen) {
+		atomic_bit_clear_release_64(word, bit);
+	}
+}
+#endif /* RMM_RIPAS_SUMMARY */
+
 /*
  * Get RIPAS of IPA
  *
@@ -113,38 +288,69 @@ enum s2_walk_status realm_ipa_get_ripas(struct rec *rec, unsigned long ipa,
 {
 	unsigned long s2tte, *ll_table;
 	struct rtt_walk wi;
-	enum s2_walk_status ws;
+	long level;
+#ifdef RMM_RIPAS_SUMMARY
+	struct rd *rd = rec->rd;
+	uint64_t gen;
+#endif
 
 	assert(ripas_ptr != NULL);
 	assert(rtt_level != NULL);
 	assert(GRANULE_ALIGNED(ipa));
 	assert(addr_in_rec_par(rec, ipa));
 
-	granule_lock(rec->realm_info.g_rtt, GRANULE_STATE_RTT);
+#ifdef RMM_RIPAS_SUMMARY
+	gen = SCA_READ64_ACQUIRE(&rd->ripas_summary_gen);
 
-	rtt_walk_lock_unlock(rec->realm_info.g_rtt,
-			     rec->realm_info.s2_starting_level,
-			     rec->realm_info.ipa_bits,
-			     ipa, RTT_PAGE_LEVEL, &wi);
+	if (ripas_summary_is_ram(rd, ipa)) {
+		*ripas_ptr = RMI_RAM;
+		return WALK_SUCCESS;
+	}
+#endif
 
-	ll_table = granule_map(wi.g_llt, SLOT_RTT);
-	s2tte = s2tte_read(&ll_table[wi.index]);
+	s2tte = rtt_read_s2tte_lockless(rec->realm_info.g_rtt,
+					rec->realm_info.s2_starting_level,
+					rec->realm_info.ipa_bits,
+					ipa, RTT_PAGE_LEVEL, &level);
+
+	/*
+	 * A zero s2tte may be the transient entry written by a concurrent
+	 * break-before-make sequence. Redo the walk with the RTT locks held,
+	 * which serialises against the RMI command performing the update.
+	 */
+	if (s2tte == 0UL) {
+		granule_lock(rec->realm_info.g_rtt, GRANULE_STATE_RTT);
+
+		rtt_walk_lock_unlock(rec->realm_info.g_rtt,
+				     rec->realm_info.s2_starting_level,
+				     rec->realm_info.ipa_bits,
+				     ipa, RTT_PAGE_LEVEL, &wi);
+
+		ll_table = granule_map(wi.g_llt, SLOT_RTT);
+		s2tte = s2tte_read(&ll_table[wi.index]);
+		level = wi.last_level;
+
+		buffer_unmap(ll_table);
+		granule_unlock(wi.g_llt);
+	}
 
 	if (s2tte_is_destroyed(s2tte)) {
-		*rtt_level = wi.last_level;
+		*rtt_level = (unsigned long)level;
 		/*
 		 * The IPA has been destroyed by NS Host. Return data_abort back
 		 * to NS Host and there is no recovery possible of this Rec
 		 * after this.
 		 */
-		ws = WALK_FAIL;
-	} else {
-		*ripas_ptr = s2tte_get_ripas(s2tte);
-		ws = WALK_SUCCESS;
+		return WALK_FAIL;
 	}
 
-	buffer_unmap(ll_table);
-	granule_unlock(wi.g_llt);
+	*ripas_ptr = s2tte_get_ripas(s2tte);
 
-	return ws;
+#ifdef RMM_RIPAS_SUMMARY
+	/* A block entry gives the RIPAS of the whole summary block */
+	if ((*ripas_ptr == RMI_RAM) && (level < RTT_PAGE_LEVEL)) {
+		ripas_summary_set(rd, ipa, gen);
+	}
+#endif
+	return WALK_SUCCESS;
 }
@@ -0,0 +1,97 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <granule.h>
+#include <realm.h>
+#include <rec.h>
+#include <rsi-rec-stats.h>
+#include <rsi-walk.h>
+#include <smc-rmi.h>
+#include <smc-rsi.h>
+
+COMPILER_ASSERT(RSI_REC_STATS_NR_EXITS == RMI_REC_STATS_NR_EXITS);
+
+#ifdef RMM_REC_STATS
+static void rec_stats_copy(struct rec *rec, struct rsi_rec_stats *stats)
+{
+	for (unsigned int i = 0U; i < RSI_REC_STATS_NR_EXITS; i++) {
+		stats->exits[i] = rec->stats.exits[i];
+	}
+
+	stats->entries = rec->stats.entries;
+	stats->fast_exits = rec->stats.fast_exits;
+	stats->s2_faults = rec->stats.s2_faults;
+	stats->mmio_exits = rec->stats.mmio_exits;
+	stats->mmio_const_reads = rec->stats.mmio_const_reads;
+	stats->host_calls = rec->stats.host_calls;
+	stats->ripas_changes = rec->stats.ripas_changes;
+	stats->attest_iterations = rec->stats.attest_iterations;
+	stats->realm_ticks = rec->stats.realm_ticks;
+	stats->rmm_ticks = rec->stats.rmm_ticks;
+}
+#endif /* RMM_REC_STATS */
+
+/*
+ * The statistics are those of the calling REC, which runs on this CPU, so
+ * they do not change while they are copied. The exit of this call is
+ * already counted, but the ticks are only updated on the next REC entry.
+ */
+struct rsi_walk_smc_result handle_rsi_rec_stats(struct rec *rec)
+{
+	struct rsi_walk_smc_result res = { 0 };
+#ifdef RMM_REC_STATS
+	unsigned long ipa = rec->regs[1];
+	enum s2_walk_status walk_status;
+	struct s2_walk_result walk_res;
+	struct granule *gr;
+	struct rsi_rec_stats *stats;
+
+	if (!GRANULE_ALIGNED(ipa) || !addr_in_rec_par(rec, ipa)) {
+		res.smc_res.x[0] = RSI_ERROR_INPUT;
+		return res;
+	}
+
+	walk_status = realm_ipa_to_pa(rec->rd, ipa, &walk_res);
+
+	if (walk_status == WALK_FAIL) {
+		if (s2_walk_result_match_ripas(&walk_res, RMI_EMPTY)) {
+			res.smc_res.x[0] = RSI_ERROR_INPUT;
+		} else {
+			/* Exit to Host */
+			res.walk_result.abort = true;
+			res.walk_result.rtt_level = walk_res.rtt_level;
+		}
+		return res;
+	}
+
+	if (walk_status == WALK_INVALID_PARAMS) {
+		/* Return error to Realm */
+		res.smc_res.x[0] = RSI_ERROR_INPUT;
+		return res;
+	}
+
+	/* Map Realm data granule to RMM address space */
+	gr = find_granule(walk_res.pa);
+	stats = (struct rsi_rec_stats *)granule_map_mec(gr, SLOT_RSI_CALL,
+						rec->realm_info.mecid);
+
+	rec_stats_copy(rec, stats);
+
+	/* Unmap Realm data granule */
+	buffer_unmap(stats);
+
+	/* Unlock last level RTT */
+	granule_unlock(walk_res.llt);
+
+	res.smc_res.x[0] = RSI_SUCCESS;
+#else
+	(void)rec;
+
+	/* The statistics are not built in */
+	res.smc_res.x[0] = RSI_ERROR_INPUT;
+#endif /* RMM_REC_STATS */
+
+	return res;
+}
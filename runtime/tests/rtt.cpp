@@ -0,0 +1,499 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ * SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+extern "C" {
+#include <feature.h>
+#include <granule.h>
+#include <host_utils.h>
+#include <realm.h>
+#include <smc-rmi.h>
+#include <smc.h>
+#include <status.h>
+#include <string.h>
+#include <table.h>
+#include <test_helpers.h>
+#include <utils_def.h>
+
+/* Implemented in handler.c and needed here */
+void handle_ns_smc(unsigned long function_id,
+		   unsigned long arg0,
+		   unsigned long arg1,
+		   unsigned long arg2,
+		   unsigned long arg3,
+		   unsigned long arg4,
+		   unsigned long arg5,
+		   union smc_regs *regs);
+}
+
+/*
+ * Realm configuration used by the tests: a 39-bit IPA space with a single
+ * level 1 root RTT. The upper half of the IPA space is unprotected.
+ */
+#define TEST_IPA_BITS			(39UL)
+#define TEST_RTT_LEVEL_START		(1L)
+#define TEST_UNPROTECTED_IPA		(UL(1) << (TEST_IPA_BITS - 1UL))
+
+/* Normal WB memory with FWB, RW, Inner Shareable */
+#define TEST_NS_S2TTE_ATTRS		((UL(0x6) << 2) | (UL(3) << 6) | \
+					 (UL(3) << 8))
+
+/* A level 1 block of NS memory, at any 1GB aligned PA */
+#define TEST_NS_L1_BLOCK_PA		(UL(1) << 30)
+
+/* IPA of the page of data of the Realm, below which the RTTs are created */
+#define TEST_DATA_IPA			(0UL)
+
+/* Index of the granules used by the tests, the NS ones first */
+enum test_granule {
+	TEST_PARAMS,
+	TEST_LIST,
+	TEST_SRC,
+	TEST_EXPORT,
+	TEST_EXPORT_OLD,
+	TEST_RD,
+	TEST_RTT_ROOT,
+	TEST_RTT_L2,
+	TEST_RTT_L3,
+	TEST_DATA,
+	TEST_NR_GRANULES
+};
+
+/* Tag of an exported granule, as returned in ret2 - ret3 */
+struct test_tag {
+	unsigned long lo;
+	unsigned long hi;
+};
+
+static union smc_regs res;
+
+static unsigned long rmi(unsigned long fid, unsigned long arg0,
+			 unsigned long arg1, unsigned long arg2,
+			 unsigned long arg3, unsigned long arg4)
+{
+	handle_ns_smc(fid, arg0, arg1, arg2, arg3, arg4, 0UL, &res);
+	return res.x[0];
+}
+
+static unsigned long granule_addr(enum test_granule idx)
+{
+	return host_util_get_granule_base() +
+		((unsigned long)idx * GRANULE_SIZE);
+}
+
+static unsigned char *granule_ptr(enum test_granule idx)
+{
+	return (unsigned char *)granule_addr(idx);
+}
+
+/* Return a pointer to the first granule structure */
+static inline struct granule *get_granule_struct_base(void)
+{
+	return addr_to_granule(host_util_get_granule_base());
+}
+
+/* The RD is read directly to check the sequence number of the exports */
+static unsigned long realm_export_seq(void)
+{
+	return ((struct rd *)granule_addr(TEST_RD))->export_seq;
+}
+
+static bool granule_is_zero(enum test_granule idx)
+{
+	unsigned char *buf = granule_ptr(idx);
+
+	for (unsigned long i = 0UL; i < GRANULE_SIZE; i++) {
+		if (buf[i] != 0U) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void realm_create(unsigned long features_0)
+{
+	struct rmi_realm_params *params =
+		(struct rmi_realm_params *)granule_addr(TEST_PARAMS);
+
+	(void)memset(params, 0, sizeof(*params));
+	params->features_0 = features_0 |
+			     INPLACE(RMM_FEATURE_REGISTER_0_S2SZ,
+				     TEST_IPA_BITS);
+	params->hash_algo = RMI_HASH_ALGO_SHA256;
+	params->vmid = 1U;
+	params->rtt_base = granule_addr(TEST_RTT_ROOT);
+	params->rtt_level_start = TEST_RTT_LEVEL_START;
+	params->rtt_num_start = 1U;
+
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_REALM_CREATE, granule_addr(TEST_RD),
+		    (unsigned long)params, 0UL, 0UL, 0UL));
+}
+
+/*
+ * Delegate the granules of the Realm and create it with @features_0, with
+ * the RTTs down to the last level at TEST_DATA_IPA.
+ */
+static void realm_build(unsigned long features_0)
+{
+	unsigned long rd = granule_addr(TEST_RD);
+
+	for (unsigned int i = TEST_RD; i < TEST_NR_GRANULES; i++) {
+		UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+			rmi(SMC_RMM_GRANULE_DELEGATE,
+			    granule_addr((enum test_granule)i),
+			    0UL, 0UL, 0UL, 0UL));
+	}
+
+	realm_create(features_0);
+
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_RTT_CREATE, granule_addr(TEST_RTT_L2), rd,
+		    TEST_DATA_IPA, (unsigned long)(RTT_PAGE_LEVEL - 1L),
+		    0UL));
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_RTT_CREATE, granule_addr(TEST_RTT_L3), rd,
+		    TEST_DATA_IPA, (unsigned long)RTT_PAGE_LEVEL, 0UL));
+}
+
+/*
+ * Build a Realm with @features_0 and a page of data at TEST_DATA_IPA,
+ * copied from TEST_SRC.
+ */
+static void realm_build_data(unsigned long features_0)
+{
+	unsigned char *src = granule_ptr(TEST_SRC);
+
+	for (unsigned long i = 0UL; i < GRANULE_SIZE; i++) {
+		src[i] = (unsigned char)(i * 7UL);
+	}
+
+	realm_build(features_0);
+
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_DATA_CREATE, granule_addr(TEST_DATA),
+		    granule_addr(TEST_RD), TEST_DATA_IPA,
+		    granule_addr(TEST_SRC), 0UL));
+}
+
+/*
+ * Tear down and destroy the Realm, and undelegate the granules it freed,
+ * its root RTT and its RD. Return the number of granules freed by
+ * RMI_REALM_TEARDOWN.
+ */
+static unsigned long realm_release(void)
+{
+	unsigned long rd = granule_addr(TEST_RD);
+	unsigned long *addrs = (unsigned long *)granule_addr(TEST_LIST);
+	unsigned long nr_freed = 0UL;
+	unsigned long count;
+
+	do {
+		unsigned long ret = rmi(SMC_RMM_REALM_TEARDOWN, rd,
+					granule_addr(TEST_LIST),
+					0UL, 0UL, 0UL);
+
+		CHECK_TRUE((ret == (unsigned long)RMI_SUCCESS) ||
+			   (ret == (unsigned long)RMI_INCOMPLETE));
+		count = res.x[1];
+
+		for (unsigned long i = 0UL; i < count; i++) {
+			UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+				rmi(SMC_RMM_GRANULE_UNDELEGATE, addrs[i],
+				    0UL, 0UL, 0UL, 0UL));
+		}
+		nr_freed += count;
+	} while (count != 0UL);
+
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_REALM_DESTROY, rd, 0UL, 0UL, 0UL, 0UL));
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_GRANULE_UNDELEGATE, granule_addr(TEST_RTT_ROOT),
+		    0UL, 0UL, 0UL, 0UL));
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_GRANULE_UNDELEGATE, rd, 0UL, 0UL, 0UL, 0UL));
+
+	return nr_freed;
+}
+
+static unsigned long rtt_entry_state(unsigned long map_addr)
+{
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_RTT_READ_ENTRY, granule_addr(TEST_RD), map_addr,
+		    (unsigned long)RTT_PAGE_LEVEL, 0UL, 0UL));
+	return res.x[2];
+}
+
+/*
+ * Export the page at TEST_DATA_IPA to the NS granule @ns and return its tag
+ * in @tag. The DATA granule is DELEGATED and zeroed afterwards.
+ */
+static void data_export(enum test_granule ns, struct test_tag *tag)
+{
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_DATA_EXPORT, granule_addr(TEST_RD),
+		    TEST_DATA_IPA, granule_addr(ns), 0UL, 0UL));
+	UNSIGNED_LONGS_EQUAL(granule_addr(TEST_DATA), res.x[1]);
+	tag->lo = res.x[2];
+	tag->hi = res.x[3];
+
+	CHECK_TRUE(granule_is_zero(TEST_DATA));
+	UNSIGNED_LONGS_EQUAL(RMI_RTT_STATE_EXPORTED,
+			     rtt_entry_state(TEST_DATA_IPA));
+}
+
+/*
+ * Load the encrypted content of the NS granule @ns into the DELEGATED
+ * TEST_DATA granule, as the Host does, and import it with @tag.
+ */
+static unsigned long data_import(enum test_granule ns,
+				 const struct test_tag *tag)
+{
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_GRANULE_UNDELEGATE, granule_addr(TEST_DATA),
+		    0UL, 0UL, 0UL, 0UL));
+	(void)memcpy(granule_ptr(TEST_DATA), granule_ptr(ns), GRANULE_SIZE);
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_GRANULE_DELEGATE_PRESERVE_RANGE,
+		    granule_addr(TEST_DATA), 1UL, 0UL, 0UL, 0UL));
+	UNSIGNED_LONGS_EQUAL(1UL, res.x[1]);
+
+	return rmi(SMC_RMM_DATA_IMPORT, granule_addr(TEST_DATA),
+		   granule_addr(TEST_RD), TEST_DATA_IPA, tag->lo, tag->hi);
+}
+
+/* Check that a failed import left TEST_DATA DELEGATED and zeroed */
+static void check_import_failed(unsigned long ret)
+{
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_INPUT, ret);
+	CHECK_TRUE(granule_is_zero(TEST_DATA));
+	UNSIGNED_LONGS_EQUAL(RMI_RTT_STATE_EXPORTED,
+			     rtt_entry_state(TEST_DATA_IPA));
+}
+
+/* Check that the page at TEST_DATA_IPA holds the content of TEST_SRC */
+static void check_data_imported(unsigned long ret)
+{
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS, ret);
+	MEMCMP_EQUAL(granule_ptr(TEST_SRC), granule_ptr(TEST_DATA),
+		     GRANULE_SIZE);
+	UNSIGNED_LONGS_EQUAL(RMI_RTT_STATE_ASSIGNED,
+			     rtt_entry_state(TEST_DATA_IPA));
+}
+
+TEST_GROUP(rtt) {
+
+	TEST_SETUP()
+	{
+		/* Enable the platform with support for multiple PEs */
+		test_helper_rmm_start(true);
+
+		/* Make sure current cpu id is 0 (primary processor) */
+		host_util_set_cpuid(0U);
+	}
+
+	TEST_TEARDOWN()
+	{
+		/*
+		 * Clean RMM's internal struct granule array
+		 * for a clean state for the next tests.
+		 */
+		memset((void *)get_granule_struct_base(), 0,
+			sizeof(struct granule) *
+					test_helper_get_nr_granules());
+	}
+};
+
+/*
+ * Tear down a Realm which holds a level 1 Valid_NS block next to a page of
+ * data, and check that RMI_REALM_TEARDOWN frees every granule of the Realm
+ * so that it can be destroyed.
+ */
+TEST(rtt, realm_teardown_l1_block_TC1)
+{
+	unsigned long rd = granule_addr(TEST_RD);
+
+	realm_build(0UL);
+
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_RTT_MAP_UNPROTECTED, rd, TEST_UNPROTECTED_IPA, 1UL,
+		    TEST_NS_L1_BLOCK_PA | TEST_NS_S2TTE_ATTRS, 0UL));
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_DATA_CREATE_UNKNOWN, granule_addr(TEST_DATA), rd,
+		    TEST_DATA_IPA, 0UL, 0UL));
+
+	/* A Realm with mappings cannot be destroyed */
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_IN_USE,
+		rmi(SMC_RMM_REALM_DESTROY, rd, 0UL, 0UL, 0UL, 0UL));
+
+	/* The two RTTs below the root and the data granule */
+	UNSIGNED_LONGS_EQUAL(3UL, realm_release());
+}
+
+/*
+ * Export a page of a Realm and import it back, twice, and check that it
+ * holds the same content afterwards and that each export uses the next
+ * sequence number as its IV.
+ */
+TEST(rtt, data_export_import_TC1)
+{
+	struct test_tag tag;
+
+	realm_build_data(INPLACE(RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN, 1));
+	UNSIGNED_LONGS_EQUAL(0UL, realm_export_seq());
+
+	data_export(TEST_EXPORT, &tag);
+	UNSIGNED_LONGS_EQUAL(1UL, realm_export_seq());
+
+	/* The content is not written in clear to the NS granule */
+	CHECK_TRUE(memcmp(granule_ptr(TEST_SRC), granule_ptr(TEST_EXPORT),
+			  GRANULE_SIZE) != 0);
+
+	check_data_imported(data_import(TEST_EXPORT, &tag));
+
+	/* The same content is encrypted differently with the next IV */
+	(void)memcpy(granule_ptr(TEST_EXPORT_OLD), granule_ptr(TEST_EXPORT),
+		     GRANULE_SIZE);
+	data_export(TEST_EXPORT, &tag);
+	UNSIGNED_LONGS_EQUAL(2UL, realm_export_seq());
+	CHECK_TRUE(memcmp(granule_ptr(TEST_EXPORT_OLD),
+			  granule_ptr(TEST_EXPORT), GRANULE_SIZE) != 0);
+
+	check_data_imported(data_import(TEST_EXPORT, &tag));
+
+	/* The two RTTs below the root and the data granule */
+	UNSIGNED_LONGS_EQUAL(3UL, realm_release());
+}
+
+/*
+ * Import the content of an older export of the same page, with its own
+ * tag, and check that it fails until the latest export is imported.
+ */
+TEST(rtt, data_import_stale_TC1)
+{
+	struct test_tag old_tag, tag;
+
+	realm_build_data(INPLACE(RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN, 1));
+
+	data_export(TEST_EXPORT_OLD, &old_tag);
+	check_data_imported(data_import(TEST_EXPORT_OLD, &old_tag));
+	data_export(TEST_EXPORT, &tag);
+
+	check_import_failed(data_import(TEST_EXPORT_OLD, &old_tag));
+
+	/* The content of the latest export with the tag of the older one */
+	check_import_failed(data_import(TEST_EXPORT, &old_tag));
+
+	check_data_imported(data_import(TEST_EXPORT, &tag));
+
+	UNSIGNED_LONGS_EQUAL(3UL, realm_release());
+}
+
+/*
+ * Import an export with a corrupted tag or content, or without loading it
+ * first, and check that it fails and leaves the granule DELEGATED and
+ * zeroed, so that the Host can load it again.
+ */
+TEST(rtt, data_import_bad_tag_TC1)
+{
+	unsigned long data = granule_addr(TEST_DATA);
+	struct test_tag tag, bad_tag;
+
+	realm_build_data(INPLACE(RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN, 1));
+	data_export(TEST_EXPORT, &tag);
+
+	bad_tag = tag;
+	bad_tag.hi ^= 1UL;
+	check_import_failed(data_import(TEST_EXPORT, &bad_tag));
+
+	granule_ptr(TEST_EXPORT)[GRANULE_SIZE - 1UL] ^= 1U;
+	check_import_failed(data_import(TEST_EXPORT, &tag));
+	granule_ptr(TEST_EXPORT)[GRANULE_SIZE - 1UL] ^= 1U;
+
+	/* A granule delegated without keeping its content is rejected */
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_GRANULE_UNDELEGATE, data, 0UL, 0UL, 0UL, 0UL));
+	(void)memcpy(granule_ptr(TEST_DATA), granule_ptr(TEST_EXPORT),
+		     GRANULE_SIZE);
+	UNSIGNED_LONGS_EQUAL(RMI_SUCCESS,
+		rmi(SMC_RMM_GRANULE_DELEGATE, data, 0UL, 0UL, 0UL, 0UL));
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_INPUT,
+		rmi(SMC_RMM_DATA_IMPORT, data, granule_addr(TEST_RD),
+		    TEST_DATA_IPA, tag.lo, tag.hi));
+	UNSIGNED_LONGS_EQUAL(RMI_RTT_STATE_EXPORTED,
+			     rtt_entry_state(TEST_DATA_IPA));
+
+	check_data_imported(data_import(TEST_EXPORT, &tag));
+
+	UNSIGNED_LONGS_EQUAL(3UL, realm_release());
+}
+
+/*
+ * Make exports fail once they have taken a sequence number, and check that
+ * the number is not used again by the next export, whose content still
+ * imports.
+ */
+TEST(rtt, data_export_failure_seq_TC1)
+{
+	unsigned long rd = granule_addr(TEST_RD);
+	unsigned long ret;
+	struct test_tag tag;
+
+	realm_build_data(INPLACE(RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN, 1));
+
+	/* Rejected before a sequence number is taken */
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_INPUT,
+		rmi(SMC_RMM_DATA_EXPORT, rd, TEST_DATA_IPA,
+		    granule_addr(TEST_RTT_ROOT), 0UL, 0UL));
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_INPUT,
+		rmi(SMC_RMM_DATA_EXPORT, rd, TEST_DATA_IPA + 1UL,
+		    granule_addr(TEST_EXPORT), 0UL, 0UL));
+	UNSIGNED_LONGS_EQUAL(0UL, realm_export_seq());
+
+	/* No page is mapped at the IPA */
+	ret = rmi(SMC_RMM_DATA_EXPORT, rd, TEST_DATA_IPA + GRANULE_SIZE,
+		  granule_addr(TEST_EXPORT), 0UL, 0UL);
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_RTT, ret & 0xffUL);
+	UNSIGNED_LONGS_EQUAL(1UL, realm_export_seq());
+
+	/* No RTT of the last level translates the IPA */
+	ret = rmi(SMC_RMM_DATA_EXPORT, rd, UL(1) << 30,
+		  granule_addr(TEST_EXPORT), 0UL, 0UL);
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_RTT, ret & 0xffUL);
+	UNSIGNED_LONGS_EQUAL(2UL, realm_export_seq());
+
+	data_export(TEST_EXPORT, &tag);
+	UNSIGNED_LONGS_EQUAL(3UL, realm_export_seq());
+
+	/* An Exported page cannot be exported again */
+	ret = rmi(SMC_RMM_DATA_EXPORT, rd, TEST_DATA_IPA,
+		  granule_addr(TEST_EXPORT_OLD), 0UL, 0UL);
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_RTT, ret & 0xffUL);
+	UNSIGNED_LONGS_EQUAL(4UL, realm_export_seq());
+
+	check_data_imported(data_import(TEST_EXPORT, &tag));
+
+	UNSIGNED_LONGS_EQUAL(3UL, realm_release());
+}
+
+/*
+ * Check that the pages of a Realm created without
+ * RMM_FEATURE_REGISTER_0_DATA_EXPORT_EN cannot be exported.
+ */
+TEST(rtt, data_export_disabled_TC1)
+{
+	realm_build_data(0UL);
+
+	UNSIGNED_LONGS_EQUAL(RMI_ERROR_REALM,
+		rmi(SMC_RMM_DATA_EXPORT, granule_addr(TEST_RD), TEST_DATA_IPA,
+		    granule_addr(TEST_EXPORT), 0UL, 0UL));
+	UNSIGNED_LONGS_EQUAL(0UL, realm_export_seq());
+	UNSIGNED_LONGS_EQUAL(RMI_RTT_STATE_ASSIGNED,
+			     rtt_entry_state(TEST_DATA_IPA));
+
+	UNSIGNED_LONGS_EQUAL(3UL, realm_release());
+}
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-3-Clause
+# SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+#
+
+"""
+Decode the binary trace of RMI and RSI calls recorded by RMM when built with
+RMM_TRACE=ON. The input is the content of the NS granule filled by
+RMI_TRACE_DUMP for one CPU. The layout decoded here must match
+runtime/include/trace.h.
+"""
+
+from argparse import ArgumentParser
+import os
+import re
+import struct
+import sys
+
+TRACE_MAGIC = 0x52544d52
+TRACE_VERSION = 1
+
+TRACE_FLAG_RSI = 1 << 0
+TRACE_FLAG_EXIT_TO_REC = 1 << 1
+
+# Default of the GRANULE_SIZE build option, see cmake/CommonConfigs.cmake
+DEFAULT_GRANULE_SIZE = 4096
+GRANULE_SIZES = (4096, 16384, 65536)
+HEADER_FMT = '<IIQ'
+RECORD_FMT = '<QII5Q2Q'
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+RECORD_SIZE = struct.calcsize(RECORD_FMT)
+
+# Base function IDs of the SMC64 standard service ranges
+SMC64_STD_FID_BASE = 0xC4000000
+SMC64_RMI_FNUM_MIN = 0x150
+SMC64_RSI_FNUM_MIN = 0x190
+
+# Replay file read by the host_replay variant of the host platform, see
+# plat/host/host_replay/src/host_replay.c
+REPLAY_MAGIC = 0x50524d52
+REPLAY_VERSION = 1
+REPLAY_HEADER_FMT = '<IIQQ'
+REPLAY_RECORD_HDR_FMT = '<II'
+REPLAY_RECORD_SMC = 1
+REPLAY_SMC_FMT = '<Q6QQ'
+
+FID_PATTERN = re.compile(
+    r'#define\s+(SMC_(?:RMM|RSI)_\w+)\s+SMC64_(RMI|RSI)_FID\(U\((0x[0-9a-fA-F]+)\)\)')
+
+
+def read_fid_names(src_dir):
+    """Build a FID to name map from the RMI and RSI headers."""
+    names = {}
+    headers = ['lib/realm/include/smc-rmi.h', 'lib/realm/include/smc-rsi.h']
+
+    for header in headers:
+        path = os.path.join(src_dir, header)
+        if not os.path.isfile(path):
+            continue
+
+        with open(path, encoding='utf-8') as f:
+            for match in FID_PATTERN.finditer(f.read()):
+                base = (SMC64_RMI_FNUM_MIN if match.group(2) == 'RMI'
+                        else SMC64_RSI_FNUM_MIN)
+                fid = SMC64_STD_FID_BASE | (base + int(match.group(3), 16))
+                names[fid] = match.group(1)
+
+    return names
+
+
+def trace_entries(granule_size):
+    """Return the number of records in the ring, see TRACE_ENTRIES."""
+    return (granule_size - HEADER_SIZE) // RECORD_SIZE
+
+
+def decode(data, names, entries):
+    """Return the records of a trace with @entries records, oldest first."""
+    magic, version, head = struct.unpack_from(HEADER_FMT, data, 0)
+
+    if magic != TRACE_MAGIC:
+        raise ValueError(f'bad magic 0x{magic:08x}')
+
+    if version != TRACE_VERSION:
+        raise ValueError(f'unsupported trace version {version}')
+
+    nr_records = min(head, entries)
+    records = []
+
+    for i in range(head - nr_records, head):
+        offset = HEADER_SIZE + ((i % entries) * RECORD_SIZE)
+        fields = struct.unpack_from(RECORD_FMT, data, offset)
+        records.append({
+            'timestamp': fields[0],
+            'fid': fields[1],
+            'flags': fields[2],
+            'args': fields[3:8],
+            'res': fields[8:10],
+            'name': names.get(fields[1], f'SMC_{fields[1]:08x}'),
+        })
+
+    return records
+
+
+def format_record(rec):
+    args = ' '.join(f'{arg:8x}' for arg in rec['args'])
+    line = f'{rec["timestamp"]:16d} {rec["name"]:<32} {args} >'
+
+    if rec['flags'] & TRACE_FLAG_RSI:
+        if rec['flags'] & TRACE_FLAG_EXIT_TO_REC:
+            line += f' {rec["res"][0]:x}'
+        else:
+            line += ' (exit to host)'
+    else:
+        line += f' {rec["res"][0]:x} {rec["res"][1]:x}'
+
+    return line
+
+
+def write_replay(path, records, dram_base, dram_size):
+    """
+    Write the RMI calls of @records as a replay file. The trace does not hold
+    the content of the NS granules read by the calls, nor their sixth
+    argument, so the replay of the calls which depend on them may fail.
+    """
+    with open(path, 'wb') as f:
+        f.write(struct.pack(REPLAY_HEADER_FMT, REPLAY_MAGIC, REPLAY_VERSION,
+                            dram_base, dram_size))
+
+        for rec in records:
+            if rec['flags'] & TRACE_FLAG_RSI:
+                continue
+
+            smc = struct.pack(REPLAY_SMC_FMT, rec['fid'], *rec['args'], 0,
+                              rec['res'][0])
+            f.write(struct.pack(REPLAY_RECORD_HDR_FMT, REPLAY_RECORD_SMC,
+                                len(smc)))
+            f.write(smc)
+
+
+def main():
+    parser = ArgumentParser(description='Decode an RMM binary trace')
+    parser.add_argument('trace', nargs='+',
+                        help='granule dumped by RMI_TRACE_DUMP, one per CPU')
+    parser.add_argument('--src', default=os.path.join(
+                        os.path.dirname(__file__), '..', '..'),
+                        help='RMM source tree, used to name the calls')
+    parser.add_argument('--replay', metavar='FILE',
+                        help='write the RMI calls, merged across CPUs in '
+                        'timestamp order, as a replay file for host_replay')
+    parser.add_argument('--dram-base', type=lambda x: int(x, 0), default=0,
+                        help='base of the DRAM rebased by host_replay')
+    parser.add_argument('--dram-size', type=lambda x: int(x, 0), default=0,
+                        help='size of the DRAM rebased by host_replay')
+    parser.add_argument('--granule-size', type=lambda x: int(x, 0),
+                        choices=GRANULE_SIZES, default=DEFAULT_GRANULE_SIZE,
+                        help='GRANULE_SIZE of the RMM build, which sets the '
+                        f'size of the ring (default {DEFAULT_GRANULE_SIZE})')
+    args = parser.parse_args()
+
+    names = read_fid_names(args.src)
+    entries = trace_entries(args.granule_size)
+    records = []
+
+    for trace in args.trace:
+        with open(trace, 'rb') as f:
+            data = f.read()
+
+        if len(data) < HEADER_SIZE + (entries * RECORD_SIZE):
+            print(f'{trace}: truncated trace', file=sys.stderr)
+            return 1
+
+        try:
+            records += decode(data, names, entries)
+        except ValueError as err:
+            print(f'{trace}: {err}', file=sys.stderr)
+            return 1
+
+    if len(args.trace) > 1:
+        records.sort(key=lambda rec: rec['timestamp'])
+
+    if args.replay:
+        write_replay(args.replay, records, args.dram_base, args.dram_size)
+        return 0
+
+    for rec in records:
+        print(format_record(rec))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-3-Clause
+# SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+#
+
+"""
+Fold the PC samples recorded by RMM when built with RMM_PC_SAMPLE=ON into
+the input format of flamegraph.pl, one line per context and function with
+its number of samples. The input is the content of the NS granule filled by
+RMI_TRACE_DUMP with RMI_TRACE_DUMP_PC_SAMPLES for one CPU. The layout
+decoded here must match struct pc_sample_buffer in runtime/include/trace.h.
+"""
+
+from argparse import ArgumentParser
+import os
+import re
+import struct
+import subprocess
+import sys
+
+PC_SAMPLE_MAGIC = 0x53504d52
+PC_SAMPLE_VERSION = 1
+
+PC_SAMPLE_FLAG_REC_EXIT = 1 << 0
+PC_SAMPLE_FLAG_POLLED = 1 << 1
+
+GRANULE_SIZE = 4096
+HEADER_FMT = '<IIQ'
+RECORD_FMT = '<QII'
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+RECORD_SIZE = struct.calcsize(RECORD_FMT)
+PC_SAMPLE_ENTRIES = (GRANULE_SIZE - HEADER_SIZE) // RECORD_SIZE
+
+# Base function ID of the SMC64 RMI range
+SMC64_STD_FID_BASE = 0xC4000000
+SMC64_RMI_FNUM_MIN = 0x150
+
+FID_PATTERN = re.compile(
+    r'#define\s+SMC_RMM_(\w+)\s+SMC64_RMI_FID\(U\((0x[0-9a-fA-F]+)\)\)')
+EXIT_PATTERN = re.compile(
+    r'#define\s+RMI_REC_STATS_EXIT_(\w+)\s+(\d+)UL')
+
+
+def read_names(src_dir):
+    """Build the RMI FID and Realm exit cause to name maps."""
+    fids = {}
+    exits = {}
+    path = os.path.join(src_dir, 'lib/realm/include/smc-rmi.h')
+
+    if os.path.isfile(path):
+        with open(path, encoding='utf-8') as f:
+            header = f.read()
+
+        for match in FID_PATTERN.finditer(header):
+            fid = SMC64_STD_FID_BASE | (SMC64_RMI_FNUM_MIN +
+                                        int(match.group(2), 16))
+            fids[fid] = 'RMI_' + match.group(1)
+
+        for match in EXIT_PATTERN.finditer(header):
+            if match.group(1) != 'TICKS':
+                exits[int(match.group(2))] = 'EXIT_' + match.group(1)
+
+    return fids, exits
+
+
+def decode(data):
+    """Return the (pc, ctx, flags) samples of the ring, oldest first."""
+    magic, version, head = struct.unpack_from(HEADER_FMT, data, 0)
+
+    if magic != PC_SAMPLE_MAGIC:
+        raise ValueError(f'bad magic 0x{magic:08x}')
+
+    if version != PC_SAMPLE_VERSION:
+        raise ValueError(f'unsupported samples version {version}')
+
+    nr_records = min(head, PC_SAMPLE_ENTRIES)
+
+    return [struct.unpack_from(RECORD_FMT, data,
+                               HEADER_SIZE +
+                               ((i % PC_SAMPLE_ENTRIES) * RECORD_SIZE))
+            for i in range(head - nr_records, head)]
+
+
+def symbolise(elf, pcs):
+    """Map each PC to its function in @elf with addr2line."""
+    if not pcs:
+        return {}
+
+    pcs = sorted(pcs)
+    out = subprocess.run([os.environ.get('ADDR2LINE', 'addr2line'),
+                          '-f', '-e', elf] + [hex(pc) for pc in pcs],
+                         capture_output=True, text=True, check=True).stdout
+    lines = out.splitlines()
+
+    # addr2line prints the function and the source line of each address
+    return {pc: lines[2 * i] for i, pc in enumerate(pcs)}
+
+
+def main():
+    parser = ArgumentParser(description='Fold RMM PC samples for flame '
+                            'graphs')
+    parser.add_argument('samples', nargs='+',
+                        help='granule dumped by RMI_TRACE_DUMP with '
+                        'RMI_TRACE_DUMP_PC_SAMPLES, one per CPU')
+    parser.add_argument('--elf', required=True,
+                        help='RMM ELF the samples were taken from')
+    parser.add_argument('--src', default='.',
+                        help='RMM source tree, to name the RMI commands and '
+                        'the Realm exit causes')
+    args = parser.parse_args()
+
+    fids, exits = read_names(args.src)
+    samples = []
+
+    for path in args.samples:
+        with open(path, 'rb') as f:
+            data = f.read()
+
+        if len(data) < HEADER_SIZE + (PC_SAMPLE_ENTRIES * RECORD_SIZE):
+            print(f'{path}: truncated samples', file=sys.stderr)
+            return 1
+
+        try:
+            samples += decode(data)
+        except ValueError as err:
+            print(f'{path}: {err}', file=sys.stderr)
+            return 1
+
+    funcs = symbolise(args.elf, {pc for pc, _, flags in samples
+                                 if (flags & PC_SAMPLE_FLAG_POLLED) == 0})
+    folded = {}
+
+    for pc, ctx, flags in samples:
+        if (flags & PC_SAMPLE_FLAG_REC_EXIT) != 0:
+            stack = ['RMI_REC_ENTER', exits.get(ctx, f'EXIT_{ctx}')]
+        else:
+            stack = [fids.get(ctx, f'0x{ctx:08x}')]
+
+        if (flags & PC_SAMPLE_FLAG_POLLED) != 0:
+            stack.append('[masked]')
+        else:
+            stack.append(funcs.get(pc, f'0x{pc:x}'))
+
+        key = ';'.join(stack)
+        folded[key] = folded.get(key, 0) + 1
+
+    for key in sorted(folded):
+        print(f'{key} {folded[key]}')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
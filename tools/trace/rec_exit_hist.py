@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-3-Clause
+# SPDX-FileCopyrightText: Copyright TF-RMM Contributors.
+#
+
+"""
+Build latency histograms from the trace of the REC entries recorded by RMM
+when built with RMM_REC_EXIT_TRACE=ON. The input is the content of the NS
+granule filled by RMI_REC_EXIT_TRACE_DUMP for one CPU. The layout decoded
+here must match struct rec_exit_trace_buffer in runtime/include/trace.h.
+"""
+
+from argparse import ArgumentParser
+import struct
+import sys
+
+REC_EXIT_TRACE_MAGIC = 0x54584d52
+REC_EXIT_TRACE_VERSION = 1
+
+GRANULE_SIZE = 4096
+HEADER_FMT = '<IIQ'
+RECORD_FMT = '<5QII'
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+RECORD_SIZE = struct.calcsize(RECORD_FMT)
+REC_EXIT_TRACE_ENTRIES = (GRANULE_SIZE - HEADER_SIZE) // RECORD_SIZE
+
+# RMI_EXIT_* reasons, see lib/realm/include/smc-rmi.h
+EXIT_REASONS = ['SYNC', 'IRQ', 'FIQ', 'PSCI', 'RIPAS_CHANGE', 'HOST_CALL',
+                'SERROR', 'ATTEST_SIGN']
+
+# Latencies reported, as the pair of record fields they are measured between
+LATENCIES = [
+    ('entry', 'rmi_entry', 'realm_entry'),
+    ('exit', 'realm_exit', 'rmi_return'),
+    ('in realm', 'realm_entry', 'realm_exit'),
+    ('total', 'rmi_entry', 'rmi_return'),
+]
+
+PERCENTILES = [50, 90, 99, 99.9]
+
+
+def decode(data):
+    """Return the records of the trace, oldest first."""
+    magic, version, head = struct.unpack_from(HEADER_FMT, data, 0)
+
+    if magic != REC_EXIT_TRACE_MAGIC:
+        raise ValueError(f'bad magic 0x{magic:08x}')
+
+    if version != REC_EXIT_TRACE_VERSION:
+        raise ValueError(f'unsupported trace version {version}')
+
+    nr_records = min(head, REC_EXIT_TRACE_ENTRIES)
+    records = []
+
+    for i in range(head - nr_records, head):
+        offset = HEADER_SIZE + ((i % REC_EXIT_TRACE_ENTRIES) * RECORD_SIZE)
+        fields = struct.unpack_from(RECORD_FMT, data, offset)
+        records.append({
+            'rmi_entry': fields[0],
+            'realm_entry': fields[1],
+            'realm_exit': fields[2],
+            'rmi_return': fields[3],
+            'esr': fields[4],
+            'exit_reason': fields[5],
+            'nr_exits': fields[6],
+        })
+
+    return records
+
+
+def percentile(values, pct):
+    """Return the @pct percentile of the sorted list @values."""
+    return values[min(len(values) - 1, int((len(values) * pct) // 100))]
+
+
+def print_histogram(values, nr_buckets, scale, unit):
+    """Print a histogram of @values with log2 sized buckets."""
+    counts = {}
+
+    for value in values:
+        bucket = max(0, int(value).bit_length() - 1)
+        counts[bucket] = counts.get(bucket, 0) + 1
+
+    peak = max(counts.values())
+
+    for bucket in sorted(counts)[-nr_buckets:]:
+        low = (1 << bucket) * scale
+        bar = '#' * max(1, (counts[bucket] * 40) // peak)
+        print(f'    >= {low:12.3f} {unit} {counts[bucket]:8d} {bar}')
+
+
+def report(records, freq, nr_buckets):
+    """Print the latency percentiles and histograms of @records."""
+    scale = 1e6 / freq if freq else 1
+    unit = 'us' if freq else 'ticks'
+
+    for name, start, end in LATENCIES:
+        values = sorted(rec[end] - rec[start] for rec in records)
+        pcts = ' '.join(f'p{pct} {percentile(values, pct) * scale:.3f}'
+                        for pct in PERCENTILES)
+        print(f'{name:<10} {len(values):8d} REC_ENTER  {pcts} '
+              f'max {values[-1] * scale:.3f} {unit}')
+        print_histogram(values, nr_buckets, scale, unit)
+
+    nr_exits = sum(rec['nr_exits'] for rec in records)
+    print(f'{nr_exits / len(records):.2f} Realm exits per REC_ENTER, '
+          'the ones handled by RMM are included in "in realm"')
+
+    print('\nexit reason       count  p50 exit  p99 exit  max exit '
+          f'({unit})')
+
+    for reason in sorted({rec['exit_reason'] for rec in records}):
+        values = sorted(rec['rmi_return'] - rec['realm_exit']
+                        for rec in records if rec['exit_reason'] == reason)
+        name = (EXIT_REASONS[reason] if reason < len(EXIT_REASONS)
+                else str(reason))
+        print(f'{name:<14} {len(values):8d} '
+              f'{percentile(values, 50) * scale:9.3f} '
+              f'{percentile(values, 99) * scale:9.3f} '
+              f'{values[-1] * scale:9.3f}')
+
+
+def main():
+    parser = ArgumentParser(description='Build REC entry and exit latency '
+                            'histograms from RMM REC exit traces')
+    parser.add_argument('trace', nargs='+',
+                        help='granule dumped by RMI_REC_EXIT_TRACE_DUMP, '
+                        'one per CPU')
+    parser.add_argument('--freq', type=lambda x: int(x, 0), default=0,
+                        help='frequency of CNTPCT_EL0 in Hz, as read from '
+                        'CNTFRQ_EL0, to report in us instead of ticks')
+    parser.add_argument('--buckets', type=int, default=12,
+                        help='number of histogram buckets printed')
+    args = parser.parse_args()
+
+    records = []
+
+    for trace in args.trace:
+        with open(trace, 'rb') as f:
+            data = f.read()
+
+        if len(data) < HEADER_SIZE + (REC_EXIT_TRACE_ENTRIES * RECORD_SIZE):
+            print(f'{trace}: truncated trace', file=sys.stderr)
+            return 1
+
+        try:
+            records += decode(data)
+        except ValueError as err:
+            print(f'{trace}: {err}', file=sys.stderr)
+            return 1
+
+    if not records:
+        print('no REC entries recorded', file=sys.stderr)
+        return 1
+
+    report(records, args.freq, args.buckets)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())